@@ -39,6 +39,24 @@ export interface Direct6Token {
 export interface GameClientPlugin {
 	id: string;
 	uid: number;
+	stats?: PluginStats;
+}
+
+// timing of one type of plugin callback, over one PluginStats interval
+export interface PluginCallbackStats {
+	name: string;
+	calls: number;
+	totalMicros: number;
+	maxMicros: number;
+}
+
+// callback timings most recently reported for a GameClientPlugin, covering the last intervalMicros
+export interface PluginStats {
+	intervalMicros: number;
+	budgetMicros: number;
+	framesOverBudget: number;
+	framesThrottled: number;
+	callbacks: PluginCallbackStats[];
 }
 
 // connected game client for plugin management purposes
@@ -87,9 +105,16 @@ interface GameClientListMessage {
 	clients: GameClient[];
 }
 
+interface InstallProgressMessage {
+	type: 'installProgress';
+	name: string;
+	progress: number;
+}
+
 export type BoltMessage =
 	| AuthTokenUpdateMessage
 	| AuthSessionUpdateMessage
 	| AuthFailedMessage
 	| ExternalUrlMessage
-	| GameClientListMessage;
+	| GameClientListMessage
+	| InstallProgressMessage;
@@ -141,6 +141,12 @@ function addMessageListeners(): void {
 					clientList.set(event.data.clients);
 				}
 				break;
+			case 'installProgress': {
+				const content = `Installing ${event.data.name}... ${event.data.progress}%`;
+				if (event.data.progress === 0) logger.info(content);
+				else logger.updateLogAtIndex(0, content);
+				break;
+			}
 			default: {
 				const type = (event.data as { type: string | undefined })?.type ?? 'no type provided';
 				logger.info(`Unknown message type: ${type}`);
@@ -3,8 +3,10 @@
 #include "include/cef_v8.h"
 #include "include/cef_values.h"
 #include "include/internal/cef_types.h"
+#include "../library/ipc.h"
 
 #include <fmt/core.h>
+#include <algorithm>
 
 #if defined(_WIN32)
 #include <Windows.h>
@@ -101,6 +103,28 @@ void Browser::App::OnUncaughtException(
 	fmt::print("\n");
 }
 
+// converts the "stats" dictionary built by Client::ListGameClients to a JS object with the same keys
+static CefRefPtr<CefV8Value> PluginStatsToV8(CefRefPtr<CefDictionaryValue> dict) {
+	CefRefPtr<CefV8Value> stats = CefV8Value::CreateObject(nullptr, nullptr);
+	stats->SetValue("intervalMicros", CefV8Value::CreateDouble(dict->GetDouble("intervalMicros")), V8_PROPERTY_ATTRIBUTE_READONLY);
+	stats->SetValue("budgetMicros", CefV8Value::CreateDouble(dict->GetDouble("budgetMicros")), V8_PROPERTY_ATTRIBUTE_READONLY);
+	stats->SetValue("framesOverBudget", CefV8Value::CreateInt(dict->GetInt("framesOverBudget")), V8_PROPERTY_ATTRIBUTE_READONLY);
+	stats->SetValue("framesThrottled", CefV8Value::CreateInt(dict->GetInt("framesThrottled")), V8_PROPERTY_ATTRIBUTE_READONLY);
+	CefRefPtr<CefListValue> in_callbacks = dict->GetList("callbacks");
+	CefRefPtr<CefV8Value> callbacks = CefV8Value::CreateArray(in_callbacks->GetSize());
+	for (size_t i = 0; i < in_callbacks->GetSize(); i += 1) {
+		CefRefPtr<CefDictionaryValue> in_cb = in_callbacks->GetDictionary(i);
+		CefRefPtr<CefV8Value> cb = CefV8Value::CreateObject(nullptr, nullptr);
+		cb->SetValue("name", CefV8Value::CreateString(in_cb->GetString("name")), V8_PROPERTY_ATTRIBUTE_READONLY);
+		cb->SetValue("calls", CefV8Value::CreateDouble(in_cb->GetDouble("calls")), V8_PROPERTY_ATTRIBUTE_READONLY);
+		cb->SetValue("totalMicros", CefV8Value::CreateDouble(in_cb->GetDouble("totalMicros")), V8_PROPERTY_ATTRIBUTE_READONLY);
+		cb->SetValue("maxMicros", CefV8Value::CreateDouble(in_cb->GetDouble("maxMicros")), V8_PROPERTY_ATTRIBUTE_READONLY);
+		callbacks->SetValue(i, cb);
+	}
+	stats->SetValue("callbacks", callbacks, V8_PROPERTY_ATTRIBUTE_READONLY);
+	return stats;
+}
+
 bool Browser::App::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame, CefProcessId, CefRefPtr<CefProcessMessage> message) {
 	CefString name = message->GetName();
 
@@ -129,6 +153,9 @@ bool Browser::App::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser, CefRe
 					CefRefPtr<CefV8Value> plugin = CefV8Value::CreateObject(nullptr, nullptr);
 					plugin->SetValue("id", CefV8Value::CreateString(in_plugin->GetString("id")), V8_PROPERTY_ATTRIBUTE_READONLY);
 					plugin->SetValue("uid", CefV8Value::CreateUInt(in_plugin->GetInt("uid")), V8_PROPERTY_ATTRIBUTE_READONLY);
+					if (in_plugin->HasKey("stats")) {
+						plugin->SetValue("stats", PluginStatsToV8(in_plugin->GetDictionary("stats")), V8_PROPERTY_ATTRIBUTE_READONLY);
+					}
 					plugins->SetValue(j, plugin);
 				}
 
@@ -154,6 +181,27 @@ bool Browser::App::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser, CefRe
 		return true;
 	}
 
+	if (name == "__bolt_install_progress") {
+		CefRefPtr<CefV8Context> context = frame->GetV8Context();
+		context->Enter();
+		CefRefPtr<CefV8Value> post_message = context->GetGlobal()->GetValue("postMessage");
+		if (post_message->IsFunction()) {
+			CefRefPtr<CefListValue> list = message->GetArgumentList();
+
+			// equivalent to: `window.postMessage({type: 'installProgress', name: '...', progress: 0}, '*')`
+			CefRefPtr<CefV8Value> dict = CefV8Value::CreateObject(nullptr, nullptr);
+			dict->SetValue("type", CefV8Value::CreateString("installProgress"), V8_PROPERTY_ATTRIBUTE_READONLY);
+			dict->SetValue("name", CefV8Value::CreateString(list->GetString(0)), V8_PROPERTY_ATTRIBUTE_READONLY);
+			dict->SetValue("progress", CefV8Value::CreateInt(list->GetInt(1)), V8_PROPERTY_ATTRIBUTE_READONLY);
+			CefV8ValueList value_list = {dict, CefV8Value::CreateString("*")};
+			post_message->ExecuteFunctionWithContext(context, nullptr, value_list);
+		} else {
+			fmt::print("[R] warning: window.postMessage is not a function, {} will be ignored\n", name.ToString());
+		}
+		context->Exit();
+		return true;
+	}
+
 	if (name == "__bolt_plugin_message") {
 		CefRefPtr<CefV8Context> context = frame->GetV8Context();
 		context->Enter();
@@ -186,57 +234,112 @@ bool Browser::App::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser, CefRe
 
 	if (name == "__bolt_plugin_capture") {
 		CefRefPtr<CefListValue> list = message->GetArgumentList();
-		if (list->GetSize() >= 2) {
+		if (list->GetSize() >= 5) {
 			const int width = list->GetInt(0);
 			const int height = list->GetInt(1);
+			const size_t offset = (size_t)list->GetDouble(2);
+			const size_t shm_size = (size_t)list->GetDouble(3);
 			const size_t size = (size_t)width * (size_t)height * 3;
+			const CefRefPtr<CefBinaryValue> dirty_tiles = list->GetType(4) == VTYPE_BINARY ? list->GetBinary(4) : nullptr;
 
-			if (list->GetSize() != 2) {
+			if (list->GetSize() != 5) {
 #if defined(_WIN32)
-				const std::wstring path = list->GetString(2).ToWString();
+				const std::wstring path = list->GetString(5).ToWString();
 				if (shm_inited) {
 					UnmapViewOfFile(shm_file);
 					CloseHandle(shm_handle);
 				}
 				shm_handle = OpenFileMappingW(FILE_MAP_READ, TRUE, path.c_str());
-				shm_file = MapViewOfFile(shm_handle, FILE_MAP_READ, 0, 0, size);
+				shm_file = MapViewOfFile(shm_handle, FILE_MAP_READ, 0, 0, shm_size);
 #else
-				if (list->GetType(2) == VTYPE_STRING) {
-					const std::string path = list->GetString(2).ToString();
+				if (list->GetType(5) == VTYPE_STRING) {
+					const std::string path = list->GetString(5).ToString();
 					if (shm_inited) {
 						munmap(shm_file, shm_length);
 						close(shm_fd);
 					}
 					shm_fd = shm_open(path.c_str(), O_RDWR, 0644);
-					shm_file = mmap(NULL, size, PROT_READ, MAP_SHARED, shm_fd, 0);
+					shm_file = mmap(NULL, shm_size, PROT_READ, MAP_SHARED, shm_fd, 0);
 					fmt::print("[R] shm named-remap '{}' -> {}, {}\n", path, shm_fd, (unsigned long long)shm_file);
 				} else if (shm_inited) {
-					shm_file = mremap(shm_file, shm_length, size, MREMAP_MAYMOVE);
+					shm_file = mremap(shm_file, shm_length, shm_size, MREMAP_MAYMOVE);
 					fmt::print("[R] shm unnamed-remap -> {} ({})\n", (unsigned long long)shm_file, errno);
 				} else {
 					fmt::print("[R] warning: shm not set up and wasn't provided with enough information to do setup; {} will be ignored\n", name.ToString());
 					return true;
 				}
 #endif
-				shm_length = size;
+				shm_length = shm_size;
 				shm_inited = true;
 			}
 
+			if (offset + size > shm_length) {
+				fmt::print("[R] warning: capture is outside the bounds of the shm, {} will be ignored\n", name.ToString());
+				return true;
+			}
+
+			const size_t tiles_x = ((size_t)width + BOLT_CAPTURE_TILE_SIZE - 1) / BOLT_CAPTURE_TILE_SIZE;
+			const size_t tiles_y = ((size_t)height + BOLT_CAPTURE_TILE_SIZE - 1) / BOLT_CAPTURE_TILE_SIZE;
+			if (dirty_tiles && dirty_tiles->GetSize() < ((tiles_x * tiles_y) + 7) / 8) {
+				fmt::print("[R] warning: dirty-tile bitmap is too small for the capture, {} will be ignored\n", name.ToString());
+				return true;
+			}
+
 			CefRefPtr<CefV8ArrayBufferReleaseCallback> cb = new ArrayBufferReleaseCallbackFree();
-			void* buffer = malloc(size);
-			memcpy(buffer, shm_file, size);
+			const uint8_t* image = (const uint8_t*)shm_file + offset;
+			void* buffer;
+			size_t buffer_size;
+			void* tile_bitmap = nullptr;
+			size_t tile_bitmap_size = 0;
+			if (dirty_tiles) {
+				// pack the dirty tiles one after the other, each with its own rows contiguous
+				tile_bitmap_size = dirty_tiles->GetSize();
+				tile_bitmap = malloc(tile_bitmap_size);
+				dirty_tiles->GetData(tile_bitmap, tile_bitmap_size, 0);
+				const uint8_t* bits = (const uint8_t*)tile_bitmap;
+				const size_t stride = (size_t)width * 3;
+				buffer_size = 0;
+				for (size_t i = 0; i < tiles_x * tiles_y; i += 1) {
+					if (!(bits[i / 8] & (1 << (i % 8)))) continue;
+					const size_t x = (i % tiles_x) * BOLT_CAPTURE_TILE_SIZE;
+					const size_t y = (i / tiles_x) * BOLT_CAPTURE_TILE_SIZE;
+					buffer_size += std::min<size_t>(width - x, BOLT_CAPTURE_TILE_SIZE) * std::min<size_t>(height - y, BOLT_CAPTURE_TILE_SIZE) * 3;
+				}
+				buffer = malloc(buffer_size ? buffer_size : 1);
+				uint8_t* out = (uint8_t*)buffer;
+				for (size_t i = 0; i < tiles_x * tiles_y; i += 1) {
+					if (!(bits[i / 8] & (1 << (i % 8)))) continue;
+					const size_t x = (i % tiles_x) * BOLT_CAPTURE_TILE_SIZE;
+					const size_t y = (i / tiles_x) * BOLT_CAPTURE_TILE_SIZE;
+					const size_t row_size = std::min<size_t>(width - x, BOLT_CAPTURE_TILE_SIZE) * 3;
+					const size_t rows = std::min<size_t>(height - y, BOLT_CAPTURE_TILE_SIZE);
+					for (size_t row = 0; row < rows; row += 1) {
+						memcpy(out, image + ((y + row) * stride) + (x * 3), row_size);
+						out += row_size;
+					}
+				}
+			} else {
+				buffer_size = size;
+				buffer = malloc(size);
+				memcpy(buffer, image, size);
+			}
 
 			CefRefPtr<CefProcessMessage> response_message = CefProcessMessage::Create("__bolt_plugin_capture_done");
 			frame->SendProcessMessage(PID_BROWSER, response_message);
 
 			CefRefPtr<CefV8Context> context = frame->GetV8Context();
 			context->Enter();
-			CefRefPtr<CefV8Value> content = CefV8Value::CreateArrayBuffer(buffer, size, cb);
+			CefRefPtr<CefV8Value> content = CefV8Value::CreateArrayBuffer(buffer, buffer_size, cb);
 			CefRefPtr<CefV8Value> dict = CefV8Value::CreateObject(nullptr, nullptr);
 			dict->SetValue("type", CefV8Value::CreateString("screenCapture"), V8_PROPERTY_ATTRIBUTE_READONLY);
 			dict->SetValue("content", content, V8_PROPERTY_ATTRIBUTE_READONLY);
 			dict->SetValue("width", CefV8Value::CreateInt(width), V8_PROPERTY_ATTRIBUTE_READONLY);
 			dict->SetValue("height", CefV8Value::CreateInt(height), V8_PROPERTY_ATTRIBUTE_READONLY);
+			if (tile_bitmap) {
+				CefRefPtr<CefV8Value> tiles = CefV8Value::CreateArrayBuffer(tile_bitmap, tile_bitmap_size, new ArrayBufferReleaseCallbackFree());
+				dict->SetValue("tileSize", CefV8Value::CreateInt(BOLT_CAPTURE_TILE_SIZE), V8_PROPERTY_ATTRIBUTE_READONLY);
+				dict->SetValue("dirtyTiles", tiles, V8_PROPERTY_ATTRIBUTE_READONLY);
+			}
 			CefV8ValueList value_list = {dict, CefV8Value::CreateString("*")};
 			CefRefPtr<CefV8Value> post_message = context->GetGlobal()->GetValue("postMessage");
 			if (post_message->IsFunction()) {
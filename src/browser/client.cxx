@@ -6,7 +6,15 @@
 #include "window_osr.hxx"
 #include "window_plugin.hxx"
 #include "../library/event.h"
+#include "../library/frametrace.h"
 #include <cstring>
+#include <ctime>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 #define BOLT_IPC_URL "https://bolt-blankpage/"
 #endif
 
@@ -44,7 +52,8 @@ Browser::Client::Client(CefRefPtr<Browser::App> app,std::filesystem::path config
 	CLIENT_FILEHANDLER(BOLT_DEV_LAUNCHER_DIRECTORY, true),
 #endif
 #if defined(BOLT_PLUGINS)
-	next_client_uid(0), next_plugin_uid(0),
+	next_client_uid(0), next_plugin_uid(0), frame_trace_running(false), frame_trace_id(0),
+	frame_trace_any_events(false), frame_trace_waiting(0),
 #endif
 	show_devtools(SHOW_DEVTOOLS), config_dir(config_dir), data_dir(data_dir), runtime_dir(runtime_dir), launcher(nullptr)
 {
@@ -254,14 +263,71 @@ CefRefPtr<CefResourceRequestHandler> Browser::Client::GetResourceRequestHandler(
 }
 
 #if defined(BOLT_PLUGINS)
+// maps the ring shm offered by a game client in IPC_MSG_IDENTIFY, returning nullptr on failure
+static void* MapClientRings(int pid, size_t size) {
+	void* file;
+#if defined(_WIN32)
+	wchar_t buf[256];
+	_snwprintf(buf, 256, L"/bolt-%i-ipc-0", pid);
+	HANDLE handle = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, buf);
+	if (!handle) {
+		fmt::print("[I] couldn't open IPC ring shm: error {}\n", GetLastError());
+		return nullptr;
+	}
+	file = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	CloseHandle(handle);
+#else
+	char buf[256];
+	snprintf(buf, sizeof(buf), "/bolt-%i-ipc-0", pid);
+	int shm_fd = shm_open(buf, O_RDWR, 0644);
+	if (shm_fd == -1) {
+		fmt::print("[I] couldn't open IPC ring shm: error {}\n", errno);
+		return nullptr;
+	}
+	file = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	close(shm_fd);
+	if (file == MAP_FAILED) file = nullptr;
+#endif
+	if (!file) fmt::print("[I] couldn't map IPC ring shm\n");
+	return file;
+}
+
+static void UnmapClientRings(void* file, size_t size) {
+#if defined(_WIN32)
+	UnmapViewOfFile(file);
+#else
+	munmap(file, size);
+#endif
+}
+
 void Browser::Client::IPCHandleNewClient(int fd) {
 	fmt::print("[I] new client fd {}\n", fd);
 	this->game_clients_lock.lock();
-	this->game_clients.push_back(GameClient {.uid = this->next_client_uid, .fd = fd, .deleted = false, .identity = nullptr});
+	this->game_clients.push_back(GameClient {
+		.uid = this->next_client_uid, .fd = fd, .deleted = false, .identity = nullptr, .ring_shm = nullptr, .ring_shm_size = 0,
+		.shared_textures = false,
+		.send_queue = new SendQueue(fd, [this]() { this->IPCWake(); }),
+		.frame_trace_pending = false,
+	});
 	this->next_client_uid += 1;
+	this->frame_trace_lock.lock();
+	if (this->frame_trace_running) this->SendFrameTrace(&this->game_clients.back(), true);
+	this->frame_trace_lock.unlock();
 	this->game_clients_lock.unlock();
 }
 
+bool Browser::Client::IPCWriteQueues() {
+	bool pending = false;
+	std::lock_guard<std::mutex> _(this->game_clients_lock);
+	for (GameClient& g: this->game_clients) {
+		if (g.deleted) continue;
+		// on error, just leave it; the read side will see the client go away and clean up
+		if (!g.send_queue->Write()) continue;
+		if (g.send_queue->HasPending()) pending = true;
+	}
+	return pending;
+}
+
 void Browser::Client::IPCHandleClientListUpdate(bool need_lock_mutex) {
 	this->launcher_lock.lock();
 	if (this->launcher) {
@@ -276,7 +342,26 @@ void Browser::Client::IPCHandleClosed(int fd) {
 	if (it != this->game_clients.end()) {
 		bool delete_now = true;
 		delete[] it->identity;
+		it->identity = nullptr;
 		it->deleted = true;
+		// only the IPC thread ever writes to the fd, so once the queue is closed, nothing else will
+		it->send_queue->Close();
+		const SendQueue::Stats stats = it->send_queue->GetStats();
+		fmt::print(
+			"[I] client fd {} sent {} messages ({} bytes), stalled {} times, peak queue {} bytes\n",
+			fd, stats.messages, stats.bytes_written, stats.stalls, stats.peak_bytes_queued
+		);
+		_bolt_ipc_release(fd);
+		if (it->frame_trace_pending) {
+			std::lock_guard<std::mutex> _(this->frame_trace_lock);
+			it->frame_trace_pending = false;
+			this->frame_trace_waiting -= 1;
+			if (!this->frame_trace_waiting) this->FinishFrameTrace();
+		}
+		if (it->ring_shm) {
+			UnmapClientRings(it->ring_shm, it->ring_shm_size);
+			it->ring_shm = nullptr;
+		}
 		for (CefRefPtr<ActivePlugin>& p: it->plugins) {
 			p->deleted = true;
 			for (CefRefPtr<WindowOSR>& w: p->windows_osr) {
@@ -329,11 +414,143 @@ CefRefPtr<Browser::Client::ActivePlugin> Browser::Client::GetPluginFromFDAndID(G
 	return nullptr;
 }
 
-bool Browser::Client::IPCHandleMessage(int fd) {
-	BoltIPCMessageTypeToHost msg_type;
-	if (_bolt_ipc_receive(fd, &msg_type, sizeof(msg_type))) {
-		return false;
+// max number of messages handled from one client before moving on to the next one
+constexpr size_t IPC_MESSAGES_PER_TURN = 64;
+
+// a connection's message buffer is given back after a message bigger than this, rather than kept
+constexpr size_t IPC_MESSAGE_KEEP_CAPACITY = 1 << 20;
+
+// means a message type isn't known, so nothing after it can be understood either
+constexpr size_t UNKNOWN_MESSAGE_SIZE = SIZE_MAX;
+
+// size of the header that comes after each type of message, or UNKNOWN_MESSAGE_SIZE
+static size_t MessageHeaderSize(BoltIPCMessageTypeToHost type) {
+	switch (type) {
+		case IPC_MSG_DUPLICATEPROCESS: return 0;
+		case IPC_MSG_IDENTIFY: return sizeof(BoltIPCIdentifyHeader);
+		case IPC_MSG_CLIENT_STOPPED_PLUGIN: return sizeof(BoltIPCClientStoppedPluginHeader);
+		case IPC_MSG_CREATEBROWSER_EXTERNAL: return sizeof(BoltIPCCreateBrowserHeader);
+		case IPC_MSG_CREATEBROWSER_OSR: return sizeof(BoltIPCCreateBrowserHeader);
+		case IPC_MSG_CLOSEBROWSER_EXTERNAL: return sizeof(BoltIPCCloseBrowserHeader);
+		case IPC_MSG_CLOSEBROWSER_OSR: return sizeof(BoltIPCCloseBrowserHeader);
+		case IPC_MSG_OSRUPDATE_ACK: return sizeof(BoltIPCOsrUpdateAckHeader);
+		// events have no tail, so the event itself is counted as part of the header
+		case IPC_MSG_EVREPOSITION: return sizeof(BoltIPCEvHeader) + sizeof(RepositionEvent);
+		case IPC_MSG_EVMOUSEMOTION: return sizeof(BoltIPCEvHeader) + sizeof(MouseMotionEvent);
+		case IPC_MSG_EVMOUSEBUTTON: return sizeof(BoltIPCEvHeader) + sizeof(MouseButtonEvent);
+		case IPC_MSG_EVMOUSEBUTTONUP: return sizeof(BoltIPCEvHeader) + sizeof(MouseButtonEvent);
+		case IPC_MSG_EVSCROLL: return sizeof(BoltIPCEvHeader) + sizeof(MouseScrollEvent);
+		case IPC_MSG_EVMOUSELEAVE: return sizeof(BoltIPCEvHeader) + sizeof(MouseMotionEvent);
+		case IPC_MSG_PLUGINMESSAGE: return sizeof(BoltIPCPluginMessageHeader);
+		case IPC_MSG_OSRPLUGINMESSAGE: return sizeof(BoltIPCPluginMessageHeader);
+		case IPC_MSG_CAPTURENOTIFY_EXTERNAL: return sizeof(BoltIPCCaptureNotifyHeader);
+		case IPC_MSG_CAPTURENOTIFY_OSR: return sizeof(BoltIPCCaptureNotifyHeader);
+		case IPC_MSG_RINGSTART: return 0;
+		case IPC_MSG_PLUGINSTATS: return sizeof(BoltIPCPluginStatsHeader);
+		case IPC_MSG_TEXCACHE_PUBLISHED: return sizeof(BoltIPCTexCachePublishedHeader);
+		case IPC_MSG_FRAMETRACEDATA: return sizeof(BoltIPCFrameTraceDataHeader);
+		default: return UNKNOWN_MESSAGE_SIZE;
+	}
+}
+
+template <typename T>
+static T MessageHeader(const uint8_t* header) {
+	T ret;
+	memcpy(&ret, header, sizeof(ret));
+	return ret;
+}
+
+// size of the tail that comes after a message's header
+static size_t MessageTailSize(BoltIPCMessageTypeToHost type, const uint8_t* header) {
+	switch (type) {
+		case IPC_MSG_IDENTIFY: return MessageHeader<BoltIPCIdentifyHeader>(header).name_length;
+		case IPC_MSG_CREATEBROWSER_EXTERNAL:
+		case IPC_MSG_CREATEBROWSER_OSR: return MessageHeader<BoltIPCCreateBrowserHeader>(header).url_length;
+		case IPC_MSG_PLUGINMESSAGE:
+		case IPC_MSG_OSRPLUGINMESSAGE: return MessageHeader<BoltIPCPluginMessageHeader>(header).message_size;
+		case IPC_MSG_CAPTURENOTIFY_EXTERNAL:
+		case IPC_MSG_CAPTURENOTIFY_OSR: return MessageHeader<BoltIPCCaptureNotifyHeader>(header).dirty_tiles_size;
+		case IPC_MSG_PLUGINSTATS: return (size_t)MessageHeader<BoltIPCPluginStatsHeader>(header).plugin_count * sizeof(BoltIPCPluginStats);
+		case IPC_MSG_FRAMETRACEDATA: {
+			const BoltIPCFrameTraceDataHeader h = MessageHeader<BoltIPCFrameTraceDataHeader>(header);
+			return ((size_t)h.event_count * sizeof(BoltIPCFrameTraceEvent)) + h.names_size;
+		}
+		default: return 0;
+	}
+}
+
+// reads a fully-received message in place of ipc_receive. the message was sized from its own
+// header, so reading beyond the end can only be a bug, but it gets zeroes rather than overrunning
+struct MessageReader {
+	const uint8_t* data;
+	size_t length;
+	size_t offset;
+
+	void Read(void* out, size_t len) {
+		const size_t count = std::min(len, this->length - this->offset);
+		memcpy(out, this->data + this->offset, count);
+		if (count < len) memset((uint8_t*)out + count, 0, len - count);
+		this->offset += count;
 	}
+};
+
+bool Browser::Client::IPCReadConnection(IPCConnection* connection, bool* drained) {
+	*drained = false;
+	size_t handled = 0;
+	while (handled < IPC_MESSAGES_PER_TURN) {
+		if (connection->received < connection->message.size()) {
+			size_t received;
+			uint8_t* dest = connection->message.data() + connection->received;
+			if (_bolt_ipc_try_receive(connection->fd, dest, connection->message.size() - connection->received, &received)) {
+				return false;
+			}
+			if (received == 0) {
+				*drained = true;
+				return true;
+			}
+			connection->received += received;
+			if (connection->received < connection->message.size()) continue;
+		}
+
+		// the current stage is complete, so work out how much of the next one there is
+		BoltIPCMessageTypeToHost msg_type;
+		memcpy(&msg_type, connection->message.data(), sizeof(msg_type));
+		if (connection->stage == 0) {
+			const size_t header_size = MessageHeaderSize(msg_type);
+			if (header_size == UNKNOWN_MESSAGE_SIZE) {
+				fmt::print("[I] got unknown message type {} from client fd {}\n", static_cast<int>(msg_type), connection->fd);
+				return false;
+			}
+			connection->message.resize(sizeof(msg_type) + header_size);
+			connection->stage = 1;
+			continue;
+		}
+		if (connection->stage == 1) {
+			const size_t tail_size = MessageTailSize(msg_type, connection->message.data() + sizeof(msg_type));
+			connection->message.resize(connection->message.size() + tail_size);
+			connection->stage = 2;
+			continue;
+		}
+
+		// this has to be handled before reading any further, since it could switch this client over
+		// to its ring, after which nothing more comes on the socket
+		if (!this->IPCHandleMessage(connection->fd, connection->message.data(), connection->message.size())) {
+			return false;
+		}
+		handled += 1;
+		if (connection->message.capacity() > IPC_MESSAGE_KEEP_CAPACITY) connection->message = std::vector<uint8_t>();
+		connection->message.resize(sizeof(BoltIPCMessageTypeToHost));
+		connection->stage = 0;
+		connection->received = 0;
+	}
+	return true;
+}
+
+bool Browser::Client::IPCHandleMessage(int fd, const uint8_t* data, size_t length) {
+	BOLT_FRAMETRACE_SCOPE(scope, "host:IPCHandleMessage");
+	MessageReader reader = { .data = data, .length = length, .offset = 0 };
+	BoltIPCMessageTypeToHost msg_type;
+	reader.Read(&msg_type, sizeof(msg_type));
 
 	if (msg_type == IPC_MSG_DUPLICATEPROCESS) {
 		this->ipc_browser->GetMainFrame()->SendProcessMessage(PID_RENDERER, CefProcessMessage::Create("__bolt_open_launcher"));
@@ -351,17 +568,68 @@ bool Browser::Client::IPCHandleMessage(int fd) {
 	switch (msg_type) {
 		case IPC_MSG_IDENTIFY: {
 			struct BoltIPCIdentifyHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
-			delete[] client->identity;
-			client->identity = new char[header.name_length + 1];
-			_bolt_ipc_receive(fd, client->identity, header.name_length);
-			client->identity[header.name_length] = '\0';
-			this->IPCHandleClientListUpdate(false);
+			reader.Read(&header, sizeof(header));
+			if (header.name_length) {
+				delete[] client->identity;
+				client->identity = new char[header.name_length + 1];
+				reader.Read(client->identity, header.name_length);
+				client->identity[header.name_length] = '\0';
+				this->IPCHandleClientListUpdate(false);
+			}
+
+			// capacity must be a power of two, and the control blocks must agree with the header
+			const uint64_t capacity = header.ring_capacity;
+			if (!client->ring_shm && capacity && !(capacity & (capacity - 1))) {
+				const size_t size = BOLT_IPC_RING_SHM_SIZE(capacity);
+				void* file = MapClientRings(header.pid, size);
+				if (file && _bolt_ipc_ring_get(file, 0)->capacity == capacity && _bolt_ipc_ring_get(file, 1)->capacity == capacity) {
+					const BoltIPCMessageTypeToClient accept_type = IPC_MSG_RINGACCEPT;
+					client->ring_shm = file;
+					client->ring_shm_size = size;
+					// everything already queued has to go on the socket before the accept message
+					client->send_queue->Flush();
+					_bolt_ipc_send(fd, &accept_type, sizeof(accept_type));
+					_bolt_ipc_set_send_ring(fd, _bolt_ipc_ring_get(file, 1));
+				} else if (file) {
+					UnmapClientRings(file, size);
+				}
+			}
+#if defined(_WIN32)
+			client->shared_textures = header.shared_textures;
+#else
+			client->shared_textures = header.shared_textures && client->ring_shm;
+#endif
+
+			// every client of this host shares one texture cache, named after the host's pid
+			const BoltIPCMessageTypeToClient texcache_type = IPC_MSG_TEXCACHE;
+#if defined(_WIN32)
+			const BoltIPCTexCacheHeader texcache_header = { .owner = (int)GetCurrentProcessId() };
+#else
+			const BoltIPCTexCacheHeader texcache_header = { .owner = getpid() };
+#endif
+			const BoltIPCBuffer texcache_buffers[] = {
+				{ .data = &texcache_type, .len = sizeof(texcache_type) },
+				{ .data = &texcache_header, .len = sizeof(texcache_header) },
+			};
+			client->send_queue->Send(texcache_buffers, std::size(texcache_buffers));
+			break;
+		}
+		case IPC_MSG_TEXCACHE_PUBLISHED: {
+			BoltIPCTexCachePublishedHeader header;
+			reader.Read(&header, sizeof(header));
+			this->texcache_ids.push_back(header.id);
+			break;
+		}
+		case IPC_MSG_RINGSTART: {
+			// this was the client's last message on the socket, everything after it is in the ring
+			if (client->ring_shm) {
+				_bolt_ipc_set_receive_ring(fd, _bolt_ipc_ring_get(client->ring_shm, 0));
+			}
 			break;
 		}
 		case IPC_MSG_CLIENT_STOPPED_PLUGIN: {
 			BoltIPCClientStoppedPluginHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
+			reader.Read(&header, sizeof(header));
 			for (auto it = client->plugins.begin(); it != client->plugins.end(); it++) {
 				if ((*it)->deleted || (*it)->uid != header.plugin_id) continue;
 				(*it)->deleted = true;
@@ -381,9 +649,9 @@ bool Browser::Client::IPCHandleMessage(int fd) {
 		}
 		case IPC_MSG_CREATEBROWSER_EXTERNAL: {
 			BoltIPCCreateBrowserHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
+			reader.Read(&header, sizeof(header));
 			char* url = new char[header.url_length + 1];
-			_bolt_ipc_receive(fd, url, header.url_length);
+			reader.Read(url, header.url_length);
 			url[header.url_length] = '\0';
 
 			CefRefPtr<ActivePlugin> plugin = this->GetPluginFromFDAndID(client, header.plugin_id);
@@ -394,20 +662,20 @@ bool Browser::Client::IPCHandleMessage(int fd) {
 				.resizeable = true,
 				.frame = true,
 			};
-			plugin->windows.push_back(new Browser::PluginWindow(this, details, url, plugin, fd, &this->send_lock, header.window_id, header.plugin_id, false));
+			plugin->windows.push_back(new Browser::PluginWindow(this, details, url, plugin, fd, client->send_queue, header.window_id, header.plugin_id, false));
 			delete[] url;
 			break;
 		}
 		case IPC_MSG_CREATEBROWSER_OSR: {
 			BoltIPCCreateBrowserHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
+			reader.Read(&header, sizeof(header));
 			char* url = new char[header.url_length + 1];
-			_bolt_ipc_receive(fd, url, header.url_length);
+			reader.Read(url, header.url_length);
 			url[header.url_length] = '\0';
 
 			CefRefPtr<ActivePlugin> plugin = this->GetPluginFromFDAndID(client, header.plugin_id);
 			if (plugin) {
-				CefRefPtr<Browser::WindowOSR> window = new Browser::WindowOSR(CefString((char*)url), header.w, header.h, fd, this, &this->send_lock, header.pid, header.window_id, header.plugin_id, plugin);
+				CefRefPtr<Browser::WindowOSR> window = new Browser::WindowOSR(CefString((char*)url), header.w, header.h, fd, this, client->send_queue, header.pid, header.window_id, header.plugin_id, plugin, client->shared_textures);
 				plugin->windows_osr.push_back(window);
 			}
 			delete[] url;
@@ -415,45 +683,88 @@ bool Browser::Client::IPCHandleMessage(int fd) {
 		}
 		case IPC_MSG_CLOSEBROWSER_EXTERNAL: {
 			BoltIPCCloseBrowserHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
+			reader.Read(&header, sizeof(header));
 			CefRefPtr<Browser::PluginWindow> window = this->GetExternalWindowFromFDAndIDs(client, header.plugin_id, header.window_id);
 			if (window && !window->IsDeleted()) window->Close();
 			break;
 		}
 		case IPC_MSG_CLOSEBROWSER_OSR: {
 			BoltIPCCloseBrowserHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
+			reader.Read(&header, sizeof(header));
 			CefRefPtr<Browser::WindowOSR> window = this->GetOsrWindowFromFDAndIDs(client, header.plugin_id, header.window_id);
 			if (window && !window->IsDeleted()) window->Close();
 			break;
 		}
 		case IPC_MSG_OSRUPDATE_ACK: {
 			BoltIPCOsrUpdateAckHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
+			reader.Read(&header, sizeof(header));
 			CefRefPtr<Browser::WindowOSR> window = this->GetOsrWindowFromFDAndIDs(client, header.plugin_id, header.window_id);
-			if (window) window->HandleAck();
+			if (window) window->HandleAck(header.generation, header.is_popup);
 			break;
 		}
 		case IPC_MSG_CAPTURENOTIFY_EXTERNAL: {
 			BoltIPCCaptureNotifyHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
+			reader.Read(&header, sizeof(header));
+			std::vector<uint8_t> dirty_tiles(header.dirty_tiles_size);
+			reader.Read(dirty_tiles.data(), dirty_tiles.size());
 			CefRefPtr<Browser::PluginWindow> window = this->GetExternalWindowFromFDAndIDs(client, header.plugin_id, header.window_id);
-			if (window && !window->IsDeleted()) window->HandleCaptureNotify(header.pid, header.capture_id, header.width, header.height, header.needs_remap != 0);
+			if (window && !window->IsDeleted()) window->HandleCaptureNotify(header.pid, header.capture_id, header.offset, header.shm_size, header.width, header.height, header.needs_remap != 0, dirty_tiles);
 			break;
 		}
 		case IPC_MSG_CAPTURENOTIFY_OSR: {
 			BoltIPCCaptureNotifyHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
+			reader.Read(&header, sizeof(header));
+			std::vector<uint8_t> dirty_tiles(header.dirty_tiles_size);
+			reader.Read(dirty_tiles.data(), dirty_tiles.size());
 			CefRefPtr<Browser::WindowOSR> window = this->GetOsrWindowFromFDAndIDs(client, header.plugin_id, header.window_id);
-			if (window && !window->IsDeleted()) window->HandleCaptureNotify(header.pid, header.capture_id, header.width, header.height, header.needs_remap != 0);
+			if (window && !window->IsDeleted()) window->HandleCaptureNotify(header.pid, header.capture_id, header.offset, header.shm_size, header.width, header.height, header.needs_remap != 0, dirty_tiles);
+			break;
+		}
+		case IPC_MSG_PLUGINSTATS: {
+			BoltIPCPluginStatsHeader header;
+			reader.Read(&header, sizeof(header));
+			for (uint32_t i = 0; i < header.plugin_count; i += 1) {
+				BoltIPCPluginStats stats;
+				reader.Read(&stats, sizeof(stats));
+				CefRefPtr<ActivePlugin> plugin = this->GetPluginFromFDAndID(client, stats.plugin_id);
+				if (!plugin) continue;
+				plugin->stats = stats;
+				plugin->stats_interval_micros = header.interval_micros;
+				plugin->has_stats = true;
+			}
+			this->IPCHandleClientListUpdate(false);
+			break;
+		}
+		case IPC_MSG_FRAMETRACEDATA: {
+			BoltIPCFrameTraceDataHeader header;
+			reader.Read(&header, sizeof(header));
+			std::vector<BoltIPCFrameTraceEvent> events(header.event_count);
+			reader.Read(events.data(), events.size() * sizeof(BoltIPCFrameTraceEvent));
+			// one extra terminator, in case the last name is missing its own
+			std::vector<char> names(header.names_size + 1, '\0');
+			reader.Read(names.data(), header.names_size);
+			std::lock_guard<std::mutex> _(this->frame_trace_lock);
+			if (!client->frame_trace_pending || header.trace_id != this->frame_trace_id) break;
+			if (client->identity) {
+				this->WriteFrameTraceProcessName(header.pid, fmt::format("Game client: {}", client->identity));
+			} else {
+				this->WriteFrameTraceProcessName(header.pid, fmt::format("Game client {}", client->uid));
+			}
+			for (const BoltIPCFrameTraceEvent& event: events) {
+				const char* name = names.data() + std::min<size_t>(event.name_offset, header.names_size);
+				this->WriteFrameTraceEvent(header.pid, event.thread, name, event.start_micros, event.duration_micros);
+			}
+			client->frame_trace_pending = false;
+			this->frame_trace_waiting -= 1;
+			if (!this->frame_trace_waiting) this->FinishFrameTrace();
 			break;
 		}
 
 #define DEF_OSR_EVENT(EVNAME, HANDLER, EVTYPE) case IPC_MSG_EV##EVNAME: { \
 	BoltIPCEvHeader header; \
 	EVTYPE event; \
-	_bolt_ipc_receive(fd, &header, sizeof(header)); \
-	_bolt_ipc_receive(fd, &event, sizeof(event)); \
+	reader.Read(&header, sizeof(header)); \
+	reader.Read(&event, sizeof(event)); \
 	CefRefPtr<Browser::WindowOSR> window = this->GetOsrWindowFromFDAndIDs(client, header.plugin_id, header.window_id); \
 	if (window) window->HANDLER(&event); \
 	break; \
@@ -468,9 +779,9 @@ bool Browser::Client::IPCHandleMessage(int fd) {
 
 		case IPC_MSG_PLUGINMESSAGE: {
 			BoltIPCPluginMessageHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
+			reader.Read(&header, sizeof(header));
 			uint8_t* content = new uint8_t[header.message_size];
-			_bolt_ipc_receive(fd, content, header.message_size);
+			reader.Read(content, header.message_size);
 			CefRefPtr<Browser::PluginWindow> window = this->GetExternalWindowFromFDAndIDs(client, header.plugin_id, header.window_id);
 			if (window) window->HandlePluginMessage(content, header.message_size);
 			delete[] content;
@@ -478,9 +789,9 @@ bool Browser::Client::IPCHandleMessage(int fd) {
 		}
 		case IPC_MSG_OSRPLUGINMESSAGE: {
 			BoltIPCPluginMessageHeader header;
-			_bolt_ipc_receive(fd, &header, sizeof(header));
+			reader.Read(&header, sizeof(header));
 			uint8_t* content = new uint8_t[header.message_size];
-			_bolt_ipc_receive(fd, content, header.message_size);
+			reader.Read(content, header.message_size);
 			CefRefPtr<Browser::WindowOSR> window = this->GetOsrWindowFromFDAndIDs(client, header.plugin_id, header.window_id);
 			if (window) window->HandlePluginMessage(content, header.message_size);
 			delete[] content;
@@ -495,9 +806,36 @@ bool Browser::Client::IPCHandleMessage(int fd) {
 }
 
 void Browser::Client::IPCHandleNoMoreClients() {
+	this->IPCDeleteTextureCache();
 	this->ipc_browser->GetMainFrame()->SendProcessMessage(PID_RENDERER, CefProcessMessage::Create("__bolt_no_more_clients"));
 }
 
+static CefRefPtr<CefDictionaryValue> PluginStatsDictionary(const BoltIPCPluginStats& stats, uint64_t interval_micros) {
+	// in the same order as BoltIPCPluginStat
+	constexpr const char* names[] = {"swapbuffers", "render2d", "render3d", "minimap", "mousemotion", "mousebutton", "mousebuttonup", "scroll"};
+	static_assert(std::size(names) == IPC_PLUGINSTAT_COUNT);
+	CefRefPtr<CefDictionaryValue> dict = CefDictionaryValue::Create();
+	CefRefPtr<CefListValue> callbacks = CefListValue::Create();
+	size_t index = 0;
+	for (size_t i = 0; i < IPC_PLUGINSTAT_COUNT; i += 1) {
+		const BoltIPCPluginCallbackStats& cb = stats.callbacks[i];
+		if (cb.calls == 0) continue;
+		CefRefPtr<CefDictionaryValue> cb_dict = CefDictionaryValue::Create();
+		cb_dict->SetString("name", names[i]);
+		cb_dict->SetDouble("calls", (double)cb.calls);
+		cb_dict->SetDouble("totalMicros", (double)cb.total_micros);
+		cb_dict->SetDouble("maxMicros", (double)cb.max_micros);
+		callbacks->SetDictionary(index, cb_dict);
+		index += 1;
+	}
+	dict->SetDouble("intervalMicros", (double)interval_micros);
+	dict->SetDouble("budgetMicros", (double)stats.budget_micros);
+	dict->SetInt("framesOverBudget", stats.frames_over_budget);
+	dict->SetInt("framesThrottled", stats.frames_throttled);
+	dict->SetList("callbacks", callbacks);
+	return dict;
+}
+
 void Browser::Client::ListGameClients(CefRefPtr<CefListValue> list, bool need_lock_mutex) {
 	if (need_lock_mutex) this->game_clients_lock.lock();
 	list->SetSize(std::count_if(this->game_clients.begin(), this->game_clients.end(), [](const GameClient& c){ return !c.deleted; }));
@@ -515,6 +853,7 @@ void Browser::Client::ListGameClients(CefRefPtr<CefListValue> list, bool need_lo
 			CefRefPtr<CefDictionaryValue> plugin_dict = CefDictionaryValue::Create();
 			plugin_dict->SetInt("uid", p->uid);
 			plugin_dict->SetString("id", CefString(p->id));
+			if (p->has_stats) plugin_dict->SetDictionary("stats", PluginStatsDictionary(p->stats, p->stats_interval_micros));
 			plugin_list->SetDictionary(plugin_list_index, plugin_dict);
 			plugin_list_index += 1;
 		}
@@ -533,10 +872,11 @@ void Browser::Client::StartPlugin(uint64_t client_id, std::string id, std::strin
 				if ((*it)->id != id) continue;
 				const BoltIPCMessageTypeToClient msg_type = IPC_MSG_HOST_STOPPED_PLUGIN;
 				const BoltIPCHostStoppedPluginHeader header = { .plugin_id = (*it)->uid };
-				this->send_lock.lock();
-				_bolt_ipc_send(g.fd, &msg_type, sizeof(msg_type));
-				_bolt_ipc_send(g.fd, &header, sizeof(header));
-				this->send_lock.unlock();
+				const BoltIPCBuffer buffers[] = {
+					{.data = &msg_type, .len = sizeof(msg_type)},
+					{.data = &header, .len = sizeof(header)},
+				};
+				g.send_queue->Send(buffers, std::size(buffers));
 				(*it)->deleted = true;
 				for (CefRefPtr<WindowOSR>& w: (*it)->windows_osr) {
 					w->Close();
@@ -570,13 +910,14 @@ void Browser::Client::StartPlugin(uint64_t client_id, std::string id, std::strin
 				.main_size = static_cast<uint32_t>(main.size()),
 				.config_path_size = static_cast<uint32_t>(config.size()),
 			};
-			this->send_lock.lock();
-			_bolt_ipc_send(g.fd, &msg_type, sizeof(msg_type));
-			_bolt_ipc_send(g.fd, &header, sizeof(header));
-			_bolt_ipc_send(g.fd, path.data(), path.size());
-			_bolt_ipc_send(g.fd, main.data(), main.size());
-			_bolt_ipc_send(g.fd, config.data(), config.size());
-			this->send_lock.unlock();
+			const BoltIPCBuffer buffers[] = {
+				{.data = &msg_type, .len = sizeof(msg_type)},
+				{.data = &header, .len = sizeof(header)},
+				{.data = path.data(), .len = path.size()},
+				{.data = main.data(), .len = main.size()},
+				{.data = config.data(), .len = config.size()},
+			};
+			g.send_queue->Send(buffers, std::size(buffers));
 			this->next_plugin_uid += 1;
 			break;
 		}
@@ -592,10 +933,11 @@ void Browser::Client::StopPlugin(uint64_t client_id, uint64_t uid) {
 				if ((*it)->uid != uid) continue;
 				const BoltIPCMessageTypeToClient msg_type = IPC_MSG_HOST_STOPPED_PLUGIN;
 				const BoltIPCHostStoppedPluginHeader header = { .plugin_id = (*it)->uid };
-				this->send_lock.lock();
-				_bolt_ipc_send(g.fd, &msg_type, sizeof(msg_type));
-				_bolt_ipc_send(g.fd, &header, sizeof(header));
-				this->send_lock.unlock();
+				const BoltIPCBuffer buffers[] = {
+					{.data = &msg_type, .len = sizeof(msg_type)},
+					{.data = &header, .len = sizeof(header)},
+				};
+				g.send_queue->Send(buffers, std::size(buffers));
 				(*it)->deleted = true;
 				for (CefRefPtr<PluginWindow>& w: (*it)->windows) {
 					w->Close();
@@ -613,6 +955,111 @@ void Browser::Client::StopPlugin(uint64_t client_id, uint64_t uid) {
 	this->game_clients_lock.unlock();
 }
 
+void Browser::Client::StartFrameTrace() {
+	std::scoped_lock _(this->game_clients_lock, this->frame_trace_lock);
+	if (this->frame_trace_running) return;
+	this->frame_trace_running = true;
+	this->frame_trace_id += 1;
+	_bolt_frametrace_start();
+	for (GameClient& g: this->game_clients) {
+		if (!g.deleted) this->SendFrameTrace(&g, true);
+	}
+	fmt::print("[I] frame trace started\n");
+}
+
+std::filesystem::path Browser::Client::StopFrameTrace() {
+	std::scoped_lock _(this->game_clients_lock, this->frame_trace_lock);
+	if (!this->frame_trace_running) return {};
+	this->frame_trace_running = false;
+	_bolt_frametrace_stop();
+
+	// anything still missing from the previous trace isn't coming now, since its clients will answer this one first
+	if (this->frame_trace_file.is_open()) this->FinishFrameTrace();
+	for (GameClient& g: this->game_clients) g.frame_trace_pending = false;
+	this->frame_trace_waiting = 0;
+
+	std::filesystem::path path = this->data_dir;
+	path.append(fmt::format("frame-trace-{}.json", static_cast<long long>(std::time(nullptr))));
+	this->frame_trace_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (this->frame_trace_file.fail()) {
+		fmt::print("[I] frame trace couldn't be written to {}\n", path.string());
+		this->frame_trace_file = std::ofstream();
+		return {};
+	}
+	this->frame_trace_path = path;
+	this->frame_trace_any_events = false;
+	this->frame_trace_file << "[\n";
+
+#if defined(_WIN32)
+	const uint32_t pid = (uint32_t)GetCurrentProcessId();
+#else
+	const uint32_t pid = (uint32_t)getpid();
+#endif
+	this->WriteFrameTraceProcessName(pid, "Bolt");
+	struct HostEvents { Browser::Client* client; uint32_t pid; } host_events = { .client = this, .pid = pid };
+	_bolt_frametrace_foreach([](const BoltFrameTraceEvent* event, void* userdata) {
+		const HostEvents* host_events = reinterpret_cast<HostEvents*>(userdata);
+		host_events->client->WriteFrameTraceEvent(host_events->pid, event->thread, event->name, event->start_micros, event->duration_micros);
+	}, &host_events);
+
+	for (GameClient& g: this->game_clients) {
+		if (g.deleted) continue;
+		this->SendFrameTrace(&g, false);
+		g.frame_trace_pending = true;
+		this->frame_trace_waiting += 1;
+	}
+	// the file is complete as far as Chrome's trace format is concerned even without the closing
+	// bracket, so it's flushed now in case some client never answers
+	this->frame_trace_file.flush();
+	if (!this->frame_trace_waiting) this->FinishFrameTrace();
+	return path;
+}
+
+// expects frame_trace_lock to be locked already, as do the other frame trace functions below
+void Browser::Client::SendFrameTrace(GameClient* client, bool running) {
+	const BoltIPCMessageTypeToClient msg_type = IPC_MSG_FRAMETRACE;
+	const BoltIPCFrameTraceHeader header = { .trace_id = this->frame_trace_id, .running = running };
+	const BoltIPCBuffer buffers[] = {
+		{.data = &msg_type, .len = sizeof(msg_type)},
+		{.data = &header, .len = sizeof(header)},
+	};
+	client->send_queue->Send(buffers, std::size(buffers));
+}
+
+// writes a string to a JSON file, escaping anything that needs it
+static void WriteJsonString(std::ofstream& file, std::string_view str) {
+	file << '"';
+	for (const char c: str) {
+		if (c == '"' || c == '\\') file << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20) file << fmt::format("\\u{:04x}", static_cast<int>(c));
+		else file << c;
+	}
+	file << '"';
+}
+
+void Browser::Client::WriteFrameTraceEvent(uint32_t pid, uint32_t thread, std::string_view name, uint64_t start_micros, uint64_t duration_micros) {
+	if (this->frame_trace_any_events) this->frame_trace_file << ",\n";
+	this->frame_trace_any_events = true;
+	this->frame_trace_file << fmt::format("{{\"ph\":\"X\",\"pid\":{},\"tid\":{},\"ts\":{},\"dur\":{},\"name\":", pid, thread, start_micros, duration_micros);
+	WriteJsonString(this->frame_trace_file, name);
+	this->frame_trace_file << '}';
+}
+
+void Browser::Client::WriteFrameTraceProcessName(uint32_t pid, std::string_view name) {
+	if (this->frame_trace_any_events) this->frame_trace_file << ",\n";
+	this->frame_trace_any_events = true;
+	this->frame_trace_file << fmt::format("{{\"ph\":\"M\",\"pid\":{},\"name\":\"process_name\",\"args\":{{\"name\":", pid);
+	WriteJsonString(this->frame_trace_file, name);
+	this->frame_trace_file << "}}";
+}
+
+void Browser::Client::FinishFrameTrace() {
+	if (!this->frame_trace_file.is_open()) return;
+	this->frame_trace_file << "\n]\n";
+	this->frame_trace_file.close();
+	fmt::print("[I] frame trace written to {}\n", this->frame_trace_path.string());
+}
+
 void Browser::Client::CleanupClientPlugins(int fd) {
 	this->game_clients_lock.lock();
 	for (auto it = this->game_clients.begin(); it != this->game_clients.end(); it += 1) {
@@ -659,6 +1106,6 @@ void Browser::Client::OnWindowCreated(CefRefPtr<CefWindow> window) {
 	window->AddChildView(this->ipc_view);
 }
 
-Browser::Client::ActivePlugin::ActivePlugin(uint64_t uid, std::string id, std::filesystem::path path, bool watch): Directory(path, watch), uid(uid), id(id), deleted(false) { }
+Browser::Client::ActivePlugin::ActivePlugin(uint64_t uid, std::string id, std::filesystem::path path, bool watch): Directory(path, watch), uid(uid), id(id), deleted(false), has_stats(false), stats_interval_micros(0) { }
 
 #endif
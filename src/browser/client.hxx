@@ -3,7 +3,10 @@
 #if defined(BOLT_PLUGINS)
 #include "window_plugin.hxx"
 #include "window_osr.hxx"
+#include "send_queue.hxx"
 #include "../library/ipc.h"
+#include <fstream>
+#include <string_view>
 #include <thread>
 #endif
 
@@ -30,6 +33,19 @@ typedef FileManager::Launcher CLIENT_FILEHANDLER;
 #endif
 
 namespace Browser {
+#if defined(BOLT_PLUGINS)
+	/// A game client's connection, as seen by the IPC thread, which is the only thing that uses it.
+	/// Nothing is ever received from a client with a blocking call: whatever has arrived is added to
+	/// `message`, and once it holds a whole message, that gets handled and the next one is started.
+	struct IPCConnection {
+		BoltSocketType fd;
+		std::vector<uint8_t> message; // sized to fit whatever's currently being received
+		size_t received; // bytes of `message` received so far
+		uint8_t stage; // what's being received: 0 for the type, 1 for the header, 2 for the tail
+		bool queued; // in the list of connections that still have more to read
+	};
+#endif
+
 	/// Implementation of CefClient, CefBrowserProcessHandler, CefLifeSpanHandler, CefRequestHandler.
 	/// https://github.com/chromiumembedded/cef/blob/5735/include/cef_client.h
 	/// https://github.com/chromiumembedded/cef/blob/5735/include/cef_browser_process_handler.h
@@ -69,6 +85,18 @@ namespace Browser {
 		/// Stops and joins the IPC thread - OS specific
 		void IPCStop();
 
+		/// Creates the connection used by IPCWake, returning the end that the IPC thread should poll
+		/// - OS-specific
+		BoltSocketType IPCCreateWakeup();
+
+		/// Wakes up the IPC thread if it's waiting, so that it'll write out any queued messages.
+		/// Thread-safe. OS-specific
+		void IPCWake();
+
+		/// Writes out as much as possible of every game client's send queue, without blocking.
+		/// Called by the IPC thread. Returns true if any client still has anything queued.
+		bool IPCWriteQueues();
+
 		/// Handles a new client connecting to the IPC socket. Called by the IPC thread.
 		void IPCHandleNewClient(int fd);
 
@@ -84,15 +112,33 @@ namespace Browser {
 		/// This is separate from IPCHandleClientListUpdate and must be called separately.
 		void IPCHandleNoMoreClients();
 
+		/// Deletes every object that game clients have added to the shared texture cache. Called by the
+		/// IPC thread once no clients are connected, so that nothing still has them open - OS-specific
+		void IPCDeleteTextureCache();
+
 		/// Lists all the game clients, in the format expected by the frontend, into the output list
 		void ListGameClients(CefRefPtr<CefListValue>, bool need_lock_mutex);
 
-		/// Handles a new message being sent to the IPC socket by a client. Called by the IPC thread.
-		/// The message hasn't actually been pulled from the socket yet when this function is called;
-		/// rather this function will pull it using ipc_receive from ipc.h.
+		/// Accepts a new client connection on the IPC socket. Returns nullptr on failure, after which
+		/// the IPC socket is unusable. Called by the IPC thread - OS-specific
+		IPCConnection* IPCAcceptConnection();
+
+		/// Closes a client connection and deletes it. Called by the IPC thread - OS-specific
+		void IPCDropConnection(IPCConnection*);
+
+		/// Receives whatever the client has sent so far, without blocking, handling every message
+		/// that's been fully received, up to a limit so that other clients get a turn. Sets `drained`
+		/// if everything available was read, otherwise this should be called again soon even if the
+		/// socket doesn't become readable. Called by the IPC thread.
+		///
+		/// Returns true on success, false if the connection should be dropped.
+		bool IPCReadConnection(IPCConnection*, bool* drained);
+
+		/// Handles a message that's been fully received from a client, made up of the message type,
+		/// header and tail, one after another. Called by the IPC thread.
 		///
 		/// Returns true on success, false on failure.
-		bool IPCHandleMessage(int fd);
+		bool IPCHandleMessage(int fd, const uint8_t* data, size_t length);
 
 		/// Sends an IPC message to the named client to start a plugin.
 		void StartPlugin(uint64_t client_id, std::string id, std::string path, std::string main);
@@ -100,6 +146,16 @@ namespace Browser {
 		/// Sends an IPC message to the named client to stop the named instance of a plugin.
 		void StopPlugin(uint64_t client_id, uint64_t uid);
 
+		/// Starts a frame trace in this process and in every game client, including any that connect
+		/// while it's running. See frametrace.h.
+		void StartFrameTrace();
+
+		/// Stops the frame trace, writes this process's part of it to a new file in the data directory,
+		/// and asks every game client for theirs, which get added to the file as they arrive. The file
+		/// is readable as soon as this returns, even if some clients never answer. Returns the path of
+		/// the file, or an empty path if no trace was running or the file couldn't be created.
+		std::filesystem::path StopFrameTrace();
+
 		/// Filters the list of plugins and their associated browsers for the client identified by the given fd,
 		/// to remove deleted plugins and browsers. Usually called when a browser is closed.
 		void CleanupClientPlugins(int fd);
@@ -163,6 +219,10 @@ namespace Browser {
 				bool deleted;
 				std::vector<CefRefPtr<Browser::PluginWindow>> windows;
 				std::vector<CefRefPtr<Browser::WindowOSR>> windows_osr;
+				// most recent callback timings reported by the client, if any yet
+				bool has_stats;
+				uint64_t stats_interval_micros;
+				BoltIPCPluginStats stats;
 
 				private:
 					IMPLEMENT_REFCOUNTING(ActivePlugin);
@@ -174,12 +234,22 @@ namespace Browser {
 				bool deleted;
 				// identity may be null if game hasn't reported its identity yet or display name is unset
 				char* identity;
+				// shm containing the two IPC rings, if the client offered them and they were accepted
+				void* ring_shm;
+				size_t ring_shm_size;
+				// set if the client can import shared textures; on POSIX this also needs the rings,
+				// since the texture's fds are sent on the socket alongside them
+				bool shared_textures;
+				// everything sent to this client goes through here, to be written by the IPC thread
+				CefRefPtr<SendQueue> send_queue;
+				// set if the frame trace being written is still waiting for this client's part of it
+				bool frame_trace_pending;
 
 				std::vector<CefRefPtr<ActivePlugin>> plugins;
 			};
-			std::mutex send_lock; // would be great to have this per-GameClient but C++ doesn't like that
 			std::thread ipc_thread;
 			BoltSocketType ipc_fd;
+			BoltSocketType ipc_wake_fd;
 			CefRefPtr<CefBrowserView> ipc_view;
 			CefRefPtr<CefWindow> ipc_window;
 			CefRefPtr<CefBrowser> ipc_browser;
@@ -187,9 +257,26 @@ namespace Browser {
 			uint64_t next_plugin_uid;
 			std::mutex game_clients_lock;
 			std::vector<GameClient> game_clients;
+			// IDs of the shared texture cache objects created by game clients, see BoltTextureCacheHeader.
+			// only used by the IPC thread
+			std::vector<uint64_t> texcache_ids;
 			CefRefPtr<Browser::PluginWindow> GetExternalWindowFromFDAndIDs(GameClient* client, uint64_t plugin_id, uint64_t window_id);
 			CefRefPtr<Browser::WindowOSR> GetOsrWindowFromFDAndIDs(GameClient* client, uint64_t plugin_id, uint64_t window_id);
 			CefRefPtr<ActivePlugin> GetPluginFromFDAndID(GameClient* client, uint64_t id);
+
+			// frame trace state, see StartFrameTrace and StopFrameTrace. protected by frame_trace_lock,
+			// which has to be locked after game_clients_lock if both are needed
+			std::mutex frame_trace_lock;
+			bool frame_trace_running;
+			uint32_t frame_trace_id; // incremented for each trace, so that a late answer to an old one can be ignored
+			std::ofstream frame_trace_file; // open until every client has sent its part, or the next trace stops
+			std::filesystem::path frame_trace_path;
+			bool frame_trace_any_events; // whether an event needs a separator before it
+			size_t frame_trace_waiting; // how many game clients have frame_trace_pending set
+			void SendFrameTrace(GameClient* client, bool running);
+			void WriteFrameTraceEvent(uint32_t pid, uint32_t thread, std::string_view name, uint64_t start_micros, uint64_t duration_micros);
+			void WriteFrameTraceProcessName(uint32_t pid, std::string_view name);
+			void FinishFrameTrace();
 #endif
 
 			// Mutex-locked - may be accessed from either UI thread (most of the time) or IO thread (GetResourceRequestHandler)
@@ -9,14 +9,22 @@
 #define OSPATH_PRINTF_STR "%ls\\"
 #else
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <unistd.h>
 #define OSPATH_PRINTF_STR "%s/"
 #endif
 
 #include <algorithm>
 #include <fmt/core.h>
 
+#if defined(_WIN32)
+// MSDN says we should use "DeleteFile or any other file delete API" instead of unlink
+#define unlink DeleteFileA
+#endif
+
 void Browser::Client::IPCBind() {
 #if defined(_WIN32)
     WSADATA wsa_data;
@@ -26,12 +34,7 @@ void Browser::Client::IPCBind() {
 	addr.sun_family = AF_UNIX;
 	snprintf(addr.sun_path, sizeof(addr.sun_path) - 1, OSPATH_PRINTF_STR "ipc-0", this->runtime_dir.c_str());
 	this->ipc_fd = socket(AF_UNIX, SOCK_STREAM, 0);
-#if defined(_WIN32)
-	// MSDN says we should use "DeleteFile or any other file delete API" instead of unlink
-	DeleteFileA(addr.sun_path);
-#else
 	unlink(addr.sun_path);
-#endif
 	if (bind(this->ipc_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
 		fmt::print("[B] error: IPC bind({}, {}) returned {}\n", this->ipc_fd, addr.sun_path, errno);
 	} else if (listen(this->ipc_fd, 16) == -1) {
@@ -39,78 +42,235 @@ void Browser::Client::IPCBind() {
 	}
 }
 
-void Browser::Client::IPCRun() {
+BoltSocketType Browser::Client::IPCCreateWakeup() {
+	// no socketpair() on windows, so connect to a temporary listening socket instead, which works
+	// the same everywhere. it can't be the main IPC socket, as a game might connect to that first.
+	struct sockaddr_un addr;
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path) - 1, OSPATH_PRINTF_STR "ipc-wake", this->runtime_dir.c_str());
+	unlink(addr.sun_path);
+	BoltSocketType listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	BoltSocketType read_fd = -1;
+	this->ipc_wake_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(listener, 1) == -1) {
+		fmt::print("[B] error: IPC wakeup bind/listen returned {}\n", errno);
+	} else if (connect(this->ipc_wake_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+		fmt::print("[B] error: IPC wakeup connect returned {}\n", errno);
+	} else {
+		read_fd = accept(listener, nullptr, nullptr);
+	}
+	close(listener);
+	unlink(addr.sun_path);
+	return read_fd;
+}
+
+void Browser::Client::IPCWake() {
+	const uint8_t byte = 0;
+#if defined(_WIN32)
+	send(this->ipc_wake_fd, (const char*)&byte, 1, 0);
+#else
+	// if the socket is full, the IPC thread has plenty of wakeups waiting already
+	send(this->ipc_wake_fd, &byte, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+#endif
+}
+
+// something that was reported by IPCPoller::Wait
+struct IPCEvent {
+	Browser::IPCConnection* connection;
+	bool readable; // if not set, it's an error or hangup
+};
+
+// waits on the IPC socket, the wakeup socket and all the client connections at once. on linux this
+// is epoll, with clients edge-triggered, so it's only ever told about sockets that have something
+// new. winsock has nothing like that for AF_UNIX sockets short of overlapped I/O throughout ipc.h,
+// so there it's WSAPoll over everything; reads never block either way, so no client holds up another.
+struct IPCPoller {
+#if defined(_WIN32)
 	std::vector<pollfd> pfds;
-	pfds.reserve(8);
-	// pfds[0] is the IPC socket itself, it's special and won't move or be removed
-	pfds.push_back({.fd = this->ipc_fd, .events = POLLIN});
-	while (true) {
-		int ready = poll(pfds.data(), pfds.size(), -1);
-		// ready=0 indicates a timeout which will probably never actually happen
-		if (ready == 0) continue;
-		if (ready == -1) {
-			fmt::print("[I] IPC thread exiting due to poll error {}\n", errno);
-			break;
+	std::vector<Browser::IPCConnection*> connections;
+
+	bool Add(Browser::IPCConnection* connection, bool edge_triggered) {
+		this->pfds.push_back({.fd = connection->fd, .events = POLLIN});
+		this->connections.push_back(connection);
+		return true;
+	}
+
+	void Remove(Browser::IPCConnection* connection) {
+		const auto it = std::find(this->connections.begin(), this->connections.end(), connection);
+		if (it == this->connections.end()) return;
+		this->pfds.erase(this->pfds.begin() + (it - this->connections.begin()));
+		this->connections.erase(it);
+	}
+
+	bool Wait(int timeout_ms, std::vector<IPCEvent>& events) {
+		if (poll(this->pfds.data(), this->pfds.size(), timeout_ms) == -1) return false;
+		for (size_t i = 0; i < this->pfds.size(); i += 1) {
+			if (this->pfds[i].revents == 0) continue;
+			events.push_back({.connection = this->connections[i], .readable = (this->pfds[i].revents & POLLIN) != 0});
 		}
+		return true;
+	}
+#else
+	int epoll_fd;
 
-		// check pfds[0] for new client connections
-		if (pfds[0].revents & POLLIN) {
-			BoltSocketType client_fd = 
+	IPCPoller(): epoll_fd(epoll_create1(EPOLL_CLOEXEC)) { }
+	~IPCPoller() { close(this->epoll_fd); }
+
+	bool Add(Browser::IPCConnection* connection, bool edge_triggered) {
+		epoll_event event = {.events = EPOLLIN | (edge_triggered ? EPOLLET : 0u), .data = {.ptr = connection}};
+		return epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, connection->fd, &event) == 0;
+	}
+
+	void Remove(Browser::IPCConnection* connection) {
+		epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, connection->fd, nullptr);
+	}
+
+	bool Wait(int timeout_ms, std::vector<IPCEvent>& events) {
+		epoll_event buf[64];
+		const int count = epoll_wait(this->epoll_fd, buf, std::size(buf), timeout_ms);
+		if (count == -1) return errno == EINTR;
+		for (int i = 0; i < count; i += 1) {
+			events.push_back({.connection = (Browser::IPCConnection*)buf[i].data.ptr, .readable = (buf[i].events & EPOLLIN) != 0});
+		}
+		return true;
+	}
+#endif
+};
+
+Browser::IPCConnection* Browser::Client::IPCAcceptConnection() {
+	BoltSocketType client_fd = 
 #if defined(_WIN32)
-				accept(this->ipc_fd, nullptr, nullptr);
+		accept(this->ipc_fd, nullptr, nullptr);
 #else
-				accept4(this->ipc_fd, nullptr, nullptr, SOCK_CLOEXEC);
+		accept4(this->ipc_fd, nullptr, nullptr, SOCK_CLOEXEC);
 #endif
-			if (client_fd == -1) {
-				fmt::print("[I] IPC thread exiting due to accept error {}\n", errno);
-				break;
-			}
-			pfds.push_back({.fd = client_fd, .events = POLLIN});
-			this->IPCHandleNewClient(client_fd);
-			this->IPCHandleClientListUpdate(true);
-		} else if (pfds[0].revents != 0) {
-			fmt::print("[I] IPC thread exiting due to poll event {}\n", pfds[0].revents);
+	if (client_fd == -1) {
+		fmt::print("[I] IPC thread exiting due to accept error {}\n", errno);
+		return nullptr;
+	}
+	IPCConnection* connection = new IPCConnection {
+		.fd = client_fd, .message = std::vector<uint8_t>(sizeof(BoltIPCMessageTypeToHost)), .received = 0, .stage = 0, .queued = false,
+	};
+	this->IPCHandleNewClient(client_fd);
+	this->IPCHandleClientListUpdate(true);
+	return connection;
+}
+
+void Browser::Client::IPCDropConnection(IPCConnection* connection) {
+	close(connection->fd);
+	this->IPCHandleClosed(connection->fd);
+	this->IPCHandleClientListUpdate(true);
+	delete connection;
+}
+
+void Browser::Client::IPCRun() {
+	IPCPoller poller;
+	// these two aren't client connections, they're just told apart from them by their address
+	IPCConnection listener = {.fd = this->ipc_fd};
+	IPCConnection wakeup = {.fd = this->IPCCreateWakeup()};
+	poller.Add(&listener, false);
+	poller.Add(&wakeup, false);
+
+	std::vector<IPCConnection*> connections;
+	std::vector<IPCConnection*> ready; // clients that still had more to read at the end of their last turn
+	std::vector<IPCConnection*> turn;
+	std::vector<IPCEvent> events;
+	bool writes_pending = false;
+	bool exiting = false;
+	while (!exiting) {
+		// if a client can't take everything we have for it yet, check back shortly, since clients
+		// using a ring have no way of telling us when there's room again. if a client has more to
+		// read, don't wait at all; the new events just get to join the queue.
+		events.clear();
+		if (!poller.Wait(ready.empty() ? (writes_pending ? 1 : -1) : 0, events)) {
+			fmt::print("[I] IPC thread exiting due to poll error {}\n", errno);
 			break;
 		}
 
-		// check the rest of the pollfds for incoming data
-		for (auto i = pfds.begin() + 1; i != pfds.end(); i += 1) {
-			if (i->revents != 0) {
-				uint8_t byte;
-				if (i->revents & POLLIN) {
-					if (!this->IPCHandleMessage(i->fd)) {
-						fmt::print("[I] dropping client fd {} due to read error or eof\n", i->fd);
-						close(i->fd);
-						this->IPCHandleClosed(i->fd);
-						this->IPCHandleClientListUpdate(true);
-						i->fd = 0;
-					}
-				} else {
-					fmt::print("[I] dropping client fd {} due to poll event {}\n", i->fd, i->revents);
-					close(i->fd);
-					this->IPCHandleClosed(i->fd);
-					this->IPCHandleClientListUpdate(true);
-					i->fd = 0;
+		turn.clear();
+		std::swap(turn, ready);
+		for (const IPCEvent& event: events) {
+			if (event.connection == &listener) {
+				if (!event.readable) {
+					fmt::print("[I] IPC thread exiting due to poll event on IPC socket\n");
+					exiting = true;
+					continue;
+				}
+				IPCConnection* connection = this->IPCAcceptConnection();
+				if (!connection) {
+					exiting = true;
+					continue;
 				}
+				if (!poller.Add(connection, true)) {
+					fmt::print("[I] dropping client fd {} due to poll error {}\n", connection->fd, errno);
+					this->IPCDropConnection(connection);
+					continue;
+				}
+				connections.push_back(connection);
+				// it may have sent something already, which an edge-triggered poller won't mention
+				connection->queued = true;
+				turn.push_back(connection);
+			} else if (event.connection == &wakeup) {
+				char buf[64];
+				recv(wakeup.fd, buf, sizeof(buf), 0);
+			} else if (!event.connection->queued) {
+				// a client using its ring only sends a wakeup when we're waiting, so its turn has to
+				// carry on until it's empty; ipc_try_receive then makes sure the next message wakes us up
+				event.connection->queued = true;
+				turn.push_back(event.connection);
 			}
 		}
-		pfds.erase(std::remove_if(pfds.begin(), pfds.end(), [](const pollfd& pfd) { return pfd.fd == 0; }), pfds.end());
-		if (pfds.size() == 1) {
-			// only the incoming IPC socket remains
-			this->IPCHandleNoMoreClients();
+
+		for (IPCConnection* connection: turn) {
+			connection->queued = false;
+			bool drained;
+			if (!this->IPCReadConnection(connection, &drained)) {
+				fmt::print("[I] dropping client fd {} due to read error or eof\n", connection->fd);
+				poller.Remove(connection);
+				connections.erase(std::find(connections.begin(), connections.end(), connection));
+				this->IPCDropConnection(connection);
+				if (connections.empty()) {
+					// only the incoming IPC socket and the wakeup socket remain
+					this->IPCHandleNoMoreClients();
+				}
+				continue;
+			}
+			if (!drained) {
+				connection->queued = true;
+				ready.push_back(connection);
+			}
 		}
+		writes_pending = this->IPCWriteQueues();
 	}
 
 	// between us closing our last FD and IPCStop() possibly being called, there might have been
 	// new connections, so we need to handle those by sending eof and closing them
-	for (auto i = pfds.begin() + 1; i != pfds.end(); i += 1) {
-		shutdown(i->fd, SHUT_RDWR);
-		close(i->fd);
+	for (IPCConnection* connection: connections) {
+		shutdown(connection->fd, SHUT_RDWR);
+		close(connection->fd);
+		delete connection;
 	}
+	// any clients still running keep their mappings, but new ones won't find these objects any more
+	this->IPCDeleteTextureCache();
+	close(wakeup.fd);
+	close(this->ipc_wake_fd);
+	this->ipc_wake_fd = -1;
 #if !defined(_WIN32)
 	// with winsock, the socket would've already been closed by this point
-	close(pfds[0].fd);
+	close(listener.fd);
+#endif
+}
+
+void Browser::Client::IPCDeleteTextureCache() {
+#if !defined(_WIN32)
+	// on Windows, these go away by themselves once no process has them open
+	char buf[256];
+	for (uint64_t id: this->texcache_ids) {
+		snprintf(buf, sizeof(buf), "/bolt-%i-tc-%lu", getpid(), id);
+		shm_unlink(buf);
+	}
 #endif
+	this->texcache_ids.clear();
 }
 
 void Browser::Client::IPCStop() {
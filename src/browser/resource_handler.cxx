@@ -2,6 +2,8 @@
 #include "include/cef_urlrequest.h"
 #include "include/internal/cef_types.h"
 
+#include <thread>
+
 // returns content-length or -1 if it's malformed or nonexistent
 // CEF interprets -1 as "unknown length"
 static int64_t GetContentLength(CefRefPtr<CefResponse> response) {
@@ -78,11 +80,51 @@ CefRefPtr<CefResourceHandler> Browser::ResourceHandler::GetResourceHandler(CefRe
 
 void Browser::ResourceHandler::finish() {
 	if (this->file_manager) {
-		this->file_manager->free(FileManager::File { .contents = this->data, .size = this->data_len, .mime_type = this->mime });
+		this->file_manager->free(this->file);
 		this->file_manager = nullptr;
 	}
 }
 
+bool Browser::AsyncResourceHandler::Open(CefRefPtr<CefRequest> request, bool& handle_request, CefRefPtr<CefCallback> callback) {
+	handle_request = false;
+	CefRefPtr<AsyncResourceHandler> self = this;
+	std::thread([self, request, callback]() {
+		CefRefPtr<CefResourceHandler> result = self->func()->GetResourceHandler(nullptr, nullptr, request);
+		bool handle_request;
+		result->Open(request, handle_request, nullptr);
+		self->lock.lock();
+		self->result = result;
+		const bool cancelled = self->cancelled;
+		self->lock.unlock();
+		if (cancelled) result->Cancel();
+		else callback->Continue();
+	}).detach();
+	return true;
+}
+
+void Browser::AsyncResourceHandler::GetResponseHeaders(CefRefPtr<CefResponse> response, int64_t& response_length, CefString& redirectUrl) {
+	this->result->GetResponseHeaders(response, response_length, redirectUrl);
+}
+
+bool Browser::AsyncResourceHandler::Read(void* data_out, int bytes_to_read, int& bytes_read, CefRefPtr<CefResourceReadCallback> callback) {
+	return this->result->Read(data_out, bytes_to_read, bytes_read, callback);
+}
+
+bool Browser::AsyncResourceHandler::Skip(int64_t bytes_to_skip, int64_t& bytes_skipped, CefRefPtr<CefResourceSkipCallback> callback) {
+	return this->result->Skip(bytes_to_skip, bytes_skipped, callback);
+}
+
+void Browser::AsyncResourceHandler::Cancel() {
+	// if func is still running, its result gets cancelled as soon as it's done instead
+	std::lock_guard<std::mutex> _(this->lock);
+	this->cancelled = true;
+	if (this->result) this->result->Cancel();
+}
+
+CefRefPtr<CefResourceHandler> Browser::AsyncResourceHandler::GetResourceHandler(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>, CefRefPtr<CefRequest>) {
+	return this;
+}
+
 Browser::DefaultURLHandler::DefaultURLHandler(CefRefPtr<CefRequest> request): urlrequest_complete(false), headers_checked(false), urlrequest_callback(nullptr), cursor(0) {
 	this->url_request = CefURLRequest::Create(request, this, nullptr);
 }
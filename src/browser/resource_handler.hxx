@@ -6,6 +6,8 @@
 #include "include/cef_base.h"
 #include "include/cef_resource_request_handler.h"
 #include "include/cef_urlrequest.h"
+#include <functional>
+#include <mutex>
 #include <string>
 
 namespace Browser {
@@ -29,7 +31,7 @@ namespace Browser {
 		
 		/// This constructor assumes the file does exist i.e. all params are initialised, and status will be 200
 		ResourceHandler(FileManager::File file, CefRefPtr<FileManager::FileManager> file_manager):
-			ResourceHandler(file.contents, file.size, 200, file.mime_type) { this->file_manager = file_manager; }
+			ResourceHandler(file.contents, file.size, 200, file.mime_type) { this->file = file; this->file_manager = file_manager; }
 
 		bool Open(CefRefPtr<CefRequest>, bool&, CefRefPtr<CefCallback>) override;
 		void GetResponseHeaders(CefRefPtr<CefResponse>, int64_t&, CefString&) override;
@@ -51,11 +53,36 @@ namespace Browser {
 			bool has_location;
 			size_t cursor;
 			const std::string internal_string;
+			FileManager::File file; // only used if file_manager is set, and passed back to it when finished
 			CefRefPtr<FileManager::FileManager> file_manager;
 			IMPLEMENT_REFCOUNTING(ResourceHandler);
 			DISALLOW_COPY_AND_ASSIGN(ResourceHandler);
 	};
 
+	/// Struct for handling a request on a new thread, for requests that do too much work to be handled
+	/// on CEF's IO thread, such as installing a game update. The response comes from whatever handler
+	/// `func` returns, so it can be written the same way as a normal request handler, as long as the
+	/// handler it returns responds straight away when opened, like ResourceHandler does.
+	struct AsyncResourceHandler: public CefResourceRequestHandler, CefResourceHandler {
+		AsyncResourceHandler(std::function<CefRefPtr<CefResourceRequestHandler>()> func): func(func), result(nullptr), cancelled(false) { }
+
+		bool Open(CefRefPtr<CefRequest>, bool&, CefRefPtr<CefCallback>) override;
+		void GetResponseHeaders(CefRefPtr<CefResponse>, int64_t&, CefString&) override;
+		bool Read(void*, int, int&, CefRefPtr<CefResourceReadCallback>) override;
+		bool Skip(int64_t, int64_t&, CefRefPtr<CefResourceSkipCallback>) override;
+		void Cancel() override;
+		CefRefPtr<CefResourceHandler> GetResourceHandler(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>, CefRefPtr<CefRequest>) override;
+
+		private:
+			std::function<CefRefPtr<CefResourceRequestHandler>()> func;
+			// result and cancelled are protected by this mutex, since func finishes on its own thread
+			std::mutex lock;
+			CefRefPtr<CefResourceHandler> result;
+			bool cancelled;
+			IMPLEMENT_REFCOUNTING(AsyncResourceHandler);
+			DISALLOW_COPY_AND_ASSIGN(AsyncResourceHandler);
+	};
+
 	/// Struct for bridging a CefURLRequestClient to a CefResourceHandler
 	/// https://github.com/chromiumembedded/cef/blob/5735/include/cef_resource_request_handler.h
 	/// https://github.com/chromiumembedded/cef/blob/5735/include/cef_resource_handler.h
@@ -0,0 +1,90 @@
+#if defined(BOLT_PLUGINS)
+#include "send_queue.hxx"
+
+Browser::SendQueue::SendQueue(BoltSocketType fd, std::function<void()> wake):
+	fd(fd), wake(wake), closed(false), writing_offset(0),
+	bytes_queued(0), peak_bytes_queued(0), bytes_written(0), messages(0), stalls(0) { }
+
+bool Browser::SendQueue::Send(const BoltIPCBuffer* buffers, size_t count) {
+	size_t total = 0;
+	for (size_t i = 0; i < count; i += 1) total += buffers[i].len;
+
+	this->lock.lock();
+	if (this->closed) {
+		this->lock.unlock();
+		return false;
+	}
+	const bool was_empty = this->bytes_queued == 0;
+	for (size_t i = 0; i < count; i += 1) {
+		const uint8_t* data = reinterpret_cast<const uint8_t*>(buffers[i].data);
+		this->pending.insert(this->pending.end(), data, data + buffers[i].len);
+	}
+	const uint64_t queued = this->bytes_queued += total;
+	if (queued > this->peak_bytes_queued) this->peak_bytes_queued = queued;
+	this->messages += 1;
+	this->lock.unlock();
+
+	if (was_empty) this->wake();
+	return true;
+}
+
+bool Browser::SendQueue::Write() {
+	while (true) {
+		if (this->writing_offset == this->writing.size()) {
+			this->writing.clear();
+			this->writing_offset = 0;
+			this->lock.lock();
+			std::swap(this->writing, this->pending);
+			this->lock.unlock();
+			if (this->writing.empty()) return true;
+		}
+		size_t sent;
+		if (_bolt_ipc_try_send(this->fd, this->writing.data() + this->writing_offset, this->writing.size() - this->writing_offset, &sent)) {
+			return false;
+		}
+		if (sent == 0) {
+			this->stalls += 1;
+			return true;
+		}
+		this->writing_offset += sent;
+		this->bytes_written += sent;
+		this->bytes_queued -= sent;
+	}
+}
+
+bool Browser::SendQueue::Flush() {
+	this->lock.lock();
+	this->writing.insert(this->writing.end(), this->pending.begin(), this->pending.end());
+	this->pending.clear();
+	this->lock.unlock();
+	const size_t remaining = this->writing.size() - this->writing_offset;
+	const bool ret = _bolt_ipc_send(this->fd, this->writing.data() + this->writing_offset, remaining) == 0;
+	this->bytes_written += remaining;
+	this->bytes_queued -= remaining;
+	this->writing.clear();
+	this->writing_offset = 0;
+	return ret;
+}
+
+bool Browser::SendQueue::HasPending() const {
+	return this->bytes_queued != 0;
+}
+
+void Browser::SendQueue::Close() {
+	std::lock_guard<std::mutex> _(this->lock);
+	this->closed = true;
+	this->bytes_queued -= this->pending.size();
+	this->pending.clear();
+}
+
+Browser::SendQueue::Stats Browser::SendQueue::GetStats() const {
+	return Stats {
+		.bytes_queued = this->bytes_queued,
+		.peak_bytes_queued = this->peak_bytes_queued,
+		.bytes_written = this->bytes_written,
+		.messages = this->messages,
+		.stalls = this->stalls,
+	};
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef _BOLT_SEND_QUEUE_HXX_
+#define _BOLT_SEND_QUEUE_HXX_
+#if defined(BOLT_PLUGINS)
+#include "../library/ipc.h"
+#include "include/cef_base.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace Browser {
+	/// Outgoing IPC messages for one game client. Any thread can call Send(), which only copies the
+	/// message into memory, then the IPC thread writes them out with Write() whenever the client is
+	/// able to take them. So a client that's slow to read never holds up anyone sending to another.
+	struct SendQueue: public CefBaseRefCounted {
+		/// Backpressure counters for one client
+		struct Stats {
+			uint64_t bytes_queued; // waiting to be written right now
+			uint64_t peak_bytes_queued; // highest value bytes_queued has ever had
+			uint64_t bytes_written;
+			uint64_t messages;
+			uint64_t stalls; // times Write() found the client unable to take any more
+		};
+
+		/// `wake` will be called, from whichever thread is sending, when the queue goes from empty to
+		/// non-empty, and must cause the IPC thread to call Write() soon after.
+		SendQueue(BoltSocketType fd, std::function<void()> wake);
+
+		/// Queues a message made up of these buffers, to be sent together in order. Thread-safe, and
+		/// never waits for the socket. Returns false if the queue has been closed.
+		bool Send(const BoltIPCBuffer* buffers, size_t count);
+
+		/// Writes as much as the client will currently take, without blocking. Must only be called
+		/// by the IPC thread. Returns false on error.
+		bool Write();
+
+		/// Writes everything that's been queued so far, blocking until it's done. Must only be called
+		/// by the IPC thread. Returns false on error.
+		bool Flush();
+
+		/// Returns true if there's anything that hasn't been written yet.
+		bool HasPending() const;
+
+		/// Discards anything still queued and makes all future calls to Send() fail. Thread-safe.
+		void Close();
+
+		Stats GetStats() const;
+
+		private:
+			BoltSocketType fd;
+			std::function<void()> wake;
+			bool closed;
+
+			// producers append to `pending` while holding `lock`; the IPC thread swaps it with
+			// `writing` when it's finished with that, so it never holds the lock while writing
+			mutable std::mutex lock;
+			std::vector<uint8_t> pending;
+			std::vector<uint8_t> writing;
+			size_t writing_offset;
+
+			std::atomic_uint64_t bytes_queued;
+			std::atomic_uint64_t peak_bytes_queued;
+			std::atomic_uint64_t bytes_written;
+			std::atomic_uint64_t messages;
+			std::atomic_uint64_t stalls;
+
+			IMPLEMENT_REFCOUNTING(SendQueue);
+			DISALLOW_COPY_AND_ASSIGN(SendQueue);
+	};
+}
+
+#endif
+#endif
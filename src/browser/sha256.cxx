@@ -0,0 +1,104 @@
+#include "sha256.hxx"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static constexpr uint32_t RotateRight(uint32_t x, int n) {
+	return (x >> n) | (x << (32 - n));
+}
+
+Browser::Sha256::Sha256(): state {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+}, block_size(0), total_size(0) { }
+
+void Browser::Sha256::Update(const void* data, size_t size) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	this->total_size += size;
+	if (this->block_size) {
+		const size_t count = std::min(size, sizeof(this->block) - this->block_size);
+		memcpy(this->block + this->block_size, bytes, count);
+		this->block_size += count;
+		bytes += count;
+		size -= count;
+		if (this->block_size < sizeof(this->block)) return;
+		this->Transform(this->block);
+		this->block_size = 0;
+	}
+	// whole blocks are hashed straight from the input, only the leftovers get copied
+	while (size >= sizeof(this->block)) {
+		this->Transform(bytes);
+		bytes += sizeof(this->block);
+		size -= sizeof(this->block);
+	}
+	memcpy(this->block, bytes, size);
+	this->block_size = size;
+}
+
+std::string Browser::Sha256::HexDigest() {
+	const uint64_t bit_count = this->total_size * 8;
+	uint8_t padding[72] = {0x80};
+	const size_t padding_size = ((this->block_size < 56) ? 56 : 120) - this->block_size;
+	for (size_t i = 0; i < 8; i += 1) {
+		padding[padding_size + i] = (uint8_t)(bit_count >> (56 - (i * 8)));
+	}
+	this->Update(padding, padding_size + 8);
+
+	constexpr char digits[] = "0123456789abcdef";
+	std::string ret(64, '0');
+	for (size_t i = 0; i < 32; i += 1) {
+		const uint8_t byte = (uint8_t)(this->state[i / 4] >> (24 - ((i % 4) * 8)));
+		ret[i * 2] = digits[byte >> 4];
+		ret[(i * 2) + 1] = digits[byte & 0xF];
+	}
+	return ret;
+}
+
+void Browser::Sha256::Transform(const uint8_t* block) {
+	uint32_t w[64];
+	for (size_t i = 0; i < 16; i += 1) {
+		w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[(i * 4) + 1] << 16) | ((uint32_t)block[(i * 4) + 2] << 8) | block[(i * 4) + 3];
+	}
+	for (size_t i = 16; i < 64; i += 1) {
+		const uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		const uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint32_t a = this->state[0], b = this->state[1], c = this->state[2], d = this->state[3];
+	uint32_t e = this->state[4], f = this->state[5], g = this->state[6], h = this->state[7];
+	for (size_t i = 0; i < 64; i += 1) {
+		const uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+		const uint32_t ch = (e & f) ^ (~e & g);
+		const uint32_t t1 = h + s1 + ch + K[i] + w[i];
+		const uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+		const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+		const uint32_t t2 = s0 + maj;
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	this->state[0] += a;
+	this->state[1] += b;
+	this->state[2] += c;
+	this->state[3] += d;
+	this->state[4] += e;
+	this->state[5] += f;
+	this->state[6] += g;
+	this->state[7] += h;
+}
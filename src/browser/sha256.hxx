@@ -0,0 +1,30 @@
+#ifndef _BOLT_SHA256_HXX_
+#define _BOLT_SHA256_HXX_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Browser {
+	/// Incremental SHA-256, for checking downloaded game files against the hash they were published
+	/// with. Data can be passed to Update in pieces of any size.
+	class Sha256 {
+		public:
+			Sha256();
+			void Update(const void* data, size_t size);
+
+			/// Finishes the hash and returns it as 64 lowercase hex digits. Update must not be called
+			/// after this.
+			std::string HexDigest();
+
+		private:
+			void Transform(const uint8_t* block);
+
+			uint32_t state[8];
+			uint8_t block[64];
+			size_t block_size;
+			uint64_t total_size;
+	};
+}
+
+#endif
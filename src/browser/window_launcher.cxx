@@ -3,6 +3,7 @@
 #include "include/internal/cef_types.h"
 #include "resource_handler.hxx"
 #include "request.hxx"
+#include "../library/frametrace.h"
 
 #include <fcntl.h>
 #include <fmt/core.h>
@@ -162,6 +163,8 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::GetResourceRequestHandle
 		99, 104, 101, 114, 45, 114, 101, 100, 105, 114, 101, 99, 116, 0
 	};
 
+	BOLT_FRAMETRACE_SCOPE(scope, "launcher:request");
+
 	// Parse URL
 	const std::string request_url = request->GetURL().ToString();
 	const std::string::size_type colon = request_url.find_first_of(':');
@@ -227,9 +230,14 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::GetResourceRequestHandle
 	// internal API endpoints - only allowed if it's a request from internal URL to internal URL
 	if (is_internal_target && is_internal_initiator) {
 
-		// instruction to launch RS3 .deb
+		// instruction to launch RS3 .deb - this may involve installing an update, so it's done on
+		// another thread, and likewise for the other launch requests that can install something
 		if (path == "/launch-rs3-deb") {
-			return this->LaunchRs3Deb(request, query);
+			CefRefPtr<Launcher> self = this;
+			return new Browser::AsyncResourceHandler([self, request, query = std::string(query)]() {
+				BOLT_FRAMETRACE_SCOPE(scope, "launcher:LaunchRs3Deb");
+				return self->LaunchRs3Deb(request, query);
+			});
 		}
 
 		// instruction to launch RS3 .exe
@@ -254,17 +262,29 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::GetResourceRequestHandle
 
 		// instruction to launch RuneLite.jar
 		if (path == "/launch-runelite-jar") {
-			return this->LaunchRuneliteJar(request, query, false);
+			CefRefPtr<Launcher> self = this;
+			return new Browser::AsyncResourceHandler([self, request, query = std::string(query)]() {
+				BOLT_FRAMETRACE_SCOPE(scope, "launcher:LaunchRuneliteJar");
+				return self->LaunchRuneliteJar(request, query, false);
+			});
 		}
 
 		// instruction to launch RuneLite.jar with --configure
 		if (path == "/launch-runelite-jar-configure") {
-			return this->LaunchRuneliteJar(request, query, true);
+			CefRefPtr<Launcher> self = this;
+			return new Browser::AsyncResourceHandler([self, request, query = std::string(query)]() {
+				BOLT_FRAMETRACE_SCOPE(scope, "launcher:LaunchRuneliteJar");
+				return self->LaunchRuneliteJar(request, query, true);
+			});
 		}
 
 		// instruction to launch RuneLite.jar
 		if (path == "/launch-hdos-jar") {
-			return this->LaunchHdosJar(request, query);
+			CefRefPtr<Launcher> self = this;
+			return new Browser::AsyncResourceHandler([self, request, query = std::string(query)]() {
+				BOLT_FRAMETRACE_SCOPE(scope, "launcher:LaunchHdosJar");
+				return self->LaunchHdosJar(request, query);
+			});
 		}
 
 		// instruction to save user config file to disk
@@ -371,6 +391,29 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::GetResourceRequestHandle
 #endif
 		}
 
+		// request to start a frame trace in Bolt and every connected game client
+		if (path == "/start-frame-trace") {
+#if defined(BOLT_PLUGINS)
+			this->client->StartFrameTrace();
+			QSENDOK();
+#else
+			QSENDNOTSUPPORTED();
+#endif
+		}
+
+		// request to stop the frame trace; responds with the path of the file it will be written to
+		if (path == "/stop-frame-trace") {
+#if defined(BOLT_PLUGINS)
+			const std::filesystem::path trace_path = this->client->StopFrameTrace();
+			if (trace_path.empty()) {
+				QSENDSTR("No frame trace running", 400);
+			}
+			return new Browser::ResourceHandler(trace_path.string(), 200, "text/plain");
+#else
+			QSENDNOTSUPPORTED();
+#endif
+		}
+
 		// instruction to try to open an external URL in the user's browser
 		if (path == "/open-external-url") {
 			CefRefPtr<CefPostData> post_data = request->GetPostData();
@@ -531,6 +574,16 @@ void Browser::Launcher::UpdateClientList(bool need_lock_mutex) const {
 }
 #endif
 
+void Browser::Launcher::UpdateInstallProgress(const char* name, int percent) const {
+	CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("__bolt_install_progress");
+	CefRefPtr<CefListValue> list = message->GetArgumentList();
+	list->SetSize(2);
+	list->SetString(0, name);
+	list->SetInt(1, percent);
+	CefRefPtr<CefBrowser> browser = this->browser;
+	if (browser) browser->GetMainFrame()->SendProcessMessage(PID_RENDERER, message);
+}
+
 void Browser::Launcher::Refresh() const {
 	// override the default behaviour, which would be to call ReloadIgnoreCache() (a.k.a. ctrl+f5)
 	// because if certain config files have changed, we need to set different URL params than before
@@ -41,6 +41,10 @@ namespace Browser {
 		void UpdateClientList(bool need_lock_client_mutex) const;
 #endif
 
+		/// Sends progress of installing a game update to the browser window via a postMessage.
+		/// `name` is shown to the user, and `percent` is from 0 to 100. Can be called from any thread.
+		void UpdateInstallProgress(const char* name, int percent) const;
+
 		void NotifyClosed() override;
 
 		/* 
@@ -1,13 +1,20 @@
 #include "window_launcher.hxx"
 #include "resource_handler.hxx"
 #include "request.hxx"
+#include "sha256.hxx"
 
+#include <algorithm>
 #include <archive.h>
 #include <archive_entry.h>
 #include <fcntl.h>
 #include <filesystem>
 #include <fmt/core.h>
+#include <memory>
 #include <spawn.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 // see #34 for why this function exists and why it can't be run between fork-exec or just run `env`.
 // true on success, false on failure, out is undefined on failure, you know the drill.
@@ -39,6 +46,150 @@ bool FindJava(const char* java_home, std::string& out) {
 	return false;
 }
 
+// files are extracted from the request body in chunks of this size, so that progress can be reported
+// as they're written
+constexpr size_t INSTALL_CHUNK_SIZE = 1 << 16;
+
+// a file being installed. it's written under a temporary name next to where it's going, then only
+// renamed into place by Commit(), so a failed install never leaves a half-written file where the
+// game expects a working one, and replacing the game binary works even while the game is running.
+// if it's never committed, the temporary file is deleted
+struct InstallFile {
+	InstallFile(const std::filesystem::path& path, mode_t mode): path(path), temp_path(path) {
+		this->temp_path += ".part";
+		this->fd = open(this->temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+	}
+
+	~InstallFile() {
+		if (this->fd != -1) {
+			close(this->fd);
+			unlink(this->temp_path.c_str());
+		}
+	}
+
+	bool IsOpen() const {
+		return this->fd != -1;
+	}
+
+	// writes `size` bytes at `offset` in the file, returning false on failure
+	bool Write(const void* data, size_t size, off_t offset) {
+		const char* bytes = reinterpret_cast<const char*>(data);
+		while (size) {
+			const ssize_t written = pwrite(this->fd, bytes, size, offset);
+			if (written == -1 && errno == EINTR) continue;
+			if (written <= 0) return false;
+			bytes += written;
+			size -= written;
+			offset += written;
+		}
+		return true;
+	}
+
+	// flushes the file to disk and moves it into place, returning false on failure
+	bool Commit() {
+		const bool synced = fsync(this->fd) == 0;
+		const bool closed = close(this->fd) == 0;
+		this->fd = -1;
+		if (synced && closed && rename(this->temp_path.c_str(), this->path.c_str()) == 0) return true;
+		unlink(this->temp_path.c_str());
+		return false;
+	}
+
+	std::filesystem::path path;
+	std::filesystem::path temp_path;
+	int fd;
+};
+
+// reports progress of an install to the launcher window, only sending a message when the percentage
+// actually changes, since there can be thousands of updates
+struct InstallProgress {
+	InstallProgress(const Browser::Launcher* launcher, const char* name, size_t total): launcher(launcher), name(name), total(total), percent(0) {
+		launcher->UpdateInstallProgress(name, 0);
+	}
+
+	void Update(size_t done) {
+		const int percent = this->total ? (int)((done * 100) / this->total) : 100;
+		if (percent == this->percent) return;
+		this->percent = percent;
+		this->launcher->UpdateInstallProgress(this->name, percent);
+	}
+
+	const Browser::Launcher* launcher;
+	const char* name;
+	size_t total;
+	int percent;
+};
+
+// an archive entry that another archive is being read out of, see ReadArchiveEntry
+struct ArchiveEntrySource {
+	struct archive* archive;
+	InstallProgress* progress;
+	const char* block;
+	size_t block_remaining;
+	size_t offset;
+};
+
+// libarchive read callback which reads from the current entry of another archive, so that an archive
+// inside an archive can be read straight out of it without being extracted first. an archive in
+// memory gives out each entry as one big block, so that gets handed on in chunks, otherwise the whole
+// thing would be decompressed before progress could be reported
+static la_ssize_t ReadArchiveEntry(struct archive*, void* userdata, const void** buffer) {
+	ArchiveEntrySource* source = reinterpret_cast<ArchiveEntrySource*>(userdata);
+	if (!source->block_remaining) {
+		const void* block;
+		size_t size;
+		la_int64_t offset;
+		const int r = archive_read_data_block(source->archive, &block, &size, &offset);
+		if (r == ARCHIVE_EOF) return 0;
+		if (r != ARCHIVE_OK) return -1;
+		source->block = reinterpret_cast<const char*>(block);
+		source->block_remaining = size;
+		source->offset = offset;
+	}
+	const size_t size = std::min(source->block_remaining, INSTALL_CHUNK_SIZE);
+	*buffer = source->block;
+	source->block += size;
+	source->block_remaining -= size;
+	source->offset += size;
+	source->progress->Update(source->offset);
+	return size;
+}
+
+// copies the current entry of `archive` into `file` a block at a time, returning false on failure,
+// either from the archive or from writing the file
+static bool ExtractEntry(struct archive* archive, InstallFile& file) {
+	const void* block;
+	size_t size;
+	la_int64_t offset;
+	while (true) {
+		const int r = archive_read_data_block(archive, &block, &size, &offset);
+		if (r == ARCHIVE_EOF) return true;
+		if (r != ARCHIVE_OK || !file.Write(block, size, offset)) return false;
+	}
+}
+
+// saves the contents of a POST body to `path` via an InstallFile, reporting progress under `name`.
+// the body has to be copied out of CEF in one go, but it's written out incrementally from there.
+// returns false on failure
+static bool InstallFromPost(const Browser::Launcher* launcher, CefRefPtr<CefPostDataElement> element, const std::filesystem::path& path, const char* name) {
+	const size_t size = element->GetBytesCount();
+	std::unique_ptr<unsigned char[]> data(new unsigned char[size]);
+	element->GetBytes(size, data.get());
+	InstallFile file(path, 0755);
+	if (!file.IsOpen()) return false;
+	InstallProgress progress(launcher, name, size);
+	for (size_t written = 0; written < size; written += INSTALL_CHUNK_SIZE) {
+		const size_t chunk = std::min(INSTALL_CHUNK_SIZE, size - written);
+		if (!file.Write(data.get() + written, chunk, written)) return false;
+		progress.Update(written + chunk);
+	}
+	return file.Commit();
+}
+
+static bool HashesMatch(std::string_view a, std::string_view b) {
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) { return tolower(x) == tolower(y); });
+}
+
 CefRefPtr<CefResourceRequestHandler> Browser::Launcher::LaunchRs3Deb(CefRefPtr<CefRequest> request, std::string_view query) {
 	/* strings that I don't want to be searchable, which also need to be mutable for passing to env functions */
 	// PULSE_PROP_OVERRIDE=
@@ -96,14 +247,23 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::LaunchRs3Deb(CefRefPtr<C
 		icons_dir.append("icons");
 		CefPostData::ElementVector vec;
 		post_data->GetElements(vec);
-		size_t deb_size = vec[0]->GetBytesCount();
-		unsigned char* deb = new unsigned char[deb_size];
-		vec[0]->GetBytes(deb_size, deb);
-
-		// use libarchive to extract data.tar.xz into memory from the supplied .deb (ar compression format)
+		const size_t deb_size = vec[0]->GetBytesCount();
+		std::unique_ptr<unsigned char[]> deb(new unsigned char[deb_size]);
+		vec[0]->GetBytes(deb_size, deb.get());
+
+		// the .deb is hashed on another thread while it's being extracted, and nothing gets moved into
+		// place unless it matches the hash the launcher got from the package list
+		std::string deb_hash;
+		std::jthread hash_thread([&deb_hash, &deb, deb_size]() {
+			Browser::Sha256 sha;
+			sha.Update(deb.get(), deb_size);
+			deb_hash = sha.HexDigest();
+		});
+
+		// use libarchive to find data.tar.xz in the supplied .deb (ar compression format)
 		struct archive* ar = archive_read_new();
 		archive_read_support_format_ar(ar);
-		archive_read_open_memory(ar, deb, deb_size);
+		archive_read_open_memory(ar, deb.get(), deb_size);
 		bool entry_found = false;
 		struct archive_entry* entry;
 		while (true) {
@@ -111,9 +271,7 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::LaunchRs3Deb(CefRefPtr<C
 			if (r == ARCHIVE_EOF) break;
 			if (r != ARCHIVE_OK) {
 				// POST data contained an invalid .deb file
-				archive_read_close(ar);
 				archive_read_free(ar);
-				delete[] deb;
 				QSENDSTR("Malformed .deb file", 400);
 			}
 			if (strcmp(archive_entry_pathname(entry), "data.tar.xz") == 0) {
@@ -123,36 +281,27 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::LaunchRs3Deb(CefRefPtr<C
 		}
 		if (!entry_found) {
 			// The .deb file is valid but does not contain "data.tar.xz" according to libarchive
-			archive_read_close(ar);
 			archive_read_free(ar);
-			delete[] deb;
 			QSENDSTR("No data in .deb file", 400);
 		}
 
-		const long entry_size = archive_entry_size(entry);
-		unsigned char* tar_xz = new unsigned char[entry_size];
-		long written = 0;
-		while (written < entry_size) {
-			written += archive_read_data(ar, tar_xz + written, entry_size - written);
-		}
-		archive_read_close(ar);
-		archive_read_free(ar);
-		delete[] deb;
-
-		// open data.tar.xz and extract any files into memory that we're interested in
+		// read data.tar.xz straight out of the .deb, decompressing it as it goes, and extract any files
+		// we're interested in to temporary files
+		InstallProgress progress(this, "RS3 client", archive_entry_size(entry));
+		ArchiveEntrySource source { .archive = ar, .progress = &progress, .block = nullptr, .block_remaining = 0, .offset = 0 };
 		struct archive* xz = archive_read_new();
 		archive_read_support_format_tar(xz);
 		archive_read_support_filter_xz(xz);
-		archive_read_open_memory(xz, tar_xz, entry_size);
-		entry_found = false;
+		archive_read_open(xz, &source, nullptr, ReadArchiveEntry, nullptr);
+		std::unique_ptr<InstallFile> game_file;
+		std::vector<std::unique_ptr<InstallFile>> icon_files;
 		while (true) {
 			int r = archive_read_next_header(xz, &entry);
 			if (r == ARCHIVE_EOF) break;
 			if (r != ARCHIVE_OK) {
 				// .deb file was valid but the data.tar.xz it contained was not
-				archive_read_close(xz);
 				archive_read_free(xz);
-				delete[] tar_xz;
+				archive_read_free(ar);
 				QSENDSTR("Malformed .tar.xz file", 400);
 			}
 
@@ -160,25 +309,13 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::LaunchRs3Deb(CefRefPtr<C
 			const size_t entry_pathname_len = strlen(entry_pathname);
 			if (strcmp(entry_pathname, tar_xz_inner_path) == 0) {
 				// found the game binary - we need to save this to disk so we can run it
-				entry_found = true;
-				const long game_size = archive_entry_size(entry);
-				char* game = new char[game_size];
-				written = 0;
-				while (written < game_size) {
-					written += archive_read_data(ar, game + written, game_size - written);
-				}
-				written = 0;
-				int file = open(this->rs3_elf_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0755);
-				if (file == -1) {
-					// failed to open game binary file on disk - probably in use or a permissions issue
-					delete[] game;
-					QSENDSTR("Failed to save executable; if the game is already running, close it and try again", 500);
-				}
-				while (written < game_size) {
-					written += write(file, game + written, game_size - written);
+				game_file = std::make_unique<InstallFile>(this->rs3_elf_path, 0755);
+				if (!game_file->IsOpen() || !ExtractEntry(xz, *game_file)) {
+					// failed to open or write game binary file on disk - probably a permissions issue
+					archive_read_free(xz);
+					archive_read_free(ar);
+					QSENDSTR("Failed to save executable", 500);
 				}
-				close(file);
-				delete[] game;
 			} else if (strncmp(entry_pathname, tar_xz_icons_path, strlen(tar_xz_icons_path)) == 0) {
 				// found an icon - save this to the icons directory, maintaining its relative path
 				std::filesystem::path icon_path = icons_dir;
@@ -186,39 +323,39 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::LaunchRs3Deb(CefRefPtr<C
 				if (entry_pathname[entry_pathname_len - 1] == '/') {
 					mkdir(icon_path.c_str(), 0755);
 				} else {
-					std::filesystem::path icon_path = icons_dir;
-					icon_path.append(entry_pathname + strlen(tar_xz_icons_path));
-					const long icon_size = archive_entry_size(entry);
-					char* icon = new char[icon_size];
-					written = 0;
-					while (written < icon_size) {
-						written += archive_read_data(ar, icon + written, icon_size - written);
-					}
-					written = 0;
-					int file = open(icon_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0755);
-					if (file == -1) {
+					std::unique_ptr<InstallFile> icon_file = std::make_unique<InstallFile>(icon_path, 0644);
+					if (icon_file->IsOpen() && ExtractEntry(xz, *icon_file)) {
+						icon_files.push_back(std::move(icon_file));
+					} else {
 						// failing to save an icon is not a fatal error, but probably something the
 						// user should know about
 						fmt::print("[B] [warning] failed to save an icon: {}\n", icon_path.c_str());
-					} else {
-						while (written < icon_size) {
-							written += write(file, icon + written, icon_size - written);
-						}
-						close(file);
-						delete[] icon;
 					}
 				}
 			}
 		}
 
-		archive_read_close(xz);
 		archive_read_free(xz);
-		delete[] tar_xz;
+		archive_read_free(ar);
 
-		if (!entry_found) {
+		if (!game_file) {
 			// data.tar.xz was valid but did not contain a game binary according to libarchive
 			QSENDSTR("No target executable in .tar.xz file", 400);
 		}
+
+		hash_thread.join();
+		if (!HashesMatch(deb_hash, hash)) {
+			fmt::print("[B] .deb file has hash {}, expected {}\n", deb_hash, hash);
+			QSENDSTR("Downloaded .deb file does not match its hash", 400);
+		}
+		if (!game_file->Commit()) {
+			QSENDSTR("Failed to save executable", 500);
+		}
+		for (const std::unique_ptr<InstallFile>& icon_file: icon_files) {
+			if (!icon_file->Commit()) {
+				fmt::print("[B] [warning] failed to save an icon: {}\n", icon_file->path.c_str());
+			}
+		}
 	}
 
 	// setup argv for the new process
@@ -321,22 +458,10 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::LaunchRuneliteJar(CefRef
 			QSENDBADREQUESTIF(post_data == nullptr || post_data->GetElementCount() != 1);
 			CefPostData::ElementVector vec;
 			post_data->GetElements(vec);
-			size_t jar_size = vec[0]->GetBytesCount();
-			unsigned char* jar = new unsigned char[jar_size];
-			vec[0]->GetBytes(jar_size, jar);
-
-			size_t written = 0;
-			int file = open(rl_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0755);
-			if (file == -1) {
-				// failed to open game binary file on disk - probably in use or a permissions issue
-				delete[] jar;
-				QSENDSTR("Failed to save JAR; if the game is already running, close it and try again", 500);
+			if (!InstallFromPost(this, vec[0], rl_path, "RuneLite")) {
+				// failed to save game binary file on disk - probably a permissions issue
+				QSENDSTR("Failed to save JAR", 500);
 			}
-			while (written < jar_size) {
-				written += write(file, jar + written, jar_size - written);
-			}
-			close(file);
-			delete[] jar;
 		}
 	}
 
@@ -424,22 +549,10 @@ CefRefPtr<CefResourceRequestHandler> Browser::Launcher::LaunchHdosJar(CefRefPtr<
 		QSENDBADREQUESTIF(post_data == nullptr || post_data->GetElementCount() != 1);
 		CefPostData::ElementVector vec;
 		post_data->GetElements(vec);
-		size_t jar_size = vec[0]->GetBytesCount();
-		unsigned char* jar = new unsigned char[jar_size];
-		vec[0]->GetBytes(jar_size, jar);
-
-		size_t written = 0;
-		int file = open(this->hdos_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0755);
-		if (file == -1) {
-			// failed to open game binary file on disk - probably in use or a permissions issue
-			delete[] jar;
-			QSENDSTR("Failed to save JAR; if the game is already running, close it and try again", 500);
-		}
-		while (written < jar_size) {
-			written += write(file, jar + written, jar_size - written);
+		if (!InstallFromPost(this, vec[0], this->hdos_path, "HDOS")) {
+			// failed to save game binary file on disk - probably a permissions issue
+			QSENDSTR("Failed to save JAR", 500);
 		}
-		close(file);
-		delete[] jar;
 	}
 
 	// set up argv for the new process
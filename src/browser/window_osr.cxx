@@ -11,35 +11,92 @@
 #include <fcntl.h>
 #endif
 
+#include <algorithm>
 #include <fmt/core.h>
 #include "client.hxx"
 #include "resource_handler.hxx"
 #include "../library/event.h"
+#include "../library/frametrace.h"
 
-static void SendUpdateMsg(BoltSocketType fd, std::mutex* send_lock, uint64_t id, int width, int height, void* needs_remap, const CefRect* rects, uint32_t rect_count) {
-	const BoltIPCMessageTypeToClient msg_type = IPC_MSG_OSRUPDATE;
-	const BoltIPCOsrUpdateHeader header = { .rect_count = rect_count, .window_id = id, .needs_remap = needs_remap, .width = width, .height = height };
-	send_lock->lock();
-	_bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-	_bolt_ipc_send(fd, &header, sizeof(header));
+static std::vector<BoltIPCOsrUpdateRect> IPCRects(const CefRect* rects, uint32_t rect_count) {
+	std::vector<BoltIPCOsrUpdateRect> ipc_rects;
+	ipc_rects.reserve(rect_count);
 	for (uint32_t i = 0; i < rect_count; i += 1) {
-		const BoltIPCOsrUpdateRect rect = { .x = rects[i].x, .y = rects[i].y, .w = rects[i].width, .h = rects[i].height };
-		_bolt_ipc_send(fd, &rect, sizeof(rect));
+		ipc_rects.push_back({ .x = rects[i].x, .y = rects[i].y, .w = rects[i].width, .h = rects[i].height });
 	}
-	send_lock->unlock();
+	return ipc_rects;
+}
+
+static void SendUpdateMsg(Browser::SendQueue* send_queue, uint64_t id, uint8_t buffer, uint64_t generation, int width, int height, void* needs_remap, const CefRect* rects, uint32_t rect_count) {
+	const BoltIPCMessageTypeToClient msg_type = IPC_MSG_OSRUPDATE;
+	const BoltIPCOsrUpdateHeader header = {
+		.rect_count = rect_count, .window_id = id, .needs_remap = needs_remap, .width = width, .height = height,
+		.generation = generation, .buffer = buffer,
+	};
+	const std::vector<BoltIPCOsrUpdateRect> ipc_rects = IPCRects(rects, rect_count);
+	const BoltIPCBuffer buffers[] = {
+		{.data = &msg_type, .len = sizeof(msg_type)},
+		{.data = &header, .len = sizeof(header)},
+		{.data = ipc_rects.data(), .len = ipc_rects.size() * sizeof(BoltIPCOsrUpdateRect)},
+	};
+	send_queue->Send(buffers, std::size(buffers));
+}
+
+static void SendPopupUpdateMsg(Browser::SendQueue* send_queue, uint64_t id, uint64_t generation, int width, int height, void* needs_remap, const CefRect* rects, uint32_t rect_count) {
+	const BoltIPCMessageTypeToClient msg_type = IPC_MSG_OSRPOPUPUPDATE;
+	const BoltIPCOsrPopupUpdateHeader header = {
+		.rect_count = rect_count, .window_id = id, .needs_remap = needs_remap, .width = width, .height = height,
+		.generation = generation,
+	};
+	const std::vector<BoltIPCOsrUpdateRect> ipc_rects = IPCRects(rects, rect_count);
+	const BoltIPCBuffer buffers[] = {
+		{.data = &msg_type, .len = sizeof(msg_type)},
+		{.data = &header, .len = sizeof(header)},
+		{.data = ipc_rects.data(), .len = ipc_rects.size() * sizeof(BoltIPCOsrUpdateRect)},
+	};
+	send_queue->Send(buffers, std::size(buffers));
+}
+
+// copies one rect of a CEF paint buffer into a frame of the same size
+static void CopyRect(void* frame, const void* buffer, int width, const CefRect& rect) {
+	const size_t row_length = (size_t)width * 4;
+	for (int y = rect.y; y < rect.y + rect.height; y += 1) {
+		const size_t offset = (y * row_length) + (rect.x * 4);
+		memcpy((uint8_t*)frame + offset, (const uint8_t*)buffer + offset, rect.width * 4);
+	}
+}
+
+static CefRect UnionRects(const CefRect& a, const CefRect& b) {
+	const int x1 = std::min(a.x, b.x);
+	const int y1 = std::min(a.y, b.y);
+	const int x2 = std::max(a.x + a.width, b.x + b.width);
+	const int y2 = std::max(a.y + a.height, b.y + b.height);
+	return CefRect(x1, y1, x2 - x1, y2 - y1);
 }
 
-Browser::WindowOSR::WindowOSR(CefString url, int width, int height, BoltSocketType client_fd, Browser::Client* main_client, std::mutex* send_lock, int pid, uint64_t window_id, uint64_t plugin_id, CefRefPtr<FileManager::Directory> file_manager):
-	PluginRequestHandler(IPC_MSG_OSRBROWSERMESSAGE, send_lock),
+static CefRect BoundingRect(const CefRenderHandler::RectList& rects) {
+	CefRect ret = rects[0];
+	for (size_t i = 1; i < rects.size(); i += 1) ret = UnionRects(ret, rects[i]);
+	return ret;
+}
+
+Browser::WindowOSR::WindowOSR(CefString url, int width, int height, BoltSocketType client_fd, Browser::Client* main_client, CefRefPtr<SendQueue> send_queue, int pid, uint64_t window_id, uint64_t plugin_id, CefRefPtr<FileManager::Directory> file_manager, bool shared_texture):
+	PluginRequestHandler(IPC_MSG_OSRBROWSERMESSAGE, send_queue),
 	deleted(false), pending_delete(false), client_fd(client_fd), width(width), height(height), browser(nullptr), window_id(window_id),
-	plugin_id(plugin_id), main_client(main_client), stored(nullptr), remote_has_remapped(false), remote_is_idle(true), file_manager(file_manager)
+	plugin_id(plugin_id), main_client(main_client), frame_width(width), frame_height(height), back_buffer(0), generation(0),
+	has_pending_damage(false), repaint_on_ack(false), remote_has_remapped(false), remote_is_idle(true), file_manager(file_manager),
+	popup_file(nullptr), popup_mapping_size(0), popup_frame_width(0), popup_frame_height(0), popup_generation(0),
+	popup_repaint_on_ack(false), popup_remote_has_remapped(false), popup_remote_is_idle(true),
+	shared_texture(false), popup_width(0), popup_height(0)
 {
-	this->mapping_size = (size_t)width * (size_t)height * 4;
+	this->mapping_size = (size_t)width * (size_t)height * 4 * BOLT_IPC_OSR_BUFFER_COUNT;
+	for (CefRect& stale: this->stale_damage) stale.Set(0, 0, width, height);
 
 #if defined(_WIN32)
 	this->shm = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)this->mapping_size, NULL);
 	this->target_process = OpenProcess(PROCESS_DUP_HANDLE, 0, pid);
 	this->file = MapViewOfFile(this->shm, FILE_MAP_WRITE, 0, 0, this->mapping_size);
+	this->popup_shm = NULL; // created on first paint, when the size is known
 #else
 	char buf[256];
 	snprintf(buf, sizeof(buf), "/bolt-%i-eb-%lu", pid, window_id);
@@ -52,12 +109,20 @@ Browser::WindowOSR::WindowOSR(CefString url, int width, int height, BoltSocketTy
 	if (this->file == MAP_FAILED) {
 		fmt::print("[B] WindowOSR(): mmap error {}\n", errno);
 	}
+	snprintf(buf, sizeof(buf), "/bolt-%i-ep-%lu", pid, window_id);
+	this->popup_shm = shm_open(buf, O_RDWR, 644);
+	shm_unlink(buf);
 #endif
 
 	CefWindowInfo window_info;
 	window_info.bounds.width = width;
 	window_info.bounds.height = height;
 	window_info.SetAsWindowless(0);
+#if CEF_VERSION_MAJOR >= 124
+	// older versions of CEF only have shared textures on Windows, and don't give out NT handles
+	this->shared_texture = shared_texture;
+	window_info.shared_texture_enabled = shared_texture;
+#endif
 	CefBrowserSettings browser_settings;
 	browser_settings.background_color = CefColorSetARGB(0, 0, 0, 0);
 	CefBrowserHost::CreateBrowser(window_info, this, CefString(url), browser_settings, nullptr, nullptr);
@@ -98,50 +163,169 @@ CefRefPtr<CefBrowser> Browser::WindowOSR::Browser() const {
 void Browser::WindowOSR::HandlePluginCloseRequest() {
 	BoltIPCMessageTypeToClient msg_type = IPC_MSG_OSRCLOSEREQUEST;
 	BoltIPCOsrCloseRequestHeader header = { .window_id = this->window_id };
-	this->send_lock->lock();
-	_bolt_ipc_send(this->client_fd, &msg_type, sizeof(msg_type));
-	_bolt_ipc_send(this->client_fd, &header, sizeof(header));
-	this->send_lock->unlock();
+	const BoltIPCBuffer buffers[] = {
+		{.data = &msg_type, .len = sizeof(msg_type)},
+		{.data = &header, .len = sizeof(header)},
+	};
+	this->send_queue->Send(buffers, std::size(buffers));
 }
 
 void Browser::WindowOSR::SendCaptureDone() const {
 	const BoltIPCMessageTypeToClient msg_type = IPC_MSG_OSRCAPTUREDONE;
 	const BoltIPCOsrCaptureDoneHeader header = { .window_id = this->WindowID() };
-	this->send_lock->lock();
-	_bolt_ipc_send(this->client_fd, &msg_type, sizeof(msg_type));
-	_bolt_ipc_send(this->client_fd, &header, sizeof(header));
-	this->send_lock->unlock();
+	const BoltIPCBuffer buffers[] = {
+		{.data = &msg_type, .len = sizeof(msg_type)},
+		{.data = &header, .len = sizeof(header)},
+	};
+	this->send_queue->Send(buffers, std::size(buffers));
 }
 
-void Browser::WindowOSR::HandleAck() {
+void Browser::WindowOSR::HandleAck(uint64_t generation, bool is_popup) {
 	if (this->deleted) return;
-	this->stored_lock.lock();
-	if (this->stored) {
-		const size_t length = this->stored_width * this->stored_height * 4;
-		void* needs_remap = length != this->mapping_size ? (void*)1 : (void*)0;
-		if (needs_remap) {
+	this->frame_lock.lock();
+	if (is_popup) {
+		if (generation != this->popup_generation) {
+			this->frame_lock.unlock();
+			return;
+		}
+		this->popup_remote_is_idle = true;
+		const bool repaint = this->popup_repaint_on_ack;
+		this->popup_repaint_on_ack = false;
+		this->frame_lock.unlock();
+		if (repaint && this->browser) this->browser->GetHost()->Invalidate(PET_POPUP);
+		return;
+	}
+	if (generation != this->generation) {
+		// not an ack for the most recent update, so the remote must still be reading that
+		this->frame_lock.unlock();
+		return;
+	}
+	this->remote_is_idle = true;
+	if (this->repaint_on_ack) {
+		// size changed while the remote was busy; now it's not, so get CEF to paint the whole thing again
+		this->repaint_on_ack = false;
+		this->has_pending_damage = false;
+		this->frame_lock.unlock();
+		if (this->browser) this->browser->GetHost()->Invalidate(PET_VIEW);
+		return;
+	}
+	if (this->has_pending_damage) {
+		// the back buffer is already up to date, so just hand it over
+		this->SendFrame(&this->pending_damage, 1);
+		this->has_pending_damage = false;
+	}
+	this->frame_lock.unlock();
+}
+
+void Browser::WindowOSR::SendFrame(const CefRect* rects, size_t rect_count) {
+	void* needs_remap = nullptr;
+	if (!this->remote_has_remapped) {
 #if defined(_WIN32)
-			UnmapViewOfFile(this->file);
-			CloseHandle(this->shm);
-			this->shm = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)length, NULL);
-			this->file = MapViewOfFile(this->shm, FILE_MAP_WRITE, 0, 0, length);
-			DuplicateHandle(GetCurrentProcess(), this->shm, this->target_process, (LPHANDLE)&needs_remap, 0, false, DUPLICATE_SAME_ACCESS);
+		DuplicateHandle(GetCurrentProcess(), this->shm, this->target_process, (LPHANDLE)&needs_remap, 0, false, DUPLICATE_SAME_ACCESS);
 #else
-			if (ftruncate(this->shm, length)) {
-				fmt::print("[B] OnPaint: ftruncate error {}\n", errno);
-			}
-			this->file = mremap(this->file, this->mapping_size, length, MREMAP_MAYMOVE);
+		needs_remap = (void*)1;
 #endif
-			this->mapping_size = length;
-		}
-		memcpy(this->file, this->stored, length);
-		SendUpdateMsg(this->client_fd, this->send_lock, this->window_id, this->stored_width, this->stored_height, needs_remap, &this->stored_damage, 1);
-		::free(this->stored);
-		this->stored = nullptr;
-	} else {
-		this->remote_is_idle = true;
 	}
-	this->stored_lock.unlock();
+	this->generation += 1;
+	SendUpdateMsg(this->send_queue.get(), this->window_id, this->back_buffer, this->generation, this->frame_width, this->frame_height, needs_remap, rects, rect_count);
+	this->remote_has_remapped = true;
+	this->remote_is_idle = false;
+	this->back_buffer ^= 1;
+}
+
+void Browser::WindowOSR::CopyToBackBuffer(const void* buffer, const CefRect& rect) {
+	const size_t frame_length = (size_t)this->frame_width * (size_t)this->frame_height * 4;
+	CopyRect((uint8_t*)this->file + (this->back_buffer * frame_length), buffer, this->frame_width, rect);
+}
+
+void Browser::WindowOSR::ResizeFrames(int width, int height) {
+	const size_t length = (size_t)width * (size_t)height * 4 * BOLT_IPC_OSR_BUFFER_COUNT;
+#if defined(_WIN32)
+	UnmapViewOfFile(this->file);
+	CloseHandle(this->shm);
+	this->shm = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)length, NULL);
+	this->file = MapViewOfFile(this->shm, FILE_MAP_WRITE, 0, 0, length);
+#else
+	if (ftruncate(this->shm, length)) {
+		fmt::print("[B] ResizeFrames: ftruncate error {}\n", errno);
+	}
+	this->file = mremap(this->file, this->mapping_size, length, MREMAP_MAYMOVE);
+#endif
+	this->mapping_size = length;
+	this->frame_width = width;
+	this->frame_height = height;
+	// the remote has to map the new object (or new size) before reading from it
+	this->remote_has_remapped = false;
+	for (CefRect& stale: this->stale_damage) stale.Set(0, 0, width, height);
+}
+
+void Browser::WindowOSR::PaintPopup(const RectList& rects, const void* buffer, int width, int height) {
+	this->frame_lock.lock();
+	if (!this->popup_remote_is_idle) {
+		this->popup_repaint_on_ack = true;
+		this->frame_lock.unlock();
+		return;
+	}
+	const bool resized = width != this->popup_frame_width || height != this->popup_frame_height;
+	if (resized && !this->ResizePopupFrame(width, height)) {
+		this->frame_lock.unlock();
+		return;
+	}
+
+	// nothing in a newly-sized frame is valid yet, so in that case all of it gets copied and sent
+	const CefRect whole(0, 0, width, height);
+	const CefRect* send_rects = resized ? &whole : rects.data();
+	const size_t send_count = resized ? 1 : rects.size();
+	for (size_t i = 0; i < send_count; i += 1) CopyRect(this->popup_file, buffer, width, send_rects[i]);
+
+	void* needs_remap = nullptr;
+	if (!this->popup_remote_has_remapped) {
+#if defined(_WIN32)
+		DuplicateHandle(GetCurrentProcess(), this->popup_shm, this->target_process, (LPHANDLE)&needs_remap, 0, false, DUPLICATE_SAME_ACCESS);
+#else
+		needs_remap = (void*)1;
+#endif
+	}
+	this->popup_generation += 1;
+	SendPopupUpdateMsg(this->send_queue.get(), this->window_id, this->popup_generation, width, height, needs_remap, send_rects, send_count);
+	this->popup_remote_has_remapped = true;
+	this->popup_remote_is_idle = false;
+	this->frame_lock.unlock();
+}
+
+bool Browser::WindowOSR::ResizePopupFrame(int width, int height) {
+	const size_t length = (size_t)width * (size_t)height * 4;
+#if defined(_WIN32)
+	if (this->popup_file) UnmapViewOfFile(this->popup_file);
+	if (this->popup_shm) CloseHandle(this->popup_shm);
+	this->popup_shm = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)length, NULL);
+	this->popup_file = this->popup_shm ? MapViewOfFile(this->popup_shm, FILE_MAP_WRITE, 0, 0, length) : nullptr;
+	if (!this->popup_file) {
+		fmt::print("[B] ResizePopupFrame: mapping error {}\n", GetLastError());
+		this->popup_mapping_size = 0;
+		this->popup_frame_width = 0;
+		this->popup_frame_height = 0;
+		return false;
+	}
+#else
+	if (ftruncate(this->popup_shm, length)) {
+		fmt::print("[B] ResizePopupFrame: ftruncate error {}\n", errno);
+		return false;
+	}
+	void* file = this->popup_file
+		? mremap(this->popup_file, this->popup_mapping_size, length, MREMAP_MAYMOVE)
+		: mmap(nullptr, length, PROT_WRITE, MAP_SHARED, this->popup_shm, 0);
+	if (file == MAP_FAILED) {
+		fmt::print("[B] ResizePopupFrame: mmap error {}\n", errno);
+		return false;
+	}
+	this->popup_file = file;
+#endif
+	this->popup_mapping_size = length;
+	this->popup_frame_width = width;
+	this->popup_frame_height = height;
+	this->popup_remote_has_remapped = false;
+	return true;
 }
 
 void Browser::WindowOSR::HandleReposition(const RepositionEvent* event) {
@@ -244,105 +428,133 @@ void Browser::WindowOSR::GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rec
 void Browser::WindowOSR::OnPopupShow(CefRefPtr<CefBrowser> browser, bool show) {
 	const BoltIPCMessageTypeToClient msg_type = IPC_MSG_OSRPOPUPVISIBILITY;
 	const BoltIPCOsrPopupVisibilityHeader header = { .window_id = this->WindowID(), .visible = show };
-	this->send_lock->lock();
-	_bolt_ipc_send(this->client_fd, &msg_type, sizeof(msg_type));
-	_bolt_ipc_send(this->client_fd, &header, sizeof(header));
-	this->send_lock->unlock();
+	const BoltIPCBuffer buffers[] = {
+		{.data = &msg_type, .len = sizeof(msg_type)},
+		{.data = &header, .len = sizeof(header)},
+	};
+	this->send_queue->Send(buffers, std::size(buffers));
 }
 
 void Browser::WindowOSR::OnPopupSize(CefRefPtr<CefBrowser> browser, const CefRect& rect) {
-	// Despite the function name, we don't actually use the size from here at all, we get that in OnPaint.
+	// Despite the function name, we only use the size from here for accelerated paints, since OnPaint has it.
 	// This function actually also gives us updates to the X and Y of the popup, which we do need.
+	this->popup_width = rect.width;
+	this->popup_height = rect.height;
 	const BoltIPCMessageTypeToClient msg_type = IPC_MSG_OSRPOPUPPOSITION;
 	const BoltIPCOsrPopupPositionHeader header = { .window_id = this->WindowID(), .x = rect.x, .y = rect.y };
-	this->send_lock->lock();
-	_bolt_ipc_send(this->client_fd, &msg_type, sizeof(msg_type));
-	_bolt_ipc_send(this->client_fd, &header, sizeof(header));
-	this->send_lock->unlock();
+	const BoltIPCBuffer buffers[] = {
+		{.data = &msg_type, .len = sizeof(msg_type)},
+		{.data = &header, .len = sizeof(header)},
+	};
+	this->send_queue->Send(buffers, std::size(buffers));
 }
 
 void Browser::WindowOSR::OnPaint(CefRefPtr<CefBrowser> browser, PaintElementType type, const RectList& dirtyRects, const void* buffer, int width, int height) {
 	if (this->deleted || dirtyRects.empty()) return;
+	BOLT_FRAMETRACE_SCOPE(scope, type == PET_POPUP ? "osr:OnPaint(popup)" : "osr:OnPaint");
 
 	if (type == PET_POPUP) {
-		const BoltIPCMessageTypeToClient msg_type = IPC_MSG_OSRPOPUPCONTENTS;
-		const BoltIPCOsrPopupContentsHeader header = { .window_id = this->WindowID(), .width = width, .height = height };
-		this->send_lock->lock();
-		_bolt_ipc_send(this->client_fd, &msg_type, sizeof(msg_type));
-		_bolt_ipc_send(this->client_fd, &header, sizeof(header));
-		_bolt_ipc_send(this->client_fd, buffer, (size_t)width * (size_t)height * 4);
-		this->send_lock->unlock();
+		this->PaintPopup(dirtyRects, buffer, width, height);
 		return;
 	}
 
 	if (type != PET_VIEW) return;
 
-	const size_t length = (size_t)width * (size_t)height * 4;
-	this->stored_lock.lock();
+	this->frame_lock.lock();
+	if (width != this->frame_width || height != this->frame_height) {
+		if (!this->remote_is_idle) {
+			// can't resize the mapping while the remote might still be reading from it, so rather
+			// than keeping a copy of this frame around, ask CEF for a new one once the remote is done
+			this->repaint_on_ack = true;
+			this->frame_lock.unlock();
+			return;
+		}
+		this->ResizeFrames(width, height);
+	}
+
+	// the back buffer first needs to catch up on anything that was painted into the other one since
+	// it was last written, then gets this paint's damage; the other buffer is now behind by that much
+	const CefRect damage = BoundingRect(dirtyRects);
+	CefRect& back_stale = this->stale_damage[this->back_buffer];
+	CefRect& front_stale = this->stale_damage[this->back_buffer ^ 1];
+	if (!back_stale.IsEmpty()) this->CopyToBackBuffer(buffer, back_stale);
+	for (const CefRect& rect: dirtyRects) this->CopyToBackBuffer(buffer, rect);
+	back_stale.Set(0, 0, 0, 0);
+	front_stale = front_stale.IsEmpty() ? damage : UnionRects(front_stale, damage);
+
 	if (this->remote_is_idle) {
-		void* needs_remap = length != this->mapping_size ? (void*)1 : (void*)0;
-		if (needs_remap) {
-#if defined(_WIN32)
-			UnmapViewOfFile(this->file);
-			CloseHandle(this->shm);
-			this->shm = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)length, NULL);
-			this->file = MapViewOfFile(this->shm, FILE_MAP_WRITE, 0, 0, length);
-			DuplicateHandle(GetCurrentProcess(), this->shm, this->target_process, (LPHANDLE)&needs_remap, 0, false, DUPLICATE_SAME_ACCESS);
-			this->remote_has_remapped = 1;
-#else
-			if (ftruncate(this->shm, length)) {
-				fmt::print("[B] OnPaint: ftruncate error {}\n", errno);
-			}
-			this->file = mremap(this->file, this->mapping_size, length, MREMAP_MAYMOVE);
-#endif
-			this->mapping_size = length;
-			memcpy(this->file, buffer, length);
-		} else {
-			for (const CefRect& rect: dirtyRects) {
-				for (int y = rect.y; y < rect.y + rect.height; y += 1) {
-					const int offset = (y * width * 4) + (rect.x * 4);
-					memcpy((uint8_t*)this->file + offset, (uint8_t*)buffer + offset, rect.width * 4);
-				}
-			}
+		this->SendFrame(dirtyRects.data(), dirtyRects.size());
+	} else {
+		// the remote will be given this buffer when it acks the one it's currently reading
+		this->pending_damage = this->has_pending_damage ? UnionRects(this->pending_damage, damage) : damage;
+		this->has_pending_damage = true;
+	}
+	this->frame_lock.unlock();
+}
+
+#if CEF_VERSION_MAJOR >= 124
+void Browser::WindowOSR::OnAcceleratedPaint(CefRefPtr<CefBrowser> browser, PaintElementType type, const RectList& dirtyRects, const CefAcceleratedPaintInfo& info) {
+	if (this->deleted || dirtyRects.empty()) return;
+	if (type != PET_VIEW && type != PET_POPUP) return;
+
+	BoltIPCOsrAcceleratedPaintHeader header = { .window_id = this->window_id, .is_popup = type == PET_POPUP };
+	if (header.is_popup) {
+		header.width = this->popup_width;
+		header.height = this->popup_height;
+	} else {
+		this->size_lock.lock();
+		header.width = this->width;
+		header.height = this->height;
+		this->size_lock.unlock();
+	}
+
+	this->frame_lock.lock();
+	if (!header.is_popup) {
+		if (!this->remote_is_idle) {
+			// the texture can't be kept until the ack, so just get CEF to paint again after it
+			this->repaint_on_ack = true;
+			this->frame_lock.unlock();
+			return;
 		}
-		if (!this->remote_has_remapped) {
+		this->generation += 1;
+		header.generation = this->generation;
+	}
+
 #if defined(_WIN32)
-			DuplicateHandle(GetCurrentProcess(), this->shm, this->target_process, (LPHANDLE)&needs_remap, 0, false, DUPLICATE_SAME_ACCESS);
+	if (!DuplicateHandle(GetCurrentProcess(), info.shared_texture_handle, this->target_process, (LPHANDLE)&header.handle, 0, false, DUPLICATE_SAME_ACCESS)) {
+		fmt::print("[B] OnAcceleratedPaint: DuplicateHandle error {}\n", GetLastError());
+		this->frame_lock.unlock();
+		return;
+	}
 #else
-			needs_remap = (void*)1;
-#endif
-		}
-		SendUpdateMsg(this->client_fd, this->send_lock, this->window_id, width, height, needs_remap, dirtyRects.data(), dirtyRects.size());
-		this->remote_has_remapped = true;
-		this->remote_is_idle = false;
-	} else {
-		const bool is_damage_stored = this->stored != nullptr;
-		if (is_damage_stored) ::free(this->stored);
-		this->stored = malloc(length);
-		memcpy(this->stored, buffer, length);
-		this->stored_width = width;
-		this->stored_height = height;
-
-		if (!is_damage_stored) this->stored_damage = dirtyRects[0];
-		for (size_t i = is_damage_stored ? 0 : 1; i < dirtyRects.size(); i += 1) {
-			if (dirtyRects[i].x < this->stored_damage.x) {
-				this->stored_damage.width += this->stored_damage.x - dirtyRects[i].x;
-				this->stored_damage.x = dirtyRects[i].x;
-			}
-			if (dirtyRects[i].y < this->stored_damage.y) {
-				this->stored_damage.height += this->stored_damage.y - dirtyRects[i].y;
-				this->stored_damage.y = dirtyRects[i].y;
-			}
-			if ((dirtyRects[i].x + dirtyRects[i].width) > (this->stored_damage.x + this->stored_damage.width)) {
-				this->stored_damage.width += (dirtyRects[i].x + dirtyRects[i].width) - (this->stored_damage.x + this->stored_damage.width);
-			}
-			if ((dirtyRects[i].y + dirtyRects[i].height) > (this->stored_damage.y + this->stored_damage.height)) {
-				this->stored_damage.height += (dirtyRects[i].y + dirtyRects[i].height) - (this->stored_damage.y + this->stored_damage.height);
-			}
-		}
+	// CEF only ever gives out 8-bit RGBA or BGRA, which are DRM_FORMAT_ABGR8888 and DRM_FORMAT_ARGB8888
+	header.format = (info.format == CEF_COLOR_TYPE_RGBA_8888) ? 0x34324241 : 0x34325241;
+	header.modifier = info.modifier;
+	header.plane_count = std::min((uint32_t)info.plane_count, (uint32_t)BOLT_IPC_MAX_PLANES);
+	int fds[BOLT_IPC_MAX_PLANES];
+	for (uint32_t i = 0; i < header.plane_count; i += 1) {
+		fds[i] = info.planes[i].fd;
+		header.strides[i] = info.planes[i].stride;
+		header.offsets[i] = info.planes[i].offset;
 	}
-	this->stored_lock.unlock();
+	// the fds go on the socket right now, so they're sure to arrive before the message that needs them
+	if (_bolt_ipc_send_handles(this->client_fd, fds, header.plane_count)) {
+		fmt::print("[B] OnAcceleratedPaint: couldn't send dmabuf fds\n");
+		this->frame_lock.unlock();
+		return;
+	}
+#endif
+
+	const BoltIPCMessageTypeToClient msg_type = IPC_MSG_OSRACCELERATEDPAINT;
+	const BoltIPCBuffer buffers[] = {
+		{.data = &msg_type, .len = sizeof(msg_type)},
+		{.data = &header, .len = sizeof(header)},
+	};
+	this->send_queue->Send(buffers, std::size(buffers));
+	if (!header.is_popup) this->remote_is_idle = false;
+	this->frame_lock.unlock();
 }
+#endif
 
 bool Browser::WindowOSR::OnBeforePopup(
 	CefRefPtr<CefBrowser> browser,
@@ -377,14 +589,17 @@ void Browser::WindowOSR::OnBeforeClose(CefRefPtr<CefBrowser> browser) {
 	if (browser->IsSame(this->browser)) {
 		this->browser = nullptr;
 		this->file_manager = nullptr;
-		::free(this->stored);
 #if defined(_WIN32)
 		UnmapViewOfFile(this->file);
 		CloseHandle(this->shm);
+		if (this->popup_file) UnmapViewOfFile(this->popup_file);
+		if (this->popup_shm) CloseHandle(this->popup_shm);
 		CloseHandle(this->target_process);
 #else
 		munmap(this->file, this->mapping_size);
 		close(this->shm);
+		if (this->popup_file) munmap(this->popup_file, this->popup_mapping_size);
+		close(this->popup_shm);
 #endif
 		this->deleted = true;
 		main_client->CleanupClientPlugins(this->client_fd);
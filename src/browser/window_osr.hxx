@@ -8,6 +8,7 @@
 #include "include/cef_client.h"
 #include "include/cef_life_span_handler.h"
 #include "include/cef_render_handler.h"
+#include "include/cef_version.h"
 
 #include "window_plugin_requests.hxx"
 #include "../file_manager/directory.hxx"
@@ -21,13 +22,13 @@ namespace Browser {
 	struct Client;
 
 	struct WindowOSR: public CefClient, CefLifeSpanHandler, CefRenderHandler, PluginRequestHandler {
-		WindowOSR(CefString url, int width, int height, BoltSocketType client_fd, Client* main_client, std::mutex* send_lock, int pid, uint64_t window_id, uint64_t plugin_id, CefRefPtr<FileManager::Directory>);
+		WindowOSR(CefString url, int width, int height, BoltSocketType client_fd, Client* main_client, CefRefPtr<SendQueue> send_queue, int pid, uint64_t window_id, uint64_t plugin_id, CefRefPtr<FileManager::Directory>, bool shared_texture);
 
 		bool IsDeleted();
 
 		void Close();
 
-		void HandleAck();
+		void HandleAck(uint64_t generation, bool is_popup);
 		void HandleReposition(const RepositionEvent*);
 		void HandleMouseMotion(const MouseMotionEvent*);
 		void HandleMouseButton(const MouseButtonEvent*);
@@ -52,6 +53,9 @@ namespace Browser {
 		void OnPopupShow(CefRefPtr<CefBrowser> browser, bool show) override;
 		void OnPopupSize(CefRefPtr<CefBrowser> browser, const CefRect& rect) override;
 		void OnPaint(CefRefPtr<CefBrowser> browser, PaintElementType type, const RectList& dirtyRects, const void* buffer, int width, int height) override;
+#if CEF_VERSION_MAJOR >= 124
+		void OnAcceleratedPaint(CefRefPtr<CefBrowser> browser, PaintElementType type, const RectList& dirtyRects, const CefAcceleratedPaintInfo& info) override;
+#endif
 
 		bool OnBeforePopup(
 			CefRefPtr<CefBrowser>,
@@ -90,14 +94,53 @@ namespace Browser {
 			Client* main_client;
 			CefRefPtr<FileManager::Directory> file_manager;
 
-			std::mutex stored_lock;
-			void* stored;
-			int stored_width;
-			int stored_height;
-			CefRect stored_damage;
+			// the shm holds BOLT_IPC_OSR_BUFFER_COUNT frames one after another. CEF paints go into the back
+			// buffer, which the remote isn't reading from, and then the remote is told to read from
+			// that one, at which point the other becomes the back buffer. while the remote is busy,
+			// paints keep going into the same back buffer, and it's sent as soon as the remote acks.
+			std::mutex frame_lock;
+			int frame_width;
+			int frame_height;
+			uint8_t back_buffer;
+			uint64_t generation; // of the last update sent to the remote; acks must match it
+			CefRect stale_damage[BOLT_IPC_OSR_BUFFER_COUNT]; // area of each buffer that's behind the latest paint
+			CefRect pending_damage; // damage painted into the back buffer but not yet sent
+			bool has_pending_damage;
+			bool repaint_on_ack;
 			uint8_t remote_has_remapped;
 			uint8_t remote_is_idle;
 
+			// popups have their own shm with a single frame in it, also guarded by frame_lock. popups are
+			// small and short-lived, so rather than double-buffering, any paint while the remote is
+			// still reading the last one is dropped, and the whole popup is repainted when it acks.
+#if defined(_WIN32)
+			HANDLE popup_shm;
+#else
+			int popup_shm;
+#endif
+			void* popup_file;
+			size_t popup_mapping_size;
+			int popup_frame_width;
+			int popup_frame_height;
+			uint64_t popup_generation;
+			bool popup_repaint_on_ack;
+			uint8_t popup_remote_has_remapped;
+			uint8_t popup_remote_is_idle;
+
+			// if set, CEF paints into GPU textures, which are handed straight to the remote with
+			// IPC_MSG_OSRACCELERATEDPAINT, and OnPaint and the shm frames above go unused.
+			// those textures don't last beyond the paint, so any paint while the remote is busy gets
+			// dropped and repeated when it acks, using repaint_on_ack.
+			bool shared_texture;
+			int popup_width;
+			int popup_height;
+
+			void SendFrame(const CefRect* rects, size_t rect_count);
+			void CopyToBackBuffer(const void* buffer, const CefRect& rect);
+			void ResizeFrames(int width, int height);
+			void PaintPopup(const RectList& rects, const void* buffer, int width, int height);
+			bool ResizePopupFrame(int width, int height);
+
 			IMPLEMENT_REFCOUNTING(WindowOSR);
 			DISALLOW_COPY_AND_ASSIGN(WindowOSR);
 	};
@@ -17,8 +17,8 @@ struct InitTask: public CefTask {
 		DISALLOW_COPY_AND_ASSIGN(InitTask);
 };
 
-Browser::PluginWindow::PluginWindow(CefRefPtr<Client> main_client, Details details, const char* url, CefRefPtr<FileManager::Directory> file_manager, BoltSocketType fd, std::mutex* send_lock, uint64_t id, uint64_t plugin_id, bool show_devtools):
-	PluginRequestHandler(IPC_MSG_EXTERNALBROWSERMESSAGE, send_lock),
+Browser::PluginWindow::PluginWindow(CefRefPtr<Client> main_client, Details details, const char* url, CefRefPtr<FileManager::Directory> file_manager, BoltSocketType fd, CefRefPtr<SendQueue> send_queue, uint64_t id, uint64_t plugin_id, bool show_devtools):
+	PluginRequestHandler(IPC_MSG_EXTERNALBROWSERMESSAGE, send_queue),
 	Window(main_client, details, show_devtools),
 	file_manager(file_manager), client_fd(fd), window_id(id), plugin_id(plugin_id), closing(false), deleted(false)
 {
@@ -56,19 +56,21 @@ CefRefPtr<CefBrowser> Browser::PluginWindow::Browser() const {
 void Browser::PluginWindow::HandlePluginCloseRequest() {
 	const BoltIPCMessageTypeToClient msg_type = IPC_MSG_BROWSERCLOSEREQUEST;
 	const BoltIPCBrowserCloseRequestHeader header = { .window_id = this->window_id, .plugin_id = this->plugin_id };
-	this->send_lock->lock();
-	_bolt_ipc_send(this->client_fd, &msg_type, sizeof(msg_type));
-	_bolt_ipc_send(this->client_fd, &header, sizeof(header));
-	this->send_lock->unlock();
+	const BoltIPCBuffer buffers[] = {
+		{.data = &msg_type, .len = sizeof(msg_type)},
+		{.data = &header, .len = sizeof(header)},
+	};
+	this->send_queue->Send(buffers, std::size(buffers));
 }
 
 void Browser::PluginWindow::SendCaptureDone() const {
 	const BoltIPCMessageTypeToClient msg_type = IPC_MSG_EXTERNALCAPTUREDONE;
 	const BoltIPCExternalCaptureDoneHeader header = { .window_id = this->window_id, .plugin_id = this->plugin_id };
-	this->send_lock->lock();
-	_bolt_ipc_send(this->client_fd, &msg_type, sizeof(msg_type));
-	_bolt_ipc_send(this->client_fd, &header, sizeof(header));
-	this->send_lock->unlock();
+	const BoltIPCBuffer buffers[] = {
+		{.data = &msg_type, .len = sizeof(msg_type)},
+		{.data = &header, .len = sizeof(header)},
+	};
+	this->send_queue->Send(buffers, std::size(buffers));
 }
 
 bool Browser::PluginWindow::OnBeforePopup(
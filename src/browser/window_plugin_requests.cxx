@@ -18,7 +18,7 @@ void Browser::PluginRequestHandler::HandlePluginMessage(const uint8_t* data, siz
 	}
 }
 
-void Browser::PluginRequestHandler::HandleCaptureNotify(uint64_t pid, uint64_t capture_id, int width, int height, bool needs_remap) {
+void Browser::PluginRequestHandler::HandleCaptureNotify(uint64_t pid, uint64_t capture_id, uint64_t offset, uint64_t shm_size, int width, int height, bool needs_remap, const std::vector<uint8_t>& dirty_tiles) {
 	CefRefPtr<CefBrowser> browser = this->Browser();
 	if (!browser) {
 		// can't process this yet - inform the game process that we're done and don't do any further handling
@@ -26,25 +26,34 @@ void Browser::PluginRequestHandler::HandleCaptureNotify(uint64_t pid, uint64_t c
 		return;
 	}
 
+	// args: width, height, offset, shm size, dirty-tile bitmap (null if the whole image should be sent),
+	// and then the shm name if it needs to be remapped (null meaning the same shm has been resized)
 	CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("__bolt_plugin_capture");
 	CefRefPtr<CefListValue> list = message->GetArgumentList();
 	if (needs_remap || capture_id != this->current_capture_id) {
-		list->SetSize(3);
+		list->SetSize(6);
 #if !defined(_WIN32)
 		if (capture_id != this->current_capture_id) {
 #endif
 		const CefString str = std::format("/bolt-{}-sc-{}", pid, capture_id);
-		list->SetString(2, str);
+		list->SetString(5, str);
 #if !defined(_WIN32)
 		} else {
-			list->SetNull(2);
+			list->SetNull(5);
 		}
 #endif
 	} else {
-		list->SetSize(2);
+		list->SetSize(5);
 	}
 	list->SetInt(0, width);
 	list->SetInt(1, height);
+	list->SetDouble(2, (double)offset);
+	list->SetDouble(3, (double)shm_size);
+	if (dirty_tiles.empty()) {
+		list->SetNull(4);
+	} else {
+		list->SetBinary(4, CefBinaryValue::Create(dirty_tiles.data(), dirty_tiles.size()));
+	}
 	browser->GetMainFrame()->SendProcessMessage(PID_RENDERER, message);
 	this->current_capture_id = capture_id;
 }
@@ -117,11 +126,12 @@ CefRefPtr<CefResourceRequestHandler> Browser::PluginRequestHandler::GetResourceR
 			vec[0]->GetBytes(message_size, message);
 
 			const BoltIPCBrowserMessageHeader header = { .window_id = this->WindowID(), .plugin_id = this->PluginID(), .message_size = message_size };
-			this->send_lock->lock();
-			const uint8_t ret = _bolt_ipc_send(this->ClientFD(), &this->message_type, sizeof(this->message_type))
-				|| _bolt_ipc_send(this->ClientFD(), &header, sizeof(header))
-				|| _bolt_ipc_send(this->ClientFD(), message, message_size);
-			this->send_lock->unlock();
+			const BoltIPCBuffer buffers[] = {
+				{.data = &this->message_type, .len = sizeof(this->message_type)},
+				{.data = &header, .len = sizeof(header)},
+				{.data = message, .len = message_size},
+			};
+			const bool ret = !this->send_queue->Send(buffers, std::size(buffers));
 			delete[] message;
 			QSENDSYSTEMERRORIF(ret);
 			QSENDOK();
@@ -150,10 +160,11 @@ CefRefPtr<CefResourceRequestHandler> Browser::PluginRequestHandler::GetResourceR
 			header.window_id = this->WindowID();
 			header.horizontal = (h == 0) ? 0 : ((h > 0) ? 1 : -1);
 			header.vertical = (v == 0) ? 0 : ((v > 0) ? 1 : -1);
-			this->send_lock->lock();
-			const uint8_t ret = _bolt_ipc_send(this->ClientFD(), &msg_type, sizeof(msg_type))
-				|| _bolt_ipc_send(this->ClientFD(), &header, sizeof(header));
-			this->send_lock->unlock();
+			const BoltIPCBuffer buffers[] = {
+				{.data = &msg_type, .len = sizeof(msg_type)},
+				{.data = &header, .len = sizeof(header)},
+			};
+			const bool ret = !this->send_queue->Send(buffers, std::size(buffers));
 			QSENDSYSTEMERRORIF(ret);
 			QSENDOK();
 		}
@@ -161,10 +172,11 @@ CefRefPtr<CefResourceRequestHandler> Browser::PluginRequestHandler::GetResourceR
 		if (api_name == "cancel-reposition") {
 			const BoltIPCMessageTypeToClient msg_type = IPC_MSG_OSRCANCELREPOSITION;
 			const BoltIPCOsrCancelRepositionHeader header = { .window_id = this->WindowID() };
-			this->send_lock->lock();
-			const uint8_t ret = _bolt_ipc_send(this->ClientFD(), &msg_type, sizeof(msg_type))
-				|| _bolt_ipc_send(this->ClientFD(), &header, sizeof(header));
-			this->send_lock->unlock();
+			const BoltIPCBuffer buffers[] = {
+				{.data = &msg_type, .len = sizeof(msg_type)},
+				{.data = &header, .len = sizeof(header)},
+			};
+			const bool ret = !this->send_queue->Send(buffers, std::size(buffers));
 			QSENDSYSTEMERRORIF(ret);
 			QSENDOK();
 		}
@@ -3,18 +3,17 @@
 #if defined(BOLT_PLUGINS)
 #include "../library/ipc.h"
 #include "../file_manager.hxx"
+#include "send_queue.hxx"
 #include "include/cef_request_handler.h"
 
-#include <mutex>
-
 namespace Browser {
 	/// Abstract class handling requests from plugin-managed browsers
 	struct PluginRequestHandler: public CefRequestHandler {
-		PluginRequestHandler(BoltIPCMessageTypeToClient message_type, std::mutex* send_lock):
-			message_type(message_type), send_lock(send_lock), current_capture_id(-1) {}
+		PluginRequestHandler(BoltIPCMessageTypeToClient message_type, CefRefPtr<SendQueue> send_queue):
+			message_type(message_type), send_queue(send_queue), current_capture_id(-1) {}
 
 		void HandlePluginMessage(const uint8_t*, size_t);
-		void HandleCaptureNotify(uint64_t, uint64_t, int, int, bool);
+		void HandleCaptureNotify(uint64_t, uint64_t, uint64_t, uint64_t, int, int, bool, const std::vector<uint8_t>&);
 		void NotifyBrowserCreated(CefRefPtr<CefBrowser>);
 
 		CefRefPtr<CefResourceRequestHandler> GetResourceRequestHandler(
@@ -36,7 +35,7 @@ namespace Browser {
 		virtual void SendCaptureDone() const = 0;
 
 		protected:
-			std::mutex* send_lock;
+			CefRefPtr<SendQueue> send_queue;
 			uint64_t current_capture_id;
 
 		private:
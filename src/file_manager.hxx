@@ -14,6 +14,9 @@ namespace FileManager {
 
 		/// MIME type of this file - not initialised if `contents` is nullptr
 		const char* mime_type;
+
+		/// Whatever owns `contents`, for the FileManager's own use in free(), or nullptr
+		void* owner;
 	};
 
 	class FileManager: public CefBaseRefCounted {
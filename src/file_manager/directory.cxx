@@ -7,81 +7,125 @@
 #if defined(__linux__)
 #include <thread>
 #include <sys/inotify.h>
+#include <unistd.h>
 
-void Watch(std::filesystem::path path, CefRefPtr<FileManager::FileManager> file_manager, int fd, int wd) {
-	const struct inotify_event *event;
-	char buf[256] __attribute__((aligned(__alignof__(struct inotify_event))));
-	bool run = true;
-	while (run) {
-		bool did_callback = false;
-		size_t len = read(fd, buf, sizeof(buf));
-		if (len <= 0) {
-			fmt::print("[B] file monitor stopping due to inotify being interrupted\n");
-			break;
-		}
-		for (const char* ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + event->len) {
-			event = reinterpret_cast<const inotify_event*>(ptr);
-			switch (event->mask) {
-				case IN_MOVE_SELF:
-				case IN_DELETE_SELF:
-					fmt::print("[B] file monitor stopping due to monitored directory being moved or deleted\n");
-					// fall through
-				case IN_IGNORED:
-					run = false;
-					ptr = buf + len; // so we won't process any more events
-					break;
-				default:
-					if (!did_callback) {
-						did_callback = true;
-						file_manager->OnFileChange();
-					}
-					break;
-			}
-		}
-		
-	}
-}
+constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVE | IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED;
 #endif
 
-FileManager::Directory::Directory(std::filesystem::path path, bool watch): path(path), watch(watch) {
+// files bigger than this are read from disk every time instead of being cached, and nothing more
+// is cached once a directory's cache reaches the total size
+constexpr size_t CACHE_MAX_FILE_SIZE = 16 << 20;
+constexpr size_t CACHE_MAX_TOTAL_SIZE = 128 << 20;
+
+FileManager::Directory::Directory(std::filesystem::path path, bool watch): path(path), watch(watch), cache_size(0), cache_generation(0) {
 	if (watch) {
 #if defined(__linux__)
 		this->inotify_fd = inotify_init1(IN_CLOEXEC);
-		this->inotify_wd = inotify_add_watch(this->inotify_fd, path.c_str(), IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVE | IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED);
-		this->inotify_thread = std::thread(Watch, path, this, this->inotify_fd, this->inotify_wd);
+		this->inotify_wd = inotify_add_watch(this->inotify_fd, path.c_str(), WATCH_MASK);
+		this->inotify_dirs[this->inotify_wd] = "";
+		this->AddWatches("");
+		this->inotify_thread = std::thread(Watch, this);
 #else
 		printf("[B] note: directory-watching is not supported on this platform\n");
 #endif
 	}
 }
 
+// true if the cached copy of the file can still be served, going by its mtime and size
+static bool IsCurrent(const std::filesystem::path& path, const std::vector<unsigned char>& contents, std::filesystem::file_time_type mtime) {
+	std::error_code ec;
+	const std::filesystem::file_time_type current_mtime = std::filesystem::last_write_time(path, ec);
+	if (ec || current_mtime != mtime) return false;
+	const uintmax_t size = std::filesystem::file_size(path, ec);
+	return !ec && size == contents.size();
+}
+
 FileManager::File FileManager::Directory::get(std::string_view uri) const {
-	std::filesystem::path path = this->path.string() + std::string(uri);
-	std::ifstream file(path, std::ios::in | std::ios::binary);
-    if (file.fail()) return File { .contents = nullptr, .size = 0 };
-    file.seekg(0, std::ios::end);
-    size_t size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    char* buffer = new char[size];
-    if (!file.read(buffer, size)) {
-		delete[] buffer;
-		return File { .contents = nullptr, .size = 0 };
-	}
-	const char* mime_type = GetMimeType(path);
-	if (!mime_type) {
-		fmt::print("ERROR: unknown file extension \"{}\" ({}), please add it to mime.cxx and rebuild\n", path.extension().string(), path.string());
-		delete[] buffer;
-		return File { .contents = nullptr, .size = 0 };
+	const std::string key(uri);
+	std::filesystem::path path = this->path.string() + key;
+
+	this->cache_lock.lock();
+	auto it = this->cache.find(key);
+	CefRefPtr<CachedFile> cached = (it == this->cache.end()) ? nullptr : it->second;
+	const uint64_t generation = this->cache_generation;
+	this->cache_lock.unlock();
+
+	// inotify tells us when a watched directory changes, otherwise it has to be checked every time
+#if defined(__linux__)
+	const bool is_watched = this->watch;
+#else
+	const bool is_watched = false;
+#endif
+	if (!cached || !(is_watched || IsCurrent(path, cached->contents, cached->mtime))) {
+		// mtime is checked before reading, so if the file changes in between, the cached copy will
+		// look out of date next time rather than looking current with the wrong contents
+		std::error_code ec;
+		const std::filesystem::file_time_type mtime = std::filesystem::last_write_time(path, ec);
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		if (file.fail()) return File { .contents = nullptr, .size = 0 };
+		file.seekg(0, std::ios::end);
+		size_t size = file.tellg();
+		file.seekg(0, std::ios::beg);
+		std::vector<unsigned char> buffer(size);
+		if (!file.read(reinterpret_cast<char*>(buffer.data()), size)) {
+			return File { .contents = nullptr, .size = 0 };
+		}
+		const char* mime_type = GetMimeType(path);
+		if (!mime_type) {
+			fmt::print("ERROR: unknown file extension \"{}\" ({}), please add it to mime.cxx and rebuild\n", path.extension().string(), path.string());
+			return File { .contents = nullptr, .size = 0 };
+		}
+		cached = new CachedFile(std::move(buffer), mime_type, mtime);
+
+		// only cache paths that are already normalised, since those are what inotify events get
+		// matched against, and anything else could be referring to a file outside the directory
+		if (!ec && size <= CACHE_MAX_FILE_SIZE && key == std::filesystem::path(key).lexically_normal().generic_string()) {
+			std::lock_guard<std::mutex> _(this->cache_lock);
+			if (this->cache_generation == generation) {
+				auto it = this->cache.find(key);
+				const size_t old_size = (it == this->cache.end()) ? 0 : it->second->contents.size();
+				if (this->cache_size - old_size + size <= CACHE_MAX_TOTAL_SIZE) {
+					this->cache[key] = cached;
+					this->cache_size = this->cache_size - old_size + size;
+				}
+			}
+		}
 	}
+
+	// this reference belongs to the File now, and is released in free()
+	cached->AddRef();
 	return File {
-		.contents = reinterpret_cast<unsigned char*>(buffer),
-		.size = size,
-		.mime_type = mime_type
+		.contents = cached->contents.data(),
+		.size = cached->contents.size(),
+		.mime_type = cached->mime_type,
+		.owner = cached.get(),
 	};
 }
 
 void FileManager::Directory::free(File file) const {
-	delete[] file.contents;
+	if (file.owner) static_cast<CachedFile*>(file.owner)->Release();
+}
+
+void FileManager::Directory::InvalidateCache(const std::string& uri, bool is_dir) {
+	std::lock_guard<std::mutex> _(this->cache_lock);
+	this->cache_generation += 1;
+	if (!is_dir) {
+		auto it = this->cache.find(uri);
+		if (it != this->cache.end()) {
+			this->cache_size -= it->second->contents.size();
+			this->cache.erase(it);
+		}
+		return;
+	}
+	const std::string prefix = uri + "/";
+	for (auto it = this->cache.begin(); it != this->cache.end();) {
+		if (it->first.starts_with(prefix)) {
+			this->cache_size -= it->second->contents.size();
+			it = this->cache.erase(it);
+		} else {
+			++it;
+		}
+	}
 }
 
 void FileManager::Directory::StopFileManager() {
@@ -89,6 +133,84 @@ void FileManager::Directory::StopFileManager() {
 	if (this->watch) {
 		inotify_rm_watch(this->inotify_fd, this->inotify_wd);
 		this->inotify_thread.join();
+		close(this->inotify_fd);
 	}
 #endif
 }
+
+#if defined(__linux__)
+void FileManager::Directory::AddWatches(const std::string& relative) {
+	const std::filesystem::path dir = this->path.string() + relative;
+	if (!relative.empty()) {
+		const int wd = inotify_add_watch(this->inotify_fd, dir.c_str(), WATCH_MASK);
+		if (wd == -1) return;
+		this->inotify_dirs[wd] = relative;
+	}
+	std::error_code ec;
+	for (const std::filesystem::directory_entry& entry: std::filesystem::directory_iterator(dir, ec)) {
+		if (entry.is_directory(ec) && !entry.is_symlink(ec)) {
+			this->AddWatches(relative + "/" + entry.path().filename().string());
+		}
+	}
+}
+
+void FileManager::Directory::RemoveWatches(const std::string& relative) {
+	const std::string prefix = relative + "/";
+	for (auto it = this->inotify_dirs.begin(); it != this->inotify_dirs.end();) {
+		if (it->second == relative || it->second.starts_with(prefix)) {
+			inotify_rm_watch(this->inotify_fd, it->first);
+			it = this->inotify_dirs.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void FileManager::Directory::Watch(CefRefPtr<Directory> directory) {
+	const struct inotify_event *event;
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool run = true;
+	while (run) {
+		bool did_callback = false;
+		ssize_t len = read(directory->inotify_fd, buf, sizeof(buf));
+		if (len <= 0) {
+			fmt::print("[B] file monitor stopping due to inotify being interrupted\n");
+			break;
+		}
+		for (const char* ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + event->len) {
+			event = reinterpret_cast<const inotify_event*>(ptr);
+			if (event->wd == directory->inotify_wd && (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))) {
+				if (!(event->mask & IN_IGNORED)) {
+					fmt::print("[B] file monitor stopping due to monitored directory being moved or deleted\n");
+				}
+				run = false;
+				break;
+			}
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				// some events were lost, so there's no telling what's changed
+				directory->InvalidateCache("", true);
+			} else {
+				auto dir = directory->inotify_dirs.find(event->wd);
+				// events can still arrive for a subdirectory after it's been removed from inotify_dirs
+				if (dir == directory->inotify_dirs.end()) continue;
+				if (event->len) {
+					const std::string uri = dir->second + "/" + event->name;
+					const bool is_dir = event->mask & IN_ISDIR;
+					if (is_dir && (event->mask & (IN_DELETE | IN_MOVED_FROM))) directory->RemoveWatches(uri);
+					if (is_dir && (event->mask & (IN_CREATE | IN_MOVED_TO))) directory->AddWatches(uri);
+					directory->InvalidateCache(uri, is_dir);
+				} else if (event->mask & IN_IGNORED) {
+					directory->InvalidateCache(dir->second, true);
+					directory->inotify_dirs.erase(dir);
+				}
+			}
+
+			if (!did_callback) {
+				did_callback = true;
+				directory->OnFileChange();
+			}
+		}
+	}
+}
+#endif
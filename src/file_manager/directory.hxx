@@ -2,20 +2,57 @@
 #define _BOLT_FILE_MANAGER_DIRECTORY_HXX_
 #include "../file_manager.hxx"
 
-#include <thread>
 #include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace FileManager {
 	/// Serves the contents of a directory from disk, also watching the directory for changes if the
-	/// current platform supports it
+	/// current platform supports it. Files are kept in memory after they're first read, so serving
+	/// them again doesn't touch the disk. Watched directories have their cached files dropped when
+	/// inotify reports a change, and any other directory checks the file's mtime and size instead.
 	class Directory: public FileManager {
+		/// Contents of one file, which never change once read. Shared between the cache and every File
+		/// handed out for it, so dropping it from the cache can't free it while a request is reading it.
+		struct CachedFile: public CefBaseRefCounted {
+			CachedFile(std::vector<unsigned char>&& contents, const char* mime_type, std::filesystem::file_time_type mtime):
+				contents(std::move(contents)), mime_type(mime_type), mtime(mtime) { }
+			const std::vector<unsigned char> contents;
+			const char* const mime_type;
+			const std::filesystem::file_time_type mtime;
+			IMPLEMENT_REFCOUNTING(CachedFile);
+			DISALLOW_COPY_AND_ASSIGN(CachedFile);
+		};
+
 		std::filesystem::path path;
 		bool watch;
 
+		// everything below cache_lock is protected by it. cache_generation goes up whenever anything
+		// is invalidated, so that a file that was read while it was changing won't get cached
+		mutable std::mutex cache_lock;
+		mutable std::unordered_map<std::string, CefRefPtr<CachedFile>> cache;
+		mutable size_t cache_size;
+		uint64_t cache_generation;
+
+		/// Drops `uri` from the cache, or if `is_dir` is set, everything under it. An empty `uri` with
+		/// `is_dir` set drops everything.
+		void InvalidateCache(const std::string& uri, bool is_dir);
+
 #if defined(__linux__)
 		std::thread inotify_thread;
 		int inotify_fd;
 		int inotify_wd;
+		// relative path of every watched directory, "" being the root. inotify only reports changes
+		// in the directory being watched, not subdirectories, so each subdirectory needs its own.
+		// only used by inotify_thread, after the constructor has returned
+		std::unordered_map<int, std::string> inotify_dirs;
+
+		void AddWatches(const std::string& relative);
+		void RemoveWatches(const std::string& relative);
+		static void Watch(CefRefPtr<Directory>);
 #endif
 
 		public:
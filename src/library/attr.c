@@ -0,0 +1,199 @@
+#include "attr.h"
+
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BOLT_HAVE_ATTR_X86
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BOLT_HAVE_ATTR_NEON
+#endif
+
+/* plain C
+ *
+ * these do exactly what the per-vertex decoders in gl.c do for the same formats. the normalised one
+ * divides by a double, and converting that back to a float gives the correctly-rounded single-precision
+ * quotient, since a double has more than twice a float's precision. that's what lets the SIMD versions
+ * divide in single precision and still match.
+ */
+
+static void _bolt_attr_decode_range_ubyte_norm(const uint8_t* base, size_t stride, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t out_stride) {
+    for (size_t i = 0; i < count; i += 1) {
+        const uint8_t* ptr = base + (indices[i] * stride);
+        float values[4];
+        for (size_t j = 0; j < num_out; j += 1) values[j] = ((float)ptr[j]) / 255.0;
+        memcpy(out + (i * out_stride), values, num_out * sizeof(float));
+    }
+}
+
+static void _bolt_attr_decode_range_short(const uint8_t* base, size_t stride, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t out_stride) {
+    for (size_t i = 0; i < count; i += 1) {
+        const uint8_t* ptr = base + (indices[i] * stride);
+        float values[4];
+        for (size_t j = 0; j < num_out; j += 1) {
+            int16_t v;
+            memcpy(&v, ptr + (j * sizeof(v)), sizeof(v));
+            values[j] = (float)v;
+        }
+        memcpy(out + (i * out_stride), values, num_out * sizeof(float));
+    }
+}
+
+/* SSE4.1
+ *
+ * each vertex's elements are widened to four 32-bit ints in one go with pmovzxbd/pmovsxwd, then
+ * converted to floats. only `num_out` elements are ever read from the vertex, same as the plain C
+ * versions, so a vertex at the very end of a buffer doesn't get read past. the loops are specialised
+ * for each element count, so that the loads and stores are fixed-size instead of library memcpy calls.
+ */
+
+#if defined(BOLT_HAVE_ATTR_X86)
+#define BOLT_ATTR_X86_INLINE __attribute__((target("sse4.1"), always_inline)) static inline
+
+// loads exactly `len` bytes, from 1 to 8, into the low end of a register with the rest zeroed. odd
+// lengths are put together in registers rather than through a stack buffer, which would stall on
+// store forwarding when read back as one load
+BOLT_ATTR_X86_INLINE __m128i _bolt_attr_load_sse41(const uint8_t* ptr, size_t len) {
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+    switch (len) {
+        case 1:
+            return _mm_cvtsi32_si128(*ptr);
+        case 2:
+            memcpy(&u16, ptr, sizeof(u16));
+            return _mm_cvtsi32_si128(u16);
+        case 3:
+            memcpy(&u16, ptr, sizeof(u16));
+            return _mm_insert_epi8(_mm_cvtsi32_si128(u16), ptr[2], 2);
+        case 4:
+            memcpy(&u32, ptr, sizeof(u32));
+            return _mm_cvtsi32_si128((int)u32);
+        case 6:
+            memcpy(&u32, ptr, sizeof(u32));
+            memcpy(&u16, ptr + sizeof(u32), sizeof(u16));
+            return _mm_insert_epi16(_mm_cvtsi32_si128((int)u32), u16, 2);
+        default:
+            memcpy(&u64, ptr, sizeof(u64));
+            return _mm_loadl_epi64((const __m128i*)&u64);
+    }
+}
+
+BOLT_ATTR_X86_INLINE void _bolt_attr_store_sse41(uint8_t* out, __m128 values, size_t num_out) {
+    switch (num_out) {
+        case 1:
+            _mm_store_ss((float*)out, values);
+            break;
+        case 2:
+            _mm_storel_pi((__m64*)out, values);
+            break;
+        case 3:
+            _mm_storel_pi((__m64*)out, values);
+            _mm_store_ss((float*)(out + (2 * sizeof(float))), _mm_movehl_ps(values, values));
+            break;
+        default:
+            _mm_storeu_ps((float*)out, values);
+            break;
+    }
+}
+
+BOLT_ATTR_X86_INLINE void _bolt_attr_ubyte_norm_sse41(const uint8_t* base, size_t stride, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t out_stride) {
+    const __m128 scale = _mm_set1_ps(255.0f);
+    for (size_t i = 0; i < count; i += 1) {
+        const __m128i packed = _bolt_attr_load_sse41(base + (indices[i] * stride), num_out);
+        const __m128 values = _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(packed)), scale);
+        _bolt_attr_store_sse41(out + (i * out_stride), values, num_out);
+    }
+}
+
+BOLT_ATTR_X86_INLINE void _bolt_attr_short_sse41(const uint8_t* base, size_t stride, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t out_stride) {
+    for (size_t i = 0; i < count; i += 1) {
+        const __m128i packed = _bolt_attr_load_sse41(base + (indices[i] * stride), num_out * sizeof(int16_t));
+        const __m128 values = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(packed));
+        _bolt_attr_store_sse41(out + (i * out_stride), values, num_out);
+    }
+}
+
+__attribute__((target("sse4.1"))) static void _bolt_attr_decode_range_ubyte_norm_sse41(const uint8_t* base, size_t stride, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t out_stride) {
+    switch (num_out) {
+        case 1: _bolt_attr_ubyte_norm_sse41(base, stride, indices, count, 1, out, out_stride); break;
+        case 2: _bolt_attr_ubyte_norm_sse41(base, stride, indices, count, 2, out, out_stride); break;
+        case 3: _bolt_attr_ubyte_norm_sse41(base, stride, indices, count, 3, out, out_stride); break;
+        default: _bolt_attr_ubyte_norm_sse41(base, stride, indices, count, 4, out, out_stride); break;
+    }
+}
+
+__attribute__((target("sse4.1"))) static void _bolt_attr_decode_range_short_sse41(const uint8_t* base, size_t stride, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t out_stride) {
+    switch (num_out) {
+        case 1: _bolt_attr_short_sse41(base, stride, indices, count, 1, out, out_stride); break;
+        case 2: _bolt_attr_short_sse41(base, stride, indices, count, 2, out, out_stride); break;
+        case 3: _bolt_attr_short_sse41(base, stride, indices, count, 3, out, out_stride); break;
+        default: _bolt_attr_short_sse41(base, stride, indices, count, 4, out, out_stride); break;
+    }
+}
+#endif
+
+/* NEON */
+
+#if defined(BOLT_HAVE_ATTR_NEON)
+static void _bolt_attr_decode_range_ubyte_norm_neon(const uint8_t* base, size_t stride, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t out_stride) {
+    const float32x4_t scale = vdupq_n_f32(255.0f);
+    for (size_t i = 0; i < count; i += 1) {
+        uint8_t packed[8] = {0};
+        memcpy(packed, base + (indices[i] * stride), num_out);
+        const uint32x4_t ints = vmovl_u16(vget_low_u16(vmovl_u8(vld1_u8(packed))));
+        float values[4];
+        vst1q_f32(values, vdivq_f32(vcvtq_f32_u32(ints), scale));
+        memcpy(out + (i * out_stride), values, num_out * sizeof(float));
+    }
+}
+
+static void _bolt_attr_decode_range_short_neon(const uint8_t* base, size_t stride, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t out_stride) {
+    for (size_t i = 0; i < count; i += 1) {
+        int16_t packed[4] = {0};
+        memcpy(packed, base + (indices[i] * stride), num_out * sizeof(int16_t));
+        float values[4];
+        vst1q_f32(values, vcvtq_f32_s32(vmovl_s16(vld1_s16(packed))));
+        memcpy(out + (i * out_stride), values, num_out * sizeof(float));
+    }
+}
+#endif
+
+uint8_t _bolt_attr_kernels(enum BoltAttrISA isa, struct BoltAttrKernels* out) {
+    switch (isa) {
+        case BOLT_ATTR_SCALAR:
+            *out = (struct BoltAttrKernels){_bolt_attr_decode_range_ubyte_norm, _bolt_attr_decode_range_short};
+            return 1;
+#if defined(BOLT_HAVE_ATTR_X86)
+        case BOLT_ATTR_SSE41:
+            if (!__builtin_cpu_supports("sse4.1")) return 0;
+            *out = (struct BoltAttrKernels){_bolt_attr_decode_range_ubyte_norm_sse41, _bolt_attr_decode_range_short_sse41};
+            return 1;
+#endif
+#if defined(BOLT_HAVE_ATTR_NEON)
+        case BOLT_ATTR_NEON:
+            // NEON is always there on aarch64, so there's nothing to check
+            *out = (struct BoltAttrKernels){_bolt_attr_decode_range_ubyte_norm_neon, _bolt_attr_decode_range_short_neon};
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+void _bolt_attr_best_kernels(struct BoltAttrKernels* out) {
+    if (_bolt_attr_kernels(BOLT_ATTR_SSE41, out)) return;
+    if (_bolt_attr_kernels(BOLT_ATTR_NEON, out)) return;
+    _bolt_attr_kernels(BOLT_ATTR_SCALAR, out);
+}
+
+const char* _bolt_attr_isa_name(enum BoltAttrISA isa) {
+    switch (isa) {
+        case BOLT_ATTR_SCALAR: return "scalar";
+        case BOLT_ATTR_SSE41: return "sse4.1";
+        case BOLT_ATTR_NEON: return "neon";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef _BOLT_LIBRARY_ATTR_H_
+#define _BOLT_LIBRARY_ATTR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* vertex attribute range decoding
+ *
+ * Decoders that convert one vertex attribute to floats for a whole range of indexed vertices in one
+ * call, for the bulk vertex functions. These only exist for the integer formats that the game's
+ * vertex colours (normalised unsigned bytes) and positions (shorts) use, since those are the ones
+ * that make up most of what plugins read. There's a plain C version of each, and SSE4.1 and NEON
+ * versions that convert all of a vertex's elements at once. The SIMD normalised-byte decoders divide
+ * in single precision, where the plain C one divides in double precision, but both round to the same
+ * float for every input, so every version gives bit-identical output, which bench/attr_bench.c checks.
+ *
+ * The x86 versions are compiled with per-function target attributes, so they can be built into a
+ * library that still runs on CPUs without them, and _bolt_attr_kernels checks the CPU before handing
+ * them out.
+ */
+
+/// Decodes `num_out` elements, at most 4, of the attribute for each of `count` vertices. Vertex i is
+/// read from `base + (indices[i] * stride)` and its floats are written to `out + (i * out_stride)`,
+/// which doesn't have to be aligned.
+typedef void (*BoltAttrDecodeRange)(const uint8_t* base, size_t stride, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t out_stride);
+
+enum BoltAttrISA {
+    BOLT_ATTR_SCALAR,
+    BOLT_ATTR_SSE41,
+    BOLT_ATTR_NEON,
+    BOLT_ATTR_ISA_COUNT,
+};
+
+/// One decoder per supported attribute format.
+struct BoltAttrKernels {
+    BoltAttrDecodeRange ubyte_norm; // GL_UNSIGNED_BYTE with normalisation, i.e. v / 255.0
+    BoltAttrDecodeRange short_int; // GL_SHORT without normalisation
+};
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/// Fills `out` with the decoders for `isa`. Returns 0, leaving `out` untouched, if they aren't
+/// compiled into this build or the CPU doesn't support them.
+uint8_t _bolt_attr_kernels(enum BoltAttrISA isa, struct BoltAttrKernels* out);
+
+/// Fills `out` with the fastest decoders that can run on this CPU, which are the plain C ones if
+/// nothing else can.
+void _bolt_attr_best_kernels(struct BoltAttrKernels* out);
+
+/// A human-readable name for `isa`, for logging.
+const char* _bolt_attr_isa_name(enum BoltAttrISA isa);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,116 @@
+// decodes the same random vertices with the plain C attribute range decoders and with every SIMD version
+// that can run on this machine, checks that they all give bit-identical output, and reports how long each
+// one took. exits with a non-zero status if any output differs.
+// usage: bolt_attr_bench [-n vertices] [-i iterations] [-s seed]
+#include "../attr.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char* format_names[] = {"ubyte_norm", "short"};
+
+static uint64_t rng_state;
+static uint64_t rng_next() {
+    // xorshift64*, so that a given seed gives the same vertices on every machine
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ull;
+}
+
+static uint64_t now_nanos() {
+    struct timespec s;
+    clock_gettime(CLOCK_MONOTONIC, &s);
+    return ((uint64_t)s.tv_sec * 1000000000) + s.tv_nsec;
+}
+
+static BoltAttrDecodeRange kernel_for(const struct BoltAttrKernels* kernels, size_t format) {
+    return format == 0 ? kernels->ubyte_norm : kernels->short_int;
+}
+
+int main(int argc, char** argv) {
+    size_t count = 1 << 16;
+    size_t iterations = 20;
+    rng_state = 0x2F6A1C93E8B4D705ull;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:i:s:")) != -1) {
+        switch (opt) {
+            case 'n': count = strtoull(optarg, NULL, 10); break;
+            case 'i': iterations = strtoull(optarg, NULL, 10); break;
+            case 's': rng_state = strtoull(optarg, NULL, 0) | 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-n vertices] [-i iterations] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (!count || count > 65536 || !iterations) {
+        fprintf(stderr, "-n must be from 1 to 65536, and -i must be at least 1\n");
+        return 2;
+    }
+
+    // vertices are 20 bytes apart, like an interleaved buffer, and are read in a shuffled order like
+    // an index buffer would give. the output records are 44 bytes apart, like render:vertices() uses
+    const size_t stride = 20;
+    const size_t out_stride = 44;
+    uint8_t* vertices = malloc(count * stride);
+    unsigned short* indices = malloc(count * sizeof(*indices));
+    uint8_t* expected = malloc(count * out_stride);
+    uint8_t* actual = malloc(count * out_stride);
+    if (!vertices || !indices || !expected || !actual) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    for (size_t i = 0; i < count * stride; i += 1) vertices[i] = (uint8_t)rng_next();
+    for (size_t i = 0; i < count; i += 1) indices[i] = (unsigned short)i;
+    for (size_t i = count - 1; i > 0; i -= 1) {
+        const size_t j = rng_next() % (i + 1);
+        const unsigned short tmp = indices[i];
+        indices[i] = indices[j];
+        indices[j] = tmp;
+    }
+
+    int failed = 0;
+    printf("%zu vertices, %zu iterations\n", count, iterations);
+    for (size_t format = 0; format < 2; format += 1) {
+        for (size_t num_out = 1; num_out <= 4; num_out += 1) {
+            for (enum BoltAttrISA isa = BOLT_ATTR_SCALAR; isa < BOLT_ATTR_ISA_COUNT; isa += 1) {
+                struct BoltAttrKernels kernels;
+                if (!_bolt_attr_kernels(isa, &kernels)) continue;
+                const BoltAttrDecodeRange decode = kernel_for(&kernels, format);
+                uint8_t* out = isa == BOLT_ATTR_SCALAR ? expected : actual;
+                uint64_t best = UINT64_MAX;
+                for (size_t it = 0; it < iterations; it += 1) {
+                    memset(out, 0xCD, count * out_stride);
+                    const uint64_t start = now_nanos();
+                    decode(vertices, stride, indices, count, num_out, out, out_stride);
+                    const uint64_t elapsed = now_nanos() - start;
+                    if (elapsed < best) best = elapsed;
+                }
+
+                // bytes past each record's floats are compared too, so writing too much counts as a mismatch
+                const char* result = "reference";
+                if (isa != BOLT_ATTR_SCALAR) {
+                    result = "identical";
+                    for (size_t i = 0; i < count * out_stride; i += 1) {
+                        if (expected[i] != actual[i]) {
+                            fprintf(stderr, "%s x%zu %s: vertex %zu byte %zu is %u, expected %u\n", format_names[format], num_out, _bolt_attr_isa_name(isa), i / out_stride, i % out_stride, actual[i], expected[i]);
+                            result = "MISMATCH";
+                            failed = 1;
+                            break;
+                        }
+                    }
+                }
+                printf("%-10s x%zu %-6s %8.3f ms  %8.2f Mvertex/s  %s\n", format_names[format], num_out, _bolt_attr_isa_name(isa), best / 1000000.0, count / (best / 1000.0), result);
+            }
+        }
+    }
+
+    free(vertices);
+    free(indices);
+    free(expected);
+    free(actual);
+    return failed;
+}
@@ -0,0 +1,866 @@
+// replays a trace recorded with BOLT_GL_TRACE (see trace.h) against the real hooks in gl.c and the
+// plugin library, with stub GL functions instead of a driver, and reports how long the hooks took.
+// usage: bolt_hook_bench [-w warmup_frames] [-p path/to/plugin/main.lua]... trace_file
+#include "../gl.h"
+#include "../trace.h"
+#include "../ipc.h"
+#include "../plugin/plugin.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PLUGINS 64
+#define MAX_MAPPINGS 16
+#define GL_INVALID_INDEX 0xFFFFFFFFu
+
+/* allocation counting */
+
+// glibc's own allocator is always available under these names, so the bench can count every call to
+// malloc, calloc and realloc made by gl.c and the plugin library by wrapping them
+static atomic_size_t allocation_count;
+#if defined(__GLIBC__)
+extern void* __libc_malloc(size_t);
+extern void* __libc_calloc(size_t, size_t);
+extern void* __libc_realloc(void*, size_t);
+extern void __libc_free(void*);
+void* malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+void* calloc(size_t n, size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+void* realloc(void* ptr, size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+#define ALLOCATIONS_COUNTED 1
+#else
+#define ALLOCATIONS_COUNTED 0
+#endif
+
+/* the loaded trace */
+
+struct Result {
+    uint8_t func;
+    uint8_t used;
+    const void* data;
+    size_t size;
+    size_t next; // index+1 of the next result for the same call, or 0
+};
+
+struct Call {
+    struct BoltTraceRecord record;
+    size_t first_result; // index+1, or 0
+    size_t last_result;
+};
+
+static struct Call* calls = NULL;
+static size_t call_count = 0;
+static struct Result* results = NULL;
+static size_t result_count = 0;
+static size_t thread_count = 0;
+
+// the call currently being replayed on this thread, so stubs know which results to give back
+static __thread struct Call* current_call = NULL;
+
+static uint8_t load_trace(const char* path, uint8_t** data_out) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("couldn't open '%s': %s\n", path, strerror(errno));
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = malloc(size > 0 ? size : 1);
+    if (size <= 0 || fread(data, 1, size, file) != (size_t)size) {
+        printf("couldn't read '%s'\n", path);
+        fclose(file);
+        free(data);
+        return 0;
+    }
+    fclose(file);
+
+    size_t offset;
+    if (!_bolt_trace_read_header(data, size, &offset)) {
+        printf("'%s' isn't a trace file, or is from a different version of Bolt\n", path);
+        free(data);
+        return 0;
+    }
+
+    size_t call_capacity = 1024, result_capacity = 1024;
+    calls = malloc(call_capacity * sizeof(*calls));
+    results = malloc(result_capacity * sizeof(*results));
+    // index+1 of the latest call on each thread, which is what any results on that thread belong to
+    size_t latest_call[256] = {0};
+    struct BoltTraceRecord record;
+    while (_bolt_trace_read_record(data, size, &offset, &record)) {
+        if (record.thread >= thread_count) thread_count = (size_t)record.thread + 1;
+        if (record.op == TRACE_OP_RESULT) {
+            const size_t call_index = latest_call[record.thread];
+            if (!call_index) continue;
+            if (result_count == result_capacity) {
+                result_capacity *= 2;
+                results = realloc(results, result_capacity * sizeof(*results));
+            }
+            struct BoltTraceCursor cursor;
+            _bolt_trace_cursor_init(&cursor, &record);
+            struct Result* result = &results[result_count];
+            result->func = _bolt_trace_read_u8(&cursor);
+            result->data = _bolt_trace_read_blob(&cursor, &result->size);
+            result->used = 0;
+            result->next = 0;
+            result_count += 1;
+            struct Call* call = &calls[call_index - 1];
+            if (call->last_result) results[call->last_result - 1].next = result_count;
+            else call->first_result = result_count;
+            call->last_result = result_count;
+        } else if (record.op < TRACE_OP_COUNT) {
+            if (call_count == call_capacity) {
+                call_capacity *= 2;
+                calls = realloc(calls, call_capacity * sizeof(*calls));
+            }
+            calls[call_count] = (struct Call){.record = record, .first_result = 0, .last_result = 0};
+            call_count += 1;
+            latest_call[record.thread] = call_count;
+        }
+    }
+    if (offset != (size_t)size) printf("warning: trace is truncated after %zu bytes\n", offset);
+    *data_out = data;
+    return 1;
+}
+
+// finds the next result of the given kind that the driver gave gl.c during the current call, or NULL
+// if there isn't one, in which case the stub has to make something up
+static const struct Result* take_result(enum BoltTraceResult func) {
+    if (!current_call) return NULL;
+    for (size_t i = current_call->first_result; i; i = results[i - 1].next) {
+        struct Result* result = &results[i - 1];
+        if (result->func == func && !result->used) {
+            result->used = 1;
+            return result;
+        }
+    }
+    return NULL;
+}
+
+static uint8_t take_result_into(enum BoltTraceResult func, void* out, size_t size) {
+    const struct Result* result = take_result(func);
+    if (!result) return 0;
+    const size_t n = result->size < size ? result->size : size;
+    if (result->data) memcpy(out, result->data, n);
+    if (n < size) memset((uint8_t*)out + n, 0, size - n);
+    return 1;
+}
+
+/* stub GL functions */
+
+// names given out for objects the trace didn't record a name for, which are well out of the range
+// a real driver would be using at the same time
+static atomic_uint next_fake_name = 1 << 24;
+
+static void stub_gen(enum BoltTraceResult func, GLsizei n, GLuint* out) {
+    if (n <= 0) return;
+    if (take_result_into(func, out, n * sizeof(*out))) return;
+    for (GLsizei i = 0; i < n; i += 1) out[i] = atomic_fetch_add(&next_fake_name, 1);
+}
+
+static GLuint stub_name(enum BoltTraceResult func) {
+    GLuint ret;
+    if (take_result_into(func, &ret, sizeof(ret))) return ret;
+    return atomic_fetch_add(&next_fake_name, 1);
+}
+
+// anything that doesn't return a value or write to a pointer. gl.c casts whatever GetProcAddress gives
+// it to the right type before calling it, which is fine for a function that ignores its arguments
+static void stub_nothing() {}
+
+static GLuint stub_CreateProgram() { return stub_name(TRACE_RESULT_CREATEPROGRAM); }
+static GLuint stub_CreateShader(GLenum type) { return stub_name(TRACE_RESULT_CREATESHADER); }
+static void stub_GenBuffers(GLsizei n, GLuint* out) { stub_gen(TRACE_RESULT_GENBUFFERS, n, out); }
+static void stub_GenFramebuffers(GLsizei n, GLuint* out) { stub_gen(TRACE_RESULT_GENFRAMEBUFFERS, n, out); }
+static void stub_GenVertexArrays(GLsizei n, GLuint* out) { stub_gen(TRACE_RESULT_GENVERTEXARRAYS, n, out); }
+static void stub_GenTextures(GLsizei n, GLuint* out) { stub_gen(TRACE_RESULT_GENTEXTURES, n, out); }
+
+static void stub_GetActiveUniformBlockiv(GLuint program, GLuint index, GLenum pname, GLint* out) {
+    if (!take_result_into(TRACE_RESULT_GETACTIVEUNIFORMBLOCKIV, out, sizeof(*out))) *out = 0;
+}
+
+static void stub_GetActiveUniformsiv(GLuint program, GLsizei count, const GLuint* indices, GLenum pname, GLint* out) {
+    if (count <= 0) return;
+    if (!take_result_into(TRACE_RESULT_GETACTIVEUNIFORMSIV, out, count * sizeof(*out))) memset(out, 0, count * sizeof(*out));
+}
+
+static void stub_GetIntegerv(GLenum pname, GLint* out) {
+    if (take_result_into(TRACE_RESULT_GETINTEGERV, out, sizeof(*out))) return;
+    *out = (pname == GL_MAX_VERTEX_ATTRIBS) ? 16 : 0;
+}
+
+static void stub_GetIntegeri_v(GLenum pname, GLuint index, GLint* out) { *out = 0; }
+static void stub_GetFramebufferAttachmentParameteriv(GLenum target, GLenum attachment, GLenum pname, GLint* out) { *out = 0; }
+static void stub_GetUniformiv(GLuint program, GLint location, GLint* out) { *out = 0; }
+static void stub_GetUniformfv(GLuint program, GLint location, GLfloat* out) { memset(out, 0, 16 * sizeof(*out)); }
+
+static GLuint stub_GetUniformBlockIndex(GLuint program, const GLchar* name) {
+    GLuint ret;
+    return take_result_into(TRACE_RESULT_GETUNIFORMBLOCKINDEX, &ret, sizeof(ret)) ? ret : GL_INVALID_INDEX;
+}
+
+static void stub_GetUniformIndices(GLuint program, GLsizei count, const GLchar** names, GLuint* out) {
+    if (count <= 0) return;
+    if (take_result_into(TRACE_RESULT_GETUNIFORMINDICES, out, count * sizeof(*out))) return;
+    for (GLsizei i = 0; i < count; i += 1) out[i] = GL_INVALID_INDEX;
+}
+
+static GLint stub_GetUniformLocation(GLuint program, const GLchar* name) {
+    GLint ret;
+    return take_result_into(TRACE_RESULT_GETUNIFORMLOCATION, &ret, sizeof(ret)) ? ret : -1;
+}
+
+// memory handed out by the MapBufferRange stub, one per buffer target, which is only reallocated when
+// a bigger mapping is asked for, so that the allocation counts are about gl.c and not the stubs
+struct StubMapping {
+    GLenum target;
+    void* data;
+    size_t capacity;
+};
+static struct StubMapping stub_mappings[MAX_MAPPINGS];
+static pthread_mutex_t stub_mappings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void* stub_MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    pthread_mutex_lock(&stub_mappings_lock);
+    struct StubMapping* mapping = NULL;
+    for (size_t i = 0; i < MAX_MAPPINGS; i += 1) {
+        if (stub_mappings[i].target == target || !stub_mappings[i].data) {
+            mapping = &stub_mappings[i];
+            break;
+        }
+    }
+    if (!mapping) {
+        pthread_mutex_unlock(&stub_mappings_lock);
+        return NULL;
+    }
+    mapping->target = target;
+    if (mapping->capacity < length) {
+        free(mapping->data);
+        mapping->data = malloc(length);
+        mapping->capacity = length;
+    }
+    void* ret = mapping->data;
+    pthread_mutex_unlock(&stub_mappings_lock);
+    if (!(access & GL_MAP_READ_BIT) || !take_result_into(TRACE_RESULT_MAPBUFFERRANGE, ret, length)) memset(ret, 0, length);
+    return ret;
+}
+
+static GLboolean stub_UnmapBuffer(GLenum target) {
+    GLboolean ret;
+    return take_result_into(TRACE_RESULT_UNMAPBUFFER, &ret, sizeof(ret)) ? ret : 1;
+}
+
+static GLenum stub_ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    GLenum ret;
+    return take_result_into(TRACE_RESULT_CLIENTWAITSYNC, &ret, sizeof(ret)) ? ret : GL_ALREADY_SIGNALED;
+}
+
+static uint8_t stub_sync_object;
+static GLsync stub_FenceSync(GLenum condition, GLbitfield flags) { return (GLsync)&stub_sync_object; }
+static GLenum stub_GetError() { return 0; }
+static GLboolean stub_IsEnabled() { return 0; }
+
+static void* stub_GetProcAddress(const char* name) {
+#define STUB(NAME, FUNC) if (!strcmp(name, "gl"#NAME)) return (void*)(FUNC);
+    STUB(CreateProgram, stub_CreateProgram)
+    STUB(CreateShader, stub_CreateShader)
+    STUB(GenBuffers, stub_GenBuffers)
+    STUB(GenFramebuffers, stub_GenFramebuffers)
+    STUB(GenVertexArrays, stub_GenVertexArrays)
+    STUB(GetActiveUniformBlockiv, stub_GetActiveUniformBlockiv)
+    STUB(GetActiveUniformsiv, stub_GetActiveUniformsiv)
+    STUB(GetFramebufferAttachmentParameteriv, stub_GetFramebufferAttachmentParameteriv)
+    STUB(GetIntegeri_v, stub_GetIntegeri_v)
+    STUB(GetIntegerv, stub_GetIntegerv)
+    STUB(GetUniformBlockIndex, stub_GetUniformBlockIndex)
+    STUB(GetUniformfv, stub_GetUniformfv)
+    STUB(GetUniformIndices, stub_GetUniformIndices)
+    STUB(GetUniformiv, stub_GetUniformiv)
+    STUB(GetUniformLocation, stub_GetUniformLocation)
+    STUB(MapBufferRange, stub_MapBufferRange)
+    STUB(UnmapBuffer, stub_UnmapBuffer)
+    STUB(ClientWaitSync, stub_ClientWaitSync)
+    STUB(FenceSync, stub_FenceSync)
+#undef STUB
+    // no EGL, so gl.c acts as if shared textures aren't supported
+    if (!strncmp(name, "egl", 3) || !strcmp(name, "glEGLImageTargetTexture2DOES")) return NULL;
+    return (void*)stub_nothing;
+}
+
+static const struct GLLibFunctions stub_libgl = {
+    .BindTexture = (void*)stub_nothing,
+    .Clear = (void*)stub_nothing,
+    .ClearColor = (void*)stub_nothing,
+    .DeleteTextures = (void*)stub_nothing,
+    .Disable = (void*)stub_nothing,
+    .DrawArrays = (void*)stub_nothing,
+    .DrawElements = (void*)stub_nothing,
+    .Enable = (void*)stub_nothing,
+    .Flush = (void*)stub_nothing,
+    .GenTextures = stub_GenTextures,
+    .GetError = stub_GetError,
+    .IsEnabled = stub_IsEnabled,
+    .PixelStorei = (void*)stub_nothing,
+    .ReadPixels = (void*)stub_nothing,
+    .TexParameteri = (void*)stub_nothing,
+    .TexSubImage2D = (void*)stub_nothing,
+    .Viewport = (void*)stub_nothing,
+};
+
+/* a stand-in for the launcher's end of the IPC socket */
+
+static int host_listen_fd = -1;
+static char host_dir[64];
+static const char* plugin_mains[MAX_PLUGINS];
+static size_t plugin_count = 0;
+
+static void* host_thread(void* arg) {
+    const int fd = accept(host_listen_fd, NULL, NULL);
+    if (fd == -1) return NULL;
+    char config_path[128];
+    const int config_path_size = snprintf(config_path, sizeof(config_path), "%s/config/", host_dir);
+    for (size_t i = 0; i < plugin_count; i += 1) {
+        const char* main = plugin_mains[i];
+        const char* slash = strrchr(main, '/');
+        const char* dir = slash ? main : "./";
+        const size_t dir_size = slash ? (size_t)(slash - main) + 1 : 2;
+        const char* file = slash ? slash + 1 : main;
+        const enum BoltIPCMessageTypeToClient msg_type = IPC_MSG_STARTPLUGIN;
+        const struct BoltIPCStartPluginHeader header = {
+            .uid = i + 1,
+            .path_size = dir_size,
+            .main_size = strlen(file),
+            .config_path_size = config_path_size,
+        };
+        const struct BoltIPCBuffer buffers[] = {
+            {.data = &msg_type, .len = sizeof(msg_type)},
+            {.data = &header, .len = sizeof(header)},
+            {.data = dir, .len = header.path_size},
+            {.data = file, .len = header.main_size},
+            {.data = config_path, .len = header.config_path_size},
+        };
+        _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
+    }
+    // never accept a ring, so everything the client sends stays on the socket and can just be thrown away
+    uint8_t buf[65536];
+    while (recv(fd, buf, sizeof(buf), 0) > 0);
+    close(fd);
+    return NULL;
+}
+
+static uint8_t host_start() {
+    strcpy(host_dir, "/tmp/bolt-hook-bench-XXXXXX");
+    if (!mkdtemp(host_dir)) {
+        printf("couldn't create a temporary directory: %s\n", strerror(errno));
+        return 0;
+    }
+    char path[128];
+    snprintf(path, sizeof(path), "%s/bolt-launcher", host_dir);
+    mkdir(path, 0700);
+    snprintf(path, sizeof(path), "%s/config", host_dir);
+    mkdir(path, 0700);
+    setenv("XDG_RUNTIME_DIR", host_dir, 1);
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    snprintf(addr.sun_path, sizeof(addr.sun_path) - 1, "%s/bolt-launcher/ipc-0", host_dir);
+    host_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (host_listen_fd == -1 || bind(host_listen_fd, (const struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(host_listen_fd, 1) == -1) {
+        printf("couldn't listen on '%s': %s\n", addr.sun_path, strerror(errno));
+        return 0;
+    }
+    pthread_t thread;
+    pthread_create(&thread, NULL, host_thread, NULL);
+    pthread_detach(thread);
+    return 1;
+}
+
+/* cache miss counting */
+
+static int perf_open() {
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HARDWARE,
+        .size = sizeof(attr),
+        .config = PERF_COUNT_HW_CACHE_MISSES,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t perf_read(int fd) {
+    uint64_t value = 0;
+    if (fd == -1 || read(fd, &value, sizeof(value)) != sizeof(value)) return 0;
+    return value;
+}
+
+/* replay */
+
+struct OpStats {
+    uint64_t calls;
+    uint64_t nanos;
+};
+
+static struct GLProcFunctions hooks;
+static uint8_t hooks_loaded = 0;
+static struct OpStats op_stats[TRACE_OP_COUNT];
+static uint64_t frames = 0;
+static uint64_t warmup_frames = 0;
+static uint8_t measuring = 0;
+static uint64_t measure_start_allocations = 0;
+static atomic_uint_fast64_t cache_misses;
+static uint8_t cache_misses_counted = 1;
+
+// what the MapBufferRange hook returned for each target, so the replay knows where the game would have
+// written the data that gl.c saw at FlushMappedBufferRange
+static struct { GLenum target; uint8_t* ptr; } replay_mappings[MAX_MAPPINGS];
+
+static GLuint* replay_names(const void* blob, size_t size, GLsizei* n) {
+    static GLuint* names = NULL;
+    static size_t capacity = 0;
+    *n = (GLsizei)(size / sizeof(GLuint));
+    if (size > capacity) {
+        free(names);
+        names = malloc(size);
+        capacity = size;
+    }
+    if (blob) memcpy(names, blob, size);
+    return names;
+}
+
+static GLuint* replay_gen_names(uint32_t n) {
+    GLsizei unused;
+    return replay_names(NULL, (size_t)n * sizeof(GLuint), &unused);
+}
+
+static void load_hooks() {
+#define LOAD_HOOK(NAME) hooks.NAME = _bolt_gl_GetProcAddress("gl"#NAME);
+    LOAD_HOOK(CreateProgram)
+    LOAD_HOOK(DeleteProgram)
+    LOAD_HOOK(BindAttribLocation)
+    LOAD_HOOK(LinkProgram)
+    LOAD_HOOK(UseProgram)
+    LOAD_HOOK(TexStorage2D)
+    LOAD_HOOK(VertexAttribPointer)
+    LOAD_HOOK(GenBuffers)
+    LOAD_HOOK(BufferData)
+    LOAD_HOOK(DeleteBuffers)
+    LOAD_HOOK(BindFramebuffer)
+    LOAD_HOOK(CompressedTexSubImage2D)
+    LOAD_HOOK(CopyImageSubData)
+    LOAD_HOOK(EnableVertexAttribArray)
+    LOAD_HOOK(DisableVertexAttribArray)
+    LOAD_HOOK(MapBufferRange)
+    LOAD_HOOK(UnmapBuffer)
+    LOAD_HOOK(BufferStorage)
+    LOAD_HOOK(FlushMappedBufferRange)
+    LOAD_HOOK(ActiveTexture)
+    LOAD_HOOK(GenVertexArrays)
+    LOAD_HOOK(DeleteVertexArrays)
+    LOAD_HOOK(BindVertexArray)
+    LOAD_HOOK(BlitFramebuffer)
+    LOAD_HOOK(GenFramebuffers)
+    LOAD_HOOK(DeleteFramebuffers)
+    LOAD_HOOK(FramebufferTexture)
+    LOAD_HOOK(FramebufferTexture2D)
+    LOAD_HOOK(FramebufferTextureLayer)
+    LOAD_HOOK(FramebufferRenderbuffer)
+    LOAD_HOOK(BindBuffer)
+    LOAD_HOOK(BindBufferBase)
+    LOAD_HOOK(BindBufferRange)
+    LOAD_HOOK(UniformBlockBinding)
+    LOAD_HOOK(Uniform1i)
+    LOAD_HOOK(Uniform1iv)
+    LOAD_HOOK(Uniform4f)
+    LOAD_HOOK(Uniform4fv)
+    LOAD_HOOK(UniformMatrix4fv)
+#undef LOAD_HOOK
+    hooks_loaded = 1;
+}
+
+// calls whichever hook the record is for, with the arguments it was recorded with. hooks the stub GL
+// doesn't provide are skipped, since the game wouldn't have been able to get them either
+static void dispatch(const struct BoltTraceRecord* record) {
+    struct BoltTraceCursor c;
+    _bolt_trace_cursor_init(&c, record);
+#define U8 _bolt_trace_read_u8(&c)
+#define U32 _bolt_trace_read_u32(&c)
+#define U64 _bolt_trace_read_u64(&c)
+#define F32 _bolt_trace_read_f32(&c)
+#define CALL(NAME, ...) if (hooks.NAME) hooks.NAME(__VA_ARGS__); break;
+    switch (record->op) {
+        case TRACE_OP_CREATECONTEXT: {
+            const uint64_t context = U64;
+            const uint64_t shared = U64;
+            const uint8_t important = U8;
+            _bolt_gl_onCreateContext((void*)(uintptr_t)context, (void*)(uintptr_t)shared, &stub_libgl, stub_GetProcAddress, important);
+            if (!hooks_loaded) load_hooks();
+            break;
+        }
+        case TRACE_OP_MAKECURRENT: _bolt_gl_onMakeCurrent((void*)(uintptr_t)U64); break;
+        case TRACE_OP_DESTROYCONTEXT: _bolt_gl_onDestroyContext((void*)(uintptr_t)U64); break;
+        case TRACE_OP_SWAPBUFFERS: {
+            const uint32_t width = U32;
+            const uint32_t height = U32;
+            _bolt_gl_onSwapBuffers(width, height);
+            break;
+        }
+        case TRACE_OP_GENTEXTURES: case TRACE_OP_DELETETEXTURES: {
+            size_t size;
+            const void* blob = _bolt_trace_read_blob(&c, &size);
+            GLsizei n;
+            GLuint* names = replay_names(blob, size, &n);
+            if (record->op == TRACE_OP_GENTEXTURES) _bolt_gl_onGenTextures(n, names);
+            else _bolt_gl_onDeleteTextures(n, names);
+            break;
+        }
+        case TRACE_OP_DRAWELEMENTS: {
+            const uint32_t mode = U32, count = U32, type = U32;
+            _bolt_gl_onDrawElements(mode, count, type, (const void*)(uintptr_t)U64);
+            break;
+        }
+        case TRACE_OP_DRAWARRAYS: {
+            const uint32_t mode = U32, first = U32;
+            _bolt_gl_onDrawArrays(mode, first, U32);
+            break;
+        }
+        case TRACE_OP_BINDTEXTURE: {
+            const uint32_t target = U32;
+            _bolt_gl_onBindTexture(target, U32);
+            break;
+        }
+        case TRACE_OP_TEXSUBIMAGE2D: {
+            const uint32_t target = U32, level = U32, x = U32, y = U32, w = U32, h = U32, format = U32, type = U32;
+            const uint64_t pointer = U64;
+            size_t size;
+            const void* pixels = _bolt_trace_read_blob(&c, &size);
+            _bolt_gl_onTexSubImage2D(target, level, x, y, w, h, format, type, pixels ? pixels : (const void*)(uintptr_t)pointer);
+            break;
+        }
+        case TRACE_OP_CLEAR: _bolt_gl_onClear(U32); break;
+        case TRACE_OP_VIEWPORT: {
+            const uint32_t x = U32, y = U32, w = U32;
+            _bolt_gl_onViewport(x, y, w, U32);
+            break;
+        }
+        case TRACE_OP_PIXELSTOREI: {
+            const uint32_t pname = U32;
+            _bolt_gl_onPixelStorei(pname, U32);
+            break;
+        }
+        case TRACE_OP_CREATEPROGRAM: if (hooks.CreateProgram) hooks.CreateProgram(); break;
+        case TRACE_OP_DELETEPROGRAM: CALL(DeleteProgram, U32)
+        case TRACE_OP_BINDATTRIBLOCATION: {
+            const uint32_t program = U32, index = U32;
+            size_t size;
+            const char* name = _bolt_trace_read_blob(&c, &size);
+            CALL(BindAttribLocation, program, index, name ? name : "")
+        }
+        case TRACE_OP_LINKPROGRAM: CALL(LinkProgram, U32)
+        case TRACE_OP_USEPROGRAM: CALL(UseProgram, U32)
+        case TRACE_OP_TEXSTORAGE2D: {
+            const uint32_t target = U32, levels = U32, format = U32, w = U32;
+            CALL(TexStorage2D, target, levels, format, w, U32)
+        }
+        case TRACE_OP_VERTEXATTRIBPOINTER: {
+            const uint32_t index = U32, size = U32, type = U32, normalised = U32, stride = U32;
+            CALL(VertexAttribPointer, index, size, type, normalised, stride, (const void*)(uintptr_t)U64)
+        }
+        case TRACE_OP_GENBUFFERS: { const uint32_t n = U32; CALL(GenBuffers, n, replay_gen_names(n)) }
+        case TRACE_OP_GENFRAMEBUFFERS: { const uint32_t n = U32; CALL(GenFramebuffers, n, replay_gen_names(n)) }
+        case TRACE_OP_GENVERTEXARRAYS: { const uint32_t n = U32; CALL(GenVertexArrays, n, replay_gen_names(n)) }
+        case TRACE_OP_BUFFERDATA: case TRACE_OP_BUFFERSTORAGE: {
+            const uint32_t target = U32;
+            const uint64_t size = U64;
+            size_t blob_size;
+            const void* data = _bolt_trace_read_blob(&c, &blob_size);
+            const uint32_t usage = U32;
+            if (record->op == TRACE_OP_BUFFERDATA) { CALL(BufferData, target, size, data, usage) }
+            else { CALL(BufferStorage, target, size, data, usage) }
+        }
+        case TRACE_OP_DELETEBUFFERS: case TRACE_OP_DELETEFRAMEBUFFERS: case TRACE_OP_DELETEVERTEXARRAYS: {
+            size_t size;
+            const void* blob = _bolt_trace_read_blob(&c, &size);
+            GLsizei n;
+            GLuint* names = replay_names(blob, size, &n);
+            if (record->op == TRACE_OP_DELETEBUFFERS) { CALL(DeleteBuffers, n, names) }
+            else if (record->op == TRACE_OP_DELETEFRAMEBUFFERS) { CALL(DeleteFramebuffers, n, names) }
+            else { CALL(DeleteVertexArrays, n, names) }
+        }
+        case TRACE_OP_BINDFRAMEBUFFER: { const uint32_t target = U32; CALL(BindFramebuffer, target, U32) }
+        case TRACE_OP_FRAMEBUFFERTEXTURE: {
+            const uint32_t target = U32, attachment = U32, texture = U32;
+            CALL(FramebufferTexture, target, attachment, texture, U32)
+        }
+        case TRACE_OP_FRAMEBUFFERTEXTURE2D: {
+            const uint32_t target = U32, attachment = U32, textarget = U32, texture = U32;
+            CALL(FramebufferTexture2D, target, attachment, textarget, texture, U32)
+        }
+        case TRACE_OP_FRAMEBUFFERTEXTURELAYER: {
+            const uint32_t target = U32, attachment = U32, texture = U32, level = U32;
+            CALL(FramebufferTextureLayer, target, attachment, texture, level, U32)
+        }
+        case TRACE_OP_FRAMEBUFFERRENDERBUFFER: {
+            const uint32_t target = U32, attachment = U32, rb_target = U32;
+            CALL(FramebufferRenderbuffer, target, attachment, rb_target, U32)
+        }
+        case TRACE_OP_BINDBUFFER: { const uint32_t target = U32; CALL(BindBuffer, target, U32) }
+        case TRACE_OP_BINDBUFFERBASE: {
+            const uint32_t target = U32, index = U32;
+            CALL(BindBufferBase, target, index, U32)
+        }
+        case TRACE_OP_BINDBUFFERRANGE: {
+            const uint32_t target = U32, index = U32, buffer = U32;
+            const uint64_t offset = U64;
+            CALL(BindBufferRange, target, index, buffer, offset, U64)
+        }
+        case TRACE_OP_UNIFORMBLOCKBINDING: {
+            const uint32_t program = U32, index = U32;
+            CALL(UniformBlockBinding, program, index, U32)
+        }
+        case TRACE_OP_UNIFORM1I: { const uint32_t location = U32; CALL(Uniform1i, location, U32) }
+        case TRACE_OP_UNIFORM1IV: case TRACE_OP_UNIFORM4FV: case TRACE_OP_UNIFORMMATRIX4FV: {
+            const uint32_t location = U32;
+            const uint32_t transpose = record->op == TRACE_OP_UNIFORMMATRIX4FV ? U32 : 0;
+            size_t size;
+            const void* values = _bolt_trace_read_blob(&c, &size);
+            if (record->op == TRACE_OP_UNIFORM1IV) { CALL(Uniform1iv, location, size / sizeof(GLint), values) }
+            else if (record->op == TRACE_OP_UNIFORM4FV) { CALL(Uniform4fv, location, size / (4 * sizeof(GLfloat)), values) }
+            else { CALL(UniformMatrix4fv, location, size / (16 * sizeof(GLfloat)), transpose, values) }
+        }
+        case TRACE_OP_UNIFORM4F: {
+            const uint32_t location = U32;
+            const float v0 = F32, v1 = F32, v2 = F32;
+            CALL(Uniform4f, location, v0, v1, v2, F32)
+        }
+        case TRACE_OP_COMPRESSEDTEXSUBIMAGE2D: {
+            const uint32_t target = U32, level = U32, x = U32, y = U32, w = U32, h = U32, format = U32, image_size = U32;
+            const uint64_t pointer = U64;
+            size_t size;
+            const void* data = _bolt_trace_read_blob(&c, &size);
+            CALL(CompressedTexSubImage2D, target, level, x, y, w, h, format, image_size, data ? data : (const void*)(uintptr_t)pointer)
+        }
+        case TRACE_OP_COPYIMAGESUBDATA: {
+            uint32_t a[15];
+            for (size_t i = 0; i < 15; i += 1) a[i] = U32;
+            CALL(CopyImageSubData, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9], a[10], a[11], a[12], a[13], a[14])
+        }
+        case TRACE_OP_ENABLEVERTEXATTRIBARRAY: CALL(EnableVertexAttribArray, U32)
+        case TRACE_OP_DISABLEVERTEXATTRIBARRAY: CALL(DisableVertexAttribArray, U32)
+        case TRACE_OP_MAPBUFFERRANGE: {
+            const uint32_t target = U32;
+            const uint64_t offset = U64, length = U64;
+            const uint32_t access = U32;
+            if (!hooks.MapBufferRange) break;
+            uint8_t* ptr = hooks.MapBufferRange(target, offset, length, access);
+            for (size_t i = 0; i < MAX_MAPPINGS; i += 1) {
+                if (replay_mappings[i].target == target || !replay_mappings[i].ptr) {
+                    replay_mappings[i].target = target;
+                    replay_mappings[i].ptr = ptr;
+                    break;
+                }
+            }
+            break;
+        }
+        case TRACE_OP_UNMAPBUFFER: CALL(UnmapBuffer, U32)
+        case TRACE_OP_FLUSHMAPPEDBUFFERRANGE: {
+            const uint32_t target = U32;
+            const uint64_t offset = U64, length = U64;
+            size_t size;
+            const void* data = _bolt_trace_read_blob(&c, &size);
+            if (data) {
+                for (size_t i = 0; i < MAX_MAPPINGS; i += 1) {
+                    if (replay_mappings[i].target == target && replay_mappings[i].ptr) {
+                        memcpy(replay_mappings[i].ptr + offset, data, size < length ? size : length);
+                        break;
+                    }
+                }
+            }
+            CALL(FlushMappedBufferRange, target, offset, length)
+        }
+        case TRACE_OP_ACTIVETEXTURE: CALL(ActiveTexture, U32)
+        case TRACE_OP_BINDVERTEXARRAY: CALL(BindVertexArray, U32)
+        case TRACE_OP_BLITFRAMEBUFFER: {
+            uint32_t a[10];
+            for (size_t i = 0; i < 10; i += 1) a[i] = U32;
+            CALL(BlitFramebuffer, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9])
+        }
+        default: break;
+    }
+#undef CALL
+#undef F32
+#undef U64
+#undef U32
+#undef U8
+}
+
+static uint64_t now_nanos() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// records are replayed strictly in order, but each one on its own recorded thread, since gl.c keeps
+// the current context per thread. only the thread whose turn it is runs; the rest wait on a condition
+static pthread_mutex_t baton_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t baton_cond = PTHREAD_COND_INITIALIZER;
+static size_t next_call = 0;
+
+static void replay_thread(uint8_t thread) {
+    const int perf_fd = perf_open();
+    if (perf_fd == -1) cache_misses_counted = 0;
+    if (thread_count > 1) pthread_mutex_lock(&baton_lock);
+    while (1) {
+        if (thread_count > 1) {
+            while (next_call < call_count && calls[next_call].record.thread != thread) pthread_cond_wait(&baton_cond, &baton_lock);
+            pthread_mutex_unlock(&baton_lock);
+        }
+        if (next_call >= call_count) break;
+
+        uint64_t misses_start = perf_read(perf_fd);
+        while (next_call < call_count && calls[next_call].record.thread == thread) {
+            struct Call* call = &calls[next_call];
+            current_call = call;
+            const uint64_t start = now_nanos();
+            dispatch(&call->record);
+            const uint64_t elapsed = now_nanos() - start;
+            current_call = NULL;
+            if (measuring) {
+                op_stats[call->record.op].calls += 1;
+                op_stats[call->record.op].nanos += elapsed;
+            }
+            if (call->record.op == TRACE_OP_SWAPBUFFERS) {
+                frames += 1;
+                if (frames == warmup_frames) {
+                    measuring = 1;
+                    measure_start_allocations = atomic_load(&allocation_count);
+                    misses_start = perf_read(perf_fd);
+                }
+            }
+            next_call += 1;
+        }
+        if (measuring) atomic_fetch_add(&cache_misses, perf_read(perf_fd) - misses_start);
+
+        if (thread_count > 1) {
+            pthread_mutex_lock(&baton_lock);
+            pthread_cond_broadcast(&baton_cond);
+        }
+    }
+    if (perf_fd != -1) close(perf_fd);
+}
+
+static void* replay_thread_main(void* arg) {
+    replay_thread((uint8_t)(uintptr_t)arg);
+    return NULL;
+}
+
+static void print_stats() {
+    static const char* names[] = {
+        "", "CreateContext", "MakeCurrent", "DestroyContext", "SwapBuffers", "GenTextures", "DrawElements",
+        "DrawArrays", "BindTexture", "TexSubImage2D", "DeleteTextures", "Clear", "Viewport", "PixelStorei",
+        "CreateProgram", "DeleteProgram", "BindAttribLocation", "LinkProgram", "UseProgram", "TexStorage2D",
+        "VertexAttribPointer", "GenBuffers", "BufferData", "DeleteBuffers", "BindFramebuffer", "GenFramebuffers",
+        "DeleteFramebuffers", "FramebufferTexture", "FramebufferTexture2D", "FramebufferTextureLayer",
+        "FramebufferRenderbuffer", "BindBuffer", "BindBufferBase", "BindBufferRange", "UniformBlockBinding",
+        "Uniform1i", "Uniform1iv", "Uniform4f", "Uniform4fv", "UniformMatrix4fv", "CompressedTexSubImage2D",
+        "CopyImageSubData", "EnableVertexAttribArray", "DisableVertexAttribArray", "MapBufferRange", "UnmapBuffer",
+        "BufferStorage", "FlushMappedBufferRange", "ActiveTexture", "GenVertexArrays", "DeleteVertexArrays",
+        "BindVertexArray", "BlitFramebuffer",
+    };
+    _Static_assert(sizeof(names) / sizeof(*names) == TRACE_OP_COUNT, "names doesn't match BoltTraceOp");
+    uint64_t total_nanos = 0;
+    for (size_t i = 0; i < TRACE_OP_COUNT; i += 1) total_nanos += op_stats[i].nanos;
+    const uint64_t measured_frames = frames > warmup_frames ? frames - warmup_frames : 0;
+    const uint64_t draws = op_stats[TRACE_OP_DRAWELEMENTS].calls + op_stats[TRACE_OP_DRAWARRAYS].calls;
+    const uint64_t draw_nanos = op_stats[TRACE_OP_DRAWELEMENTS].nanos + op_stats[TRACE_OP_DRAWARRAYS].nanos;
+    const uint64_t allocations = atomic_load(&allocation_count) - measure_start_allocations;
+
+    printf("%llu frames measured (%llu warmup), %zu threads, %zu plugins\n", (unsigned long long)measured_frames,
+        (unsigned long long)(frames < warmup_frames ? frames : warmup_frames), thread_count, plugin_count);
+    if (!measured_frames) {
+        printf("nothing measured; the trace has no more than %llu frames\n", (unsigned long long)warmup_frames);
+        return;
+    }
+    printf("  ns/frame:          %.1f\n", (double)total_nanos / measured_frames);
+    printf("  ns/draw:           %.1f\n", draws ? (double)draw_nanos / draws : 0.0);
+    if (ALLOCATIONS_COUNTED) printf("  allocations/frame: %.1f\n", (double)allocations / measured_frames);
+    else printf("  allocations/frame: n/a\n");
+    if (cache_misses_counted) printf("  cache misses/frame: %.1f\n", (double)atomic_load(&cache_misses) / measured_frames);
+    else printf("  cache misses/frame: n/a (perf events unavailable)\n");
+    printf("\n  %-26s %12s %14s %10s\n", "hook", "calls", "total ns", "ns/call");
+    for (size_t i = 1; i < TRACE_OP_COUNT; i += 1) {
+        if (!op_stats[i].calls) continue;
+        printf("  %-26s %12llu %14llu %10.1f\n", names[i], (unsigned long long)op_stats[i].calls,
+            (unsigned long long)op_stats[i].nanos, (double)op_stats[i].nanos / op_stats[i].calls);
+    }
+}
+
+int main(int argc, char** argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "w:p:")) != -1) {
+        switch (opt) {
+            case 'w':
+                warmup_frames = strtoull(optarg, NULL, 10);
+                break;
+            case 'p':
+                if (plugin_count < MAX_PLUGINS) plugin_mains[plugin_count++] = optarg;
+                break;
+            default:
+                printf("usage: %s [-w warmup_frames] [-p path/to/plugin/main.lua]... trace_file\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        printf("usage: %s [-w warmup_frames] [-p path/to/plugin/main.lua]... trace_file\n", argv[0]);
+        return 1;
+    }
+
+    uint8_t* trace_data;
+    if (!load_trace(argv[optind], &trace_data)) return 1;
+    printf("loaded %zu calls and %zu results\n", call_count, result_count);
+    if (!host_start()) return 1;
+
+    // don't record the replay over the top of the trace being replayed
+    unsetenv("BOLT_GL_TRACE");
+    _bolt_plugin_on_startup();
+    if (warmup_frames == 0) {
+        measuring = 1;
+        measure_start_allocations = atomic_load(&allocation_count);
+    }
+
+    pthread_t threads[256];
+    for (size_t i = 1; i < thread_count; i += 1) pthread_create(&threads[i], NULL, replay_thread_main, (void*)(uintptr_t)i);
+    replay_thread(0);
+    for (size_t i = 1; i < thread_count; i += 1) pthread_join(threads[i], NULL);
+
+    print_stats();
+    // gl.c and the plugin library aren't closed, since a trace usually ends with the game still running,
+    // so there's nothing to shut them down cleanly in the order they expect
+    char path[128];
+    snprintf(path, sizeof(path), "%s/bolt-launcher/ipc-0", host_dir);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,145 @@
+// decodes the same S3TC blocks with the plain C decoders and with every SIMD version that can run on
+// this machine, checks that they all give byte-identical output, and reports how long each one took.
+// exits with a non-zero status if any output differs.
+// usage: bolt_s3tc_bench [-n blocks_per_side] [-i iterations] [-s seed]
+#include "../s3tc.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char* format_names[] = {"dxt1", "dxt1a", "dxt3", "dxt5"};
+
+static uint64_t rng_state;
+static uint64_t rng_next() {
+    // xorshift64*, so that a given seed gives the same blocks on every machine
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ull;
+}
+
+static uint64_t now_nanos() {
+    struct timespec s;
+    clock_gettime(CLOCK_MONOTONIC, &s);
+    return ((uint64_t)s.tv_sec * 1000000000) + s.tv_nsec;
+}
+
+static BoltS3TCDecodeBlock kernel_for(const struct BoltS3TCKernels* kernels, size_t format) {
+    switch (format) {
+        case 0: return kernels->dxt1;
+        case 1: return kernels->dxt1a;
+        case 2: return kernels->dxt3;
+        default: return kernels->dxt5;
+    }
+}
+
+// fills `blocks` with random data, then forces both orderings of each pair of endpoints into some of
+// them so that every mode of both tables gets checked
+static void make_blocks(uint8_t* blocks, size_t count, size_t block_size) {
+    for (size_t i = 0; i < count * block_size; i += 8) {
+        const uint64_t r = rng_next();
+        memcpy(blocks + i, &r, 8);
+    }
+    for (size_t i = 0; i < count; i += 1) {
+        uint8_t* block = blocks + (i * block_size);
+        uint8_t* colour = block + (block_size - 8);
+        uint8_t tmp;
+        switch (i % 4) {
+            case 0:
+                // c0 <= c1, and alpha0 <= alpha1 for DXT5
+                if (colour[1] > colour[3] || (colour[1] == colour[3] && colour[0] > colour[2])) {
+                    tmp = colour[0]; colour[0] = colour[2]; colour[2] = tmp;
+                    tmp = colour[1]; colour[1] = colour[3]; colour[3] = tmp;
+                }
+                if (block_size == 16 && block[0] > block[1]) { tmp = block[0]; block[0] = block[1]; block[1] = tmp; }
+                break;
+            case 1:
+                // equal endpoints
+                colour[2] = colour[0];
+                colour[3] = colour[1];
+                if (block_size == 16) block[1] = block[0];
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t side = 512;
+    size_t iterations = 20;
+    rng_state = 0x5D3C7AF1B2E94606ull;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:i:s:")) != -1) {
+        switch (opt) {
+            case 'n': side = strtoull(optarg, NULL, 10); break;
+            case 'i': iterations = strtoull(optarg, NULL, 10); break;
+            case 's': rng_state = strtoull(optarg, NULL, 0) | 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-n blocks_per_side] [-i iterations] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (!side || !iterations) {
+        fprintf(stderr, "-n and -i must be at least 1\n");
+        return 2;
+    }
+
+    const size_t count = side * side;
+    const size_t stride = side * 16;
+    uint8_t* blocks = malloc(count * 16);
+    uint8_t* expected = malloc(count * 64);
+    uint8_t* actual = malloc(count * 64);
+    if (!blocks || !expected || !actual) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+
+    int failed = 0;
+    printf("%zux%zu blocks (%zux%zu pixels), %zu iterations\n", side, side, side * 4, side * 4, iterations);
+    for (size_t format = 0; format < 4; format += 1) {
+        const size_t block_size = format < 2 ? 8 : 16;
+        make_blocks(blocks, count, block_size);
+        for (enum BoltS3TCISA isa = BOLT_S3TC_SCALAR; isa < BOLT_S3TC_ISA_COUNT; isa += 1) {
+            struct BoltS3TCKernels kernels;
+            if (!_bolt_s3tc_kernels(isa, &kernels)) continue;
+            const BoltS3TCDecodeBlock decode = kernel_for(&kernels, format);
+            uint8_t* out = isa == BOLT_S3TC_SCALAR ? expected : actual;
+            uint64_t best = UINT64_MAX;
+            for (size_t it = 0; it < iterations; it += 1) {
+                memset(out, 0xCD, count * 64);
+                const uint64_t start = now_nanos();
+                for (size_t by = 0; by < side; by += 1) {
+                    for (size_t bx = 0; bx < side; bx += 1) {
+                        decode(blocks + (((by * side) + bx) * block_size), out + (by * 4 * stride) + (bx * 16), stride);
+                    }
+                }
+                const uint64_t elapsed = now_nanos() - start;
+                if (elapsed < best) best = elapsed;
+            }
+
+            const char* result = "reference";
+            if (isa != BOLT_S3TC_SCALAR) {
+                result = "identical";
+                for (size_t i = 0; i < count * 64; i += 1) {
+                    if (expected[i] != actual[i]) {
+                        const size_t px = (i % stride) / 4, py = i / stride;
+                        fprintf(stderr, "%s %s: pixel %zu,%zu byte %zu is %u, expected %u\n", format_names[format], _bolt_s3tc_isa_name(isa), px, py, i % 4, actual[i], expected[i]);
+                        result = "MISMATCH";
+                        failed = 1;
+                        break;
+                    }
+                }
+            }
+            printf("%-5s %-6s %8.3f ms  %7.2f Mpx/s  %s\n", format_names[format], _bolt_s3tc_isa_name(isa), best / 1000000.0, (count * 16) / (best / 1000.0), result);
+        }
+    }
+
+    free(blocks);
+    free(expected);
+    free(actual);
+    return failed;
+}
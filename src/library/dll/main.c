@@ -51,6 +51,7 @@ static void hook_glTexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei, GLsizei,
 static void hook_glDeleteTextures(GLsizei, const GLuint*);
 static void hook_glClear(GLbitfield);
 static void hook_glViewport(GLint, GLint, GLsizei, GLsizei);
+static void hook_glPixelStorei(GLenum, GLint);
 
 static HGLRC __stdcall hook_wglCreateContextAttribsARB(HDC, HGLRC, const int*);
 
@@ -97,11 +98,15 @@ DWORD __stdcall BOLT_STUB_ENTRYNAME(struct PluginInjectParams* data) {
     libgl.Clear = (void(*)(GLbitfield))data->pGetProcAddress(libgl_module, "glClear");
     libgl.ClearColor = (void(*)(GLfloat, GLfloat, GLfloat, GLfloat))data->pGetProcAddress(libgl_module, "glClearColor");
     libgl.DeleteTextures = (void(*)(GLsizei, const GLuint*))data->pGetProcAddress(libgl_module, "glDeleteTextures");
+    libgl.Disable = (void(*)(GLenum))data->pGetProcAddress(libgl_module, "glDisable");
     libgl.DrawArrays = (void(*)(GLenum, GLint, GLsizei))data->pGetProcAddress(libgl_module, "glDrawArrays");
     libgl.DrawElements = (void(*)(GLenum, GLsizei, GLenum, const void*))data->pGetProcAddress(libgl_module, "glDrawElements");
+    libgl.Enable = (void(*)(GLenum))data->pGetProcAddress(libgl_module, "glEnable");
     libgl.Flush = (void(*)(void))data->pGetProcAddress(libgl_module, "glFlush");
     libgl.GenTextures = (void(*)(GLsizei, GLuint*))data->pGetProcAddress(libgl_module, "glGenTextures");
     libgl.GetError = (GLenum(*)(void))data->pGetProcAddress(libgl_module, "glGetError");
+    libgl.IsEnabled = (GLboolean(*)(GLenum))data->pGetProcAddress(libgl_module, "glIsEnabled");
+    libgl.PixelStorei = (void(*)(GLenum, GLint))data->pGetProcAddress(libgl_module, "glPixelStorei");
     libgl.ReadPixels = (void(*)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void*))data->pGetProcAddress(libgl_module, "glReadPixels");
     libgl.TexParameteri = (void(*)(GLenum, GLenum, GLfloat))data->pGetProcAddress(libgl_module, "glTexParameteri");
     libgl.TexSubImage2D = (void(*)(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void*))data->pGetProcAddress(libgl_module, "glTexSubImage2D");
@@ -135,6 +140,7 @@ DWORD __stdcall BOLT_STUB_ENTRYNAME(struct PluginInjectParams* data) {
                     FNHOOK(glDeleteTextures)
                     FNHOOK(glClear)
                     FNHOOK(glViewport)
+                    FNHOOK(glPixelStorei)
                 }
                 if (bolt_cmp(module_name, "gdi32.dll", 0)) {
                     FNHOOKA(SwapBuffers, SWAPBUFFERS)
@@ -177,10 +183,10 @@ static void winapi_to_mouseevent(int x, int y, WPARAM param, struct MouseEvent*
     out->mb_middle = param & MK_MBUTTON ? 1 : 0;
 }
 
-static BOOL handle_mouse_event(WPARAM wParam, POINTS point, ptrdiff_t bool_offset, ptrdiff_t event_offset, uint8_t grab_type) {
+static BOOL handle_mouse_event(WPARAM wParam, POINTS point, uint8_t input_type, uint8_t grab_type) {
     struct MouseEvent event;
     winapi_to_mouseevent(point.x, point.y, wParam, &event);
-    return _bolt_plugin_handle_mouse_event(&event, bool_offset, event_offset, grab_type, NULL, NULL);
+    return _bolt_plugin_handle_mouse_event(&event, input_type, grab_type, NULL, NULL);
 }
 
 // middle-man function for WNDPROC. when the game window gets an event, we intercept it here, act on
@@ -200,28 +206,28 @@ LRESULT hook_wndproc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
             break;
         }
         case WM_MOUSEMOVE:
-            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), offsetof(struct WindowPendingInput, mouse_motion), offsetof(struct WindowPendingInput, mouse_motion_event), GRAB_TYPE_NONE)) return 0;
+            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), INPUT_MOUSE_MOTION, GRAB_TYPE_NONE)) return 0;
             break;
         case WM_LBUTTONDOWN:
         case WM_LBUTTONDBLCLK:
-            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), offsetof(struct WindowPendingInput, mouse_left), offsetof(struct WindowPendingInput, mouse_left_event), GRAB_TYPE_START)) return 0;
+            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), INPUT_MOUSE_LEFT, GRAB_TYPE_START)) return 0;
             break;
         case WM_RBUTTONDOWN:
         case WM_RBUTTONDBLCLK:
-            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), offsetof(struct WindowPendingInput, mouse_right), offsetof(struct WindowPendingInput, mouse_right_event), GRAB_TYPE_NONE)) return 0;
+            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), INPUT_MOUSE_RIGHT, GRAB_TYPE_NONE)) return 0;
             break;
         case WM_MBUTTONDOWN:
         case WM_MBUTTONDBLCLK:
-            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), offsetof(struct WindowPendingInput, mouse_middle), offsetof(struct WindowPendingInput, mouse_middle_event), GRAB_TYPE_NONE)) return 0;
+            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), INPUT_MOUSE_MIDDLE, GRAB_TYPE_NONE)) return 0;
             break;
         case WM_LBUTTONUP:
-            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), offsetof(struct WindowPendingInput, mouse_left_up), offsetof(struct WindowPendingInput, mouse_left_up_event), GRAB_TYPE_STOP)) return 0;
+            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), INPUT_MOUSE_LEFT_UP, GRAB_TYPE_STOP)) return 0;
             break;
         case WM_RBUTTONUP:
-            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), offsetof(struct WindowPendingInput, mouse_right_up), offsetof(struct WindowPendingInput, mouse_right_up_event), GRAB_TYPE_NONE)) return 0;
+            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), INPUT_MOUSE_RIGHT_UP, GRAB_TYPE_NONE)) return 0;
             break;
         case WM_MBUTTONUP:
-            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), offsetof(struct WindowPendingInput, mouse_middle_up), offsetof(struct WindowPendingInput, mouse_middle_up_event), GRAB_TYPE_NONE)) return 0;
+            if (!handle_mouse_event(wParam, MAKEPOINTS(lParam), INPUT_MOUSE_MIDDLE_UP, GRAB_TYPE_NONE)) return 0;
             break;
         case WM_MOUSEWHEEL: {
             const WORD keys = GET_KEYSTATE_WPARAM(wParam);
@@ -233,9 +239,9 @@ LRESULT hook_wndproc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
             points.x = (SHORT)point.x;
             points.y = (SHORT)point.y;
             if (delta > 0) {
-                if (!handle_mouse_event(keys, points, offsetof(struct WindowPendingInput, mouse_scroll_up), offsetof(struct WindowPendingInput, mouse_scroll_up_event), GRAB_TYPE_NONE)) return 0;
+                if (!handle_mouse_event(keys, points, INPUT_MOUSE_SCROLL_UP, GRAB_TYPE_NONE)) return 0;
             } else {
-                if (!handle_mouse_event(keys, points, offsetof(struct WindowPendingInput, mouse_scroll_down), offsetof(struct WindowPendingInput, mouse_scroll_down_event), GRAB_TYPE_NONE)) return 0;
+                if (!handle_mouse_event(keys, points, INPUT_MOUSE_SCROLL_DOWN, GRAB_TYPE_NONE)) return 0;
             }
             break;
         }
@@ -397,6 +403,13 @@ static void hook_glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
     LOG("glViewport end\n");
 }
 
+static void hook_glPixelStorei(GLenum pname, GLint param) {
+    LOG("glPixelStorei\n");
+    libgl.PixelStorei(pname, param);
+    _bolt_gl_onPixelStorei(pname, param);
+    LOG("glPixelStorei end\n");
+}
+
 static HGLRC __stdcall hook_wglCreateContextAttribsARB(HDC hdc, HGLRC hglrc, const int* attribList) {
     LOG("wglCreateContextAttribsARB(%llu)\n", (ULONGLONG)hglrc);
     EnterCriticalSection(&wgl_lock);
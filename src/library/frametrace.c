@@ -0,0 +1,157 @@
+#include "frametrace.h"
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// a ring of events. only the thread that owns a ring writes to it; everything read by other threads
+// goes through the atomics below. rings are never freed, but a thread that exits gives its ring up for
+// the next new thread to carry on with, so the list only grows as far as the most threads alive at once
+struct FrameTraceRing {
+    struct FrameTraceRing* next;
+    uint32_t in_use;
+    uint32_t thread; // the OS's ID for the thread that owns this ring
+    uint32_t generation; // the value of frametrace_generation when `count` was last reset
+    uint64_t count; // total events written this generation, of which the last BOLT_FRAMETRACE_RING_SIZE are kept
+    struct BoltFrameTraceEvent events[BOLT_FRAMETRACE_RING_SIZE];
+};
+
+static uint32_t frametrace_running = 0;
+static uint32_t frametrace_generation = 0; // incremented by every start, and rings reset themselves when it changes
+static struct FrameTraceRing* frametrace_rings = NULL;
+static uint8_t frametrace_tls_inited = 0;
+
+#if defined(_WIN32)
+static DWORD frametrace_tls;
+static LARGE_INTEGER frametrace_frequency;
+static uint32_t load_u32(const uint32_t* p) { return (uint32_t)InterlockedCompareExchange((volatile LONG*)p, 0, 0); }
+static void store_u32(uint32_t* p, uint32_t v) { InterlockedExchange((volatile LONG*)p, (LONG)v); }
+static uint8_t cas_u32(uint32_t* p, uint32_t expected, uint32_t desired) { return (uint32_t)InterlockedCompareExchange((volatile LONG*)p, (LONG)desired, (LONG)expected) == expected; }
+static uint64_t load_u64(const uint64_t* p) { return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)p, 0, 0); }
+static void store_u64(uint64_t* p, uint64_t v) { InterlockedExchange64((volatile LONG64*)p, (LONG64)v); }
+static struct FrameTraceRing* load_ring(struct FrameTraceRing** p) { return InterlockedCompareExchangePointer((PVOID volatile*)p, NULL, NULL); }
+static uint8_t cas_ring(struct FrameTraceRing** p, struct FrameTraceRing* expected, struct FrameTraceRing* desired) { return InterlockedCompareExchangePointer((PVOID volatile*)p, desired, expected) == expected; }
+#else
+static pthread_key_t frametrace_tls;
+static uint32_t load_u32(const uint32_t* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static void store_u32(uint32_t* p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+static uint8_t cas_u32(uint32_t* p, uint32_t expected, uint32_t desired) { return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+static uint64_t load_u64(const uint64_t* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static void store_u64(uint64_t* p, uint64_t v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+static struct FrameTraceRing* load_ring(struct FrameTraceRing** p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static uint8_t cas_ring(struct FrameTraceRing** p, struct FrameTraceRing* expected, struct FrameTraceRing* desired) { return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+#endif
+
+uint64_t _bolt_frametrace_now() {
+#if defined(_WIN32)
+    LARGE_INTEGER ticks;
+    if (!frametrace_frequency.QuadPart) QueryPerformanceFrequency(&frametrace_frequency);
+    QueryPerformanceCounter(&ticks);
+    const uint64_t freq = frametrace_frequency.QuadPart;
+    return ((ticks.QuadPart / freq) * 1000000) + (((ticks.QuadPart % freq) * 1000000) / freq);
+#else
+    struct timespec s;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &s);
+    return ((uint64_t)s.tv_sec * 1000000) + (s.tv_nsec / 1000);
+#endif
+}
+
+// called when a thread with a ring exits
+#if defined(_WIN32)
+static void WINAPI _bolt_frametrace_release_ring(void* ring) {
+#else
+static void _bolt_frametrace_release_ring(void* ring) {
+#endif
+    if (ring) store_u32(&((struct FrameTraceRing*)ring)->in_use, 0);
+}
+
+void _bolt_frametrace_start() {
+    if (!frametrace_tls_inited) {
+#if defined(_WIN32)
+        frametrace_tls = FlsAlloc(_bolt_frametrace_release_ring);
+#else
+        pthread_key_create(&frametrace_tls, _bolt_frametrace_release_ring);
+#endif
+        frametrace_tls_inited = 1;
+    }
+    store_u32(&frametrace_generation, load_u32(&frametrace_generation) + 1);
+    store_u32(&frametrace_running, 1);
+}
+
+void _bolt_frametrace_stop() {
+    store_u32(&frametrace_running, 0);
+}
+
+uint64_t _bolt_frametrace_begin() {
+    return load_u32(&frametrace_running) ? _bolt_frametrace_now() : 0;
+}
+
+// gets the calling thread's ring, taking over an unused one or allocating a new one if it has none yet
+static struct FrameTraceRing* _bolt_frametrace_thread_ring() {
+#if defined(_WIN32)
+    struct FrameTraceRing* ring = FlsGetValue(frametrace_tls);
+#else
+    struct FrameTraceRing* ring = pthread_getspecific(frametrace_tls);
+#endif
+    if (ring) return ring;
+    for (ring = load_ring(&frametrace_rings); ring; ring = ring->next) {
+        if (cas_u32(&ring->in_use, 0, 1)) break;
+    }
+    if (!ring) {
+        ring = malloc(sizeof(*ring));
+        if (!ring) return NULL;
+        ring->in_use = 1;
+        ring->generation = 0;
+        ring->count = 0;
+        do {
+            ring->next = load_ring(&frametrace_rings);
+        } while (!cas_ring(&frametrace_rings, ring->next, ring));
+    }
+#if defined(_WIN32)
+    ring->thread = (uint32_t)GetCurrentThreadId();
+    FlsSetValue(frametrace_tls, ring);
+#else
+    ring->thread = (uint32_t)syscall(SYS_gettid);
+    pthread_setspecific(frametrace_tls, ring);
+#endif
+    return ring;
+}
+
+void _bolt_frametrace_end(uint64_t start, const char* name) {
+    if (!start || !load_u32(&frametrace_running)) return;
+    const uint64_t end = _bolt_frametrace_now();
+    struct FrameTraceRing* ring = _bolt_frametrace_thread_ring();
+    if (!ring) return;
+    const uint32_t generation = load_u32(&frametrace_generation);
+    if (ring->generation != generation) {
+        // the count has to be reset before the generation says it's current
+        store_u64(&ring->count, 0);
+        store_u32(&ring->generation, generation);
+    }
+    const uint64_t count = ring->count;
+    struct BoltFrameTraceEvent* event = &ring->events[count % BOLT_FRAMETRACE_RING_SIZE];
+    event->start_micros = start;
+    event->name = name;
+    event->duration_micros = end - start < UINT32_MAX ? (uint32_t)(end - start) : UINT32_MAX;
+    event->thread = ring->thread;
+    store_u64(&ring->count, count + 1);
+}
+
+void _bolt_frametrace_foreach(void (*callback)(const struct BoltFrameTraceEvent*, void*), void* userdata) {
+    const uint32_t generation = load_u32(&frametrace_generation);
+    for (struct FrameTraceRing* ring = load_ring(&frametrace_rings); ring; ring = ring->next) {
+        if (load_u32(&ring->generation) != generation) continue;
+        const uint64_t count = load_u64(&ring->count);
+        const uint64_t first = count > BOLT_FRAMETRACE_RING_SIZE ? count - BOLT_FRAMETRACE_RING_SIZE : 0;
+        for (uint64_t i = first; i < count; i += 1) {
+            callback(&ring->events[i % BOLT_FRAMETRACE_RING_SIZE], userdata);
+        }
+    }
+}
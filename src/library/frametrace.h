@@ -0,0 +1,86 @@
+#ifndef _BOLT_LIBRARY_FRAMETRACE_H_
+#define _BOLT_LIBRARY_FRAMETRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Frame tracing
+ *
+ * Timings of named scopes in the host and in every game client, for working out where a stutter came
+ * from, which the host merges into one Chrome trace (JSON array format, which Perfetto and
+ * chrome://tracing can both open). Tracing is started and stopped from the launcher; see
+ * IPC_MSG_FRAMETRACE for how the clients' timings get to the host.
+ *
+ * Scopes are marked with BOLT_FRAMETRACE_BEGIN and BOLT_FRAMETRACE_END, which expand to nothing unless
+ * BOLT_FRAME_TRACE is defined (the BOLT_FRAME_TRACE cmake setting), so they cost nothing in a normal
+ * build. The functions below are always compiled, so that a client without scopes still answers the
+ * host, just with no events. While tracing isn't running, a scope costs one atomic load.
+ *
+ * Each thread writes to a ring that no other thread writes to at the same time, so recording a scope
+ * never takes a lock. A ring holds BOLT_FRAMETRACE_RING_SIZE events, after which the oldest ones are
+ * overwritten, and a thread that exits leaves its ring to the next new thread. Timestamps are in microseconds from a monotonic clock
+ * shared by every process on the machine, so events from different processes line up when merged.
+ */
+#define BOLT_FRAMETRACE_RING_SIZE 16384
+
+/// One finished scope. `name` is the string literal given to BOLT_FRAMETRACE_END, and `thread` is the
+/// OS's ID for the thread that recorded it.
+struct BoltFrameTraceEvent {
+    uint64_t start_micros;
+    const char* name;
+    uint32_t duration_micros;
+    uint32_t thread;
+};
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/// The calling process's current time, in the clock used for frame trace events.
+uint64_t _bolt_frametrace_now();
+
+/// Starts tracing in this process, discarding anything recorded by an earlier trace.
+void _bolt_frametrace_start();
+
+/// Stops tracing in this process. Events already recorded stay until the next start.
+void _bolt_frametrace_stop();
+
+/// Returns the time to pass to _bolt_frametrace_end, or 0 if tracing isn't running.
+uint64_t _bolt_frametrace_begin();
+
+/// Records a scope that started at `start`, if `start` is non-zero. `name` must outlive the trace.
+void _bolt_frametrace_end(uint64_t start, const char* name);
+
+/// Calls `callback` for every event recorded since the last start. Should be called after stopping,
+/// since a thread that's still recording could overwrite an event while it's being read.
+void _bolt_frametrace_foreach(void (*callback)(const struct BoltFrameTraceEvent*, void*), void* userdata);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#if defined(BOLT_FRAME_TRACE)
+#define BOLT_FRAMETRACE_BEGIN(VAR) const uint64_t VAR = _bolt_frametrace_begin()
+#define BOLT_FRAMETRACE_END(VAR, NAME) _bolt_frametrace_end(VAR, NAME)
+#else
+#define BOLT_FRAMETRACE_BEGIN(VAR)
+#define BOLT_FRAMETRACE_END(VAR, NAME)
+#endif
+
+#if defined(__cplusplus)
+/// Records a scope covering the rest of the enclosing block, for C++ code where a block can be left
+/// by a return in the middle of it.
+struct BoltFrameTraceScope {
+    BoltFrameTraceScope(const char* name): name(name), start(_bolt_frametrace_begin()) {}
+    ~BoltFrameTraceScope() { _bolt_frametrace_end(this->start, this->name); }
+    const char* name;
+    uint64_t start;
+};
+#if defined(BOLT_FRAME_TRACE)
+#define BOLT_FRAMETRACE_SCOPE(VAR, NAME) BoltFrameTraceScope VAR(NAME)
+#else
+#define BOLT_FRAMETRACE_SCOPE(VAR, NAME)
+#endif
+#endif
+
+#endif
@@ -1,5 +1,8 @@
 #include "plugin/plugin.h"
 #include "gl.h"
+#include "trace.h"
+#include "frametrace.h"
+#include "s3tc.h"
 
 #include <math.h>
 #include <stdio.h>
@@ -16,6 +19,38 @@
 #define LOG(...)
 #endif
 
+// records a hook, if a trace is being recorded (see trace.h). FIELDS is a list of the T* macros below,
+// in the order that trace.h lists them for this op
+#define TRACE(OP, FIELDS) if (bolt_trace_recording) { _bolt_trace_begin(TRACE_OP_##OP); FIELDS _bolt_trace_end(); }
+#define T8(V) _bolt_trace_u8((uint8_t)(V));
+#define T32(V) _bolt_trace_u32((uint32_t)(V));
+#define T64(V) _bolt_trace_u64((uint64_t)(V));
+#define TF32(V) _bolt_trace_f32(V);
+#define TBLOB(PTR, SIZE) _bolt_trace_blob(PTR, SIZE);
+
+// uncomment this to check every read from the shadow GL state against the real driver state, logging any
+// mismatches. this reintroduces all the glGet calls that the shadow state exists to avoid, so it's slow.
+//#define VERIFY_SHADOW_STATE
+
+#if defined(VERIFY_SHADOW_STATE)
+#define VERIFY_INTEGERV(NAME, CACHED) {GLint v_; gl.GetIntegerv(NAME, &v_); _bolt_verify_integer(#NAME, v_, (GLint)(CACHED));}
+#define VERIFY_INTEGERI_V(NAME, INDEX, CACHED) {GLint v_; gl.GetIntegeri_v(NAME, INDEX, &v_); _bolt_verify_integer(#NAME, v_, (GLint)(CACHED));}
+#define VERIFY_ATTACHMENT(TARGET, FRAMEBUFFER, CACHED) if (FRAMEBUFFER) {GLint v_; gl.GetFramebufferAttachmentParameteriv(TARGET, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &v_); _bolt_verify_integer(#TARGET" attachment", v_, (GLint)(CACHED));}
+#define VERIFY_UNIFORM_BLOCK_BINDING(PROGRAM, INDEX, CACHED) {GLint v_; gl.GetActiveUniformBlockiv(PROGRAM, INDEX, GL_UNIFORM_BLOCK_BINDING, &v_); _bolt_verify_integer("GL_UNIFORM_BLOCK_BINDING", v_, (GLint)(CACHED));}
+#define VERIFY_UNIFORMIV(PROGRAM, LOC, CACHED) {GLint v_; gl.GetUniformiv(PROGRAM, LOC, &v_); _bolt_verify_integer(#CACHED, v_, (GLint)(CACHED));}
+#define VERIFY_UNIFORMFV(PROGRAM, LOC, CACHED, COUNT) {GLfloat v_[16]; gl.GetUniformfv(PROGRAM, LOC, v_); if (memcmp(v_, CACHED, (COUNT) * sizeof(GLfloat))) printf("warning: shadow state mismatch for %s\n", #CACHED);}
+static void _bolt_verify_integer(const char* name, GLint real, GLint cached) {
+    if (real != cached) printf("warning: shadow state mismatch for %s: driver has %i, cache has %i\n", name, real, cached);
+}
+#else
+#define VERIFY_INTEGERV(NAME, CACHED)
+#define VERIFY_INTEGERI_V(NAME, INDEX, CACHED)
+#define VERIFY_ATTACHMENT(TARGET, FRAMEBUFFER, CACHED)
+#define VERIFY_UNIFORM_BLOCK_BINDING(PROGRAM, INDEX, CACHED)
+#define VERIFY_UNIFORMIV(PROGRAM, LOC, CACHED)
+#define VERIFY_UNIFORMFV(PROGRAM, LOC, CACHED, COUNT)
+#endif
+
 static unsigned int gl_width;
 static unsigned int gl_height;
 
@@ -26,11 +61,22 @@ static uint8_t egl_main_context_makecurrent_pending = 0;
 
 static struct GLProcFunctions gl = {0};
 static const struct GLLibFunctions* lgl = NULL;
+#if !defined(_WIN32)
+// EGL functions used for importing dmabufs, which may be NULL if the platform doesn't have them
+struct EGLImportFunctions {
+    void* (*GetCurrentDisplay)(void);
+    const char* (*QueryString)(void*, int32_t);
+    void* (*CreateImageKHR)(void*, void*, unsigned int, void*, const int32_t*);
+    unsigned int (*DestroyImageKHR)(void*, void*);
+    void (*EGLImageTargetTexture2DOES)(GLenum, void*);
+};
+static struct EGLImportFunctions egl = {0};
+#endif
 static GLuint program_direct_screen;
 static GLint program_direct_screen_sampler;
-static GLint program_direct_screen_d_xywh;
-static GLint program_direct_screen_s_xywh;
 static GLint program_direct_screen_src_wh_dest_wh;
+static GLuint program_direct_screen_vao;
+static GLuint buffer_screen_draws;
 static GLuint program_direct_surface;
 static GLint program_direct_surface_sampler;
 static GLint program_direct_surface_d_xywh;
@@ -42,16 +88,40 @@ static GLint program_region_dest_wh;
 static GLuint program_direct_vao;
 static GLuint buffer_vertices_square;
 
+// total size of all currently-allocated compressed texture mirrors, and a list of every compressed texture
+// that has one, least recently used first. the budget covers every share group, so these have their own
+// lock, which is created and destroyed along with `contexts`. mirrors are only evicted at the end of a frame,
+// so the budget can be overshot during one, but a pointer a plugin got from texture_data is never freed under it
+static RWLock texture_mirror_lock;
+static size_t texture_mirror_bytes = 0;
+static struct GLTexture2D* texture_mirror_lru_first = NULL;
+static struct GLTexture2D* texture_mirror_lru_last = NULL;
+
+struct S3TCDecoder {
+    BoltS3TCDecodeBlock decode_block;
+    size_t block_size;
+};
+
 // "direct" program is basically a blit but with transparency.
-// there are different vertex shaders for targeting the screen vs targeting a surface.
+// there are different programs for targeting the screen vs targeting a surface. the screen one is instanced,
+// taking the source and destination rectangles of each draw as per-instance attributes, so that all the draws
+// from the same surface can be done in one call; see _bolt_gl_flush_screen_draws.
 static const GLchar program_direct_screen_vs[] = "#version 330 core\n"
 "layout (location = 0) in vec2 aPos;"
-"out vec2 vPos;"
-"uniform ivec4 d_xywh;"
+"layout (location = 1) in ivec4 aDestXYWH;"
+"layout (location = 2) in ivec4 aSourceXYWH;"
+"out vec2 vTexCoord;"
 "uniform ivec4 src_wh_dest_wh;"
 "void main() {"
-  "vPos = aPos;"
-  "gl_Position = vec4(((((aPos * d_xywh.pq) + d_xywh.st) * vec2(2.0, 2.0) / src_wh_dest_wh.pq) - vec2(1.0, 1.0)) * vec2(1.0, -1.0), 0.0, 1.0);"
+  "vTexCoord = ((aPos * aSourceXYWH.pq) + aSourceXYWH.st) / vec2(src_wh_dest_wh.st);"
+  "gl_Position = vec4(((((aPos * aDestXYWH.pq) + aDestXYWH.st) * vec2(2.0, 2.0) / src_wh_dest_wh.pq) - vec2(1.0, 1.0)) * vec2(1.0, -1.0), 0.0, 1.0);"
+"}";
+static const GLchar program_direct_screen_fs[] = "#version 330 core\n"
+"in vec2 vTexCoord;"
+"layout (location = 0) out vec4 col;"
+"uniform sampler2D tex;"
+"void main() {"
+  "col = texture(tex, vTexCoord);"
 "}";
 static const GLchar program_direct_surface_vs[] = "#version 330 core\n"
 "layout (location = 0) in vec2 aPos;"
@@ -98,8 +168,11 @@ static struct GLProgram* _bolt_context_get_program(struct GLContext*, GLuint);
 static struct GLArrayBuffer* _bolt_context_get_buffer(struct GLContext*, GLuint);
 static struct GLTexture2D* _bolt_context_get_texture(struct GLContext*, GLuint);
 static struct GLVertexArray* _bolt_context_get_vao(struct GLContext*, GLuint);
-static void _bolt_glcontext_init(struct GLContext*, void*, void*);
+static struct GLFramebuffer* _bolt_context_get_framebuffer(struct GLContext*, GLuint);
+static void _bolt_glcontext_init(struct GLContext*, void*, struct GLContext*);
 static void _bolt_glcontext_free(struct GLContext*);
+static uint8_t _bolt_s3tc_decoder(GLenum, struct S3TCDecoder*);
+static void _bolt_texture_storage_free(struct GLTexture2D*);
 
 static void _bolt_gl_plugin_drawelements_vertex2d_xy(size_t index, void* userdata, int32_t* out);
 static void _bolt_gl_plugin_drawelements_vertex2d_atlas_xy(size_t index, void* userdata, int32_t* out);
@@ -112,22 +185,38 @@ static void _bolt_gl_plugin_drawelements_vertex3d_meta_xywh(size_t meta, void* u
 static void _bolt_gl_plugin_drawelements_vertex3d_uv(size_t index, void* userdata, double* out);
 static void _bolt_gl_plugin_drawelements_vertex3d_colour(size_t index, void* userdata, double* out);
 static uint8_t _bolt_gl_plugin_drawelements_vertex3d_boneid(size_t index, void* userdata);
+static void _bolt_gl_plugin_drawelements_vertex2d_xy_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride);
+static void _bolt_gl_plugin_drawelements_vertex2d_atlas_xy_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride);
+static void _bolt_gl_plugin_drawelements_vertex2d_atlas_wh_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride);
+static void _bolt_gl_plugin_drawelements_vertex2d_uv_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride);
+static void _bolt_gl_plugin_drawelements_vertex2d_colour_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride);
+static void _bolt_gl_plugin_drawelements_vertex3d_xyz_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride);
+static void _bolt_gl_plugin_drawelements_vertex3d_atlas_meta_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride);
+static void _bolt_gl_plugin_drawelements_vertex3d_uv_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride);
+static void _bolt_gl_plugin_drawelements_vertex3d_colour_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride);
+static void _bolt_gl_plugin_drawelements_vertex3d_boneid_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride);
 static void _bolt_gl_plugin_bone_transform(uint8_t bone_id, void* userdata, struct Transform3D* out);
+static const float* _bolt_gl_plugin_bone_palette(void* userdata, size_t* bone_count);
 static void _bolt_gl_plugin_matrix3d_model(void* userdata, struct Transform3D* out);
 static void _bolt_gl_plugin_matrix3d_viewproj(void* userdata, struct Transform3D* out);
 static size_t _bolt_gl_plugin_texture_id(void* userdata);
 static void _bolt_gl_plugin_texture_size(void* userdata, size_t* out);
 static uint8_t _bolt_gl_plugin_texture_compare(void* userdata, size_t x, size_t y, size_t len, const unsigned char* data);
-static uint8_t* _bolt_gl_plugin_texture_data(void* userdata, size_t x, size_t y);
+static uint8_t _bolt_gl_plugin_texture_hash(void* userdata, size_t x, size_t y, size_t w, size_t h, uint8_t perceptual, uint64_t* out);
+static uint8_t* _bolt_gl_plugin_texture_data(void* userdata, size_t x, size_t y, size_t len);
 static void _bolt_gl_plugin_surface_init(struct SurfaceFunctions* out, unsigned int width, unsigned int height, const void* data);
 static void _bolt_gl_plugin_surface_destroy(void* userdata);
 static void _bolt_gl_plugin_surface_resize(void* userdata, unsigned int width, unsigned int height);
 static void _bolt_gl_plugin_surface_clear(void* userdata, double r, double g, double b, double a);
-static void _bolt_gl_plugin_surface_subimage(void* userdata, int x, int y, int w, int h, const void* pixels, uint8_t is_bgra);
+static void _bolt_gl_plugin_surface_subimage(void* userdata, int x, int y, int w, int h, const void* pixels, size_t stride, uint8_t is_bgra);
 static void _bolt_gl_plugin_surface_drawtoscreen(void* userdata, int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh);
 static void _bolt_gl_plugin_surface_drawtosurface(void* userdata, void* target, int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh);
+static uint8_t _bolt_gl_plugin_surface_copy_shared_texture(void* userdata, const struct SharedTexture* texture);
+static uint8_t _bolt_gl_plugin_shared_texture_supported();
+static void _bolt_gl_flush_screen_draws();
 static void _bolt_gl_plugin_draw_region_outline(void* userdata, int16_t x, int16_t y, uint16_t width, uint16_t height);
-static void _bolt_gl_plugin_read_screen_pixels(uint32_t width, uint32_t height, void* data);
+static uint8_t _bolt_gl_plugin_read_screen_pixels_start(const struct CaptureRegion* regions, size_t count);
+static uint8_t _bolt_gl_plugin_read_screen_pixels_finish(const struct CaptureRegion* regions, size_t count, void* data);
 static void _bolt_gl_plugin_game_view_rect(int* x, int* y, int* w, int* h);
 
 #define MAX_TEXTURE_UNITS 4096 // would be nice if there was a way to query this at runtime, but it would be awkward to set up
@@ -135,9 +224,42 @@ static void _bolt_gl_plugin_game_view_rect(int* x, int* y, int* w, int* h);
 #define TEXTURE_LIST_CAPACITY 256
 #define PROGRAM_LIST_CAPACITY 256 * 8
 #define VAO_LIST_CAPACITY 256 * 256
-#define CONTEXTS_CAPACITY 64 // not growable so we just have to hard-code a number and hope it's enough forever
+#define FRAMEBUFFER_LIST_CAPACITY 256
+
+// GL object names below this are looked up by direct indexing, anything above it goes in a hashmap.
+// drivers hand out names incrementally and reuse deleted ones, so in practice nothing gets near this
+#define OBJECT_TABLE_DIRECT_LIMIT (1 << 20)
+#define MAX_UNIFORM_BUFFER_BINDINGS 128 // GL guarantees at least 36, no driver we care about has more than this
+#define MAX_BONE_TRANSFORMS 256 // bone IDs are 8-bit, so no more than this many can ever be used
+#if !defined(TEXTURE_MIRROR_BUDGET)
+#define TEXTURE_MIRROR_BUDGET (256 * 1024 * 1024) // max bytes of decoded RGBA kept for compressed textures
+#endif
+#define TEXTURE_CACHE_MIN_BYTES (64 * 1024) // smaller mirrors aren't worth putting in the shared texture cache
 #define GAME_MINIMAP_BIG_SIZE 2048
-static struct GLContext contexts[CONTEXTS_CAPACITY];
+#define CAPTURE_BUFFER_COUNT 3 // pixel pack buffers for screen captures that are still in flight on the GPU
+#define UPLOAD_RING_SIZE (4 * 1024 * 1024) // bytes in the pixel unpack buffer that surface uploads are streamed through
+
+// every context that's been created and not yet destroyed, keyed by the OS's handle for it. only used by
+// the os-level hooks, which the caller has to serialise, so it doesn't need a lock of its own
+static struct hashmap* contexts = NULL;
+
+// ring of pixel pack buffers which screen captures get read into, so the CPU never has to wait for the GPU
+struct GLCaptureBuffer {
+    GLuint buffer;
+    GLsizeiptr buffer_size;
+    GLsync fence;
+    struct CaptureRegion* regions; // the regions this read was started with
+    size_t region_count;
+    size_t region_capacity;
+};
+static struct GLCaptureBuffer capture_buffers[CAPTURE_BUFFER_COUNT];
+static size_t capture_buffer_first = 0; // index of the oldest read that's in flight
+static size_t capture_buffer_count = 0; // number of reads in flight
+
+// surface uploads are copied into consecutive parts of this buffer and the GPU takes them from there, so
+// TexSubImage2D never has to wait for it. when it fills up, its storage is orphaned and it starts again.
+static GLuint upload_ring = 0;
+static GLsizeiptr upload_ring_offset = 0;
 
 // since GL contexts are bound only to the thread that binds them, we use thread-local storage (TLS)
 // to keep track of which context struct is relevant to each thread. One TLS slot can store exactly
@@ -150,12 +272,97 @@ static DWORD current_context_tls;
 static pthread_key_t current_context_tls;
 #endif
 
+struct SurfaceAtlas;
 struct PluginSurfaceUserdata {
     unsigned int width;
     unsigned int height;
     unsigned int framebuffer;
     unsigned int renderbuffer;
+    // where this surface is in its texture, and the size of the whole texture, which may be shared with
+    // other surfaces (if atlas is set) or be rounded up to a size class. renderbuffer is the texture
+    unsigned int x;
+    unsigned int y;
+    unsigned int tex_width;
+    unsigned int tex_height;
+    struct SurfaceAtlas* atlas;
+    // dmabufs that have been copied into this surface, see _bolt_gl_plugin_surface_copy_shared_texture.
+    // NULL until the first one
+    struct SharedTextureImport* imports;
+};
+static void _bolt_gl_surface_free_imports(struct PluginSurfaceUserdata* userdata);
+
+// small surfaces are packed into shared atlas textures, in square slots whose size is a power of two.
+// each atlas only has one slot size, so finding and freeing a slot is just a matter of flipping a bit
+#define SURFACE_ATLAS_SIZE 1024
+#define SURFACE_ATLAS_MIN_SLOT 16
+#define SURFACE_ATLAS_CLASS_COUNT 4 // 16, 32, 64, 128
+#define SURFACE_ATLAS_MAX_SLOTS ((SURFACE_ATLAS_SIZE / SURFACE_ATLAS_MIN_SLOT) * (SURFACE_ATLAS_SIZE / SURFACE_ATLAS_MIN_SLOT))
+struct SurfaceAtlas {
+    unsigned int framebuffer;
+    unsigned int texture;
+    unsigned int slot_size;
+    unsigned int slot_count;
+    unsigned int used_count;
+    uint64_t used[SURFACE_ATLAS_MAX_SLOTS / 64];
+    struct SurfaceAtlas* next;
+};
+static struct SurfaceAtlas* surface_atlases[SURFACE_ATLAS_CLASS_COUNT] = {0};
+
+// anything too big for an atlas gets its own texture, with each side rounded up to a multiple of
+// SURFACE_SIZE_CLASS, so that resizing doesn't usually need a new one. textures of freed surfaces
+// are kept here to be reused, oldest first, up to SURFACE_POOL_MAX_SIZE bytes
+#define SURFACE_SIZE_CLASS 64
+#define SURFACE_POOL_MAX_SIZE (64 * 1024 * 1024)
+struct PooledSurfaceBuffers {
+    unsigned int framebuffer;
+    unsigned int texture;
+    unsigned int width;
+    unsigned int height;
 };
+static struct PooledSurfaceBuffers* surface_pool = NULL;
+static size_t surface_pool_count = 0;
+static size_t surface_pool_capacity = 0;
+static size_t surface_pool_size = 0;
+
+// surface:drawtoscreen() calls are queued up rather than drawn straight away, and drawn in as few calls as possible
+// when the queue is flushed, which happens at the end of the frame or before anything else touches a surface.
+// draws from the same surface are grouped together, but a draw is only moved into an earlier group if it
+// doesn't overlap anything drawn after that group, so the end result is the same as drawing them in order.
+struct GLScreenDraw {
+    GLint d_xywh[4];
+    GLint s_xywh[4];
+    size_t group;
+};
+struct GLScreenDrawGroup {
+    struct PluginSurfaceUserdata* surface;
+    size_t count;
+    size_t first; // only used while flushing
+    int x0, y0, x1, y1; // bounding box of every destination rectangle in this group
+};
+static struct GLScreenDraw* screen_draws = NULL;
+static size_t screen_draw_count = 0;
+static size_t screen_draw_capacity = 0;
+static struct GLScreenDrawGroup* screen_draw_groups = NULL;
+static size_t screen_draw_group_count = 0;
+static size_t screen_draw_group_capacity = 0;
+static GLint* screen_draw_instances = NULL; // staging area for the instance buffer, sorted by group
+static size_t screen_draw_instance_capacity = 0;
+
+// scaled-down capture regions get blitted into this surface, stacked on top of each other, before being read
+static struct PluginSurfaceUserdata capture_staging = {0};
+
+// a multisampled framebuffer can only be blitted at 1:1 scale, so if the default framebuffer is one, each
+// scaled-down region gets resolved into this surface first, then scaled from here into capture_staging
+static uint8_t default_framebuffer_multisampled = 0;
+static struct PluginSurfaceUserdata capture_resolve = {0};
+
+// atlas slots can't be cleared with glClear, so this 1x1 texture gets cleared instead and stretched over the slot
+static unsigned int surface_clear_framebuffer = 0;
+static unsigned int surface_clear_texture = 0;
+
+// drawing one surface to another in the same atlas would read and write the same texture, so the
+// source gets copied here first
+static struct PluginSurfaceUserdata surface_draw_staging = {0};
 
 struct GLContext* _bolt_context() {
 #if defined(_WIN32)
@@ -173,49 +380,52 @@ static void _bolt_set_context(struct GLContext* context) {
 #endif
 }
 
+static int _bolt_context_map_compare(const void* a, const void* b, void* udata) {
+    return **(uintptr_t**)a != **(uintptr_t**)b;
+}
+
+// items are GLContext pointers, whose first member is the id, so a pointer to an id can be used as a key
+static uint64_t _bolt_context_map_hash(const void* item, uint64_t seed0, uint64_t seed1) {
+    return hashmap_sip(*(uintptr_t**)item, sizeof(uintptr_t), seed0, seed1);
+}
+
+static struct GLContext* _bolt_find_context(uintptr_t id) {
+    if (!contexts) return NULL;
+    const uintptr_t* key = &id;
+    struct GLContext** ptr = (struct GLContext**)hashmap_get(contexts, &key);
+    return ptr ? *ptr : NULL;
+}
+
 size_t _bolt_context_count() {
-    size_t ret = 0;
-    for (size_t i = 0; i < CONTEXTS_CAPACITY; i += 1) {
-        if (contexts[i].id != 0) {
-            ret += 1;
-        }
-    }
-    return ret;
+    return contexts ? hashmap_count(contexts) : 0;
 }
 
 void _bolt_create_context(void* egl_context, void* shared) {
-    for (size_t i = 0; i < CONTEXTS_CAPACITY; i += 1) {
-        struct GLContext* ptr = &contexts[i];
-        if (ptr->id == 0) {
-            _bolt_glcontext_init(ptr, egl_context, shared);
-            ptr->is_attached = 1;
-            return;
-        }
+    if (!contexts) {
+        contexts = hashmap_new(sizeof(struct GLContext*), 8, 0, 0, _bolt_context_map_hash, _bolt_context_map_compare, NULL, NULL);
+        _bolt_rwlock_init(&texture_mirror_lock);
     }
+    struct GLContext* ptr = malloc(sizeof(*ptr));
+    _bolt_glcontext_init(ptr, egl_context, shared ? _bolt_find_context((uintptr_t)shared) : NULL);
+    ptr->is_attached = 1;
+    hashmap_set(contexts, &ptr);
 }
 
 void _bolt_destroy_context(void* egl_context) {
-    for (size_t i = 0; i < CONTEXTS_CAPACITY; i += 1) {
-        struct GLContext* ptr = &contexts[i];
-        if (ptr->id == (uintptr_t)egl_context) {
-            if (ptr->is_attached) {
-                ptr->deferred_destroy = 1;
-            } else {
-                _bolt_glcontext_free(ptr);
-                ptr->id = 0;
-            }
-            break;
-        }
+    struct GLContext* ptr = _bolt_find_context((uintptr_t)egl_context);
+    if (!ptr) return;
+    if (ptr->is_attached) {
+        ptr->deferred_destroy = 1;
+        return;
+    }
+    hashmap_delete(contexts, &ptr);
+    _bolt_glcontext_free(ptr);
+    free(ptr);
+    if (hashmap_count(contexts) == 0) {
+        hashmap_free(contexts);
+        contexts = NULL;
+        _bolt_rwlock_destroy(&texture_mirror_lock);
     }
-}
-
-void _bolt_set_attr_binding(struct GLContext* c, struct GLAttrBinding* binding, unsigned int buffer, int size, const void* offset, unsigned int stride, uint32_t type, uint8_t normalise) {
-    binding->buffer = _bolt_context_get_buffer(c, buffer);
-    binding->offset = (uintptr_t)offset;
-    binding->size = size;
-    binding->stride = stride;
-    binding->normalise = normalise;
-    binding->type = type;
 }
 
 float _bolt_f16_to_f32(uint16_t bits) {
@@ -228,104 +438,209 @@ float _bolt_f16_to_f32(uint16_t bits) {
     return u.f;
 }
 
-uint8_t _bolt_get_attr_binding(struct GLContext* c, const struct GLAttrBinding* binding, size_t index, size_t num_out, float* out) {
-    struct GLArrayBuffer* buffer = binding->buffer;
-    if (!buffer || !buffer->data) return 0;
-    uintptr_t buf_offset = binding->offset + (binding->stride * index);
-
-    const uint8_t* ptr = (uint8_t*)buffer->data + buf_offset;
-    if (!binding->normalise) {
-        switch (binding->type) {
-            case GL_FLOAT:
-                memcpy(out, ptr, num_out * sizeof(float));
-                break;
+/*
+decode kernels for vertex attributes, one for each (type, normalise) pair. one of these is picked
+when an attribute gets bound, so reading a vertex doesn't have to switch on its type every time.
+the number of elements isn't known until read time, since the same attribute gets read with
+different counts - e.g. xyz and bone ID are read from the same vec4 - so it's passed in instead.
+*/
+
+#define DEFINE_ATTR_DECODE(NAME, TYPE, EXPR) \
+static void _bolt_attr_decode_##NAME(const uint8_t* ptr, size_t num_out, float* out) { \
+    for (size_t i = 0; i < num_out; i += 1) { \
+        TYPE v; \
+        memcpy(&v, ptr + (i * sizeof(TYPE)), sizeof(TYPE)); \
+        out[i] = (EXPR); \
+    } \
+}
+
+#define DEFINE_ATTR_DECODE_INT(NAME, TYPE) \
+static void _bolt_attr_decode_int_##NAME(const uint8_t* ptr, size_t num_out, int32_t* out) { \
+    for (size_t i = 0; i < num_out; i += 1) { \
+        TYPE v; \
+        memcpy(&v, ptr + (i * sizeof(TYPE)), sizeof(TYPE)); \
+        out[i] = (int32_t)v; \
+    } \
+}
+
+static void _bolt_attr_decode_float(const uint8_t* ptr, size_t num_out, float* out) {
+    memcpy(out, ptr, num_out * sizeof(float));
+}
+
+static void _bolt_attr_decode_unsupported(const uint8_t* ptr, size_t num_out, float* out) {
+    memset(out, 0, num_out * sizeof(float));
+}
+
+DEFINE_ATTR_DECODE(half, uint16_t, _bolt_f16_to_f32(v))
+DEFINE_ATTR_DECODE(ubyte, uint8_t, (float)v)
+DEFINE_ATTR_DECODE(ushort, uint16_t, (float)v)
+DEFINE_ATTR_DECODE(uint, uint32_t, (float)v)
+DEFINE_ATTR_DECODE(byte, int8_t, (float)v)
+DEFINE_ATTR_DECODE(short, int16_t, (float)v)
+DEFINE_ATTR_DECODE(int, int32_t, (float)v)
+DEFINE_ATTR_DECODE(ubyte_norm, uint8_t, ((float)v) / 255.0)
+DEFINE_ATTR_DECODE(ushort_norm, uint16_t, ((float)v) / 65535.0)
+DEFINE_ATTR_DECODE(uint_norm, uint32_t, ((float)v) / 4294967295.0)
+DEFINE_ATTR_DECODE(byte_norm, int8_t, ((((float)v) + 128.0) * 2.0 / 255.0) - 1.0)
+DEFINE_ATTR_DECODE_INT(ubyte, uint8_t)
+DEFINE_ATTR_DECODE_INT(ushort, uint16_t)
+DEFINE_ATTR_DECODE_INT(uint, uint32_t)
+DEFINE_ATTR_DECODE_INT(byte, int8_t)
+DEFINE_ATTR_DECODE_INT(short, int16_t)
+DEFINE_ATTR_DECODE_INT(int, int32_t)
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BOLT_HAVE_F16C_DECODE
+// half-floats are the most common vertex attribute type in this game, and the only one where the
+// scalar conversion is much more than a cast, so it's the only one worth doing in hardware per vertex.
+// the others are all one or two instructions per element already; normalised bytes and shorts are
+// only worth vectorising across a whole range of vertices, which attr.c does for the bulk functions.
+__attribute__((target("f16c"))) static void _bolt_attr_decode_half_f16c(const uint8_t* ptr, size_t num_out, float* out) {
+    for (size_t i = 0; i < num_out; i += 4) {
+        const size_t n = (num_out - i) < 4 ? (num_out - i) : 4;
+        uint16_t halfs[8] = {0};
+        float floats[4];
+        memcpy(halfs, ptr + (i * 2), n * sizeof(uint16_t));
+        _mm_storeu_ps(floats, _mm_cvtph_ps(_mm_loadu_si128((const __m128i*)halfs)));
+        memcpy(out + i, floats, n * sizeof(float));
+    }
+}
+#endif
+
+static GLAttrDecodeFunction _bolt_attr_decode_function(uint32_t type, uint8_t normalise) {
+    if (!normalise) {
+        switch (type) {
+            case GL_FLOAT: return _bolt_attr_decode_float;
             case GL_HALF_FLOAT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = _bolt_f16_to_f32(*(uint16_t*)(ptr + (i * 2)));
-                break;
-            case GL_UNSIGNED_BYTE:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (float)*(uint8_t*)(ptr + i);
-                break;
-            case GL_UNSIGNED_SHORT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (float)*(uint16_t*)(ptr + (i * 2));
-                break;
-            case GL_UNSIGNED_INT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (float)*(uint32_t*)(ptr + (i * 4));
-                break;
-            case GL_BYTE:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (float)*(int8_t*)(ptr + i);
-                break;
-            case GL_SHORT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (float)*(int16_t*)(ptr + (i * 2));
-                break;
-            case GL_INT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (float)*(int32_t*)(ptr + (i * 4));
-                break;
+#if defined(BOLT_HAVE_F16C_DECODE)
+                if (__builtin_cpu_supports("f16c")) return _bolt_attr_decode_half_f16c;
+#endif
+                return _bolt_attr_decode_half;
+            case GL_UNSIGNED_BYTE: return _bolt_attr_decode_ubyte;
+            case GL_UNSIGNED_SHORT: return _bolt_attr_decode_ushort;
+            case GL_UNSIGNED_INT: return _bolt_attr_decode_uint;
+            case GL_BYTE: return _bolt_attr_decode_byte;
+            case GL_SHORT: return _bolt_attr_decode_short;
+            case GL_INT: return _bolt_attr_decode_int;
             default:
-                printf("warning: unsupported non-normalise type %u\n", binding->type);
-                memset(out, 0, num_out * sizeof(float));
-                break;
+                printf("warning: unsupported non-normalise type %u\n", type);
+                return _bolt_attr_decode_unsupported;
         }
     } else {
-        switch (binding->type) {
-            case GL_FLOAT:
-                memcpy(out, ptr, num_out * sizeof(float));
-                break;
-            case GL_UNSIGNED_BYTE:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = ((float)*(uint8_t*)(ptr + i)) / 255.0;
-                break;
-            case GL_UNSIGNED_SHORT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = ((float)*(uint16_t*)(ptr + (i * 2))) / 65535.0;
-                break;
-            case GL_UNSIGNED_INT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = ((float)*(uint32_t*)(ptr + (i * 4))) / 4294967295.0;
-                break;
-            case GL_BYTE:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = ((((float)*(int8_t*)(ptr + i)) + 128.0) * 2.0 / 255.0) - 1.0;
-                break;
+        switch (type) {
+            case GL_FLOAT: return _bolt_attr_decode_float;
+            case GL_UNSIGNED_BYTE: return _bolt_attr_decode_ubyte_norm;
+            case GL_UNSIGNED_SHORT: return _bolt_attr_decode_ushort_norm;
+            case GL_UNSIGNED_INT: return _bolt_attr_decode_uint_norm;
+            case GL_BYTE: return _bolt_attr_decode_byte_norm;
             default:
-                printf("warning: unsupported normalise type %u\n", binding->type);
-                memset(out, 0, num_out * sizeof(float));
-                break;
+                printf("warning: unsupported normalise type %u\n", type);
+                return _bolt_attr_decode_unsupported;
         }
     }
+}
+
+static GLAttrDecodeIntFunction _bolt_attr_decode_int_function(uint32_t type, uint8_t normalise) {
+    if (normalise) return NULL;
+    switch (type) {
+        case GL_UNSIGNED_BYTE: return _bolt_attr_decode_int_ubyte;
+        case GL_UNSIGNED_SHORT: return _bolt_attr_decode_int_ushort;
+        case GL_UNSIGNED_INT: return _bolt_attr_decode_int_uint;
+        case GL_BYTE: return _bolt_attr_decode_int_byte;
+        case GL_SHORT: return _bolt_attr_decode_int_short;
+        case GL_INT: return _bolt_attr_decode_int_int;
+        default: return NULL;
+    }
+}
+
+static BoltAttrDecodeRange _bolt_attr_decode_range_function(uint32_t type, uint8_t normalise) {
+    struct BoltAttrKernels kernels;
+    _bolt_attr_best_kernels(&kernels);
+    if (normalise && type == GL_UNSIGNED_BYTE) return kernels.ubyte_norm;
+    if (!normalise && type == GL_SHORT) return kernels.short_int;
+    return NULL;
+}
+
+// returns the CPU copy of a buffer's contents, or NULL if there isn't one. the copy is filled in by the upload hooks,
+// which already have the bytes in hand, so nothing is ever read back from the driver in the middle of a draw.
+static void* _bolt_buffer_shadow(struct GLArrayBuffer* buffer) {
+    if (!buffer) return NULL;
+    return buffer->data;
+}
+
+// returns the `count` 16-bit indices at `offset` in an element buffer's shadow copy, or NULL if the range is
+// outside the buffer or the buffer hasn't had any contents uploaded to it from the CPU.
+static const unsigned short* _bolt_buffer_indices(struct GLArrayBuffer* buffer, const void* offset, GLsizei count) {
+    const size_t size = (size_t)count * sizeof(unsigned short);
+    if (!buffer || (uintptr_t)offset > buffer->size || size > buffer->size - (uintptr_t)offset) return NULL;
+    const uint8_t* data = _bolt_buffer_shadow(buffer);
+    return data ? (const unsigned short*)(data + (uintptr_t)offset) : NULL;
+}
+
+// called when a buffer's storage is (re)created with glBufferData or glBufferStorage. storage created without
+// any contents doesn't get a shadow until something is actually written into it; see _bolt_buffer_write.
+static void _bolt_buffer_storage(struct GLArrayBuffer* buffer, GLsizeiptr size, const void* data) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = size;
+    if (data && size) {
+        buffer->data = malloc(size);
+        if (buffer->data) memcpy(buffer->data, data, size);
+    }
+}
+
+// called when the game writes `length` bytes at `offset` into a buffer from the CPU, i.e. a mapped range being
+// flushed. if the buffer has no shadow yet, one is made here; any part of it that hasn't been written yet has
+// undefined contents in GL anyway, so it's zeroed.
+static void _bolt_buffer_write(struct GLArrayBuffer* buffer, GLintptr offset, GLsizeiptr length, const void* data) {
+    if (offset < 0 || length <= 0 || offset > buffer->size || length > buffer->size - offset) return;
+    if (!buffer->data) {
+        buffer->data = calloc(1, buffer->size);
+        if (!buffer->data) return;
+    }
+    memcpy((uint8_t*)buffer->data + offset, data, length);
+}
+
+void _bolt_set_attr_binding(struct GLContext* c, struct GLAttrBinding* binding, unsigned int buffer, int size, const void* offset, unsigned int stride, uint32_t type, uint8_t normalise) {
+    binding->buffer = _bolt_context_get_buffer(c, buffer);
+    binding->offset = (uintptr_t)offset;
+    binding->size = size;
+    binding->stride = stride;
+    if (binding->decode == NULL || binding->type != type || binding->normalise != normalise) {
+        binding->decode = _bolt_attr_decode_function(type, normalise);
+        binding->decode_int = _bolt_attr_decode_int_function(type, normalise);
+        binding->decode_range = _bolt_attr_decode_range_function(type, normalise);
+    }
+    binding->normalise = normalise;
+    binding->type = type;
+}
+
+uint8_t _bolt_get_attr_binding(struct GLContext* c, const struct GLAttrBinding* binding, size_t index, size_t num_out, float* out) {
+    const uint8_t* data = _bolt_buffer_shadow(binding->buffer);
+    if (!data) return 0;
+    const uint8_t* ptr = data + binding->offset + (binding->stride * index);
+    binding->decode(ptr, num_out, out);
     return 1;
 }
 
 uint8_t _bolt_get_attr_binding_int(struct GLContext* c, const struct GLAttrBinding* binding, size_t index, size_t num_out, int32_t* out) {
-    struct GLArrayBuffer* buffer = binding->buffer;
-    if (!buffer || !buffer->data) return 0;
-    uintptr_t buf_offset = binding->offset + (binding->stride * index);
-
-    const uint8_t* ptr = (uint8_t*)buffer->data + buf_offset;
-    if (!binding->normalise) {
-        switch (binding->type) {
-            case GL_UNSIGNED_BYTE:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (int32_t)*(uint8_t*)(ptr + i);
-                break;
-            case GL_UNSIGNED_SHORT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (int32_t)*(uint16_t*)(ptr + (i * 2));
-                break;
-            case GL_UNSIGNED_INT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (int32_t)*(uint32_t*)(ptr + (i * 4));
-                break;
-            case GL_BYTE:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (int32_t)*(int8_t*)(ptr + i);
-                break;
-            case GL_SHORT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (int32_t)*(int16_t*)(ptr + (i * 2));
-                break;
-            case GL_INT:
-                for (size_t i = 0; i < num_out; i += 1) out[i] = (int32_t)*(int32_t*)(ptr + (i * 4));
-                break;
-            default:
-                return 0;
-        }
-    } else {
-        return 0;
-    }
+    if (!binding->decode_int) return 0;
+    const uint8_t* data = _bolt_buffer_shadow(binding->buffer);
+    if (!data) return 0;
+    const uint8_t* ptr = data + binding->offset + (binding->stride * index);
+    binding->decode_int(ptr, num_out, out);
     return 1;
 }
 
+#if defined(_MSC_VER)
+static void* _bolt_load_ptr(void* const* p) { return InterlockedCompareExchangePointer((PVOID volatile*)p, NULL, NULL); }
+static void _bolt_store_ptr(void** p, void* v) { InterlockedExchangePointer((PVOID volatile*)p, v); }
+#else
+static void* _bolt_load_ptr(void* const* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static void _bolt_store_ptr(void** p, void* v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+#endif
+
 static int _bolt_hashmap_compare(const void* a, const void* b, void* udata) {
     return (**(GLuint**)a) - (**(GLuint**)b);
 }
@@ -335,64 +650,141 @@ static uint64_t _bolt_hashmap_hash(const void* item, uint64_t seed0, uint64_t se
     return hashmap_sip(*id, sizeof(GLuint), seed0, seed1);
 }
 
-static void _bolt_hashmap_init(struct HashMap* map, size_t cap) {
-    _bolt_rwlock_init(&map->rwlock);
-    map->map = hashmap_new(sizeof(void*), cap, 0, 0, _bolt_hashmap_hash, _bolt_hashmap_compare, NULL, NULL);
+static struct GLObjectSlots* _bolt_objtable_slots_new(size_t capacity) {
+    struct GLObjectSlots* slots = calloc(1, sizeof(struct GLObjectSlots) + (capacity * sizeof(void*)));
+    slots->capacity = capacity;
+    return slots;
 }
 
-static void _bolt_hashmap_destroy(struct HashMap* map) {
-    _bolt_rwlock_destroy(&map->rwlock);
-    hashmap_free(map->map);
+static void _bolt_objtable_init(struct GLObjectTable* table, size_t cap) {
+    _bolt_rwlock_init(&table->rwlock);
+    table->slots = _bolt_objtable_slots_new(cap);
+    table->sparse = hashmap_new(sizeof(void*), 0, 0, 0, _bolt_hashmap_hash, _bolt_hashmap_compare, NULL, NULL);
 }
 
-static void _bolt_glcontext_init(struct GLContext* context, void* egl_context, void* egl_shared) {
-    struct GLContext* shared = NULL;
-    if (egl_shared) {
-        for (size_t i = 0; i < CONTEXTS_CAPACITY; i += 1) {
-            struct GLContext* ptr = &contexts[i];
-            if (ptr->id == (uintptr_t)egl_shared) {
-                shared = ptr;
-                break;
-            }
+static void _bolt_objtable_destroy(struct GLObjectTable* table) {
+    _bolt_rwlock_destroy(&table->rwlock);
+    struct GLObjectSlots* slots = table->slots;
+    while (slots) {
+        struct GLObjectSlots* previous = slots->previous;
+        free(slots);
+        slots = previous;
+    }
+    hashmap_free(table->sparse);
+}
+
+// doesn't need the lock, unless the name is too big to be looked up directly
+static void* _bolt_objtable_get(struct GLObjectTable* table, GLuint name) {
+    if (name < OBJECT_TABLE_DIRECT_LIMIT) {
+        struct GLObjectSlots* slots = _bolt_load_ptr((void* const*)&table->slots);
+        return name < slots->capacity ? _bolt_load_ptr(&slots->items[name]) : NULL;
+    }
+    const GLuint* name_ptr = &name;
+    _bolt_rwlock_lock_read(&table->rwlock);
+    void* const* item = hashmap_get(table->sparse, &name_ptr);
+    void* ret = item ? *item : NULL;
+    _bolt_rwlock_unlock_read(&table->rwlock);
+    return ret;
+}
+
+// `item` must start with its GLuint name. the write lock must be held
+static void _bolt_objtable_set(struct GLObjectTable* table, GLuint name, void* item) {
+    if (name >= OBJECT_TABLE_DIRECT_LIMIT) {
+        hashmap_set(table->sparse, &item);
+        return;
+    }
+    struct GLObjectSlots* slots = table->slots;
+    if (name >= slots->capacity) {
+        size_t capacity = slots->capacity;
+        while (name >= capacity) capacity *= 2;
+        if (capacity > OBJECT_TABLE_DIRECT_LIMIT) capacity = OBJECT_TABLE_DIRECT_LIMIT;
+        struct GLObjectSlots* grown = _bolt_objtable_slots_new(capacity);
+        memcpy(grown->items, slots->items, slots->capacity * sizeof(void*));
+        // readers might still be looking at the old array, so it can't be freed until the table is
+        grown->previous = slots;
+        _bolt_store_ptr((void**)&table->slots, grown);
+        slots = grown;
+    }
+    _bolt_store_ptr(&slots->items[name], item);
+}
+
+// returns the removed item, or NULL if there wasn't one. the write lock must be held
+static void* _bolt_objtable_remove(struct GLObjectTable* table, GLuint name) {
+    if (name >= OBJECT_TABLE_DIRECT_LIMIT) {
+        const GLuint* name_ptr = &name;
+        void* const* item = hashmap_delete(table->sparse, &name_ptr);
+        return item ? *item : NULL;
+    }
+    struct GLObjectSlots* slots = table->slots;
+    if (name >= slots->capacity) return NULL;
+    void* ret = slots->items[name];
+    _bolt_store_ptr(&slots->items[name], NULL);
+    return ret;
+}
+
+// works like hashmap_iter, with `iter` starting at 0. the lock must be held for reading or writing
+static bool _bolt_objtable_iter(struct GLObjectTable* table, size_t* iter, void** item) {
+    struct GLObjectSlots* slots = table->slots;
+    while (*iter < slots->capacity) {
+        void* ptr = slots->items[*iter];
+        *iter += 1;
+        if (ptr) {
+            *item = ptr;
+            return true;
         }
     }
+    size_t sparse_iter = *iter - slots->capacity;
+    void* sparse_item;
+    const bool ret = hashmap_iter(table->sparse, &sparse_iter, &sparse_item);
+    *iter = slots->capacity + sparse_iter;
+    if (ret) *item = *(void**)sparse_item;
+    return ret;
+}
+
+static void _bolt_glcontext_init(struct GLContext* context, void* egl_context, struct GLContext* shared) {
     memset(context, 0, sizeof(*context));
     context->id = (uintptr_t)egl_context;
     context->texture_units = calloc(MAX_TEXTURE_UNITS, sizeof(unsigned int));
+    context->uniform_buffer_bindings = calloc(MAX_UNIFORM_BUFFER_BINDINGS, sizeof(struct GLIndexedBinding));
+    // framebuffers are container objects, so they're never shared between contexts
+    context->framebuffers = malloc(sizeof(struct GLObjectTable));
+    _bolt_objtable_init(context->framebuffers, FRAMEBUFFER_LIST_CAPACITY);
     context->game_view_part_framebuffer = -1;
     context->game_view_sSourceTex = -1;
     context->does_blit_3d_target = false;
     context->recalculate_sSceneHDRTex = false;
     context->depth_of_field_enabled = false;
+    context->pack_alignment = 4;
     if (shared) {
-        context->programs = shared->programs;
-        context->buffers = shared->buffers;
-        context->textures = shared->textures;
-        context->vaos = shared->vaos;
+        context->share_group = shared->share_group;
     } else {
-        context->is_shared_owner = 1;
-        context->programs = malloc(sizeof(struct HashMap));
-        _bolt_hashmap_init(context->programs, PROGRAM_LIST_CAPACITY);
-        context->buffers = malloc(sizeof(struct HashMap));
-        _bolt_hashmap_init(context->buffers, BUFFER_LIST_CAPACITY);
-        context->textures = malloc(sizeof(struct HashMap));
-        _bolt_hashmap_init(context->textures, TEXTURE_LIST_CAPACITY);
-        context->vaos = malloc(sizeof(struct HashMap));
-        _bolt_hashmap_init(context->vaos, VAO_LIST_CAPACITY);
+        struct GLShareGroup* group = malloc(sizeof(*group));
+        _bolt_objtable_init(&group->programs, PROGRAM_LIST_CAPACITY);
+        _bolt_objtable_init(&group->buffers, BUFFER_LIST_CAPACITY);
+        _bolt_objtable_init(&group->textures, TEXTURE_LIST_CAPACITY);
+        _bolt_objtable_init(&group->vaos, VAO_LIST_CAPACITY);
+        group->context_count = 0;
+        context->share_group = group;
     }
+    context->share_group->context_count += 1;
 }
 
 static void _bolt_glcontext_free(struct GLContext* context) {
     free(context->texture_units);
-    if (context->is_shared_owner) {
-        _bolt_hashmap_destroy(context->programs);
-        free(context->programs);
-        _bolt_hashmap_destroy(context->buffers);
-        free(context->buffers);
-        _bolt_hashmap_destroy(context->textures);
-        free(context->textures);
-        _bolt_hashmap_destroy(context->vaos);
-        free(context->vaos);
+    free(context->uniform_buffer_bindings);
+    size_t iter = 0;
+    void* item;
+    while (_bolt_objtable_iter(context->framebuffers, &iter, &item)) free(item);
+    _bolt_objtable_destroy(context->framebuffers);
+    free(context->framebuffers);
+    struct GLShareGroup* group = context->share_group;
+    group->context_count -= 1;
+    if (group->context_count == 0) {
+        _bolt_objtable_destroy(&group->programs);
+        _bolt_objtable_destroy(&group->buffers);
+        _bolt_objtable_destroy(&group->textures);
+        _bolt_objtable_destroy(&group->vaos);
+        free(group);
     }
 }
 
@@ -410,86 +802,305 @@ static GLenum _bolt_binding_for_buffer(GLuint target) {
     }
 }
 
-static struct GLProgram* _bolt_context_get_program(struct GLContext* c, GLuint index) {
-    struct HashMap* map = c->programs;
-    const GLuint* index_ptr = &index;
-    _bolt_rwlock_lock_read(&map->rwlock);
-    struct GLProgram** program = (struct GLProgram**)hashmap_get(map->map, &index_ptr);
-    struct GLProgram* ret = program ? *program : NULL;
-    _bolt_rwlock_unlock_read(&map->rwlock);
+// returns the buffer currently bound to the given target, according to our shadow state
+static GLuint _bolt_context_bound_buffer(struct GLContext* c, GLenum target) {
+    GLuint ret;
+    switch (target) {
+        case GL_ARRAY_BUFFER:
+            ret = c->bound_array_buffer;
+            break;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            ret = c->bound_vao ? c->bound_vao->element_array_buffer : c->default_element_array_buffer;
+            break;
+        case GL_UNIFORM_BUFFER:
+            ret = c->bound_uniform_buffer;
+            break;
+        default:
+            return 0;
+    }
+    VERIFY_INTEGERV(_bolt_binding_for_buffer(target), ret);
     return ret;
 }
 
+static struct GLProgram* _bolt_context_get_program(struct GLContext* c, GLuint index) {
+    return _bolt_objtable_get(&c->share_group->programs, index);
+}
+
 static struct GLArrayBuffer* _bolt_context_get_buffer(struct GLContext* c, GLuint index) {
-    struct HashMap* map = c->buffers;
-    const GLuint* index_ptr = &index;
-    _bolt_rwlock_lock_read(&map->rwlock);
-    struct GLArrayBuffer** buffer = (struct GLArrayBuffer**)hashmap_get(map->map, &index_ptr);
-    struct GLArrayBuffer* ret = buffer ? *buffer : NULL;
-    _bolt_rwlock_unlock_read(&map->rwlock);
-    return ret;
+    return _bolt_objtable_get(&c->share_group->buffers, index);
 }
 
 static struct GLTexture2D* _bolt_context_get_texture(struct GLContext* c, GLuint index) {
-    struct HashMap* map = c->textures;
-    const GLuint* index_ptr = &index;
-    _bolt_rwlock_lock_read(&map->rwlock);
-    struct GLTexture2D** tex = (struct GLTexture2D**)hashmap_get(map->map, &index_ptr);
-    struct GLTexture2D* ret = tex ? *tex : NULL;
-    _bolt_rwlock_unlock_read(&map->rwlock);
-    return ret;
+    return _bolt_objtable_get(&c->share_group->textures, index);
 }
 
 static struct GLVertexArray* _bolt_context_get_vao(struct GLContext* c, GLuint index) {
-    struct HashMap* map = c->vaos;
-    const GLuint* index_ptr = &index;
-    _bolt_rwlock_lock_read(&map->rwlock);
-    struct GLVertexArray** vao = (struct GLVertexArray**)hashmap_get(map->map, &index_ptr);
-    struct GLVertexArray* ret = vao ? *vao : NULL;
-    _bolt_rwlock_unlock_read(&map->rwlock);
+    return _bolt_objtable_get(&c->share_group->vaos, index);
+}
+
+static struct GLFramebuffer* _bolt_context_get_framebuffer(struct GLContext* c, GLuint index) {
+    return _bolt_objtable_get(c->framebuffers, index);
+}
+
+// equivalent to GetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME) for
+// GL_COLOR_ATTACHMENT0 of the bound draw framebuffer, except it returns 0 for the default framebuffer
+static GLuint _bolt_context_draw_attachment(struct GLContext* c) {
+    const GLuint ret = c->draw_framebuffer ? c->draw_framebuffer->colour_attachment0 : 0;
+    VERIFY_ATTACHMENT(GL_DRAW_FRAMEBUFFER, c->current_draw_framebuffer, ret);
     return ret;
 }
 
-static void _bolt_unpack_rgb565(uint16_t packed, uint8_t out[3]) {
-    out[0] = (packed >> 11) & 0b00011111;
-    out[0] = (out[0] << 3) | (out[0] >> 2);
-    out[1] = (packed >> 5) & 0b00111111;
-    out[1] = (out[1] << 2) | (out[1] >> 4);
-    out[2] = packed & 0b00011111;
-    out[2] = (out[2] << 3) | (out[2] >> 2);
+// same as _bolt_context_draw_attachment but for the read framebuffer
+static GLuint _bolt_context_read_attachment(struct GLContext* c) {
+    const GLuint ret = c->read_framebuffer ? c->read_framebuffer->colour_attachment0 : 0;
+    VERIFY_ATTACHMENT(GL_READ_FRAMEBUFFER, c->current_read_framebuffer, ret);
+    return ret;
 }
 
-// use a lookup table for each of the possible 5-bit and 6-bit values for consistency across platforms
-// `lut5 = [round(pow(((x << 3) | (x >> 2)) / 255.0, 2.2) * 255.0) for x in range(32)]`
-// `lut6 = [round(pow(((x << 2) | (x >> 4)) / 255.0, 2.2) * 255.0) for x in range(64)]`
-//const uint8_t lut5[] = {0, 0, 1, 1, 3, 5, 7, 9, 13, 17, 21, 26, 32, 38, 44, 51, 60, 68, 77, 87, 98, 109, 120, 132, 146, 159, 173, 188, 205, 221, 238, 255};
-//const uint8_t lut6[] = {0, 0, 0, 0, 1, 1, 1, 2, 3, 3, 4, 5, 6, 8, 9, 11, 13, 14, 16, 18, 20, 23, 25, 28, 30, 33, 36, 39, 43, 46, 49, 53, 58, 62, 66, 70, 75, 79, 84, 89, 94, 99, 105, 110, 116, 121, 127, 133, 141, 148, 154, 161, 168, 175, 182, 190, 197, 205, 213, 221, 229, 238, 246, 255};
-static void _bolt_unpack_srgb565(uint16_t packed, uint8_t out[3]) {
-    // game seems to be giving us RGBA and telling us it's SRGB, so for now, just don't convert it
-    _bolt_unpack_rgb565(packed, out);
-    //out[0] = lut5[(packed >> 11) & 0b00011111];
-    //out[1] = lut6[(packed >> 5) & 0b00111111];
-    //out[2] = lut5[packed & 0b00011111];
+// returns a pointer to the contents of the ViewTransforms uniform block for the given program,
+// i.e. the contents of whichever buffer is bound to its binding point, or NULL if there isn't one
+static const uint8_t* _bolt_context_view_transforms(struct GLContext* c, const struct GLProgram* p) {
+    const GLuint binding = p->ubo_binding_ViewTransforms;
+    VERIFY_UNIFORM_BLOCK_BINDING(p->id, p->block_index_ViewTransforms, binding);
+    if (binding >= MAX_UNIFORM_BUFFER_BINDINGS) return NULL;
+    const struct GLIndexedBinding* ubo = &c->uniform_buffer_bindings[binding];
+    VERIFY_INTEGERI_V(GL_UNIFORM_BUFFER_BINDING, binding, ubo->buffer);
+    VERIFY_INTEGERI_V(GL_UNIFORM_BUFFER_START, binding, ubo->offset);
+    const uint8_t* data = _bolt_buffer_shadow(_bolt_context_get_buffer(c, ubo->buffer));
+    return data ? data + ubo->offset : NULL;
+}
+
+// resets the shadow copies of a program's uniforms to 0, which in GL happens every time a program is linked
+static void _bolt_program_reset_uniforms(struct GLProgram* p) {
+    p->uDiffuseMap = 0;
+    p->uTextureAtlas = 0;
+    p->uTextureAtlasSettings = 0;
+    p->sSceneHDRTex = 0;
+    p->sSourceTex = 0;
+    memset(p->uProjectionMatrix, 0, sizeof(p->uProjectionMatrix));
+    memset(p->uModelMatrix, 0, sizeof(p->uModelMatrix));
+    memset(p->uAtlasMeta, 0, sizeof(p->uAtlasMeta));
+    if (p->bone_count) {
+        // the palette is kept across links as long as its size doesn't change, see _bolt_glLinkProgram
+        if (!p->uBoneTransforms) p->uBoneTransforms = malloc(p->bone_count * 3 * 4 * sizeof(GLfloat));
+        if (p->uBoneTransforms) memset(p->uBoneTransforms, 0, p->bone_count * 3 * 4 * sizeof(GLfloat));
+    }
+    p->ubo_binding_ViewTransforms = 0;
+}
+
+static void _bolt_program_set_uniform_ints(struct GLProgram* p, GLint location, GLsizei count, const GLint* value) {
+    if (location == -1 || count < 1) return;
+#define UNIFORM_MAP(NAME) if (location == p->loc_##NAME) p->NAME = value[0];
+    UNIFORM_MAP(uDiffuseMap)
+    UNIFORM_MAP(uTextureAtlas)
+    UNIFORM_MAP(uTextureAtlasSettings)
+    UNIFORM_MAP(sSceneHDRTex)
+    UNIFORM_MAP(sSourceTex)
+#undef UNIFORM_MAP
+}
+
+static void _bolt_program_set_uniform_vec4s(struct GLProgram* p, GLint location, GLsizei count, const GLfloat* value) {
+    if (location == -1 || count < 1) return;
+    if (location == p->loc_uAtlasMeta) memcpy(p->uAtlasMeta, value, sizeof(p->uAtlasMeta));
+    if (p->uBoneTransforms && location >= p->loc_uBoneTransforms && location < p->loc_uBoneTransforms + (p->bone_count * 3)) {
+        const GLint first = location - p->loc_uBoneTransforms;
+        const GLsizei available = (p->bone_count * 3) - first;
+        memcpy(p->uBoneTransforms + (first * 4), value, (count < available ? count : available) * 4 * sizeof(GLfloat));
+    }
+}
+
+static void _bolt_program_set_uniform_mat4s(struct GLProgram* p, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    if (location == -1 || count < 1) return;
+    GLfloat* out;
+    if (location == p->loc_uProjectionMatrix) out = p->uProjectionMatrix;
+    else if (location == p->loc_uModelMatrix) out = p->uModelMatrix;
+    else return;
+    if (transpose) {
+        for (size_t i = 0; i < 16; i += 1) out[i] = value[((i & 3) * 4) + (i >> 2)];
+    } else {
+        memcpy(out, value, 16 * sizeof(GLfloat));
+    }
 }
 
 // note this function binds GL_DRAW_FRAMEBUFFER and GL_TEXTURE_2D (for the current active texture unit)
 // so you'll have to restore the prior values yourself if you need to leave the opengl state unchanged
-static void _bolt_gl_surface_init_buffers(struct PluginSurfaceUserdata* userdata) {
-    gl.GenFramebuffers(1, &userdata->framebuffer);
-    lgl->GenTextures(1, &userdata->renderbuffer);
-    gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, userdata->framebuffer);
-    lgl->BindTexture(GL_TEXTURE_2D, userdata->renderbuffer);
-    gl.TexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, userdata->width, userdata->height);
+static void _bolt_gl_surface_init_buffers(unsigned int* framebuffer, unsigned int* texture, unsigned int width, unsigned int height) {
+    gl.GenFramebuffers(1, framebuffer);
+    lgl->GenTextures(1, texture);
+    gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, *framebuffer);
+    lgl->BindTexture(GL_TEXTURE_2D, *texture);
+    gl.TexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
     lgl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     lgl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     lgl->TexParameteri(GL_TEXTURE_2D,  GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     lgl->TexParameteri(GL_TEXTURE_2D,  GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    gl.FramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, userdata->renderbuffer, 0);
+    gl.FramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, *texture, 0);
+}
+
+static void _bolt_gl_surface_destroy_buffers(unsigned int framebuffer, unsigned int texture) {
+    gl.DeleteFramebuffers(1, &framebuffer);
+    lgl->DeleteTextures(1, &texture);
+}
+
+// returns the atlas size class for a surface of this size, or SURFACE_ATLAS_CLASS_COUNT if it's too big for one
+static unsigned int _bolt_gl_surface_atlas_class(unsigned int width, unsigned int height) {
+    const unsigned int size = width > height ? width : height;
+    unsigned int atlas_class = 0;
+    while (atlas_class < SURFACE_ATLAS_CLASS_COUNT && (SURFACE_ATLAS_MIN_SLOT << atlas_class) < size) atlas_class += 1;
+    return atlas_class;
+}
+
+static unsigned int _bolt_gl_surface_size_class(unsigned int size) {
+    if (size == 0) return SURFACE_SIZE_CLASS;
+    return ((size + SURFACE_SIZE_CLASS - 1) / SURFACE_SIZE_CLASS) * SURFACE_SIZE_CLASS;
+}
+
+// finds space for a surface of the given size, either in an atlas, a pooled texture or a new texture, and
+// sets everything in userdata accordingly. like init_buffers, this binds GL_DRAW_FRAMEBUFFER and GL_TEXTURE_2D.
+// the contents of the surface's rectangle are undefined until it's cleared or uploaded to
+static void _bolt_gl_surface_alloc(struct PluginSurfaceUserdata* userdata, unsigned int width, unsigned int height) {
+    userdata->width = width;
+    userdata->height = height;
+    const unsigned int atlas_class = _bolt_gl_surface_atlas_class(width, height);
+    if (atlas_class < SURFACE_ATLAS_CLASS_COUNT) {
+        struct SurfaceAtlas* atlas = surface_atlases[atlas_class];
+        while (atlas && atlas->used_count == atlas->slot_count) atlas = atlas->next;
+        if (!atlas) {
+            atlas = malloc(sizeof(struct SurfaceAtlas));
+            if (atlas) {
+                const unsigned int slots_per_row = SURFACE_ATLAS_SIZE / (SURFACE_ATLAS_MIN_SLOT << atlas_class);
+                atlas->slot_size = SURFACE_ATLAS_MIN_SLOT << atlas_class;
+                atlas->slot_count = slots_per_row * slots_per_row;
+                atlas->used_count = 0;
+                memset(atlas->used, 0, sizeof(atlas->used));
+                _bolt_gl_surface_init_buffers(&atlas->framebuffer, &atlas->texture, SURFACE_ATLAS_SIZE, SURFACE_ATLAS_SIZE);
+                atlas->next = surface_atlases[atlas_class];
+                surface_atlases[atlas_class] = atlas;
+            }
+        }
+        if (atlas) {
+            unsigned int slot = 0;
+            for (size_t i = 0; i < atlas->slot_count / 64; i += 1) {
+                if (atlas->used[i] == UINT64_MAX) continue;
+                unsigned int bit = 0;
+                while (atlas->used[i] & ((uint64_t)1 << bit)) bit += 1;
+                atlas->used[i] |= (uint64_t)1 << bit;
+                slot = (i * 64) + bit;
+                break;
+            }
+            atlas->used_count += 1;
+            const unsigned int slots_per_row = SURFACE_ATLAS_SIZE / atlas->slot_size;
+            userdata->x = (slot % slots_per_row) * atlas->slot_size;
+            userdata->y = (slot / slots_per_row) * atlas->slot_size;
+            userdata->tex_width = SURFACE_ATLAS_SIZE;
+            userdata->tex_height = SURFACE_ATLAS_SIZE;
+            userdata->framebuffer = atlas->framebuffer;
+            userdata->renderbuffer = atlas->texture;
+            userdata->atlas = atlas;
+            gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, userdata->framebuffer);
+            lgl->BindTexture(GL_TEXTURE_2D, userdata->renderbuffer);
+            return;
+        }
+    }
+
+    userdata->x = 0;
+    userdata->y = 0;
+    userdata->tex_width = _bolt_gl_surface_size_class(width);
+    userdata->tex_height = _bolt_gl_surface_size_class(height);
+    userdata->atlas = NULL;
+    for (size_t i = surface_pool_count; i > 0; i -= 1) {
+        const struct PooledSurfaceBuffers* buffers = &surface_pool[i - 1];
+        if (buffers->width != userdata->tex_width || buffers->height != userdata->tex_height) continue;
+        userdata->framebuffer = buffers->framebuffer;
+        userdata->renderbuffer = buffers->texture;
+        surface_pool_size -= (size_t)buffers->width * buffers->height * 4;
+        memmove(&surface_pool[i - 1], &surface_pool[i], (surface_pool_count - i) * sizeof(*surface_pool));
+        surface_pool_count -= 1;
+        gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, userdata->framebuffer);
+        lgl->BindTexture(GL_TEXTURE_2D, userdata->renderbuffer);
+        return;
+    }
+    _bolt_gl_surface_init_buffers(&userdata->framebuffer, &userdata->renderbuffer, userdata->tex_width, userdata->tex_height);
+}
+
+// gives a surface's space back to its atlas or the pool. doesn't free userdata itself
+static void _bolt_gl_surface_free(struct PluginSurfaceUserdata* userdata) {
+    struct SurfaceAtlas* atlas = userdata->atlas;
+    if (atlas) {
+        const unsigned int slots_per_row = SURFACE_ATLAS_SIZE / atlas->slot_size;
+        const unsigned int slot = ((userdata->y / atlas->slot_size) * slots_per_row) + (userdata->x / atlas->slot_size);
+        atlas->used[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+        atlas->used_count -= 1;
+        userdata->atlas = NULL;
+        if (atlas->used_count) return;
+
+        // empty atlases are deleted, unless it's the last one of its size, which is kept around for next time
+        const unsigned int atlas_class = _bolt_gl_surface_atlas_class(atlas->slot_size, atlas->slot_size);
+        struct SurfaceAtlas** link = &surface_atlases[atlas_class];
+        if (*link == atlas && !atlas->next) return;
+        while (*link != atlas) link = &(*link)->next;
+        *link = atlas->next;
+        _bolt_gl_surface_destroy_buffers(atlas->framebuffer, atlas->texture);
+        free(atlas);
+        return;
+    }
+
+    if (surface_pool_count == surface_pool_capacity) {
+        const size_t capacity = surface_pool_capacity ? surface_pool_capacity * 2 : 16;
+        struct PooledSurfaceBuffers* pool = realloc(surface_pool, capacity * sizeof(*pool));
+        if (!pool) {
+            _bolt_gl_surface_destroy_buffers(userdata->framebuffer, userdata->renderbuffer);
+            return;
+        }
+        surface_pool = pool;
+        surface_pool_capacity = capacity;
+    }
+    surface_pool[surface_pool_count] = (struct PooledSurfaceBuffers){.framebuffer = userdata->framebuffer, .texture = userdata->renderbuffer, .width = userdata->tex_width, .height = userdata->tex_height};
+    surface_pool_count += 1;
+    surface_pool_size += (size_t)userdata->tex_width * userdata->tex_height * 4;
+    while (surface_pool_size > SURFACE_POOL_MAX_SIZE) {
+        const struct PooledSurfaceBuffers* oldest = &surface_pool[0];
+        surface_pool_size -= (size_t)oldest->width * oldest->height * 4;
+        _bolt_gl_surface_destroy_buffers(oldest->framebuffer, oldest->texture);
+        surface_pool_count -= 1;
+        memmove(&surface_pool[0], &surface_pool[1], surface_pool_count * sizeof(*surface_pool));
+    }
+}
+
+// whether a surface can be resized to this size without having to move it somewhere else
+static uint8_t _bolt_gl_surface_fits(const struct PluginSurfaceUserdata* userdata, unsigned int width, unsigned int height) {
+    const unsigned int atlas_class = _bolt_gl_surface_atlas_class(width, height);
+    if (userdata->atlas) return atlas_class == _bolt_gl_surface_atlas_class(userdata->atlas->slot_size, userdata->atlas->slot_size);
+    if (atlas_class < SURFACE_ATLAS_CLASS_COUNT) return 0;
+    // a texture that's big enough is kept, as long as it's not wasting more than half of itself
+    const size_t needed = (size_t)_bolt_gl_surface_size_class(width) * _bolt_gl_surface_size_class(height);
+    return width <= userdata->tex_width && height <= userdata->tex_height && (size_t)userdata->tex_width * userdata->tex_height <= needed * 2;
 }
 
-static void _bolt_gl_surface_destroy_buffers(struct PluginSurfaceUserdata* userdata) {
-    gl.DeleteFramebuffers(1, &userdata->framebuffer);
-    lgl->DeleteTextures(1, &userdata->renderbuffer);
+// clears only the surface's own rectangle, which isn't possible with glClear for a surface that's in an
+// atlas, since glClear ignores the viewport. binds GL_DRAW_FRAMEBUFFER to the surface's framebuffer
+static void _bolt_gl_surface_clear_rect(const struct PluginSurfaceUserdata* userdata, GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    struct GLContext* c = _bolt_context();
+    if (!userdata->atlas) {
+        gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, userdata->framebuffer);
+        lgl->ClearColor(r, g, b, a);
+        lgl->Clear(GL_COLOR_BUFFER_BIT);
+        return;
+    }
+    if (!surface_clear_framebuffer) {
+        _bolt_gl_surface_init_buffers(&surface_clear_framebuffer, &surface_clear_texture, 1, 1);
+        const struct GLTexture2D* original_tex = c->texture_units[c->active_texture];
+        lgl->BindTexture(GL_TEXTURE_2D, original_tex ? original_tex->id : 0);
+    }
+    gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, surface_clear_framebuffer);
+    lgl->ClearColor(r, g, b, a);
+    lgl->Clear(GL_COLOR_BUFFER_BIT);
+    gl.BindFramebuffer(GL_READ_FRAMEBUFFER, surface_clear_framebuffer);
+    gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, userdata->framebuffer);
+    const GLint x = userdata->x;
+    const GLint y = userdata->y;
+    gl.BlitFramebuffer(0, 0, 1, 1, x, y, x + userdata->width, y + userdata->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    gl.BindFramebuffer(GL_READ_FRAMEBUFFER, c->current_read_framebuffer);
 }
 
 // this function is called at the earliest possible opportunity, and is never undone
@@ -504,12 +1115,15 @@ static void _bolt_gl_load(void* (*GetProcAddress)(const char*)) {
     INIT_GL_FUNC(AttachShader)
     INIT_GL_FUNC(BindAttribLocation)
     INIT_GL_FUNC(BindBuffer)
+    INIT_GL_FUNC(BindBufferBase)
+    INIT_GL_FUNC(BindBufferRange)
     INIT_GL_FUNC(BindFramebuffer)
     INIT_GL_FUNC(BindVertexArray)
     INIT_GL_FUNC(BlitFramebuffer)
     INIT_GL_FUNC(BufferData)
     INIT_GL_FUNC(BufferStorage)
     INIT_GL_FUNC(BufferSubData)
+    INIT_GL_FUNC(ClientWaitSync)
     INIT_GL_FUNC(CompileShader)
     INIT_GL_FUNC(CompressedTexSubImage2D)
     INIT_GL_FUNC(CopyImageSubData)
@@ -519,12 +1133,17 @@ static void _bolt_gl_load(void* (*GetProcAddress)(const char*)) {
     INIT_GL_FUNC(DeleteFramebuffers)
     INIT_GL_FUNC(DeleteProgram)
     INIT_GL_FUNC(DeleteShader)
+    INIT_GL_FUNC(DeleteSync)
     INIT_GL_FUNC(DeleteVertexArrays)
     INIT_GL_FUNC(DisableVertexAttribArray)
+    INIT_GL_FUNC(DrawArraysInstanced)
     INIT_GL_FUNC(DrawElements)
     INIT_GL_FUNC(EnableVertexAttribArray)
+    INIT_GL_FUNC(FenceSync)
     INIT_GL_FUNC(FlushMappedBufferRange)
+    INIT_GL_FUNC(FramebufferRenderbuffer)
     INIT_GL_FUNC(FramebufferTexture)
+    INIT_GL_FUNC(FramebufferTexture2D)
     INIT_GL_FUNC(FramebufferTextureLayer)
     INIT_GL_FUNC(GenBuffers)
     INIT_GL_FUNC(GenFramebuffers)
@@ -545,13 +1164,28 @@ static void _bolt_gl_load(void* (*GetProcAddress)(const char*)) {
     INIT_GL_FUNC(ShaderSource)
     INIT_GL_FUNC(TexStorage2D)
     INIT_GL_FUNC(Uniform1i)
+    INIT_GL_FUNC(Uniform1iv)
     INIT_GL_FUNC(Uniform2i)
+    INIT_GL_FUNC(Uniform4f)
+    INIT_GL_FUNC(Uniform4fv)
     INIT_GL_FUNC(Uniform4i)
+    INIT_GL_FUNC(UniformBlockBinding)
     INIT_GL_FUNC(UniformMatrix4fv)
     INIT_GL_FUNC(UnmapBuffer)
     INIT_GL_FUNC(UseProgram)
+    INIT_GL_FUNC(VertexAttribDivisor)
+    INIT_GL_FUNC(VertexAttribIPointer)
     INIT_GL_FUNC(VertexAttribPointer)
 #undef INIT_GL_FUNC
+    if (bolt_trace_recording) _bolt_trace_wrap_proc_functions(&gl);
+#if !defined(_WIN32)
+    // this is eglGetProcAddress, which can also find the core EGL functions
+    egl.GetCurrentDisplay = GetProcAddress("eglGetCurrentDisplay");
+    egl.QueryString = GetProcAddress("eglQueryString");
+    egl.CreateImageKHR = GetProcAddress("eglCreateImageKHR");
+    egl.DestroyImageKHR = GetProcAddress("eglDestroyImageKHR");
+    egl.EGLImageTargetTexture2DOES = GetProcAddress("glEGLImageTargetTexture2DOES");
+#endif
 }
 
 // this function is called when the "main" gl context gets created, and is undone by _bolt_gl_close()
@@ -577,13 +1211,17 @@ static void _bolt_gl_init() {
     gl.ShaderSource(direct_fs, 1, &source, &size);
     gl.CompileShader(direct_fs);
 
+    GLuint direct_screen_fs = gl.CreateShader(GL_FRAGMENT_SHADER);
+    source = &program_direct_screen_fs[0];
+    size = sizeof(program_direct_screen_fs) - sizeof(*program_direct_screen_fs);
+    gl.ShaderSource(direct_screen_fs, 1, &source, &size);
+    gl.CompileShader(direct_screen_fs);
+
     program_direct_screen = gl.CreateProgram();
     gl.AttachShader(program_direct_screen, direct_screen_vs);
-    gl.AttachShader(program_direct_screen, direct_fs);
+    gl.AttachShader(program_direct_screen, direct_screen_fs);
     gl.LinkProgram(program_direct_screen);
     program_direct_screen_sampler = gl.GetUniformLocation(program_direct_screen, "tex");
-    program_direct_screen_d_xywh = gl.GetUniformLocation(program_direct_screen, "d_xywh");
-    program_direct_screen_s_xywh = gl.GetUniformLocation(program_direct_screen, "s_xywh");
     program_direct_screen_src_wh_dest_wh = gl.GetUniformLocation(program_direct_screen, "src_wh_dest_wh");
 
     program_direct_surface = gl.CreateProgram();
@@ -598,6 +1236,7 @@ static void _bolt_gl_init() {
     gl.DeleteShader(direct_screen_vs);
     gl.DeleteShader(direct_surface_vs);
     gl.DeleteShader(direct_fs);
+    gl.DeleteShader(direct_screen_fs);
 
     GLuint region_vs = gl.CreateShader(GL_VERTEX_SHADER);
     source = &program_region_vs[0];
@@ -628,19 +1267,84 @@ static void _bolt_gl_init() {
     gl.BufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 8, square, GL_STATIC_DRAW);
     gl.EnableVertexAttribArray(0);
     gl.VertexAttribPointer(0, 2, GL_FLOAT, 0, 2 * sizeof(float), NULL);
+
+    // attributes 1 and 2 get pointed at the right part of the instance buffer for each draw call
+    gl.GenVertexArrays(1, &program_direct_screen_vao);
+    gl.BindVertexArray(program_direct_screen_vao);
+    gl.EnableVertexAttribArray(0);
+    gl.VertexAttribPointer(0, 2, GL_FLOAT, 0, 2 * sizeof(float), NULL);
+    gl.GenBuffers(1, &buffer_screen_draws);
+    gl.EnableVertexAttribArray(1);
+    gl.EnableVertexAttribArray(2);
+    gl.VertexAttribDivisor(1, 1);
+    gl.VertexAttribDivisor(2, 1);
     gl.BindVertexArray(0);
+    gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // nothing has been bound to GL_DRAW_FRAMEBUFFER yet, so this is about the default framebuffer
+    GLint sample_buffers = 0;
+    gl.GetIntegerv(GL_SAMPLE_BUFFERS, &sample_buffers);
+    default_framebuffer_multisampled = sample_buffers > 0;
 }
 
 void _bolt_gl_close() {
+    screen_draw_count = 0;
+    screen_draw_group_count = 0;
+    free(screen_draws);
+    free(screen_draw_groups);
+    free(screen_draw_instances);
+    screen_draws = NULL;
+    screen_draw_groups = NULL;
+    screen_draw_instances = NULL;
+    screen_draw_capacity = 0;
+    screen_draw_group_capacity = 0;
+    screen_draw_instance_capacity = 0;
+    gl.DeleteBuffers(1, &buffer_screen_draws);
     gl.DeleteBuffers(1, &buffer_vertices_square);
+    if (upload_ring) gl.DeleteBuffers(1, &upload_ring);
+    upload_ring = 0;
+    upload_ring_offset = 0;
+    _bolt_gl_plugin_read_screen_pixels_finish(NULL, 0, NULL);
+    for (size_t i = 0; i < CAPTURE_BUFFER_COUNT; i += 1) {
+        if (capture_buffers[i].buffer) gl.DeleteBuffers(1, &capture_buffers[i].buffer);
+        free(capture_buffers[i].regions);
+        memset(&capture_buffers[i], 0, sizeof(capture_buffers[i]));
+    }
+    if (capture_staging.framebuffer) _bolt_gl_surface_destroy_buffers(capture_staging.framebuffer, capture_staging.renderbuffer);
+    if (capture_resolve.framebuffer) _bolt_gl_surface_destroy_buffers(capture_resolve.framebuffer, capture_resolve.renderbuffer);
+    memset(&capture_resolve, 0, sizeof(capture_resolve));
+    if (surface_draw_staging.framebuffer) _bolt_gl_surface_destroy_buffers(surface_draw_staging.framebuffer, surface_draw_staging.renderbuffer);
+    memset(&surface_draw_staging, 0, sizeof(surface_draw_staging));
+    if (surface_clear_framebuffer) _bolt_gl_surface_destroy_buffers(surface_clear_framebuffer, surface_clear_texture);
+    surface_clear_framebuffer = 0;
+    surface_clear_texture = 0;
+    for (size_t i = 0; i < SURFACE_ATLAS_CLASS_COUNT; i += 1) {
+        while (surface_atlases[i]) {
+            struct SurfaceAtlas* atlas = surface_atlases[i];
+            surface_atlases[i] = atlas->next;
+            _bolt_gl_surface_destroy_buffers(atlas->framebuffer, atlas->texture);
+            free(atlas);
+        }
+    }
+    for (size_t i = 0; i < surface_pool_count; i += 1) {
+        _bolt_gl_surface_destroy_buffers(surface_pool[i].framebuffer, surface_pool[i].texture);
+    }
+    free(surface_pool);
+    surface_pool = NULL;
+    surface_pool_count = 0;
+    surface_pool_capacity = 0;
+    surface_pool_size = 0;
     gl.DeleteProgram(program_direct_screen);
     gl.DeleteProgram(program_direct_surface);
     gl.DeleteVertexArrays(1, &program_direct_vao);
+    gl.DeleteVertexArrays(1, &program_direct_screen_vao);
     _bolt_destroy_context((void*)egl_main_context);
+    _bolt_trace_close();
 }
 
 static GLuint _bolt_glCreateProgram() {
     LOG("glCreateProgram\n");
+    TRACE(CREATEPROGRAM, )
     GLuint id = gl.CreateProgram();
     struct GLContext* c = _bolt_context();
     struct GLProgram* program = malloc(sizeof(struct GLProgram));
@@ -662,33 +1366,40 @@ static GLuint _bolt_glCreateProgram() {
     program->loc_uGridSize = -1;
     program->loc_uVertexScale = -1;
     program->loc_sSceneHDRTex = -1;
+    program->loc_sSourceTex = -1;
+    program->loc_sBlurFarTex = -1;
     program->block_index_ViewTransforms = -1;
     program->offset_uCameraPosition = -1;
     program->offset_uViewProjMatrix = -1;
     program->is_2d = 0;
     program->is_3d = 0;
     program->is_minimap = 0;
-    _bolt_rwlock_lock_write(&c->programs->rwlock);
-    hashmap_set(c->programs->map, &program);
-    _bolt_rwlock_unlock_write(&c->programs->rwlock);
+    program->uBoneTransforms = NULL;
+    program->bone_count = 0;
+    _bolt_program_reset_uniforms(program);
+    _bolt_rwlock_lock_write(&c->share_group->programs.rwlock);
+    _bolt_objtable_set(&c->share_group->programs, id, program);
+    _bolt_rwlock_unlock_write(&c->share_group->programs.rwlock);
     LOG("glCreateProgram end\n");
     return id;
 }
 
 static void _bolt_glDeleteProgram(GLuint program) {
     LOG("glDeleteProgram\n");
+    TRACE(DELETEPROGRAM, T32(program))
     gl.DeleteProgram(program);
     struct GLContext* c = _bolt_context();
-    unsigned int* ptr = &program;
-    _bolt_rwlock_lock_write(&c->programs->rwlock);
-    struct GLProgram* const* p = hashmap_delete(c->programs->map, &ptr);
-    free(*p);
-    _bolt_rwlock_unlock_write(&c->programs->rwlock);
+    _bolt_rwlock_lock_write(&c->share_group->programs.rwlock);
+    struct GLProgram* p = _bolt_objtable_remove(&c->share_group->programs, program);
+    free(p->uBoneTransforms);
+    free(p);
+    _bolt_rwlock_unlock_write(&c->share_group->programs.rwlock);
     LOG("glDeleteProgram end\n");
 }
 
 static void _bolt_glBindAttribLocation(GLuint program, GLuint index, const GLchar* name) {
     LOG("glBindAttribLocation\n");
+    TRACE(BINDATTRIBLOCATION, T32(program) T32(index) TBLOB(name, strlen(name) + 1))
     gl.BindAttribLocation(program, index, name);
     struct GLContext* c = _bolt_context();
     struct GLProgram* p = _bolt_context_get_program(c, program);
@@ -706,6 +1417,7 @@ static void _bolt_glBindAttribLocation(GLuint program, GLuint index, const GLcha
 
 static void _bolt_glLinkProgram(GLuint program) {
     LOG("glLinkProgram\n");
+    TRACE(LINKPROGRAM, T32(program))
     gl.LinkProgram(program);
     struct GLContext* c = _bolt_context();
     struct GLProgram* p = _bolt_context_get_program(c, program);
@@ -722,6 +1434,22 @@ static void _bolt_glLinkProgram(GLuint program) {
     p->loc_sBlurFarTex = gl.GetUniformLocation(program, "sBlurFarTex");
     p->loc_uBoneTransforms = gl.GetUniformLocation(program, "uBoneTransforms");
 
+    // uBoneTransforms is an array of three vec4s per bone, and different shaders declare it with different
+    // lengths, so the palette is sized from what the driver says was linked rather than the most there could be
+    GLint bone_vec4s = 0;
+    if (p->loc_uBoneTransforms != -1) {
+        const GLchar* bone_name = "uBoneTransforms";
+        GLuint bone_index;
+        gl.GetUniformIndices(program, 1, &bone_name, &bone_index);
+        if ((GLint)bone_index != -1) gl.GetActiveUniformsiv(program, 1, &bone_index, GL_UNIFORM_SIZE, &bone_vec4s);
+    }
+    const GLsizei bone_count = (bone_vec4s / 3) < MAX_BONE_TRANSFORMS ? (bone_vec4s / 3) : MAX_BONE_TRANSFORMS;
+    if (bone_count != p->bone_count) {
+        free(p->uBoneTransforms);
+        p->uBoneTransforms = NULL;
+        p->bone_count = bone_count;
+    }
+
     const GLchar* view_var_names[] = {"uCameraPosition", "uViewProjMatrix"};
     const GLuint block_index_ViewTransforms = gl.GetUniformBlockIndex(program, "ViewTransforms");
     GLuint ubo_indices[2];
@@ -756,11 +1484,19 @@ static void _bolt_glLinkProgram(GLuint program) {
         p->offset_uViewProjMatrix = view_offsets[1];
         p->is_3d = 1;
     }
+    _bolt_program_reset_uniforms(p);
+    if ((GLint)p->block_index_ViewTransforms != -1) {
+        // the block binding can be set in the shader, so this is the one time we have to ask for it
+        GLint ubo_binding;
+        gl.GetActiveUniformBlockiv(program, p->block_index_ViewTransforms, GL_UNIFORM_BLOCK_BINDING, &ubo_binding);
+        p->ubo_binding_ViewTransforms = ubo_binding;
+    }
     LOG("glLinkProgram end\n");
 }
 
 static void _bolt_glUseProgram(GLuint program) {
     LOG("glUseProgram\n");
+    TRACE(USEPROGRAM, T32(program))
     gl.UseProgram(program);
     struct GLContext* c = _bolt_context();
     c->bound_program = _bolt_context_get_program(c, program);
@@ -769,217 +1505,690 @@ static void _bolt_glUseProgram(GLuint program) {
 
 static void _bolt_glTexStorage2D(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height) {
     LOG("glTexStorage2D\n");
+    TRACE(TEXSTORAGE2D, T32(target) T32(levels) T32(internalformat) T32(width) T32(height))
     gl.TexStorage2D(target, levels, internalformat, width, height);
     struct GLContext* c = _bolt_context();
     if (target == GL_TEXTURE_2D) {
         struct GLTexture2D* tex = c->texture_units[c->active_texture];
-        free(tex->data);
-        tex->data = malloc(width * height * 4);
+        struct S3TCDecoder decoder;
+        _bolt_texture_storage_free(tex);
         tex->width = width;
         tex->height = height;
+        if (_bolt_s3tc_decoder(internalformat, &decoder)) {
+            // compressed textures only get an RGBA mirror when something reads from them
+            const size_t blocks_y = ((size_t)height + 3) / 4;
+            tex->compressed = calloc(((size_t)width + 3) / 4 * blocks_y, decoder.block_size);
+            tex->compressed_format = internalformat;
+            tex->dirty_rows = calloc(blocks_y, 1);
+        } else {
+            tex->data = malloc(width * height * 4);
+        }
     }
     LOG("glTexStorage2D end\n");
 }
 
 static void _bolt_glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalised, GLsizei stride, const void* pointer) {
     LOG("glVertexAttribPointer\n");
+    TRACE(VERTEXATTRIBPOINTER, T32(index) T32(size) T32(type) T32(normalised) T32(stride) T64((uintptr_t)pointer))
     gl.VertexAttribPointer(index, size, type, normalised, stride, pointer);
     struct GLContext* c = _bolt_context();
-    GLint array_binding;
-    gl.GetIntegerv(GL_ARRAY_BUFFER_BINDING, &array_binding);
-    _bolt_set_attr_binding(c, &c->bound_vao->attributes[index], array_binding, size, pointer, stride, type, normalised);
+    _bolt_set_attr_binding(c, &c->bound_vao->attributes[index], _bolt_context_bound_buffer(c, GL_ARRAY_BUFFER), size, pointer, stride, type, normalised);
     LOG("glVertexAttribPointer end\n");
 }
 
 static void _bolt_glGenBuffers(GLsizei n, GLuint* buffers) {
     LOG("glGenBuffers\n");
+    TRACE(GENBUFFERS, T32(n))
     gl.GenBuffers(n, buffers);
     struct GLContext* c = _bolt_context();
-    _bolt_rwlock_lock_write(&c->buffers->rwlock);
+    _bolt_rwlock_lock_write(&c->share_group->buffers.rwlock);
     for (GLsizei i = 0; i < n; i += 1) {
         struct GLArrayBuffer* buffer = calloc(1, sizeof(struct GLArrayBuffer));
         buffer->id = buffers[i];
-        hashmap_set(c->buffers->map, &buffer);
+        _bolt_objtable_set(&c->share_group->buffers, buffer->id, buffer);
     }
-    _bolt_rwlock_unlock_write(&c->buffers->rwlock);
+    _bolt_rwlock_unlock_write(&c->share_group->buffers.rwlock);
     LOG("glGenBuffers end\n");
 }
 
 static void _bolt_glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
     LOG("glBufferData\n");
+    TRACE(BUFFERDATA, T32(target) T64(size) TBLOB(data, size) T32(usage))
     gl.BufferData(target, size, data, usage);
+    BOLT_FRAMETRACE_BEGIN(scope_start);
     struct GLContext* c = _bolt_context();
     GLenum binding_type = _bolt_binding_for_buffer(target);
     if (binding_type != -1) {
-        GLint buffer_id;
-        gl.GetIntegerv(binding_type, &buffer_id);
-        void* buffer_content = malloc(size);
-        if (data) memcpy(buffer_content, data, size);
-        struct GLArrayBuffer* buffer = _bolt_context_get_buffer(c, buffer_id);
+        const GLuint buffer_id = _bolt_context_bound_buffer(c, target);
+        _bolt_buffer_storage(_bolt_context_get_buffer(c, buffer_id), size, data);
+    }
+    BOLT_FRAMETRACE_END(scope_start, "gl:BufferData");
+    LOG("glBufferData end\n");
+}
+
+static void _bolt_glDeleteBuffers(GLsizei n, const GLuint* buffers) {
+    LOG("glDeleteBuffers\n");
+    TRACE(DELETEBUFFERS, TBLOB(buffers, n * sizeof(*buffers)))
+    gl.DeleteBuffers(n, buffers);
+    struct GLContext* c = _bolt_context();
+    _bolt_rwlock_lock_write(&c->share_group->buffers.rwlock);
+    for (GLsizei i = 0; i < n; i += 1) {
+        struct GLArrayBuffer* buffer = _bolt_objtable_remove(&c->share_group->buffers, buffers[i]);
         free(buffer->data);
-        buffer->data = buffer_content;
+        free(buffer->mapping);
+        free(buffer);
+
+        // deleting a buffer unbinds it from the current context, so do the same to our shadow state
+        if (c->bound_array_buffer == buffers[i]) c->bound_array_buffer = 0;
+        if (c->bound_uniform_buffer == buffers[i]) c->bound_uniform_buffer = 0;
+        if (c->default_element_array_buffer == buffers[i]) c->default_element_array_buffer = 0;
+        if (c->bound_vao && c->bound_vao->element_array_buffer == buffers[i]) c->bound_vao->element_array_buffer = 0;
+        for (size_t j = 0; j < MAX_UNIFORM_BUFFER_BINDINGS; j += 1) {
+            if (c->uniform_buffer_bindings[j].buffer == buffers[i]) {
+                c->uniform_buffer_bindings[j].buffer = 0;
+                c->uniform_buffer_bindings[j].offset = 0;
+            }
+        }
+    }
+    _bolt_rwlock_unlock_write(&c->share_group->buffers.rwlock);
+    LOG("glDeleteBuffers end\n");
+}
+
+static void _bolt_glBindFramebuffer(GLenum target, GLuint framebuffer) {
+    LOG("glBindFramebuffer\n");
+    TRACE(BINDFRAMEBUFFER, T32(target) T32(framebuffer))
+    gl.BindFramebuffer(target, framebuffer);
+    struct GLContext* c = _bolt_context();
+    switch (target) {
+        case GL_READ_FRAMEBUFFER:
+            c->current_read_framebuffer = framebuffer;
+            c->read_framebuffer = _bolt_context_get_framebuffer(c, framebuffer);
+            break;
+        case GL_DRAW_FRAMEBUFFER:
+            c->current_draw_framebuffer = framebuffer;
+            c->draw_framebuffer = _bolt_context_get_framebuffer(c, framebuffer);
+            break;
+        case GL_FRAMEBUFFER:
+            c->current_read_framebuffer = framebuffer;
+            c->current_draw_framebuffer = framebuffer;
+            c->read_framebuffer = _bolt_context_get_framebuffer(c, framebuffer);
+            c->draw_framebuffer = c->read_framebuffer;
+            break;
+    }
+    LOG("glBindFramebuffer end\n");
+}
+
+static void _bolt_glGenFramebuffers(GLsizei n, GLuint* framebuffers) {
+    LOG("glGenFramebuffers\n");
+    TRACE(GENFRAMEBUFFERS, T32(n))
+    gl.GenFramebuffers(n, framebuffers);
+    struct GLContext* c = _bolt_context();
+    _bolt_rwlock_lock_write(&c->framebuffers->rwlock);
+    for (GLsizei i = 0; i < n; i += 1) {
+        struct GLFramebuffer* fb = calloc(1, sizeof(struct GLFramebuffer));
+        fb->id = framebuffers[i];
+        _bolt_objtable_set(c->framebuffers, fb->id, fb);
+    }
+    _bolt_rwlock_unlock_write(&c->framebuffers->rwlock);
+    LOG("glGenFramebuffers end\n");
+}
+
+static void _bolt_glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+    LOG("glDeleteFramebuffers\n");
+    TRACE(DELETEFRAMEBUFFERS, TBLOB(framebuffers, n * sizeof(*framebuffers)))
+    gl.DeleteFramebuffers(n, framebuffers);
+    struct GLContext* c = _bolt_context();
+    _bolt_rwlock_lock_write(&c->framebuffers->rwlock);
+    for (GLsizei i = 0; i < n; i += 1) {
+        struct GLFramebuffer* fb = _bolt_objtable_remove(c->framebuffers, framebuffers[i]);
+        if (!fb) continue;
+        if (c->draw_framebuffer == fb) {
+            c->draw_framebuffer = NULL;
+            c->current_draw_framebuffer = 0;
+        }
+        if (c->read_framebuffer == fb) {
+            c->read_framebuffer = NULL;
+            c->current_read_framebuffer = 0;
+        }
+        free(fb);
+    }
+    _bolt_rwlock_unlock_write(&c->framebuffers->rwlock);
+    LOG("glDeleteFramebuffers end\n");
+}
+
+// updates the shadow state for a glFramebuffer* call - we only care about the first colour attachment
+static void _bolt_set_framebuffer_attachment(GLenum target, GLenum attachment, GLuint object) {
+    if (attachment != GL_COLOR_ATTACHMENT0) return;
+    struct GLContext* c = _bolt_context();
+    struct GLFramebuffer* fb = (target == GL_READ_FRAMEBUFFER) ? c->read_framebuffer : c->draw_framebuffer;
+    if (fb) fb->colour_attachment0 = object;
+}
+
+static void _bolt_glFramebufferTexture(GLenum target, GLenum attachment, GLuint texture, GLint level) {
+    LOG("glFramebufferTexture\n");
+    TRACE(FRAMEBUFFERTEXTURE, T32(target) T32(attachment) T32(texture) T32(level))
+    gl.FramebufferTexture(target, attachment, texture, level);
+    _bolt_set_framebuffer_attachment(target, attachment, texture);
+    LOG("glFramebufferTexture end\n");
+}
+
+static void _bolt_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) {
+    LOG("glFramebufferTexture2D\n");
+    TRACE(FRAMEBUFFERTEXTURE2D, T32(target) T32(attachment) T32(textarget) T32(texture) T32(level))
+    gl.FramebufferTexture2D(target, attachment, textarget, texture, level);
+    _bolt_set_framebuffer_attachment(target, attachment, texture);
+    LOG("glFramebufferTexture2D end\n");
+}
+
+static void _bolt_glFramebufferTextureLayer(GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer) {
+    LOG("glFramebufferTextureLayer\n");
+    TRACE(FRAMEBUFFERTEXTURELAYER, T32(target) T32(attachment) T32(texture) T32(level) T32(layer))
+    gl.FramebufferTextureLayer(target, attachment, texture, level, layer);
+    _bolt_set_framebuffer_attachment(target, attachment, texture);
+    LOG("glFramebufferTextureLayer end\n");
+}
+
+static void _bolt_glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) {
+    LOG("glFramebufferRenderbuffer\n");
+    TRACE(FRAMEBUFFERRENDERBUFFER, T32(target) T32(attachment) T32(renderbuffertarget) T32(renderbuffer))
+    gl.FramebufferRenderbuffer(target, attachment, renderbuffertarget, renderbuffer);
+    _bolt_set_framebuffer_attachment(target, attachment, renderbuffer);
+    LOG("glFramebufferRenderbuffer end\n");
+}
+
+static void _bolt_glBindBuffer(GLenum target, GLuint buffer) {
+    LOG("glBindBuffer\n");
+    TRACE(BINDBUFFER, T32(target) T32(buffer))
+    gl.BindBuffer(target, buffer);
+    struct GLContext* c = _bolt_context();
+    switch (target) {
+        case GL_ARRAY_BUFFER:
+            c->bound_array_buffer = buffer;
+            break;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            if (c->bound_vao) c->bound_vao->element_array_buffer = buffer;
+            else c->default_element_array_buffer = buffer;
+            break;
+        case GL_UNIFORM_BUFFER:
+            c->bound_uniform_buffer = buffer;
+            break;
+        case GL_PIXEL_PACK_BUFFER:
+            c->bound_pixel_pack_buffer = buffer;
+            break;
+        case GL_PIXEL_UNPACK_BUFFER:
+            c->bound_pixel_unpack_buffer = buffer;
+            break;
+    }
+    LOG("glBindBuffer end\n");
+}
+
+static void _bolt_glBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    LOG("glBindBufferBase\n");
+    TRACE(BINDBUFFERBASE, T32(target) T32(index) T32(buffer))
+    gl.BindBufferBase(target, index, buffer);
+    struct GLContext* c = _bolt_context();
+    if (target == GL_UNIFORM_BUFFER) {
+        c->bound_uniform_buffer = buffer;
+        if (index < MAX_UNIFORM_BUFFER_BINDINGS) {
+            c->uniform_buffer_bindings[index].buffer = buffer;
+            c->uniform_buffer_bindings[index].offset = 0;
+        }
+    }
+    LOG("glBindBufferBase end\n");
+}
+
+static void _bolt_glBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    LOG("glBindBufferRange\n");
+    TRACE(BINDBUFFERRANGE, T32(target) T32(index) T32(buffer) T64(offset) T64(size))
+    gl.BindBufferRange(target, index, buffer, offset, size);
+    struct GLContext* c = _bolt_context();
+    if (target == GL_UNIFORM_BUFFER) {
+        c->bound_uniform_buffer = buffer;
+        if (index < MAX_UNIFORM_BUFFER_BINDINGS) {
+            c->uniform_buffer_bindings[index].buffer = buffer;
+            c->uniform_buffer_bindings[index].offset = offset;
+        }
+    }
+    LOG("glBindBufferRange end\n");
+}
+
+static void _bolt_glUniformBlockBinding(GLuint program, GLuint block_index, GLuint binding) {
+    LOG("glUniformBlockBinding\n");
+    TRACE(UNIFORMBLOCKBINDING, T32(program) T32(block_index) T32(binding))
+    gl.UniformBlockBinding(program, block_index, binding);
+    struct GLContext* c = _bolt_context();
+    struct GLProgram* p = _bolt_context_get_program(c, program);
+    if (p && block_index == p->block_index_ViewTransforms) p->ubo_binding_ViewTransforms = binding;
+    LOG("glUniformBlockBinding end\n");
+}
+
+static void _bolt_glUniform1i(GLint location, GLint v0) {
+    LOG("glUniform1i\n");
+    TRACE(UNIFORM1I, T32(location) T32(v0))
+    gl.Uniform1i(location, v0);
+    struct GLContext* c = _bolt_context();
+    if (c->bound_program) _bolt_program_set_uniform_ints(c->bound_program, location, 1, &v0);
+    LOG("glUniform1i end\n");
+}
+
+static void _bolt_glUniform1iv(GLint location, GLsizei count, const GLint* value) {
+    LOG("glUniform1iv\n");
+    TRACE(UNIFORM1IV, T32(location) TBLOB(value, count * sizeof(GLint)))
+    gl.Uniform1iv(location, count, value);
+    struct GLContext* c = _bolt_context();
+    if (c->bound_program) _bolt_program_set_uniform_ints(c->bound_program, location, count, value);
+    LOG("glUniform1iv end\n");
+}
+
+static void _bolt_glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) {
+    LOG("glUniform4f\n");
+    TRACE(UNIFORM4F, T32(location) TF32(v0) TF32(v1) TF32(v2) TF32(v3))
+    gl.Uniform4f(location, v0, v1, v2, v3);
+    struct GLContext* c = _bolt_context();
+    const GLfloat value[] = {v0, v1, v2, v3};
+    if (c->bound_program) _bolt_program_set_uniform_vec4s(c->bound_program, location, 1, value);
+    LOG("glUniform4f end\n");
+}
+
+static void _bolt_glUniform4fv(GLint location, GLsizei count, const GLfloat* value) {
+    LOG("glUniform4fv\n");
+    TRACE(UNIFORM4FV, T32(location) TBLOB(value, count * 4 * sizeof(GLfloat)))
+    gl.Uniform4fv(location, count, value);
+    struct GLContext* c = _bolt_context();
+    if (c->bound_program) _bolt_program_set_uniform_vec4s(c->bound_program, location, count, value);
+    LOG("glUniform4fv end\n");
+}
+
+static void _bolt_glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    LOG("glUniformMatrix4fv\n");
+    TRACE(UNIFORMMATRIX4FV, T32(location) T32(transpose) TBLOB(value, count * 16 * sizeof(GLfloat)))
+    gl.UniformMatrix4fv(location, count, transpose, value);
+    struct GLContext* c = _bolt_context();
+    if (c->bound_program) _bolt_program_set_uniform_mat4s(c->bound_program, location, count, transpose, value);
+    LOG("glUniformMatrix4fv end\n");
+}
+
+// https://www.khronos.org/opengl/wiki/S3_Texture_Compression
+// returns 0 if the format isn't one we know how to decode
+static uint8_t _bolt_s3tc_decoder(GLenum format, struct S3TCDecoder* out) {
+    // the sRGB formats get decoded the same as the linear ones, see s3tc.h
+    struct BoltS3TCKernels kernels;
+    _bolt_s3tc_best_kernels(&kernels);
+    switch (format) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+            out->decode_block = kernels.dxt1;
+            out->block_size = 8;
+            return 1;
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+            out->decode_block = kernels.dxt1a;
+            out->block_size = 8;
+            return 1;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+            out->decode_block = kernels.dxt3;
+            out->block_size = 16;
+            return 1;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+            out->decode_block = kernels.dxt5;
+            out->block_size = 16;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// decodes a width*height region of tightly-packed blocks into tex->data at xoffset,yoffset
+static void _bolt_s3tc_decode_region(struct GLTexture2D* tex, const struct S3TCDecoder* decoder, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, const uint8_t* blocks) {
+    const size_t blocks_x = ((size_t)width + 3) / 4;
+    const size_t blocks_y = ((size_t)height + 3) / 4;
+
+    // pixels may only be written within both the uploaded region and the texture itself
+    const GLint min_x = xoffset < 0 ? 0 : xoffset;
+    const GLint min_y = yoffset < 0 ? 0 : yoffset;
+    const GLint max_x = (xoffset + width < tex->width) ? xoffset + width : tex->width;
+    const GLint max_y = (yoffset + height < tex->height) ? yoffset + height : tex->height;
+    const size_t out_stride = (size_t)tex->width * 4;
+    const uint8_t* ptr = blocks;
+    for (size_t by = 0; by < blocks_y; by += 1) {
+        const GLint y = yoffset + (GLint)(by * 4);
+        for (size_t bx = 0; bx < blocks_x; bx += 1, ptr += decoder->block_size) {
+            const GLint x = xoffset + (GLint)(bx * 4);
+            if (x >= min_x && y >= min_y && x + 4 <= max_x && y + 4 <= max_y) {
+                // whole block is in bounds, so decode it straight into the texture
+                decoder->decode_block(ptr, tex->data + (y * out_stride) + (x * 4), out_stride);
+                continue;
+            }
+
+            // edge block: decode into a temporary buffer and copy only the pixels that are in bounds
+            const GLint i_start = (min_x > x) ? min_x - x : 0;
+            const GLint i_end = (max_x < x + 4) ? max_x - x : 4;
+            if (i_start >= i_end) continue;
+            uint8_t pixels[64];
+            decoder->decode_block(ptr, pixels, 16);
+            for (GLint j = 0; j < 4; j += 1) {
+                if (y + j < min_y || y + j >= max_y) continue;
+                memcpy(tex->data + ((y + j) * out_stride) + ((x + i_start) * 4), pixels + (j * 16) + (i_start * 4), (i_end - i_start) * 4);
+            }
+        }
+    }
+}
+
+static int _bolt_region_hash_compare(const void* a, const void* b, void* udata) {
+    const struct GLTextureRegionHash* ra = a;
+    const struct GLTextureRegionHash* rb = b;
+    if (ra->x != rb->x) return (ra->x > rb->x) - (ra->x < rb->x);
+    return (ra->y > rb->y) - (ra->y < rb->y);
+}
+
+static uint64_t _bolt_region_hash_hash(const void* item, uint64_t seed0, uint64_t seed1) {
+    const struct GLTextureRegionHash* r = item;
+    const GLint xy[2] = {r->x, r->y};
+    return hashmap_sip(xy, sizeof(xy), seed0, seed1);
+}
+
+// hashes `rows` rows of `row_len` bytes each, with rows `row_stride` bytes apart. this has to give the same
+// result for the data being uploaded as it would for the same data after it's been copied into the texture
+static uint64_t _bolt_texture_hash_rows(const uint8_t* data, size_t row_len, size_t row_stride, size_t rows) {
+    uint64_t hash = rows;
+    for (size_t i = 0; i < rows; i += 1) hash = hashmap_sip(data + (i * row_stride), row_len, hash, row_len);
+    return hash;
+}
+
+static void _bolt_texture_regions_put(struct GLTexture2D* tex, const struct GLTextureRegionHash* region) {
+    if (!tex->region_hashes) {
+        tex->region_hashes = hashmap_new(sizeof(struct GLTextureRegionHash), 0, 0, 0, _bolt_region_hash_hash, _bolt_region_hash_compare, NULL, NULL);
+    }
+    hashmap_set(tex->region_hashes, region);
+}
+
+// forgets any cached hashes for regions overlapping this rectangle, since its contents are being changed
+static void _bolt_texture_regions_invalidate(struct GLTexture2D* tex, GLint x, GLint y, GLsizei width, GLsizei height) {
+    if (!tex->region_hashes) return;
+    if (x <= 0 && y <= 0 && x + width >= tex->width && y + height >= tex->height) {
+        hashmap_clear(tex->region_hashes, false);
+        return;
+    }
+    // deleting moves other items around, which would break the iteration, so the overlapping regions are
+    // collected in one pass and deleted afterwards. a texture rarely has more than a few cached regions.
+    struct GLTextureRegionHash stack_overlaps[32];
+    struct GLTextureRegionHash* overlaps = stack_overlaps;
+    const size_t region_count = hashmap_count(tex->region_hashes);
+    if (region_count > sizeof(stack_overlaps) / sizeof(*stack_overlaps)) {
+        overlaps = malloc(region_count * sizeof(*overlaps));
+        if (!overlaps) {
+            // can't know which ones to keep, so forget them all instead
+            hashmap_clear(tex->region_hashes, false);
+            return;
+        }
+    }
+    size_t overlap_count = 0;
+    size_t iter = 0;
+    void* item;
+    while (hashmap_iter(tex->region_hashes, &iter, &item)) {
+        const struct GLTextureRegionHash* r = item;
+        if (r->x < x + width && x < r->x + r->width && r->y < y + height && y < r->y + r->height) {
+            overlaps[overlap_count] = *r;
+            overlap_count += 1;
+        }
+    }
+    for (size_t i = 0; i < overlap_count; i += 1) hashmap_delete(tex->region_hashes, &overlaps[i]);
+    if (overlaps != stack_overlaps) free(overlaps);
+}
+
+// records the hash of a rectangle that's just been uploaded, so it doesn't need to be read back later
+static void _bolt_texture_regions_uploaded(struct GLTexture2D* tex, GLint x, GLint y, GLsizei width, GLsizei height, uint64_t hash) {
+    _bolt_texture_regions_invalidate(tex, x, y, width, height);
+    const struct GLTextureRegionHash region = {.x = x, .y = y, .width = width, .height = height, .hash = hash, .has_phash = 0};
+    _bolt_texture_regions_put(tex, &region);
+}
+
+// copies a width*height region of blocks, with rows `row_stride` bytes apart, into a compressed texture's
+// block storage and marks those rows as dirty. offsets must be multiples of 4 as GL requires for S3TC.
+static void _bolt_texture_store_blocks(struct GLTexture2D* tex, size_t block_size, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, const uint8_t* blocks, size_t row_stride) {
+    if (xoffset < 0 || yoffset < 0 || (xoffset % 4) || (yoffset % 4)) return;
+    const size_t tex_blocks_x = ((size_t)tex->width + 3) / 4;
+    const size_t tex_blocks_y = ((size_t)tex->height + 3) / 4;
+    const size_t bx = xoffset / 4;
+    const size_t by = yoffset / 4;
+    if (bx >= tex_blocks_x || by >= tex_blocks_y) return;
+    size_t copy_x = ((size_t)width + 3) / 4;
+    size_t copy_y = ((size_t)height + 3) / 4;
+    if (copy_x > tex_blocks_x - bx) copy_x = tex_blocks_x - bx;
+    if (copy_y > tex_blocks_y - by) copy_y = tex_blocks_y - by;
+    for (size_t j = 0; j < copy_y; j += 1) {
+        memcpy(tex->compressed + ((((by + j) * tex_blocks_x) + bx) * block_size), blocks + (j * row_stride), copy_x * block_size);
+    }
+    memset(tex->dirty_rows + by, 1, copy_y);
+    _bolt_texture_regions_uploaded(tex, xoffset, yoffset, width, height, _bolt_texture_hash_rows(blocks, copy_x * block_size, row_stride, copy_y));
+}
+
+// the mirror lock must be held for writing by anything that calls these two
+static void _bolt_texture_mirror_lru_remove(struct GLTexture2D* tex) {
+    if (tex->mirror_lru_prev) tex->mirror_lru_prev->mirror_lru_next = tex->mirror_lru_next;
+    else texture_mirror_lru_first = tex->mirror_lru_next;
+    if (tex->mirror_lru_next) tex->mirror_lru_next->mirror_lru_prev = tex->mirror_lru_prev;
+    else texture_mirror_lru_last = tex->mirror_lru_prev;
+    tex->mirror_lru_prev = NULL;
+    tex->mirror_lru_next = NULL;
+}
+
+static void _bolt_texture_mirror_lru_append(struct GLTexture2D* tex) {
+    tex->mirror_lru_prev = texture_mirror_lru_last;
+    tex->mirror_lru_next = NULL;
+    if (texture_mirror_lru_last) texture_mirror_lru_last->mirror_lru_next = tex;
+    else texture_mirror_lru_first = tex;
+    texture_mirror_lru_last = tex;
+}
+
+// same as _bolt_texture_mirror_free, for when the mirror lock is already held for writing
+static void _bolt_texture_mirror_free_locked(struct GLTexture2D* tex) {
+    if (tex->compressed && tex->data) {
+        texture_mirror_bytes -= (size_t)tex->width * tex->height * 4;
+        _bolt_texture_mirror_lru_remove(tex);
+    }
+    if (tex->mirror_shm) {
+        _bolt_plugin_shm_close(tex->mirror_shm);
+        free(tex->mirror_shm);
+        tex->mirror_shm = NULL;
+    } else {
+        free(tex->data);
+    }
+    tex->data = NULL;
+}
+
+static void _bolt_texture_mirror_free(struct GLTexture2D* tex) {
+    _bolt_rwlock_lock_write(&texture_mirror_lock);
+    _bolt_texture_mirror_free_locked(tex);
+    _bolt_rwlock_unlock_write(&texture_mirror_lock);
+}
+
+// tries to get a compressed texture's whole mirror from the texture cache shared with other game clients,
+// by the hash of its blocks, decoding it into the cache first if no other client has done so yet. on
+// success, tex->data is read-only and fully up to date. returns 0 if the cache can't be used
+static uint8_t _bolt_texture_mirror_share(struct GLTexture2D* tex, const struct S3TCDecoder* decoder) {
+    const size_t blocks_x = ((size_t)tex->width + 3) / 4;
+    const size_t blocks_y = ((size_t)tex->height + 3) / 4;
+    if ((size_t)tex->width * tex->height * 4 < TEXTURE_CACHE_MIN_BYTES) return 0;
+    struct BoltSHM* shm = malloc(sizeof(struct BoltSHM));
+    if (!shm) return 0;
+    const size_t row_len = blocks_x * decoder->block_size;
+    const uint64_t hash = _bolt_texture_hash_rows(tex->compressed, row_len, row_len, blocks_y);
+    uint8_t created;
+    uint8_t* pixels = _bolt_plugin_texcache_open(shm, hash, tex->width, tex->height, tex->compressed_format, &created);
+    if (!pixels) {
+        free(shm);
+        return 0;
+    }
+    tex->data = pixels;
+    tex->mirror_shm = shm;
+    if (created) {
+        _bolt_s3tc_decode_region(tex, decoder, 0, 0, tex->width, tex->height, tex->compressed);
+        _bolt_plugin_texcache_publish(shm);
+    }
+    memset(tex->dirty_rows, 0, blocks_y);
+    return 1;
+}
+
+// replaces a shared mirror with a private copy of it, so that newly uploaded blocks can be decoded into it
+static uint8_t _bolt_texture_mirror_unshare(struct GLTexture2D* tex) {
+    const size_t size = (size_t)tex->width * tex->height * 4;
+    uint8_t* data = malloc(size);
+    if (!data) return 0;
+    memcpy(data, tex->data, size);
+    _bolt_plugin_shm_close(tex->mirror_shm);
+    free(tex->mirror_shm);
+    tex->mirror_shm = NULL;
+    tex->data = data;
+    return 1;
+}
+
+static void _bolt_texture_storage_free(struct GLTexture2D* tex) {
+    _bolt_texture_mirror_free(tex);
+    free(tex->compressed);
+    free(tex->dirty_rows);
+    if (tex->region_hashes) hashmap_free(tex->region_hashes);
+    tex->compressed = NULL;
+    tex->dirty_rows = NULL;
+    tex->region_hashes = NULL;
+}
+
+// frees least-recently-used compressed texture mirrors until the total is back within the budget, called at
+// the end of each frame. only textures in `group` are freed, since another group's might be in use right now
+// on another thread, so a group that draws nothing can't shrink it. the mirror lock must be held for writing
+static void _bolt_texture_mirror_evict(struct GLShareGroup* group) {
+    struct GLTexture2D* tex = texture_mirror_lru_first;
+    while (tex && texture_mirror_bytes > TEXTURE_MIRROR_BUDGET) {
+        struct GLTexture2D* next = tex->mirror_lru_next;
+        if (tex->share_group == group) _bolt_texture_mirror_free_locked(tex);
+        tex = next;
+    }
+}
+
+// makes sure the RGBA mirror is up to date for pixel rows [y_start, y_end), decoding any blocks that have been
+// uploaded since they were last read, then returns tex->data. returns NULL if the texture has no data.
+static uint8_t* _bolt_texture_mirror_rows(struct GLTexture2D* tex, size_t y_start, size_t y_end) {
+    if (!tex->compressed) return tex->data;
+    struct S3TCDecoder decoder;
+    if (!_bolt_s3tc_decoder(tex->compressed_format, &decoder)) return NULL;
+    const size_t blocks_x = ((size_t)tex->width + 3) / 4;
+    const size_t blocks_y = ((size_t)tex->height + 3) / 4;
+    if (!tex->data) {
+        const size_t size = (size_t)tex->width * tex->height * 4;
+        if (!_bolt_texture_mirror_share(tex, &decoder)) {
+            tex->data = malloc(size);
+            if (!tex->data) return NULL;
+            memset(tex->dirty_rows, 1, blocks_y);
+        }
+        _bolt_rwlock_lock_write(&texture_mirror_lock);
+        texture_mirror_bytes += size;
+        _bolt_texture_mirror_lru_append(tex);
+        _bolt_rwlock_unlock_write(&texture_mirror_lock);
+    } else {
+        _bolt_rwlock_lock_write(&texture_mirror_lock);
+        if (tex != texture_mirror_lru_last) {
+            _bolt_texture_mirror_lru_remove(tex);
+            _bolt_texture_mirror_lru_append(tex);
+        }
+        _bolt_rwlock_unlock_write(&texture_mirror_lock);
     }
-    LOG("glBufferData end\n");
-}
 
-static void _bolt_glDeleteBuffers(GLsizei n, const GLuint* buffers) {
-    LOG("glDeleteBuffers\n");
-    gl.DeleteBuffers(n, buffers);
-    struct GLContext* c = _bolt_context();
-    _bolt_rwlock_lock_write(&c->buffers->rwlock);
-    for (GLsizei i = 0; i < n; i += 1) {
-        const GLuint* ptr = &buffers[i];
-        struct GLArrayBuffer* const* buffer = hashmap_delete(c->buffers->map, &ptr);
-        free((*buffer)->data);
-        free((*buffer)->mapping);
-        free(*buffer);
+    size_t by = y_start / 4;
+    const size_t by_end = ((y_end + 3) / 4 < blocks_y) ? (y_end + 3) / 4 : blocks_y;
+    // a shared mirror can't be written to, so it has to become private before anything's decoded into it
+    if (tex->mirror_shm && by < by_end && memchr(tex->dirty_rows + by, 1, by_end - by) && !_bolt_texture_mirror_unshare(tex)) return NULL;
+    while (by < by_end) {
+        if (!tex->dirty_rows[by]) {
+            by += 1;
+            continue;
+        }
+        // decode each run of consecutive dirty rows in one go
+        size_t run_end = by + 1;
+        while (run_end < by_end && tex->dirty_rows[run_end]) run_end += 1;
+        _bolt_s3tc_decode_region(tex, &decoder, 0, (GLint)(by * 4), tex->width, (GLsizei)((run_end - by) * 4), tex->compressed + (by * blocks_x * decoder.block_size));
+        memset(tex->dirty_rows + by, 0, run_end - by);
+        by = run_end;
     }
-    _bolt_rwlock_unlock_write(&c->buffers->rwlock);
-    LOG("glDeleteBuffers end\n");
+    return tex->data;
+}
+
+// hashes a rectangle of a texture the same way as _bolt_texture_regions_uploaded would have. for compressed
+// textures that means hashing the blocks, unless the rectangle isn't aligned to them. rectangle must be in-bounds
+static uint8_t _bolt_texture_region_content_hash(struct GLTexture2D* tex, size_t x, size_t y, size_t w, size_t h, uint64_t* out) {
+    struct S3TCDecoder decoder;
+    if (tex->compressed && !(x % 4) && !(y % 4) && _bolt_s3tc_decoder(tex->compressed_format, &decoder)) {
+        const size_t row_stride = (((size_t)tex->width + 3) / 4) * decoder.block_size;
+        const size_t blocks_x = (w + 3) / 4;
+        const size_t blocks_y = (h + 3) / 4;
+        *out = _bolt_texture_hash_rows(tex->compressed + ((y / 4) * row_stride) + ((x / 4) * decoder.block_size), blocks_x * decoder.block_size, row_stride, blocks_y);
+        return 1;
+    }
+    const uint8_t* data = _bolt_texture_mirror_rows(tex, y, y + h);
+    if (!data) return 0;
+    const size_t row_len = (size_t)tex->width * 4;
+    *out = _bolt_texture_hash_rows(data + (y * row_len) + (x * 4), w * 4, row_len, h);
+    return 1;
 }
 
-static void _bolt_glBindFramebuffer(GLenum target, GLuint framebuffer) {
-    LOG("glBindFramebuffer\n");
-    gl.BindFramebuffer(target, framebuffer);
-    struct GLContext* c = _bolt_context();
-    switch (target) {
-        case GL_READ_FRAMEBUFFER:
-            c->current_read_framebuffer = framebuffer;
-            break;
-        case GL_DRAW_FRAMEBUFFER:
-            c->current_draw_framebuffer = framebuffer;
-            break;
-        case GL_FRAMEBUFFER:
-            c->current_read_framebuffer = framebuffer;
-            c->current_draw_framebuffer = framebuffer;
-            break;
+// average hash: splits the rectangle into an 8x8 grid and sets one bit for each cell that's brighter than
+// the average cell. small changes to the pixels, like from re-encoding them, rarely change any of the bits
+static uint8_t _bolt_texture_region_perceptual_hash(struct GLTexture2D* tex, size_t x, size_t y, size_t w, size_t h, uint64_t* out) {
+    const uint8_t* data = _bolt_texture_mirror_rows(tex, y, y + h);
+    if (!data) return 0;
+    uint64_t sums[64] = {0};
+    uint64_t counts[64] = {0};
+    for (size_t j = 0; j < h; j += 1) {
+        const uint8_t* row = data + ((((y + j) * tex->width) + x) * 4);
+        const size_t cell_row = ((j * 8) / h) * 8;
+        for (size_t i = 0; i < w; i += 1) {
+            const uint8_t* px = row + (i * 4);
+            // transparent pixels count as dark, so that an icon's shape matters more than its background
+            const uint32_t luma = ((px[0] * 77) + (px[1] * 150) + (px[2] * 29)) >> 8;
+            const size_t cell = cell_row + ((i * 8) / w);
+            sums[cell] += (luma * px[3]) / 255;
+            counts[cell] += 1;
+        }
     }
-    LOG("glBindFramebuffer end\n");
+    double cells[64];
+    double mean = 0.0;
+    for (size_t i = 0; i < 64; i += 1) {
+        cells[i] = counts[i] ? (double)sums[i] / counts[i] : 0.0;
+        mean += cells[i];
+    }
+    mean /= 64.0;
+    uint64_t hash = 0;
+    for (size_t i = 0; i < 64; i += 1) {
+        if (cells[i] > mean) hash |= ((uint64_t)1 << i);
+    }
+    *out = hash;
+    return 1;
 }
 
-// https://www.khronos.org/opengl/wiki/S3_Texture_Compression
 static void _bolt_glCompressedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void* data) {
     LOG("glCompressedTexSubImage2D\n");
+    TRACE(COMPRESSEDTEXSUBIMAGE2D, T32(target) T32(level) T32(xoffset) T32(yoffset) T32(width) T32(height) T32(format) T32(imageSize) T64((uintptr_t)data) TBLOB(_bolt_context()->bound_pixel_unpack_buffer ? NULL : data, imageSize))
     gl.CompressedTexSubImage2D(target, level, xoffset, yoffset, width, height, format, imageSize, data);
     if (target != GL_TEXTURE_2D || level != 0 || width <= 0 || height <= 0) return;
-    const uint8_t is_dxt1 = (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT);
-    const uint8_t is_srgb = (format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT || format == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT);
-    const size_t input_stride = is_dxt1 ? 8 : 16;
-    void (*const unpack565)(uint16_t, uint8_t*) = is_srgb ? _bolt_unpack_srgb565 : _bolt_unpack_rgb565;
+    struct S3TCDecoder decoder;
+    if (!_bolt_s3tc_decoder(format, &decoder)) {
+        LOG("glCompressedTexSubImage2D end (unsupported format)\n");
+        return;
+    }
     struct GLContext* c = _bolt_context();
     struct GLTexture2D* tex = c->texture_units[c->active_texture];
-    GLint out_xoffset = xoffset;
-    GLint out_yoffset = yoffset;
-    for (size_t ii = 0; ii < ((size_t)width * (size_t)height); ii += input_stride) {
-        const uint8_t* ptr = (uint8_t*)data + ii;
-        const uint8_t* cptr = is_dxt1 ? ptr : (ptr + 8);
-        uint8_t* out_ptr = tex->data + (out_yoffset * tex->width * 4) + (out_xoffset * 4);
-        uint16_t c0 = cptr[0] + (cptr[1] << 8);
-        uint16_t c1 = cptr[2] + (cptr[3] << 8);
-        uint8_t c0_rgb[3];
-        uint8_t c1_rgb[3];
-        unpack565(c0, c0_rgb);
-        unpack565(c1, c1_rgb);
-        const uint8_t c0_greater = c0 > c1;
-        const uint32_t ctable = cptr[4] + (cptr[5] << 8) + (cptr[6] << 16) + (cptr[7] << 24);
-        const uint8_t alpha0 = ptr[0];
-        const uint8_t alpha1 = ptr[1];
-        const uint8_t a0_greater = alpha0 > alpha1;
-        const uint64_t atable = ptr[2] + ((uint64_t)ptr[3] << 8) + ((uint64_t)ptr[4] << 16) + ((uint64_t)ptr[5] << 24) + ((uint64_t)ptr[6] << 32) + ((uint64_t)ptr[7] << 40);
-
-        for (size_t j = 0; j < 4; j += 1) {
-            for (size_t i = 0; i < 4; i += 1) {
-                if (out_xoffset + i >= 0 && out_yoffset + j >= 0 && out_xoffset + i < tex->width && out_yoffset + j < tex->height) {
-                    uint8_t* pixel_ptr = out_ptr + (tex->width * j * 4) + (i * 4);
-                    uint8_t pixel_index = (4 * j) + i;
-                    const uint8_t code = (ctable >> (pixel_index * 2)) & 0b11;
-
-                    // parse colour table and set R, G and B bytes for this pixel
-                    switch(code) {
-                        case 0:
-                            memcpy(pixel_ptr, c0_rgb, 3);
-                            break;
-                        case 1:
-                            memcpy(pixel_ptr, c1_rgb, 3);
-                            break;
-                        case 2:
-                            if (c0_greater) {
-                                pixel_ptr[0] = (2*c0_rgb[0]+c1_rgb[0])/3;
-                                pixel_ptr[1] = (2*c0_rgb[1]+c1_rgb[1])/3;
-                                pixel_ptr[2] = (2*c0_rgb[2]+c1_rgb[2])/3;
-                            } else {
-                                pixel_ptr[0] = (c0_rgb[0]+c1_rgb[0])/2;
-                                pixel_ptr[1] = (c0_rgb[1]+c1_rgb[1])/2;
-                                pixel_ptr[2] = (c0_rgb[2]+c1_rgb[2])/2;
-                            }
-                            break;
-                        case 3:
-                            if (c0_greater) {
-                                pixel_ptr[0] = (2*c1_rgb[0]+c0_rgb[0])/3;
-                                pixel_ptr[1] = (2*c1_rgb[1]+c0_rgb[1])/3;
-                                pixel_ptr[2] = (2*c1_rgb[2]+c0_rgb[2])/3;
-                            } else {
-                                memset(pixel_ptr, 0, 3);
-                            }
-                            break;
-                    }
-
-                    // parse alpha table (if any) and set alpha byte for this pixel
-                    switch (format) {
-                        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
-                        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: {
-                            // no alpha channel at all
-                            pixel_ptr[3] = 0xFF;
-                            break;
-                        }
-                        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
-                        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT: {
-                            // black means zero alpha
-                            pixel_ptr[3] = (code == 3 && !c0_greater) ? 0 : 0xFF;
-                            break;
-                        }
-                        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-                        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT: {
-                            // 4-bit alpha value from the alpha chunk
-                            pixel_ptr[3] = ((ptr[pixel_index / 2] >> ((i & 1) ? 4 : 0)) & 0b1111) * 17;
-                            break;
-                        }
-                        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
-                        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: {
-                            // 3-bit instruction value from atable
-                            const uint8_t code = (atable >> (pixel_index * 3)) & 0b111;
-                            switch (code) {
-                                case 0:
-                                    pixel_ptr[3] = alpha0;
-                                    break;
-                                case 1:
-                                    pixel_ptr[3] = alpha1;
-                                    break;
-                                case 6:
-                                case 7:
-                                    if (!a0_greater) {
-                                        pixel_ptr[3] = code == 6 ? 0 : 0xFF;
-                                        break;
-                                    }
-                                    // fall through is intentional
-                                default:
-                                    if (a0_greater) pixel_ptr[3] = (((8 - code) * (uint16_t)alpha0) + ((code - 1) * (uint16_t)alpha1)) / 7;
-                                    else pixel_ptr[3] = (((6 - code) * (uint16_t)alpha0) + ((code - 1) * (uint16_t)alpha1)) / 5;
-                                    break;
-                            }
-                            break;
-                        }
-                    }
-                }
-            }
-        }
-
-        out_xoffset += 4;
-        if (out_xoffset >= xoffset + width) {
-            out_xoffset = xoffset;
-            out_yoffset += 4;
-        }
+    const size_t row_stride = (((size_t)width + 3) / 4) * decoder.block_size;
+    if (!tex || (size_t)imageSize < row_stride * (((size_t)height + 3) / 4)) return;
+    BOLT_FRAMETRACE_BEGIN(scope_start);
+    if (tex->compressed && tex->compressed_format == format) {
+        // keep the blocks as they are, they'll only be decoded if a plugin actually reads this part of the texture
+        _bolt_texture_store_blocks(tex, decoder.block_size, xoffset, yoffset, width, height, data, row_stride);
+    } else if (tex->data && !tex->mirror_shm) {
+        _bolt_s3tc_decode_region(tex, &decoder, xoffset, yoffset, width, height, data);
+        _bolt_texture_regions_invalidate(tex, xoffset, yoffset, width, height);
     }
+    BOLT_FRAMETRACE_END(scope_start, "gl:CompressedTexSubImage2D");
     LOG("glCompressedTexSubImage2D end\n");
 }
 
@@ -989,11 +2198,12 @@ static void _bolt_glCopyImageSubData(
     GLsizei srcWidth, GLsizei srcHeight, GLsizei srcDepth
 ) {
     LOG("glCopyImageSubData\n");
+    TRACE(COPYIMAGESUBDATA, T32(srcName) T32(srcTarget) T32(srcLevel) T32(srcX) T32(srcY) T32(srcZ) T32(dstName) T32(dstTarget) T32(dstLevel) T32(dstX) T32(dstY) T32(dstZ) T32(srcWidth) T32(srcHeight) T32(srcDepth))
     gl.CopyImageSubData(srcName, srcTarget, srcLevel, srcX, srcY, srcZ, dstName, dstTarget, dstLevel, dstX, dstY, dstZ, srcWidth, srcHeight, srcDepth);
     struct GLContext* c = _bolt_context();
     if (srcTarget == GL_TEXTURE_2D && dstTarget == GL_TEXTURE_2D && srcLevel == 0 && dstLevel == 0) {
-        const struct GLTexture2D* src = _bolt_context_get_texture(c, srcName);
-        const struct GLTexture2D* dst = _bolt_context_get_texture(c, dstName);
+        struct GLTexture2D* src = _bolt_context_get_texture(c, srcName);
+        struct GLTexture2D* dst = _bolt_context_get_texture(c, dstName);
         if (!c->does_blit_3d_target && c->depth_of_field_enabled && dst->id == c->depth_of_field_sSourceTex) {
             if (srcX == 0 && srcY == 0 && dstX == 0 && dstY == 0 && src->width == dst->width && src->height == dst->height && src->width == srcWidth && src->height == srcHeight) {
                 printf("copy to depth-of-field tex from tex %i\n", src->id);
@@ -1001,8 +2211,26 @@ static void _bolt_glCopyImageSubData(
                 c->target_3d_tex = src->id;
             }
         } else if (src->id != c->target_3d_tex) {
-            for (GLsizei i = 0; i < srcHeight; i += 1) {
-                memcpy(dst->data + (dstY * dst->width * 4) + (dstX * 4), src->data + (srcY * src->width * 4) + (srcX * 4), srcWidth * 4);
+            if (dst->compressed) {
+                struct S3TCDecoder decoder;
+                if (src->compressed && src->compressed_format == dst->compressed_format && !(srcX % 4) && !(srcY % 4) && _bolt_s3tc_decoder(src->compressed_format, &decoder)) {
+                    const size_t row_stride = (((size_t)src->width + 3) / 4) * decoder.block_size;
+                    const uint8_t* blocks = src->compressed + ((srcY / 4) * row_stride) + ((srcX / 4) * decoder.block_size);
+                    _bolt_texture_store_blocks(dst, decoder.block_size, dstX, dstY, srcWidth, srcHeight, blocks, row_stride);
+                } else {
+                    // the copied pixels can't be turned back into blocks, so don't keep a mirror that
+                    // claims to be up to date, or region hashes that no longer match what was copied
+                    _bolt_texture_mirror_free(dst);
+                    _bolt_texture_regions_invalidate(dst, dstX, dstY, srcWidth, srcHeight);
+                }
+            } else {
+                const uint8_t* src_data = _bolt_texture_mirror_rows(src, srcY, srcY + srcHeight);
+                if (src_data && dst->data) {
+                    for (GLsizei i = 0; i < srcHeight; i += 1) {
+                        memcpy(dst->data + ((dstY + i) * dst->width * 4) + (dstX * 4), src_data + ((srcY + i) * src->width * 4) + (srcX * 4), srcWidth * 4);
+                    }
+                    _bolt_texture_regions_invalidate(dst, dstX, dstY, srcWidth, srcHeight);
+                }
             }
         }
     }
@@ -1011,6 +2239,7 @@ static void _bolt_glCopyImageSubData(
 
 static void _bolt_glEnableVertexAttribArray(GLuint index) {
     LOG("glEnableVertexAttribArray\n");
+    TRACE(ENABLEVERTEXATTRIBARRAY, T32(index))
     gl.EnableVertexAttribArray(index);
     struct GLContext* c = _bolt_context();
     c->bound_vao->attributes[index].enabled = 1;
@@ -1019,6 +2248,7 @@ static void _bolt_glEnableVertexAttribArray(GLuint index) {
 
 static void _bolt_glDisableVertexAttribArray(GLuint index) {
     LOG("glDisableVertexAttribArray\n");
+    TRACE(DISABLEVERTEXATTRIBARRAY, T32(index))
     gl.DisableVertexAttribArray(index);
     struct GLContext* c = _bolt_context();
     c->bound_vao->attributes[index].enabled = 0;
@@ -1027,11 +2257,11 @@ static void _bolt_glDisableVertexAttribArray(GLuint index) {
 
 static void* _bolt_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
     LOG("glMapBufferRange\n");
+    TRACE(MAPBUFFERRANGE, T32(target) T64(offset) T64(length) T32(access))
     struct GLContext* c = _bolt_context();
     GLenum binding_type = _bolt_binding_for_buffer(target);
     if (binding_type != -1) {
-        GLint buffer_id;
-        gl.GetIntegerv(binding_type, &buffer_id);
+        const GLuint buffer_id = _bolt_context_bound_buffer(c, target);
         struct GLArrayBuffer* buffer = _bolt_context_get_buffer(c, buffer_id);
         buffer->mapping = malloc(length);
         buffer->mapping_offset = offset;
@@ -1048,11 +2278,11 @@ static void* _bolt_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr l
 
 static GLboolean _bolt_glUnmapBuffer(GLuint target) {
     LOG("glUnmapBuffer\n");
+    TRACE(UNMAPBUFFER, T32(target))
     struct GLContext* c = _bolt_context();
     GLenum binding_type = _bolt_binding_for_buffer(target);
     if (binding_type != -1) {
-        GLint buffer_id;
-        gl.GetIntegerv(binding_type, &buffer_id);
+        const GLuint buffer_id = _bolt_context_bound_buffer(c, target);
         struct GLArrayBuffer* buffer = _bolt_context_get_buffer(c, buffer_id);
         free(buffer->mapping);
         buffer->mapping = NULL;
@@ -1067,39 +2297,41 @@ static GLboolean _bolt_glUnmapBuffer(GLuint target) {
 
 static void _bolt_glBufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags) {
     LOG("glBufferStorage\n");
+    TRACE(BUFFERSTORAGE, T32(target) T64(size) TBLOB(data, size) T32(flags))
     gl.BufferStorage(target, size, data, flags);
+    BOLT_FRAMETRACE_BEGIN(scope_start);
     struct GLContext* c = _bolt_context();
     GLenum binding_type = _bolt_binding_for_buffer(target);
     if (binding_type != -1) {
-        GLint buffer_id;
-        gl.GetIntegerv(binding_type, &buffer_id);
-        void* buffer_content = malloc(size);
-        if (data) memcpy(buffer_content, data, size);
-        struct GLArrayBuffer* buffer = _bolt_context_get_buffer(c, buffer_id);
-        free(buffer->data);
-        buffer->data = buffer_content;
+        const GLuint buffer_id = _bolt_context_bound_buffer(c, target);
+        _bolt_buffer_storage(_bolt_context_get_buffer(c, buffer_id), size, data);
     }
+    BOLT_FRAMETRACE_END(scope_start, "gl:BufferStorage");
     LOG("glBufferStorage end (%s)\n", binding_type == -1 ? "not intercepted" : "intercepted");
 }
 
 static void _bolt_glFlushMappedBufferRange(GLenum target, GLintptr offset, GLsizeiptr length) {
     LOG("glFlushMappedBufferRange\n");
+    BOLT_FRAMETRACE_BEGIN(scope_start);
     struct GLContext* c = _bolt_context();
     GLenum binding_type = _bolt_binding_for_buffer(target);
     if (binding_type != -1) {
-        GLint buffer_id;
-        gl.GetIntegerv(binding_type, &buffer_id);
+        const GLuint buffer_id = _bolt_context_bound_buffer(c, target);
         struct GLArrayBuffer* buffer = _bolt_context_get_buffer(c, buffer_id);
+        TRACE(FLUSHMAPPEDBUFFERRANGE, T32(target) T64(offset) T64(length) TBLOB(buffer->mapping + offset, length))
         gl.BufferSubData(target, buffer->mapping_offset + offset, length, buffer->mapping + offset);
-        memcpy((uint8_t*)buffer->data + buffer->mapping_offset + offset, buffer->mapping + offset, length);
+        _bolt_buffer_write(buffer, buffer->mapping_offset + offset, length, buffer->mapping + offset);
     } else {
+        TRACE(FLUSHMAPPEDBUFFERRANGE, T32(target) T64(offset) T64(length) TBLOB(NULL, 0))
         gl.FlushMappedBufferRange(target, offset, length);
     }
+    BOLT_FRAMETRACE_END(scope_start, "gl:FlushMappedBufferRange");
     LOG("glFlushMappedBufferRange end (%s)\n", binding_type == -1 ? "not intercepted" : "intercepted");
 }
 
 static void _bolt_glActiveTexture(GLenum texture) {
     LOG("glActiveTexture\n");
+    TRACE(ACTIVETEXTURE, T32(texture))
     gl.ActiveTexture(texture);
     struct GLContext* c = _bolt_context();
     c->active_texture = texture - GL_TEXTURE0;
@@ -1117,38 +2349,40 @@ static void _bolt_glMultiDrawElements(GLenum mode, const GLsizei* count, GLenum
 
 static void _bolt_glGenVertexArrays(GLsizei n, GLuint* arrays) {
     LOG("glGenVertexArrays\n");
+    TRACE(GENVERTEXARRAYS, T32(n))
     gl.GenVertexArrays(n, arrays);
     struct GLContext* c = _bolt_context();
     GLint attrib_count;
     gl.GetIntegerv(GL_MAX_VERTEX_ATTRIBS, &attrib_count);
-    _bolt_rwlock_lock_write(&c->vaos->rwlock);
+    _bolt_rwlock_lock_write(&c->share_group->vaos.rwlock);
     for (GLsizei i = 0; i < n; i += 1) {
         struct GLVertexArray* array = malloc(sizeof(struct GLVertexArray));
         array->id = arrays[i];
         array->attributes = calloc(attrib_count, sizeof(struct GLAttrBinding));
-        hashmap_set(c->vaos->map, &array);
+        _bolt_objtable_set(&c->share_group->vaos, array->id, array);
     }
-    _bolt_rwlock_unlock_write(&c->vaos->rwlock);
+    _bolt_rwlock_unlock_write(&c->share_group->vaos.rwlock);
     LOG("glGenVertexArrays end\n");
 }
 
 static void _bolt_glDeleteVertexArrays(GLsizei n, const GLuint* arrays) {
     LOG("glDeleteVertexArrays\n");
+    TRACE(DELETEVERTEXARRAYS, TBLOB(arrays, n * sizeof(*arrays)))
     gl.DeleteVertexArrays(n, arrays);
     struct GLContext* c = _bolt_context();
-    _bolt_rwlock_lock_write(&c->vaos->rwlock);
+    _bolt_rwlock_lock_write(&c->share_group->vaos.rwlock);
     for (GLsizei i = 0; i < n; i += 1) {
-        const GLuint* ptr = &arrays[i];
-        struct GLVertexArray* const* vao = hashmap_delete(c->vaos->map, &ptr);
-        free((*vao)->attributes);
-        free(*vao);
+        struct GLVertexArray* vao = _bolt_objtable_remove(&c->share_group->vaos, arrays[i]);
+        free(vao->attributes);
+        free(vao);
     }
-    _bolt_rwlock_unlock_write(&c->vaos->rwlock);
+    _bolt_rwlock_unlock_write(&c->share_group->vaos.rwlock);
     LOG("glDeleteVertexArrays end\n");
 }
 
 static void _bolt_glBindVertexArray(GLuint array) {
     LOG("glBindVertexArray\n");
+    TRACE(BINDVERTEXARRAY, T32(array))
     gl.BindVertexArray(array);
     struct GLContext* c = _bolt_context();
     c->bound_vao = _bolt_context_get_vao(c, array);
@@ -1157,6 +2391,7 @@ static void _bolt_glBindVertexArray(GLuint array) {
 
 static void _bolt_glBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter) {
     LOG("glBlitFramebuffer\n");
+    TRACE(BLITFRAMEBUFFER, T32(srcX0) T32(srcY0) T32(srcX1) T32(srcY1) T32(dstX0) T32(dstY0) T32(dstX1) T32(dstY1) T32(mask) T32(filter))
     gl.BlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
     struct GLContext* c = _bolt_context();
     if (c->current_draw_framebuffer == 0 && c->game_view_part_framebuffer != c->current_read_framebuffer) {
@@ -1170,20 +2405,16 @@ static void _bolt_glBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint
         c->game_view_y = dstY0;
         printf("new game_view_part_framebuffer %u...\n", c->current_read_framebuffer);
     } else if (srcX0 == 0 && dstX0 == 0 && srcY0 == 0 && dstY0 == 0 && srcX1 == dstX1 && srcY1 == dstY1) {
-        GLint tex_id;
-        gl.GetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &tex_id);
-        struct GLTexture2D* target_tex = _bolt_context_get_texture(c, tex_id);
+        struct GLTexture2D* target_tex = _bolt_context_get_texture(c, _bolt_context_draw_attachment(c));
         if (!c->does_blit_3d_target && target_tex && target_tex->width == dstX1 && target_tex->height == dstY1) {
             if (!c->depth_of_field_enabled && target_tex->id == c->game_view_sSceneHDRTex) {
                 printf("does blit to sSceneHDRTex from fb %u\n", c->current_read_framebuffer);
                 c->does_blit_3d_target = true;
-                gl.GetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &tex_id);
-                c->target_3d_tex = tex_id;
+                c->target_3d_tex = _bolt_context_read_attachment(c);
             } else if (c->depth_of_field_enabled && target_tex->id == c->depth_of_field_sSourceTex) {
                 printf("blit to depth-of-field tex from fb %u\n", c->current_read_framebuffer);
                 c->does_blit_3d_target = true;
-                gl.GetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &tex_id);
-                c->target_3d_tex = tex_id;
+                c->target_3d_tex = _bolt_context_read_attachment(c);
             }
         }
     }
@@ -1217,19 +2448,44 @@ void* _bolt_gl_GetProcAddress(const char* name) {
     PROC_ADDRESS_MAP(DeleteVertexArrays)
     PROC_ADDRESS_MAP(BindVertexArray)
     PROC_ADDRESS_MAP(BlitFramebuffer)
+    PROC_ADDRESS_MAP(GenFramebuffers)
+    PROC_ADDRESS_MAP(DeleteFramebuffers)
+    PROC_ADDRESS_MAP(FramebufferTexture)
+    PROC_ADDRESS_MAP(FramebufferTexture2D)
+    PROC_ADDRESS_MAP(FramebufferTextureLayer)
+    PROC_ADDRESS_MAP(FramebufferRenderbuffer)
+    PROC_ADDRESS_MAP(BindBuffer)
+    PROC_ADDRESS_MAP(BindBufferBase)
+    PROC_ADDRESS_MAP(BindBufferRange)
+    PROC_ADDRESS_MAP(UniformBlockBinding)
+    PROC_ADDRESS_MAP(Uniform1i)
+    PROC_ADDRESS_MAP(Uniform1iv)
+    PROC_ADDRESS_MAP(Uniform4f)
+    PROC_ADDRESS_MAP(Uniform4fv)
+    PROC_ADDRESS_MAP(UniformMatrix4fv)
 #undef PROC_ADDRESS_MAP
     return NULL;
 }
 
 void _bolt_gl_onSwapBuffers(uint32_t window_width, uint32_t window_height) {
+    TRACE(SWAPBUFFERS, T32(window_width) T32(window_height))
     gl_width = window_width;
     gl_height = window_height;
     if (_bolt_plugin_is_inited()) _bolt_plugin_end_frame(window_width, window_height);
+    struct GLContext* c = _bolt_context();
+    if (c) {
+        _bolt_rwlock_lock_write(&texture_mirror_lock);
+        _bolt_texture_mirror_evict(c->share_group);
+        _bolt_rwlock_unlock_write(&texture_mirror_lock);
+    }
 }
 
 void _bolt_gl_onCreateContext(void* context, void* shared_context, const struct GLLibFunctions* libgl, void* (*GetProcAddress)(const char*), bool is_important) {
+    // this is the first hook the game ever calls, so it's where recording has to start
+    if (!shared_context && is_important && egl_init_count == 0) _bolt_trace_open_from_env();
+    TRACE(CREATECONTEXT, T64((uintptr_t)context) T64((uintptr_t)shared_context) T8(is_important))
     if (!shared_context && is_important) {
-        lgl = libgl;
+        lgl = bolt_trace_recording ? _bolt_trace_wrap_lib_functions(libgl) : libgl;
         if (egl_init_count == 0) {
             _bolt_gl_load(GetProcAddress);
         } else {
@@ -1242,22 +2498,19 @@ void _bolt_gl_onCreateContext(void* context, void* shared_context, const struct
 }
 
 void _bolt_gl_onMakeCurrent(void* context) {
+    TRACE(MAKECURRENT, T64((uintptr_t)context))
     struct GLContext* const current_context = _bolt_context();
     if (current_context) {
         current_context->is_attached = 0;
-        if (current_context->deferred_destroy) _bolt_destroy_context(current_context);
+        if (current_context->deferred_destroy) _bolt_destroy_context((void*)current_context->id);
     }
     if (!context) {
         _bolt_set_context(NULL);
         return;
     }
-    for (size_t i = 0; i < CONTEXTS_CAPACITY; i += 1) {
-        struct GLContext* const ptr = &contexts[i];
-        if (ptr->id == (uintptr_t)context) {
-            _bolt_set_context(ptr);
-            break;
-        }
-    }
+    struct GLContext* const ptr = _bolt_find_context((uintptr_t)context);
+    if (ptr) ptr->is_attached = 1;
+    _bolt_set_context(ptr);
     if (egl_main_context_makecurrent_pending && (uintptr_t)context == egl_main_context) {
         egl_main_context_makecurrent_pending = 0;
         _bolt_gl_init();
@@ -1266,14 +2519,18 @@ void _bolt_gl_onMakeCurrent(void* context) {
             .surface_destroy = _bolt_gl_plugin_surface_destroy,
             .surface_resize_and_clear = _bolt_gl_plugin_surface_resize,
             .draw_region_outline = _bolt_gl_plugin_draw_region_outline,
-            .read_screen_pixels = _bolt_gl_plugin_read_screen_pixels,
+            .read_screen_pixels_start = _bolt_gl_plugin_read_screen_pixels_start,
+            .read_screen_pixels_finish = _bolt_gl_plugin_read_screen_pixels_finish,
             .game_view_rect = _bolt_gl_plugin_game_view_rect,
+            .shared_texture_supported = _bolt_gl_plugin_shared_texture_supported,
+            .flush_screen_draws = _bolt_gl_flush_screen_draws,
         };
         _bolt_plugin_init(&functions);
     }
 }
 
 void* _bolt_gl_onDestroyContext(void* context) {
+    TRACE(DESTROYCONTEXT, T64((uintptr_t)context))
     uint8_t do_destroy_main = 0;
     if ((uintptr_t)context != egl_main_context) {
         _bolt_destroy_context(context);
@@ -1288,38 +2545,42 @@ void* _bolt_gl_onDestroyContext(void* context) {
 }
 
 void _bolt_gl_onGenTextures(GLsizei n, GLuint* textures) {
+    TRACE(GENTEXTURES, TBLOB(textures, n * sizeof(*textures)))
     struct GLContext* c = _bolt_context();
-    _bolt_rwlock_lock_write(&c->textures->rwlock);
+    _bolt_rwlock_lock_write(&c->share_group->textures.rwlock);
     for (GLsizei i = 0; i < n; i += 1) {
         struct GLTexture2D* tex = calloc(1, sizeof(struct GLTexture2D));
         tex->id = textures[i];
+        tex->share_group = c->share_group;
         tex->is_minimap_tex_big = 0;
         tex->is_minimap_tex_small = 0;
-        hashmap_set(c->textures->map, &tex);
+        _bolt_objtable_set(&c->share_group->textures, tex->id, tex);
     }
-    _bolt_rwlock_unlock_write(&c->textures->rwlock);
+    _bolt_rwlock_unlock_write(&c->share_group->textures.rwlock);
 }
 
 void _bolt_gl_onDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices_offset) {
+    TRACE(DRAWELEMENTS, T32(mode) T32(count) T32(type) T64((uintptr_t)indices_offset))
+    // if no plugin wants any of the events this function can produce, there's nothing to do here
+    const uint32_t interest = _bolt_plugin_callback_interest();
+    if (!(interest & (PLUGIN_CALLBACK_BATCH2D | PLUGIN_CALLBACK_RENDER3D | PLUGIN_CALLBACK_MINIMAP))) return;
+    BOLT_FRAMETRACE_BEGIN(scope_start);
     struct GLContext* c = _bolt_context();
     struct GLAttrBinding* attributes = c->bound_vao->attributes;
-    GLint element_binding;
-    gl.GetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &element_binding);
-    struct GLArrayBuffer* element_buffer = _bolt_context_get_buffer(c, element_binding);
-    const unsigned short* indices = (unsigned short*)((uint8_t*)element_buffer->data + (uintptr_t)indices_offset);
-    if (type == GL_UNSIGNED_SHORT && mode == GL_TRIANGLES && count > 0 && c->bound_program->is_2d && !c->bound_program->is_minimap) {
-        GLint diffuse_map;
-        gl.GetUniformiv(c->bound_program->id, c->bound_program->loc_uDiffuseMap, &diffuse_map);
-        GLfloat projection_matrix[16];
-        gl.GetUniformfv(c->bound_program->id, c->bound_program->loc_uProjectionMatrix, projection_matrix);
-        GLint draw_tex;
-        gl.GetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &draw_tex);
+    struct GLArrayBuffer* element_buffer = _bolt_context_get_buffer(c, _bolt_context_bound_buffer(c, GL_ELEMENT_ARRAY_BUFFER));
+    // NULL if the element buffer has no CPU copy, in which case none of the branches below can do anything
+    const unsigned short* indices = _bolt_buffer_indices(element_buffer, indices_offset, count);
+    if ((interest & (PLUGIN_CALLBACK_BATCH2D | PLUGIN_CALLBACK_MINIMAP)) && type == GL_UNSIGNED_SHORT && mode == GL_TRIANGLES && count > 0 && c->bound_program->is_2d && !c->bound_program->is_minimap) {
+        const GLint diffuse_map = c->bound_program->uDiffuseMap;
+        const GLfloat* projection_matrix = c->bound_program->uProjectionMatrix;
+        VERIFY_UNIFORMIV(c->bound_program->id, c->bound_program->loc_uDiffuseMap, diffuse_map);
+        VERIFY_UNIFORMFV(c->bound_program->id, c->bound_program->loc_uProjectionMatrix, projection_matrix, 16);
         struct GLTexture2D* tex = c->texture_units[diffuse_map];
-        struct GLTexture2D* tex_target = _bolt_context_get_texture(c, draw_tex);
+        struct GLTexture2D* tex_target = _bolt_context_get_texture(c, _bolt_context_draw_attachment(c));
 
         if (tex->is_minimap_tex_big) {
             tex_target->is_minimap_tex_small = 1;
-            if (count == 6) {
+            if (count == 6 && (interest & PLUGIN_CALLBACK_MINIMAP) && indices) {
                 // get XY and UV of first two vertices
                 const struct GLAttrBinding* tex_uv = &attributes[c->bound_program->loc_aTextureUV];
                 const struct GLAttrBinding* position_2d = &attributes[c->bound_program->loc_aVertexPosition2D];
@@ -1382,10 +2643,10 @@ void _bolt_gl_onDrawElements(GLenum mode, GLsizei count, GLenum type, const void
                     _bolt_plugin_handle_minimap(&render);
                 }
             }
-        } else {
+        } else if ((interest & PLUGIN_CALLBACK_BATCH2D) && indices) {
             struct GLPluginDrawElementsVertex2DUserData vertex_userdata;
             vertex_userdata.c = c;
-            vertex_userdata.indices = (unsigned short*)((uint8_t*)element_buffer->data + (uintptr_t)indices_offset);
+            vertex_userdata.indices = indices;
             vertex_userdata.atlas = c->texture_units[diffuse_map];
             vertex_userdata.position = &attributes[c->bound_program->loc_aVertexPosition2D];
             vertex_userdata.atlas_min = &attributes[c->bound_program->loc_aTextureUVAtlasMin];
@@ -1408,33 +2669,38 @@ void _bolt_gl_onDrawElements(GLenum mode, GLsizei count, GLenum type, const void
             batch.vertex_functions.atlas_wh = _bolt_gl_plugin_drawelements_vertex2d_atlas_wh;
             batch.vertex_functions.uv = _bolt_gl_plugin_drawelements_vertex2d_uv;
             batch.vertex_functions.colour = _bolt_gl_plugin_drawelements_vertex2d_colour;
+            batch.vertex_functions.xy_bulk = _bolt_gl_plugin_drawelements_vertex2d_xy_bulk;
+            batch.vertex_functions.atlas_xy_bulk = _bolt_gl_plugin_drawelements_vertex2d_atlas_xy_bulk;
+            batch.vertex_functions.atlas_wh_bulk = _bolt_gl_plugin_drawelements_vertex2d_atlas_wh_bulk;
+            batch.vertex_functions.uv_bulk = _bolt_gl_plugin_drawelements_vertex2d_uv_bulk;
+            batch.vertex_functions.colour_bulk = _bolt_gl_plugin_drawelements_vertex2d_colour_bulk;
             batch.texture_functions.userdata = &tex_userdata;
             batch.texture_functions.id = _bolt_gl_plugin_texture_id;
             batch.texture_functions.size = _bolt_gl_plugin_texture_size;
             batch.texture_functions.compare = _bolt_gl_plugin_texture_compare;
             batch.texture_functions.data = _bolt_gl_plugin_texture_data;
+            batch.texture_functions.hash = _bolt_gl_plugin_texture_hash;
 
             _bolt_plugin_handle_render2d(&batch);
         }
     }
-    if (type == GL_UNSIGNED_SHORT && mode == GL_TRIANGLES && c->bound_program->is_3d) {
-        GLint draw_tex;
-        gl.GetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &draw_tex);
-        if (draw_tex == c->target_3d_tex) {
-            GLint atlas, settings_atlas, ubo_binding, ubo_view_index, ubo_viewport_index;
-            GLfloat atlas_meta[4];
-            gl.GetUniformiv(c->bound_program->id, c->bound_program->loc_uTextureAtlas, &atlas);
-            gl.GetUniformiv(c->bound_program->id, c->bound_program->loc_uTextureAtlasSettings, &settings_atlas);
-            gl.GetUniformfv(c->bound_program->id, c->bound_program->loc_uAtlasMeta, atlas_meta);
+    if ((interest & PLUGIN_CALLBACK_RENDER3D) && type == GL_UNSIGNED_SHORT && mode == GL_TRIANGLES && c->bound_program->is_3d) {
+        const GLint draw_tex = _bolt_context_draw_attachment(c);
+        const uint8_t* view_transforms = (draw_tex == c->target_3d_tex) ? _bolt_context_view_transforms(c, c->bound_program) : NULL;
+        if (view_transforms && indices) {
+            const GLint atlas = c->bound_program->uTextureAtlas;
+            const GLint settings_atlas = c->bound_program->uTextureAtlasSettings;
+            const GLfloat* atlas_meta = c->bound_program->uAtlasMeta;
+            VERIFY_UNIFORMIV(c->bound_program->id, c->bound_program->loc_uTextureAtlas, atlas);
+            VERIFY_UNIFORMIV(c->bound_program->id, c->bound_program->loc_uTextureAtlasSettings, settings_atlas);
+            VERIFY_UNIFORMFV(c->bound_program->id, c->bound_program->loc_uAtlasMeta, atlas_meta, 4);
             struct GLTexture2D* tex = c->texture_units[atlas];
             struct GLTexture2D* tex_settings = c->texture_units[settings_atlas];
-            gl.GetActiveUniformBlockiv(c->bound_program->id, c->bound_program->block_index_ViewTransforms, GL_UNIFORM_BLOCK_BINDING, &ubo_binding);
-            gl.GetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, ubo_binding, &ubo_view_index);
-            const float* view_proj_matrix = (float*)((uint8_t*)(_bolt_context_get_buffer(c, ubo_view_index)->data) + c->bound_program->offset_uViewProjMatrix);
+            const float* view_proj_matrix = (float*)(view_transforms + c->bound_program->offset_uViewProjMatrix);
 
             struct GLPluginDrawElementsVertex3DUserData vertex_userdata;
             vertex_userdata.c = c;
-            vertex_userdata.indices = (unsigned short*)((uint8_t*)element_buffer->data + (uintptr_t)indices_offset);
+            vertex_userdata.indices = indices;
             vertex_userdata.atlas_scale = roundf(atlas_meta[1]);
             vertex_userdata.atlas = tex;
             vertex_userdata.settings_atlas = tex_settings;
@@ -1447,7 +2713,8 @@ void _bolt_gl_onDrawElements(GLenum mode, GLsizei count, GLenum type, const void
             tex_userdata.tex = tex;
 
             struct GLPlugin3DMatrixUserData matrix_userdata;
-            gl.GetUniformfv(c->bound_program->id, c->bound_program->loc_uModelMatrix, matrix_userdata.model_matrix);
+            VERIFY_UNIFORMFV(c->bound_program->id, c->bound_program->loc_uModelMatrix, c->bound_program->uModelMatrix, 16);
+            memcpy(matrix_userdata.model_matrix, c->bound_program->uModelMatrix, 16 * sizeof(float));
             memcpy(matrix_userdata.viewproj_matrix, view_proj_matrix, 16 * sizeof(float));
 
             struct Render3D render;
@@ -1461,11 +2728,18 @@ void _bolt_gl_onDrawElements(GLenum mode, GLsizei count, GLenum type, const void
             render.vertex_functions.colour = _bolt_gl_plugin_drawelements_vertex3d_colour;
             render.vertex_functions.bone_id = _bolt_gl_plugin_drawelements_vertex3d_boneid;
             render.vertex_functions.bone_transform = _bolt_gl_plugin_bone_transform;
+            render.vertex_functions.bone_palette = _bolt_gl_plugin_bone_palette;
+            render.vertex_functions.xyz_bulk = _bolt_gl_plugin_drawelements_vertex3d_xyz_bulk;
+            render.vertex_functions.atlas_meta_bulk = _bolt_gl_plugin_drawelements_vertex3d_atlas_meta_bulk;
+            render.vertex_functions.uv_bulk = _bolt_gl_plugin_drawelements_vertex3d_uv_bulk;
+            render.vertex_functions.colour_bulk = _bolt_gl_plugin_drawelements_vertex3d_colour_bulk;
+            render.vertex_functions.bone_id_bulk = _bolt_gl_plugin_drawelements_vertex3d_boneid_bulk;
             render.texture_functions.userdata = &tex_userdata;
             render.texture_functions.id = _bolt_gl_plugin_texture_id;
             render.texture_functions.size = _bolt_gl_plugin_texture_size;
             render.texture_functions.compare = _bolt_gl_plugin_texture_compare;
             render.texture_functions.data = _bolt_gl_plugin_texture_data;
+            render.texture_functions.hash = _bolt_gl_plugin_texture_hash;
             render.matrix_functions.userdata = &matrix_userdata;
             render.matrix_functions.model_matrix = _bolt_gl_plugin_matrix3d_model;
             render.matrix_functions.viewproj_matrix = _bolt_gl_plugin_matrix3d_viewproj;
@@ -1473,6 +2747,7 @@ void _bolt_gl_onDrawElements(GLenum mode, GLsizei count, GLenum type, const void
             _bolt_plugin_handle_render3d(&render);
         }
     }
+    BOLT_FRAMETRACE_END(scope_start, "gl:DrawElements");
 }
 
 /*
@@ -1508,23 +2783,22 @@ hunt strategy is as follows:
 5b. if a full-blit or full-glCopyImageSubData occurs targeting depth_of_field_sSourceTex, take that as the render target
 */
 void _bolt_gl_onDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    TRACE(DRAWARRAYS, T32(mode) T32(first) T32(count))
     struct GLContext* c = _bolt_context();
-    GLint target_tex_id;
-    gl.GetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &target_tex_id);
+    const GLint target_tex_id = _bolt_context_draw_attachment(c);
     struct GLTexture2D* target_tex = _bolt_context_get_texture(c, target_tex_id);
 
     if (c->bound_program->is_minimap && target_tex->width == GAME_MINIMAP_BIG_SIZE && target_tex->height == GAME_MINIMAP_BIG_SIZE) {
-        GLint ubo_binding, ubo_view_index;
-        gl.GetActiveUniformBlockiv(c->bound_program->id, c->bound_program->block_index_ViewTransforms, GL_UNIFORM_BLOCK_BINDING, &ubo_binding);
-        gl.GetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, (GLuint)ubo_binding, &ubo_view_index);
-        const float* camera_position = (float*)((uint8_t*)(_bolt_context_get_buffer(c, ubo_view_index)->data) + c->bound_program->offset_uCameraPosition);
+        const uint8_t* view_transforms = _bolt_context_view_transforms(c, c->bound_program);
+        if (!view_transforms) return;
+        const float* camera_position = (float*)(view_transforms + c->bound_program->offset_uCameraPosition);
         target_tex->is_minimap_tex_big = 1;
         target_tex->minimap_center_x = camera_position[0];
         target_tex->minimap_center_y = camera_position[2];
     } else if (mode == GL_TRIANGLE_STRIP && count == 4) {
         if (c->bound_program->loc_sSceneHDRTex != -1) {
-            GLint source_tex_unit;
-            gl.GetUniformiv(c->bound_program->id, c->bound_program->loc_sSceneHDRTex, &source_tex_unit);
+            const GLint source_tex_unit = c->bound_program->sSceneHDRTex;
+            VERIFY_UNIFORMIV(c->bound_program->id, c->bound_program->loc_sSceneHDRTex, source_tex_unit);
             struct GLTexture2D* source_tex = c->texture_units[source_tex_unit];
             if (c->current_draw_framebuffer == 0 && c->game_view_sSceneHDRTex != source_tex->id) {
                 c->game_view_sSceneHDRTex = source_tex->id;
@@ -1546,8 +2820,8 @@ void _bolt_gl_onDrawArrays(GLenum mode, GLint first, GLsizei count) {
                 printf("new sSceneHDRTex %i\n", c->target_3d_tex);
             }
         } else if (c->bound_program->loc_sSourceTex != -1) {
-            GLint source_tex_unit;
-            gl.GetUniformiv(c->bound_program->id, c->bound_program->loc_sSourceTex, &source_tex_unit);
+            const GLint source_tex_unit = c->bound_program->sSourceTex;
+            VERIFY_UNIFORMIV(c->bound_program->id, c->bound_program->loc_sSourceTex, source_tex_unit);
             struct GLTexture2D* source_tex = c->texture_units[source_tex_unit];
             if (c->bound_program->loc_sBlurFarTex != -1) {
                 if (c->depth_of_field_enabled || c->game_view_sSceneHDRTex != target_tex->id) return;
@@ -1572,6 +2846,7 @@ void _bolt_gl_onDrawArrays(GLenum mode, GLint first, GLsizei count) {
 }
 
 void _bolt_gl_onBindTexture(GLenum target, GLuint texture) {
+    TRACE(BINDTEXTURE, T32(target) T32(texture))
     if (target == GL_TEXTURE_2D) {
         struct GLContext* c = _bolt_context();
         c->texture_units[c->active_texture] = _bolt_context_get_texture(c, texture);
@@ -1580,36 +2855,41 @@ void _bolt_gl_onBindTexture(GLenum target, GLuint texture) {
 
 void _bolt_gl_onTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels) {
     struct GLContext* c = _bolt_context();
+    // only RGBA pixels are ever read by this function, and it assumes they're tightly packed
+    const uint8_t trace_pixels = pixels && !c->bound_pixel_unpack_buffer && format == GL_RGBA && width > 0 && height > 0;
+    TRACE(TEXSUBIMAGE2D, T32(target) T32(level) T32(xoffset) T32(yoffset) T32(width) T32(height) T32(format) T32(type) T64((uintptr_t)pixels) TBLOB(trace_pixels ? pixels : NULL, (size_t)width * height * 4))
+    BOLT_FRAMETRACE_BEGIN(scope_start);
     if (target == GL_TEXTURE_2D && level == 0 && format == GL_RGBA) {
         struct GLTexture2D* tex = c->texture_units[c->active_texture];
-        if (tex && !(xoffset < 0 || yoffset < 0 || xoffset + width > tex->width || yoffset + height > tex->height)) {
+        if (tex && tex->data && !tex->compressed && !(xoffset < 0 || yoffset < 0 || xoffset + width > tex->width || yoffset + height > tex->height)) {
             for (GLsizei y = 0; y < height; y += 1) {
                 uint8_t* dest_ptr = tex->data + ((tex->width * (y + yoffset)) + xoffset) * 4;
                 const uint8_t* src_ptr = (uint8_t*)pixels + (width * y * 4);
                 memcpy(dest_ptr, src_ptr, width * 4);
             }
+            _bolt_texture_regions_uploaded(tex, xoffset, yoffset, width, height, _bolt_texture_hash_rows(pixels, (size_t)width * 4, (size_t)width * 4, height));
         }
     }
+    BOLT_FRAMETRACE_END(scope_start, "gl:TexSubImage2D");
 }
 
 void _bolt_gl_onDeleteTextures(GLsizei n, const GLuint* textures) {
+    TRACE(DELETETEXTURES, TBLOB(textures, n * sizeof(*textures)))
     struct GLContext* c = _bolt_context();
-    _bolt_rwlock_lock_write(&c->textures->rwlock);
+    _bolt_rwlock_lock_write(&c->share_group->textures.rwlock);
     for (GLsizei i = 0; i < n; i += 1) {
-        const GLuint* ptr = &textures[i];
-        struct GLTexture2D* const* texture = hashmap_delete(c->textures->map, &ptr);
-        free((*texture)->data);
-        free(*texture);
+        struct GLTexture2D* texture = _bolt_objtable_remove(&c->share_group->textures, textures[i]);
+        _bolt_texture_storage_free(texture);
+        free(texture);
     }
-    _bolt_rwlock_unlock_write(&c->textures->rwlock);
+    _bolt_rwlock_unlock_write(&c->share_group->textures.rwlock);
 }
 
 void _bolt_gl_onClear(GLbitfield mask) {
+    TRACE(CLEAR, T32(mask))
     struct GLContext* c = _bolt_context();
     if (mask & GL_COLOR_BUFFER_BIT) {
-        GLint draw_tex;
-        gl.GetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &draw_tex);
-        struct GLTexture2D* tex = _bolt_context_get_texture(c, draw_tex);
+        struct GLTexture2D* tex = _bolt_context_get_texture(c, _bolt_context_draw_attachment(c));
         if (tex) {
             tex->is_minimap_tex_big = 0;
         }
@@ -1617,6 +2897,7 @@ void _bolt_gl_onClear(GLbitfield mask) {
 }
 
 void _bolt_gl_onViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    TRACE(VIEWPORT, T32(x) T32(y) T32(width) T32(height))
     struct GLContext* c = _bolt_context();
     c->viewport_x = x;
     c->viewport_y = y;
@@ -1624,6 +2905,13 @@ void _bolt_gl_onViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
     c->viewport_h = height;
 }
 
+void _bolt_gl_onPixelStorei(GLenum pname, GLint param) {
+    TRACE(PIXELSTOREI, T32(pname) T32(param))
+    struct GLContext* c = _bolt_context();
+    if (pname == GL_UNPACK_ROW_LENGTH) c->unpack_row_length = param;
+    if (pname == GL_PACK_ALIGNMENT) c->pack_alignment = param;
+}
+
 static void _bolt_gl_plugin_drawelements_vertex2d_xy(size_t index, void* userdata, int32_t* out) {
     struct GLPluginDrawElementsVertex2DUserData* data = userdata;
     if (!_bolt_get_attr_binding_int(data->c, data->position, data->indices[index], 2, out)) {
@@ -1695,8 +2983,13 @@ static void _bolt_gl_plugin_drawelements_vertex3d_meta_xywh(size_t meta, void* u
     struct GLPluginDrawElementsVertex3DUserData* data = userdata;
     size_t slot_x = meta & 0xFF;
     size_t slot_y = meta >> 16;
+    const uint8_t* settings_data = _bolt_texture_mirror_rows(data->settings_atlas, slot_y * 4, (slot_y * 4) + 3);
+    if (!settings_data) {
+        memset(out, 0, 4 * sizeof(*out));
+        return;
+    }
     // this is pretty wild
-    const uint8_t* settings_ptr = data->settings_atlas->data + (slot_y * data->settings_atlas->width * 4 * 4) + (slot_x * 3 * 4);
+    const uint8_t* settings_ptr = settings_data + (slot_y * data->settings_atlas->width * 4 * 4) + (slot_x * 3 * 4);
     const uint8_t bitmask = *(settings_ptr + (data->settings_atlas->width * 2 * 4) + 7);
     out[0] = ((int32_t)(*settings_ptr) + (bitmask & 1 ? 256 : 0)) * data->atlas_scale;
     out[1] = ((int32_t)*(settings_ptr + 1) + (bitmask & 2 ? 256 : 0)) * data->atlas_scale;
@@ -1734,29 +3027,204 @@ static uint8_t _bolt_gl_plugin_drawelements_vertex3d_boneid(size_t index, void*
     return (uint8_t)(ret[3]);
 }
 
+// decodes `num_out` floats of one attribute for each vertex in a range of indices, writing them
+// `stride` bytes apart. the binding can't change part-way through, so whether it's readable and
+// which decode function to use only need checking once. if it's unreadable, everything is zeroed.
+static void _bolt_get_attr_binding_range(struct GLContext* c, const struct GLAttrBinding* binding, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t stride) {
+    float values[4];
+    const uint8_t* data = _bolt_buffer_shadow(binding->buffer);
+    if (!data) {
+        memset(values, 0, sizeof(values));
+        for (size_t i = 0; i < count; i += 1) memcpy(out + (i * stride), values, num_out * sizeof(float));
+        return;
+    }
+    const uint8_t* base = data + binding->offset;
+    if (binding->decode_range && num_out <= 4) {
+        binding->decode_range(base, binding->stride, indices, count, num_out, out, stride);
+        return;
+    }
+    const GLAttrDecodeFunction decode = binding->decode;
+    for (size_t i = 0; i < count; i += 1) {
+        decode(base + (binding->stride * indices[i]), num_out, values);
+        memcpy(out + (i * stride), values, num_out * sizeof(float));
+    }
+}
+
+// same as above but for integer attributes. returns 0 without writing anything if the binding
+// isn't an integer type, same as _bolt_get_attr_binding_int.
+static uint8_t _bolt_get_attr_binding_int_range(struct GLContext* c, const struct GLAttrBinding* binding, const unsigned short* indices, size_t count, size_t num_out, uint8_t* out, size_t stride) {
+    int32_t values[4];
+    if (!binding->decode_int) return 0;
+    const uint8_t* data = _bolt_buffer_shadow(binding->buffer);
+    if (!data) return 0;
+    const uint8_t* base = data + binding->offset;
+    const GLAttrDecodeIntFunction decode = binding->decode_int;
+    for (size_t i = 0; i < count; i += 1) {
+        decode(base + (binding->stride * indices[i]), num_out, values);
+        memcpy(out + (i * stride), values, num_out * sizeof(int32_t));
+    }
+    return 1;
+}
+
+static void _bolt_gl_plugin_drawelements_vertex2d_xy_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    struct GLPluginDrawElementsVertex2DUserData* data = userdata;
+    if (_bolt_get_attr_binding_int_range(data->c, data->position, data->indices + first, count, 2, out, stride)) return;
+    _bolt_get_attr_binding_range(data->c, data->position, data->indices + first, count, 2, out, stride);
+    for (size_t i = 0; i < count; i += 1) {
+        uint8_t* ptr = (uint8_t*)out + (i * stride);
+        float pos[2];
+        memcpy(pos, ptr, sizeof(pos));
+        const int32_t xy[2] = {(int32_t)roundf(pos[0]), (int32_t)roundf(pos[1])};
+        memcpy(ptr, xy, sizeof(xy));
+    }
+}
+
+// converts pairs of floats from 0.0 to 1.0 into pixel positions on the atlas, in-place
+static void _bolt_gl_plugin_atlas_pixels_bulk(const struct GLTexture2D* atlas, size_t count, uint8_t* out, size_t stride, int32_t sign) {
+    for (size_t i = 0; i < count; i += 1) {
+        uint8_t* ptr = out + (i * stride);
+        float xy[2];
+        memcpy(xy, ptr, sizeof(xy));
+        const int32_t pixels[2] = {sign * (int32_t)roundf(xy[0] * atlas->width), sign * (int32_t)roundf(xy[1] * atlas->height)};
+        memcpy(ptr, pixels, sizeof(pixels));
+    }
+}
+
+static void _bolt_gl_plugin_drawelements_vertex2d_atlas_xy_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    struct GLPluginDrawElementsVertex2DUserData* data = userdata;
+    _bolt_get_attr_binding_range(data->c, data->atlas_min, data->indices + first, count, 2, out, stride);
+    _bolt_gl_plugin_atlas_pixels_bulk(data->atlas, count, out, stride, 1);
+}
+
+static void _bolt_gl_plugin_drawelements_vertex2d_atlas_wh_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    struct GLPluginDrawElementsVertex2DUserData* data = userdata;
+    _bolt_get_attr_binding_range(data->c, data->atlas_size, data->indices + first, count, 2, out, stride);
+    // these are negative for some reason
+    _bolt_gl_plugin_atlas_pixels_bulk(data->atlas, count, out, stride, -1);
+}
+
+static void _bolt_gl_plugin_drawelements_vertex2d_uv_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    struct GLPluginDrawElementsVertex2DUserData* data = userdata;
+    _bolt_get_attr_binding_range(data->c, data->tex_uv, data->indices + first, count, 2, out, stride);
+}
+
+// reverses each group of four floats in-place, since vertex colours are ABGR for some reason
+static void _bolt_gl_plugin_colour_bulk(size_t count, uint8_t* out, size_t stride) {
+    for (size_t i = 0; i < count; i += 1) {
+        uint8_t* ptr = out + (i * stride);
+        float abgr[4];
+        memcpy(abgr, ptr, sizeof(abgr));
+        const float rgba[4] = {abgr[3], abgr[2], abgr[1], abgr[0]};
+        memcpy(ptr, rgba, sizeof(rgba));
+    }
+}
+
+static void _bolt_gl_plugin_drawelements_vertex2d_colour_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    struct GLPluginDrawElementsVertex2DUserData* data = userdata;
+    _bolt_get_attr_binding_range(data->c, data->colour, data->indices + first, count, 4, out, stride);
+    _bolt_gl_plugin_colour_bulk(count, out, stride);
+}
+
+static void _bolt_gl_plugin_drawelements_vertex3d_xyz_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    struct GLPluginDrawElementsVertex3DUserData* data = userdata;
+    // shorts, which is what positions usually are, have a range decoder that gives the same floats
+    // as going through ints, without the second pass
+    if (!data->xyz_bone->decode_range && _bolt_get_attr_binding_int_range(data->c, data->xyz_bone, data->indices + first, count, 3, out, stride)) {
+        for (size_t i = 0; i < count; i += 1) {
+            uint8_t* ptr = (uint8_t*)out + (i * stride);
+            int32_t xyz[3];
+            memcpy(xyz, ptr, sizeof(xyz));
+            const float xyzf[3] = {(float)xyz[0], (float)xyz[1], (float)xyz[2]};
+            memcpy(ptr, xyzf, sizeof(xyzf));
+        }
+        return;
+    }
+    _bolt_get_attr_binding_range(data->c, data->xyz_bone, data->indices + first, count, 3, out, stride);
+}
+
+static void _bolt_gl_plugin_drawelements_vertex3d_atlas_meta_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    struct GLPluginDrawElementsVertex3DUserData* data = userdata;
+    const struct GLAttrBinding* binding = data->xy_xz;
+    const uint8_t* shadow = binding->decode_int ? _bolt_buffer_shadow(binding->buffer) : NULL;
+    if (!shadow) {
+        const uint32_t meta = 0;
+        for (size_t i = 0; i < count; i += 1) memcpy((uint8_t*)out + (i * stride), &meta, sizeof(meta));
+        return;
+    }
+    const uint8_t* base = shadow + binding->offset;
+    const GLAttrDecodeIntFunction decode = binding->decode_int;
+    const unsigned short* indices = data->indices + first;
+    for (size_t i = 0; i < count; i += 1) {
+        int32_t material_xy[2];
+        decode(base + (binding->stride * indices[i]), 2, material_xy);
+        const uint32_t meta = ((uint32_t)material_xy[1] << 16) | (uint32_t)material_xy[0];
+        memcpy((uint8_t*)out + (i * stride), &meta, sizeof(meta));
+    }
+}
+
+static void _bolt_gl_plugin_drawelements_vertex3d_uv_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    struct GLPluginDrawElementsVertex3DUserData* data = userdata;
+    _bolt_get_attr_binding_range(data->c, data->tex_uv, data->indices + first, count, 2, out, stride);
+}
+
+static void _bolt_gl_plugin_drawelements_vertex3d_colour_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    struct GLPluginDrawElementsVertex3DUserData* data = userdata;
+    _bolt_get_attr_binding_range(data->c, data->colour, data->indices + first, count, 4, out, stride);
+    _bolt_gl_plugin_colour_bulk(count, out, stride);
+}
+
+// bone IDs are the W of the position attribute, which may be an int or a float type
+static void _bolt_gl_plugin_drawelements_vertex3d_boneid_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    struct GLPluginDrawElementsVertex3DUserData* data = userdata;
+    const struct GLAttrBinding* binding = data->xyz_bone;
+    const uint8_t* shadow = _bolt_buffer_shadow(binding->buffer);
+    if (!shadow) {
+        const uint32_t bone_id = 0;
+        for (size_t i = 0; i < count; i += 1) memcpy((uint8_t*)out + (i * stride), &bone_id, sizeof(bone_id));
+        return;
+    }
+    const uint8_t* base = shadow + binding->offset;
+    const unsigned short* indices = data->indices + first;
+    if (binding->decode_int) {
+        const GLAttrDecodeIntFunction decode = binding->decode_int;
+        for (size_t i = 0; i < count; i += 1) {
+            int32_t xyzw[4];
+            decode(base + (binding->stride * indices[i]), 4, xyzw);
+            const uint32_t bone_id = (uint8_t)(uint32_t)xyzw[3];
+            memcpy((uint8_t*)out + (i * stride), &bone_id, sizeof(bone_id));
+        }
+    } else {
+        const GLAttrDecodeFunction decode = binding->decode;
+        for (size_t i = 0; i < count; i += 1) {
+            float xyzw[4];
+            decode(base + (binding->stride * indices[i]), 4, xyzw);
+            const uint32_t bone_id = (uint8_t)(uint32_t)(int32_t)roundf(xyzw[3]);
+            memcpy((uint8_t*)out + (i * stride), &bone_id, sizeof(bone_id));
+        }
+    }
+}
+
 static void _bolt_gl_plugin_bone_transform(uint8_t bone_id, void* userdata, struct Transform3D* out) {
     struct GLContext* c = _bolt_context();
+    if (!c->bound_program->uBoneTransforms || bone_id >= c->bound_program->bone_count) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+#if defined(VERIFY_SHADOW_STATE)
     const GLint uniform_loc = c->bound_program->loc_uBoneTransforms + (bone_id * 3);
-    GLfloat f[4];
-    gl.GetUniformfv(c->bound_program->id, uniform_loc, f);
-    out->matrix[0] = (double)f[0];
-    out->matrix[1] = (double)f[1];
-    out->matrix[2] = (double)f[2];
-    out->matrix[3] = 0.0;
-    out->matrix[4] = (double)f[3];
-    gl.GetUniformfv(c->bound_program->id, uniform_loc + 1, f);
-    out->matrix[5] = (double)f[0];
-    out->matrix[6] = (double)f[1];
-    out->matrix[7] = 0.0;
-    out->matrix[8] = (double)f[2];
-    out->matrix[9] = (double)f[3];
-    gl.GetUniformfv(c->bound_program->id, uniform_loc + 2, f);
-    out->matrix[10] = (double)f[0];
-    out->matrix[11] = 0.0;
-    out->matrix[12] = (double)f[1];
-    out->matrix[13] = (double)f[2];
-    out->matrix[14] = (double)f[3];
-    out->matrix[15] = 1.0;
+    const GLfloat* f = c->bound_program->uBoneTransforms + (bone_id * 3 * 4);
+    VERIFY_UNIFORMFV(c->bound_program->id, uniform_loc, f, 4);
+    VERIFY_UNIFORMFV(c->bound_program->id, uniform_loc + 1, f + 4, 4);
+    VERIFY_UNIFORMFV(c->bound_program->id, uniform_loc + 2, f + 8, 4);
+#endif
+    _bolt_plugin_bone_transform_from_palette(c->bound_program->uBoneTransforms, bone_id, out);
+}
+
+static const float* _bolt_gl_plugin_bone_palette(void* userdata, size_t* bone_count) {
+    struct GLContext* c = _bolt_context();
+    // this is the shadow copy kept up to date by glUniform4fv, so nothing has to be read back here
+    *bone_count = c->bound_program->uBoneTransforms ? c->bound_program->bone_count : 0;
+    return c->bound_program->uBoneTransforms;
 }
 
 static void _bolt_gl_plugin_matrix3d_model(void* userdata, struct Transform3D* out) {
@@ -1786,7 +3254,7 @@ static void _bolt_gl_plugin_texture_size(void* userdata, size_t* out) {
 
 static uint8_t _bolt_gl_plugin_texture_compare(void* userdata, size_t x, size_t y, size_t len, const unsigned char* data) {
     const struct GLPluginTextureUserData* data_ = userdata;
-    const struct GLTexture2D* tex = data_->tex;
+    struct GLTexture2D* tex = data_->tex;
     const size_t start_offset = (tex->width * y * 4) + (x * 4);
     if (start_offset + len > tex->width * tex->height * 4) {
         printf(
@@ -1795,32 +3263,108 @@ static uint8_t _bolt_gl_plugin_texture_compare(void* userdata, size_t x, size_t
         );
         return 0;
     }
-    return !memcmp(tex->data + start_offset, data, len);
+    const size_t row_len = (size_t)tex->width * 4;
+    const uint8_t* tex_data = _bolt_texture_mirror_rows(tex, y, (start_offset + len + row_len - 1) / row_len);
+    return tex_data && !memcmp(tex_data + start_offset, data, len);
+}
+
+static uint8_t* _bolt_gl_plugin_texture_data(void* userdata, size_t x, size_t y, size_t len) {
+    const struct GLPluginTextureUserData* data = userdata;
+    struct GLTexture2D* tex = data->tex;
+    const size_t row_len = (size_t)tex->width * 4;
+    const size_t start_offset = (row_len * y) + (x * 4);
+    uint8_t* tex_data = _bolt_texture_mirror_rows(tex, y, (start_offset + len + row_len - 1) / row_len);
+    return tex_data ? tex_data + start_offset : NULL;
 }
 
-static uint8_t* _bolt_gl_plugin_texture_data(void* userdata, size_t x, size_t y) {
+static uint8_t _bolt_gl_plugin_texture_hash(void* userdata, size_t x, size_t y, size_t w, size_t h, uint8_t perceptual, uint64_t* out) {
     const struct GLPluginTextureUserData* data = userdata;
-    const struct GLTexture2D* tex = data->tex;
-    return tex->data + (tex->width * y * 4) + (x * 4);
+    struct GLTexture2D* tex = data->tex;
+    if (!w || !h || x >= (size_t)tex->width || y >= (size_t)tex->height || w > tex->width - x || h > tex->height - y) return 0;
+    struct GLTextureRegionHash region = {.x = x, .y = y, .width = w, .height = h, .has_phash = 0};
+    const struct GLTextureRegionHash* cached = tex->region_hashes ? hashmap_get(tex->region_hashes, &region) : NULL;
+    if (cached && cached->width == region.width && cached->height == region.height) {
+        if (!perceptual) {
+            *out = cached->hash;
+            return 1;
+        }
+        if (cached->has_phash) {
+            *out = cached->phash;
+            return 1;
+        }
+        region.hash = cached->hash;
+    } else if (!_bolt_texture_region_content_hash(tex, x, y, w, h, &region.hash)) {
+        return 0;
+    }
+    if (perceptual) {
+        if (!_bolt_texture_region_perceptual_hash(tex, x, y, w, h, &region.phash)) return 0;
+        region.has_phash = 1;
+    }
+    _bolt_texture_regions_put(tex, &region);
+    *out = perceptual ? region.phash : region.hash;
+    return 1;
+}
+
+// uploads 4-byte pixels into the texture bound to GL_TEXTURE_2D, using the upload ring if it fits and
+// the game's pixel unpack state otherwise, and putting all of that state back how the game left it.
+// rows of `pixels` start `stride` bytes apart, or are tightly packed if stride is 0.
+static void _bolt_gl_upload_rect(GLint x, GLint y, GLsizei w, GLsizei h, const void* pixels, size_t stride, GLenum format) {
+    struct GLContext* c = _bolt_context();
+    const size_t row_size = (size_t)w * 4;
+    if (stride == 0) stride = row_size;
+    const GLsizeiptr size = (GLsizeiptr)(row_size * h);
+    const uint8_t use_ring = size <= UPLOAD_RING_SIZE;
+    uint8_t* mapping = NULL;
+    if (use_ring) {
+        if (!upload_ring) {
+            gl.GenBuffers(1, &upload_ring);
+            upload_ring_offset = UPLOAD_RING_SIZE;
+        }
+        gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_ring);
+        if (upload_ring_offset + size > UPLOAD_RING_SIZE) {
+            // the driver keeps the old storage until the GPU is done with it, so this never waits
+            gl.BufferData(GL_PIXEL_UNPACK_BUFFER, UPLOAD_RING_SIZE, NULL, GL_STREAM_DRAW);
+            upload_ring_offset = 0;
+        }
+        mapping = gl.MapBufferRange(GL_PIXEL_UNPACK_BUFFER, upload_ring_offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+
+    GLint row_length;
+    const void* source;
+    if (mapping) {
+        for (GLsizei i = 0; i < h; i += 1) memcpy(mapping + (i * row_size), (const uint8_t*)pixels + (i * stride), row_size);
+        gl.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        row_length = 0;
+        source = (const void*)(uintptr_t)upload_ring_offset;
+        upload_ring_offset += (size + 255) & ~(GLsizeiptr)255;
+    } else {
+        // too big for the ring, or it couldn't be mapped, so read straight out of the caller's memory
+        if (use_ring || c->bound_pixel_unpack_buffer) gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        row_length = (stride == row_size) ? 0 : (GLint)(stride / 4);
+        source = pixels;
+    }
+    if (row_length != c->unpack_row_length) lgl->PixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+    lgl->TexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, format, GL_UNSIGNED_BYTE, source);
+    if (row_length != c->unpack_row_length) lgl->PixelStorei(GL_UNPACK_ROW_LENGTH, c->unpack_row_length);
+    if (use_ring || c->bound_pixel_unpack_buffer) gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, c->bound_pixel_unpack_buffer);
 }
 
 static void _bolt_gl_plugin_surface_init(struct SurfaceFunctions* functions, unsigned int width, unsigned int height, const void* data) {
     struct PluginSurfaceUserdata* userdata = malloc(sizeof(struct PluginSurfaceUserdata));
     struct GLContext* c = _bolt_context();
-    userdata->width = width;
-    userdata->height = height;
-    _bolt_gl_surface_init_buffers(userdata);
+    userdata->imports = NULL;
+    _bolt_gl_surface_alloc(userdata, width, height);
     if (data) {
-        lgl->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        _bolt_gl_upload_rect(userdata->x, userdata->y, width, height, data, 0, GL_RGBA);
     } else {
-        lgl->ClearColor(0.0, 0.0, 0.0, 0.0);
-        lgl->Clear(GL_COLOR_BUFFER_BIT);
+        _bolt_gl_surface_clear_rect(userdata, 0.0, 0.0, 0.0, 0.0);
     }
     functions->userdata = userdata;
     functions->clear = _bolt_gl_plugin_surface_clear;
     functions->subimage = _bolt_gl_plugin_surface_subimage;
     functions->draw_to_screen = _bolt_gl_plugin_surface_drawtoscreen;
     functions->draw_to_surface = _bolt_gl_plugin_surface_drawtosurface;
+    functions->copy_shared_texture = _bolt_gl_plugin_surface_copy_shared_texture;
 
     const struct GLTexture2D* original_tex = c->texture_units[c->active_texture];
     lgl->BindTexture(GL_TEXTURE_2D, original_tex ? original_tex->id : 0);
@@ -1829,104 +3373,568 @@ static void _bolt_gl_plugin_surface_init(struct SurfaceFunctions* functions, uns
 
 static void _bolt_gl_plugin_surface_destroy(void* _userdata) {
     struct PluginSurfaceUserdata* userdata = _userdata;
-    _bolt_gl_surface_destroy_buffers(userdata);
+    _bolt_gl_flush_screen_draws();
+    _bolt_gl_surface_free_imports(userdata);
+    _bolt_gl_surface_free(userdata);
     free(userdata);
 }
 
 static void _bolt_gl_plugin_surface_resize(void* _userdata, unsigned int width, unsigned int height) {
     struct PluginSurfaceUserdata* userdata = _userdata;
-    _bolt_gl_surface_destroy_buffers(userdata);
-    userdata->width = width;
-    userdata->height = height;
-    _bolt_gl_surface_init_buffers(userdata);
-    lgl->ClearColor(0.0, 0.0, 0.0, 0.0);
-    lgl->Clear(GL_COLOR_BUFFER_BIT);
+    struct GLContext* c = _bolt_context();
+    _bolt_gl_flush_screen_draws();
+    if (_bolt_gl_surface_fits(userdata, width, height)) {
+        userdata->width = width;
+        userdata->height = height;
+    } else {
+        _bolt_gl_surface_free(userdata);
+        _bolt_gl_surface_alloc(userdata, width, height);
+        const struct GLTexture2D* original_tex = c->texture_units[c->active_texture];
+        lgl->BindTexture(GL_TEXTURE_2D, original_tex ? original_tex->id : 0);
+    }
+    _bolt_gl_surface_clear_rect(userdata, 0.0, 0.0, 0.0, 0.0);
+    gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, c->current_draw_framebuffer);
 }
 
 static void _bolt_gl_plugin_surface_clear(void* _userdata, double r, double g, double b, double a) {
     struct PluginSurfaceUserdata* userdata = _userdata;
     struct GLContext* c = _bolt_context();
-    gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, userdata->framebuffer);
-    lgl->ClearColor(r, g, b, a);
-    lgl->Clear(GL_COLOR_BUFFER_BIT);
+    _bolt_gl_flush_screen_draws();
+    _bolt_gl_surface_clear_rect(userdata, r, g, b, a);
     gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, c->current_draw_framebuffer);
 }
 
-static void _bolt_gl_plugin_surface_subimage(void* _userdata, int x, int y, int w, int h, const void* pixels, uint8_t is_bgra) {
+static void _bolt_gl_plugin_surface_subimage(void* _userdata, int x, int y, int w, int h, const void* pixels, size_t stride, uint8_t is_bgra) {
     struct PluginSurfaceUserdata* userdata = _userdata;
     struct GLContext* c = _bolt_context();
+    // anything outside the surface would be written into whatever's next to it in the texture
+    if (x < 0 || y < 0 || w < 0 || h < 0 || x + w > (int)userdata->width || y + h > (int)userdata->height) return;
+    _bolt_gl_flush_screen_draws();
     lgl->BindTexture(GL_TEXTURE_2D, userdata->renderbuffer);
-    lgl->TexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, is_bgra ? GL_BGRA : GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    _bolt_gl_upload_rect(userdata->x + x, userdata->y + y, w, h, pixels, stride, is_bgra ? GL_BGRA : GL_RGBA);
+    const struct GLTexture2D* original_tex = c->texture_units[c->active_texture];
+    lgl->BindTexture(GL_TEXTURE_2D, original_tex ? original_tex->id : 0);
+}
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#define EGL_EXTENSIONS 0x3055
+#define EGL_HEIGHT 0x3056
+#define EGL_WIDTH 0x3057
+#define EGL_NONE 0x3038
+#define EGL_LINUX_DMA_BUF_EXT 0x3270
+#define EGL_LINUX_DRM_FOURCC_EXT 0x3271
+#define DRM_FORMAT_MOD_INVALID 0x00FFFFFFFFFFFFFFull
+
+// checks for a whole word in a space-separated extension string
+static uint8_t _bolt_egl_has_extension(const char* extensions, const char* name) {
+    const size_t len = strlen(name);
+    for (const char* p = strstr(extensions, name); p; p = strstr(p + len, name)) {
+        if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0')) return 1;
+    }
+    return 0;
+}
+#endif
+
+static uint8_t _bolt_gl_plugin_shared_texture_supported() {
+#if defined(_WIN32)
+    // DXGI shared handles would need WGL_NV_DX_interop and a D3D11 device to open them on
+    return 0;
+#else
+    if (!egl.GetCurrentDisplay || !egl.QueryString || !egl.CreateImageKHR || !egl.DestroyImageKHR || !egl.EGLImageTargetTexture2DOES) return 0;
+    const char* extensions = egl.QueryString(egl.GetCurrentDisplay(), EGL_EXTENSIONS);
+    return extensions && _bolt_egl_has_extension(extensions, "EGL_EXT_image_dma_buf_import");
+#endif
+}
+
+// a dmabuf that's been imported as an EGLImage, along with the texture and framebuffer wrapping it. the browser
+// draws into the same few buffers over and over, so these are kept instead of being remade on every paint.
+// a buffer is recognised by the inode of its first plane's fd, which is the same for every fd that refers to it,
+// and the image holds a reference to the buffer, so the inode can't be reused while it's cached.
+#define SHARED_TEXTURE_IMPORT_COUNT 4
+struct SharedTextureImport {
+    uint64_t dev;
+    uint64_t ino; // 0 if this entry is unused
+    uint64_t modifier;
+    uint32_t format;
+    uint32_t plane_count;
+    int width;
+    int height;
+    uint32_t strides[SHARED_TEXTURE_MAX_PLANES];
+    uint64_t offsets[SHARED_TEXTURE_MAX_PLANES];
+    uint64_t last_used;
+    void* display;
+    void* image;
+    GLuint texture;
+    GLuint framebuffer;
+};
+
+#if defined(_WIN32)
+static void _bolt_gl_surface_free_imports(struct PluginSurfaceUserdata* userdata) {}
+
+static uint8_t _bolt_gl_plugin_surface_copy_shared_texture(void* _userdata, const struct SharedTexture* texture) {
+    return 0;
+}
+#else
+static uint64_t shared_texture_import_clock = 0;
+
+static void _bolt_gl_shared_texture_import_free(struct SharedTextureImport* import) {
+    if (!import->ino) return;
+    gl.DeleteFramebuffers(1, &import->framebuffer);
+    lgl->DeleteTextures(1, &import->texture);
+    egl.DestroyImageKHR(import->display, import->image);
+    import->ino = 0;
+}
+
+static void _bolt_gl_surface_free_imports(struct PluginSurfaceUserdata* userdata) {
+    if (!userdata->imports) return;
+    for (size_t i = 0; i < SHARED_TEXTURE_IMPORT_COUNT; i += 1) _bolt_gl_shared_texture_import_free(&userdata->imports[i]);
+    free(userdata->imports);
+    userdata->imports = NULL;
+}
+
+static uint8_t _bolt_gl_shared_texture_import_matches(const struct SharedTextureImport* import, const struct stat* st, const struct SharedTexture* texture) {
+    if (import->ino != (uint64_t)st->st_ino || import->dev != (uint64_t)st->st_dev) return 0;
+    if (import->modifier != texture->modifier || import->format != texture->format || import->plane_count != texture->plane_count) return 0;
+    if (import->width != texture->width || import->height != texture->height) return 0;
+    for (uint32_t i = 0; i < texture->plane_count; i += 1) {
+        if (import->strides[i] != texture->strides[i] || import->offsets[i] != texture->offsets[i]) return 0;
+    }
+    return 1;
+}
+
+// imports a dmabuf into `import`, which must be unused, leaving its framebuffer bound to GL_READ_FRAMEBUFFER.
+// returns 0 if EGL can't import it
+static uint8_t _bolt_gl_shared_texture_import(struct SharedTextureImport* import, const struct stat* st, const struct SharedTexture* texture) {
+    // per-plane fd, offset, pitch, modifier lo and modifier hi attributes, from EGL_EXT_image_dma_buf_import(_modifiers)
+    static const int32_t plane_attribs[SHARED_TEXTURE_MAX_PLANES][5] = {
+        {0x3272, 0x3273, 0x3274, 0x3443, 0x3444},
+        {0x3275, 0x3276, 0x3277, 0x3445, 0x3446},
+        {0x3278, 0x3279, 0x327A, 0x3447, 0x3448},
+        {0x3440, 0x3441, 0x3442, 0x3449, 0x344A},
+    };
+    int32_t attribs[7 + (SHARED_TEXTURE_MAX_PLANES * 10)];
+    size_t n = 0;
+    attribs[n++] = EGL_WIDTH;
+    attribs[n++] = texture->width;
+    attribs[n++] = EGL_HEIGHT;
+    attribs[n++] = texture->height;
+    attribs[n++] = EGL_LINUX_DRM_FOURCC_EXT;
+    attribs[n++] = (int32_t)texture->format;
+    for (uint32_t i = 0; i < texture->plane_count; i += 1) {
+        attribs[n++] = plane_attribs[i][0];
+        attribs[n++] = texture->fds[i];
+        attribs[n++] = plane_attribs[i][1];
+        attribs[n++] = (int32_t)texture->offsets[i];
+        attribs[n++] = plane_attribs[i][2];
+        attribs[n++] = (int32_t)texture->strides[i];
+        if (texture->modifier != DRM_FORMAT_MOD_INVALID) {
+            attribs[n++] = plane_attribs[i][3];
+            attribs[n++] = (int32_t)(texture->modifier & 0xFFFFFFFF);
+            attribs[n++] = plane_attribs[i][4];
+            attribs[n++] = (int32_t)(texture->modifier >> 32);
+        }
+    }
+    attribs[n++] = EGL_NONE;
+    void* display = egl.GetCurrentDisplay();
+    void* image = egl.CreateImageKHR(display, NULL, EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
+    if (!image) return 0;
+
+    // the image can't be attached to the surface's framebuffer itself, so wrap it in a texture
+    // and blit from that, which also takes care of any difference in format
+    lgl->GenTextures(1, &import->texture);
+    lgl->BindTexture(GL_TEXTURE_2D, import->texture);
+    egl.EGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+    gl.GenFramebuffers(1, &import->framebuffer);
+    gl.BindFramebuffer(GL_READ_FRAMEBUFFER, import->framebuffer);
+    gl.FramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, import->texture, 0);
+    import->dev = (uint64_t)st->st_dev;
+    import->ino = (uint64_t)st->st_ino;
+    import->modifier = texture->modifier;
+    import->format = texture->format;
+    import->plane_count = texture->plane_count;
+    import->width = texture->width;
+    import->height = texture->height;
+    memcpy(import->strides, texture->strides, sizeof(import->strides));
+    memcpy(import->offsets, texture->offsets, sizeof(import->offsets));
+    import->display = display;
+    import->image = image;
+    return 1;
+}
+
+static uint8_t _bolt_gl_plugin_surface_copy_shared_texture(void* _userdata, const struct SharedTexture* texture) {
+    struct PluginSurfaceUserdata* userdata = _userdata;
+    if (texture->plane_count == 0 || texture->plane_count > SHARED_TEXTURE_MAX_PLANES) return 0;
+    struct stat st;
+    if (fstat(texture->fds[0], &st) || !st.st_ino) return 0;
+    if (!userdata->imports) {
+        userdata->imports = calloc(SHARED_TEXTURE_IMPORT_COUNT, sizeof(*userdata->imports));
+        if (!userdata->imports) return 0;
+    }
+
+    // reuse the import for this buffer if there is one, otherwise replace whichever entry is unused or was used longest ago
+    struct GLContext* c = _bolt_context();
+    _bolt_gl_flush_screen_draws();
+    struct SharedTextureImport* import = NULL;
+    struct SharedTextureImport* oldest = &userdata->imports[0];
+    for (size_t i = 0; i < SHARED_TEXTURE_IMPORT_COUNT && !import; i += 1) {
+        struct SharedTextureImport* entry = &userdata->imports[i];
+        if (entry->ino && _bolt_gl_shared_texture_import_matches(entry, &st, texture)) import = entry;
+        else if (oldest->ino && (!entry->ino || entry->last_used < oldest->last_used)) oldest = entry;
+    }
+    if (import) {
+        gl.BindFramebuffer(GL_READ_FRAMEBUFFER, import->framebuffer);
+    } else {
+        _bolt_gl_shared_texture_import_free(oldest);
+        if (!_bolt_gl_shared_texture_import(oldest, &st, texture)) return 0;
+        import = oldest;
+    }
+    shared_texture_import_clock += 1;
+    import->last_used = shared_texture_import_clock;
+
+    gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, userdata->framebuffer);
+    const int w = texture->width < (int)userdata->width ? texture->width : (int)userdata->width;
+    const int h = texture->height < (int)userdata->height ? texture->height : (int)userdata->height;
+    gl.BlitFramebuffer(0, 0, w, h, userdata->x, userdata->y, userdata->x + w, userdata->y + h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    gl.BindFramebuffer(GL_READ_FRAMEBUFFER, c->current_read_framebuffer);
+    gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, c->current_draw_framebuffer);
     const struct GLTexture2D* original_tex = c->texture_units[c->active_texture];
     lgl->BindTexture(GL_TEXTURE_2D, original_tex ? original_tex->id : 0);
+    return 1;
 }
+#endif
 
 static void _bolt_gl_plugin_surface_drawtoscreen(void* _userdata, int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh) {
     struct PluginSurfaceUserdata* userdata = _userdata;
+    const int x0 = dw < 0 ? dx + dw : dx;
+    const int y0 = dh < 0 ? dy + dh : dy;
+    const int x1 = dw < 0 ? dx : dx + dw;
+    const int y1 = dh < 0 ? dy : dy + dh;
+
+    // look for the earliest group from the same texture that this can be added to without changing the result.
+    // surfaces sharing an atlas can go in the same group, since the source rectangle is converted to atlas space
+    size_t group = screen_draw_group_count;
+    for (size_t i = screen_draw_group_count; i > 0; i -= 1) {
+        const struct GLScreenDrawGroup* g = &screen_draw_groups[i - 1];
+        if (g->surface->renderbuffer == userdata->renderbuffer) {
+            group = i - 1;
+            break;
+        }
+        if (x0 < g->x1 && g->x0 < x1 && y0 < g->y1 && g->y0 < y1) break;
+    }
+    if (group == screen_draw_group_count) {
+        if (screen_draw_group_count == screen_draw_group_capacity) {
+            const size_t capacity = screen_draw_group_capacity ? screen_draw_group_capacity * 2 : 16;
+            struct GLScreenDrawGroup* groups = realloc(screen_draw_groups, capacity * sizeof(*groups));
+            if (!groups) return;
+            screen_draw_groups = groups;
+            screen_draw_group_capacity = capacity;
+        }
+        screen_draw_groups[group] = (struct GLScreenDrawGroup){.surface = userdata, .count = 0, .x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1};
+        screen_draw_group_count += 1;
+    }
+    if (screen_draw_count == screen_draw_capacity) {
+        const size_t capacity = screen_draw_capacity ? screen_draw_capacity * 2 : 64;
+        struct GLScreenDraw* draws = realloc(screen_draws, capacity * sizeof(*draws));
+        if (!draws) return;
+        screen_draws = draws;
+        screen_draw_capacity = capacity;
+    }
+    struct GLScreenDrawGroup* g = &screen_draw_groups[group];
+    if (x0 < g->x0) g->x0 = x0;
+    if (y0 < g->y0) g->y0 = y0;
+    if (x1 > g->x1) g->x1 = x1;
+    if (y1 > g->y1) g->y1 = y1;
+    g->count += 1;
+    screen_draws[screen_draw_count] = (struct GLScreenDraw){.d_xywh = {dx, dy, dw, dh}, .s_xywh = {userdata->x + sx, userdata->y + sy, sw, sh}, .group = group};
+    screen_draw_count += 1;
+}
+
+static void _bolt_gl_flush_screen_draws() {
+    if (!screen_draw_count) return;
     struct GLContext* c = _bolt_context();
+    const size_t instance_size = 8 * sizeof(GLint);
+    if (screen_draw_count > screen_draw_instance_capacity) {
+        GLint* instances = realloc(screen_draw_instances, screen_draw_count * instance_size);
+        if (!instances) {
+            screen_draw_count = 0;
+            screen_draw_group_count = 0;
+            return;
+        }
+        screen_draw_instances = instances;
+        screen_draw_instance_capacity = screen_draw_count;
+    }
+    size_t first = 0;
+    for (size_t i = 0; i < screen_draw_group_count; i += 1) {
+        screen_draw_groups[i].first = first;
+        first += screen_draw_groups[i].count;
+        screen_draw_groups[i].count = 0;
+    }
+    for (size_t i = 0; i < screen_draw_count; i += 1) {
+        struct GLScreenDrawGroup* g = &screen_draw_groups[screen_draws[i].group];
+        GLint* instance = screen_draw_instances + ((g->first + g->count) * 8);
+        memcpy(instance, screen_draws[i].d_xywh, sizeof(screen_draws[i].d_xywh));
+        memcpy(instance + 4, screen_draws[i].s_xywh, sizeof(screen_draws[i].s_xywh));
+        g->count += 1;
+    }
 
     gl.UseProgram(program_direct_screen);
-    lgl->BindTexture(GL_TEXTURE_2D, userdata->renderbuffer);
-    gl.BindVertexArray(program_direct_vao);
+    gl.BindVertexArray(program_direct_screen_vao);
     gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    gl.BindBuffer(GL_ARRAY_BUFFER, buffer_screen_draws);
+    gl.BufferData(GL_ARRAY_BUFFER, screen_draw_count * instance_size, screen_draw_instances, GL_STREAM_DRAW);
     gl.Uniform1i(program_direct_screen_sampler, c->active_texture);
-    gl.Uniform4i(program_direct_screen_d_xywh, dx, dy, dw, dh);
-    gl.Uniform4i(program_direct_screen_s_xywh, sx, sy, sw, sh);
-    gl.Uniform4i(program_direct_screen_src_wh_dest_wh, userdata->width, userdata->height, gl_width, gl_height);
     lgl->Viewport(0, 0, gl_width, gl_height);
-    lgl->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    for (size_t i = 0; i < screen_draw_group_count; i += 1) {
+        const struct GLScreenDrawGroup* g = &screen_draw_groups[i];
+        const uintptr_t offset = g->first * instance_size;
+        gl.VertexAttribIPointer(1, 4, GL_INT, instance_size, (const void*)offset);
+        gl.VertexAttribIPointer(2, 4, GL_INT, instance_size, (const void*)(offset + (4 * sizeof(GLint))));
+        lgl->BindTexture(GL_TEXTURE_2D, g->surface->renderbuffer);
+        gl.Uniform4i(program_direct_screen_src_wh_dest_wh, g->surface->tex_width, g->surface->tex_height, gl_width, gl_height);
+        gl.DrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, g->count);
+    }
+    screen_draw_count = 0;
+    screen_draw_group_count = 0;
 
     lgl->Viewport(c->viewport_x, c->viewport_y, c->viewport_w, c->viewport_h);
     const struct GLTexture2D* original_tex = c->texture_units[c->active_texture];
     lgl->BindTexture(GL_TEXTURE_2D, original_tex ? original_tex->id : 0);
+    gl.BindBuffer(GL_ARRAY_BUFFER, c->bound_array_buffer);
     gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, c->current_draw_framebuffer);
-    gl.BindVertexArray(c->bound_vao->id);
+    gl.BindVertexArray(c->bound_vao ? c->bound_vao->id : 0);
     gl.UseProgram(c->bound_program ? c->bound_program->id : 0);
 }
 
 static void _bolt_gl_plugin_surface_drawtosurface(void* _userdata, void* _target, int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh) {
-    struct PluginSurfaceUserdata* userdata = _userdata;
+    const struct PluginSurfaceUserdata* source = _userdata;
     struct PluginSurfaceUserdata* target = _target;
     struct GLContext* c = _bolt_context();
+    _bolt_gl_flush_screen_draws();
+
+    if (source->renderbuffer == target->renderbuffer) {
+        if (source->width > surface_draw_staging.width || source->height > surface_draw_staging.height) {
+            if (surface_draw_staging.framebuffer) _bolt_gl_surface_destroy_buffers(surface_draw_staging.framebuffer, surface_draw_staging.renderbuffer);
+            if (source->width > surface_draw_staging.width) surface_draw_staging.width = source->width;
+            if (source->height > surface_draw_staging.height) surface_draw_staging.height = source->height;
+            surface_draw_staging.tex_width = surface_draw_staging.width;
+            surface_draw_staging.tex_height = surface_draw_staging.height;
+            _bolt_gl_surface_init_buffers(&surface_draw_staging.framebuffer, &surface_draw_staging.renderbuffer, surface_draw_staging.width, surface_draw_staging.height);
+        }
+        gl.BindFramebuffer(GL_READ_FRAMEBUFFER, source->framebuffer);
+        gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, surface_draw_staging.framebuffer);
+        gl.BlitFramebuffer(source->x, source->y, source->x + source->width, source->y + source->height, 0, 0, source->width, source->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        gl.BindFramebuffer(GL_READ_FRAMEBUFFER, c->current_read_framebuffer);
+        source = &surface_draw_staging;
+    }
 
+    // the viewport keeps everything inside the target's own rectangle, so the destination is still in surface space
     gl.UseProgram(program_direct_surface);
-    lgl->BindTexture(GL_TEXTURE_2D, userdata->renderbuffer);
+    lgl->BindTexture(GL_TEXTURE_2D, source->renderbuffer);
     gl.BindVertexArray(program_direct_vao);
     gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, target->framebuffer);
     gl.Uniform1i(program_direct_surface_sampler, c->active_texture);
     gl.Uniform4i(program_direct_surface_d_xywh, dx, dy, dw, dh);
-    gl.Uniform4i(program_direct_surface_s_xywh, sx, sy, sw, sh);
-    gl.Uniform4i(program_direct_surface_src_wh_dest_wh, userdata->width, userdata->height, target->width, target->height);
-    lgl->Viewport(0, 0, target->width, target->height);
+    gl.Uniform4i(program_direct_surface_s_xywh, source->x + sx, source->y + sy, sw, sh);
+    gl.Uniform4i(program_direct_surface_src_wh_dest_wh, source->tex_width, source->tex_height, target->width, target->height);
+    lgl->Viewport(target->x, target->y, target->width, target->height);
     lgl->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
     lgl->Viewport(c->viewport_x, c->viewport_y, c->viewport_w, c->viewport_h);
     const struct GLTexture2D* original_tex = c->texture_units[c->active_texture];
     lgl->BindTexture(GL_TEXTURE_2D, original_tex ? original_tex->id : 0);
     gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, c->current_draw_framebuffer);
-    gl.BindVertexArray(c->bound_vao->id);
+    gl.BindVertexArray(c->bound_vao ? c->bound_vao->id : 0);
     gl.UseProgram(c->bound_program ? c->bound_program->id : 0);
 }
 
 static void _bolt_gl_plugin_draw_region_outline(void* userdata, int16_t x, int16_t y, uint16_t width, uint16_t height) {
     struct PluginSurfaceUserdata* target = userdata;
     struct GLContext* c = _bolt_context();
+    _bolt_gl_flush_screen_draws();
     gl.UseProgram(program_region);
     gl.BindVertexArray(program_direct_vao);
     gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, target->framebuffer);
-    lgl->Viewport(0, 0, gl_width, gl_height);
+    lgl->Viewport(target->x, target->y, gl_width, gl_height);
     gl.Uniform4i(program_region_xywh, x, y, width, height);
     gl.Uniform2i(program_region_dest_wh, gl_width, gl_height);
     lgl->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
     lgl->Viewport(c->viewport_x, c->viewport_y, c->viewport_w, c->viewport_h);
     gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, c->current_draw_framebuffer);
-    gl.BindVertexArray(c->bound_vao->id);
+    gl.BindVertexArray(c->bound_vao ? c->bound_vao->id : 0);
     gl.UseProgram(c->bound_program ? c->bound_program->id : 0);
 }
 
-static void _bolt_gl_plugin_read_screen_pixels(uint32_t width, uint32_t height, void* data) {
-    lgl->ReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, data);
+static void _bolt_capture_buffer_pop() {
+    struct GLCaptureBuffer* capture = &capture_buffers[capture_buffer_first];
+    gl.DeleteSync(capture->fence);
+    capture->fence = NULL;
+    capture_buffer_first = (capture_buffer_first + 1) % CAPTURE_BUFFER_COUNT;
+    capture_buffer_count -= 1;
+}
+
+static uint8_t _bolt_capture_buffer_is_done(const struct GLCaptureBuffer* capture) {
+    const GLenum status = gl.ClientWaitSync(capture->fence, 0, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+}
+
+static uint8_t _bolt_capture_buffer_matches(const struct GLCaptureBuffer* capture, const struct CaptureRegion* regions, size_t count) {
+    return capture->region_count == count && !memcmp(capture->regions, regions, count * sizeof(*regions));
+}
+
+static uint8_t _bolt_gl_plugin_read_screen_pixels_start(const struct CaptureRegion* regions, size_t count) {
+    if (capture_buffer_count == CAPTURE_BUFFER_COUNT || count == 0) return false;
+    struct GLContext* c = _bolt_context();
+    // captures have to include everything that's been drawn to the screen so far
+    _bolt_gl_flush_screen_draws();
+    struct GLCaptureBuffer* capture = &capture_buffers[(capture_buffer_first + capture_buffer_count) % CAPTURE_BUFFER_COUNT];
+    if (count > capture->region_capacity) {
+        free(capture->regions);
+        capture->regions = malloc(count * sizeof(*regions));
+        capture->region_capacity = count;
+    }
+    memcpy(capture->regions, regions, count * sizeof(*regions));
+    capture->region_count = count;
+
+    // work out how big the pixel buffer and the staging surface need to be for these regions
+    size_t buffer_size = 0;
+    unsigned int staging_width = 0;
+    unsigned int staging_height = 0;
+    unsigned int resolve_width = 0;
+    unsigned int resolve_height = 0;
+    for (size_t i = 0; i < count; i += 1) {
+        const int width = regions[i].width / regions[i].scale;
+        const int height = regions[i].height / regions[i].scale;
+        buffer_size += (size_t)width * height * 3;
+        if (regions[i].scale > 1) {
+            if (width > staging_width) staging_width = width;
+            staging_height += height;
+            if (regions[i].width > resolve_width) resolve_width = regions[i].width;
+            if (regions[i].height > resolve_height) resolve_height = regions[i].height;
+        }
+    }
+    if (!default_framebuffer_multisampled) {
+        resolve_width = 0;
+        resolve_height = 0;
+    }
+    uint8_t rebind_texture = false;
+    if (staging_width > capture_staging.width || staging_height > capture_staging.height) {
+        if (capture_staging.framebuffer) _bolt_gl_surface_destroy_buffers(capture_staging.framebuffer, capture_staging.renderbuffer);
+        if (staging_width > capture_staging.width) capture_staging.width = staging_width;
+        if (staging_height > capture_staging.height) capture_staging.height = staging_height;
+        _bolt_gl_surface_init_buffers(&capture_staging.framebuffer, &capture_staging.renderbuffer, capture_staging.width, capture_staging.height);
+        rebind_texture = true;
+    }
+    if (resolve_width > capture_resolve.width || resolve_height > capture_resolve.height) {
+        if (capture_resolve.framebuffer) _bolt_gl_surface_destroy_buffers(capture_resolve.framebuffer, capture_resolve.renderbuffer);
+        if (resolve_width > capture_resolve.width) capture_resolve.width = resolve_width;
+        if (resolve_height > capture_resolve.height) capture_resolve.height = resolve_height;
+        _bolt_gl_surface_init_buffers(&capture_resolve.framebuffer, &capture_resolve.renderbuffer, capture_resolve.width, capture_resolve.height);
+        rebind_texture = true;
+    }
+    if (rebind_texture) {
+        const struct GLTexture2D* original_tex = c->texture_units[c->active_texture];
+        lgl->BindTexture(GL_TEXTURE_2D, original_tex ? original_tex->id : 0);
+    }
+
+    // do all the scaling with one blit per region, then read everything into the same pixel buffer
+    gl.BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    if (staging_height) {
+        // blits are clipped by the scissor test, which the game may have left on for a smaller area
+        const GLboolean scissor_test = lgl->IsEnabled(GL_SCISSOR_TEST);
+        if (scissor_test) lgl->Disable(GL_SCISSOR_TEST);
+        gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, capture_staging.framebuffer);
+        int staging_y = 0;
+        for (size_t i = 0; i < count; i += 1) {
+            const struct CaptureRegion* region = &regions[i];
+            if (region->scale <= 1) continue;
+            const int width = region->width / region->scale;
+            const int height = region->height / region->scale;
+            if (default_framebuffer_multisampled) {
+                gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, capture_resolve.framebuffer);
+                gl.BlitFramebuffer(region->x, region->y, region->x + region->width, region->y + region->height, 0, 0, region->width, region->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                gl.BindFramebuffer(GL_READ_FRAMEBUFFER, capture_resolve.framebuffer);
+                gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, capture_staging.framebuffer);
+                gl.BlitFramebuffer(0, 0, region->width, region->height, 0, staging_y, width, staging_y + height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                gl.BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            } else {
+                gl.BlitFramebuffer(region->x, region->y, region->x + region->width, region->y + region->height, 0, staging_y, width, staging_y + height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            }
+            staging_y += height;
+        }
+        gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, c->current_draw_framebuffer);
+        if (scissor_test) lgl->Enable(GL_SCISSOR_TEST);
+    }
+    if (!capture->buffer) gl.GenBuffers(1, &capture->buffer);
+    gl.BindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffer);
+    if (buffer_size > capture->buffer_size) {
+        gl.BufferData(GL_PIXEL_PACK_BUFFER, buffer_size, NULL, GL_STREAM_READ);
+        capture->buffer_size = buffer_size;
+    }
+    // read with no row padding, so that each region's rows are contiguous in the buffer
+    if (c->pack_alignment != 1) lgl->PixelStorei(GL_PACK_ALIGNMENT, 1);
+    size_t offset = 0;
+    int staging_y = 0;
+    GLuint read_framebuffer = 0;
+    for (size_t i = 0; i < count; i += 1) {
+        const struct CaptureRegion* region = &regions[i];
+        const int width = region->width / region->scale;
+        const int height = region->height / region->scale;
+        const GLuint framebuffer = region->scale > 1 ? capture_staging.framebuffer : 0;
+        if (framebuffer != read_framebuffer) {
+            gl.BindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+            read_framebuffer = framebuffer;
+        }
+        if (region->scale > 1) {
+            lgl->ReadPixels(0, staging_y, width, height, GL_RGB, GL_UNSIGNED_BYTE, (void*)offset);
+            staging_y += height;
+        } else {
+            lgl->ReadPixels(region->x, region->y, width, height, GL_RGB, GL_UNSIGNED_BYTE, (void*)offset);
+        }
+        offset += (size_t)width * height * 3;
+    }
+    if (c->pack_alignment != 1) lgl->PixelStorei(GL_PACK_ALIGNMENT, c->pack_alignment);
+    gl.BindBuffer(GL_PIXEL_PACK_BUFFER, c->bound_pixel_pack_buffer);
+    gl.BindFramebuffer(GL_READ_FRAMEBUFFER, c->current_read_framebuffer);
+    capture->fence = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    capture_buffer_count += 1;
+    return true;
+}
+
+static uint8_t _bolt_gl_plugin_read_screen_pixels_finish(const struct CaptureRegion* regions, size_t count, void* data) {
+    if (!data) {
+        while (capture_buffer_count) _bolt_capture_buffer_pop();
+        return false;
+    }
+
+    // skip over any reads that are for different regions or have been superseded by a newer finished one
+    while (capture_buffer_count) {
+        const struct GLCaptureBuffer* capture = &capture_buffers[capture_buffer_first];
+        if (!_bolt_capture_buffer_matches(capture, regions, count)) {
+            _bolt_capture_buffer_pop();
+            continue;
+        }
+        if (capture_buffer_count == 1) break;
+        const struct GLCaptureBuffer* next = &capture_buffers[(capture_buffer_first + 1) % CAPTURE_BUFFER_COUNT];
+        if (!_bolt_capture_buffer_matches(next, regions, count) || !_bolt_capture_buffer_is_done(next)) break;
+        _bolt_capture_buffer_pop();
+    }
+    if (!capture_buffer_count || !_bolt_capture_buffer_is_done(&capture_buffers[capture_buffer_first])) return false;
+
+    struct GLContext* c = _bolt_context();
+    const struct GLCaptureBuffer* capture = &capture_buffers[capture_buffer_first];
+    size_t size = 0;
+    for (size_t i = 0; i < count; i += 1) size += (size_t)(regions[i].width / regions[i].scale) * (regions[i].height / regions[i].scale) * 3;
+    gl.BindBuffer(GL_PIXEL_PACK_BUFFER, capture->buffer);
+    const void* pixels = gl.MapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels) {
+        memcpy(data, pixels, size);
+        gl.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    gl.BindBuffer(GL_PIXEL_PACK_BUFFER, c->bound_pixel_pack_buffer);
+    _bolt_capture_buffer_pop();
+    return pixels != NULL;
 }
 
 static void _bolt_gl_plugin_game_view_rect(int* x, int* y, int* w, int* h) {
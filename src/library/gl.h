@@ -5,6 +5,7 @@
 
 #include "../../modules/hashmap/hashmap.h"
 #include "rwlock/rwlock.h"
+#include "attr.h"
 struct hashmap;
 struct SurfaceFunctions;
 
@@ -29,6 +30,8 @@ typedef void GLvoid;
 typedef char GLchar;
 typedef intptr_t GLintptr;
 typedef uintptr_t GLsizeiptr;
+typedef uint64_t GLuint64;
+typedef struct __GLsync* GLsync;
 
 /// Struct representing all the OpenGL functions of interest to us that the game gets from GetProcAddress
 struct GLProcFunctions {
@@ -36,12 +39,15 @@ struct GLProcFunctions {
     void (*AttachShader)(GLuint, GLuint);
     void (*BindAttribLocation)(GLuint, GLuint, const GLchar*);
     void (*BindBuffer)(GLenum, GLuint);
+    void (*BindBufferBase)(GLenum, GLuint, GLuint);
+    void (*BindBufferRange)(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr);
     void (*BindFramebuffer)(GLenum, GLuint);
     void (*BindVertexArray)(GLuint);
     void (*BlitFramebuffer)(GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLbitfield, GLenum);
     void (*BufferData)(GLenum, GLsizeiptr, const void*, GLenum);
     void (*BufferStorage)(GLenum, GLsizeiptr, const void*, GLbitfield);
     void (*BufferSubData)(GLenum, GLintptr, GLsizeiptr, const void*);
+    GLenum (*ClientWaitSync)(GLsync, GLbitfield, GLuint64);
     void (*CompileShader)(GLuint);
     void (*CompressedTexSubImage2D)(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLsizei, const void*);
     void (*CopyImageSubData)(GLuint, GLenum, GLint, GLint, GLint, GLint, GLuint, GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei);
@@ -51,12 +57,17 @@ struct GLProcFunctions {
     void (*DeleteFramebuffers)(GLsizei, const GLuint*);
     void (*DeleteProgram)(GLuint);
     void (*DeleteShader)(GLuint);
+    void (*DeleteSync)(GLsync);
     void (*DeleteVertexArrays)(GLsizei, const GLuint*);
     void (*DisableVertexAttribArray)(GLuint);
+    void (*DrawArraysInstanced)(GLenum, GLint, GLsizei, GLsizei);
     void (*DrawElements)(GLenum, GLsizei, GLenum, const void*);
     void (*EnableVertexAttribArray)(GLuint);
+    GLsync (*FenceSync)(GLenum, GLbitfield);
     void (*FlushMappedBufferRange)(GLenum, GLintptr, GLsizeiptr);
+    void (*FramebufferRenderbuffer)(GLenum, GLenum, GLenum, GLuint);
     void (*FramebufferTexture)(GLenum, GLenum, GLuint, GLint);
+    void (*FramebufferTexture2D)(GLenum, GLenum, GLenum, GLuint, GLint);
     void (*FramebufferTextureLayer)(GLenum, GLenum, GLuint, GLint, GLint);
     void (*GenBuffers)(GLsizei, GLuint*);
     void (*GenFramebuffers)(GLsizei, GLuint*);
@@ -77,11 +88,17 @@ struct GLProcFunctions {
     void (*ShaderSource)(GLuint, GLsizei, const GLchar**, const GLint*);
     void (*TexStorage2D)(GLenum, GLsizei, GLenum, GLsizei, GLsizei);
     void (*Uniform1i)(GLint, GLint);
+    void (*Uniform1iv)(GLint, GLsizei, const GLint*);
     void (*Uniform2i)(GLint, GLint, GLint);
+    void (*Uniform4f)(GLint, GLfloat, GLfloat, GLfloat, GLfloat);
+    void (*Uniform4fv)(GLint, GLsizei, const GLfloat*);
     void (*Uniform4i)(GLint, GLint, GLint, GLint, GLint);
+    void (*UniformBlockBinding)(GLuint, GLuint, GLuint);
     void (*UniformMatrix4fv)(GLint, GLsizei, GLboolean, const GLfloat*);
     GLboolean (*UnmapBuffer)(GLenum);
     void (*UseProgram)(GLuint);
+    void (*VertexAttribDivisor)(GLuint, GLuint);
+    void (*VertexAttribIPointer)(GLuint, GLint, GLenum, GLsizei, const void*);
     void (*VertexAttribPointer)(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*);
 };
 
@@ -91,11 +108,15 @@ struct GLLibFunctions {
     void (*Clear)(GLbitfield);
     void (*ClearColor)(GLfloat, GLfloat, GLfloat, GLfloat);
     void (*DeleteTextures)(GLsizei, const GLuint*);
+    void (*Disable)(GLenum);
     void (*DrawArrays)(GLenum, GLint, GLsizei);
     void (*DrawElements)(GLenum, GLsizei, GLenum, const void*);
+    void (*Enable)(GLenum);
     void (*Flush)(void);
     void (*GenTextures)(GLsizei, GLuint*);
     GLenum (*GetError)(void);
+    GLboolean (*IsEnabled)(GLenum);
+    void (*PixelStorei)(GLenum, GLint);
     void (*ReadPixels)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void*);
     void (*TexParameteri)(GLenum, GLenum, GLfloat);
     void (*TexSubImage2D)(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void*);
@@ -136,6 +157,8 @@ struct GLLibFunctions {
 #define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 35919
 #define GL_ACTIVE_TEXTURE 34016
 #define GL_STATIC_DRAW 35044
+#define GL_STREAM_DRAW 35040
+#define GL_STREAM_READ 35041
 #define GL_FRAGMENT_SHADER 35632
 #define GL_VERTEX_SHADER 35633
 #define GL_FRAMEBUFFER 36160
@@ -144,37 +167,77 @@ struct GLLibFunctions {
 #define GL_ARRAY_BUFFER 34962
 #define GL_ELEMENT_ARRAY_BUFFER 34963
 #define GL_UNIFORM_BUFFER 35345
+#define GL_PIXEL_PACK_BUFFER 35051
+#define GL_PIXEL_UNPACK_BUFFER 35052
+#define GL_UNPACK_ROW_LENGTH 3314
+#define GL_PACK_ALIGNMENT 3333
+#define GL_SCISSOR_TEST 3089
+#define GL_MAP_INVALIDATE_RANGE_BIT 4
+#define GL_MAP_UNSYNCHRONIZED_BIT 32
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 37143
+#define GL_ALREADY_SIGNALED 37146
+#define GL_CONDITION_SATISFIED 37148
 #define GL_VERTEX_ARRAY_BINDING 34229
 #define GL_ARRAY_BUFFER_BINDING 34964
 #define GL_ELEMENT_ARRAY_BUFFER_BINDING 34965
 #define GL_UNIFORM_BUFFER_BINDING 35368
+#define GL_UNIFORM_BUFFER_START 35369
+#define GL_UNIFORM_SIZE 35384
 #define GL_UNIFORM_OFFSET 35387
 #define GL_UNIFORM_BLOCK_BINDING 35391
 #define GL_TEXTURE0 33984
 #define GL_COLOR_ATTACHMENT0 36064
 #define GL_NEAREST 9728
+#define GL_LINEAR 9729
 #define GL_COLOR_BUFFER_BIT 16384
 #define GL_RGBA8 32856
 #define GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE 36048
 #define GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME 36049
+#define GL_READ_FRAMEBUFFER_BINDING 36010
+#define GL_DRAW_FRAMEBUFFER_BINDING 36006
 #define GL_MAX_VERTEX_ATTRIBS 34921
+#define GL_SAMPLE_BUFFERS 32936
 
 /* bolt re-implementation of some gl objects, storing only the things we need */
 
 struct GLArrayBuffer {
     GLuint id;
+    // CPU copy of the buffer's contents, filled in by the upload hooks. NULL if nothing has been uploaded
+    // to the buffer from the CPU since its storage was created; see _bolt_buffer_shadow.
     void* data;
+    GLsizeiptr size;
     uint8_t* mapping;
     GLintptr mapping_offset;
     GLsizeiptr mapping_len;
     GLbitfield mapping_access_type;
 };
 
+/// Cached hashes for one rectangle of a texture, usually one image in an atlas. Hashes are taken
+/// over the texture's data exactly as we store it, i.e. RGBA pixels, or S3TC blocks for compressed
+/// textures, so they're only comparable between textures using the same storage format.
+struct GLTextureRegionHash {
+    GLint x;
+    GLint y;
+    GLsizei width;
+    GLsizei height;
+    uint64_t hash;
+    uint64_t phash; // perceptual hash, only valid if has_phash is nonzero
+    uint8_t has_phash;
+};
+
 struct GLTexture2D {
     GLuint id;
-    uint8_t* data;
+    uint8_t* data; // RGBA mirror; for compressed textures this is decoded on demand and may be NULL
     GLsizei width;
     GLsizei height;
+    uint8_t* compressed; // raw S3TC blocks, or NULL if this texture doesn't have compressed storage
+    GLenum compressed_format;
+    uint8_t* dirty_rows; // one per row of blocks, nonzero if the mirror is out of date for that row
+    struct BoltSHM* mirror_shm; // if not NULL, `data` is a read-only view of this shared texture cache object
+    struct GLTexture2D* mirror_lru_prev; // neighbours in the list of compressed textures that have a mirror, see texture_mirror_lock
+    struct GLTexture2D* mirror_lru_next;
+    struct GLShareGroup* share_group; // the group this texture was generated in, see _bolt_texture_mirror_evict
+    struct hashmap* region_hashes; // GLTextureRegionHash keyed by x and y, or NULL if there aren't any yet
     double minimap_center_x;
     double minimap_center_y;
     uint8_t is_minimap_tex_big;
@@ -208,8 +271,28 @@ struct GLProgram {
     uint8_t is_minimap;
     uint8_t is_2d;
     uint8_t is_3d;
+
+    // shadow copies of the uniform values we read during draw calls, kept up to date by the glUniform*
+    // hooks so that we never have to ask the driver for them. reset to 0 whenever the program is linked.
+    GLint uDiffuseMap;
+    GLint uTextureAtlas;
+    GLint uTextureAtlasSettings;
+    GLint sSceneHDRTex;
+    GLint sSourceTex;
+    GLfloat uProjectionMatrix[16];
+    GLfloat uModelMatrix[16];
+    GLfloat uAtlasMeta[4];
+    GLfloat* uBoneTransforms; // 12 floats per bone, or NULL if the program has no bone palette
+    GLsizei bone_count; // how many bones uBoneTransforms is declared with, as of the last link
+    GLuint ubo_binding_ViewTransforms;
 };
 
+/// Converts `num_out` elements of a vertex attribute, starting at `ptr`, to floats.
+typedef void (*GLAttrDecodeFunction)(const uint8_t* ptr, size_t num_out, float* out);
+
+/// Converts `num_out` elements of a vertex attribute, starting at `ptr`, to ints.
+typedef void (*GLAttrDecodeIntFunction)(const uint8_t* ptr, size_t num_out, int32_t* out);
+
 struct GLAttrBinding {
     struct GLArrayBuffer* buffer;
     uintptr_t offset;
@@ -218,34 +301,85 @@ struct GLAttrBinding {
     uint32_t type;
     uint8_t normalise;
     uint8_t enabled;
+    // picked by _bolt_set_attr_binding based on type and normalise. decode_int is NULL if the
+    // attribute can't be read as ints, and decode_range is NULL if there's no range decoder in
+    // attr.h for its format, in which case ranges get decoded one vertex at a time with decode.
+    GLAttrDecodeFunction decode;
+    GLAttrDecodeIntFunction decode_int;
+    BoltAttrDecodeRange decode_range;
 };
 
 struct GLVertexArray {
     GLuint id;
     struct GLAttrBinding* attributes;
+    GLuint element_array_buffer;
 };
 
-struct HashMap {
-    struct hashmap* map;
+struct GLFramebuffer {
+    GLuint id;
+    GLuint colour_attachment0;
+};
+
+/// An indexed buffer binding point, as set by glBindBufferBase or glBindBufferRange
+struct GLIndexedBinding {
+    GLuint buffer;
+    GLintptr offset;
+};
+
+/// One array of GLObjectTable slots. When the table grows, a bigger copy replaces this one, which
+/// is kept in the `previous` chain until the table is destroyed, since readers may still be using it.
+struct GLObjectSlots {
+    size_t capacity;
+    struct GLObjectSlots* previous;
+    void* items[];
+};
+
+/// Maps GL object names to our own objects, all of which start with a GLuint `id`. GL names are small
+/// integers handed out more or less incrementally, so most of them are stored directly in `slots`
+/// at the index of their name, with any names too big for that falling back to `sparse`.
+///
+/// Looking up a name in `slots` doesn't need a lock: the slots pointer and each item are only ever
+/// read and written atomically, and old arrays are never freed while the table exists. `rwlock`
+/// must be held for writing when making any changes, and for reading when iterating or looking
+/// anything up in `sparse`.
+struct GLObjectTable {
+    struct GLObjectSlots* slots;
+    struct hashmap* sparse;
     RWLock rwlock;
 };
 
+/// The objects shared by a group of contexts. A context created with a shared context joins that
+/// context's group, so every context in a chain of shares ends up in the same one, and the group is
+/// freed along with whichever of its contexts is destroyed last.
+struct GLShareGroup {
+    struct GLObjectTable programs;
+    struct GLObjectTable buffers;
+    struct GLObjectTable textures;
+    struct GLObjectTable vaos;
+    size_t context_count;
+};
+
 /// Context-specific information - this is thread-specific on EGL, not sure about elsewhere
-/// this method of context-sharing takes advantage of the fact that the game never chains shares together
-/// with a depth greater than 1, and always deletes the non-owner before the owner. neither of those things
-/// are actually safe assumptions in valid OpenGL usage.
 struct GLContext {
-    uintptr_t id;
-    struct HashMap* programs;
-    struct HashMap* buffers;
-    struct HashMap* textures;
-    struct HashMap* vaos;
+    uintptr_t id; // must be the first member, see _bolt_context_map_hash
+    struct GLShareGroup* share_group;
+    struct GLObjectTable* framebuffers;
     struct GLTexture2D** texture_units;
+    struct GLIndexedBinding* uniform_buffer_bindings;
     struct GLProgram* bound_program;
     struct GLVertexArray* bound_vao;
     GLenum active_texture;
+    GLuint bound_array_buffer;
+    GLuint bound_uniform_buffer;
+    GLuint bound_pixel_pack_buffer;
+    GLuint bound_pixel_unpack_buffer;
+    GLint unpack_row_length;
+    GLint pack_alignment;
+    GLuint default_element_array_buffer; // element array binding while no VAO is bound
     GLuint current_draw_framebuffer;
     GLuint current_read_framebuffer;
+    struct GLFramebuffer* draw_framebuffer;
+    struct GLFramebuffer* read_framebuffer;
     GLuint game_view_part_framebuffer;
     GLint game_view_sSourceTex;
     GLint game_view_sSceneHDRTex;
@@ -257,7 +391,6 @@ struct GLContext {
     GLint game_view_h;
     uint8_t is_attached;
     uint8_t deferred_destroy;
-    uint8_t is_shared_owner;
     uint8_t recalculate_sSceneHDRTex;
     uint8_t does_blit_3d_target;
     uint8_t depth_of_field_enabled;
@@ -320,11 +453,14 @@ void _bolt_gl_onClear(GLbitfield);
 /// Call this in response to glViewport, which needs to be hooked from libgl.
 void _bolt_gl_onViewport(GLint, GLint, GLsizei, GLsizei);
 
+/// Call this in response to glPixelStorei, which needs to be hooked from libgl.
+void _bolt_gl_onPixelStorei(GLenum, GLint);
+
 /* plugin library interop stuff */
 
 struct GLPluginDrawElementsVertex2DUserData {
     struct GLContext* c;
-    unsigned short* indices;
+    const unsigned short* indices;
     struct GLTexture2D* atlas;
     struct GLAttrBinding* position;
     struct GLAttrBinding* atlas_min;
@@ -335,7 +471,7 @@ struct GLPluginDrawElementsVertex2DUserData {
 
 struct GLPluginDrawElementsVertex3DUserData {
     struct GLContext* c;
-    unsigned short* indices;
+    const unsigned short* indices;
     int atlas_scale;
     struct GLTexture2D* atlas;
     struct GLTexture2D* settings_atlas;
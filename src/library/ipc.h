@@ -35,13 +35,17 @@ enum BoltIPCMessageTypeToHost {
     IPC_MSG_OSRPLUGINMESSAGE,
     IPC_MSG_CAPTURENOTIFY_EXTERNAL,
     IPC_MSG_CAPTURENOTIFY_OSR,
+    IPC_MSG_RINGSTART, // no header; last message the client sends on the socket before switching to its ring
+    IPC_MSG_PLUGINSTATS,
+    IPC_MSG_TEXCACHE_PUBLISHED,
+    IPC_MSG_FRAMETRACEDATA,
 };
 
 enum BoltIPCMessageTypeToClient {
     IPC_MSG_STARTPLUGIN,
     IPC_MSG_HOST_STOPPED_PLUGIN,
     IPC_MSG_OSRUPDATE,
-    IPC_MSG_OSRPOPUPCONTENTS,
+    IPC_MSG_OSRPOPUPUPDATE,
     IPC_MSG_OSRPOPUPPOSITION,
     IPC_MSG_OSRPOPUPVISIBILITY,
     IPC_MSG_EXTERNALBROWSERMESSAGE,
@@ -52,11 +56,18 @@ enum BoltIPCMessageTypeToClient {
     IPC_MSG_OSRCLOSEREQUEST,
     IPC_MSG_EXTERNALCAPTUREDONE,
     IPC_MSG_OSRCAPTUREDONE,
+    IPC_MSG_RINGACCEPT, // no header; last message the host sends on the socket before switching to its ring
+    IPC_MSG_OSRACCELERATEDPAINT,
+    IPC_MSG_TEXCACHE,
+    IPC_MSG_FRAMETRACE,
 };
 
 /// Header for BoltIPCMessageTypeToHost::IPC_MSG_IDENTIFY
 struct BoltIPCIdentifyHeader {
     uint8_t name_length;
+    int pid;
+    uint32_t ring_capacity; // if non-zero, the client has created a shm pair of rings with this capacity each
+    uint8_t shared_textures; // if non-zero, the client can import IPC_MSG_OSRACCELERATEDPAINT frames
 };
 
 /// Header for BoltIPCMessageTypeToHost::IPC_MSG_CLIENT_STOPPED_PLUGINS
@@ -84,6 +95,8 @@ struct BoltIPCCloseBrowserHeader {
 struct BoltIPCOsrUpdateAckHeader {
     uint64_t plugin_id;
     uint64_t window_id;
+    uint64_t generation; // copied from the BoltIPCOsrUpdateHeader or BoltIPCOsrPopupUpdateHeader being acked
+    uint8_t is_popup; // true if acking an IPC_MSG_OSRPOPUPUPDATE
 };
 
 /// Header for BoltIPCMessageTypeToHost::IPC_MSG_EV*
@@ -99,17 +112,88 @@ struct BoltIPCPluginMessageHeader {
     size_t message_size;
 };
 
+/// Plugin callback types that timing stats are kept for, see IPC_MSG_PLUGINSTATS
+enum BoltIPCPluginStat {
+    IPC_PLUGINSTAT_SWAPBUFFERS,
+    IPC_PLUGINSTAT_BATCH2D,
+    IPC_PLUGINSTAT_RENDER3D,
+    IPC_PLUGINSTAT_MINIMAP,
+    IPC_PLUGINSTAT_MOUSEMOTION,
+    IPC_PLUGINSTAT_MOUSEBUTTON,
+    IPC_PLUGINSTAT_MOUSEBUTTONUP,
+    IPC_PLUGINSTAT_SCROLL,
+    IPC_PLUGINSTAT_COUNT,
+};
+
+/// Header for BoltIPCMessageTypeToHost::IPC_MSG_PLUGINSTATS, which the client sends roughly once
+/// per interval_micros. Followed by `plugin_count` BoltIPCPluginStats structs, one for each plugin
+/// that's currently running. All numbers are for that interval only, not totals since starting.
+struct BoltIPCPluginStatsHeader {
+    uint32_t plugin_count;
+    uint64_t interval_micros;
+};
+
+/// Timing of all the calls to one type of plugin callback
+struct BoltIPCPluginCallbackStats {
+    uint64_t calls;
+    uint64_t total_micros;
+    uint64_t max_micros;
+};
+
+/// Struct following BoltIPCPluginStatsHeader
+struct BoltIPCPluginStats {
+    uint64_t plugin_id;
+    uint64_t budget_micros; // 0 if the plugin has no frame budget
+    uint32_t frames_over_budget;
+    uint32_t frames_throttled;
+    struct BoltIPCPluginCallbackStats callbacks[IPC_PLUGINSTAT_COUNT];
+};
+
 /// Header for BoltMessageTypeToHost::IPC_MSG_CAPTURENOTIFY_*
 struct BoltIPCCaptureNotifyHeader {
     uint64_t plugin_id;
     uint64_t window_id;
     uint64_t pid;
     uint64_t capture_id;
+    uint64_t offset; // where this window's image starts in the shared memory
+    uint64_t shm_size;
     uint32_t width;
     uint32_t height;
+    uint32_t dirty_tiles_size; // length of the dirty-tile bitmap after this header, or 0 if the whole image is being sent
     uint8_t needs_remap;
 };
 
+/// Width and height of the tiles that a capture is split into for browsers with tiled capture enabled.
+/// Their IPC_MSG_CAPTURENOTIFY_* messages are followed by a bitmap with one bit for each tile of the
+/// image, in row-major order starting from the first row in the shm, least significant bit first. A
+/// set bit means the tile has changed since the previous capture that was sent to that browser. Tiles
+/// on the right and top edges are smaller if the image size isn't a multiple of this.
+#define BOLT_CAPTURE_TILE_SIZE 64
+
+/// Header for BoltIPCMessageTypeToHost::IPC_MSG_TEXCACHE_PUBLISHED, sent when the client has created
+/// an object in the shared texture cache, so that the host can delete it once every client is gone
+struct BoltIPCTexCachePublishedHeader {
+    uint64_t id;
+};
+
+/// Header for BoltIPCMessageTypeToHost::IPC_MSG_FRAMETRACEDATA, sent in reply to an IPC_MSG_FRAMETRACE
+/// that stopped tracing. Followed by `event_count` BoltIPCFrameTraceEvent structs, then `names_size`
+/// bytes of null-terminated scope names, which the events refer to by their offset. See frametrace.h.
+struct BoltIPCFrameTraceDataHeader {
+    uint32_t trace_id; // from the IPC_MSG_FRAMETRACE this answers
+    uint32_t pid;
+    uint32_t event_count;
+    uint32_t names_size;
+};
+
+/// Struct following BoltIPCFrameTraceDataHeader
+struct BoltIPCFrameTraceEvent {
+    uint64_t start_micros;
+    uint64_t duration_micros;
+    uint32_t thread;
+    uint32_t name_offset;
+};
+
 /// Header for BoltIPCMessageTypeToClient::IPC_MSG_STARTPLUGIN
 struct BoltIPCStartPluginHeader {
     uint64_t uid;
@@ -130,8 +214,15 @@ struct BoltIPCOsrUpdateHeader {
     void* needs_remap; // 1 or 0 on POSIX-compliant platforms, HANDLE or nullptr on Windows
     int width;
     int height;
+    uint64_t generation; // increases by one with every update; must be sent back in the ack
+    uint8_t buffer; // index of the frame to read, see BOLT_IPC_OSR_BUFFER_COUNT
 };
 
+/// Number of frames in an OSR window's shm. Each is width*height*4 bytes, one after another. The
+/// host only paints into a frame the client isn't reading from, so the client may read from the one
+/// named in an IPC_MSG_OSRUPDATE header until it sends the ack, without any copying on either side.
+#define BOLT_IPC_OSR_BUFFER_COUNT 2
+
 /// Rectangle sent after IPC_MSG_OSRUPDATE; header.rect_count indicates the number of rects sent
 struct BoltIPCOsrUpdateRect {
     int x;
@@ -140,11 +231,41 @@ struct BoltIPCOsrUpdateRect {
     int h;
 };
 
-/// Header for BoltIPCMessageTypeToClient::IPC_MSG_OSRPOPUPCONTENTS
-struct BoltIPCOsrPopupContentsHeader {
+/// Maximum number of planes in a shared texture, and so of handles sent along with one message.
+#define BOLT_IPC_MAX_PLANES 4
+
+/// Header for BoltIPCMessageTypeToClient::IPC_MSG_OSRACCELERATEDPAINT, which OSR windows send instead
+/// of IPC_MSG_OSRUPDATE and IPC_MSG_OSRPOPUPUPDATE if the client set shared_textures when
+/// identifying. The frame is a texture on the GPU, which the host may paint into again at any time
+/// after this message, so the client copies it out as soon as it's received. On POSIX-compliant
+/// platforms it's a dmabuf, and the fd of each plane is sent with ipc_send_handles just before this
+/// message; on Windows it's a shared NT handle, already duplicated into the client process. The
+/// client must close the handles when it's done. View updates get acked as with IPC_MSG_OSRUPDATE,
+/// popup updates don't.
+struct BoltIPCOsrAcceleratedPaintHeader {
+    uint64_t window_id;
+    uint64_t generation; // as in BoltIPCOsrUpdateHeader, unused for popups
+    int width;
+    int height;
+    uint32_t format; // DRM fourcc code, POSIX only
+    uint64_t modifier; // DRM format modifier, POSIX only
+    uint32_t plane_count; // POSIX only
+    uint32_t strides[BOLT_IPC_MAX_PLANES];
+    uint64_t offsets[BOLT_IPC_MAX_PLANES];
+    void* handle; // Windows only
+    uint8_t is_popup;
+};
+
+/// Header for BoltIPCMessageTypeToClient::IPC_MSG_OSRPOPUPUPDATE, followed by rect_count instances of
+/// BoltIPCOsrUpdateRect. Works like IPC_MSG_OSRUPDATE, except the popup has its own shm holding just
+/// one width*height*4 frame, which the host won't paint into again until the client acks.
+struct BoltIPCOsrPopupUpdateHeader {
+    uint32_t rect_count;
     uint64_t window_id;
+    void* needs_remap; // as in BoltIPCOsrUpdateHeader
     int width;
     int height;
+    uint64_t generation; // counted separately from the view's generation
 };
 
 /// Header for BoltIPCMessageTypeToClient::IPC_MSG_OSRPOPUPPOSITION
@@ -201,6 +322,51 @@ struct BoltIPCOsrCaptureDoneHeader {
     uint64_t window_id;
 };
 
+/// Header for BoltIPCMessageTypeToClient::IPC_MSG_TEXCACHE, sent in reply to IPC_MSG_IDENTIFY. Shared
+/// texture cache objects are named after `owner` (the host's pid) instead of the client's own pid, so
+/// that every client of the same host finds the same objects. See BoltTextureCacheHeader in plugin.h.
+struct BoltIPCTexCacheHeader {
+    int owner;
+};
+
+/// Header for BoltIPCMessageTypeToClient::IPC_MSG_FRAMETRACE, which starts frame tracing in the client
+/// if `running` is non-zero, or stops it otherwise, in which case the client replies with everything
+/// it recorded in an IPC_MSG_FRAMETRACEDATA.
+struct BoltIPCFrameTraceHeader {
+    uint32_t trace_id;
+    uint8_t running;
+};
+
+/// Capacity of each direction of the optional shared-memory ring transport. Must be a power of two.
+#define BOLT_IPC_RING_CAPACITY (1 << 20)
+
+/// Control block of one direction of the optional shared-memory ring transport. The ring's data
+/// immediately follows this struct in memory, and its capacity is always a power of two. A game
+/// client creates a shm object tagged "ipc" containing two rings, first the one it writes to, then
+/// the one the host writes to, and offers it in IPC_MSG_IDENTIFY. If the host accepts, both sides
+/// carry on sending exactly the same messages as before, but through the rings instead of the
+/// socket, and the socket is only used to wake up a reader that's waiting for data.
+///
+/// The offsets are free-running counters and are never wrapped, only masked when indexing data.
+struct BoltIPCRing {
+    uint64_t write_offset;
+    uint8_t pad1[56];
+    uint64_t read_offset;
+    uint32_t reader_waiting;
+    uint8_t pad2[52];
+    uint64_t capacity;
+    uint8_t pad3[56];
+};
+
+/// Size of the shm object containing both rings, for rings of the given capacity.
+#define BOLT_IPC_RING_SHM_SIZE(CAPACITY) (2 * (sizeof(struct BoltIPCRing) + (CAPACITY)))
+
+/// One piece of a message for ipc_sendv.
+struct BoltIPCBuffer {
+    const void* data;
+    size_t len;
+};
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -208,14 +374,73 @@ extern "C" {
 /// Sends the given bytes on the IPC channel and returns zero on success or non-zero on failure.
 uint8_t _bolt_ipc_send(BoltSocketType fd, const void* data, size_t len);
 
+/// Sends several buffers, one after another, on the IPC channel, using a single system call where
+/// possible. Typically used to send a message type, header and tail together. Returns zero on
+/// success or non-zero on failure.
+uint8_t _bolt_ipc_sendv(BoltSocketType fd, const struct BoltIPCBuffer* buffers, size_t count);
+
+/// Sends as much of the given bytes as possible without blocking, setting `sent` to the number of
+/// bytes sent, which may be zero. Returns zero on success or non-zero on failure.
+uint8_t _bolt_ipc_try_send(BoltSocketType fd, const void* data, size_t len, size_t* sent);
+
+/// If `queueing` is non-zero, all future sends on this fd will be held in memory until the next
+/// call to ipc_flush, so that they can all be sent at once. If zero, flushes and goes back to
+/// sending immediately. Returns zero on success, or non-zero if there are too many fds with state
+/// already, in which case sends will continue to be immediate.
+uint8_t _bolt_ipc_set_queueing(BoltSocketType fd, uint8_t queueing);
+
+/// Sends everything queued up for this fd, if anything. Returns zero on success or non-zero on failure.
+uint8_t _bolt_ipc_flush(BoltSocketType fd);
+
 /// Receives the given number of bytes from the IPC socket, blocking until the full amount has been
 /// received. Use plugin_ipc_poll to check if this will block. Returns zero on success or non-zero
 /// on failure.
 uint8_t _bolt_ipc_receive(BoltSocketType fd, void* data, size_t len);
 
+/// Receives as many of the given number of bytes as are available, without blocking, setting
+/// `received` to the number received, which may be zero. If that's zero and the fd has a receive
+/// ring, the other side will write a byte to the socket the next time it sends anything, as with
+/// ipc_poll. Returns zero on success or non-zero on failure, including EOF.
+uint8_t _bolt_ipc_try_receive(BoltSocketType fd, void* data, size_t len, size_t* received);
+
 /// Checks whether ipc_receive would return immediately (1) or block (0) or return an error (0).
+/// If the fd has a receive ring and this returns 0, the other side will write a byte to the socket
+/// the next time it sends anything, so it's safe to wait on the socket after this.
 uint8_t _bolt_ipc_poll(BoltSocketType fd);
 
+/// Initialises both rings in a newly-created ring shm object of the given total size.
+void _bolt_ipc_ring_init(void* shm, size_t shm_size);
+
+/// Gets the ring at the given index (0 for client-to-host, 1 for host-to-client) in a ring shm object.
+struct BoltIPCRing* _bolt_ipc_ring_get(void* shm, uint8_t index);
+
+/// Makes all future ipc_send calls on this fd go into this ring instead of the socket. Any message
+/// currently being sent must be finished first, and anything queued will be sent on the socket
+/// first. Returns zero on success, or non-zero if there are too many fds with state already, in
+/// which case the socket will continue to be used.
+uint8_t _bolt_ipc_set_send_ring(BoltSocketType fd, struct BoltIPCRing* ring);
+
+/// Makes all future ipc_receive calls on this fd read from this ring instead of the socket. This
+/// must be called directly after receiving the other side's last socket message. Returns zero on
+/// success, or non-zero if there are too many fds with state already.
+uint8_t _bolt_ipc_set_receive_ring(BoltSocketType fd, struct BoltIPCRing* ring);
+
+#if !defined(_WIN32)
+/// Sends some fds on the socket, out of band, so that the other side gets its own copies of them.
+/// The message that refers to them should be sent after this. Only works on an fd with a send ring,
+/// since otherwise the socket is carrying messages. Returns zero on success or non-zero on failure.
+uint8_t _bolt_ipc_send_handles(BoltSocketType fd, const int* handles, size_t count);
+
+/// Receives fds sent with ipc_send_handles, in the order they were sent, blocking until there are
+/// enough. Only works on an fd with a receive ring. The caller owns the fds and has to close them.
+/// Returns zero on success or non-zero on failure.
+uint8_t _bolt_ipc_receive_handles(BoltSocketType fd, int* handles, size_t count);
+#endif
+
+/// Frees everything kept for this fd, including any rings, buffered input and queued output. Should
+/// be called when the fd is closed, before any ring shm is unmapped.
+void _bolt_ipc_release(BoltSocketType fd);
+
 #if defined(__cplusplus)
 }
 #endif
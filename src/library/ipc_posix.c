@@ -3,56 +3,593 @@
 #if defined(_WIN32)
 #include <afunix.h>
 #define SENDFLAGS 0
+#define SENDV_ERROR SOCKET_ERROR
 #define poll WSAPoll
+#define sched_yield SwitchToThread
 #else
+#include <sched.h>
 #include <errno.h>
 #include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #define SENDFLAGS MSG_NOSIGNAL
+#define SENDV_ERROR -1
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-uint8_t _bolt_ipc_send(BoltSocketType fd, const void* data, size_t len) {
-    const int olderr = errno;
-    size_t remaining = len;
-    size_t sent = 0;
-    while (remaining > 0) {
-        int r = send(fd, (const uint8_t*)data + sent, remaining, SENDFLAGS);
+// maximum number of fds that can have state (rings, buffers, queues) at once. any fds beyond this
+// are still usable, they just go straight to the socket for everything.
+#define CHANNEL_TABLE_SIZE 64
+
+// socket reads are done this many bytes at a time, if available, then consumed from the buffer.
+// reads bigger than this go straight to the caller's memory.
+#define RECEIVE_BUFFER_SIZE 65536
+
+// a queueing channel flushes early if its queue would grow beyond this
+#define QUEUE_FLUSH_THRESHOLD (256 * 1024)
+
+// max buffers handed to a single sendmsg/WSASend call
+#define SENDV_MAX_BUFFERS 16
+
+// max fds that can be waiting for ipc_receive_handles on one channel; any more are closed
+#define CHANNEL_HANDLE_CAPACITY (BOLT_IPC_MAX_PLANES * 4)
+
+// how many times a writer yields to a busy reader when its ring is full, before it starts sleeping
+#define RING_FULL_SPIN_COUNT 256
+
+// the ring offsets are shared with another process, and the channel table is shared between threads,
+// so everything touching them goes through these. all of them are sequentially-consistent, which
+// the reader_waiting handshake relies on: the writer stores write_offset then loads reader_waiting,
+// and the reader stores reader_waiting then loads write_offset, so at least one sees the other.
+#if defined(_MSC_VER)
+static uint64_t load_u64(const uint64_t* p) { return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)p, 0, 0); }
+static void store_u64(uint64_t* p, uint64_t v) { InterlockedExchange64((volatile LONG64*)p, (LONG64)v); }
+static uint32_t load_u32(const uint32_t* p) { return (uint32_t)InterlockedCompareExchange((volatile LONG*)p, 0, 0); }
+static uint32_t exchange_u32(uint32_t* p, uint32_t v) { return (uint32_t)InterlockedExchange((volatile LONG*)p, (LONG)v); }
+static void* load_ptr(void* const* p) { return InterlockedCompareExchangePointer((PVOID volatile*)p, NULL, NULL); }
+static void store_ptr(void** p, void* v) { InterlockedExchangePointer((PVOID volatile*)p, v); }
+#else
+static uint64_t load_u64(const uint64_t* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static void store_u64(uint64_t* p, uint64_t v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+static uint32_t load_u32(const uint32_t* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static uint32_t exchange_u32(uint32_t* p, uint32_t v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+static void* load_ptr(void* const* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static void store_ptr(void** p, void* v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+#endif
+
+// per-fd state. a free slot is only claimed with channel_add_lock held, since the sending side (e.g.
+// ipc_set_queueing on the render thread) and the receiving side can both be first to add an fd. in_use
+// is only cleared by ipc_release, once neither side is using the fd any more. the other fields of a
+// channel are only touched by whichever side (sending or receiving) they belong to.
+struct IPCChannel {
+    uint32_t in_use;
+    BoltSocketType fd;
+    void* send_ring; // struct BoltIPCRing*
+    void* receive_ring; // struct BoltIPCRing*
+
+    // bytes already pulled from the socket but not yet handed to ipc_receive
+    uint8_t* receive_buffer;
+    size_t receive_start;
+    size_t receive_end;
+
+    // if queueing is set, ipc_send appends here instead of sending, until ipc_flush
+    uint8_t queueing;
+    uint8_t* queue;
+    size_t queue_length;
+    size_t queue_capacity;
+
+#if !defined(_WIN32)
+    // fds that came in on the socket but haven't been taken by ipc_receive_handles yet
+    int handles[CHANNEL_HANDLE_CAPACITY];
+    size_t handle_count;
+#endif
+};
+static struct IPCChannel channels[CHANNEL_TABLE_SIZE];
+static uint32_t channel_add_lock = 0;
+
+static struct IPCChannel* channel_find(BoltSocketType fd) {
+    for (size_t i = 0; i < CHANNEL_TABLE_SIZE; i += 1) {
+        struct IPCChannel* channel = &channels[i];
+        if (load_u32(&channel->in_use) && channel->fd == fd) return channel;
+    }
+    return NULL;
+}
+
+static struct IPCChannel* channel_find_or_add(BoltSocketType fd) {
+    struct IPCChannel* channel = channel_find(fd);
+    if (channel) return channel;
+    while (exchange_u32(&channel_add_lock, 1)) sched_yield();
+    // another thread may have added this fd while this one was waiting for the lock
+    channel = channel_find(fd);
+    if (channel) {
+        exchange_u32(&channel_add_lock, 0);
+        return channel;
+    }
+    for (size_t i = 0; i < CHANNEL_TABLE_SIZE; i += 1) {
+        channel = &channels[i];
+        if (!load_u32(&channel->in_use)) {
+            channel->fd = fd;
+            channel->send_ring = NULL;
+            channel->receive_ring = NULL;
+            channel->receive_buffer = NULL;
+            channel->receive_start = 0;
+            channel->receive_end = 0;
+            channel->queueing = 0;
+            channel->queue = NULL;
+            channel->queue_length = 0;
+            channel->queue_capacity = 0;
+#if !defined(_WIN32)
+            channel->handle_count = 0;
+#endif
+            exchange_u32(&channel->in_use, 1);
+            exchange_u32(&channel_add_lock, 0);
+            return channel;
+        }
+    }
+    exchange_u32(&channel_add_lock, 0);
+    return NULL;
+}
+
+static uint8_t* ring_data(struct BoltIPCRing* ring) {
+    return (uint8_t*)(ring + 1);
+}
+
+// sends a wakeup byte on the socket if the reader of this ring is waiting for one
+static uint8_t ring_wake_reader(BoltSocketType fd, struct BoltIPCRing* ring) {
+    if (!load_u32(&ring->reader_waiting) || !exchange_u32(&ring->reader_waiting, 0)) return 0;
+    const uint8_t byte = 0;
+    if (send(fd, (const char*)&byte, 1, SENDFLAGS) == -1) {
+        printf("[IPC] error: IPC send() failed, error %i\n", errno);
+        return 1;
+    }
+    return 0;
+}
+
+// reads from the socket of a channel with a receive ring, where every byte is either a wakeup or
+// was sent with ipc_send_handles. any fds that come with them are kept for ipc_receive_handles.
+// returns the same as recv().
+static int channel_receive_wakeups(struct IPCChannel* channel) {
+    char buf[64];
+#if defined(_WIN32)
+    return recv(channel->fd, buf, sizeof(buf), 0);
+#else
+    union {
+        struct cmsghdr align;
+        char data[CMSG_SPACE(sizeof(int) * BOLT_IPC_MAX_PLANES)];
+    } control;
+    struct iovec iov = {.iov_base = buf, .iov_len = sizeof(buf)};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.data, .msg_controllen = sizeof(control.data)};
+    const ssize_t r = recvmsg(channel->fd, &msg, MSG_CMSG_CLOEXEC);
+    if (r <= 0) return (int)r;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; i += 1) {
+            int handle;
+            memcpy(&handle, CMSG_DATA(cmsg) + (i * sizeof(int)), sizeof(handle));
+            if (channel->handle_count < CHANNEL_HANDLE_CAPACITY) {
+                channel->handles[channel->handle_count] = handle;
+                channel->handle_count += 1;
+            } else {
+                close(handle);
+            }
+        }
+    }
+    return (int)r;
+#endif
+}
+
+// discards any wakeup bytes that are already waiting on the socket, without blocking.
+// returns non-zero if the socket has hit EOF or an error.
+static uint8_t ring_drain_wakeups(struct IPCChannel* channel) {
+    struct pollfd pfd = {.events = POLLIN, .fd = channel->fd};
+    while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+        if (channel_receive_wakeups(channel) <= 0) return 1;
+    }
+    return 0;
+}
+
+// copies as much as will fit into the ring, without waiting, and returns the number of bytes copied
+static size_t ring_write_some(struct BoltIPCRing* ring, const uint8_t* data, size_t len) {
+    const uint64_t capacity = ring->capacity;
+    const uint64_t write_offset = ring->write_offset;
+    const uint64_t free_space = capacity - (write_offset - load_u64(&ring->read_offset));
+    const size_t amount = (len < free_space) ? len : (size_t)free_space;
+    if (amount == 0) return 0;
+    const size_t start = (size_t)(write_offset & (capacity - 1));
+    const size_t first = (amount < capacity - start) ? amount : (size_t)(capacity - start);
+    memcpy(ring_data(ring) + start, data, first);
+    memcpy(ring_data(ring), data + first, amount - first);
+    store_u64(&ring->write_offset, write_offset + amount);
+    return amount;
+}
+
+// writes into the ring, waiting for space if necessary. the reader is only woken at the end if
+// `wake` is set, so consecutive writes can share a wakeup, but it's always woken before waiting.
+static uint8_t ring_write(BoltSocketType fd, struct BoltIPCRing* ring, const uint8_t* data, size_t len, uint8_t wake) {
+    unsigned int spins = 0;
+    while (len > 0) {
+        const size_t amount = ring_write_some(ring, data, len);
+        if (amount == 0) {
+            // ring is full, so the reader must be busy. give it a moment, unless it's gone away
+            if (spins == 0 && ring_wake_reader(fd, ring)) return 1;
+            if (spins < RING_FULL_SPIN_COUNT) {
+                spins += 1;
+                sched_yield();
+                continue;
+            }
+            struct pollfd pfd = {.events = 0, .fd = fd};
+            if (poll(&pfd, 1, 1) > 0 && (pfd.revents & (POLLHUP | POLLERR | POLLNVAL))) {
+                printf("[IPC] error: IPC ring full and socket closed\n");
+                return 1;
+            }
+            continue;
+        }
+        spins = 0;
+        data += amount;
+        len -= amount;
+    }
+    return wake ? ring_wake_reader(fd, ring) : 0;
+}
+
+// copies as much as is available out of the ring, without waiting, and returns the number of bytes copied
+static size_t ring_read_some(struct BoltIPCRing* ring, uint8_t* data, size_t len) {
+    const uint64_t capacity = ring->capacity;
+    const uint64_t read_offset = ring->read_offset;
+    const uint64_t available = load_u64(&ring->write_offset) - read_offset;
+    const size_t amount = (len < available) ? len : (size_t)available;
+    if (amount == 0) return 0;
+    const size_t start = (size_t)(read_offset & (capacity - 1));
+    const size_t first = (amount < capacity - start) ? amount : (size_t)(capacity - start);
+    memcpy(data, ring_data(ring) + start, first);
+    memcpy(data + first, ring_data(ring), amount - first);
+    store_u64(&ring->read_offset, read_offset + amount);
+    return amount;
+}
+
+static uint8_t ring_read(struct IPCChannel* channel, struct BoltIPCRing* ring, uint8_t* data, size_t len) {
+    const uint64_t capacity = ring->capacity;
+    uint64_t read_offset = ring->read_offset;
+    while (len > 0) {
+        const uint64_t available = load_u64(&ring->write_offset) - read_offset;
+        if (available == 0) {
+            // nothing to read yet, so ask to be woken up, check again, and sleep on the socket
+            store_u64(&ring->read_offset, read_offset);
+            exchange_u32(&ring->reader_waiting, 1);
+            if (load_u64(&ring->write_offset) != read_offset) continue;
+            const int r = channel_receive_wakeups(channel);
+            if (r == -1) {
+                printf("[IPC] error: IPC recv() failed, error %i\n", errno);
+                return 1;
+            }
+            if (r == 0) {
+                printf("[IPC] IPC recv() got EOF\n");
+                return 1;
+            }
+            continue;
+        }
+        const size_t amount = (len < available) ? len : (size_t)available;
+        const size_t start = (size_t)(read_offset & (capacity - 1));
+        const size_t first = (amount < capacity - start) ? amount : (size_t)(capacity - start);
+        memcpy(data, ring_data(ring) + start, first);
+        memcpy(data + first, ring_data(ring), amount - first);
+        read_offset += amount;
+        data += amount;
+        len -= amount;
+    }
+    store_u64(&ring->read_offset, read_offset);
+    return 0;
+}
+
+static uint8_t socket_send(BoltSocketType fd, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        int r = send(fd, (const char*)data, len, SENDFLAGS);
         if (r == -1) {
             printf("[IPC] error: IPC send() failed, error %i\n", errno);
-            errno = olderr;
             return 1;
         }
-        remaining -= r;
-        sent += r;
+        data += r;
+        len -= r;
     }
     return 0;
 }
 
-uint8_t _bolt_ipc_receive(BoltSocketType fd, void* data, size_t len) {
-    const int olderr = errno;
-    size_t remaining = len;
-    size_t received = 0;
-    while (remaining > 0) {
-        int r = recv(fd, (uint8_t*)data + received, remaining, 0);
+static uint8_t socket_sendv(BoltSocketType fd, const struct BoltIPCBuffer* buffers, size_t count) {
+    while (count > 0) {
+        const size_t batch = (count < SENDV_MAX_BUFFERS) ? count : SENDV_MAX_BUFFERS;
+#if defined(_WIN32)
+        WSABUF bufs[SENDV_MAX_BUFFERS];
+        for (size_t i = 0; i < batch; i += 1) {
+            bufs[i].buf = (CHAR*)buffers[i].data;
+            bufs[i].len = (ULONG)buffers[i].len;
+        }
+        DWORD sent;
+        const int r = WSASend(fd, bufs, (DWORD)batch, &sent, 0, NULL, NULL);
+#else
+        struct iovec iov[SENDV_MAX_BUFFERS];
+        for (size_t i = 0; i < batch; i += 1) {
+            iov[i].iov_base = (void*)buffers[i].data;
+            iov[i].iov_len = buffers[i].len;
+        }
+        const struct msghdr msg = {.msg_iov = iov, .msg_iovlen = batch};
+        const ssize_t r = sendmsg(fd, &msg, SENDFLAGS);
+        const size_t sent = (size_t)r;
+#endif
+        if (r == SENDV_ERROR) {
+            printf("[IPC] error: IPC sendmsg() failed, error %i\n", errno);
+            return 1;
+        }
+
+        // skip past whatever was fully sent, then finish off any partially-sent buffer
+        size_t i = 0;
+        size_t remaining = sent;
+        while (i < batch && remaining >= buffers[i].len) {
+            remaining -= buffers[i].len;
+            i += 1;
+        }
+        if (i < batch) {
+            if (socket_send(fd, (const uint8_t*)buffers[i].data + remaining, buffers[i].len - remaining)) return 1;
+            i += 1;
+        }
+        buffers += i;
+        count -= i;
+    }
+    return 0;
+}
+
+static uint8_t socket_receive(BoltSocketType fd, uint8_t* data, size_t len) {
+    while (len > 0) {
+        int r = recv(fd, (char*)data, len, 0);
         if (r == -1) {
             printf("[IPC] error: IPC recv() failed, error %i\n", errno);
-            errno = olderr;
             return 1;
         }
         if (r == 0) {
             printf("[IPC] IPC recv() got EOF\n");
             return 1;
         }
-        remaining -= r;
-        received += r;
+        data += r;
+        len -= r;
     }
     return 0;
 }
 
+// receives whatever is available from the socket, up to len bytes, without blocking
+static uint8_t socket_try_receive(BoltSocketType fd, uint8_t* data, size_t len, size_t* received) {
+    *received = 0;
+    if (len == 0) return 0;
+#if defined(_WIN32)
+    // as in ipc_try_send, winsock has no per-call non-blocking flag
+    struct pollfd pfd = {.events = POLLIN, .fd = fd};
+    if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & (POLLIN | POLLHUP))) return 0;
+    const int r = recv(fd, (char*)data, (int)len, 0);
+#else
+    const ssize_t r = recv(fd, data, len, MSG_DONTWAIT);
+    if (r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+#endif
+    if (r == -1) {
+        printf("[IPC] error: IPC recv() failed, error %i\n", errno);
+        return 1;
+    }
+    if (r == 0) {
+        printf("[IPC] IPC recv() got EOF\n");
+        return 1;
+    }
+    *received = (size_t)r;
+    return 0;
+}
+
+// like socket_receive, but pulls as much as is available from the socket at once into the
+// channel's buffer, so that a burst of small messages only needs one recv() call
+static uint8_t channel_receive(struct IPCChannel* channel, uint8_t* data, size_t len) {
+    while (len > 0) {
+        if (channel->receive_start == channel->receive_end) {
+            if (len >= RECEIVE_BUFFER_SIZE) return socket_receive(channel->fd, data, len);
+            int r = recv(channel->fd, (char*)channel->receive_buffer, RECEIVE_BUFFER_SIZE, 0);
+            if (r == -1) {
+                printf("[IPC] error: IPC recv() failed, error %i\n", errno);
+                return 1;
+            }
+            if (r == 0) {
+                printf("[IPC] IPC recv() got EOF\n");
+                return 1;
+            }
+            channel->receive_start = 0;
+            channel->receive_end = r;
+        }
+        const size_t buffered = channel->receive_end - channel->receive_start;
+        const size_t amount = (len < buffered) ? len : buffered;
+        memcpy(data, channel->receive_buffer + channel->receive_start, amount);
+        channel->receive_start += amount;
+        data += amount;
+        len -= amount;
+    }
+    return 0;
+}
+
+// like channel_receive, but only takes what's already buffered or available from the socket
+static uint8_t channel_try_receive(struct IPCChannel* channel, uint8_t* data, size_t len, size_t* received) {
+    *received = 0;
+    if (len == 0) return 0;
+    if (channel->receive_start == channel->receive_end) {
+        size_t r;
+        if (socket_try_receive(channel->fd, channel->receive_buffer, RECEIVE_BUFFER_SIZE, &r)) return 1;
+        channel->receive_start = 0;
+        channel->receive_end = r;
+    }
+    const size_t buffered = channel->receive_end - channel->receive_start;
+    const size_t amount = (len < buffered) ? len : buffered;
+    memcpy(data, channel->receive_buffer + channel->receive_start, amount);
+    channel->receive_start += amount;
+    *received = amount;
+    return 0;
+}
+
+static uint8_t channel_flush(struct IPCChannel* channel) {
+    if (!channel->queue_length) return 0;
+    struct BoltIPCRing* ring = load_ptr(&channel->send_ring);
+    const uint8_t ret = ring
+        ? ring_write(channel->fd, ring, channel->queue, channel->queue_length, 1)
+        : socket_send(channel->fd, channel->queue, channel->queue_length);
+    channel->queue_length = 0;
+    return ret;
+}
+
+// appends to the channel's queue, flushing it first if it's already big enough
+static uint8_t channel_enqueue(struct IPCChannel* channel, const struct BoltIPCBuffer* buffers, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i += 1) total += buffers[i].len;
+    if (channel->queue_length + total > QUEUE_FLUSH_THRESHOLD) {
+        if (channel_flush(channel)) return 1;
+    }
+    if (channel->queue_length + total > channel->queue_capacity) {
+        size_t capacity = channel->queue_capacity ? channel->queue_capacity : 4096;
+        while (capacity < channel->queue_length + total) capacity *= 2;
+        uint8_t* queue = realloc(channel->queue, capacity);
+        if (!queue) {
+            // no memory for the queue, so just send in order instead
+            if (channel_flush(channel)) return 1;
+            return socket_sendv(channel->fd, buffers, count);
+        }
+        channel->queue = queue;
+        channel->queue_capacity = capacity;
+    }
+    for (size_t i = 0; i < count; i += 1) {
+        memcpy(channel->queue + channel->queue_length, buffers[i].data, buffers[i].len);
+        channel->queue_length += buffers[i].len;
+    }
+    return 0;
+}
+
+uint8_t _bolt_ipc_send(BoltSocketType fd, const void* data, size_t len) {
+    const struct BoltIPCBuffer buffer = {.data = data, .len = len};
+    return _bolt_ipc_sendv(fd, &buffer, 1);
+}
+
+uint8_t _bolt_ipc_sendv(BoltSocketType fd, const struct BoltIPCBuffer* buffers, size_t count) {
+    const int olderr = errno;
+    uint8_t ret = 0;
+    struct IPCChannel* channel = channel_find(fd);
+    struct BoltIPCRing* ring = channel ? load_ptr(&channel->send_ring) : NULL;
+    if (channel && channel->queueing) {
+        ret = channel_enqueue(channel, buffers, count);
+    } else if (ring) {
+        for (size_t i = 0; i < count && !ret; i += 1) {
+            ret = ring_write(fd, ring, buffers[i].data, buffers[i].len, i + 1 == count);
+        }
+    } else {
+        ret = socket_sendv(fd, buffers, count);
+    }
+    errno = olderr;
+    return ret;
+}
+
+uint8_t _bolt_ipc_try_send(BoltSocketType fd, const void* data, size_t len, size_t* sent) {
+    const int olderr = errno;
+    uint8_t ret = 0;
+    struct IPCChannel* channel = channel_find(fd);
+    struct BoltIPCRing* ring = channel ? load_ptr(&channel->send_ring) : NULL;
+    *sent = 0;
+    if (ring) {
+        *sent = ring_write_some(ring, data, len);
+        if (*sent) ret = ring_wake_reader(fd, ring);
+    } else {
+#if defined(_WIN32)
+        // winsock has no per-call non-blocking flag, so check there's some room, then send a
+        // limited amount, which may still block briefly if the room is less than that
+        struct pollfd pfd = {.events = POLLOUT, .fd = fd};
+        if (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLOUT)) {
+            const int r = send(fd, (const char*)data, (int)((len < RECEIVE_BUFFER_SIZE) ? len : RECEIVE_BUFFER_SIZE), 0);
+            if (r == -1) {
+                printf("[IPC] error: IPC send() failed, error %i\n", errno);
+                ret = 1;
+            } else {
+                *sent = r;
+            }
+        }
+#else
+        const ssize_t r = send(fd, data, len, SENDFLAGS | MSG_DONTWAIT);
+        if (r == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            printf("[IPC] error: IPC send() failed, error %i\n", errno);
+            ret = 1;
+        } else if (r > 0) {
+            *sent = r;
+        }
+#endif
+    }
+    errno = olderr;
+    return ret;
+}
+
+uint8_t _bolt_ipc_receive(BoltSocketType fd, void* data, size_t len) {
+    const int olderr = errno;
+    uint8_t ret;
+    struct IPCChannel* channel = channel_find_or_add(fd);
+    if (channel && !channel->receive_buffer && !channel->receive_ring) {
+        channel->receive_buffer = malloc(RECEIVE_BUFFER_SIZE);
+    }
+    struct BoltIPCRing* ring = channel ? load_ptr(&channel->receive_ring) : NULL;
+    if (ring) {
+        ret = ring_read(channel, ring, data, len);
+    } else if (channel && channel->receive_buffer) {
+        ret = channel_receive(channel, data, len);
+    } else {
+        ret = socket_receive(fd, data, len);
+    }
+    errno = olderr;
+    return ret;
+}
+
+uint8_t _bolt_ipc_try_receive(BoltSocketType fd, void* data, size_t len, size_t* received) {
+    const int olderr = errno;
+    uint8_t ret = 0;
+    struct IPCChannel* channel = channel_find_or_add(fd);
+    if (channel && !channel->receive_buffer && !channel->receive_ring) {
+        channel->receive_buffer = malloc(RECEIVE_BUFFER_SIZE);
+    }
+    struct BoltIPCRing* ring = channel ? load_ptr(&channel->receive_ring) : NULL;
+    if (ring) {
+        *received = ring_read_some(ring, data, len);
+        if (*received == 0 && len > 0) {
+            // same handshake as ipc_poll: drain the socket, ask for a wakeup, then check once more,
+            // so that either this finds the data or the writer sees reader_waiting
+            if (ring_drain_wakeups(channel)) {
+                printf("[IPC] IPC recv() got EOF\n");
+                ret = 1;
+            } else {
+                exchange_u32(&ring->reader_waiting, 1);
+                *received = ring_read_some(ring, data, len);
+            }
+        }
+    } else if (channel && channel->receive_buffer) {
+        ret = channel_try_receive(channel, data, len, received);
+    } else {
+        ret = socket_try_receive(fd, data, len, received);
+    }
+    errno = olderr;
+    return ret;
+}
+
 uint8_t _bolt_ipc_poll(BoltSocketType fd) {
     const int olderr = errno;
+    struct IPCChannel* channel = channel_find(fd);
+    struct BoltIPCRing* ring = channel ? load_ptr(&channel->receive_ring) : NULL;
+    if (ring) {
+        // anything on the socket now is just a wakeup, except EOF, which ipc_receive will report
+        const uint8_t eof = ring_drain_wakeups(channel);
+        errno = olderr;
+        if (eof) return 1;
+        const uint64_t read_offset = load_u64(&ring->read_offset);
+        if (load_u64(&ring->write_offset) != read_offset) return 1;
+        exchange_u32(&ring->reader_waiting, 1);
+        return load_u64(&ring->write_offset) != read_offset;
+    }
+    if (channel && channel->receive_start != channel->receive_end) return 1;
+
     struct pollfd pfd = {.events = POLLIN, .fd = fd};
     int r = poll(&pfd, 1, 0);
     if (r == -1) {
@@ -62,3 +599,129 @@ uint8_t _bolt_ipc_poll(BoltSocketType fd) {
     }
     return r && (pfd.revents & POLLIN);
 }
+
+uint8_t _bolt_ipc_set_queueing(BoltSocketType fd, uint8_t queueing) {
+    struct IPCChannel* channel = channel_find_or_add(fd);
+    if (!channel) return 1;
+    if (!queueing) _bolt_ipc_flush(fd);
+    channel->queueing = queueing;
+    return 0;
+}
+
+uint8_t _bolt_ipc_flush(BoltSocketType fd) {
+    const int olderr = errno;
+    struct IPCChannel* channel = channel_find(fd);
+    const uint8_t ret = channel ? channel_flush(channel) : 0;
+    errno = olderr;
+    return ret;
+}
+
+void _bolt_ipc_ring_init(void* shm, size_t shm_size) {
+    const uint64_t capacity = (shm_size / 2) - sizeof(struct BoltIPCRing);
+    memset(shm, 0, sizeof(struct BoltIPCRing));
+    _bolt_ipc_ring_get(shm, 0)->capacity = capacity;
+    memset(_bolt_ipc_ring_get(shm, 1), 0, sizeof(struct BoltIPCRing));
+    _bolt_ipc_ring_get(shm, 1)->capacity = capacity;
+}
+
+struct BoltIPCRing* _bolt_ipc_ring_get(void* shm, uint8_t index) {
+    struct BoltIPCRing* first = shm;
+    if (index == 0) return first;
+    return (struct BoltIPCRing*)(ring_data(first) + first->capacity);
+}
+
+uint8_t _bolt_ipc_set_send_ring(BoltSocketType fd, struct BoltIPCRing* ring) {
+    struct IPCChannel* channel = channel_find_or_add(fd);
+    if (!channel) return 1;
+    // anything queued up to now was meant for the socket, so it has to go there first
+    if (channel->queue_length) {
+        if (socket_send(fd, channel->queue, channel->queue_length)) return 1;
+        channel->queue_length = 0;
+    }
+    store_ptr(&channel->send_ring, ring);
+    return 0;
+}
+
+uint8_t _bolt_ipc_set_receive_ring(BoltSocketType fd, struct BoltIPCRing* ring) {
+    struct IPCChannel* channel = channel_find_or_add(fd);
+    if (!channel) return 1;
+    // nothing after the last socket message can be anything other than a wakeup
+    channel->receive_start = 0;
+    channel->receive_end = 0;
+    store_ptr(&channel->receive_ring, ring);
+    return 0;
+}
+
+#if !defined(_WIN32)
+uint8_t _bolt_ipc_send_handles(BoltSocketType fd, const int* handles, size_t count) {
+    struct IPCChannel* channel = channel_find(fd);
+    if (!channel || !load_ptr(&channel->send_ring) || count == 0 || count > BOLT_IPC_MAX_PLANES) return 1;
+    const int olderr = errno;
+    union {
+        struct cmsghdr align;
+        char data[CMSG_SPACE(sizeof(int) * BOLT_IPC_MAX_PLANES)];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    // the byte itself means nothing, the other side treats it the same as a wakeup
+    uint8_t byte = 0;
+    struct iovec iov = {.iov_base = &byte, .iov_len = 1};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.data, .msg_controllen = CMSG_SPACE(sizeof(int) * count)};
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    memcpy(CMSG_DATA(cmsg), handles, sizeof(int) * count);
+    uint8_t ret = 0;
+    if (sendmsg(fd, &msg, SENDFLAGS) == -1) {
+        printf("[IPC] error: IPC sendmsg() failed, error %i\n", errno);
+        ret = 1;
+    }
+    errno = olderr;
+    return ret;
+}
+
+uint8_t _bolt_ipc_receive_handles(BoltSocketType fd, int* handles, size_t count) {
+    struct IPCChannel* channel = channel_find(fd);
+    if (!channel || !load_ptr(&channel->receive_ring) || count > CHANNEL_HANDLE_CAPACITY) return 1;
+    const int olderr = errno;
+    uint8_t ret = 0;
+    while (channel->handle_count < count) {
+        // the handles were sent before the message asking for them, so they're already on their way
+        const int r = channel_receive_wakeups(channel);
+        if (r == -1) {
+            printf("[IPC] error: IPC recvmsg() failed, error %i\n", errno);
+            ret = 1;
+            break;
+        }
+        if (r == 0) {
+            printf("[IPC] IPC recvmsg() got EOF\n");
+            ret = 1;
+            break;
+        }
+    }
+    if (!ret) {
+        memcpy(handles, channel->handles, count * sizeof(int));
+        channel->handle_count -= count;
+        memmove(channel->handles, channel->handles + count, channel->handle_count * sizeof(int));
+    }
+    errno = olderr;
+    return ret;
+}
+#endif
+
+void _bolt_ipc_release(BoltSocketType fd) {
+    struct IPCChannel* channel = channel_find(fd);
+    if (!channel) return;
+#if !defined(_WIN32)
+    for (size_t i = 0; i < channel->handle_count; i += 1) close(channel->handles[i]);
+    channel->handle_count = 0;
+#endif
+    store_ptr(&channel->send_ring, NULL);
+    store_ptr(&channel->receive_ring, NULL);
+    free(channel->receive_buffer);
+    free(channel->queue);
+    channel->receive_buffer = NULL;
+    channel->queue = NULL;
+    exchange_u32(&channel->in_use, 0);
+}
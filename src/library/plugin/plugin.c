@@ -1,4 +1,5 @@
 #include "../ipc.h"
+#include "../frametrace.h"
 
 #include "plugin.h"
 #include "plugin_api.h"
@@ -8,6 +9,7 @@
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
+#include <luajit.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,6 +18,7 @@
 #if defined(_WIN32)
 #include <afunix.h>
 #define close closesocket
+#define SHUT_RDWR SD_BOTH
 LARGE_INTEGER performance_frequency;
 #else
 #include <errno.h>
@@ -30,19 +33,34 @@ LARGE_INTEGER performance_frequency;
 
 #define API_ADD(FUNC) lua_pushliteral(state, #FUNC);lua_pushcfunction(state, api_##FUNC);lua_settable(state, -3);
 #define API_ADD_SUB(STATE, FUNC, SUB) lua_pushliteral(STATE, #FUNC);lua_pushcfunction(STATE, api_##SUB##_##FUNC);lua_settable(STATE, -3);
-#define API_ADD_SUB_ALIAS(STATE, FUNC, ALIAS, SUB) lua_pushliteral(STATE, #ALIAS);lua_pushcfunction(STATE, api_##SUB##_##FUNC);lua_settable(STATE, -3);
+#define API_REG(FUNC, SUB) {#FUNC, api_##SUB##_##FUNC},
+#define API_REG_ALIAS(FUNC, ALIAS, SUB) {#ALIAS, api_##SUB##_##FUNC},
 
 #define WINDOW_MIN_SIZE 20
 
 #define PLUGIN_REGISTRYNAME "plugin"
 #define WINDOWS_REGISTRYNAME "windows"
 #define BROWSERS_REGISTRYNAME "browsers"
+#define WORKERS_REGISTRYNAME "workers"
+#define WORKER_REGISTRYNAME "worker"
+#define FILECALLBACKS_REGISTRYNAME "filecallbacks"
 #define BATCH2D_META_REGISTRYNAME "batch2dmeta"
 #define RENDER3D_META_REGISTRYNAME "render3dmeta"
 #define MINIMAP_META_REGISTRYNAME "minimapmeta"
 #define POINT_META_REGISTRYNAME "pointmeta"
 #define TRANSFORM_META_REGISTRYNAME "transformmeta"
 #define BUFFER_META_REGISTRYNAME "buffermeta"
+#define BUFFERVIEW_REGISTRYNAME "bufferview"
+
+// how often plugin timing stats are sent to the host
+#define PLUGIN_STATS_INTERVAL_MICROS 1000000
+
+// number of frames in a row a plugin has to go over its budget before it gets throttled
+#define BUDGET_THROTTLE_FRAMES 10
+
+// sizes of one vertex record written by batch2d:vertices() and render3d:vertices()
+#define BATCH2D_VERTEX_SIZE 48
+#define RENDER3D_VERTEX_SIZE 44
 #define SWAPBUFFERS_META_REGISTRYNAME "swapbuffersmeta"
 #define SURFACE_META_REGISTRYNAME "surfacemeta"
 #define REPOSITION_META_REGISTRYNAME "repositionmeta"
@@ -54,6 +72,7 @@ LARGE_INTEGER performance_frequency;
 #define WINDOW_META_REGISTRYNAME "windowmeta"
 #define BROWSER_META_REGISTRYNAME "browsermeta"
 #define EMBEDDEDBROWSER_META_REGISTRYNAME "embeddedbrowsermeta"
+#define WORKER_META_REGISTRYNAME "workermeta"
 #define SWAPBUFFERS_CB_REGISTRYNAME "swapbufferscb"
 #define BATCH2D_CB_REGISTRYNAME "batch2dcb"
 #define RENDER3D_CB_REGISTRYNAME "render3dcb"
@@ -63,6 +82,11 @@ LARGE_INTEGER performance_frequency;
 #define MOUSEBUTTONUP_CB_REGISTRYNAME "mousebuttonupcb"
 #define SCROLL_CB_REGISTRYNAME "scrollcb"
 #define MESSAGE_CB_REGISTRYNAME "messagecb"
+#define WORKER_MESSAGE_CB_REGISTRYNAME "workermessagecb"
+#define SWAPBUFFERS_EVENT_REGISTRYNAME "swapbuffersevent"
+#define BATCH2D_EVENT_REGISTRYNAME "batch2devent"
+#define RENDER3D_EVENT_REGISTRYNAME "render3devent"
+#define MINIMAP_EVENT_REGISTRYNAME "minimapevent"
 
 enum {
     WINDOW_USERDATA,
@@ -82,9 +106,18 @@ enum {
     BROWSER_EVENT_ENUM_SIZE, // last member of enum
 };
 
+enum {
+    WORKER_ONMESSAGE,
+    WORKER_EVENT_ENUM_SIZE, // last member of enum
+};
+
+// how long _bolt_worker_free waits for a stopped worker's thread to exit before giving up on it
+#define WORKER_JOIN_TIMEOUT_MILLIS 2000
+
 static struct PluginManagedFunctions managed_functions;
 
 static uint64_t next_window_id;
+static uint64_t next_worker_id = 1;
 static struct WindowInfo windows;
 
 static struct SurfaceFunctions overlay;
@@ -96,14 +129,199 @@ static bool inited = false;
 static int _bolt_api_init(lua_State* state);
 
 static BoltSocketType fd = 0;
+static struct BoltSHM ipc_ring_shm; // offered to the host in IPC_MSG_IDENTIFY, see BoltIPCRing
+static uint8_t ipc_ring_inited;
+
+// pid of the host, which shared texture cache objects are named after, or 0 if the cache isn't in use
+static int texcache_owner;
+
+// a complete message from the host: the message type, header and tail, one after another. these are
+// read from the socket by the IPC thread, so that the render thread never has to wait for one to
+// arrive, and handled by the render thread in _bolt_plugin_handle_messages.
+struct IPCMessage {
+    struct IPCMessage* next;
+    size_t length;
+    size_t offset; // how much of data has been read by the handler so far
+    uint8_t data[];
+};
+#define IPC_MAX_HEADER_SIZE 256
+
+// most different scope names that one frame trace can send to the host; see handle_ipc_FRAMETRACE
+#define FRAMETRACE_MAX_NAMES 256
+
+// time the render thread may spend handling host messages each frame, after which the rest are left
+// for the next frame. can be overridden with the BOLT_IPC_BUDGET_MICROS environment variable.
+#define DEFAULT_IPC_BUDGET_MICROS 2000
+static uint64_t ipc_budget_micros;
+
+// everything after `ipc_thread` is protected by ipc_thread.lock
+static struct BoltThread ipc_thread;
+static uint8_t ipc_thread_running; // if not set, messages are read by the render thread instead
+static struct IPCMessage* ipc_inbox_head;
+static struct IPCMessage* ipc_inbox_tail;
+
+// the message currently being handled, only used by the render thread
+static struct IPCMessage* ipc_current_message;
+
+// a plugin waiting for the loader thread to read and compile its files, or one that's been prepared
+// and is waiting for the render thread to start it in _bolt_process_plugin_loads
+struct PluginLoad {
+    struct PluginLoad* next;
+    struct Plugin* plugin;
+    char* path; // full path of the plugin's main file
+    uint8_t failed;
+};
+
+// everything after `loader_thread` is protected by loader_thread.lock
+static struct BoltThread loader_thread;
+static uint8_t loader_thread_running; // if not set, plugins are loaded by the render thread instead
+static uint8_t loader_stopping;
+static struct PluginLoad* loader_inbox_head;
+static struct PluginLoad* loader_inbox_tail;
+static struct PluginLoad* loader_current; // the one the loader thread is working on right now
+static struct PluginLoad* loader_outbox_head;
+static struct PluginLoad* loader_outbox_tail;
+
+// a read or write queued by one of the async file functions, e.g. bolt.saveconfigasync. jobs are
+// done in order by the I/O thread, then handed back to the render thread by _bolt_process_file_jobs,
+// which calls the plugin's callback for each one, if it gave one
+struct FileJob {
+    struct FileJob* next;
+    struct FileJob* coalesced; // later writes to the same file, whose data this one ended up writing
+    uint64_t plugin_id;
+    uint64_t callback_id; // key in the plugin's FILECALLBACKS_REGISTRYNAME table, or 0 for none
+    char* path;
+    void* data; // for writes, what to write. for reads, what was read, if it succeeded
+    size_t size;
+    uint8_t type;
+    uint8_t is_mapped; // data came from _bolt_plugin_file_map rather than malloc
+    uint8_t ok;
+};
+#define FILE_JOB_READ 0
+#define FILE_JOB_READ_MAPPABLE 1 // a read that may use _bolt_plugin_file_map if the file is big enough
+#define FILE_JOB_WRITE 2
+
+// files at least this big are mapped instead of read, where allowed. only files in the plugin's own
+// directory are mapped, since config files get replaced by saves, which fails on Windows while the
+// old file is mapped
+#define FILE_MAP_THRESHOLD (256 * 1024)
+
+// everything after `io_thread` is protected by io_thread.lock
+static struct BoltThread io_thread;
+static uint8_t io_thread_running; // if not set, file jobs are done by the render thread instead
+static uint8_t io_stopping; // if set, remaining writes still get done, but reads don't
+static struct FileJob* io_inbox_head;
+static struct FileJob* io_inbox_tail;
+static struct FileJob* io_outbox_head;
+static struct FileJob* io_outbox_tail;
+
+// id for the next file job that has a callback, only used by the render thread
+static uint64_t next_file_callback_id = 1;
+
+// a decoded PNG, shared between the image cache and any PNG jobs that are using it. only ever
+// touched by the render thread, so the refcount doesn't need to be atomic
+struct DecodedImage {
+    char* path;
+    int64_t mtime;
+    uint8_t* rgba;
+    uint32_t width;
+    uint32_t height;
+    uint32_t refcount;
+    uint8_t is_cached;
+    struct DecodedImage* lru_prev; // towards the most recently used
+    struct DecodedImage* lru_next; // towards the least recently used
+};
+
+// decoded PNGs, keyed by path, shared by every plugin. least recently used images get dropped once
+// the total size goes over IMAGE_CACHE_MAX_SIZE. render thread only
+#define IMAGE_CACHE_MAX_SIZE (64 * 1024 * 1024)
+static struct hashmap* image_cache;
+static struct DecodedImage* image_cache_lru_head;
+static struct DecodedImage* image_cache_lru_tail;
+static size_t image_cache_size;
+
+// a PNG to be decoded for bolt.createsurfacefrompngasync. `next`, `path` and the decoder's results
+// are used by whichever decoder thread the job was given to, everything else belongs to the render
+// thread
+struct PngJob {
+    struct PngJob* next;
+    struct PngJob* coalesced; // later jobs for the same file that are waiting on this one
+    struct PngJob* pending_next; // next in png_pending
+    uint64_t plugin_id;
+    uint64_t callback_id; // key in the plugin's FILECALLBACKS_REGISTRYNAME table
+    char* path;
+    int64_t mtime;
+    uint8_t has_mtime;
+    struct DecodedImage* image; // set if it was in the cache, or once the decoded image is added
+    uint8_t* rgba; // decoder's results
+    uint32_t width;
+    uint32_t height;
+    char error[256];
+};
+
+#define PNG_DECODER_COUNT 2
+struct PngDecoder {
+    uint8_t running;
+    // everything after `thread` is protected by thread.lock
+    struct BoltThread thread;
+    uint8_t stopping;
+    struct PngJob* inbox_head;
+    struct PngJob* inbox_tail;
+    struct PngJob* outbox_head;
+    struct PngJob* outbox_tail;
+};
+static struct PngDecoder png_decoders[PNG_DECODER_COUNT];
+static size_t next_png_decoder;
+
+// jobs that were given to a decoder and haven't been completed yet, so that more requests for the
+// same file can wait for them instead of decoding it again. render thread only
+static struct PngJob* png_pending;
+// jobs that are ready to be completed without going through a decoder. render thread only
+static struct PngJob* png_ready_head;
+static struct PngJob* png_ready_tail;
+
+// directory that compiled plugin files are cached in, with a trailing separator, or an empty string
+// if there's nowhere to cache them. set once by _bolt_plugin_init and read-only after that
+static char bytecode_cache_dir[512];
 
 static struct BoltSHM capture_shm;
 static uint64_t next_capture_time = 0;
+static uint64_t next_stats_time = 0;
 static uint64_t capture_id;
-static uint32_t capture_width;
-static uint32_t capture_height;
+static size_t capture_size;
 static uint8_t capture_inited;
-#define CAPTURE_COOLDOWN_MICROS 250000
+static uint8_t capture_needs_remap; // the mapping has changed since browsers were last sent a capture
+#define DEFAULT_CAPTURE_INTERVAL_MICROS 250000
+#define CAPTURE_REGION_NONE SIZE_MAX // region_index of a request whose region couldn't be added this frame
+
+// what all capture-enabled browsers want from this frame, gathered while processing plugins and windows
+struct CaptureState {
+    uint32_t window_width;
+    uint32_t window_height;
+    uint8_t need_capture; // at least one browser has capture enabled
+    uint8_t ready; // every capture-enabled browser is done with the previous capture
+    uint8_t due; // at least one capture-enabled browser's requested interval has elapsed
+    uint64_t min_interval_micros;
+    struct CaptureRegion* regions; // every distinct region requested by a capture-enabled browser
+    size_t* offsets; // where each region's image starts in the capture shm
+    size_t region_count;
+    size_t region_capacity;
+    size_t size; // total size of all the regions' images
+};
+static struct CaptureState capture_state = {0}; // the region list is reused from frame to frame
+
+// tile hashes for one of capture_state's regions, as of the last capture that a tiled browser wanted it in
+struct CaptureTiles {
+    struct CaptureRegion region; // all zero if the hashes haven't been filled in yet
+    uint64_t generation; // value of capture_generation when this was last updated
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    uint64_t* hashes;
+    uint8_t dirty[CAPTURE_TILE_BITMAP_SIZE]; // tiles that changed between the last two captures
+};
+static struct CaptureTiles* capture_tiles; // indexed the same as capture_state.regions
+static size_t capture_tiles_capacity;
+static uint64_t capture_generation; // incremented every time a capture is written to the shm
 
 /* 0 indicates no window */
 static uint64_t last_mouseevent_window_id = 0;
@@ -114,16 +332,35 @@ uint64_t _bolt_plugin_get_last_mouseevent_windowid() { return last_mouseevent_wi
 // a currently-running plugin.
 // note "path" is not null-terminated, and must always be converted to use '/' as path-separators
 // and must always end with a trailing separator by the time it's received by this process.
+struct PluginCallbackStats {
+    uint64_t calls;
+    uint64_t total_nanos;
+    uint64_t max_nanos;
+};
+
 struct Plugin {
     lua_State* state;
     uint64_t id; // refers to this specific activation of the plugin, not the plugin in general
     struct hashmap* external_browsers;
     size_t ext_browser_capture_count;
+    struct hashmap* workers;
     char* path;
     uint32_t path_length;
     char* config_path;
     uint32_t config_path_length;
+    uint32_t callback_interest; // bitmask of PLUGIN_CALLBACK_* values for callbacks this plugin has set
     uint8_t is_deleted;
+
+    // callback timing since the last IPC_MSG_PLUGINSTATS, indexed by IPC_PLUGINSTAT_*
+    struct PluginCallbackStats stats[IPC_PLUGINSTAT_COUNT];
+    uint32_t frames_over_budget;
+    uint32_t frames_throttled;
+    // total callback time allowed per frame, set by the plugin, or 0 if there's no limit
+    uint64_t budget_nanos;
+    uint64_t frame_nanos; // total callback time so far this frame
+    uint32_t over_budget_streak; // number of consecutive frames that have ended over budget
+    uint8_t is_throttled; // if true, this plugin's callbacks are skipped for the rest of this frame
+    uint8_t budget_warned;
 };
 
 struct ExternalBrowser {
@@ -133,15 +370,117 @@ struct ExternalBrowser {
     uint8_t do_capture;
     uint8_t capture_ready;
     uint64_t capture_id;
+    struct CaptureRequest capture;
 };
 
+// the start of this is also declared to the ffi in buffer_view_chunk, so the two have to be kept in sync
 struct FixedBuffer {
     void* data;
     size_t size;
+    uint8_t storage; // one of BUFFER_STORAGE_*, saying what has to be done with data when it's released
+    uint8_t pool_class; // for BUFFER_STORAGE_POOLED, which size class data came from
+    struct IPCMessage* message; // for BUFFER_STORAGE_MESSAGE, the message that data points into
+};
+#define BUFFER_STORAGE_MALLOC 0
+#define BUFFER_STORAGE_MAPPED 1 // came from _bolt_plugin_file_map
+#define BUFFER_STORAGE_POOLED 2 // a block from buffer_pool, which is an ordinary malloc'd block underneath
+#define BUFFER_STORAGE_MESSAGE 3 // part of an IPCMessage, which the buffer now owns
+
+// free blocks for buffers holding messages from browsers, which plugins can get dozens of per second,
+// so that they don't each cost a malloc and a free. class N holds blocks of (BUFFER_POOL_MIN_SIZE << N)
+// bytes, up to BUFFER_POOL_MAX_SIZE, and each free block's first bytes point to the next one. messages
+// bigger than the largest class don't need the pool, since their buffers take over the IPCMessage they
+// arrived in instead. render thread only, since pooled buffers are only ever made and collected there
+#define BUFFER_POOL_MIN_SIZE 256
+#define BUFFER_POOL_CLASSES 9
+#define BUFFER_POOL_MAX_SIZE (BUFFER_POOL_MIN_SIZE << (BUFFER_POOL_CLASSES - 1))
+#define BUFFER_POOL_MAX_FREE 16 // any more free blocks than this in one class are actually freed
+static void* buffer_pool[BUFFER_POOL_CLASSES];
+static size_t buffer_pool_free_count[BUFFER_POOL_CLASSES];
+
+// a message on its way to or from a worker. the message owns `data`, which is malloc'd, until it
+// gets handed to lua as a Buffer.
+struct WorkerMessage {
+    struct WorkerMessage* next;
+    void* data;
+    size_t size;
+};
+
+// a lua state created by bolt.createworker, which runs on its own thread. the state is created and
+// closed by the plugin's thread, but in between, it's used only by the worker's thread. everything
+// after `thread` is protected by thread.lock.
+struct Worker {
+    uint64_t id;
+    uint64_t plugin_id;
+    lua_State* state;
+    uint8_t is_deleted; // set by worker:close(), only used by the plugin's thread
+    struct BoltThread thread;
+    struct WorkerMessage* inbox_head; // sent by the plugin, waiting to be handled by the worker
+    struct WorkerMessage* inbox_tail;
+    struct WorkerMessage* outbox_head; // sent by the worker, waiting to be handled by the plugin
+    struct WorkerMessage* outbox_tail;
+    uint8_t stopping; // the worker should exit as soon as possible
+    uint8_t failed; // the worker exited because of an error
+};
+
+// a RenderBatch2D made by batch:snapshot(), whose vtables point at its own copy of the batch's
+// vertices and texture details instead of at live GL state. it lives in a single userdata, laid out
+// as a FrameEventHeader, then this struct, then the arrays it points to.
+struct Batch2DSnapshot {
+    struct RenderBatch2D batch;
+    size_t vertex_count;
+    size_t texture_id;
+    size_t texture_size[2];
+    int32_t* xy; // 2 per vertex
+    int32_t* atlas_xy; // 2 per vertex
+    int32_t* atlas_wh; // 2 per vertex
+    float* uv; // 2 per vertex
+    float* colour; // 4 per vertex
+};
+
+// the Render3D equivalent of Batch2DSnapshot. atlas_xywh results are stored for each distinct
+// meta-ID, with `metas` sorted so they can be looked up with bsearch.
+#define SNAPSHOT_BONE_COUNT 129
+struct Render3DSnapshot {
+    struct Render3D render;
+    size_t vertex_count;
+    size_t texture_id;
+    size_t texture_size[2];
+    struct Transform3D model_matrix;
+    struct Transform3D viewproj_matrix;
+    float* bone_palette; // 12 floats per bone for SNAPSHOT_BONE_COUNT bones, or NULL if not animated
+    size_t meta_count;
+    uint32_t* metas;
+    int32_t* meta_xywh; // 4 per meta-ID
+    float* xyz; // 3 per vertex
+    uint32_t* meta; // 1 per vertex
+    float* uv; // 2 per vertex
+    float* colour; // 4 per vertex
+    uint32_t* bone_id; // 1 per vertex
+};
+
+// start of the userdata objects used by DEFINE_FRAME_CALLBACK, which is followed by the event
+struct FrameEventHeader {
+    uint64_t valid; // 64 bits so that the event after it is aligned
 };
 
 static void _bolt_plugin_ipc_init(BoltSocketType*);
 static void _bolt_plugin_ipc_close(BoltSocketType);
+static void _bolt_ipc_thread_main(void*);
+static void _bolt_ipc_message_discard(struct IPCMessage*);
+static void _bolt_loader_thread_main(void*);
+static void _bolt_process_plugin_loads();
+static void _bolt_free_plugin_loads(struct PluginLoad*);
+static void _bolt_plugin_cancel_load(uint64_t uid);
+static void _bolt_io_thread_main(void*);
+static void _bolt_process_file_jobs();
+static void _bolt_free_file_jobs(struct FileJob*);
+static void _bolt_png_decoder_main(void*);
+static void _bolt_process_png_jobs();
+static void _bolt_free_png_jobs(struct PngJob*);
+static void _bolt_image_cache_remove(struct DecodedImage*);
+static int _bolt_image_map_compare(const void*, const void*, void*);
+static uint64_t _bolt_image_map_hash(const void*, uint64_t, uint64_t);
 
 static void _bolt_plugin_window_onreposition(struct EmbeddedWindow*, struct RepositionEvent*);
 static void _bolt_plugin_window_onmousemotion(struct EmbeddedWindow*, struct MouseMotionEvent*);
@@ -155,13 +494,23 @@ static void _bolt_plugin_handle_mousebuttonup(struct MouseButtonEvent*);
 static void _bolt_plugin_handle_scroll(struct MouseScrollEvent*);
 
 static void _bolt_plugin_stop(uint64_t id);
+static void _bolt_plugin_notify_stopped(uint64_t id);
 static void _bolt_plugin_handle_swapbuffers(struct SwapBuffersEvent*);
+static void _bolt_worker_stop(struct Worker*);
+static void _bolt_worker_free(struct Worker*);
 
 void _bolt_plugin_free(struct Plugin* plugin) {
+    // tell all the workers to stop before waiting for any of them, so they can all stop at once
+    size_t iter = 0;
+    void* item;
+    while (hashmap_iter(plugin->workers, &iter, &item)) _bolt_worker_stop(*(struct Worker**)item);
+    iter = 0;
+    while (hashmap_iter(plugin->workers, &iter, &item)) _bolt_worker_free(*(struct Worker**)item);
+    hashmap_free(plugin->workers);
     hashmap_free(plugin->external_browsers);
     free(plugin->path);
     free(plugin->config_path);
-    lua_close(plugin->state);
+    if (plugin->state) lua_close(plugin->state);
     free(plugin);
 }
 
@@ -186,15 +535,54 @@ static uint64_t _bolt_plugin_map_hash(const void* item, uint64_t seed0, uint64_t
 
 static struct hashmap* plugins;
 
+// bitwise-or of callback_interest for every plugin that's still running
+static uint32_t callback_interest = 0;
+
+static void _bolt_plugin_update_callback_interest() {
+    uint32_t interest = 0;
+    size_t iter = 0;
+    void* item;
+    while (hashmap_iter(plugins, &iter, &item)) {
+        const struct Plugin* plugin = *(struct Plugin* const*)item;
+        if (!plugin->is_deleted) interest |= plugin->callback_interest;
+    }
+    callback_interest = interest;
+}
+
+uint32_t _bolt_plugin_callback_interest() {
+    return callback_interest;
+}
+
+// macro for defining function "api_on*", which sets the plugin's callback for an event type
+#define DEFINE_CALLBACK_SETTER(APINAME, REGNAME) \
+static int api_on##APINAME(lua_State* state) { \
+    luaL_checkany(state, 1); \
+    lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME); \
+    struct Plugin* plugin = lua_touserdata(state, -1); \
+    lua_pop(state, 1); \
+    lua_pushliteral(state, REGNAME##_CB_REGISTRYNAME); \
+    if (lua_isfunction(state, 1)) { \
+        lua_pushvalue(state, 1); \
+        plugin->callback_interest |= PLUGIN_CALLBACK_##REGNAME; \
+    } else { \
+        lua_pushnil(state); \
+        plugin->callback_interest &= ~PLUGIN_CALLBACK_##REGNAME; \
+    } \
+    lua_settable(state, LUA_REGISTRYINDEX); \
+    _bolt_plugin_update_callback_interest(); \
+    return 0; \
+}
+
 // macro for defining callback functions "_bolt_plugin_handle_*" and "api_on*"
-// e.g. DEFINE_CALLBACK(swapbuffers, SWAPBUFFERS, SwapBuffersEvent)
+// e.g. DEFINE_CALLBACK(mousemotion, MOUSEMOTION, MouseMotionEvent)
 #define DEFINE_CALLBACK(APINAME, REGNAME, STRUCTNAME) \
 void _bolt_plugin_handle_##APINAME(struct STRUCTNAME* e) { \
+    if (!(callback_interest & PLUGIN_CALLBACK_##REGNAME)) return; \
     size_t iter = 0; \
     void* item; \
     while (hashmap_iter(plugins, &iter, &item)) { \
         struct Plugin* plugin = *(struct Plugin* const*)item; \
-        if (plugin->is_deleted) continue; \
+        if (plugin->is_deleted || !(plugin->callback_interest & PLUGIN_CALLBACK_##REGNAME)) continue; \
         void* newud = lua_newuserdata(plugin->state, sizeof(struct STRUCTNAME)); /*stack: userdata*/ \
         memcpy(newud, e, sizeof(struct STRUCTNAME)); \
         lua_getfield(plugin->state, LUA_REGISTRYINDEX, REGNAME##_META_REGISTRYNAME); /*stack: userdata, metatable*/ \
@@ -206,7 +594,10 @@ void _bolt_plugin_handle_##APINAME(struct STRUCTNAME* e) { \
             continue; \
         } \
         lua_pushvalue(plugin->state, -2); /*stack: userdata, callback, userdata*/ \
-        if (lua_pcall(plugin->state, 1, 0, 0)) { /*stack: userdata, ?error*/ \
+        const uint64_t start = plugin_timer_start(); \
+        const int err = lua_pcall(plugin->state, 1, 0, 0); /*stack: userdata, ?error*/ \
+        plugin_timer_end(plugin, IPC_PLUGINSTAT_##REGNAME, start); \
+        if (err) { \
             const char* e = lua_tolstring(plugin->state, -1, 0); \
             printf("plugin callback " #APINAME " error: %s\n", e); \
             lua_pop(plugin->state, 2); /*stack: (empty)*/ \
@@ -218,20 +609,51 @@ void _bolt_plugin_handle_##APINAME(struct STRUCTNAME* e) { \
         } \
     } \
 } \
-static int api_on##APINAME(lua_State* state) { \
-    luaL_checkany(state, 1); \
-    lua_pushliteral(state, REGNAME##_CB_REGISTRYNAME); \
-    if (lua_isfunction(state, 1)) { \
-        lua_pushvalue(state, 1); \
-    } else { \
-        lua_pushnil(state); \
+DEFINE_CALLBACK_SETTER(APINAME, REGNAME)
+
+// same as DEFINE_CALLBACK, but for events that happen many times per frame, or at least once per
+// frame. instead of allocating a new userdata for every call, each plugin has one userdata per
+// event type which gets reused every time, so the render path doesn't create any garbage. this is
+// only possible because these event objects are only valid during the callback anyway, since they
+// point into the renderer's state; the userdata gets marked invalid as soon as the callback
+// returns, so using one that a plugin kept hold of is a lua error instead of undefined behaviour.
+// the functions of these objects must use require_frame_event instead of require_self_userdata.
+#define DEFINE_FRAME_CALLBACK(APINAME, REGNAME, STRUCTNAME) \
+void _bolt_plugin_handle_##APINAME(struct STRUCTNAME* e) { \
+    if (!(callback_interest & PLUGIN_CALLBACK_##REGNAME)) return; \
+    size_t iter = 0; \
+    void* item; \
+    while (hashmap_iter(plugins, &iter, &item)) { \
+        struct Plugin* plugin = *(struct Plugin* const*)item; \
+        if (plugin->is_deleted || !(plugin->callback_interest & PLUGIN_CALLBACK_##REGNAME)) continue; \
+        if (plugin->is_throttled && PLUGIN_CALLBACK_##REGNAME != PLUGIN_CALLBACK_SWAPBUFFERS) continue; \
+        lua_pushliteral(plugin->state, REGNAME##_CB_REGISTRYNAME); /*stack: enumname*/ \
+        lua_gettable(plugin->state, LUA_REGISTRYINDEX); /*stack: callback*/ \
+        if (!lua_isfunction(plugin->state, -1)) { \
+            lua_pop(plugin->state, 1); \
+            continue; \
+        } \
+        struct FrameEventHeader* header = get_frame_event(plugin->state, REGNAME##_EVENT_REGISTRYNAME, REGNAME##_META_REGISTRYNAME, sizeof(struct STRUCTNAME)); /*stack: callback, userdata*/ \
+        memcpy(header + 1, e, sizeof(struct STRUCTNAME)); \
+        header->valid = true; \
+        const uint64_t start = plugin_timer_start(); \
+        const int err = lua_pcall(plugin->state, 1, 0, 0); /*stack: ?error*/ \
+        plugin_timer_end(plugin, IPC_PLUGINSTAT_##REGNAME, start); \
+        header->valid = false; \
+        if (err) { \
+            const char* e = lua_tolstring(plugin->state, -1, 0); \
+            printf("plugin callback " #APINAME " error: %s\n", e); \
+            lua_pop(plugin->state, 1); /*stack: (empty)*/ \
+            _bolt_plugin_stop(plugin->id); \
+            _bolt_plugin_notify_stopped(plugin->id); \
+            break; \
+        } \
     } \
-    lua_settable(state, LUA_REGISTRYINDEX); \
-    return 0; \
-}
+} \
+DEFINE_CALLBACK_SETTER(APINAME, REGNAME)
 
-// same as DEFINE_CALLBACK except _bolt_plugin_handle_... will be defined as static
-#define DEFINE_CALLBACK_STATIC(APINAME, REGNAME, STRUCTNAME) static DEFINE_CALLBACK(APINAME, REGNAME, STRUCTNAME)
+// same as DEFINE_FRAME_CALLBACK except _bolt_plugin_handle_... will be defined as static
+#define DEFINE_FRAME_CALLBACK_STATIC(APINAME, REGNAME, STRUCTNAME) static DEFINE_FRAME_CALLBACK(APINAME, REGNAME, STRUCTNAME)
 
 // macro for defining function "api_window_on*" and "_bolt_plugin_window_on*"
 // e.g. DEFINE_WINDOWEVENT(resize, RESIZE, ResizeEvent)
@@ -258,9 +680,12 @@ void _bolt_plugin_window_on##APINAME(struct EmbeddedWindow* window, struct EVNAM
     if (window->is_browser) { \
         const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_EV##REGNAME; \
         const struct BoltIPCEvHeader header = { .plugin_id = window->plugin_id, .window_id = window->id }; \
-        _bolt_ipc_send(fd, &msg_type, sizeof(msg_type)); \
-        _bolt_ipc_send(fd, &header, sizeof(header)); \
-        _bolt_ipc_send(fd, event, sizeof(struct EVNAME)); \
+        const struct BoltIPCBuffer buffers[] = { \
+            {.data = &msg_type, .len = sizeof(msg_type)}, \
+            {.data = &header, .len = sizeof(header)}, \
+            {.data = event, .len = sizeof(struct EVNAME)}, \
+        }; \
+        _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers)); \
         return; \
     } \
     lua_getfield(state, LUA_REGISTRYINDEX, WINDOWS_REGISTRYNAME); /*stack: window table*/ \
@@ -307,6 +732,330 @@ static void* require_self_userdata(lua_State* state, const char* apiname) {
     return ret;
 }
 
+// same as require_self_userdata, but for event objects from DEFINE_FRAME_CALLBACK. returns a
+// pointer to the event, and errors if the object is being used outside of its callback.
+static void* require_frame_event(lua_State* state, const char* apiname) {
+    struct FrameEventHeader* header = require_self_userdata(state, apiname);
+    if (!header->valid) {
+        lua_pushfstring(state, "%s: this object is no longer valid, since the callback it was given to has returned", apiname);
+        lua_error(state);
+    }
+    return header + 1;
+}
+
+// pushes this plugin's reusable userdata for an event type, creating it if this is the first time
+static struct FrameEventHeader* get_frame_event(lua_State* state, const char* regname, const char* metaname, size_t event_size) {
+    lua_getfield(state, LUA_REGISTRYINDEX, regname);
+    struct FrameEventHeader* header = lua_touserdata(state, -1);
+    if (header) return header;
+    lua_pop(state, 1);
+    header = lua_newuserdata(state, sizeof(struct FrameEventHeader) + event_size);
+    header->valid = false;
+    lua_getfield(state, LUA_REGISTRYINDEX, metaname);
+    lua_setmetatable(state, -2);
+    lua_pushvalue(state, -1);
+    lua_setfield(state, LUA_REGISTRYINDEX, regname);
+    return header;
+}
+
+// pushes a new Buffer object which takes ownership of `data`, which must have been malloc'd
+static struct FixedBuffer* push_buffer(lua_State* state, void* data, size_t size) {
+    struct FixedBuffer* buffer = lua_newuserdata(state, sizeof(struct FixedBuffer));
+    buffer->data = data;
+    buffer->size = size;
+    buffer->storage = BUFFER_STORAGE_MALLOC;
+    buffer->pool_class = 0;
+    buffer->message = NULL;
+    lua_getfield(state, LUA_REGISTRYINDEX, BUFFER_META_REGISTRYNAME);
+    lua_setmetatable(state, -2);
+    return buffer;
+}
+
+// pushes a new Buffer object of at most BUFFER_POOL_MAX_SIZE bytes, using a block from the pool if there
+// is one, and returns its data for the caller to fill in. returns NULL, having pushed nothing, if out of memory
+static void* push_pooled_buffer(lua_State* state, size_t size) {
+    uint8_t pool_class = 0;
+    while ((BUFFER_POOL_MIN_SIZE << pool_class) < size) pool_class += 1;
+    void* data = buffer_pool[pool_class];
+    if (data) {
+        memcpy(&buffer_pool[pool_class], data, sizeof(void*));
+        buffer_pool_free_count[pool_class] -= 1;
+    } else {
+        data = malloc(BUFFER_POOL_MIN_SIZE << pool_class);
+        if (!data) return NULL;
+    }
+    struct FixedBuffer* buffer = push_buffer(state, data, size);
+    buffer->storage = BUFFER_STORAGE_POOLED;
+    buffer->pool_class = pool_class;
+    return data;
+}
+
+// frees a buffer's data, or gives it back to wherever it came from, and leaves the buffer empty
+static void buffer_release(struct FixedBuffer* buffer) {
+    switch (buffer->storage) {
+        case BUFFER_STORAGE_MAPPED:
+            _bolt_plugin_file_unmap(buffer->data, buffer->size);
+            break;
+        case BUFFER_STORAGE_POOLED:
+            if (buffer_pool_free_count[buffer->pool_class] < BUFFER_POOL_MAX_FREE) {
+                memcpy(buffer->data, &buffer_pool[buffer->pool_class], sizeof(void*));
+                buffer_pool[buffer->pool_class] = buffer->data;
+                buffer_pool_free_count[buffer->pool_class] += 1;
+            } else {
+                free(buffer->data);
+            }
+            break;
+        case BUFFER_STORAGE_MESSAGE:
+            free(buffer->message);
+            break;
+        default:
+            free(buffer->data);
+            break;
+    }
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->storage = BUFFER_STORAGE_MALLOC;
+    buffer->message = NULL;
+}
+
+// errors if the `length` bytes at `offset` aren't all inside the buffer
+static void check_buffer_range(lua_State* state, const struct FixedBuffer* buffer, long offset, long length, const char* apiname) {
+    if (offset < 0 || length < 0 || (size_t)offset + (size_t)length > buffer->size) {
+        lua_pushfstring(state, "%s: %d bytes at offset %d is out of bounds for a buffer of size %d", apiname, (int)length, (int)offset, (int)buffer->size);
+        lua_error(state);
+    }
+}
+
+// gets the contents of a message to be sent to or from a worker, as a malloc'd block of memory.
+// buffers are handed over without copying, leaving the buffer empty, and strings are copied.
+static void take_message_data(lua_State* state, int n, const char* apiname, void** data, size_t* size) {
+    if (lua_isuserdata(state, n)) {
+        struct FixedBuffer* buffer = lua_touserdata(state, n);
+        *size = buffer->size;
+        if (buffer->storage == BUFFER_STORAGE_MALLOC || buffer->storage == BUFFER_STORAGE_POOLED) {
+            // pooled blocks are malloc'd like any other, they just don't go back to the pool this way
+            *data = buffer->data;
+            buffer->data = NULL;
+            buffer->storage = BUFFER_STORAGE_MALLOC;
+        } else {
+            // mapped files and messages can't be given away as a malloc'd block, so they're copied
+            *data = malloc(*size ? *size : 1);
+            if (!*data) {
+                lua_pushfstring(state, "%s: heap error, failed to allocate %d bytes", apiname, (int)*size);
+                lua_error(state);
+            }
+            memcpy(*data, buffer->data, *size);
+        }
+        buffer_release(buffer);
+        return;
+    }
+    const char* str = luaL_checklstring(state, n, size);
+    *data = malloc(*size ? *size : 1);
+    if (!*data) {
+        lua_pushfstring(state, "%s: heap error, failed to allocate %d bytes", apiname, (int)*size);
+        lua_error(state);
+    }
+    memcpy(*data, str, *size);
+}
+
+// checks the (first, count, [buffer, offset]) params of the bulk vertex functions, with `first`
+// being 1-indexed in lua. if a buffer was given, checks it's big enough and returns a pointer into
+// it where the records should be written, otherwise returns NULL, meaning a table should be made.
+static uint8_t* check_vertex_range(lua_State* state, const char* apiname, size_t vertex_count, size_t record_size, size_t* first, size_t* count) {
+    const lua_Integer lfirst = luaL_checkinteger(state, 2);
+    const lua_Integer lcount = luaL_checkinteger(state, 3);
+    if (lfirst < 1 || lcount < 0 || (size_t)(lfirst - 1) + (size_t)lcount > vertex_count) {
+        lua_pushfstring(state, "%s: vertex range is out of bounds", apiname);
+        lua_error(state);
+    }
+    *first = lfirst - 1;
+    *count = lcount;
+    if (lua_isnoneornil(state, 4)) return NULL;
+    const struct FixedBuffer* buffer = require_userdata(state, 4, apiname);
+    const lua_Integer offset = luaL_optinteger(state, 5, 0);
+    if (offset < 0 || (size_t)offset + (*count * record_size) > buffer->size) {
+        lua_pushfstring(state, "%s: buffer is too small for %d vertices at offset %d", apiname, (int)*count, (int)offset);
+        lua_error(state);
+    }
+    return (uint8_t*)buffer->data + offset;
+}
+
+// handles the (x, y, len, [buffer, offset]) params of texturedata. without a buffer, pushes the data as a
+// string, or nil if it isn't available. with one, copies it into the buffer and pushes whether it could.
+static int push_texture_data(lua_State* state, const struct TextureFunctions* functions, const char* apiname) {
+    const size_t x = luaL_checkinteger(state, 2);
+    const size_t y = luaL_checkinteger(state, 3);
+    const size_t len = luaL_checkinteger(state, 4);
+    uint8_t* out = NULL;
+    if (!lua_isnoneornil(state, 5)) {
+        const struct FixedBuffer* buffer = require_userdata(state, 5, apiname);
+        const long offset = luaL_optlong(state, 6, 0);
+        check_buffer_range(state, buffer, offset, (long)len, apiname);
+        out = (uint8_t*)buffer->data + offset;
+    }
+    const uint8_t* ret = functions->data(functions->userdata, x, y, len);
+    if (out) {
+        if (ret) memcpy(out, ret, len);
+        lua_pushboolean(state, ret != NULL);
+    } else if (ret) {
+        lua_pushlstring(state, (const char*)ret, len);
+    } else {
+        lua_pushnil(state);
+    }
+    return 1;
+}
+
+// pushes the hash of an atlas image as a 16-character hex string, or nil if it isn't available
+static void push_texture_hash(lua_State* state, const struct TextureFunctions* functions, const int32_t* xywh, uint8_t perceptual) {
+    uint64_t hash;
+    if (xywh[0] < 0 || xywh[1] < 0 || xywh[2] <= 0 || xywh[3] <= 0 || !functions->hash(functions->userdata, xywh[0], xywh[1], xywh[2], xywh[3], perceptual, &hash)) {
+        lua_pushnil(state);
+        return;
+    }
+    char str[17];
+    snprintf(str, sizeof(str), "%016llx", (unsigned long long)hash);
+    lua_pushlstring(state, str, 16);
+}
+
+// pushes a flat table of every 4-byte value in `count` records. bit N of `int_mask` being set means
+// the Nth value in each record is an int32_t, otherwise it's a float.
+static void push_vertex_table(lua_State* state, const uint8_t* records, size_t count, size_t values_per_record, uint32_t int_mask) {
+    lua_createtable(state, count * values_per_record, 0);
+    int n = 1;
+    for (size_t i = 0; i < count; i += 1) {
+        for (size_t v = 0; v < values_per_record; v += 1) {
+            const uint8_t* ptr = records + (((i * values_per_record) + v) * 4);
+            if (int_mask & (1 << v)) {
+                int32_t value;
+                memcpy(&value, ptr, sizeof(value));
+                lua_pushinteger(state, value);
+            } else {
+                float value;
+                memcpy(&value, ptr, sizeof(value));
+                lua_pushnumber(state, value);
+            }
+            lua_rawseti(state, -2, n);
+            n += 1;
+        }
+    }
+}
+
+// sets `out` to a transform which does the same thing as applying `first` and then `second`
+static void combine_transforms(const struct Transform3D* first, const struct Transform3D* second, struct Transform3D* out) {
+    for (size_t col = 0; col < 4; col += 1) {
+        for (size_t row = 0; row < 4; row += 1) {
+            double value = 0.0;
+            for (size_t k = 0; k < 4; k += 1) value += second->matrix[(k * 4) + row] * first->matrix[(col * 4) + k];
+            out->matrix[(col * 4) + row] = value;
+        }
+    }
+}
+
+// bulk point projection is done a block at a time with X Y Z and W in separate arrays, so that the
+// matrix maths has no branches, gathers or strided loads in it and each step covers a whole vector of
+// points. callers fill in x, y and z, then call project_block.
+#define PROJECT_BLOCK_SIZE 64
+struct ProjectBlock {
+    float x[PROJECT_BLOCK_SIZE];
+    float y[PROJECT_BLOCK_SIZE];
+    float z[PROJECT_BLOCK_SIZE];
+    float w[PROJECT_BLOCK_SIZE];
+};
+
+// gets the game view rect in the form project_block wants: x, y, half-width, half-height
+static void project_view(float* view) {
+    int game_view_x, game_view_y, game_view_w, game_view_h;
+    managed_functions.game_view_rect(&game_view_x, &game_view_y, &game_view_w, &game_view_h);
+    view[0] = (float)game_view_x;
+    view[1] = (float)game_view_y;
+    view[2] = game_view_w / 2.0f;
+    view[3] = game_view_h / 2.0f;
+}
+
+// projects points `first` to `n` of the block one at a time. this is the whole of project_block on
+// CPUs without SIMD kernels, and the leftover points after the last full vector on CPUs with them.
+static void project_block_scalar(struct ProjectBlock* block, size_t first, size_t n, const float* m, const float* view) {
+    for (size_t i = first; i < n; i += 1) {
+        const float x = block->x[i], y = block->y[i], z = block->z[i];
+        const float cx = (m[0] * x) + (m[4] * y) + (m[8] * z) + m[12];
+        const float cy = (m[1] * x) + (m[5] * y) + (m[9] * z) + m[13];
+        const float cz = (m[2] * x) + (m[6] * y) + (m[10] * z) + m[14];
+        const float cw = (m[3] * x) + (m[7] * y) + (m[11] * z) + m[15];
+        block->x[i] = (((cx / cw) + 1.0f) * view[2]) + view[0];
+        block->y[i] = (((-cy / cw) + 1.0f) * view[3]) + view[1];
+        block->z[i] = cz;
+        block->w[i] = cw;
+    }
+}
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BOLT_HAVE_PROJECT_BLOCK_SIMD
+// these do the same operations in the same order as project_block_scalar, so they give the same
+// results as it does. they return how many points they did, which leaves the rest for the scalar one.
+__attribute__((target("sse"))) static size_t project_block_sse(struct ProjectBlock* block, size_t n, const float* m, const float* view) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    size_t i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        const __m128 x = _mm_loadu_ps(block->x + i), y = _mm_loadu_ps(block->y + i), z = _mm_loadu_ps(block->z + i);
+        const __m128 cx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), x), _mm_mul_ps(_mm_set1_ps(m[4]), y)), _mm_mul_ps(_mm_set1_ps(m[8]), z)), _mm_set1_ps(m[12]));
+        const __m128 cy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[1]), x), _mm_mul_ps(_mm_set1_ps(m[5]), y)), _mm_mul_ps(_mm_set1_ps(m[9]), z)), _mm_set1_ps(m[13]));
+        const __m128 cz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2]), x), _mm_mul_ps(_mm_set1_ps(m[6]), y)), _mm_mul_ps(_mm_set1_ps(m[10]), z)), _mm_set1_ps(m[14]));
+        const __m128 cw = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[3]), x), _mm_mul_ps(_mm_set1_ps(m[7]), y)), _mm_mul_ps(_mm_set1_ps(m[11]), z)), _mm_set1_ps(m[15]));
+        _mm_storeu_ps(block->x + i, _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_div_ps(cx, cw), one), _mm_set1_ps(view[2])), _mm_set1_ps(view[0])));
+        _mm_storeu_ps(block->y + i, _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_div_ps(_mm_xor_ps(cy, sign), cw), one), _mm_set1_ps(view[3])), _mm_set1_ps(view[1])));
+        _mm_storeu_ps(block->z + i, cz);
+        _mm_storeu_ps(block->w + i, cw);
+    }
+    return i;
+}
+
+__attribute__((target("avx"))) static size_t project_block_avx(struct ProjectBlock* block, size_t n, const float* m, const float* view) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    size_t i;
+    for (i = 0; i + 8 <= n; i += 8) {
+        const __m256 x = _mm256_loadu_ps(block->x + i), y = _mm256_loadu_ps(block->y + i), z = _mm256_loadu_ps(block->z + i);
+        const __m256 cx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0]), x), _mm256_mul_ps(_mm256_set1_ps(m[4]), y)), _mm256_mul_ps(_mm256_set1_ps(m[8]), z)), _mm256_set1_ps(m[12]));
+        const __m256 cy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[1]), x), _mm256_mul_ps(_mm256_set1_ps(m[5]), y)), _mm256_mul_ps(_mm256_set1_ps(m[9]), z)), _mm256_set1_ps(m[13]));
+        const __m256 cz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[2]), x), _mm256_mul_ps(_mm256_set1_ps(m[6]), y)), _mm256_mul_ps(_mm256_set1_ps(m[10]), z)), _mm256_set1_ps(m[14]));
+        const __m256 cw = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[3]), x), _mm256_mul_ps(_mm256_set1_ps(m[7]), y)), _mm256_mul_ps(_mm256_set1_ps(m[11]), z)), _mm256_set1_ps(m[15]));
+        _mm256_storeu_ps(block->x + i, _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(cx, cw), one), _mm256_set1_ps(view[2])), _mm256_set1_ps(view[0])));
+        _mm256_storeu_ps(block->y + i, _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(_mm256_xor_ps(cy, sign), cw), one), _mm256_set1_ps(view[3])), _mm256_set1_ps(view[1])));
+        _mm256_storeu_ps(block->z + i, cz);
+        _mm256_storeu_ps(block->w + i, cw);
+    }
+    return i;
+}
+#endif
+
+// transforms the first `n` points in the block by `m`, then replaces X and Y with pixel positions
+// as Point:aspixels() would give them. Z and W are left in clip space.
+static void project_block(struct ProjectBlock* block, size_t n, const float* m, const float* view) {
+    size_t done = 0;
+#if defined(BOLT_HAVE_PROJECT_BLOCK_SIMD)
+    if (__builtin_cpu_supports("avx")) done = project_block_avx(block, n, m, view);
+    else if (__builtin_cpu_supports("sse")) done = project_block_sse(block, n, m, view);
+#endif
+    project_block_scalar(block, done, n, m, view);
+}
+
+// gets the optional "interval" argument to enablecapture, in milliseconds, and returns it in microseconds
+static uint64_t opt_capture_interval(lua_State* state) {
+    const lua_Number interval_ms = luaL_optnumber(state, 2, DEFAULT_CAPTURE_INTERVAL_MICROS / 1000.0);
+    return interval_ms > 0.0 ? (uint64_t)(interval_ms * 1000.0) : 0;
+}
+
+// reads the arguments to setcaptureregion into a browser's capture request
+static void check_capture_region(lua_State* state, struct CaptureRequest* request) {
+    request->x = luaL_optinteger(state, 2, 0);
+    request->y = luaL_optinteger(state, 3, 0);
+    request->width = luaL_optinteger(state, 4, 0);
+    request->height = luaL_optinteger(state, 5, 0);
+    request->scale = luaL_optinteger(state, 6, 1);
+}
+
 static int surface_gc(lua_State* state) {
     const struct SurfaceFunctions* functions = lua_touserdata(state, 1);
     managed_functions.surface_destroy(functions->userdata);
@@ -314,8 +1063,7 @@ static int surface_gc(lua_State* state) {
 }
 
 static int buffer_gc(lua_State* state) {
-    const struct FixedBuffer* buffer = lua_touserdata(state, 1);
-    free(buffer->data);
+    buffer_release(lua_touserdata(state, 1));
     return 0;
 }
 
@@ -335,15 +1083,89 @@ void _bolt_plugin_on_startup() {
 void _bolt_plugin_init(const struct PluginManagedFunctions* functions) {
     _bolt_plugin_ipc_init(&fd);
 
+    const size_t ring_shm_size = BOLT_IPC_RING_SHM_SIZE(BOLT_IPC_RING_CAPACITY);
+    ipc_ring_inited = _bolt_plugin_shm_open_outbound(&ipc_ring_shm, ring_shm_size, "ipc", 0);
+    if (ipc_ring_inited) _bolt_ipc_ring_init(ipc_ring_shm.file, ring_shm_size);
+
+    // always identify, even with no display name, so that the host gets a chance to accept the rings.
+    // shared textures are opt-in for now; on POSIX their fds can only be sent alongside the rings
     const char* display_name = getenv("JX_DISPLAY_NAME");
-    if (display_name && *display_name) {
-        size_t name_len = strlen(display_name);
-        const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_IDENTIFY;
-        const struct BoltIPCIdentifyHeader header = { .name_length = name_len };
-        _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-        _bolt_ipc_send(fd, &header, sizeof(header));
-        _bolt_ipc_send(fd, display_name, name_len);
+    const char* accelerated_osr = getenv("BOLT_ACCELERATED_OSR");
+    const uint8_t shared_textures = accelerated_osr && strcmp(accelerated_osr, "0") && functions->shared_texture_supported();
+    const size_t name_len = display_name ? strlen(display_name) : 0;
+    const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_IDENTIFY;
+    const struct BoltIPCIdentifyHeader header = {
+        .name_length = name_len,
+        .pid = getpid(),
+        .ring_capacity = ipc_ring_inited ? BOLT_IPC_RING_CAPACITY : 0,
+#if defined(_WIN32)
+        .shared_textures = shared_textures,
+#else
+        .shared_textures = shared_textures && ipc_ring_inited,
+#endif
+    };
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &header, .len = sizeof(header)},
+        {.data = display_name, .len = name_len},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
+
+    // from here on, messages are sent in one go at the end of each frame
+    _bolt_ipc_set_queueing(fd, true);
+
+    const char* budget = getenv("BOLT_IPC_BUDGET_MICROS");
+    ipc_budget_micros = budget ? strtoull(budget, NULL, 10) : DEFAULT_IPC_BUDGET_MICROS;
+    ipc_inbox_head = NULL;
+    ipc_inbox_tail = NULL;
+    ipc_thread_running = _bolt_plugin_thread_start(&ipc_thread, _bolt_ipc_thread_main, NULL);
+    if (!ipc_thread_running) {
+        printf("[plugin] failed to start IPC thread, messages will be read on the render thread\n");
+    }
+
+    if (!_bolt_plugin_cache_dir(bytecode_cache_dir, sizeof(bytecode_cache_dir))) {
+        printf("[plugin] no bytecode cache directory, plugins will be compiled every time they start\n");
+        bytecode_cache_dir[0] = '\0';
+    }
+    loader_stopping = false;
+    loader_inbox_head = NULL;
+    loader_inbox_tail = NULL;
+    loader_current = NULL;
+    loader_outbox_head = NULL;
+    loader_outbox_tail = NULL;
+    loader_thread_running = _bolt_plugin_thread_start(&loader_thread, _bolt_loader_thread_main, NULL);
+    if (!loader_thread_running) {
+        printf("[plugin] failed to start loader thread, plugins will be loaded on the render thread\n");
     }
+    io_stopping = false;
+    io_inbox_head = NULL;
+    io_inbox_tail = NULL;
+    io_outbox_head = NULL;
+    io_outbox_tail = NULL;
+    io_thread_running = _bolt_plugin_thread_start(&io_thread, _bolt_io_thread_main, NULL);
+    if (!io_thread_running) {
+        printf("[plugin] failed to start I/O thread, async file functions will block the render thread\n");
+    }
+    for (size_t i = 0; i < PNG_DECODER_COUNT; i += 1) {
+        struct PngDecoder* decoder = &png_decoders[i];
+        decoder->stopping = false;
+        decoder->inbox_head = NULL;
+        decoder->inbox_tail = NULL;
+        decoder->outbox_head = NULL;
+        decoder->outbox_tail = NULL;
+        decoder->running = _bolt_plugin_thread_start(&decoder->thread, _bolt_png_decoder_main, decoder);
+        if (!decoder->running) {
+            printf("[plugin] failed to start PNG decoder thread %zu\n", i);
+        }
+    }
+    next_png_decoder = 0;
+    png_pending = NULL;
+    png_ready_head = NULL;
+    png_ready_tail = NULL;
+    image_cache = hashmap_new(sizeof(struct DecodedImage*), 16, 0, 0, _bolt_image_map_hash, _bolt_image_map_compare, NULL, NULL);
+    image_cache_lru_head = NULL;
+    image_cache_lru_tail = NULL;
+    image_cache_size = 0;
 
     managed_functions = *functions;
     _bolt_rwlock_lock_write(&windows.lock);
@@ -354,7 +1176,7 @@ void _bolt_plugin_init(const struct PluginManagedFunctions* functions) {
 }
 
 static int _bolt_api_init(lua_State* state) {
-    lua_createtable(state, 0, 22);
+    lua_createtable(state, 0, 31);
     API_ADD(apiversion)
     API_ADD(checkversion)
     API_ADD(close)
@@ -364,6 +1186,9 @@ static int _bolt_api_init(lua_State* state) {
     API_ADD(loadfile)
     API_ADD(loadconfig)
     API_ADD(saveconfig)
+    API_ADD(loadfileasync)
+    API_ADD(loadconfigasync)
+    API_ADD(saveconfigasync)
     API_ADD(onrender2d)
     API_ADD(onrender3d)
     API_ADD(onminimap)
@@ -375,11 +1200,29 @@ static int _bolt_api_init(lua_State* state) {
     API_ADD(createsurface)
     API_ADD(createsurfacefromrgba)
     API_ADD(createsurfacefrompng)
+    API_ADD(createsurfacefrompngasync)
     API_ADD(createwindow)
     API_ADD(createbrowser)
     API_ADD(createembeddedbrowser)
     API_ADD(point)
     API_ADD(createbuffer)
+    API_ADD(createworker)
+    API_ADD(setframebudget)
+    return 1;
+}
+
+// the equivalent of _bolt_api_init for workers, which only get the functions that don't touch the
+// game or the plugin's state
+static int _bolt_worker_api_init(lua_State* state) {
+    lua_createtable(state, 0, 8);
+    API_ADD(apiversion)
+    API_ADD(checkversion)
+    API_ADD(time)
+    API_ADD(datetime)
+    API_ADD(weekday)
+    API_ADD(createbuffer)
+    API_ADD_SUB(state, sendmessage, inworker)
+    API_ADD_SUB(state, onmessage, inworker)
     return 1;
 }
 
@@ -404,6 +1247,44 @@ static uint8_t monotonic_microseconds(uint64_t* microseconds) {
 #endif
 }
 
+// same as monotonic_microseconds, for timing things that can take less than a microsecond
+static uint8_t monotonic_nanoseconds(uint64_t* nanoseconds) {
+#if defined(_WIN32)
+    LARGE_INTEGER ticks;
+    if (QueryPerformanceCounter(&ticks)) {
+        const uint64_t freq = performance_frequency.QuadPart;
+        *nanoseconds = ((ticks.QuadPart / freq) * 1000000000) + (((ticks.QuadPart % freq) * 1000000000) / freq);
+        return true;
+    }
+    return false;
+#else
+    struct timespec s;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &s);
+    *nanoseconds = (s.tv_sec * 1000000000) + s.tv_nsec;
+    return true;
+#endif
+}
+
+static uint64_t plugin_timer_start() {
+    uint64_t nanos = 0;
+    monotonic_nanoseconds(&nanos);
+    return nanos;
+}
+
+// records the time taken by a plugin callback that started at `start`, and starts throttling the
+// plugin if it's gone over its budget for this frame and has already been doing so persistently
+static void plugin_timer_end(struct Plugin* plugin, enum BoltIPCPluginStat stat, uint64_t start) {
+    const uint64_t elapsed = plugin_timer_start() - start;
+    struct PluginCallbackStats* stats = &plugin->stats[stat];
+    stats->calls += 1;
+    stats->total_nanos += elapsed;
+    if (elapsed > stats->max_nanos) stats->max_nanos = elapsed;
+    plugin->frame_nanos += elapsed;
+    if (plugin->budget_nanos && plugin->frame_nanos > plugin->budget_nanos && plugin->over_budget_streak >= BUDGET_THROTTLE_FRAMES) {
+        plugin->is_throttled = true;
+    }
+}
+
 // populates the window->repos_target_... variables, without accessing any of the window's mutex-protected members
 #define WINDOW_REPOSITION_THRESHOLD 6
 static void _bolt_window_calc_repos_target(struct EmbeddedWindow* window, const struct EmbeddedWindowMetadata* meta, int16_t x, int16_t y, uint32_t window_width, uint32_t window_height) {
@@ -472,14 +1353,71 @@ static void _bolt_window_calc_repos_target(struct EmbeddedWindow* window, const
     }
 }
 
-static void _bolt_process_plugins(uint8_t* need_capture, uint8_t* capture_ready) {
+// clips a browser's requested region to the window, converts it to GL coordinates, and adds it to the
+// list of regions to capture, if there isn't an identical one already. returns the region's index, or
+// CAPTURE_REGION_NONE if the list couldn't be grown.
+static size_t _bolt_capture_state_add_region(struct CaptureState* state, const struct CaptureRequest* request) {
+    const int window_width = (int)state->window_width;
+    const int window_height = (int)state->window_height;
+    struct CaptureRegion region = {.x = 0, .y = 0, .width = window_width, .height = window_height, .scale = 1};
+    if (request->width > 0 && request->height > 0) {
+        int x1 = request->x < 0 ? 0 : request->x;
+        int y1 = request->y < 0 ? 0 : request->y;
+        if (x1 >= window_width) x1 = window_width - 1;
+        if (y1 >= window_height) y1 = window_height - 1;
+        int x2 = (request->x + request->width > window_width) ? window_width : request->x + request->width;
+        int y2 = (request->y + request->height > window_height) ? window_height : request->y + request->height;
+        if (x2 <= x1) x2 = x1 + 1;
+        if (y2 <= y1) y2 = y1 + 1;
+        region.x = x1;
+        region.y = window_height - y2;
+        region.width = x2 - x1;
+        region.height = y2 - y1;
+    }
+    if (request->scale > 1) {
+        const int max_scale = region.width < region.height ? region.width : region.height;
+        region.scale = request->scale < max_scale ? request->scale : max_scale;
+    }
+
+    for (size_t i = 0; i < state->region_count; i += 1) {
+        if (!memcmp(&state->regions[i], &region, sizeof(region))) return i;
+    }
+    if (state->region_count == state->region_capacity) {
+        const size_t capacity = state->region_capacity ? state->region_capacity * 2 : 4;
+        struct CaptureRegion* regions = realloc(state->regions, capacity * sizeof(*state->regions));
+        if (!regions) return CAPTURE_REGION_NONE;
+        state->regions = regions;
+        size_t* offsets = realloc(state->offsets, capacity * sizeof(*state->offsets));
+        if (!offsets) return CAPTURE_REGION_NONE;
+        state->offsets = offsets;
+        state->region_capacity = capacity;
+    }
+    state->regions[state->region_count] = region;
+    state->offsets[state->region_count] = state->size;
+    state->size += (size_t)(region.width / region.scale) * (size_t)(region.height / region.scale) * 3;
+    return state->region_count++;
+}
+
+static void _bolt_capture_state_add(struct CaptureState* state, uint64_t micros, uint8_t ready, struct CaptureRequest* request) {
+    // a browser whose region couldn't be added just doesn't get anything this frame
+    request->region_index = _bolt_capture_state_add_region(state, request);
+    if (request->region_index == CAPTURE_REGION_NONE) return;
+    state->need_capture = true;
+    if (!ready) state->ready = false;
+    if (micros >= request->next_time) state->due = true;
+    if (request->interval_micros < state->min_interval_micros) state->min_interval_micros = request->interval_micros;
+}
+
+static void _bolt_process_plugins(uint64_t micros, struct CaptureState* capture) {
     size_t iter = 0;
     void* item;
+    uint8_t any_deleted = false;
     while (hashmap_iter(plugins, &iter, &item)) {
         struct Plugin* plugin = *(struct Plugin**)item;
         if (plugin->is_deleted) {
             hashmap_delete(plugins, &plugin);
             _bolt_plugin_free(plugin);
+            any_deleted = true;
             iter = 0;
             continue;
         }
@@ -489,70 +1427,357 @@ static void _bolt_process_plugins(uint8_t* need_capture, uint8_t* capture_ready)
         while (hashmap_iter(plugin->external_browsers, &iter2, &item2)) {
             struct ExternalBrowser* browser = *(struct ExternalBrowser**)item2;
             if (browser->do_capture) {
-                *need_capture = true;
-                if (!browser->capture_ready) *capture_ready = false;
+                _bolt_capture_state_add(capture, micros, browser->capture_ready, &browser->capture);
             }
         }
     }
+    if (any_deleted) _bolt_plugin_update_callback_interest();
+}
+
+// InputMailbox fields are shared between the thread receiving window events and the render thread,
+// so everything touching them goes through these
+#if defined(_MSC_VER)
+static uint32_t load_u32(const uint32_t* p) { return (uint32_t)InterlockedCompareExchange((volatile LONG*)p, 0, 0); }
+static void store_u32(uint32_t* p, uint32_t v) { InterlockedExchange((volatile LONG*)p, (LONG)v); }
+static uint8_t cas_u32(uint32_t* p, uint32_t* expected, uint32_t desired) {
+    const uint32_t old = (uint32_t)InterlockedCompareExchange((volatile LONG*)p, (LONG)desired, (LONG)*expected);
+    if (old == *expected) return true;
+    *expected = old;
+    return false;
 }
+static uint32_t fetch_add_u32(uint32_t* p, uint32_t v) { return (uint32_t)InterlockedExchangeAdd((volatile LONG*)p, (LONG)v); }
+static uint8_t cas_u64(uint64_t* p, uint64_t expected, uint64_t desired) { return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)p, (LONG64)desired, (LONG64)expected) == expected; }
+static void store_u64(uint64_t* p, uint64_t v) { InterlockedExchange64((volatile LONG64*)p, (LONG64)v); }
+static uint64_t exchange_u64(uint64_t* p, uint64_t v) { return (uint64_t)InterlockedExchange64((volatile LONG64*)p, (LONG64)v); }
+#else
+static uint32_t load_u32(const uint32_t* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static void store_u32(uint32_t* p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+static uint8_t cas_u32(uint32_t* p, uint32_t* expected, uint32_t desired) { return __atomic_compare_exchange_n(p, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+static uint32_t fetch_add_u32(uint32_t* p, uint32_t v) { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+static uint8_t cas_u64(uint64_t* p, uint64_t expected, uint64_t desired) { return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+static void store_u64(uint64_t* p, uint64_t v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+static uint64_t exchange_u64(uint64_t* p, uint64_t v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+#endif
 
-static void _bolt_process_embedded_windows(uint32_t window_width, uint32_t window_height, uint8_t* need_capture, uint8_t* capture_ready) {
-    _bolt_rwlock_lock_write(&windows.input_lock);
-    struct WindowPendingInput inputs = windows.input;
-    memset(&windows.input, 0, sizeof(windows.input));
-    _bolt_rwlock_unlock_write(&windows.input_lock);
-
-    if (inputs.mouse_motion) {
-        struct MouseMotionEvent event = {.details = inputs.mouse_motion_event};
-        _bolt_plugin_handle_mousemotion(&event);
-    }
-    if (inputs.mouse_left) {
-        struct MouseButtonEvent event = {.details = inputs.mouse_left_event, .button = MBLeft};
-        _bolt_plugin_handle_mousebutton(&event);
-    }
-    if (inputs.mouse_right) {
-        struct MouseButtonEvent event = {.details = inputs.mouse_right_event, .button = MBRight};
-        _bolt_plugin_handle_mousebutton(&event);
-    }
-    if (inputs.mouse_middle) {
-        struct MouseButtonEvent event = {.details = inputs.mouse_middle_event, .button = MBMiddle};
-        _bolt_plugin_handle_mousebutton(&event);
-    }
-    if (inputs.mouse_left_up) {
-        struct MouseButtonEvent event = {.details = inputs.mouse_left_up_event, .button = MBLeft};
-        _bolt_plugin_handle_mousebuttonup(&event);
+uint8_t* _bolt_plugin_texcache_open(struct BoltSHM* shm, uint64_t content_hash, uint32_t width, uint32_t height, uint32_t format, uint8_t* created) {
+    if (!texcache_owner) return NULL;
+    const size_t size = sizeof(struct BoltTextureCacheHeader) + ((size_t)width * height * 4);
+    // the same blocks could be uploaded to textures of different sizes or formats, which decode differently
+    const uint64_t id = content_hash ^ (((((uint64_t)width) << 32) | height) * 0x9E3779B97F4A7C15ULL) ^ format;
+    if (!_bolt_plugin_shm_open_shared(shm, size, "tc", texcache_owner, id, created)) return NULL;
+    struct BoltTextureCacheHeader* header = shm->file;
+    if (*created) {
+        header->width = width;
+        header->height = height;
+        header->format = format;
+        header->content_hash = content_hash;
+    } else if (!load_u32(&header->ready) || header->width != width || header->height != height || header->format != format || header->content_hash != content_hash) {
+        _bolt_plugin_shm_close(shm);
+        return NULL;
     }
-    if (inputs.mouse_right_up) {
-        struct MouseButtonEvent event = {.details = inputs.mouse_right_up_event, .button = MBRight};
-        _bolt_plugin_handle_mousebuttonup(&event);
+    return (uint8_t*)(header + 1);
+}
+
+void _bolt_plugin_texcache_publish(struct BoltSHM* shm) {
+    struct BoltTextureCacheHeader* header = shm->file;
+    store_u32(&header->ready, 1);
+    _bolt_plugin_shm_seal(shm);
+    const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_TEXCACHE_PUBLISHED;
+    const struct BoltIPCTexCachePublishedHeader published = { .id = shm->id };
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &published, .len = sizeof(published)},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
+}
+
+// a MouseEvent fits in 41 bits, so it's packed into a uint64_t along with its input type, its sequence
+// number, and a bit that's always set, so that a packed event is never 0. the sequence number wraps,
+// but a mailbox never holds more than a frame's worth of events, which is far fewer than it can count.
+#define INPUT_PACKED_PRESENT (1ULL << 63)
+#define INPUT_SEQUENCE_SHIFT 52
+#define INPUT_SEQUENCE_MASK 0x7FFu
+static uint64_t _bolt_input_pack(uint8_t input_type, uint32_t sequence, const struct MouseEvent* event) {
+    const uint64_t flags =
+        (event->ctrl ? 1 << 0 : 0) | (event->shift ? 1 << 1 : 0) | (event->meta ? 1 << 2 : 0) |
+        (event->alt ? 1 << 3 : 0) | (event->capslock ? 1 << 4 : 0) | (event->numlock ? 1 << 5 : 0) |
+        (event->mb_left ? 1 << 6 : 0) | (event->mb_right ? 1 << 7 : 0) | (event->mb_middle ? 1 << 8 : 0);
+    return INPUT_PACKED_PRESENT | ((uint64_t)(sequence & INPUT_SEQUENCE_MASK) << INPUT_SEQUENCE_SHIFT) | ((uint64_t)(input_type & 0xF) << 48) | (flags << 32) | ((uint64_t)(uint16_t)event->y << 16) | (uint64_t)(uint16_t)event->x;
+}
+
+static uint8_t _bolt_input_unpack(uint64_t packed, struct MouseEvent* event) {
+    const uint32_t flags = (uint32_t)(packed >> 32);
+    event->x = (int16_t)(uint16_t)packed;
+    event->y = (int16_t)(uint16_t)(packed >> 16);
+    event->ctrl = (flags >> 0) & 1;
+    event->shift = (flags >> 1) & 1;
+    event->meta = (flags >> 2) & 1;
+    event->alt = (flags >> 3) & 1;
+    event->capslock = (flags >> 4) & 1;
+    event->numlock = (flags >> 5) & 1;
+    event->mb_left = (flags >> 6) & 1;
+    event->mb_right = (flags >> 7) & 1;
+    event->mb_middle = (flags >> 8) & 1;
+    return (uint8_t)((packed >> 48) & 0xF);
+}
+
+// true if packed event `a` was posted after packed event `b`, allowing for the sequence number wrapping
+static uint8_t _bolt_input_after(uint64_t a, uint64_t b) {
+    const uint32_t diff = ((uint32_t)(a >> INPUT_SEQUENCE_SHIFT) - (uint32_t)(b >> INPUT_SEQUENCE_SHIFT)) & INPUT_SEQUENCE_MASK;
+    return diff != 0 && diff <= (INPUT_SEQUENCE_MASK >> 1);
+}
+
+// puts an already-packed event in the next queue slot. returns false if the queue is full.
+static uint8_t _bolt_input_enqueue(struct InputMailbox* mailbox, uint64_t packed) {
+    uint32_t head = load_u32(&mailbox->head);
+    do {
+        if (head - load_u32(&mailbox->tail) >= INPUT_MAILBOX_CAPACITY) return false;
+    } while (!cas_u32(&mailbox->head, &head, head + 1));
+    // the consumer can't get here until it's taken the event out of this slot last time round,
+    // because it only moves `tail` after doing that
+    store_u64(&mailbox->queue[head % INPUT_MAILBOX_CAPACITY], packed);
+    return true;
+}
+
+void _bolt_plugin_input_post(struct InputMailbox* mailbox, uint8_t input_type, const struct MouseEvent* event) {
+    const uint64_t packed = _bolt_input_pack(input_type, fetch_add_u32(&mailbox->sequence, 1), event);
+    switch (input_type) {
+        case INPUT_MOUSE_MOTION:
+            // any input other than a mouseleave means the mouse is back, so cancel any pending one
+            store_u64(&mailbox->leave, 0);
+            store_u64(&mailbox->motion, packed);
+            return;
+        case INPUT_MOUSE_LEAVE:
+            store_u64(&mailbox->leave, packed);
+            return;
     }
-    if (inputs.mouse_middle_up) {
-        struct MouseButtonEvent event = {.details = inputs.mouse_middle_up_event, .button = MBMiddle};
-        _bolt_plugin_handle_mousebuttonup(&event);
+    store_u64(&mailbox->leave, 0);
+    // the motion that led up to this event has to be handled before it, not coalesced with whatever
+    // motion comes after it, so it goes in the queue first with its own sequence number
+    const uint64_t motion = exchange_u64(&mailbox->motion, 0);
+    if (motion && !_bolt_input_enqueue(mailbox, motion)) {
+        // no room, so put it back unless something newer has been posted since
+        cas_u64(&mailbox->motion, 0, motion);
+        return;
     }
-    if (inputs.mouse_scroll_up) {
-        struct MouseScrollEvent event = {.details = inputs.mouse_scroll_up_event, .direction = 1};
-        _bolt_plugin_handle_scroll(&event);
+    _bolt_input_enqueue(mailbox, packed);
+}
+
+// the contents of an InputMailbox after draining it, in the order they were posted. this includes
+// INPUT_MOUSE_MOTION and INPUT_MOUSE_LEAVE events, along with the button and scroll events.
+struct DrainedInput {
+    size_t count;
+    uint8_t types[INPUT_MAILBOX_CAPACITY + 2];
+    struct MouseEvent events[INPUT_MAILBOX_CAPACITY + 2];
+};
+
+// takes everything out of the mailbox. must only be called from the render thread.
+static void _bolt_input_drain(struct InputMailbox* mailbox, struct DrainedInput* out) {
+    uint64_t packed[INPUT_MAILBOX_CAPACITY + 2];
+    size_t count = 0;
+    uint32_t tail = load_u32(&mailbox->tail);
+    const uint32_t head = load_u32(&mailbox->head);
+    while (tail != head) {
+        const uint64_t event = exchange_u64(&mailbox->queue[tail % INPUT_MAILBOX_CAPACITY], 0);
+        // a producer has claimed this slot but not written it yet, so leave it until next frame
+        if (!event) break;
+        packed[count++] = event;
+        tail += 1;
     }
-    if (inputs.mouse_scroll_down) {
-        struct MouseScrollEvent event = {.details = inputs.mouse_scroll_down_event, .direction = 0};
-        _bolt_plugin_handle_scroll(&event);
+    store_u32(&mailbox->tail, tail);
+    const uint64_t motion = exchange_u64(&mailbox->motion, 0);
+    if (motion) packed[count++] = motion;
+    const uint64_t leave = exchange_u64(&mailbox->leave, 0);
+    if (leave) packed[count++] = leave;
+
+    // nearly always in order already, except when producers raced for queue slots, so insertion sort
+    for (size_t i = 1; i < count; i += 1) {
+        const uint64_t event = packed[i];
+        size_t j = i;
+        for (; j > 0 && _bolt_input_after(packed[j - 1], event); j -= 1) packed[j] = packed[j - 1];
+        packed[j] = event;
+    }
+    for (size_t i = 0; i < count; i += 1) out->types[i] = _bolt_input_unpack(packed[i], &out->events[i]);
+    out->count = count;
+}
+
+static uint8_t point_in_rect(int x, int y, int rx, int ry, int rw, int rh) {
+    return rx <= x && rx + rw > x && ry <= y && ry + rh > y;
+}
+
+// windows drawn so far this frame, in order, and where. swapped into the hit index if it changed.
+static struct EmbeddedWindow** drawn_windows;
+static struct EmbeddedWindowMetadata* drawn_rects;
+static size_t drawn_count;
+static size_t drawn_capacity;
+
+static void _bolt_window_order_add(struct EmbeddedWindow* window) {
+    if (windows.order_count == windows.order_capacity) {
+        windows.order_capacity = windows.order_capacity ? windows.order_capacity * 2 : 16;
+        windows.order = realloc(windows.order, windows.order_capacity * sizeof(*windows.order));
+    }
+    windows.order[windows.order_count++] = window;
+}
+
+static void _bolt_window_drawn_add(struct EmbeddedWindow* window, const struct EmbeddedWindowMetadata* rect) {
+    if (drawn_count == drawn_capacity) {
+        drawn_capacity = drawn_capacity ? drawn_capacity * 2 : 16;
+        drawn_windows = realloc(drawn_windows, drawn_capacity * sizeof(*drawn_windows));
+        drawn_rects = realloc(drawn_rects, drawn_capacity * sizeof(*drawn_rects));
+    }
+    drawn_windows[drawn_count] = window;
+    drawn_rects[drawn_count] = *rect;
+    drawn_count += 1;
+}
+
+// gets the range of grid cells covered by a rect, returning false if it doesn't cover any
+#define WINDOW_GRID_CELL_SIZE 128
+static uint8_t _bolt_window_grid_span(const struct EmbeddedWindowMetadata* rect, uint32_t* x1, uint32_t* y1, uint32_t* x2, uint32_t* y2) {
+    if (rect->width <= 0 || rect->height <= 0 || rect->x + rect->width <= 0 || rect->y + rect->height <= 0) return false;
+    *x1 = rect->x > 0 ? rect->x / WINDOW_GRID_CELL_SIZE : 0;
+    *y1 = rect->y > 0 ? rect->y / WINDOW_GRID_CELL_SIZE : 0;
+    *x2 = (rect->x + rect->width - 1) / WINDOW_GRID_CELL_SIZE;
+    *y2 = (rect->y + rect->height - 1) / WINDOW_GRID_CELL_SIZE;
+    return true;
+}
+
+// rebuilds the grid from index->windows and index->rects. caller must hold windows.lock for writing.
+static void _bolt_window_hit_index_build(struct WindowHitIndex* index) {
+    uint32_t x1, y1, x2, y2;
+    index->columns = 0;
+    index->rows = 0;
+    for (size_t i = 0; i < index->count; i += 1) {
+        if (!_bolt_window_grid_span(&index->rects[i], &x1, &y1, &x2, &y2)) continue;
+        if (x2 + 1 > index->columns) index->columns = x2 + 1;
+        if (y2 + 1 > index->rows) index->rows = y2 + 1;
+    }
+    const size_t cell_count = (size_t)index->columns * index->rows;
+    if (cell_count + 1 > index->cell_capacity) {
+        index->cell_capacity = cell_count + 1;
+        index->cell_start = realloc(index->cell_start, index->cell_capacity * sizeof(*index->cell_start));
+    }
+    memset(index->cell_start, 0, (cell_count + 1) * sizeof(*index->cell_start));
+
+    // count how many windows are in each cell, then turn those into starting offsets
+    for (size_t i = 0; i < index->count; i += 1) {
+        if (!_bolt_window_grid_span(&index->rects[i], &x1, &y1, &x2, &y2)) continue;
+        for (uint32_t y = y1; y <= y2; y += 1) {
+            for (uint32_t x = x1; x <= x2; x += 1) index->cell_start[(y * index->columns) + x + 1] += 1;
+        }
+    }
+    for (size_t c = 0; c < cell_count; c += 1) index->cell_start[c + 1] += index->cell_start[c];
+    const size_t item_count = index->cell_start[cell_count];
+    if (item_count > index->item_capacity) {
+        index->item_capacity = item_count;
+        index->cell_items = realloc(index->cell_items, index->item_capacity * sizeof(*index->cell_items));
+    }
+
+    // fill the cells in from the top window down, using cell_start as a write cursor. afterwards each
+    // one points at the end of its cell, i.e. the start of the next one, so shift them all back by one
+    for (size_t i = index->count; i > 0; i -= 1) {
+        if (!_bolt_window_grid_span(&index->rects[i - 1], &x1, &y1, &x2, &y2)) continue;
+        for (uint32_t y = y1; y <= y2; y += 1) {
+            for (uint32_t x = x1; x <= x2; x += 1) index->cell_items[index->cell_start[(y * index->columns) + x]++] = i - 1;
+        }
+    }
+    for (size_t c = cell_count; c > 0; c -= 1) index->cell_start[c] = index->cell_start[c - 1];
+    index->cell_start[0] = 0;
+}
+
+// replaces the hit index with the windows drawn this frame, if anything about them changed. windows
+// that got deleted after being drawn are left out, since they're about to be freed.
+static void _bolt_window_hit_index_update() {
+    size_t count = 0;
+    for (size_t i = 0; i < drawn_count; i += 1) {
+        if (drawn_windows[i]->is_deleted) continue;
+        drawn_windows[count] = drawn_windows[i];
+        drawn_rects[count] = drawn_rects[i];
+        count += 1;
+    }
+    drawn_count = 0;
+    struct WindowHitIndex* index = &windows.hit_index;
+    if (count == index->count && (count == 0 ||
+        (!memcmp(drawn_windows, index->windows, count * sizeof(*drawn_windows)) &&
+        !memcmp(drawn_rects, index->rects, count * sizeof(*drawn_rects))))) return;
+
+    _bolt_rwlock_lock_write(&windows.lock);
+    struct EmbeddedWindow** old_windows = index->windows;
+    struct EmbeddedWindowMetadata* old_rects = index->rects;
+    const size_t old_capacity = index->capacity;
+    index->windows = drawn_windows;
+    index->rects = drawn_rects;
+    index->capacity = drawn_capacity;
+    index->count = count;
+    _bolt_window_hit_index_build(index);
+    _bolt_rwlock_unlock_write(&windows.lock);
+    drawn_windows = old_windows;
+    drawn_rects = old_rects;
+    drawn_capacity = old_capacity;
+}
+
+struct EmbeddedWindow* _bolt_plugin_window_at(int x, int y, struct EmbeddedWindowMetadata* rect) {
+    const struct WindowHitIndex* index = &windows.hit_index;
+    if (x < 0 || y < 0) return NULL;
+    const uint32_t column = x / WINDOW_GRID_CELL_SIZE;
+    const uint32_t row = y / WINDOW_GRID_CELL_SIZE;
+    if (column >= index->columns || row >= index->rows) return NULL;
+    const size_t cell = (row * index->columns) + column;
+    for (uint32_t i = index->cell_start[cell]; i < index->cell_start[cell + 1]; i += 1) {
+        const uint32_t n = index->cell_items[i];
+        const struct EmbeddedWindowMetadata* r = &index->rects[n];
+        if (point_in_rect(x, y, r->x, r->y, r->width, r->height)) {
+            if (rect) *rect = *r;
+            return index->windows[n];
+        }
+    }
+    return NULL;
+}
+
+static void _bolt_process_embedded_windows(uint32_t window_width, uint32_t window_height, uint64_t micros, struct CaptureState* capture) {
+    struct DrainedInput inputs;
+    _bolt_input_drain(&windows.input, &inputs);
+    for (size_t i = 0; i < inputs.count; i += 1) {
+        const struct MouseEvent* details = &inputs.events[i];
+        switch (inputs.types[i]) {
+            case INPUT_MOUSE_MOTION: {
+                struct MouseMotionEvent event = {.details = *details};
+                _bolt_plugin_handle_mousemotion(&event);
+                break;
+            }
+            case INPUT_MOUSE_LEFT:
+            case INPUT_MOUSE_RIGHT:
+            case INPUT_MOUSE_MIDDLE: {
+                struct MouseButtonEvent event = {.details = *details, .button = MBLeft + (inputs.types[i] - INPUT_MOUSE_LEFT)};
+                _bolt_plugin_handle_mousebutton(&event);
+                break;
+            }
+            case INPUT_MOUSE_LEFT_UP:
+            case INPUT_MOUSE_RIGHT_UP:
+            case INPUT_MOUSE_MIDDLE_UP: {
+                struct MouseButtonEvent event = {.details = *details, .button = MBLeft + (inputs.types[i] - INPUT_MOUSE_LEFT_UP)};
+                _bolt_plugin_handle_mousebuttonup(&event);
+                break;
+            }
+            case INPUT_MOUSE_SCROLL_UP:
+            case INPUT_MOUSE_SCROLL_DOWN: {
+                struct MouseScrollEvent event = {.details = *details, .direction = inputs.types[i] == INPUT_MOUSE_SCROLL_UP};
+                _bolt_plugin_handle_scroll(&event);
+                break;
+            }
+        }
     }
 
     bool any_deleted = false;
     _bolt_rwlock_lock_read(&windows.lock);
-    size_t iter = 0;
-    void* item;
-    while (hashmap_iter(windows.map, &iter, &item)) {
-        struct EmbeddedWindow* window = *(struct EmbeddedWindow**)item;
+    for (size_t i = 0; i < windows.order_count; i += 1) {
+        struct EmbeddedWindow* window = windows.order[i];
         if (window->is_deleted) {
             any_deleted = true;
             continue;
         }
 
         if (window->do_capture) {
-            *need_capture = true;
-            if (!window->capture_ready) *capture_ready = false;
+            _bolt_capture_state_add(capture, micros, window->capture_ready, &window->capture);
         }
 
         _bolt_rwlock_lock_write(&window->lock);
@@ -585,10 +1810,7 @@ static void _bolt_process_embedded_windows(uint32_t window_width, uint32_t windo
         struct EmbeddedWindowMetadata metadata = window->metadata;
         _bolt_rwlock_unlock_write(&window->lock);
 
-        _bolt_rwlock_lock_write(&window->input_lock);
-        struct WindowPendingInput inputs = window->input;
-        memset(&window->input, 0, sizeof(window->input));
-        _bolt_rwlock_unlock_write(&window->input_lock);
+        _bolt_input_drain(&window->input, &inputs);
 
         if (did_move || did_resize) {
             if (did_resize) {
@@ -601,11 +1823,17 @@ static void _bolt_process_embedded_windows(uint32_t window_width, uint32_t windo
         }
 
         if (window->reposition_mode) {
-            if (inputs.mouse_motion) {
-                _bolt_window_calc_repos_target(window, &metadata, inputs.mouse_motion_event.x, inputs.mouse_motion_event.y, window_width, window_height);
+            // motion after the button was released belongs to whatever happens next, not to the reposition
+            const struct MouseEvent* left_up = NULL;
+            for (size_t i = 0; i < inputs.count && !left_up; i += 1) {
+                if (inputs.types[i] == INPUT_MOUSE_MOTION) {
+                    _bolt_window_calc_repos_target(window, &metadata, inputs.events[i].x, inputs.events[i].y, window_width, window_height);
+                } else if (inputs.types[i] == INPUT_MOUSE_LEFT_UP) {
+                    left_up = &inputs.events[i];
+                }
             }
-            if (inputs.mouse_left_up) {
-                _bolt_window_calc_repos_target(window, &metadata, inputs.mouse_left_up_event.x, inputs.mouse_left_up_event.y, window_width, window_height);
+            if (left_up) {
+                _bolt_window_calc_repos_target(window, &metadata, left_up->x, left_up->y, window_width, window_height);
                 if (window->reposition_threshold) {
                     //did_move = (window->metadata.x != window->repos_target_x) || (window->metadata.y != window->repos_target_y);
                     did_resize = (window->metadata.width != window->repos_target_w) || (window->metadata.height != window->repos_target_h);
@@ -629,47 +1857,43 @@ static void _bolt_process_embedded_windows(uint32_t window_width, uint32_t windo
                 window->reposition_mode = false;
             }
         } else {
-            if (inputs.mouse_motion) {
-                struct MouseMotionEvent event = {.details = inputs.mouse_motion_event};
-                _bolt_plugin_window_onmousemotion(window, &event);
-            }
-            if (inputs.mouse_left) {
-                window->drag_xstart = inputs.mouse_left_event.x;
-                window->drag_ystart = inputs.mouse_left_event.y;
-                struct MouseButtonEvent event = {.details = inputs.mouse_left_event, .button = MBLeft};
-                _bolt_plugin_window_onmousebutton(window, &event);
-            }
-            if (inputs.mouse_right) {
-                struct MouseButtonEvent event = {.details = inputs.mouse_right_event, .button = MBRight};
-                _bolt_plugin_window_onmousebutton(window, &event);
-            }
-            if (inputs.mouse_middle) {
-                struct MouseButtonEvent event = {.details = inputs.mouse_middle_event, .button = MBMiddle};
-                _bolt_plugin_window_onmousebutton(window, &event);
-            }
-            if (inputs.mouse_left_up) {
-                struct MouseButtonEvent event = {.details = inputs.mouse_left_up_event, .button = MBLeft};
-                _bolt_plugin_window_onmousebuttonup(window, &event);
-            }
-            if (inputs.mouse_right_up) {
-                struct MouseButtonEvent event = {.details = inputs.mouse_right_up_event, .button = MBRight};
-                _bolt_plugin_window_onmousebuttonup(window, &event);
-            }
-            if (inputs.mouse_middle_up) {
-                struct MouseButtonEvent event = {.details = inputs.mouse_middle_up_event, .button = MBMiddle};
-                _bolt_plugin_window_onmousebuttonup(window, &event);
-            }
-            if (inputs.mouse_scroll_up) {
-                struct MouseScrollEvent event = {.details = inputs.mouse_scroll_up_event, .direction = 1};
-                _bolt_plugin_window_onscroll(window, &event);
-            }
-            if (inputs.mouse_scroll_down) {
-                struct MouseScrollEvent event = {.details = inputs.mouse_scroll_down_event, .direction = 0};
-                _bolt_plugin_window_onscroll(window, &event);
-            }
-            if (inputs.mouse_leave) {
-                struct MouseMotionEvent event = {.details = inputs.mouse_motion_event};
-                _bolt_plugin_window_onmouseleave(window, &event);
+            for (size_t i = 0; i < inputs.count; i += 1) {
+                const struct MouseEvent* details = &inputs.events[i];
+                switch (inputs.types[i]) {
+                    case INPUT_MOUSE_MOTION: {
+                        struct MouseMotionEvent event = {.details = *details};
+                        _bolt_plugin_window_onmousemotion(window, &event);
+                        break;
+                    }
+                    case INPUT_MOUSE_LEAVE: {
+                        struct MouseMotionEvent event = {.details = *details};
+                        _bolt_plugin_window_onmouseleave(window, &event);
+                        break;
+                    }
+                    case INPUT_MOUSE_LEFT:
+                        window->drag_xstart = details->x;
+                        window->drag_ystart = details->y;
+                        // fall through
+                    case INPUT_MOUSE_RIGHT:
+                    case INPUT_MOUSE_MIDDLE: {
+                        struct MouseButtonEvent event = {.details = *details, .button = MBLeft + (inputs.types[i] - INPUT_MOUSE_LEFT)};
+                        _bolt_plugin_window_onmousebutton(window, &event);
+                        break;
+                    }
+                    case INPUT_MOUSE_LEFT_UP:
+                    case INPUT_MOUSE_RIGHT_UP:
+                    case INPUT_MOUSE_MIDDLE_UP: {
+                        struct MouseButtonEvent event = {.details = *details, .button = MBLeft + (inputs.types[i] - INPUT_MOUSE_LEFT_UP)};
+                        _bolt_plugin_window_onmousebuttonup(window, &event);
+                        break;
+                    }
+                    case INPUT_MOUSE_SCROLL_UP:
+                    case INPUT_MOUSE_SCROLL_DOWN: {
+                        struct MouseScrollEvent event = {.details = *details, .direction = inputs.types[i] == INPUT_MOUSE_SCROLL_UP};
+                        _bolt_plugin_window_onscroll(window, &event);
+                        break;
+                    }
+                }
             }
         }
 
@@ -680,6 +1904,7 @@ static void _bolt_process_embedded_windows(uint32_t window_width, uint32_t windo
         }
 
         window->surface_functions.draw_to_surface(window->surface_functions.userdata, overlay.userdata, 0, 0, metadata.width, metadata.height, metadata.x, metadata.y, metadata.width, metadata.height);
+        _bolt_window_drawn_add(window, &metadata);
         if (window->popup_shown && window->popup_initialised) {
             window->popup_surface_functions.draw_to_surface(window->popup_surface_functions.userdata, overlay.userdata, 0, 0, window->popup_meta.width, window->popup_meta.height, metadata.x + window->popup_meta.x, metadata.y + window->popup_meta.y, window->popup_meta.width, window->popup_meta.height);
         }
@@ -688,16 +1913,24 @@ static void _bolt_process_embedded_windows(uint32_t window_width, uint32_t windo
         }
     }
     _bolt_rwlock_unlock_read(&windows.lock);
+    _bolt_window_hit_index_update();
 
     if (any_deleted) {
         _bolt_rwlock_lock_write(&windows.lock);
-        iter = 0;
+        size_t kept = 0;
+        for (size_t i = 0; i < windows.order_count; i += 1) {
+            if (!windows.order[i]->is_deleted) windows.order[kept++] = windows.order[i];
+        }
+        windows.order_count = kept;
+        size_t iter = 0;
+        void* item;
         while (hashmap_iter(windows.map, &iter, &item)) {
             struct EmbeddedWindow* window = *(struct EmbeddedWindow**)item;
             if (window->is_deleted) {
                 if (window->is_browser) {
-                    // destroy shm object
+                    // destroy shm objects
                     _bolt_plugin_shm_close(&window->browser_shm);
+                    _bolt_plugin_shm_close(&window->popup_shm);
                 }
 
                 // destroy the plugin registry entry
@@ -720,51 +1953,228 @@ static void _bolt_process_embedded_windows(uint32_t window_width, uint32_t windo
     }
 }
 
-// does a screen capture, then notifies all the browsers. don't call if any browser isn't ready yet.
-static void _bolt_process_captures(uint32_t window_width, uint32_t window_height) {
-    const size_t capture_bytes = window_width * window_height * 3;
-    uint8_t need_remap = false;
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BOLT_HAVE_SSE2_TILE_HASH
+#endif
+
+// hashes one tile of a capture. each 16-byte chunk of a row is mixed with a key for its position in the
+// row, then the rows are scrambled into each other, so moving pixels around within a tile changes the
+// hash as well as changing them. this only needs to be fast and unlikely to miss a change, since the
+// hashes are only ever compared against the previous capture of the same tile in the same process.
+#if defined(BOLT_HAVE_SSE2_TILE_HASH)
+static uint64_t _bolt_capture_tile_hash(const uint8_t* data, size_t row_size, size_t stride, size_t rows) {
+    __m128i keys[(BOLT_CAPTURE_TILE_SIZE * 3) / 16];
+    for (size_t i = 0; i < sizeof(keys) / sizeof(*keys); i += 1) {
+        keys[i] = _mm_set_epi64x((long long)(((i * 2) + 1) * 0x9E3779B97F4A7C15ULL), (long long)(((i * 2) + 2) * 0xC2B2AE3D27D4EB4FULL));
+    }
+    const __m128i prime = _mm_set1_epi32((int)0x9E3779B1);
+    __m128i acc = _mm_set_epi64x((long long)rows, (long long)row_size);
+    for (size_t y = 0; y < rows; y += 1) {
+        const uint8_t* row = data + (y * stride);
+        for (size_t i = 0; i < row_size; i += 16) {
+            __m128i v;
+            if (i + 16 <= row_size) {
+                v = _mm_loadu_si128((const __m128i*)(row + i));
+            } else {
+                uint8_t tail[16] = {0};
+                memcpy(tail, row + i, row_size - i);
+                v = _mm_loadu_si128((const __m128i*)tail);
+            }
+            // 32x32->64 multiply of each lane's halves with each other, plus the data itself so that no
+            // input is lost to a multiply by zero
+            const __m128i data_key = _mm_xor_si128(v, keys[i / 16]);
+            const __m128i product = _mm_mul_epu32(data_key, _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)));
+            acc = _mm_add_epi64(acc, _mm_add_epi64(product, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+        acc = _mm_xor_si128(acc, _mm_srli_epi64(acc, 47));
+        const __m128i lo = _mm_mul_epu32(acc, prime);
+        const __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(acc, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        acc = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return lanes[0] ^ (lanes[1] * 0x9E3779B97F4A7C15ULL);
+}
+#else
+static uint64_t _bolt_capture_tile_hash(const uint8_t* data, size_t row_size, size_t stride, size_t rows) {
+    uint64_t acc = ((uint64_t)rows << 32) ^ row_size;
+    for (size_t y = 0; y < rows; y += 1) {
+        const uint8_t* row = data + (y * stride);
+        for (size_t i = 0; i < row_size; i += 8) {
+            uint64_t v = 0;
+            memcpy(&v, row + i, (row_size - i) < 8 ? (row_size - i) : 8);
+            acc += (v ^ (((i / 8) + 1) * 0x9E3779B97F4A7C15ULL)) * 0xC2B2AE3D27D4EB4FULL;
+        }
+        acc ^= acc >> 47;
+        acc *= 0x9E3779B1ULL;
+    }
+    return acc;
+}
+#endif
+
+// sets the first `count` bits of a tile bitmap and clears the rest
+static void _bolt_capture_tiles_set_all(uint8_t* bitmap, size_t count) {
+    memset(bitmap, 0xFF, count / 8);
+    memset(bitmap + (count / 8), 0, CAPTURE_TILE_BITMAP_SIZE - (count / 8));
+    if (count % 8) bitmap[count / 8] = (uint8_t)((1 << (count % 8)) - 1);
+}
+
+// brings the tile hashes of one region up to date with the capture that's just been written to the shm,
+// if that hasn't already been done for this capture, and returns them. returns NULL if the region has too
+// many tiles to be sent tiled.
+static const struct CaptureTiles* _bolt_capture_tiles_update(const struct CaptureState* capture, size_t region_index) {
+    const struct CaptureRegion* region = &capture->regions[region_index];
+    const size_t width = region->width / region->scale;
+    const size_t height = region->height / region->scale;
+    const size_t tiles_x = (width + BOLT_CAPTURE_TILE_SIZE - 1) / BOLT_CAPTURE_TILE_SIZE;
+    const size_t tiles_y = (height + BOLT_CAPTURE_TILE_SIZE - 1) / BOLT_CAPTURE_TILE_SIZE;
+    if (tiles_x * tiles_y > CAPTURE_TILE_BITMAP_SIZE * 8) return NULL;
+
+    if (region_index >= capture_tiles_capacity) {
+        const size_t capacity = capture->region_capacity;
+        struct CaptureTiles* tiles = realloc(capture_tiles, capacity * sizeof(*tiles));
+        if (!tiles) return NULL;
+        memset(tiles + capture_tiles_capacity, 0, (capacity - capture_tiles_capacity) * sizeof(*tiles));
+        capture_tiles = tiles;
+        capture_tiles_capacity = capacity;
+    }
+    struct CaptureTiles* tiles = &capture_tiles[region_index];
+    if (tiles->generation == capture_generation && !memcmp(&tiles->region, region, sizeof(*region))) return tiles;
+
+    // a region that's different from last time, or wasn't in the previous capture, has nothing up-to-date
+    // to compare against, so all of it is dirty
+    const uint8_t is_new = (tiles->generation + 1 != capture_generation) || memcmp(&tiles->region, region, sizeof(*region));
+    if (is_new) {
+        uint64_t* hashes = realloc(tiles->hashes, tiles_x * tiles_y * sizeof(*hashes));
+        if (!hashes) return NULL;
+        tiles->hashes = hashes;
+        tiles->tiles_x = tiles_x;
+        tiles->tiles_y = tiles_y;
+        tiles->region = *region;
+        _bolt_capture_tiles_set_all(tiles->dirty, tiles_x * tiles_y);
+    } else {
+        memset(tiles->dirty, 0, sizeof(tiles->dirty));
+    }
+    tiles->generation = capture_generation;
+
+    const size_t stride = width * 3;
+    const uint8_t* image = (const uint8_t*)capture_shm.file + capture->offsets[region_index];
+    for (size_t ty = 0; ty < tiles_y; ty += 1) {
+        const size_t y = ty * BOLT_CAPTURE_TILE_SIZE;
+        const size_t rows = (height - y) < BOLT_CAPTURE_TILE_SIZE ? (height - y) : BOLT_CAPTURE_TILE_SIZE;
+        for (size_t tx = 0; tx < tiles_x; tx += 1) {
+            const size_t x = tx * BOLT_CAPTURE_TILE_SIZE;
+            const size_t columns = (width - x) < BOLT_CAPTURE_TILE_SIZE ? (width - x) : BOLT_CAPTURE_TILE_SIZE;
+            const size_t index = (ty * tiles_x) + tx;
+            const uint64_t hash = _bolt_capture_tile_hash(image + (y * stride) + (x * 3), columns * 3, stride, rows);
+            if (!is_new && hash != tiles->hashes[index]) tiles->dirty[index / 8] |= (uint8_t)(1 << (index % 8));
+            tiles->hashes[index] = hash;
+        }
+    }
+    return tiles;
+}
+
+// adds the tiles that changed in this capture to the ones a tiled browser hasn't been sent yet. returns the
+// size of its bitmap, which is 0 if it can't be sent tiled this time, in which case it'll get the whole image.
+static uint32_t _bolt_capture_request_add_tiles(const struct CaptureState* capture, struct CaptureRequest* request) {
+    const struct CaptureTiles* tiles = _bolt_capture_tiles_update(capture, request->region_index);
+    if (!tiles) {
+        memset(&request->tile_region, 0, sizeof(request->tile_region));
+        return 0;
+    }
+    const size_t count = (size_t)tiles->tiles_x * tiles->tiles_y;
+    if (memcmp(&request->tile_region, &tiles->region, sizeof(tiles->region))) {
+        request->tile_region = tiles->region;
+        _bolt_capture_tiles_set_all(request->dirty_tiles, count);
+    } else {
+        for (size_t i = 0; i < (count + 7) / 8; i += 1) request->dirty_tiles[i] |= tiles->dirty[i];
+    }
+    return (uint32_t)((count + 7) / 8);
+}
+
+static uint8_t _bolt_capture_request_has_dirty_tiles(const struct CaptureRequest* request, uint32_t dirty_tiles_size) {
+    for (uint32_t i = 0; i < dirty_tiles_size; i += 1) {
+        if (request->dirty_tiles[i]) return true;
+    }
+    return false;
+}
+
+static void _bolt_send_capture_notify(enum BoltIPCMessageTypeToHost msg_type, uint64_t plugin_id, uint64_t window_id, uint64_t* browser_capture_id, const struct CaptureState* capture, struct CaptureRequest* request, uint32_t dirty_tiles_size) {
+    const struct CaptureRegion* region = &capture->regions[request->region_index];
+    const struct BoltIPCCaptureNotifyHeader header = {
+        .plugin_id = plugin_id,
+        .window_id = window_id,
+        .pid = getpid(),
+        .capture_id = capture_id,
+        .offset = capture->offsets[request->region_index],
+        .shm_size = capture->size,
+        .width = region->width / region->scale,
+        .height = region->height / region->scale,
+        .dirty_tiles_size = dirty_tiles_size,
+        .needs_remap = capture_needs_remap || (capture_id != *browser_capture_id),
+    };
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &header, .len = sizeof(header)},
+        {.data = request->dirty_tiles, .len = dirty_tiles_size},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
+    memset(request->dirty_tiles, 0, dirty_tiles_size);
+    *browser_capture_id = capture_id;
+}
+
+// decides whether a capture-enabled browser should be sent the capture that's just been written to the shm,
+// and if so, how big its dirty-tile bitmap is. tiled browsers keep collecting dirty tiles from every capture,
+// even ones they aren't sent, and are skipped if nothing they can see has changed. browsers which aren't due
+// yet are also skipped, unless the mapping changed, since they all need to know about that.
+static uint8_t _bolt_capture_should_notify(uint64_t micros, const struct CaptureState* capture, struct CaptureRequest* request, uint64_t browser_capture_id, uint32_t* dirty_tiles_size) {
+    if (request->region_index == CAPTURE_REGION_NONE) return false;
+    const uint8_t needs_remap = capture_needs_remap || (capture_id != browser_capture_id);
+    *dirty_tiles_size = request->tiled ? _bolt_capture_request_add_tiles(capture, request) : 0;
+    if (!needs_remap && micros < request->next_time) return false;
+    return needs_remap || !*dirty_tiles_size || _bolt_capture_request_has_dirty_tiles(request, *dirty_tiles_size);
+}
+
+// starts reading the requested regions of the screen if a capture is due, and if an earlier read has arrived from
+// the GPU and every browser is done with the previous one, puts it in the shared memory and notifies the browsers
+// whose interval has elapsed.
+static void _bolt_process_captures(uint64_t micros, const struct CaptureState* capture) {
+    if (capture->due && (micros >= next_capture_time) && managed_functions.read_screen_pixels_start(capture->regions, capture->region_count)) {
+        next_capture_time = micros + capture->min_interval_micros;
+    }
+    if (!capture->due || !capture->ready) return;
+
     if (!capture_inited) {
-        _bolt_plugin_shm_open_outbound(&capture_shm, capture_bytes, "sc", next_window_id);
+        _bolt_plugin_shm_open_outbound(&capture_shm, capture->size, "sc", next_window_id);
         capture_inited = true;
         capture_id = next_window_id;
-        capture_width = window_width;
-        capture_height = window_height;
-        need_remap = true;
+        capture_size = capture->size;
+        capture_needs_remap = true;
         next_window_id += 1;
-    } else if (capture_width != window_width || capture_height != window_height) {
-        _bolt_plugin_shm_resize(&capture_shm, capture_bytes, next_window_id);
+    } else if (capture_size != capture->size) {
+        _bolt_plugin_shm_resize(&capture_shm, capture->size, next_window_id);
 #if defined(_WIN32)
         capture_id = next_window_id;
         next_window_id += 1;
 #endif
-        capture_width = window_width;
-        capture_height = window_height;
-        need_remap = true;
+        capture_size = capture->size;
+        capture_needs_remap = true;
     }
-    managed_functions.read_screen_pixels(window_width, window_height, capture_shm.file);
-    
+    if (!managed_functions.read_screen_pixels_finish(capture->regions, capture->region_count, capture_shm.file)) return;
+    capture_generation += 1;
+
     _bolt_rwlock_lock_read(&windows.lock);
     size_t iter = 0;
     void* item;
+    uint32_t dirty_tiles_size;
     while (hashmap_iter(windows.map, &iter, &item)) {
         struct EmbeddedWindow* window = *(struct EmbeddedWindow**)item;
         if (window->is_deleted) continue;
-        if (window->do_capture) {
-            const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_CAPTURENOTIFY_OSR;
-            const struct BoltIPCCaptureNotifyHeader header = {
-                .plugin_id = window->plugin_id,
-                .window_id = window->id,
-                .pid = getpid(),
-                .capture_id = capture_id,
-                .width = window_width,
-                .height = window_height,
-                .needs_remap = need_remap || (capture_id != window->capture_id),
-            };
-            _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-            _bolt_ipc_send(fd, &header, sizeof(header));
+        if (window->do_capture && _bolt_capture_should_notify(micros, capture, &window->capture, window->capture_id, &dirty_tiles_size)) {
+            _bolt_send_capture_notify(IPC_MSG_CAPTURENOTIFY_OSR, window->plugin_id, window->id, &window->capture_id, capture, &window->capture, dirty_tiles_size);
             window->capture_ready = false;
-            window->capture_id = capture_id;
+            window->capture.next_time = micros + window->capture.interval_micros;
         }
     }
     _bolt_rwlock_unlock_read(&windows.lock);
@@ -777,24 +2187,249 @@ static void _bolt_process_captures(uint32_t window_width, uint32_t window_height
         size_t iter2 = 0;
         while (hashmap_iter(plugin->external_browsers, &iter2, &item2)) {
             struct ExternalBrowser* browser = *(struct ExternalBrowser**)item2;
-            if (browser->do_capture) {
-                const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_CAPTURENOTIFY_EXTERNAL;
-                    const struct BoltIPCCaptureNotifyHeader header = {
-                    .plugin_id = browser->plugin_id,
-                    .window_id = browser->id,
-                    .pid = getpid(),
-                    .capture_id = capture_id,
-                    .width = window_width,
-                    .height = window_height,
-                    .needs_remap = need_remap || (capture_id != browser->capture_id),
-                };
-                _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-                _bolt_ipc_send(fd, &header, sizeof(header));
+            if (browser->do_capture && _bolt_capture_should_notify(micros, capture, &browser->capture, browser->capture_id, &dirty_tiles_size)) {
+                _bolt_send_capture_notify(IPC_MSG_CAPTURENOTIFY_EXTERNAL, browser->plugin_id, browser->id, &browser->capture_id, capture, &browser->capture, dirty_tiles_size);
                 browser->capture_ready = false;
-                browser->capture_id = capture_id;
+                browser->capture.next_time = micros + browser->capture.interval_micros;
+            }
+        }
+    }
+    capture_needs_remap = false;
+}
+
+// adds a message to the end of a worker's inbox or outbox. the worker's lock must be held.
+// returns 0 if out of memory, in which case `data` is still owned by the caller.
+static uint8_t worker_queue_push(struct WorkerMessage** head, struct WorkerMessage** tail, void* data, size_t size) {
+    struct WorkerMessage* message = malloc(sizeof(struct WorkerMessage));
+    if (!message) return 0;
+    message->next = NULL;
+    message->data = data;
+    message->size = size;
+    if (*tail) (*tail)->next = message;
+    else *head = message;
+    *tail = message;
+    return 1;
+}
+
+static void worker_queue_free(struct WorkerMessage* message) {
+    while (message) {
+        struct WorkerMessage* next = message->next;
+        free(message->data);
+        free(message);
+        message = next;
+    }
+}
+
+// set on a worker's state to interrupt whatever it's doing, since a worker could be stuck in a
+// long-running loop. compiled code never calls hooks, which is why workers run with the JIT off.
+static void worker_stop_hook(lua_State* state, lua_Debug* debug) {
+    luaL_error(state, "worker stopped");
+}
+
+// runs on the worker's thread: runs the worker's main file, then handles messages until stopped
+static void _bolt_worker_main(void* userdata) {
+    struct Worker* worker = userdata;
+    lua_State* state = worker->state;
+    uint8_t ok = !lua_pcall(state, 0, 0, 0);
+    while (ok) {
+        _bolt_plugin_thread_lock(&worker->thread);
+        while (!worker->inbox_head && !worker->stopping) _bolt_plugin_thread_wait(&worker->thread);
+        if (worker->stopping) {
+            _bolt_plugin_thread_unlock(&worker->thread);
+            break;
+        }
+        struct WorkerMessage* message = worker->inbox_head;
+        worker->inbox_head = NULL;
+        worker->inbox_tail = NULL;
+        _bolt_plugin_thread_unlock(&worker->thread);
+
+        while (message) {
+            struct WorkerMessage* next = message->next;
+            if (ok) {
+                lua_getfield(state, LUA_REGISTRYINDEX, WORKER_MESSAGE_CB_REGISTRYNAME);
+                if (lua_isfunction(state, -1)) {
+                    push_buffer(state, message->data, message->size);
+                    ok = !lua_pcall(state, 1, 0, 0);
+                } else {
+                    lua_pop(state, 1);
+                    free(message->data);
+                }
+            } else {
+                free(message->data);
+            }
+            free(message);
+            message = next;
+        }
+    }
+    if (!ok) {
+        _bolt_plugin_thread_lock(&worker->thread);
+        if (!worker->stopping) {
+            const char* e = lua_tolstring(state, -1, 0);
+            printf("plugin worker error: %s\n", e);
+            worker->failed = true;
+        }
+        _bolt_plugin_thread_unlock(&worker->thread);
+        lua_pop(state, 1);
+    }
+}
+
+// tells a worker to exit, without waiting for it to do so
+static void _bolt_worker_stop(struct Worker* worker) {
+    _bolt_plugin_thread_lock(&worker->thread);
+    if (!worker->stopping) {
+        worker->stopping = true;
+        lua_sethook(worker->state, worker_stop_hook, LUA_MASKCOUNT, 1);
+        _bolt_plugin_thread_notify(&worker->thread);
+    }
+    _bolt_plugin_thread_unlock(&worker->thread);
+}
+
+// waits for a worker to exit after _bolt_worker_stop, then frees it. if it doesn't exit in time, it must be
+// blocked somewhere the stop hook can't reach, such as a C function, so it's detached and left running
+// along with everything it uses, since that's better than hanging the game.
+static void _bolt_worker_free(struct Worker* worker) {
+    if (!_bolt_plugin_thread_join_timeout(&worker->thread, WORKER_JOIN_TIMEOUT_MILLIS)) {
+        printf("[plugin] worker %llu didn't stop within %ums, leaking it\n", (unsigned long long)worker->id, WORKER_JOIN_TIMEOUT_MILLIS);
+        return;
+    }
+    lua_close(worker->state);
+    worker_queue_free(worker->inbox_head);
+    worker_queue_free(worker->outbox_head);
+    free(worker);
+}
+
+// calls a plugin's onmessage handler for one of its workers. takes ownership of the message data.
+static void handle_worker_message(struct Plugin* plugin, struct Worker* worker, struct WorkerMessage* message) {
+    lua_State* state = plugin->state;
+    lua_getfield(state, LUA_REGISTRYINDEX, WORKERS_REGISTRYNAME); /*stack: worker table*/
+    lua_pushinteger(state, worker->id); /*stack: worker table, worker id*/
+    lua_gettable(state, -2); /*stack: worker table, event table*/
+    lua_pushinteger(state, WORKER_ONMESSAGE); /*stack: worker table, event table, event id*/
+    lua_gettable(state, -2); /*stack: worker table, event table, function or nil*/
+    if (lua_isfunction(state, -1)) {
+        push_buffer(state, message->data, message->size); /*stack: worker table, event table, function, message*/
+        if (lua_pcall(state, 1, 0, 0)) { /*stack: worker table, event table, ?error*/
+            const char* e = lua_tolstring(state, -1, 0);
+            printf("plugin worker onmessage error: %s\n", e);
+            lua_pop(state, 3); /*stack: (empty)*/
+            _bolt_plugin_stop(plugin->id);
+            _bolt_plugin_notify_stopped(plugin->id);
+        } else {
+            lua_pop(state, 2); /*stack: (empty)*/
+        }
+    } else {
+        free(message->data);
+        lua_pop(state, 3); /*stack: (empty)*/
+    }
+}
+
+// frees any workers that have been closed, and hands each plugin the messages its workers have sent
+static void _bolt_process_workers() {
+    size_t iter = 0;
+    void* item;
+    while (hashmap_iter(plugins, &iter, &item)) {
+        struct Plugin* plugin = *(struct Plugin**)item;
+        if (plugin->is_deleted) continue;
+        size_t iter2 = 0;
+        void* item2;
+        while (hashmap_iter(plugin->workers, &iter2, &item2)) {
+            struct Worker* worker = *(struct Worker**)item2;
+            if (worker->is_deleted) {
+                hashmap_delete(plugin->workers, &worker);
+                _bolt_worker_free(worker);
+                iter2 = 0;
+                continue;
+            }
+            _bolt_plugin_thread_lock(&worker->thread);
+            struct WorkerMessage* message = worker->outbox_head;
+            const uint8_t failed = worker->failed;
+            worker->outbox_head = NULL;
+            worker->outbox_tail = NULL;
+            _bolt_plugin_thread_unlock(&worker->thread);
+
+            while (message) {
+                struct WorkerMessage* next = message->next;
+                // the plugin might stop, or close this worker, during any of these callbacks
+                if (plugin->is_deleted || worker->is_deleted) {
+                    free(message->data);
+                } else {
+                    handle_worker_message(plugin, worker, message);
+                }
+                free(message);
+                message = next;
+            }
+            if (failed && !plugin->is_deleted) {
+                _bolt_plugin_stop(plugin->id);
+                _bolt_plugin_notify_stopped(plugin->id);
+            }
+        }
+    }
+}
+
+// called once all of a frame's callbacks are done: updates each plugin's budget state, and sends
+// timing stats to the host if it's time to
+static void _bolt_process_plugin_budgets(uint64_t micros) {
+    size_t plugin_count = 0;
+    size_t iter = 0;
+    void* item;
+    while (hashmap_iter(plugins, &iter, &item)) {
+        struct Plugin* plugin = *(struct Plugin* const*)item;
+        if (plugin->is_deleted) continue;
+        plugin_count += 1;
+        if (plugin->budget_nanos && plugin->frame_nanos > plugin->budget_nanos) {
+            plugin->frames_over_budget += 1;
+            plugin->over_budget_streak += 1;
+            if (!plugin->budget_warned) {
+                printf(
+                    "warning: plugin %llu used %lluus of callback time in one frame, over its budget of %lluus; it will be throttled if this keeps happening\n",
+                    (unsigned long long)plugin->id, (unsigned long long)(plugin->frame_nanos / 1000), (unsigned long long)(plugin->budget_nanos / 1000)
+                );
+                plugin->budget_warned = true;
             }
+        } else {
+            plugin->over_budget_streak = 0;
+        }
+        if (plugin->is_throttled) plugin->frames_throttled += 1;
+        plugin->is_throttled = false;
+        plugin->frame_nanos = 0;
+    }
+
+    if (micros < next_stats_time) return;
+    const uint64_t interval = next_stats_time ? (micros - next_stats_time) + PLUGIN_STATS_INTERVAL_MICROS : 0;
+    next_stats_time = micros + PLUGIN_STATS_INTERVAL_MICROS;
+    if (!plugin_count || !interval) return;
+
+    struct BoltIPCPluginStats* records = malloc(plugin_count * sizeof(struct BoltIPCPluginStats));
+    if (!records) return;
+    size_t i = 0;
+    iter = 0;
+    while (hashmap_iter(plugins, &iter, &item)) {
+        struct Plugin* plugin = *(struct Plugin* const*)item;
+        if (plugin->is_deleted) continue;
+        struct BoltIPCPluginStats* record = &records[i];
+        record->plugin_id = plugin->id;
+        record->budget_micros = plugin->budget_nanos / 1000;
+        record->frames_over_budget = plugin->frames_over_budget;
+        record->frames_throttled = plugin->frames_throttled;
+        for (size_t stat = 0; stat < IPC_PLUGINSTAT_COUNT; stat += 1) {
+            record->callbacks[stat].calls = plugin->stats[stat].calls;
+            record->callbacks[stat].total_micros = plugin->stats[stat].total_nanos / 1000;
+            record->callbacks[stat].max_micros = plugin->stats[stat].max_nanos / 1000;
         }
+        memset(plugin->stats, 0, sizeof(plugin->stats));
+        plugin->frames_over_budget = 0;
+        plugin->frames_throttled = 0;
+        i += 1;
     }
+    const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_PLUGINSTATS;
+    const struct BoltIPCPluginStatsHeader header = { .plugin_count = plugin_count, .interval_micros = interval };
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &header, .len = sizeof(header)},
+        {.data = records, .len = plugin_count * sizeof(struct BoltIPCPluginStats)},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
+    free(records);
 }
 
 void _bolt_plugin_end_frame(uint32_t window_width, uint32_t window_height) {
@@ -809,31 +2444,136 @@ void _bolt_plugin_end_frame(uint32_t window_width, uint32_t window_height) {
         overlay_height = window_height;
     }
 
-    uint8_t need_capture = false;
-    uint8_t capture_ready = true;
-    _bolt_plugin_handle_messages();
-    _bolt_process_embedded_windows(window_width, window_height, &need_capture, &capture_ready);
-    _bolt_process_plugins(&need_capture, &capture_ready);
-
+    BOLT_FRAMETRACE_BEGIN(frame_start);
     uint64_t micros = 0;
     monotonic_microseconds(&micros);
-    if (need_capture && capture_ready && (micros >= next_capture_time)) {
-        _bolt_process_captures(window_width, window_height);
-        next_capture_time = micros + CAPTURE_COOLDOWN_MICROS;
-        if (next_capture_time < micros) next_capture_time = micros;
-    } else if (!need_capture && capture_inited) {
+    struct CaptureState* capture = &capture_state;
+    capture->window_width = window_width;
+    capture->window_height = window_height;
+    capture->need_capture = false;
+    capture->ready = true;
+    capture->due = false;
+    capture->min_interval_micros = UINT64_MAX;
+    capture->region_count = 0;
+    capture->size = 0;
+    _bolt_plugin_handle_messages();
+    BOLT_FRAMETRACE_BEGIN(loads_start);
+    _bolt_process_plugin_loads();
+    BOLT_FRAMETRACE_END(loads_start, "endframe:pluginloads");
+    BOLT_FRAMETRACE_BEGIN(windows_start);
+    _bolt_process_embedded_windows(window_width, window_height, micros, capture);
+    BOLT_FRAMETRACE_END(windows_start, "endframe:windows");
+    BOLT_FRAMETRACE_BEGIN(plugins_start);
+    _bolt_process_plugins(micros, capture);
+    BOLT_FRAMETRACE_END(plugins_start, "endframe:plugins");
+    BOLT_FRAMETRACE_BEGIN(jobs_start);
+    _bolt_process_workers();
+    _bolt_process_file_jobs();
+    _bolt_process_png_jobs();
+    BOLT_FRAMETRACE_END(jobs_start, "endframe:jobs");
+
+    BOLT_FRAMETRACE_BEGIN(capture_start);
+    if (capture->need_capture && window_width && window_height) {
+        _bolt_process_captures(micros, capture);
+    } else if (capture_inited) {
+        managed_functions.read_screen_pixels_finish(NULL, 0, NULL);
         _bolt_plugin_shm_close(&capture_shm);
         capture_inited = false;
     }
+    BOLT_FRAMETRACE_END(capture_start, "endframe:capture");
 
+    BOLT_FRAMETRACE_BEGIN(swapbuffers_start);
     struct SwapBuffersEvent event;
     _bolt_plugin_handle_swapbuffers(&event);
+    _bolt_process_plugin_budgets(micros);
+    BOLT_FRAMETRACE_END(swapbuffers_start, "endframe:swapbuffers");
+    BOLT_FRAMETRACE_BEGIN(overlay_start);
     overlay.draw_to_screen(overlay.userdata, 0, 0, window_width, window_height, 0, 0, window_width, window_height);
     overlay.clear(overlay.userdata, 0.0, 0.0, 0.0, 0.0);
+    managed_functions.flush_screen_draws();
+    BOLT_FRAMETRACE_END(overlay_start, "endframe:overlay");
+
+    // everything queued up for the host during this frame gets sent here in one go
+    BOLT_FRAMETRACE_BEGIN(flush_start);
+    _bolt_ipc_flush(fd);
+    BOLT_FRAMETRACE_END(flush_start, "endframe:ipcflush");
+    BOLT_FRAMETRACE_END(frame_start, "endframe");
 }
 
 void _bolt_plugin_close() {
+    _bolt_ipc_flush(fd);
+    if (ipc_thread_running) {
+        // wakes the IPC thread up with an error if it's waiting for a message, so that it exits
+        shutdown(fd, SHUT_RDWR);
+        _bolt_plugin_thread_join(&ipc_thread);
+        ipc_thread_running = false;
+    }
+    while (ipc_inbox_head) {
+        struct IPCMessage* next = ipc_inbox_head->next;
+        _bolt_ipc_message_discard(ipc_inbox_head);
+        ipc_inbox_head = next;
+    }
+    ipc_inbox_tail = NULL;
+    if (loader_thread_running) {
+        // a plugin that's halfway through loading gets finished first, anything after it is dropped
+        _bolt_plugin_thread_lock(&loader_thread);
+        loader_stopping = true;
+        _bolt_plugin_thread_notify(&loader_thread);
+        _bolt_plugin_thread_unlock(&loader_thread);
+        _bolt_plugin_thread_join(&loader_thread);
+        loader_thread_running = false;
+    }
+    _bolt_free_plugin_loads(loader_inbox_head);
+    _bolt_free_plugin_loads(loader_outbox_head);
+    if (io_thread_running) {
+        // waits for any writes that are still queued, so nothing a plugin saved gets lost
+        _bolt_plugin_thread_lock(&io_thread);
+        io_stopping = true;
+        _bolt_plugin_thread_notify(&io_thread);
+        _bolt_plugin_thread_unlock(&io_thread);
+        _bolt_plugin_thread_join(&io_thread);
+        io_thread_running = false;
+    }
+    _bolt_free_file_jobs(io_inbox_head);
+    _bolt_free_file_jobs(io_outbox_head);
+    io_inbox_head = NULL;
+    io_inbox_tail = NULL;
+    io_outbox_head = NULL;
+    io_outbox_tail = NULL;
+    for (size_t i = 0; i < PNG_DECODER_COUNT; i += 1) {
+        // anything still waiting to be decoded is dropped, the decoder only finishes its current one
+        struct PngDecoder* decoder = &png_decoders[i];
+        if (decoder->running) {
+            _bolt_plugin_thread_lock(&decoder->thread);
+            decoder->stopping = true;
+            _bolt_plugin_thread_notify(&decoder->thread);
+            _bolt_plugin_thread_unlock(&decoder->thread);
+            _bolt_plugin_thread_join(&decoder->thread);
+            decoder->running = false;
+        }
+        _bolt_free_png_jobs(decoder->inbox_head);
+        _bolt_free_png_jobs(decoder->outbox_head);
+        decoder->inbox_head = NULL;
+        decoder->inbox_tail = NULL;
+        decoder->outbox_head = NULL;
+        decoder->outbox_tail = NULL;
+    }
+    _bolt_free_png_jobs(png_ready_head);
+    png_pending = NULL;
+    png_ready_head = NULL;
+    png_ready_tail = NULL;
+    while (image_cache_lru_head) _bolt_image_cache_remove(image_cache_lru_head);
+    hashmap_free(image_cache);
+    loader_inbox_head = NULL;
+    loader_inbox_tail = NULL;
+    loader_outbox_head = NULL;
+    loader_outbox_tail = NULL;
+    _bolt_ipc_release(fd);
     _bolt_plugin_ipc_close(fd);
+    if (ipc_ring_inited) {
+        _bolt_plugin_shm_close(&ipc_ring_shm);
+        ipc_ring_inited = false;
+    }
     size_t iter = 0;
     void* item;
     _bolt_rwlock_lock_write(&windows.lock);
@@ -842,12 +2582,18 @@ void _bolt_plugin_close() {
         if (!window->is_deleted) {
             if (window->is_browser) {
                 _bolt_plugin_shm_close(&window->browser_shm);
+                _bolt_plugin_shm_close(&window->popup_shm);
             }
             managed_functions.surface_destroy(window->surface_functions.userdata);
             _bolt_rwlock_destroy(&window->lock);
         }
     }
     hashmap_clear(windows.map, true);
+    windows.order_count = 0;
+    windows.hit_index.count = 0;
+    windows.hit_index.columns = 0;
+    windows.hit_index.rows = 0;
+    drawn_count = 0;
     _bolt_rwlock_unlock_write(&windows.lock);
     iter = 0;
     while (hashmap_iter(plugins, &iter, &item)) {
@@ -856,36 +2602,73 @@ void _bolt_plugin_close() {
     }
     
     hashmap_free(plugins);
+    callback_interest = 0;
     if (capture_inited) {
         _bolt_plugin_shm_close(&capture_shm);
         capture_inited = false;
     }
+    free(capture_state.regions);
+    free(capture_state.offsets);
+    memset(&capture_state, 0, sizeof(capture_state));
+    for (size_t i = 0; i < capture_tiles_capacity; i += 1) free(capture_tiles[i].hashes);
+    free(capture_tiles);
+    capture_tiles = NULL;
+    capture_tiles_capacity = 0;
+    for (size_t i = 0; i < BUFFER_POOL_CLASSES; i += 1) {
+        while (buffer_pool[i]) {
+            void* next;
+            memcpy(&next, buffer_pool[i], sizeof(next));
+            free(buffer_pool[i]);
+            buffer_pool[i] = next;
+        }
+        buffer_pool_free_count[i] = 0;
+    }
+    texcache_owner = 0;
     inited = 0;
 }
 
 static void _bolt_plugin_notify_stopped(uint64_t id) {
     const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_CLIENT_STOPPED_PLUGIN;
     const struct BoltIPCClientStoppedPluginHeader header = { .plugin_id = id };
-    _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-    _bolt_ipc_send(fd, &header, sizeof(header));
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &header, .len = sizeof(header)},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
 }
 
 struct WindowInfo* _bolt_plugin_windowinfo() {
     return &windows;
 }
 
-static void _bolt_receive_discard(uint64_t amount) {
-    uint8_t buf[0x10000];
-    uint64_t i = 0;
-    while (amount - i > sizeof(buf)) {
-        _bolt_ipc_receive(fd, buf, sizeof(buf));
-        amount -= sizeof(buf);
-    }
-    if (i < amount) {
-        _bolt_ipc_receive(fd, buf, amount - i);
+void _bolt_plugin_bone_transform_from_palette(const float* palette, uint8_t bone_id, struct Transform3D* out) {
+    const float* f = palette + (bone_id * 12);
+    for (size_t col = 0; col < 4; col += 1) {
+        out->matrix[(col * 4) + 0] = (double)f[(col * 3) + 0];
+        out->matrix[(col * 4) + 1] = (double)f[(col * 3) + 1];
+        out->matrix[(col * 4) + 2] = (double)f[(col * 3) + 2];
+        out->matrix[(col * 4) + 3] = col == 3 ? 1.0 : 0.0;
     }
 }
 
+// reads the next part of the message being handled. the IPC thread already knew how long the
+// message was, so handlers reading beyond it would be a bug, but it gets zeroes rather than overrunning
+static void _bolt_message_read(void* data, size_t len) {
+    struct IPCMessage* message = ipc_current_message;
+    const size_t available = message->length - message->offset;
+    const size_t count = len < available ? len : available;
+    memcpy(data, message->data + message->offset, count);
+    if (count < len) memset((uint8_t*)data + count, 0, len - count);
+    message->offset += count;
+}
+
+// skips over the next part of the message being handled
+static void _bolt_message_skip(uint64_t amount) {
+    struct IPCMessage* message = ipc_current_message;
+    const size_t available = message->length - message->offset;
+    message->offset += amount < available ? amount : available;
+}
+
 /// can return nullptr if the browser is nonexistent or deleted
 static struct ExternalBrowser* get_externalbrowser(const uint64_t plugin_id, const uint64_t* window_id) {
     const struct Plugin p = {.id = plugin_id};
@@ -918,15 +2701,23 @@ static void handle_plugin_message(lua_State* state, struct BoltIPCBrowserMessage
     lua_pushinteger(state, BROWSER_ONMESSAGE); /*stack: window table, event table, event id*/
     lua_gettable(state, -2); /*stack: window table, event table, function or nil*/
     if (lua_isfunction(state, -1)) {
-        void* data = malloc(header->message_size);
-        if (!data) {
-            lua_pushfstring(state, "onmessage: heap error, failed to allocate %i bytes", header->message_size);
-            lua_error(state);
-        }
-        _bolt_ipc_receive(fd, data, header->message_size);
-        struct FixedBuffer* buffer = lua_newuserdata(state, sizeof(struct FixedBuffer)); /*stack: window table, event table, function, message*/
-        buffer->data = data;
-        buffer->size = header->message_size;
+        struct IPCMessage* message = ipc_current_message;
+        if (header->message_size > BUFFER_POOL_MAX_SIZE && header->message_size <= message->length - message->offset) {
+            // big messages stay where they were received, and the buffer takes the whole message over,
+            // so that the loop in _bolt_plugin_handle_messages doesn't free it
+            struct FixedBuffer* buffer = push_buffer(state, message->data + message->offset, header->message_size);
+            buffer->storage = BUFFER_STORAGE_MESSAGE;
+            buffer->message = message;
+            message->offset += header->message_size;
+            ipc_current_message = NULL;
+        } else {
+            void* data = push_pooled_buffer(state, header->message_size);
+            if (!data) {
+                lua_pushfstring(state, "onmessage: heap error, failed to allocate %i bytes", header->message_size);
+                lua_error(state);
+            }
+            _bolt_message_read(data, header->message_size);
+        } /*stack: window table, event table, function, message*/
         if (lua_pcall(state, 1, 0, 0)) { /*stack: window table, event table, ?error*/
             const char* e = lua_tolstring(state, -1, 0);
             printf("plugin browser onmessage error: %s\n", e);
@@ -939,7 +2730,7 @@ static void handle_plugin_message(lua_State* state, struct BoltIPCBrowserMessage
             lua_pop(state, 2); /*stack: (empty)*/
         }
     } else {
-        _bolt_receive_discard(header->message_size);
+        _bolt_message_skip(header->message_size);
         lua_pop(state, 3); /*stack: (empty)*/
     }
 }
@@ -969,14 +2760,14 @@ static void handle_close_request(lua_State* state, uint64_t window_id) {
 
 #define IPCCASE(NAME, STRUCT) case IPC_MSG_##NAME: { \
     struct BoltIPC##STRUCT##Header header; \
-    _bolt_ipc_receive(fd, &header, sizeof(header)); \
+    _bolt_message_read(&header, sizeof(header)); \
     handle_ipc_##NAME(&header); \
     break; \
 }
 
 #define IPCCASEWINDOW(NAME, STRUCT) case IPC_MSG_##NAME: { \
     struct BoltIPC##STRUCT##Header header; \
-    _bolt_ipc_receive(fd, &header, sizeof(header)); \
+    _bolt_message_read(&header, sizeof(header)); \
     struct EmbeddedWindow* window = get_embeddedwindow(&header.window_id); \
     if (window) handle_ipc_##NAME(&header, window); \
     break; \
@@ -984,16 +2775,16 @@ static void handle_close_request(lua_State* state, uint64_t window_id) {
 
 #define IPCCASEWINDOWTAIL(NAME, STRUCT) case IPC_MSG_##NAME: { \
     struct BoltIPC##STRUCT##Header header; \
-    _bolt_ipc_receive(fd, &header, sizeof(header)); \
+    _bolt_message_read(&header, sizeof(header)); \
     struct EmbeddedWindow* window = get_embeddedwindow(&header.window_id); \
     if (window) handle_ipc_##NAME(&header, window); \
-    else _bolt_receive_discard(get_tail_ipc_##STRUCT(&header)); \
+    else _bolt_message_skip(get_tail_ipc_##STRUCT(&header)); \
     break; \
 }
 
 #define IPCCASEBROWSER(NAME, STRUCT) case IPC_MSG_##NAME: { \
     struct BoltIPC##STRUCT##Header header; \
-    _bolt_ipc_receive(fd, &header, sizeof(header)); \
+    _bolt_message_read(&header, sizeof(header)); \
     struct ExternalBrowser* window = get_externalbrowser(header.plugin_id, &header.window_id); \
     if (window) handle_ipc_##NAME(&header, window); \
     break; \
@@ -1001,10 +2792,10 @@ static void handle_close_request(lua_State* state, uint64_t window_id) {
 
 #define IPCCASEBROWSERTAIL(NAME, STRUCT) case IPC_MSG_##NAME: { \
     struct BoltIPC##STRUCT##Header header; \
-    _bolt_ipc_receive(fd, &header, sizeof(header)); \
+    _bolt_message_read(&header, sizeof(header)); \
     struct ExternalBrowser* window = get_externalbrowser(header.plugin_id, &header.window_id); \
     if (window) handle_ipc_##NAME(&header, window); \
-    else _bolt_receive_discard(get_tail_ipc_##STRUCT(&header)); \
+    else _bolt_message_skip(get_tail_ipc_##STRUCT(&header)); \
     break; \
 }
 
@@ -1014,66 +2805,198 @@ static void handle_ipc_STARTPLUGIN(struct BoltIPCStartPluginHeader* header) {
     // (see PluginMenu.svelte)
     struct Plugin* plugin = malloc(sizeof(struct Plugin));
     plugin->external_browsers = hashmap_new(sizeof(struct ExternalBrowser), 8, 0, 0, _bolt_window_map_hash, _bolt_window_map_compare, NULL, NULL);
-    plugin->state = luaL_newstate();
+    plugin->workers = hashmap_new(sizeof(struct Worker*), 8, 0, 0, _bolt_window_map_hash, _bolt_window_map_compare, NULL, NULL);
+    plugin->state = NULL;
     plugin->id = header->uid;
     plugin->path = malloc(header->path_size);
     plugin->path_length = header->path_size;
     plugin->config_path = malloc(header->config_path_size);
     plugin->config_path_length = header->config_path_size;
     plugin->ext_browser_capture_count = 0;
+    plugin->callback_interest = 0;
     plugin->is_deleted = false;
-    _bolt_ipc_receive(fd, plugin->path, header->path_size);
-    char* full_path = lua_newuserdata(plugin->state, header->path_size + header->main_size + 1);
-    memcpy(full_path, plugin->path, header->path_size);
-    _bolt_ipc_receive(fd, full_path + header->path_size, header->main_size);
-    _bolt_ipc_receive(fd, plugin->config_path, header->config_path_size);
-    full_path[header->path_size + header->main_size] = '\0';
-    if (_bolt_plugin_add(full_path, plugin)) {
-        lua_pop(plugin->state, 1);
+    memset(plugin->stats, 0, sizeof(plugin->stats));
+    plugin->frames_over_budget = 0;
+    plugin->frames_throttled = 0;
+    plugin->budget_nanos = 0;
+    plugin->frame_nanos = 0;
+    plugin->over_budget_streak = 0;
+    plugin->is_throttled = false;
+    plugin->budget_warned = false;
+    _bolt_message_read(plugin->path, header->path_size);
+    struct PluginLoad* load = malloc(sizeof(struct PluginLoad));
+    load->next = NULL;
+    load->plugin = plugin;
+    load->path = malloc(header->path_size + header->main_size + 1);
+    load->failed = false;
+    memcpy(load->path, plugin->path, header->path_size);
+    _bolt_message_read(load->path + header->path_size, header->main_size);
+    _bolt_message_read(plugin->config_path, header->config_path_size);
+    load->path[header->path_size + header->main_size] = '\0';
+
+    // reading and compiling the plugin's files is slow enough to drop frames, so that's left to the
+    // loader thread and the plugin will be started by _bolt_process_plugin_loads once it's done
+    if (loader_thread_running) {
+        _bolt_plugin_thread_lock(&loader_thread);
+        if (loader_inbox_tail) loader_inbox_tail->next = load;
+        else loader_inbox_head = load;
+        loader_inbox_tail = load;
+        _bolt_plugin_thread_notify(&loader_thread);
+        _bolt_plugin_thread_unlock(&loader_thread);
     } else {
-        _bolt_plugin_notify_stopped(header->uid);
-        plugin->is_deleted = true;
+        load->failed = !_bolt_plugin_prepare(load->path, plugin);
+        if (loader_outbox_tail) loader_outbox_tail->next = load;
+        else loader_outbox_head = load;
+        loader_outbox_tail = load;
     }
 }
 
+static size_t get_tail_ipc_StartPlugin(const struct BoltIPCStartPluginHeader* header) {
+    return (size_t)header->path_size + (size_t)header->main_size + (size_t)header->config_path_size;
+}
+
 static void handle_ipc_HOST_STOPPED_PLUGIN(struct BoltIPCHostStoppedPluginHeader* header) {
     _bolt_plugin_stop(header->plugin_id);
 }
 
 static size_t get_tail_ipc_OsrUpdate(const struct BoltIPCOsrUpdateHeader* header) {
-    return (size_t)header->width * (size_t)header->height * 4;
+    return (size_t)header->rect_count * sizeof(struct BoltIPCOsrUpdateRect);
+}
+
+static void send_osr_update_ack(struct EmbeddedWindow* window, uint64_t generation, uint8_t is_popup) {
+    const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_OSRUPDATE_ACK;
+    const struct BoltIPCOsrUpdateAckHeader ack_header = { .window_id = window->id, .plugin_id = window->plugin_id, .generation = generation, .is_popup = is_popup };
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &ack_header, .len = sizeof(ack_header)},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
+}
+
+// OSR damage is read and merged this many rects at a time
+#define DAMAGE_MERGE_BATCH 64
+// two damage rects get merged if their bounding box is at most this many pixels bigger than the
+// two of them added together, since one bigger upload is cheaper than two small ones
+#define DAMAGE_MERGE_SLACK 4096
+
+// merges damage rects in place wherever uploading their bounding box would cost little more than
+// uploading them separately, and always if they overlap, then returns how many are left
+static uint32_t merge_damage_rects(struct BoltIPCOsrUpdateRect* rects, uint32_t count) {
+    for (uint32_t i = 0; i < count; i += 1) {
+        for (uint32_t j = i + 1; j < count;) {
+            const struct BoltIPCOsrUpdateRect* a = &rects[i];
+            const struct BoltIPCOsrUpdateRect* b = &rects[j];
+            const int x1 = a->x < b->x ? a->x : b->x;
+            const int y1 = a->y < b->y ? a->y : b->y;
+            const int x2 = (a->x + a->w) > (b->x + b->w) ? (a->x + a->w) : (b->x + b->w);
+            const int y2 = (a->y + a->h) > (b->y + b->h) ? (a->y + a->h) : (b->y + b->h);
+            const int64_t merged_area = (int64_t)(x2 - x1) * (y2 - y1);
+            const int64_t separate_area = ((int64_t)a->w * a->h) + ((int64_t)b->w * b->h);
+            const uint8_t overlap = a->x < b->x + b->w && b->x < a->x + a->w && a->y < b->y + b->h && b->y < a->y + a->h;
+            if (overlap || merged_area <= separate_area + DAMAGE_MERGE_SLACK) {
+                rects[i] = (struct BoltIPCOsrUpdateRect){.x = x1, .y = y1, .w = x2 - x1, .h = y2 - y1};
+                count -= 1;
+                rects[j] = rects[count];
+                // rect i just got bigger, so it has to be checked against everything again
+                j = i + 1;
+            } else {
+                j += 1;
+            }
+        }
+    }
+    return count;
+}
+
+// receives rect_count damage rects from the socket and uploads those parts of the frame to the surface
+static void upload_osr_damage(const struct SurfaceFunctions* functions, const uint8_t* frame, int width, uint32_t rect_count) {
+    struct BoltIPCOsrUpdateRect rects[DAMAGE_MERGE_BATCH];
+    const size_t row_length = (size_t)width * 4;
+    uint32_t remaining = rect_count;
+    while (remaining > 0) {
+        // upload exactly the damaged parts of the frame, straight out of the shm, by giving the
+        // backend the frame's stride. damage usually comes in a handful of rects, so it's merged in
+        // batches rather than collecting all of it first.
+        const uint32_t batch = remaining < DAMAGE_MERGE_BATCH ? remaining : DAMAGE_MERGE_BATCH;
+        _bolt_message_read(rects, batch * sizeof(*rects));
+        remaining -= batch;
+        const uint32_t count = merge_damage_rects(rects, batch);
+        for (uint32_t i = 0; i < count; i += 1) {
+            const struct BoltIPCOsrUpdateRect* rect = &rects[i];
+            const void* data_ptr = (const void*)(frame + (row_length * rect->y) + ((size_t)rect->x * 4));
+            functions->subimage(functions->userdata, rect->x, rect->y, rect->w, rect->h, data_ptr, row_length, 1);
+        }
+    }
 }
 
 static void handle_ipc_OSRUPDATE(struct BoltIPCOsrUpdateHeader* header, struct EmbeddedWindow* window) {
-    struct BoltIPCOsrUpdateRect rect;
+    const size_t frame_length = (size_t)header->width * (size_t)header->height * 4;
     if (header->needs_remap) {
-        _bolt_plugin_shm_remap(&window->browser_shm, get_tail_ipc_OsrUpdate(header), header->needs_remap);
-    }
-    for (uint32_t i = 0; i < header->rect_count; i += 1) {
-        // the backend needs contiguous pixels for the rectangle, so here we ignore
-        // the width of the damage and instead update every row of pixels in the
-        // damage area. that way we have contiguous pixels straight out of the shm file.
-        // would it be faster to allocate and build a contiguous pixel rect and use
-        // that as the subimage? probably not.
-        _bolt_ipc_receive(fd, &rect, sizeof(rect));
-        const void* data_ptr = (const void*)((uint8_t*)window->browser_shm.file + (header->width * rect.y * 4));
-        window->surface_functions.subimage(window->surface_functions.userdata, 0, rect.y, header->width, rect.h, data_ptr, 1);
+        _bolt_plugin_shm_remap(&window->browser_shm, frame_length * BOLT_IPC_OSR_BUFFER_COUNT, header->needs_remap);
     }
-    const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_OSRUPDATE_ACK;
-    const struct BoltIPCOsrUpdateAckHeader ack_header = { .window_id = header->window_id, .plugin_id = window->plugin_id };
-    _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-    _bolt_ipc_send(fd, &ack_header, sizeof(ack_header));
+    const uint8_t* frame = (const uint8_t*)window->browser_shm.file + (frame_length * header->buffer);
+    upload_osr_damage(&window->surface_functions, frame, header->width, header->rect_count);
+    send_osr_update_ack(window, header->generation, false);
+}
+
+// the handles have to be closed whether or not the window still exists, so this isn't IPCCASEWINDOW
+static void handle_ipc_OSRACCELERATEDPAINT(struct BoltIPCOsrAcceleratedPaintHeader* header) {
+    struct SharedTexture texture = {
+        .width = header->width,
+        .height = header->height,
+        .format = header->format,
+        .modifier = header->modifier,
+        .plane_count = header->plane_count,
+        .handle = header->handle,
+    };
+#if !defined(_WIN32)
+    // the IPC thread received the handles, and put them in the tail
+    if (texture.plane_count > SHARED_TEXTURE_MAX_PLANES) {
+        printf("[plugin] couldn't receive %u shared texture handles\n", (unsigned int)texture.plane_count);
+        return;
+    }
+    _bolt_message_read(texture.fds, texture.plane_count * sizeof(*texture.fds));
+    for (uint32_t i = 0; i < texture.plane_count; i += 1) {
+        texture.strides[i] = header->strides[i];
+        texture.offsets[i] = header->offsets[i];
+    }
+#endif
+
+    struct EmbeddedWindow* window = get_embeddedwindow(&header->window_id);
+    if (window && header->is_popup) {
+        if (!window->popup_initialised) {
+            managed_functions.surface_init(&window->popup_surface_functions, header->width, header->height, NULL);
+            window->popup_initialised = true;
+        } else if (header->width != window->popup_meta.width || header->height != window->popup_meta.height) {
+            managed_functions.surface_resize_and_clear(window->popup_surface_functions.userdata, header->width, header->height);
+        }
+        window->popup_meta.width = header->width;
+        window->popup_meta.height = header->height;
+        if (!window->popup_surface_functions.copy_shared_texture(window->popup_surface_functions.userdata, &texture)) {
+            printf("[plugin] couldn't import shared texture for popup of window %llu\n", (unsigned long long)header->window_id);
+        }
+    } else if (window) {
+        if (!window->surface_functions.copy_shared_texture(window->surface_functions.userdata, &texture)) {
+            printf("[plugin] couldn't import shared texture for window %llu\n", (unsigned long long)header->window_id);
+        }
+        send_osr_update_ack(window, header->generation, false);
+    }
+
+#if defined(_WIN32)
+    if (texture.handle) CloseHandle(texture.handle);
+#else
+    for (uint32_t i = 0; i < texture.plane_count; i += 1) close(texture.fds[i]);
+#endif
 }
 
-static size_t get_tail_ipc_OsrPopupContents(const struct BoltIPCOsrPopupContentsHeader* header) {
-    return (size_t)header->width * (size_t)header->height * 4;
+static size_t get_tail_ipc_OsrPopupUpdate(const struct BoltIPCOsrPopupUpdateHeader* header) {
+    return (size_t)header->rect_count * sizeof(struct BoltIPCOsrUpdateRect);
 }
 
-static void handle_ipc_OSRPOPUPCONTENTS(struct BoltIPCOsrPopupContentsHeader* header, struct EmbeddedWindow* window) {
-    const size_t rgba_size = get_tail_ipc_OsrPopupContents(header);
-    void* rgba = lua_newuserdata(window->plugin, rgba_size);
+static void handle_ipc_OSRPOPUPUPDATE(struct BoltIPCOsrPopupUpdateHeader* header, struct EmbeddedWindow* window) {
     struct EmbeddedWindowMetadata* meta = &window->popup_meta;
-    _bolt_ipc_receive(fd, rgba, rgba_size);
+    if (header->needs_remap) {
+        _bolt_plugin_shm_remap(&window->popup_shm, (size_t)header->width * (size_t)header->height * 4, header->needs_remap);
+    }
     if (!window->popup_initialised) {
         managed_functions.surface_init(&window->popup_surface_functions, header->width, header->height, NULL);
         window->popup_initialised = true;
@@ -1082,8 +3005,8 @@ static void handle_ipc_OSRPOPUPCONTENTS(struct BoltIPCOsrPopupContentsHeader* he
     }
     meta->width = header->width;
     meta->height = header->height;
-    window->popup_surface_functions.subimage(window->popup_surface_functions.userdata, 0, 0, header->width, header->height, rgba, true);
-    lua_pop(window->plugin, 1);
+    upload_osr_damage(&window->popup_surface_functions, (const uint8_t*)window->popup_shm.file, header->width, header->rect_count);
+    send_osr_update_ack(window, header->generation, true);
 }
 
 static void handle_ipc_OSRPOPUPPOSITION(struct BoltIPCOsrPopupPositionHeader* header, struct EmbeddedWindow* window) {
@@ -1134,49 +3057,330 @@ static void handle_ipc_OSRCAPTUREDONE(struct BoltIPCOsrCaptureDoneHeader* header
     window->capture_ready = true;
 }
 
-void _bolt_plugin_handle_messages() {
-    enum BoltIPCMessageTypeToHost msg_type;
-    while (_bolt_ipc_poll(fd)) {
-        if (_bolt_ipc_receive(fd, &msg_type, sizeof(msg_type)) != 0) break;
-        switch (msg_type) {
-            IPCCASE(STARTPLUGIN, StartPlugin)
-            IPCCASE(HOST_STOPPED_PLUGIN, HostStoppedPlugin)
-            IPCCASEWINDOWTAIL(OSRUPDATE, OsrUpdate)
-            IPCCASEWINDOWTAIL(OSRPOPUPCONTENTS, OsrPopupContents)
-            IPCCASEWINDOW(OSRPOPUPPOSITION, OsrPopupPosition)
-            IPCCASEWINDOW(OSRPOPUPVISIBILITY, OsrPopupVisibility)
-            IPCCASEBROWSERTAIL(EXTERNALBROWSERMESSAGE, BrowserMessage)
-            IPCCASEWINDOWTAIL(OSRBROWSERMESSAGE, BrowserMessage)
-            IPCCASEWINDOW(OSRSTARTREPOSITION, OsrStartReposition)
-            IPCCASEWINDOW(OSRCANCELREPOSITION, OsrCancelReposition)
-            IPCCASEBROWSER(BROWSERCLOSEREQUEST, BrowserCloseRequest)
-            IPCCASEWINDOW(OSRCLOSEREQUEST, OsrCloseRequest)
-            IPCCASEBROWSER(EXTERNALCAPTUREDONE, ExternalCaptureDone)
-            IPCCASEWINDOW(OSRCAPTUREDONE, OsrCaptureDone)
-            default:
-                printf("unknown message type %i\n", (int)msg_type);
-                break;
-        }
-    }
+// the host accepted the rings offered in IPC_MSG_IDENTIFY. the receiving side was already switched
+// over by whoever read this message, so switch sending over too, telling the host where our socket
+// messages end
+static void handle_ipc_RINGACCEPT() {
+    if (!ipc_ring_inited) return;
+    const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_RINGSTART;
+    _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
+    _bolt_ipc_set_send_ring(fd, _bolt_ipc_ring_get(ipc_ring_shm.file, 0));
 }
 
-static uint8_t point_in_rect(int x, int y, int rx, int ry, int rw, int rh) {
-    return rx <= x && rx + rw > x && ry <= y && ry + rh > y;
+// the host's shared texture cache is only used if the user has asked for it
+static void handle_ipc_TEXCACHE(struct BoltIPCTexCacheHeader* header) {
+    const char* env = getenv("BOLT_SHARED_TEXTURE_CACHE");
+    if (env && strcmp(env, "0")) texcache_owner = header->owner;
 }
 
-uint8_t _bolt_plugin_handle_mouse_event(struct MouseEvent* event, ptrdiff_t bool_offset, ptrdiff_t event_offset, uint8_t grab_type, uint8_t* mousein_fake, uint8_t* mousein_real) {
-    uint8_t ret = true;
-    _bolt_rwlock_lock_read(&windows.lock);
+// everything recorded by this process's frame trace, in the form IPC_MSG_FRAMETRACEDATA sends it
+struct FrameTraceData {
+    struct BoltIPCFrameTraceEvent* events;
+    uint32_t event_count;
+    uint32_t event_capacity;
+    const char* names[FRAMETRACE_MAX_NAMES];
+    uint32_t name_offsets[FRAMETRACE_MAX_NAMES];
+    uint32_t name_count;
+    uint32_t names_size;
+};
 
-    // if the left mouse button is being held, try to route this event to the window that was clicked on
-    if (event->mb_left || grab_type == GRAB_TYPE_STOP) {
-        // we can only use this route if the grabbed window actually exists, otherwise fall through.
-        // that will also happen if the actual game window was grabbed, since that has ID 0, which is not a valid hashmap entry.
-        uint64_t* pp = &grabbed_window_id;
-        struct EmbeddedWindow* const* const window = hashmap_get(windows.map, &pp);
-        if (grab_type == GRAB_TYPE_STOP) grabbed_window_id = 0;
-        if (window) {
-            // `window` grabs this input, so route everything here then return.
+static void _bolt_frametrace_collect(const struct BoltFrameTraceEvent* event, void* userdata) {
+    struct FrameTraceData* data = userdata;
+    // scope names are string literals, so there are only ever a few different pointers
+    uint32_t name = 0;
+    while (name < data->name_count && data->names[name] != event->name) name += 1;
+    if (name == data->name_count) {
+        if (name == FRAMETRACE_MAX_NAMES) return;
+        data->names[name] = event->name;
+        data->name_offsets[name] = data->names_size;
+        data->names_size += strlen(event->name) + 1;
+        data->name_count += 1;
+    }
+    if (data->event_count == data->event_capacity) {
+        const uint32_t capacity = data->event_capacity ? data->event_capacity * 2 : BOLT_FRAMETRACE_RING_SIZE;
+        struct BoltIPCFrameTraceEvent* events = realloc(data->events, capacity * sizeof(*events));
+        if (!events) return;
+        data->events = events;
+        data->event_capacity = capacity;
+    }
+    struct BoltIPCFrameTraceEvent* out = &data->events[data->event_count];
+    out->start_micros = event->start_micros;
+    out->duration_micros = event->duration_micros;
+    out->thread = event->thread;
+    out->name_offset = data->name_offsets[name];
+    data->event_count += 1;
+}
+
+// the host starts and stops tracing in every client at once, and merges what they send back
+static void handle_ipc_FRAMETRACE(struct BoltIPCFrameTraceHeader* header) {
+    if (header->running) {
+        _bolt_frametrace_start();
+        return;
+    }
+    _bolt_frametrace_stop();
+    struct FrameTraceData data = {0};
+    _bolt_frametrace_foreach(_bolt_frametrace_collect, &data);
+    char* names = malloc(data.names_size ? data.names_size : 1);
+    if (!names) {
+        // the host still needs an answer, even if it's an empty one
+        data.event_count = 0;
+        data.names_size = 0;
+    }
+    for (uint32_t i = 0; names && i < data.name_count; i += 1) {
+        memcpy(names + data.name_offsets[i], data.names[i], strlen(data.names[i]) + 1);
+    }
+    const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_FRAMETRACEDATA;
+    const struct BoltIPCFrameTraceDataHeader data_header = {
+        .trace_id = header->trace_id,
+        .pid = getpid(),
+        .event_count = data.event_count,
+        .names_size = data.names_size,
+    };
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &data_header, .len = sizeof(data_header)},
+        {.data = data.events, .len = data.event_count * sizeof(*data.events)},
+        {.data = names, .len = data.names_size},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
+    free(data.events);
+    free(names);
+}
+
+#if defined(_WIN32)
+static size_t get_tail_ipc_OsrAcceleratedPaint(const struct BoltIPCOsrAcceleratedPaintHeader* header) {
+    return 0;
+}
+#else
+// the tail is the plane fds, which come from ipc_receive_handles rather than ipc_receive.
+// _bolt_receive_message has already checked plane_count by the time this is called.
+static size_t get_tail_ipc_OsrAcceleratedPaint(const struct BoltIPCOsrAcceleratedPaintHeader* header) {
+    return header->plane_count * sizeof(int);
+}
+#endif
+
+// frees a message that's being dropped without being handled. a shared texture message owns handles
+// that only its handler would otherwise have closed, so those get closed here instead.
+static void _bolt_ipc_message_discard(struct IPCMessage* message) {
+    enum BoltIPCMessageTypeToClient msg_type;
+    memcpy(&msg_type, message->data, sizeof(msg_type));
+    if (msg_type == IPC_MSG_OSRACCELERATEDPAINT) {
+        struct BoltIPCOsrAcceleratedPaintHeader header;
+        const uint8_t* ptr = message->data + sizeof(msg_type);
+        memcpy(&header, ptr, sizeof(header));
+#if defined(_WIN32)
+        if (header.handle) CloseHandle(header.handle);
+#else
+        // the tail is only there if ipc_receive_handles succeeded, so go by its length, not plane_count
+        const size_t tail_size = message->length - sizeof(msg_type) - sizeof(header);
+        for (size_t i = 0; i < tail_size / sizeof(int); i += 1) {
+            int handle;
+            memcpy(&handle, ptr + sizeof(header) + (i * sizeof(int)), sizeof(handle));
+            close(handle);
+        }
+#endif
+    }
+    free(message);
+}
+
+#define IPCSIZE(NAME, STRUCT) case IPC_MSG_##NAME: \
+    header_size = sizeof(struct BoltIPC##STRUCT##Header); \
+    break;
+
+#define IPCTAIL(NAME, STRUCT) case IPC_MSG_##NAME: \
+    tail_size = get_tail_ipc_##STRUCT((const struct BoltIPC##STRUCT##Header*)header.bytes); \
+    break;
+
+// reads one whole message from the host, blocking until all of it has arrived. sets `message` to
+// NULL if the message was unusable but the stream is still intact. returns non-zero if nothing more
+// can be read, either because of an error or a message that can't be understood.
+static uint8_t _bolt_receive_message(struct IPCMessage** message) {
+    enum BoltIPCMessageTypeToClient msg_type;
+    union { uint64_t align; uint8_t bytes[IPC_MAX_HEADER_SIZE]; } header;
+    size_t header_size = 0;
+    size_t tail_size = 0;
+    *message = NULL;
+    if (_bolt_ipc_receive(fd, &msg_type, sizeof(msg_type))) return 1;
+    switch (msg_type) {
+        IPCSIZE(STARTPLUGIN, StartPlugin)
+        IPCSIZE(HOST_STOPPED_PLUGIN, HostStoppedPlugin)
+        IPCSIZE(OSRUPDATE, OsrUpdate)
+        IPCSIZE(OSRPOPUPUPDATE, OsrPopupUpdate)
+        IPCSIZE(OSRPOPUPPOSITION, OsrPopupPosition)
+        IPCSIZE(OSRPOPUPVISIBILITY, OsrPopupVisibility)
+        IPCSIZE(EXTERNALBROWSERMESSAGE, BrowserMessage)
+        IPCSIZE(OSRBROWSERMESSAGE, BrowserMessage)
+        IPCSIZE(OSRSTARTREPOSITION, OsrStartReposition)
+        IPCSIZE(OSRCANCELREPOSITION, OsrCancelReposition)
+        IPCSIZE(BROWSERCLOSEREQUEST, BrowserCloseRequest)
+        IPCSIZE(OSRCLOSEREQUEST, OsrCloseRequest)
+        IPCSIZE(EXTERNALCAPTUREDONE, ExternalCaptureDone)
+        IPCSIZE(OSRCAPTUREDONE, OsrCaptureDone)
+        case IPC_MSG_RINGACCEPT:
+            // anything after this comes on the ring, so the switch can't wait for the handler
+            if (ipc_ring_inited) _bolt_ipc_set_receive_ring(fd, _bolt_ipc_ring_get(ipc_ring_shm.file, 1));
+            break;
+        IPCSIZE(OSRACCELERATEDPAINT, OsrAcceleratedPaint)
+        IPCSIZE(TEXCACHE, TexCache)
+        IPCSIZE(FRAMETRACE, FrameTrace)
+        default:
+            // there's no way to know how long this is, so nothing after it can be read either
+            printf("unknown message type %i\n", (int)msg_type);
+            return 1;
+    }
+    if (header_size > sizeof(header)) {
+        printf("[plugin] message type %i has a header of %llu bytes, which is too big\n", (int)msg_type, (unsigned long long)header_size);
+        return 1;
+    }
+    if (header_size && _bolt_ipc_receive(fd, header.bytes, header_size)) return 1;
+#if !defined(_WIN32)
+    if (msg_type == IPC_MSG_OSRACCELERATEDPAINT) {
+        // the host can't send this many fds with one message, so its handles and ours are out of step and
+        // there's no telling how many more are coming. disconnecting closes any that already arrived.
+        const uint32_t plane_count = ((const struct BoltIPCOsrAcceleratedPaintHeader*)header.bytes)->plane_count;
+        if (plane_count > SHARED_TEXTURE_MAX_PLANES) {
+            printf("[plugin] host sent a shared texture with %u planes, disconnecting\n", (unsigned int)plane_count);
+            return 1;
+        }
+    }
+#endif
+    switch (msg_type) {
+        IPCTAIL(STARTPLUGIN, StartPlugin)
+        IPCTAIL(OSRUPDATE, OsrUpdate)
+        IPCTAIL(OSRPOPUPUPDATE, OsrPopupUpdate)
+        IPCTAIL(EXTERNALBROWSERMESSAGE, BrowserMessage)
+        IPCTAIL(OSRBROWSERMESSAGE, BrowserMessage)
+        IPCTAIL(OSRACCELERATEDPAINT, OsrAcceleratedPaint)
+        default:
+            break;
+    }
+
+    const size_t length = sizeof(msg_type) + header_size + tail_size;
+    struct IPCMessage* ret = malloc(sizeof(struct IPCMessage) + length);
+    if (!ret) {
+        printf("[plugin] heap error, failed to allocate %llu bytes for a message\n", (unsigned long long)length);
+        return 1;
+    }
+    ret->next = NULL;
+    ret->length = length;
+    ret->offset = 0;
+    memcpy(ret->data, &msg_type, sizeof(msg_type));
+    memcpy(ret->data + sizeof(msg_type), header.bytes, header_size);
+    uint8_t* tail = ret->data + sizeof(msg_type) + header_size;
+#if !defined(_WIN32)
+    if (msg_type == IPC_MSG_OSRACCELERATEDPAINT) {
+        if (_bolt_ipc_receive_handles(fd, (int*)tail, tail_size / sizeof(int))) {
+            printf("[plugin] couldn't receive %u shared texture handles\n", (unsigned int)(tail_size / sizeof(int)));
+            free(ret);
+            return 0;
+        }
+        *message = ret;
+        return 0;
+    }
+#endif
+    if (tail_size && _bolt_ipc_receive(fd, tail, tail_size)) {
+        free(ret);
+        return 1;
+    }
+    *message = ret;
+    return 0;
+}
+
+static void _bolt_ipc_thread_main(void* userdata) {
+    while (true) {
+        struct IPCMessage* message;
+        const uint8_t failed = _bolt_receive_message(&message);
+        _bolt_plugin_thread_lock(&ipc_thread);
+        if (message) {
+            if (ipc_inbox_tail) ipc_inbox_tail->next = message;
+            else ipc_inbox_head = message;
+            ipc_inbox_tail = message;
+        }
+        _bolt_plugin_thread_unlock(&ipc_thread);
+        if (failed) return;
+    }
+}
+
+// takes the next message that's ready to be handled, or returns NULL if there isn't one yet
+static struct IPCMessage* _bolt_next_message() {
+    if (!ipc_thread_running) {
+        // no IPC thread, so read here, but only when it won't block
+        struct IPCMessage* message = NULL;
+        while (!message && _bolt_ipc_poll(fd)) {
+            if (_bolt_receive_message(&message)) return NULL;
+        }
+        return message;
+    }
+    _bolt_plugin_thread_lock(&ipc_thread);
+    struct IPCMessage* message = ipc_inbox_head;
+    if (message) {
+        ipc_inbox_head = message->next;
+        if (!ipc_inbox_head) ipc_inbox_tail = NULL;
+    }
+    _bolt_plugin_thread_unlock(&ipc_thread);
+    return message;
+}
+
+void _bolt_plugin_handle_messages() {
+    BOLT_FRAMETRACE_BEGIN(scope_start);
+    uint64_t start = 0;
+    monotonic_microseconds(&start);
+    while (true) {
+        struct IPCMessage* message = _bolt_next_message();
+        if (!message) break;
+        ipc_current_message = message;
+        enum BoltIPCMessageTypeToClient msg_type;
+        _bolt_message_read(&msg_type, sizeof(msg_type));
+        switch (msg_type) {
+            IPCCASE(STARTPLUGIN, StartPlugin)
+            IPCCASE(HOST_STOPPED_PLUGIN, HostStoppedPlugin)
+            IPCCASEWINDOWTAIL(OSRUPDATE, OsrUpdate)
+            IPCCASEWINDOWTAIL(OSRPOPUPUPDATE, OsrPopupUpdate)
+            IPCCASEWINDOW(OSRPOPUPPOSITION, OsrPopupPosition)
+            IPCCASEWINDOW(OSRPOPUPVISIBILITY, OsrPopupVisibility)
+            IPCCASEBROWSERTAIL(EXTERNALBROWSERMESSAGE, BrowserMessage)
+            IPCCASEWINDOWTAIL(OSRBROWSERMESSAGE, BrowserMessage)
+            IPCCASEWINDOW(OSRSTARTREPOSITION, OsrStartReposition)
+            IPCCASEWINDOW(OSRCANCELREPOSITION, OsrCancelReposition)
+            IPCCASEBROWSER(BROWSERCLOSEREQUEST, BrowserCloseRequest)
+            IPCCASEWINDOW(OSRCLOSEREQUEST, OsrCloseRequest)
+            IPCCASEBROWSER(EXTERNALCAPTUREDONE, ExternalCaptureDone)
+            IPCCASEWINDOW(OSRCAPTUREDONE, OsrCaptureDone)
+            case IPC_MSG_RINGACCEPT:
+                handle_ipc_RINGACCEPT();
+                break;
+            IPCCASE(OSRACCELERATEDPAINT, OsrAcceleratedPaint)
+            IPCCASE(TEXCACHE, TexCache)
+            IPCCASE(FRAMETRACE, FrameTrace)
+            default:
+                // can't happen, since the message was read using its type
+                break;
+        }
+        // handlers can take a message over, in which case they'll have set this to NULL
+        free(ipc_current_message);
+        ipc_current_message = NULL;
+
+        // at least one message is always handled, so that a tiny budget can't stall everything
+        uint64_t now = 0;
+        monotonic_microseconds(&now);
+        if (now - start >= ipc_budget_micros) break;
+    }
+    BOLT_FRAMETRACE_END(scope_start, "plugin:handlemessages");
+}
+
+uint8_t _bolt_plugin_handle_mouse_event(struct MouseEvent* event, uint8_t input_type, uint8_t grab_type, uint8_t* mousein_fake, uint8_t* mousein_real) {
+    uint8_t ret = true;
+    _bolt_rwlock_lock_read(&windows.lock);
+
+    // if the left mouse button is being held, try to route this event to the window that was clicked on
+    if (event->mb_left || grab_type == GRAB_TYPE_STOP) {
+        // we can only use this route if the grabbed window actually exists, otherwise fall through.
+        // that will also happen if the actual game window was grabbed, since that has ID 0, which is not a valid hashmap entry.
+        uint64_t* pp = &grabbed_window_id;
+        struct EmbeddedWindow* const* const window = hashmap_get(windows.map, &pp);
+        if (grab_type == GRAB_TYPE_STOP) grabbed_window_id = 0;
+        if (window) {
+            // `window` grabs this input, so route everything here then return.
             uint8_t do_mouseleave = 0;
             _bolt_rwlock_lock_read(&(*window)->lock);
             // if this input is a left-mouse-button-release, then the window has been un-grabbed, so
@@ -1191,14 +3395,8 @@ uint8_t _bolt_plugin_handle_mouse_event(struct MouseEvent* event, ptrdiff_t bool
             _bolt_rwlock_unlock_read(&(*window)->lock);
 
             // write the relevant events to the window
-            _bolt_rwlock_lock_write(&(*window)->input_lock);
-            *(uint8_t*)(((uint8_t*)&(*window)->input) + bool_offset) = 1;
-            *(struct MouseEvent*)(((uint8_t*)&(*window)->input) + event_offset) = *event;
-            if (do_mouseleave) {
-                (*window)->input.mouse_leave = 1;
-                (*window)->input.mouse_leave_event = *event;
-            }
-            _bolt_rwlock_unlock_write(&(*window)->input_lock);
+            _bolt_plugin_input_post(&(*window)->input, input_type, event);
+            if (do_mouseleave) _bolt_plugin_input_post(&(*window)->input, INPUT_MOUSE_LEAVE, event);
 
             // save this window as the most recent one to receive an event, unlock the windows mutex
             // before returning, then return 0 to indicate that this event shouldn't be forwarded to the game
@@ -1208,49 +3406,32 @@ uint8_t _bolt_plugin_handle_mouse_event(struct MouseEvent* event, ptrdiff_t bool
         }
     }
 
-    // normal route - look through all the windows to find one that's under the cursor
-    size_t iter = 0;
-    void* item;
+    // normal route - find the topmost window that's under the cursor, if any. if there is one, set
+    // `ret` to false, to indicate that this event shouldn't be forwarded to the game.
     const uint64_t* pp = &last_mouseevent_window_id;
     struct EmbeddedWindow* const* mouseleave_window = hashmap_get(windows.map, &pp);
-    while (hashmap_iter(windows.map, &iter, &item)) {
-        struct EmbeddedWindow* const* const window = item;
-
-        // if the mouse is in this rect, set `ret` to false, to 0 that this event shouldn't be
-        // forwarded to the game, and that this loop shouldn't continue after this iteration.
-        _bolt_rwlock_lock_read(&(*window)->lock);
-        if (point_in_rect(event->x, event->y, (*window)->metadata.x, (*window)->metadata.y, (*window)->metadata.width, (*window)->metadata.height)) {
-            // offset the x and y to be relative to the embedded window instead of the game client area
-            event->x -= (*window)->metadata.x;
-            event->y -= (*window)->metadata.y;
-            ret = false;
-        }
-        _bolt_rwlock_unlock_read(&(*window)->lock);
-
-        if (!ret) {
-            // if this is the same window as the previous one that received a mouse event, set
-            // `mouseleave_window` to null, to indicate that no mouseleave event needs to be sent
-            // anywhere. otherwise, leave it set, but update `last_mouseevent_window_id`.
-            if (last_mouseevent_window_id == (*window)->id) mouseleave_window = NULL;
-            else last_mouseevent_window_id = (*window)->id;
-            if (mousein_fake) *mousein_fake = false;
-            if (grab_type == GRAB_TYPE_START) grabbed_window_id = (*window)->id;
-
-            // write the relevant event to this window
-            _bolt_rwlock_lock_write(&(*window)->input_lock);
-            (*window)->input.mouse_leave = 0;
-            *(uint8_t*)(((uint8_t*)&(*window)->input) + bool_offset) = 1;
-            *(struct MouseEvent*)(((uint8_t*)&(*window)->input) + event_offset) = *event;
-            _bolt_rwlock_unlock_write(&(*window)->input_lock);
-            break;
-        }
+    struct EmbeddedWindowMetadata rect;
+    struct EmbeddedWindow* window = _bolt_plugin_window_at(event->x, event->y, &rect);
+    if (window) {
+        // offset the x and y to be relative to the embedded window instead of the game client area
+        event->x -= rect.x;
+        event->y -= rect.y;
+        ret = false;
+
+        // if this is the same window as the previous one that received a mouse event, set
+        // `mouseleave_window` to null, to indicate that no mouseleave event needs to be sent
+        // anywhere. otherwise, leave it set, but update `last_mouseevent_window_id`.
+        if (last_mouseevent_window_id == window->id) mouseleave_window = NULL;
+        else last_mouseevent_window_id = window->id;
+        if (mousein_fake) *mousein_fake = false;
+        if (grab_type == GRAB_TYPE_START) grabbed_window_id = window->id;
+
+        // write the relevant event to this window. this also cancels any pending mouseleave
+        _bolt_plugin_input_post(&window->input, input_type, event);
     }
     // if a window needs to receive a mouseleave event, set it now before unlocking the windows mutex.
     if (mouseleave_window) {
-        _bolt_rwlock_lock_write(&(*mouseleave_window)->input_lock);
-        (*mouseleave_window)->input.mouse_leave = 1;
-        (*mouseleave_window)->input.mouse_leave_event = *event;
-        _bolt_rwlock_unlock_write(&(*mouseleave_window)->input_lock);
+        _bolt_plugin_input_post(&(*mouseleave_window)->input, INPUT_MOUSE_LEAVE, event);
     }
     _bolt_rwlock_unlock_read(&windows.lock);
 
@@ -1260,34 +3441,504 @@ uint8_t _bolt_plugin_handle_mouse_event(struct MouseEvent* event, ptrdiff_t bool
     last_mouseevent_window_id = 0;
     if (mousein_fake) *mousein_fake = true;
     if (mousein_real) *mousein_real = true;
-    _bolt_rwlock_lock_write(&windows.input_lock);
-    *(uint8_t*)(((uint8_t*)&windows.input) + bool_offset) = 1;
-    *(struct MouseEvent*)(((uint8_t*)&windows.input) + event_offset) = *event;
-    _bolt_rwlock_unlock_write(&windows.input_lock);
+    _bolt_plugin_input_post(&windows.input, input_type, event);
     return true;
 }
 
-uint8_t _bolt_plugin_add(const char* path, struct Plugin* plugin) {
-    // load the user-provided string as a lua function, putting that function on the stack
-    if (luaL_loadfile(plugin->state, path)) {
-        const char* e = lua_tolstring(plugin->state, -1, 0);
-        printf("plugin load error: %s\n", e);
-        lua_pop(plugin->state, 1);
-        return 0;
+// run by _bolt_open_libraries with the ffi library as its only argument, returning the function that
+// api_buffer_view calls to make a view. the ffi itself is never reachable from plugin code, since it
+// would let plugins read and write anything in the game's memory. instead, each view is a table whose
+// protected metatable does the indexing through a typed pointer, which the jit compiles down to a bounds
+// check and a load or store. the pointer and the bounds are upvalues, which plugins can't get at without
+// the debug library, and the metatable keeps the Buffer alive. the buffer's data and size are read again
+// on every access, because sending a buffer to or from a worker takes its data away.
+static const char buffer_view_chunk[] =
+    "local ffi = ...\n"
+    "local type, error, setmetatable = type, error, setmetatable\n"
+    "ffi.cdef('struct BoltFixedBuffer { uint8_t* data; size_t size; };')\n"
+    "local buffer_ptr = ffi.typeof('const struct BoltFixedBuffer*')\n"
+    "local pointer_types = {}\n"
+    "return function(buffer, owner, ctype, offset, element_size, count)\n"
+    "  local ptr_type = pointer_types[ctype]\n"
+    "  if not ptr_type then ptr_type = ffi.typeof(ctype .. '*') pointer_types[ctype] = ptr_type end\n"
+    "  local b = ffi.cast(buffer_ptr, buffer)\n"
+    "  local function check(i)\n"
+    "    if type(i) ~= 'number' or not (i >= 1 and i <= count) then error('view index is out of bounds', 3) end\n"
+    "    if offset + (i * element_size) > b.size then error('view is no longer valid, since its buffer has been emptied', 3) end\n"
+    "  end\n"
+    "  return setmetatable({count = count}, {\n"
+    "    __index = function(_, i) check(i) return ffi.cast(ptr_type, b.data + offset)[i - 1] end,\n"
+    "    __newindex = function(_, i, v) check(i) ffi.cast(ptr_type, b.data + offset)[i - 1] = v end,\n"
+    "    __metatable = false,\n"
+    "    buffer = owner,\n"
+    "  })\n"
+    "end\n";
+
+// opens just the specific libraries plugins are allowed to have, with `require("bolt")` returning
+// the result of `api_init` and `require` searching only in the plugin's root directory
+static void _bolt_open_libraries(lua_State* state, const char* root, uint32_t root_length, lua_CFunction api_init) {
+    lua_pushcfunction(state, luaopen_base);
+    lua_call(state, 0, 0);
+    lua_pushcfunction(state, luaopen_package);
+    lua_call(state, 0, 0);
+    lua_pushcfunction(state, luaopen_string);
+    lua_call(state, 0, 0);
+    lua_pushcfunction(state, luaopen_table);
+    lua_call(state, 0, 0);
+    lua_pushcfunction(state, luaopen_math);
+    lua_call(state, 0, 0);
+
+    // opening the jit library is what turns the compiler on. the ffi is only given to buffer_view_chunk,
+    // and only the function that returns is kept. neither library is left anywhere plugins can find it
+    lua_pushcfunction(state, luaopen_jit);
+    lua_call(state, 0, 0);
+    if (!luaL_loadbuffer(state, buffer_view_chunk, sizeof(buffer_view_chunk) - 1, "bufferview")) {
+        lua_pushcfunction(state, luaopen_ffi);
+        lua_call(state, 0, 1);
+        if (!lua_pcall(state, 1, 1, 0)) {
+            lua_setfield(state, LUA_REGISTRYINDEX, BUFFERVIEW_REGISTRYNAME);
+        } else {
+            printf("[plugin] buffer views unavailable: %s\n", lua_tostring(state, -1));
+            lua_pop(state, 1);
+        }
+    } else {
+        lua_pop(state, 1);
+    }
+    lua_pushnil(state);
+    lua_setfield(state, LUA_GLOBALSINDEX, "jit");
+    lua_getfield(state, LUA_GLOBALSINDEX, "package");
+    static const char* const hidden_modules[] = {"jit", "jit.opt", "jit.util", "jit.profile", "ffi"};
+    for (size_t i = 0; i < sizeof(hidden_modules) / sizeof(*hidden_modules); i += 1) {
+        lua_getfield(state, -1, "loaded");
+        lua_pushnil(state);
+        lua_setfield(state, -2, hidden_modules[i]);
+        lua_getfield(state, -2, "preload");
+        lua_pushnil(state);
+        lua_setfield(state, -2, hidden_modules[i]);
+        lua_pop(state, 2);
     }
+    lua_pop(state, 1);
 
-    // put this into our list of plugins (important to do this before lua_pcall)
-    struct Plugin* const* old_plugin = hashmap_set(plugins, &plugin);
-    if (hashmap_oom(plugins)) {
+    // load Bolt API into package.preload, so that `require("bolt")` will find it
+    lua_getfield(state, LUA_GLOBALSINDEX, "package");
+    lua_getfield(state, -1, "preload");
+    lua_pushliteral(state, "bolt");
+    lua_pushcfunction(state, api_init);
+    lua_settable(state, -3);
+    // now set package.path to the plugin's root path
+    char* search_path = lua_newuserdata(state, root_length + 5);
+    memcpy(search_path, root, root_length);
+    memcpy(&search_path[root_length], "?.lua", 5);
+    lua_pushliteral(state, "path");
+    lua_pushlstring(state, search_path, root_length + 5);
+    lua_settable(state, -5);
+    lua_pop(state, 2);
+    // finally, restrict package.loaders by removing the module searcher and all-in-one searcher,
+    // because these can load .dll and .so files which are a huge security concern, and also
+    // because stupid people will make windows-only plugins with it and I'm not dealing with that
+    lua_getfield(state, -1, "loaders");
+    lua_pushnil(state);
+    lua_pushnil(state);
+    lua_rawseti(state, -3, 3);
+    lua_rawseti(state, -2, 4);
+    lua_pop(state, 2);
+}
+
+#define BYTECODE_CACHE_MAGIC "BOLTLJBC"
+#define BYTECODE_CACHE_FORMAT 1
+
+// start of a file in the bytecode cache, followed by the path of the source file it was compiled
+// from and then the bytecode itself. an entry is only used if everything before `bytecode_size`
+// matches the source file as it is now, otherwise the file gets compiled again and the entry replaced
+struct BytecodeCacheHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t luajit_version; // bytecode from a different version of LuaJIT isn't guaranteed to load
+    int64_t mtime;
+    uint64_t source_size;
+    uint64_t source_hash;
+    uint32_t path_length;
+    uint32_t padding;
+    uint64_t bytecode_size;
+    uint64_t bytecode_hash;
+};
+
+// growable buffer for lua_dump to write bytecode into
+struct BytecodeWriter {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+};
+
+static uint64_t _bolt_bytecode_hash(const void* data, size_t size) {
+    return hashmap_sip(data, size, 0, 0);
+}
+
+// reads a whole file into a newly malloc'd buffer, returning NULL on failure
+static uint8_t* _bolt_read_file(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    const long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = file_size >= 0 ? malloc(file_size ? file_size : 1) : NULL;
+    if (!data || fread(data, 1, file_size, f) < (size_t)file_size) {
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *size = file_size;
+    return data;
+}
+
+static int _bolt_bytecode_writer(lua_State* state, const void* p, size_t size, void* userdata) {
+    struct BytecodeWriter* writer = userdata;
+    if (writer->size + size > writer->capacity) {
+        size_t capacity = writer->capacity ? writer->capacity * 2 : 4096;
+        while (capacity < writer->size + size) capacity *= 2;
+        uint8_t* data = realloc(writer->data, capacity);
+        if (!data) return 1;
+        writer->data = data;
+        writer->capacity = capacity;
+    }
+    memcpy(writer->data + writer->size, p, size);
+    writer->size += size;
+    return 0;
+}
+
+// tries to load a function from the bytecode cache onto the stack, returning 1 on success, or 0 if
+// there's no usable entry, in which case nothing is pushed
+static uint8_t _bolt_load_cached_bytecode(lua_State* state, const char* cache_path, const struct BytecodeCacheHeader* expected, const char* path, const char* chunkname) {
+    FILE* f = fopen(cache_path, "rb");
+    if (!f) return 0;
+    struct BytecodeCacheHeader header;
+    uint8_t ok = fread(&header, sizeof(header), 1, f) == 1 && !memcmp(&header, expected, offsetof(struct BytecodeCacheHeader, bytecode_size));
+    uint8_t* data = NULL;
+    if (ok) {
+        const size_t size = (size_t)header.path_length + (size_t)header.bytecode_size;
+        data = malloc(size);
+        ok = data && fread(data, 1, size, f) == size && !memcmp(data, path, header.path_length)
+            && _bolt_bytecode_hash(data + header.path_length, header.bytecode_size) == header.bytecode_hash;
+    }
+    fclose(f);
+    if (ok && luaL_loadbuffer(state, (const char*)data + header.path_length, header.bytecode_size, chunkname)) {
+        // LuaJIT was probably built with different options than whatever wrote this, so recompile it
+        lua_pop(state, 1);
+        ok = 0;
+    }
+    free(data);
+    return ok;
+}
+
+// writes the function on top of the stack to the bytecode cache. it's written to a temporary file
+// and moved into place, so nothing ever sees a half-written entry, even if two threads are caching
+// the same file at once
+static void _bolt_save_bytecode(lua_State* state, const char* cache_path, const struct BytecodeCacheHeader* expected, const char* path) {
+    struct BytecodeWriter writer = {.data = NULL, .size = 0, .capacity = 0};
+    if (lua_dump(state, _bolt_bytecode_writer, &writer)) {
+        free(writer.data);
+        return;
+    }
+    struct BytecodeCacheHeader header = *expected;
+    header.bytecode_size = writer.size;
+    header.bytecode_hash = _bolt_bytecode_hash(writer.data, writer.size);
+
+    char temp_path[sizeof(bytecode_cache_dir) + 64];
+    snprintf(temp_path, sizeof(temp_path), "%s.%p.tmp", cache_path, (void*)state);
+    FILE* f = fopen(temp_path, "wb");
+    if (f) {
+        const uint8_t ok = fwrite(&header, sizeof(header), 1, f) == 1
+            && fwrite(path, 1, header.path_length, f) == header.path_length
+            && fwrite(writer.data, 1, writer.size, f) == writer.size;
+        const uint8_t closed = !fclose(f);
+        if (ok && closed) _bolt_plugin_file_replace(temp_path, cache_path);
+        else remove(temp_path);
+    }
+    free(writer.data);
+}
+
+// loads a Lua file onto the top of the stack as a function, the same as luaL_loadfile, except that
+// the compiled bytecode is cached on disk so the file doesn't need to be parsed again next time,
+// unless it's changed. returns 0 on success, like luaL_loadfile. safe to call from any thread.
+static int _bolt_load_chunk(lua_State* state, const char* path) {
+    // mtime is checked before reading, so if the file changes in between, the entry will be stale
+    // next time rather than looking valid for the wrong content
+    int64_t mtime;
+    const uint8_t can_cache = bytecode_cache_dir[0] && _bolt_plugin_file_mtime(path, &mtime);
+    size_t source_size;
+    uint8_t* source = _bolt_read_file(path, &source_size);
+    // let LuaJIT report any problem with the file the way it normally would
+    if (!source) return luaL_loadfile(state, path);
+
+    const size_t path_length = strlen(path);
+    char* chunkname = malloc(path_length + 2);
+    chunkname[0] = '@';
+    memcpy(chunkname + 1, path, path_length + 1);
+
+    struct BytecodeCacheHeader expected;
+    char cache_path[sizeof(bytecode_cache_dir) + 32];
+    if (can_cache) {
+        memset(&expected, 0, sizeof(expected));
+        memcpy(expected.magic, BYTECODE_CACHE_MAGIC, sizeof(expected.magic));
+        expected.format = BYTECODE_CACHE_FORMAT;
+        expected.luajit_version = LUAJIT_VERSION_NUM;
+        expected.mtime = mtime;
+        expected.source_size = source_size;
+        expected.source_hash = _bolt_bytecode_hash(source, source_size);
+        expected.path_length = path_length;
+        snprintf(cache_path, sizeof(cache_path), "%s%016llx.ljbc", bytecode_cache_dir, (unsigned long long)_bolt_bytecode_hash(path, path_length));
+        if (_bolt_load_cached_bytecode(state, cache_path, &expected, path, chunkname)) {
+            free(chunkname);
+            free(source);
+            return 0;
+        }
+    }
+
+    const int ret = luaL_loadbuffer(state, (const char*)source, source_size, chunkname);
+    if (!ret && can_cache) _bolt_save_bytecode(state, cache_path, &expected, path);
+    free(chunkname);
+    free(source);
+    return ret;
+}
+
+// a metatable that gets created in the registry of every new Lua state that needs it. these are laid
+// out once here as static data, so each state just gets a copy of them, with every table allocated
+// at its final size, instead of having to be built up one field at a time
+struct MetatableTemplate {
+    const char* name;
+    const luaL_Reg* index; // functions in the __index table
+    size_t index_size;
+    lua_CFunction gc; // __gc, if not NULL
+};
+#define METATABLE(NAME, INDEX, GC) {.name = NAME, .index = INDEX, .index_size = sizeof(INDEX) / sizeof(*INDEX), .gc = GC}
+
+static const luaL_Reg buffer_index[] = {
+    API_REG(writeinteger, buffer)
+    API_REG(writenumber, buffer)
+    API_REG(writestring, buffer)
+    API_REG(writebuffer, buffer)
+    API_REG(readinteger, buffer)
+    API_REG(readnumber, buffer)
+    API_REG(readstring, buffer)
+    API_REG(size, buffer)
+    API_REG(view, buffer)
+};
+
+static const luaL_Reg batch2d_index[] = {
+    API_REG(vertexcount, batch2d)
+    API_REG(verticesperimage, batch2d)
+    API_REG(isminimap, batch2d)
+    API_REG(targetsize, batch2d)
+    API_REG(vertexxy, batch2d)
+    API_REG(vertexatlasxy, batch2d)
+    API_REG(vertexatlaswh, batch2d)
+    API_REG(vertexatlashash, batch2d)
+    API_REG(vertexatlasphash, batch2d)
+    API_REG(vertexuv, batch2d)
+    API_REG(vertexcolour, batch2d)
+    API_REG(vertices, batch2d)
+    API_REG(textureid, batch2d)
+    API_REG(texturesize, batch2d)
+    API_REG(texturecompare, batch2d)
+    API_REG(texturedata, batch2d)
+    API_REG(snapshot, batch2d)
+    API_REG_ALIAS(vertexcolour, vertexcolor, batch2d)
+};
+
+static const luaL_Reg render3d_index[] = {
+    API_REG(vertexcount, render3d)
+    API_REG(vertexxyz, render3d)
+    API_REG(modelmatrix, render3d)
+    API_REG(viewprojmatrix, render3d)
+    API_REG(vertexmeta, render3d)
+    API_REG(atlasxywh, render3d)
+    API_REG(atlashash, render3d)
+    API_REG(atlasphash, render3d)
+    API_REG(vertexuv, render3d)
+    API_REG(vertexcolour, render3d)
+    API_REG(vertices, render3d)
+    API_REG(skinnedvertices, render3d)
+    API_REG(textureid, render3d)
+    API_REG(texturesize, render3d)
+    API_REG(texturecompare, render3d)
+    API_REG(texturedata, render3d)
+    API_REG(vertexbone, render3d)
+    API_REG(boneanimation, render3d)
+    API_REG(animated, render3d)
+    API_REG(snapshot, render3d)
+    API_REG_ALIAS(vertexcolour, vertexcolor, render3d)
+};
+
+static const luaL_Reg minimap_index[] = {
+    API_REG(angle, minimap)
+    API_REG(scale, minimap)
+    API_REG(position, minimap)
+};
+
+static const luaL_Reg point_index[] = {
+    API_REG(transform, point)
+    API_REG(get, point)
+    API_REG(aspixels, point)
+};
+
+static const luaL_Reg transform_index[] = {
+    API_REG(decompose, transform)
+    API_REG(get, transform)
+    API_REG(combine, transform)
+    API_REG(projectpoints, transform)
+};
+
+static const luaL_Reg surface_index[] = {
+    API_REG(clear, surface)
+    API_REG(subimage, surface)
+    API_REG(drawtoscreen, surface)
+    API_REG(drawtosurface, surface)
+    API_REG(drawtowindow, surface)
+};
+
+static const luaL_Reg window_index[] = {
+    API_REG(close, window)
+    API_REG(id, window)
+    API_REG(size, window)
+    API_REG(clear, window)
+    API_REG(subimage, window)
+    API_REG(startreposition, window)
+    API_REG(cancelreposition, window)
+    API_REG(onreposition, window)
+    API_REG(onmousemotion, window)
+    API_REG(onmousebutton, window)
+    API_REG(onmousebuttonup, window)
+    API_REG(onscroll, window)
+};
+
+static const luaL_Reg browser_index[] = {
+    API_REG(close, browser)
+    API_REG(sendmessage, browser)
+    API_REG(enablecapture, browser)
+    API_REG(disablecapture, browser)
+    API_REG(setcaptureregion, browser)
+    API_REG(setcapturetiled, browser)
+    API_REG(startreposition, window)
+    API_REG(cancelreposition, window)
+    API_REG(oncloserequest, browser)
+    API_REG(onmessage, browser)
+};
+
+static const luaL_Reg embeddedbrowser_index[] = {
+    API_REG(close, embeddedbrowser)
+    API_REG(sendmessage, embeddedbrowser)
+    API_REG(enablecapture, embeddedbrowser)
+    API_REG(disablecapture, embeddedbrowser)
+    API_REG(setcaptureregion, embeddedbrowser)
+    API_REG(setcapturetiled, embeddedbrowser)
+    API_REG(oncloserequest, browser)
+    API_REG(onmessage, browser)
+};
+
+static const luaL_Reg reposition_index[] = {
+    API_REG(xywh, repositionevent)
+    API_REG(didresize, repositionevent)
+};
+
+static const luaL_Reg mouseevent_index[] = {
+    API_REG(xy, mouseevent)
+    API_REG(ctrl, mouseevent)
+    API_REG(shift, mouseevent)
+    API_REG(meta, mouseevent)
+    API_REG(alt, mouseevent)
+    API_REG(capslock, mouseevent)
+    API_REG(numlock, mouseevent)
+    API_REG(mousebuttons, mouseevent)
+};
+
+static const luaL_Reg mousebutton_index[] = {
+    API_REG(xy, mouseevent)
+    API_REG(ctrl, mouseevent)
+    API_REG(shift, mouseevent)
+    API_REG(meta, mouseevent)
+    API_REG(alt, mouseevent)
+    API_REG(capslock, mouseevent)
+    API_REG(numlock, mouseevent)
+    API_REG(mousebuttons, mouseevent)
+    API_REG(button, mousebutton)
+};
+
+static const luaL_Reg scroll_index[] = {
+    API_REG(xy, mouseevent)
+    API_REG(ctrl, mouseevent)
+    API_REG(shift, mouseevent)
+    API_REG(meta, mouseevent)
+    API_REG(alt, mouseevent)
+    API_REG(capslock, mouseevent)
+    API_REG(numlock, mouseevent)
+    API_REG(mousebuttons, mouseevent)
+    API_REG(direction, scroll)
+};
+
+static const luaL_Reg worker_index[] = {
+    API_REG(sendmessage, worker)
+    API_REG(onmessage, worker)
+    API_REG(close, worker)
+};
+
+static const struct MetatableTemplate buffer_metatable = METATABLE(BUFFER_META_REGISTRYNAME, buffer_index, buffer_gc);
+
+static const struct MetatableTemplate plugin_metatables[] = {
+    METATABLE(BATCH2D_META_REGISTRYNAME, batch2d_index, NULL),
+    METATABLE(RENDER3D_META_REGISTRYNAME, render3d_index, NULL),
+    METATABLE(MINIMAP_META_REGISTRYNAME, minimap_index, NULL),
+    METATABLE(POINT_META_REGISTRYNAME, point_index, NULL),
+    METATABLE(TRANSFORM_META_REGISTRYNAME, transform_index, NULL),
+    METATABLE(BUFFER_META_REGISTRYNAME, buffer_index, buffer_gc),
+    {.name = SWAPBUFFERS_META_REGISTRYNAME, .index = NULL, .index_size = 0, .gc = NULL},
+    METATABLE(SURFACE_META_REGISTRYNAME, surface_index, surface_gc),
+    METATABLE(WINDOW_META_REGISTRYNAME, window_index, NULL),
+    METATABLE(BROWSER_META_REGISTRYNAME, browser_index, NULL),
+    METATABLE(EMBEDDEDBROWSER_META_REGISTRYNAME, embeddedbrowser_index, NULL),
+    METATABLE(REPOSITION_META_REGISTRYNAME, reposition_index, NULL),
+    METATABLE(MOUSEMOTION_META_REGISTRYNAME, mouseevent_index, NULL),
+    METATABLE(MOUSEBUTTON_META_REGISTRYNAME, mousebutton_index, NULL),
+    METATABLE(SCROLL_META_REGISTRYNAME, scroll_index, NULL),
+    METATABLE(MOUSELEAVE_META_REGISTRYNAME, mouseevent_index, NULL),
+    METATABLE(WORKER_META_REGISTRYNAME, worker_index, NULL),
+};
+
+static void _bolt_create_metatables(lua_State* state, const struct MetatableTemplate* templates, size_t count) {
+    for (size_t i = 0; i < count; i += 1) {
+        const struct MetatableTemplate* template = &templates[i];
+        lua_pushstring(state, template->name);
+        lua_createtable(state, 0, template->gc ? 2 : 1);
+        lua_pushliteral(state, "__index");
+        lua_createtable(state, 0, template->index_size);
+        for (size_t j = 0; j < template->index_size; j += 1) {
+            lua_pushstring(state, template->index[j].name);
+            lua_pushcfunction(state, template->index[j].func);
+            lua_rawset(state, -3);
+        }
+        lua_rawset(state, -3);
+        if (template->gc) {
+            lua_pushliteral(state, "__gc");
+            lua_pushcfunction(state, template->gc);
+            lua_rawset(state, -3);
+        }
+        lua_rawset(state, LUA_REGISTRYINDEX);
+    }
+}
+
+uint8_t _bolt_plugin_prepare(const char* path, struct Plugin* plugin) {
+    plugin->state = luaL_newstate();
+    if (!plugin->state) {
         printf("plugin load error: out of memory\n");
         return 0;
     }
-    if (old_plugin) {
-        // a plugin with this id was already running and we just overwrote it, so make sure not to leak the memory.
-        // this shouldn't happen in practice because IDs are incremental, but what if someone overflows the ID to 0
-        // by starting 18 quintillion plugins in one session? okay, yes, it's very unlikely.
-        printf("plugin ID %llu has been overwritten by one with the same ID\n", (unsigned long long)plugin->id);
-        (*old_plugin)->is_deleted = true;
+
+    // load the user-provided file as a lua function, putting that function on the stack
+    if (_bolt_load_chunk(plugin->state, path)) {
+        const char* e = lua_tolstring(plugin->state, -1, 0);
+        printf("plugin load error: %s\n", e);
+        lua_pop(plugin->state, 1);
+        return 0;
     }
 
     // add the struct pointer to the registry
@@ -1295,41 +3946,7 @@ uint8_t _bolt_plugin_add(const char* path, struct Plugin* plugin) {
     lua_pushlightuserdata(plugin->state, plugin);
     lua_settable(plugin->state, LUA_REGISTRYINDEX);
 
-    // Open just the specific libraries plugins are allowed to have
-    lua_pushcfunction(plugin->state, luaopen_base);
-    lua_call(plugin->state, 0, 0);
-    lua_pushcfunction(plugin->state, luaopen_package);
-    lua_call(plugin->state, 0, 0);
-    lua_pushcfunction(plugin->state, luaopen_string);
-    lua_call(plugin->state, 0, 0);
-    lua_pushcfunction(plugin->state, luaopen_table);
-    lua_call(plugin->state, 0, 0);
-    lua_pushcfunction(plugin->state, luaopen_math);
-    lua_call(plugin->state, 0, 0);
-
-    // load Bolt API into package.preload, so that `require("bolt")` will find it
-    lua_getfield(plugin->state, LUA_GLOBALSINDEX, "package");
-    lua_getfield(plugin->state, -1, "preload");
-    lua_pushliteral(plugin->state, "bolt");
-    lua_pushcfunction(plugin->state, _bolt_api_init);
-    lua_settable(plugin->state, -3);
-    // now set package.path to the plugin's root path
-    char* search_path = lua_newuserdata(plugin->state, plugin->path_length + 5);
-    memcpy(search_path, plugin->path, plugin->path_length);
-    memcpy(&search_path[plugin->path_length], "?.lua", 5);
-    lua_pushliteral(plugin->state, "path");
-    lua_pushlstring(plugin->state, search_path, plugin->path_length + 5);
-    lua_settable(plugin->state, -5);
-    lua_pop(plugin->state, 2);
-    // finally, restrict package.loaders by removing the module searcher and all-in-one searcher,
-    // because these can load .dll and .so files which are a huge security concern, and also
-    // because stupid people will make windows-only plugins with it and I'm not dealing with that
-    lua_getfield(plugin->state, -1, "loaders");
-    lua_pushnil(plugin->state);
-    lua_pushnil(plugin->state);
-    lua_rawseti(plugin->state, -3, 3);
-    lua_rawseti(plugin->state, -2, 4);
-    lua_pop(plugin->state, 2);
+    _bolt_open_libraries(plugin->state, plugin->path, plugin->path_length, _bolt_api_init);
 
     // create window table (empty)
     lua_pushliteral(plugin->state, WINDOWS_REGISTRYNAME);
@@ -1341,267 +3958,654 @@ uint8_t _bolt_plugin_add(const char* path, struct Plugin* plugin) {
     lua_newtable(plugin->state);
     lua_settable(plugin->state, LUA_REGISTRYINDEX);
 
-    // create the metatable for all RenderBatch2D objects
-    lua_pushliteral(plugin->state, BATCH2D_META_REGISTRYNAME);
+    // create workers table (empty)
+    lua_pushliteral(plugin->state, WORKERS_REGISTRYNAME);
     lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 14);
-    API_ADD_SUB(plugin->state, vertexcount, batch2d)
-    API_ADD_SUB(plugin->state, verticesperimage, batch2d)
-    API_ADD_SUB(plugin->state, isminimap, batch2d)
-    API_ADD_SUB(plugin->state, targetsize, batch2d)
-    API_ADD_SUB(plugin->state, vertexxy, batch2d)
-    API_ADD_SUB(plugin->state, vertexatlasxy, batch2d)
-    API_ADD_SUB(plugin->state, vertexatlaswh, batch2d)
-    API_ADD_SUB(plugin->state, vertexuv, batch2d)
-    API_ADD_SUB(plugin->state, vertexcolour, batch2d)
-    API_ADD_SUB(plugin->state, textureid, batch2d)
-    API_ADD_SUB(plugin->state, texturesize, batch2d)
-    API_ADD_SUB(plugin->state, texturecompare, batch2d)
-    API_ADD_SUB(plugin->state, texturedata, batch2d)
-    API_ADD_SUB_ALIAS(plugin->state, vertexcolour, vertexcolor, batch2d)
-    lua_settable(plugin->state, -3);
     lua_settable(plugin->state, LUA_REGISTRYINDEX);
 
-    // create the metatable for all Render3D objects
-    lua_pushliteral(plugin->state, RENDER3D_META_REGISTRYNAME);
+    // create file callbacks table (empty)
+    lua_pushliteral(plugin->state, FILECALLBACKS_REGISTRYNAME);
     lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 16);
-    API_ADD_SUB(plugin->state, vertexcount, render3d)
-    API_ADD_SUB(plugin->state, vertexxyz, render3d)
-    API_ADD_SUB(plugin->state, modelmatrix, render3d)
-    API_ADD_SUB(plugin->state, viewprojmatrix, render3d)
-    API_ADD_SUB(plugin->state, vertexmeta, render3d)
-    API_ADD_SUB(plugin->state, atlasxywh, render3d)
-    API_ADD_SUB(plugin->state, vertexuv, render3d)
-    API_ADD_SUB(plugin->state, vertexcolour, render3d)
-    API_ADD_SUB(plugin->state, textureid, render3d)
-    API_ADD_SUB(plugin->state, texturesize, render3d)
-    API_ADD_SUB(plugin->state, texturecompare, render3d)
-    API_ADD_SUB(plugin->state, texturedata, render3d)
-    API_ADD_SUB(plugin->state, vertexbone, render3d)
-    API_ADD_SUB(plugin->state, boneanimation, render3d)
-    API_ADD_SUB(plugin->state, animated, render3d)
-    API_ADD_SUB_ALIAS(plugin->state, vertexcolour, vertexcolor, render3d)
-    lua_settable(plugin->state, -3);
     lua_settable(plugin->state, LUA_REGISTRYINDEX);
 
-    // create the metatable for all RenderMinimap objects
-    lua_pushliteral(plugin->state, MINIMAP_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 3);
-    API_ADD_SUB(plugin->state, angle, minimap)
-    API_ADD_SUB(plugin->state, scale, minimap)
-    API_ADD_SUB(plugin->state, position, minimap)
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+    _bolt_create_metatables(plugin->state, plugin_metatables, sizeof(plugin_metatables) / sizeof(*plugin_metatables));
+    return 1;
+}
 
-    // create the metatable for all Point objects
-    lua_pushliteral(plugin->state, POINT_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 3);
-    API_ADD_SUB(plugin->state, transform, point)
-    API_ADD_SUB(plugin->state, get, point)
-    API_ADD_SUB(plugin->state, aspixels, point)
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+uint8_t _bolt_plugin_add(struct Plugin* plugin) {
+    // put this into our list of plugins (important to do this before lua_pcall)
+    struct Plugin* const* old_plugin = hashmap_set(plugins, &plugin);
+    if (hashmap_oom(plugins)) {
+        printf("plugin load error: out of memory\n");
+        return 0;
+    }
+    if (old_plugin) {
+        // a plugin with this id was already running and we just overwrote it, so make sure not to leak the memory.
+        // this shouldn't happen in practice because IDs are incremental, but what if someone overflows the ID to 0
+        // by starting 18 quintillion plugins in one session? okay, yes, it's very unlikely.
+        printf("plugin ID %llu has been overwritten by one with the same ID\n", (unsigned long long)plugin->id);
+        (*old_plugin)->is_deleted = true;
+    }
 
-    // create the metatable for all Transform objects
-    lua_pushliteral(plugin->state, TRANSFORM_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 2);
-    API_ADD_SUB(plugin->state, decompose, transform)
-    API_ADD_SUB(plugin->state, get, transform)
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+    // attempt to run the function
+    if (lua_pcall(plugin->state, 0, 0, 0)) {
+        _bolt_rwlock_lock_read(&windows.lock);
+        size_t iter = 0;
+        void* item;
+        while (hashmap_iter(windows.map, &iter, &item)) {
+            struct EmbeddedWindow* window = *(struct EmbeddedWindow**)item;
+            window->is_deleted = true;
+        }
+        _bolt_rwlock_unlock_read(&windows.lock);
 
-    // create the metatable for all Buffer objects
-    lua_pushliteral(plugin->state, BUFFER_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 3);
-    API_ADD_SUB(plugin->state, writeinteger, buffer)
-    API_ADD_SUB(plugin->state, writenumber, buffer)
-    API_ADD_SUB(plugin->state, writestring, buffer)
-    API_ADD_SUB(plugin->state, writebuffer, buffer)
-    lua_settable(plugin->state, -3);
-    lua_pushliteral(plugin->state, "__gc");
-    lua_pushcfunction(plugin->state, buffer_gc);
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+        const char* e = lua_tolstring(plugin->state, -1, 0);
+        printf("plugin startup error: %s\n", e);
+        lua_pop(plugin->state, 1);
+        plugin->is_deleted = true;
+        return 0;
+    } else {
+        return 1;
+    }
+}
 
-    // create the metatable for all SwapBuffers objects
-    lua_pushliteral(plugin->state, SWAPBUFFERS_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 0);
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+static void _bolt_loader_thread_main(void* userdata) {
+    _bolt_plugin_thread_lock(&loader_thread);
+    while (true) {
+        while (!loader_inbox_head && !loader_stopping) _bolt_plugin_thread_wait(&loader_thread);
+        if (loader_stopping) break;
+        struct PluginLoad* load = loader_inbox_head;
+        loader_inbox_head = load->next;
+        if (!loader_inbox_head) loader_inbox_tail = NULL;
+        load->next = NULL;
+        loader_current = load;
+        _bolt_plugin_thread_unlock(&loader_thread);
+
+        load->failed = !_bolt_plugin_prepare(load->path, load->plugin);
+
+        _bolt_plugin_thread_lock(&loader_thread);
+        loader_current = NULL;
+        if (loader_outbox_tail) loader_outbox_tail->next = load;
+        else loader_outbox_head = load;
+        loader_outbox_tail = load;
+    }
+    _bolt_plugin_thread_unlock(&loader_thread);
+}
 
-    // create the metatable for all Surface objects
-    lua_pushliteral(plugin->state, SURFACE_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 5);
-    API_ADD_SUB(plugin->state, clear, surface)
-    API_ADD_SUB(plugin->state, subimage, surface)
-    API_ADD_SUB(plugin->state, drawtoscreen, surface)
-    API_ADD_SUB(plugin->state, drawtosurface, surface)
-    API_ADD_SUB(plugin->state, drawtowindow, surface)
-    lua_settable(plugin->state, -3);
-    lua_pushliteral(plugin->state, "__gc");
-    lua_pushcfunction(plugin->state, surface_gc);
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+static void _bolt_free_plugin_loads(struct PluginLoad* load) {
+    while (load) {
+        struct PluginLoad* next = load->next;
+        _bolt_plugin_free(load->plugin);
+        free(load->path);
+        free(load);
+        load = next;
+    }
+}
 
-    // create the metatable for all Window objects
-    lua_pushliteral(plugin->state, WINDOW_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 12);
-    API_ADD_SUB(plugin->state, close, window)
-    API_ADD_SUB(plugin->state, id, window)
-    API_ADD_SUB(plugin->state, size, window)
-    API_ADD_SUB(plugin->state, clear, window)
-    API_ADD_SUB(plugin->state, subimage, window)
-    API_ADD_SUB(plugin->state, startreposition, window)
-    API_ADD_SUB(plugin->state, cancelreposition, window)
-    API_ADD_SUB(plugin->state, onreposition, window)
-    API_ADD_SUB(plugin->state, onmousemotion, window)
-    API_ADD_SUB(plugin->state, onmousebutton, window)
-    API_ADD_SUB(plugin->state, onmousebuttonup, window)
-    API_ADD_SUB(plugin->state, onscroll, window)
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+// marks a plugin that hasn't been started yet as deleted, so it gets freed instead of started. the
+// loader thread never touches is_deleted, so it's fine to set it even if the plugin is being prepared
+static void _bolt_plugin_cancel_load(uint64_t uid) {
+    if (loader_thread_running) _bolt_plugin_thread_lock(&loader_thread);
+    for (struct PluginLoad* load = loader_inbox_head; load; load = load->next) {
+        if (load->plugin->id == uid) load->plugin->is_deleted = true;
+    }
+    if (loader_current && loader_current->plugin->id == uid) loader_current->plugin->is_deleted = true;
+    for (struct PluginLoad* load = loader_outbox_head; load; load = load->next) {
+        if (load->plugin->id == uid) load->plugin->is_deleted = true;
+    }
+    if (loader_thread_running) _bolt_plugin_thread_unlock(&loader_thread);
+}
 
-    // create the metatable for all Browser objects
-    lua_pushliteral(plugin->state, BROWSER_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 8);
-    API_ADD_SUB(plugin->state, close, browser)
-    API_ADD_SUB(plugin->state, sendmessage, browser)
-    API_ADD_SUB(plugin->state, enablecapture, browser)
-    API_ADD_SUB(plugin->state, disablecapture, browser)
-    API_ADD_SUB(plugin->state, startreposition, window)
-    API_ADD_SUB(plugin->state, cancelreposition, window)
-    API_ADD_SUB(plugin->state, oncloserequest, browser)
-    API_ADD_SUB(plugin->state, onmessage, browser)
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+// starts any plugins that the loader thread has finished preparing, in the order they were requested
+static void _bolt_process_plugin_loads() {
+    if (loader_thread_running) _bolt_plugin_thread_lock(&loader_thread);
+    struct PluginLoad* load = loader_outbox_head;
+    loader_outbox_head = NULL;
+    loader_outbox_tail = NULL;
+    if (loader_thread_running) _bolt_plugin_thread_unlock(&loader_thread);
 
-    // create the metatable for all EmbeddedBrowser objects
-    lua_pushliteral(plugin->state, EMBEDDEDBROWSER_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 4);
-    API_ADD_SUB(plugin->state, close, embeddedbrowser)
-    API_ADD_SUB(plugin->state, sendmessage, embeddedbrowser)
-    API_ADD_SUB(plugin->state, enablecapture, embeddedbrowser)
-    API_ADD_SUB(plugin->state, disablecapture, embeddedbrowser)
-    API_ADD_SUB(plugin->state, oncloserequest, browser)
-    API_ADD_SUB(plugin->state, onmessage, browser)
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+    while (load) {
+        struct PluginLoad* next = load->next;
+        struct Plugin* plugin = load->plugin;
+        if (plugin->is_deleted) {
+            // the host stopped it before it got a chance to start
+            _bolt_plugin_free(plugin);
+        } else if (load->failed) {
+            _bolt_plugin_notify_stopped(plugin->id);
+            _bolt_plugin_free(plugin);
+        } else if (!_bolt_plugin_add(plugin)) {
+            _bolt_plugin_notify_stopped(plugin->id);
+            plugin->is_deleted = true;
+        }
+        free(load->path);
+        free(load);
+        load = next;
+    }
+}
 
-    // create the metatable for all RepositionEvent objects
-    lua_pushliteral(plugin->state, REPOSITION_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 2);
-    API_ADD_SUB(plugin->state, xywh, repositionevent)
-    API_ADD_SUB(plugin->state, didresize, repositionevent)
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+// does one file job, on whichever thread is running them
+static void _bolt_do_file_job(struct FileJob* job) {
+    job->ok = false;
+    if (job->type == FILE_JOB_WRITE) {
+        // written to a temporary file and then moved into place, so that the game crashing part-way
+        // through can't leave the plugin with a half-written file
+        const size_t path_length = strlen(job->path);
+        char* temp_path = malloc(path_length + 5);
+        memcpy(temp_path, job->path, path_length);
+        memcpy(temp_path + path_length, ".tmp", 5);
+        FILE* f = fopen(temp_path, "wb");
+        if (f) {
+            const uint8_t written = fwrite(job->data, 1, job->size, f) == job->size;
+            const uint8_t closed = !fclose(f);
+            if (written && closed) job->ok = _bolt_plugin_file_replace(temp_path, job->path);
+            else remove(temp_path);
+        }
+        free(temp_path);
+        free(job->data);
+        job->data = NULL;
+        return;
+    }
 
-    // create the metatable for all MouseMotionEvent objects
-    lua_pushliteral(plugin->state, MOUSEMOTION_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 8);
-    API_ADD_SUB(plugin->state, xy, mouseevent)
-    API_ADD_SUB(plugin->state, ctrl, mouseevent);
-    API_ADD_SUB(plugin->state, shift, mouseevent);
-    API_ADD_SUB(plugin->state, meta, mouseevent);
-    API_ADD_SUB(plugin->state, alt, mouseevent);
-    API_ADD_SUB(plugin->state, capslock, mouseevent);
-    API_ADD_SUB(plugin->state, numlock, mouseevent);
-    API_ADD_SUB(plugin->state, mousebuttons, mouseevent);
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+    FILE* f = fopen(job->path, "rb");
+    if (!f) return;
+    fseek(f, 0, SEEK_END);
+    const long file_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (job->type == FILE_JOB_READ_MAPPABLE && file_size >= FILE_MAP_THRESHOLD) {
+        fclose(f);
+        job->data = _bolt_plugin_file_map(job->path, &job->size);
+        job->is_mapped = job->data != NULL;
+        job->ok = job->is_mapped;
+        return;
+    }
+    job->data = file_size >= 0 ? malloc(file_size ? file_size : 1) : NULL;
+    if (job->data && fread(job->data, 1, file_size, f) == (size_t)file_size) {
+        job->size = file_size;
+        job->ok = true;
+    } else {
+        free(job->data);
+        job->data = NULL;
+    }
+    fclose(f);
+}
+
+static void _bolt_io_thread_main(void* userdata) {
+    _bolt_plugin_thread_lock(&io_thread);
+    while (true) {
+        while (!io_inbox_head && !io_stopping) _bolt_plugin_thread_wait(&io_thread);
+        struct FileJob* job = io_inbox_head;
+        if (!job) break;
+        io_inbox_head = job->next;
+        if (!io_inbox_head) io_inbox_tail = NULL;
+        job->next = NULL;
+        const uint8_t skip = io_stopping && job->type != FILE_JOB_WRITE;
+        _bolt_plugin_thread_unlock(&io_thread);
+
+        if (!skip) _bolt_do_file_job(job);
+
+        _bolt_plugin_thread_lock(&io_thread);
+        if (io_outbox_tail) io_outbox_tail->next = job;
+        else io_outbox_head = job;
+        io_outbox_tail = job;
+    }
+    _bolt_plugin_thread_unlock(&io_thread);
+}
+
+// hands a file job to the I/O thread, or does it right away if there isn't one. a write to a file
+// that's already waiting to be written just replaces the data of the queued write, so a plugin that
+// saves the same file over and over only gets it written as often as the disk can keep up. that's
+// not done if there's a read of the file queued after the write, so reads always see what was saved
+// before them and nothing newer.
+static void _bolt_queue_file_job(struct FileJob* job) {
+    if (!io_thread_running) {
+        _bolt_do_file_job(job);
+        if (io_outbox_tail) io_outbox_tail->next = job;
+        else io_outbox_head = job;
+        io_outbox_tail = job;
+        return;
+    }
+    _bolt_plugin_thread_lock(&io_thread);
+    if (job->type == FILE_JOB_WRITE) {
+        struct FileJob* target = NULL;
+        for (struct FileJob* queued = io_inbox_head; queued; queued = queued->next) {
+            if (!strcmp(queued->path, job->path)) target = (queued->type == FILE_JOB_WRITE) ? queued : NULL;
+        }
+        if (target) {
+            free(target->data);
+            target->data = job->data;
+            target->size = job->size;
+            job->data = NULL;
+            struct FileJob** tail = &target->coalesced;
+            while (*tail) tail = &(*tail)->coalesced;
+            *tail = job;
+            _bolt_plugin_thread_unlock(&io_thread);
+            return;
+        }
+    }
+    if (io_inbox_tail) io_inbox_tail->next = job;
+    else io_inbox_head = job;
+    io_inbox_tail = job;
+    _bolt_plugin_thread_notify(&io_thread);
+    _bolt_plugin_thread_unlock(&io_thread);
+}
+
+static void _bolt_free_file_job(struct FileJob* job) {
+    if (job->data) {
+        if (job->is_mapped) _bolt_plugin_file_unmap(job->data, job->size);
+        else free(job->data);
+    }
+    free(job->path);
+    free(job);
+}
+
+static void _bolt_free_file_jobs(struct FileJob* job) {
+    while (job) {
+        struct FileJob* next = job->next;
+        struct FileJob* coalesced = job->coalesced;
+        while (coalesced) {
+            struct FileJob* next_coalesced = coalesced->coalesced;
+            _bolt_free_file_job(coalesced);
+            coalesced = next_coalesced;
+        }
+        _bolt_free_file_job(job);
+        job = next;
+    }
+}
+
+// stores the function at stack index `n` in the plugin's FILECALLBACKS_REGISTRYNAME table and returns
+// its key, or returns 0 if there's no function there
+static uint64_t _bolt_store_file_callback(lua_State* state, int n) {
+    if (!lua_isfunction(state, n)) return 0;
+    const uint64_t id = next_file_callback_id;
+    next_file_callback_id += 1;
+    lua_getfield(state, LUA_REGISTRYINDEX, FILECALLBACKS_REGISTRYNAME); /*stack: callback table*/
+    lua_pushinteger(state, id);
+    lua_pushvalue(state, n);
+    lua_settable(state, -3);
+    lua_pop(state, 1); /*stack: (empty)*/
+    return id;
+}
+
+// pushes a callback stored by _bolt_store_file_callback and removes it from the table, since each
+// one only gets called once
+static void _bolt_push_file_callback(lua_State* state, uint64_t id) {
+    lua_getfield(state, LUA_REGISTRYINDEX, FILECALLBACKS_REGISTRYNAME); /*stack: callback table*/
+    lua_pushinteger(state, id); /*stack: callback table, id*/
+    lua_gettable(state, -2); /*stack: callback table, function*/
+    lua_pushinteger(state, id);
+    lua_pushnil(state);
+    lua_settable(state, -4);
+    lua_remove(state, -2); /*stack: function*/
+}
+
+// calls the callback for a finished file job, if it has one and its plugin is still running, then
+// frees it. `ok` is passed separately since a coalesced write gets the result of the one it joined
+static void _bolt_finish_file_job(struct FileJob* job, uint8_t ok) {
+    struct Plugin p = {.id = job->plugin_id};
+    struct Plugin* pp = &p;
+    struct Plugin* const* plugin = job->callback_id ? hashmap_get(plugins, &pp) : NULL;
+    if (plugin && !(*plugin)->is_deleted) {
+        lua_State* state = (*plugin)->state;
+        _bolt_push_file_callback(state, job->callback_id); /*stack: function*/
+        if (job->type == FILE_JOB_WRITE) {
+            lua_pushboolean(state, ok);
+        } else if (ok) {
+            struct FixedBuffer* buffer = push_buffer(state, job->data, job->size);
+            if (job->is_mapped) buffer->storage = BUFFER_STORAGE_MAPPED;
+            job->data = NULL; // belongs to the Buffer now
+        } else {
+            lua_pushnil(state);
+        } /*stack: function, result*/
+        if (lua_pcall(state, 1, 0, 0)) { /*stack: error*/
+            const char* e = lua_tolstring(state, -1, 0);
+            printf("plugin file callback error: %s\n", e);
+            lua_pop(state, 1); /*stack: (empty)*/
+            _bolt_plugin_stop(job->plugin_id);
+            _bolt_plugin_notify_stopped(job->plugin_id);
+        }
+    }
+    _bolt_free_file_job(job);
+}
+
+// calls the callbacks for every file job the I/O thread has finished since last time
+static void _bolt_process_file_jobs() {
+    if (io_thread_running) _bolt_plugin_thread_lock(&io_thread);
+    struct FileJob* job = io_outbox_head;
+    io_outbox_head = NULL;
+    io_outbox_tail = NULL;
+    if (io_thread_running) _bolt_plugin_thread_unlock(&io_thread);
+
+    while (job) {
+        struct FileJob* next = job->next;
+        struct FileJob* coalesced = job->coalesced;
+        const uint8_t ok = job->ok;
+        _bolt_finish_file_job(job, ok);
+        while (coalesced) {
+            struct FileJob* next_coalesced = coalesced->coalesced;
+            _bolt_finish_file_job(coalesced, ok);
+            coalesced = next_coalesced;
+        }
+        job = next;
+    }
+}
+
+// reads and decodes a PNG file to RGBA8, returning it malloc'd, or returning NULL with a description
+// of what went wrong written to `error`. safe to call from any thread
+static uint8_t* _bolt_decode_png(const char* path, uint32_t* width, uint32_t* height, char* error, size_t error_size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        snprintf(error, error_size, "error opening file '%s'", path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    const long png_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void* png = png_size > 0 ? malloc(png_size) : NULL;
+    if (!png || fread(png, 1, png_size, f) < (size_t)png_size) {
+        free(png);
+        fclose(f);
+        snprintf(error, error_size, "error reading file '%s'", path);
+        return NULL;
+    }
+    fclose(f);
 
-    // create the metatable for all MouseButtonEvent objects
-    lua_pushliteral(plugin->state, MOUSEBUTTON_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 9);
-    API_ADD_SUB(plugin->state, xy, mouseevent)
-    API_ADD_SUB(plugin->state, ctrl, mouseevent);
-    API_ADD_SUB(plugin->state, shift, mouseevent);
-    API_ADD_SUB(plugin->state, meta, mouseevent);
-    API_ADD_SUB(plugin->state, alt, mouseevent);
-    API_ADD_SUB(plugin->state, capslock, mouseevent);
-    API_ADD_SUB(plugin->state, numlock, mouseevent);
-    API_ADD_SUB(plugin->state, mousebuttons, mouseevent);
-    API_ADD_SUB(plugin->state, button, mousebutton);
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+#define CALL_SPNG(FUNC, ...) err = FUNC(__VA_ARGS__); if(err){snprintf(error,error_size,"error decoding file '%s': " #FUNC " returned %i",path,err);goto fail;}
+    uint8_t* rgba = NULL;
+    size_t rgba_size;
+    int err;
+    struct spng_ihdr ihdr;
+    spng_ctx* spng = spng_ctx_new(0);
+    CALL_SPNG(spng_set_png_buffer, spng, png, png_size)
+    CALL_SPNG(spng_get_ihdr, spng, &ihdr)
+    CALL_SPNG(spng_decoded_image_size, spng, SPNG_FMT_RGBA8, &rgba_size)
+    rgba = malloc(rgba_size);
+    CALL_SPNG(spng_decode_image, spng, rgba, rgba_size, SPNG_FMT_RGBA8, 0)
+#undef CALL_SPNG
+    spng_ctx_free(spng);
+    free(png);
+    *width = ihdr.width;
+    *height = ihdr.height;
+    return rgba;
 
-    // create the metatable for all MouseScrollEvent objects
-    lua_pushliteral(plugin->state, SCROLL_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 9);
-    API_ADD_SUB(plugin->state, xy, mouseevent)
-    API_ADD_SUB(plugin->state, ctrl, mouseevent);
-    API_ADD_SUB(plugin->state, shift, mouseevent);
-    API_ADD_SUB(plugin->state, meta, mouseevent);
-    API_ADD_SUB(plugin->state, alt, mouseevent);
-    API_ADD_SUB(plugin->state, capslock, mouseevent);
-    API_ADD_SUB(plugin->state, numlock, mouseevent);
-    API_ADD_SUB(plugin->state, mousebuttons, mouseevent);
-    API_ADD_SUB(plugin->state, direction, scroll);
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+fail:
+    spng_ctx_free(spng);
+    free(png);
+    free(rgba);
+    return NULL;
+}
+
+static int _bolt_image_map_compare(const void* a, const void* b, void* udata) {
+    return strcmp((*(const struct DecodedImage* const*)a)->path, (*(const struct DecodedImage* const*)b)->path);
+}
+
+static uint64_t _bolt_image_map_hash(const void* item, uint64_t seed0, uint64_t seed1) {
+    const char* path = (*(const struct DecodedImage* const*)item)->path;
+    return hashmap_sip(path, strlen(path), seed0, seed1);
+}
+
+// makes a DecodedImage with one reference, taking ownership of `path` and `rgba`
+static struct DecodedImage* _bolt_new_decoded_image(char* path, int64_t mtime, uint8_t* rgba, uint32_t width, uint32_t height) {
+    struct DecodedImage* image = malloc(sizeof(struct DecodedImage));
+    image->path = path;
+    image->mtime = mtime;
+    image->rgba = rgba;
+    image->width = width;
+    image->height = height;
+    image->refcount = 1;
+    image->is_cached = false;
+    image->lru_prev = NULL;
+    image->lru_next = NULL;
+    return image;
+}
+
+static void _bolt_image_unref(struct DecodedImage* image) {
+    image->refcount -= 1;
+    if (image->refcount) return;
+    free(image->path);
+    free(image->rgba);
+    free(image);
+}
+
+static size_t _bolt_image_size(const struct DecodedImage* image) {
+    return (size_t)image->width * image->height * 4;
+}
+
+static void _bolt_image_cache_remove(struct DecodedImage* image) {
+    hashmap_delete(image_cache, &image);
+    if (image->lru_prev) image->lru_prev->lru_next = image->lru_next;
+    else image_cache_lru_head = image->lru_next;
+    if (image->lru_next) image->lru_next->lru_prev = image->lru_prev;
+    else image_cache_lru_tail = image->lru_prev;
+    image_cache_size -= _bolt_image_size(image);
+    image->is_cached = false;
+    _bolt_image_unref(image);
+}
+
+static void _bolt_image_cache_touch(struct DecodedImage* image) {
+    if (!image->lru_prev) return;
+    image->lru_prev->lru_next = image->lru_next;
+    if (image->lru_next) image->lru_next->lru_prev = image->lru_prev;
+    else image_cache_lru_tail = image->lru_prev;
+    image->lru_prev = NULL;
+    image->lru_next = image_cache_lru_head;
+    image_cache_lru_head->lru_prev = image;
+    image_cache_lru_head = image;
+}
+
+// looks up a decoded image in the cache, without adding a reference to it. a cached copy of an older
+// version of the file gets dropped, and NULL is returned as if there wasn't one.
+static struct DecodedImage* _bolt_image_cache_get(const char* path, int64_t mtime) {
+    struct DecodedImage key = {.path = (char*)path};
+    struct DecodedImage* key_ptr = &key;
+    struct DecodedImage* const* found = hashmap_get(image_cache, &key_ptr);
+    if (!found) return NULL;
+    struct DecodedImage* image = *found;
+    if (image->mtime != mtime) {
+        _bolt_image_cache_remove(image);
+        return NULL;
+    }
+    _bolt_image_cache_touch(image);
+    return image;
+}
+
+// adds an image to the cache, replacing any other image with the same path, then drops the least
+// recently used images until the cache fits in IMAGE_CACHE_MAX_SIZE. images too big to fit at all
+// are left out
+static void _bolt_image_cache_put(struct DecodedImage* image) {
+    const size_t size = _bolt_image_size(image);
+    if (size > IMAGE_CACHE_MAX_SIZE) return;
+    struct DecodedImage* const* found = hashmap_get(image_cache, &image);
+    if (found) _bolt_image_cache_remove(*found);
+    hashmap_set(image_cache, &image);
+    image->refcount += 1;
+    image->is_cached = true;
+    image->lru_prev = NULL;
+    image->lru_next = image_cache_lru_head;
+    if (image_cache_lru_head) image_cache_lru_head->lru_prev = image;
+    else image_cache_lru_tail = image;
+    image_cache_lru_head = image;
+    image_cache_size += size;
+    while (image_cache_size > IMAGE_CACHE_MAX_SIZE) _bolt_image_cache_remove(image_cache_lru_tail);
+}
+
+static void _bolt_png_decoder_main(void* userdata) {
+    struct PngDecoder* decoder = userdata;
+    _bolt_plugin_thread_lock(&decoder->thread);
+    while (true) {
+        while (!decoder->inbox_head && !decoder->stopping) _bolt_plugin_thread_wait(&decoder->thread);
+        if (decoder->stopping) break;
+        struct PngJob* job = decoder->inbox_head;
+        decoder->inbox_head = job->next;
+        if (!decoder->inbox_head) decoder->inbox_tail = NULL;
+        job->next = NULL;
+        _bolt_plugin_thread_unlock(&decoder->thread);
+
+        BOLT_FRAMETRACE_BEGIN(scope_start);
+        job->rgba = _bolt_decode_png(job->path, &job->width, &job->height, job->error, sizeof(job->error));
+        BOLT_FRAMETRACE_END(scope_start, "plugin:decodepng");
+
+        _bolt_plugin_thread_lock(&decoder->thread);
+        if (decoder->outbox_tail) decoder->outbox_tail->next = job;
+        else decoder->outbox_head = job;
+        decoder->outbox_tail = job;
+    }
+    _bolt_plugin_thread_unlock(&decoder->thread);
+}
+
+static void _bolt_png_ready(struct PngJob* job) {
+    if (png_ready_tail) png_ready_tail->next = job;
+    else png_ready_head = job;
+    png_ready_tail = job;
+}
+
+// starts a PNG job on the render thread. if the image is in the cache, or another job is already
+// decoding the same file, no decoding is done for this one. otherwise it goes to one of the decoder
+// threads, taking turns, or gets decoded right away if none of them are running
+static void _bolt_queue_png_job(struct PngJob* job) {
+    if (job->has_mtime) {
+        struct DecodedImage* image = _bolt_image_cache_get(job->path, job->mtime);
+        if (image) {
+            image->refcount += 1;
+            job->image = image;
+            _bolt_png_ready(job);
+            return;
+        }
+        for (struct PngJob* pending = png_pending; pending; pending = pending->pending_next) {
+            if (pending->has_mtime && pending->mtime == job->mtime && !strcmp(pending->path, job->path)) {
+                job->coalesced = pending->coalesced;
+                pending->coalesced = job;
+                return;
+            }
+        }
+    }
+    job->pending_next = png_pending;
+    png_pending = job;
+
+    for (size_t i = 0; i < PNG_DECODER_COUNT; i += 1) {
+        struct PngDecoder* decoder = &png_decoders[(next_png_decoder + i) % PNG_DECODER_COUNT];
+        if (!decoder->running) continue;
+        next_png_decoder = (next_png_decoder + i + 1) % PNG_DECODER_COUNT;
+        _bolt_plugin_thread_lock(&decoder->thread);
+        if (decoder->inbox_tail) decoder->inbox_tail->next = job;
+        else decoder->inbox_head = job;
+        decoder->inbox_tail = job;
+        _bolt_plugin_thread_notify(&decoder->thread);
+        _bolt_plugin_thread_unlock(&decoder->thread);
+        return;
+    }
+    BOLT_FRAMETRACE_BEGIN(scope_start);
+    job->rgba = _bolt_decode_png(job->path, &job->width, &job->height, job->error, sizeof(job->error));
+    BOLT_FRAMETRACE_END(scope_start, "plugin:decodepng");
+    _bolt_png_ready(job);
+}
+
+static void _bolt_free_png_job(struct PngJob* job) {
+    if (job->image) _bolt_image_unref(job->image);
+    free(job->rgba);
+    free(job->path);
+    free(job);
+}
+
+static void _bolt_free_png_jobs(struct PngJob* job) {
+    while (job) {
+        struct PngJob* next = job->next;
+        struct PngJob* coalesced = job->coalesced;
+        while (coalesced) {
+            struct PngJob* next_coalesced = coalesced->coalesced;
+            _bolt_free_png_job(coalesced);
+            coalesced = next_coalesced;
+        }
+        _bolt_free_png_job(job);
+        job = next;
+    }
+}
 
-    // create the metatable for all MouseLeaveEvent objects
-    lua_pushliteral(plugin->state, MOUSEMOTION_META_REGISTRYNAME);
-    lua_newtable(plugin->state);
-    lua_pushliteral(plugin->state, "__index");
-    lua_createtable(plugin->state, 0, 8);
-    API_ADD_SUB(plugin->state, xy, mouseevent)
-    API_ADD_SUB(plugin->state, ctrl, mouseevent);
-    API_ADD_SUB(plugin->state, shift, mouseevent);
-    API_ADD_SUB(plugin->state, meta, mouseevent);
-    API_ADD_SUB(plugin->state, alt, mouseevent);
-    API_ADD_SUB(plugin->state, capslock, mouseevent);
-    API_ADD_SUB(plugin->state, numlock, mouseevent);
-    API_ADD_SUB(plugin->state, mousebuttons, mouseevent);
-    lua_settable(plugin->state, -3);
-    lua_settable(plugin->state, LUA_REGISTRYINDEX);
+// pushes a new surface with the given contents, with the surface metatable
+static void _bolt_push_surface(lua_State* state, uint32_t width, uint32_t height, const void* rgba) {
+    struct SurfaceFunctions* functions = lua_newuserdata(state, sizeof(struct SurfaceFunctions));
+    managed_functions.surface_init(functions, width, height, rgba);
+    lua_getfield(state, LUA_REGISTRYINDEX, SURFACE_META_REGISTRYNAME);
+    lua_setmetatable(state, -2);
+}
 
-    // attempt to run the function
-    if (lua_pcall(plugin->state, 0, 0, 0)) {
-        _bolt_rwlock_lock_read(&windows.lock);
-        size_t iter = 0;
-        void* item;
-        while (hashmap_iter(windows.map, &iter, &item)) {
-            struct EmbeddedWindow* window = *(struct EmbeddedWindow**)item;
-            window->is_deleted = true;
+// calls the callback of a PNG job with the image it loaded, or with `error` if there isn't one
+static void _bolt_finish_png_job(struct PngJob* job, struct DecodedImage* image, const char* error) {
+    struct Plugin p = {.id = job->plugin_id};
+    struct Plugin* pp = &p;
+    struct Plugin* const* plugin = job->callback_id ? hashmap_get(plugins, &pp) : NULL;
+    if (plugin && !(*plugin)->is_deleted) {
+        lua_State* state = (*plugin)->state;
+        int nargs;
+        _bolt_push_file_callback(state, job->callback_id); /*stack: function*/
+        if (image) {
+            lua_pushinteger(state, image->width);
+            lua_pushinteger(state, image->height);
+            _bolt_push_surface(state, image->width, image->height, image->rgba);
+            nargs = 3; /*stack: function, width, height, surface*/
+        } else {
+            lua_pushnil(state);
+            lua_pushfstring(state, "createsurfacefrompngasync: %s", error);
+            nargs = 2; /*stack: function, nil, error*/
         }
-        _bolt_rwlock_unlock_read(&windows.lock);
+        if (lua_pcall(state, nargs, 0, 0)) { /*stack: error*/
+            const char* e = lua_tolstring(state, -1, 0);
+            printf("plugin png callback error: %s\n", e);
+            lua_pop(state, 1); /*stack: (empty)*/
+            _bolt_plugin_stop(job->plugin_id);
+            _bolt_plugin_notify_stopped(job->plugin_id);
+        }
+    }
+}
 
-        const char* e = lua_tolstring(plugin->state, -1, 0);
-        printf("plugin startup error: %s\n", e);
-        lua_pop(plugin->state, 1);
-        plugin->is_deleted = true;
-        return 0;
-    } else {
-        return 1;
+// turns a job's decoded RGBA data into a DecodedImage, caches it, and calls back every plugin that
+// was waiting for it. the job holds a reference to the image throughout, so it can't be freed by a
+// callback loading enough other images to push it out of the cache
+static void _bolt_complete_png_job(struct PngJob* job) {
+    for (struct PngJob** pending = &png_pending; *pending; pending = &(*pending)->pending_next) {
+        if (*pending == job) {
+            *pending = job->pending_next;
+            break;
+        }
+    }
+    if (!job->image && job->rgba) {
+        job->image = _bolt_new_decoded_image(job->path, job->mtime, job->rgba, job->width, job->height);
+        job->path = NULL;
+        job->rgba = NULL;
+        if (job->has_mtime) _bolt_image_cache_put(job->image);
+    }
+    _bolt_finish_png_job(job, job->image, job->error);
+    struct PngJob* coalesced = job->coalesced;
+    while (coalesced) {
+        struct PngJob* next = coalesced->coalesced;
+        _bolt_finish_png_job(coalesced, job->image, job->error);
+        _bolt_free_png_job(coalesced);
+        coalesced = next;
+    }
+    _bolt_free_png_job(job);
+}
+
+// calls back every PNG job that's finished since last time
+static void _bolt_process_png_jobs() {
+    struct PngJob* job = png_ready_head;
+    png_ready_head = NULL;
+    png_ready_tail = NULL;
+    while (job) {
+        struct PngJob* next = job->next;
+        _bolt_complete_png_job(job);
+        job = next;
+    }
+    for (size_t i = 0; i < PNG_DECODER_COUNT; i += 1) {
+        struct PngDecoder* decoder = &png_decoders[i];
+        if (!decoder->running) continue;
+        _bolt_plugin_thread_lock(&decoder->thread);
+        job = decoder->outbox_head;
+        decoder->outbox_head = NULL;
+        decoder->outbox_tail = NULL;
+        _bolt_plugin_thread_unlock(&decoder->thread);
+        while (job) {
+            struct PngJob* next = job->next;
+            _bolt_complete_png_job(job);
+            job = next;
+        }
     }
 }
 
@@ -1618,7 +4622,8 @@ static void _bolt_plugin_stop(uint64_t uid) {
     struct Plugin p = {.id = uid};
     struct Plugin* pp = &p;
     struct Plugin* const* plugin = hashmap_get(plugins, &pp);
-    (*plugin)->is_deleted = true;
+    if (plugin) (*plugin)->is_deleted = true;
+    else _bolt_plugin_cancel_load(uid);
 }
 
 void _bolt_plugin_ipc_init(BoltSocketType* fd) {
@@ -1660,10 +4665,10 @@ void get_binary_data(lua_State* state, int n, const void** data, size_t* size) {
     }
 }
 
-DEFINE_CALLBACK_STATIC(swapbuffers, SWAPBUFFERS, SwapBuffersEvent)
-DEFINE_CALLBACK(render2d, BATCH2D, RenderBatch2D)
-DEFINE_CALLBACK(render3d, RENDER3D, Render3D)
-DEFINE_CALLBACK(minimap, MINIMAP, RenderMinimapEvent)
+DEFINE_FRAME_CALLBACK_STATIC(swapbuffers, SWAPBUFFERS, SwapBuffersEvent)
+DEFINE_FRAME_CALLBACK(render2d, BATCH2D, RenderBatch2D)
+DEFINE_FRAME_CALLBACK(render3d, RENDER3D, Render3D)
+DEFINE_FRAME_CALLBACK(minimap, MINIMAP, RenderMinimapEvent)
 DEFINE_CALLBACK(mousemotion, MOUSEMOTION, MouseMotionEvent)
 DEFINE_CALLBACK(mousebutton, MOUSEBUTTON, MouseButtonEvent)
 DEFINE_CALLBACK(mousebuttonup, MOUSEBUTTONUP, MouseButtonEvent)
@@ -1837,6 +4842,79 @@ static int api_saveconfig(lua_State* state) {
     return 1;
 }
 
+// makes the full path of a file in `root` the same way loadfile and loadconfig do, but malloc'd
+static char* _bolt_plugin_file_path(const char* root, size_t root_length, const char* path, size_t path_length) {
+    char* full_path = malloc(root_length + path_length + 1);
+    memcpy(full_path, root, root_length);
+    memcpy(full_path + root_length, path, path_length + 1);
+    for (char* c = full_path + root_length; *c; c += 1) {
+        if (*c == '\\') *c = '/';
+    }
+    return full_path;
+}
+
+// creates a file job, storing the function at stack index `n` as its callback if there is one
+static struct FileJob* _bolt_new_file_job(lua_State* state, const struct Plugin* plugin, char* path, uint8_t type, int n) {
+    struct FileJob* job = malloc(sizeof(struct FileJob));
+    job->next = NULL;
+    job->coalesced = NULL;
+    job->plugin_id = plugin->id;
+    job->callback_id = _bolt_store_file_callback(state, n);
+    job->path = path;
+    job->data = NULL;
+    job->size = 0;
+    job->type = type;
+    job->is_mapped = false;
+    job->ok = false;
+    return job;
+}
+
+static int api_loadfileasync(lua_State* state) {
+    size_t path_length;
+    const char* path = luaL_checklstring(state, 1, &path_length);
+    luaL_checktype(state, 2, LUA_TFUNCTION);
+    lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME);
+    const struct Plugin* plugin = lua_touserdata(state, -1);
+    lua_pop(state, 1);
+    char* full_path = _bolt_plugin_file_path(plugin->path, plugin->path_length, path, path_length);
+    _bolt_queue_file_job(_bolt_new_file_job(state, plugin, full_path, FILE_JOB_READ_MAPPABLE, 2));
+    return 0;
+}
+
+static int api_loadconfigasync(lua_State* state) {
+    size_t path_length;
+    const char* path = luaL_checklstring(state, 1, &path_length);
+    luaL_checktype(state, 2, LUA_TFUNCTION);
+    lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME);
+    const struct Plugin* plugin = lua_touserdata(state, -1);
+    lua_pop(state, 1);
+    char* full_path = _bolt_plugin_file_path(plugin->config_path, plugin->config_path_length, path, path_length);
+    _bolt_queue_file_job(_bolt_new_file_job(state, plugin, full_path, FILE_JOB_READ, 2));
+    return 0;
+}
+
+static int api_saveconfigasync(lua_State* state) {
+    size_t path_length, content_length;
+    const void* content;
+    const char* path = luaL_checklstring(state, 1, &path_length);
+    get_binary_data(state, 2, &content, &content_length);
+    lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME);
+    const struct Plugin* plugin = lua_touserdata(state, -1);
+    lua_pop(state, 1);
+    void* data = malloc(content_length ? content_length : 1);
+    if (!data) {
+        lua_pushfstring(state, "saveconfigasync: heap error, failed to allocate %d bytes", (int)content_length);
+        lua_error(state);
+    }
+    memcpy(data, content, content_length);
+    char* full_path = _bolt_plugin_file_path(plugin->config_path, plugin->config_path_length, path, path_length);
+    struct FileJob* job = _bolt_new_file_job(state, plugin, full_path, FILE_JOB_WRITE, 3);
+    job->data = data;
+    job->size = content_length;
+    _bolt_queue_file_job(job);
+    return 0;
+}
+
 static int api_createsurface(lua_State* state) {
     const lua_Integer w = luaL_checkinteger(state, 1);
     const lua_Integer h = luaL_checkinteger(state, 2);
@@ -1869,60 +4947,77 @@ static int api_createsurfacefromrgba(lua_State* state) {
     return 1;
 }
 
-static int api_createsurfacefrompng(lua_State* state) {
+// makes the full path of a PNG for createsurfacefrompng, which works the same way as require()
+static char* _bolt_png_path(const struct Plugin* plugin, const char* path, size_t path_length) {
     const char extension[] = ".png";
-    size_t rgba_size, path_length;
-    const char* path = luaL_checklstring(state, 1, &path_length);
-    lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME);
-    const struct Plugin* plugin = lua_touserdata(state, -1);
-    const size_t full_path_length = plugin->path_length + path_length + sizeof(extension);
-    char* full_path = lua_newuserdata(state, full_path_length);
+    char* full_path = malloc(plugin->path_length + path_length + sizeof(extension));
     memcpy(full_path, plugin->path, plugin->path_length);
     memcpy(full_path + plugin->path_length, path, path_length + 1);
     for (char* c = full_path + plugin->path_length; *c; c += 1) {
         if (*c == '.') *c = '/';
     }
     memcpy(full_path + plugin->path_length + path_length, extension, sizeof(extension));
-    FILE* f = fopen(full_path, "rb");
-    if (!f) {
-        lua_pushfstring(state, "createsurfacefrompng: error opening file '%s'", (char*)full_path);
-        lua_error(state);
-    }
-    fseek(f, 0, SEEK_END);
-    const long png_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    void* png = lua_newuserdata(state, png_size);
-    if (fread(png, 1, png_size, f) < png_size) {
-        fclose(f);
-        lua_pushfstring(state, "createsurfacefrompng: error reading file '%s'", (char*)full_path);
-        lua_error(state);
-    }
-    fclose(f);
+    return full_path;
+}
 
-#define CALL_SPNG(FUNC, ...) err = FUNC(__VA_ARGS__); if(err){free(rgba);lua_pushfstring(state,"createsurfacefrompng: error decoding file '%s': " #FUNC " returned %i",(char*)full_path,err);lua_error(state);}
-    void* rgba = NULL;
-    int err;
-    spng_ctx* spng = spng_ctx_new(0);
-    CALL_SPNG(spng_set_png_buffer, spng, png, png_size);
-    struct spng_ihdr ihdr;
-    CALL_SPNG(spng_get_ihdr, spng, &ihdr)
-    CALL_SPNG(spng_decoded_image_size, spng, SPNG_FMT_RGBA8, &rgba_size)
-    rgba = malloc(rgba_size);
-    CALL_SPNG(spng_decode_image, spng, rgba, rgba_size, SPNG_FMT_RGBA8, 0)
-    spng_ctx_free(spng);
-    lua_pop(state, 3);
-#undef CALL_SPNG
+static int api_createsurfacefrompng(lua_State* state) {
+    size_t path_length;
+    const char* path = luaL_checklstring(state, 1, &path_length);
+    lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME);
+    const struct Plugin* plugin = lua_touserdata(state, -1);
+    lua_pop(state, 1);
+    char* full_path = _bolt_png_path(plugin, path, path_length);
+    int64_t mtime = 0;
+    const uint8_t has_mtime = _bolt_plugin_file_mtime(full_path, &mtime);
+    struct DecodedImage* image = has_mtime ? _bolt_image_cache_get(full_path, mtime) : NULL;
+    if (image) {
+        image->refcount += 1;
+        free(full_path);
+    } else {
+        char error[256];
+        uint32_t width, height;
+        uint8_t* rgba = _bolt_decode_png(full_path, &width, &height, error, sizeof(error));
+        if (!rgba) {
+            free(full_path);
+            lua_pushfstring(state, "createsurfacefrompng: %s", error);
+            lua_error(state);
+        }
+        image = _bolt_new_decoded_image(full_path, mtime, rgba, width, height);
+        if (has_mtime) _bolt_image_cache_put(image);
+    }
 
-    lua_pushinteger(state, ihdr.width);
-    lua_pushinteger(state, ihdr.height);
-    struct SurfaceFunctions* functions = lua_newuserdata(state, sizeof(struct SurfaceFunctions));
-    managed_functions.surface_init(functions, ihdr.width, ihdr.height, rgba);
-    lua_getfield(state, LUA_REGISTRYINDEX, SURFACE_META_REGISTRYNAME);
-    lua_setmetatable(state, -2);
-    free(rgba);
+    lua_pushinteger(state, image->width);
+    lua_pushinteger(state, image->height);
+    _bolt_push_surface(state, image->width, image->height, image->rgba);
+    _bolt_image_unref(image);
     return 3;
 }
 
+static int api_createsurfacefrompngasync(lua_State* state) {
+    size_t path_length;
+    const char* path = luaL_checklstring(state, 1, &path_length);
+    luaL_checktype(state, 2, LUA_TFUNCTION);
+    lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME);
+    const struct Plugin* plugin = lua_touserdata(state, -1);
+    lua_pop(state, 1);
+    struct PngJob* job = malloc(sizeof(struct PngJob));
+    job->next = NULL;
+    job->coalesced = NULL;
+    job->pending_next = NULL;
+    job->plugin_id = plugin->id;
+    job->callback_id = _bolt_store_file_callback(state, 2);
+    job->path = _bolt_png_path(plugin, path, path_length);
+    job->mtime = 0;
+    job->has_mtime = _bolt_plugin_file_mtime(job->path, &job->mtime);
+    job->image = NULL;
+    job->rgba = NULL;
+    job->width = 0;
+    job->height = 0;
+    job->error[0] = '\0';
+    _bolt_queue_png_job(job);
+    return 0;
+}
+
 static int api_createwindow(lua_State* state) {
     lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME);
     const struct Plugin* plugin = lua_touserdata(state, -1);
@@ -1939,7 +5034,6 @@ static int api_createwindow(lua_State* state) {
     window->plugin_id = plugin->id;
     window->plugin = state;
     _bolt_rwlock_init(&window->lock);
-    _bolt_rwlock_init(&window->input_lock);
     window->metadata.x = luaL_checkinteger(state, 1);
     window->metadata.y = luaL_checkinteger(state, 2);
     window->metadata.width = luaL_checkinteger(state, 3);
@@ -1962,9 +5056,10 @@ static int api_createwindow(lua_State* state) {
     lua_settable(state, -3);
     lua_pop(state, 1);
 
-    // set this window in the hashmap, which is accessible by backends
+    // set this window in the hashmap, which is accessible by backends, and put it on top of the others
     _bolt_rwlock_lock_write(&windows.lock);
     hashmap_set(windows.map, &window);
+    _bolt_window_order_add(window);
     _bolt_rwlock_unlock_write(&windows.lock);
     return 1;
 }
@@ -1981,6 +5076,7 @@ static int api_createbrowser(lua_State* state) {
     browser->plugin = plugin;
     browser->do_capture = false;
     browser->capture_id = 0;
+    memset(&browser->capture, 0, sizeof(browser->capture));
     lua_getfield(state, LUA_REGISTRYINDEX, BROWSER_META_REGISTRYNAME);
     lua_setmetatable(state, -2);
     next_window_id += 1;
@@ -2006,9 +5102,12 @@ static int api_createbrowser(lua_State* state) {
         .h = luaL_checkinteger(state, 2),
     };
     const uint32_t url_length32 = (uint32_t)url_length;
-    _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-    _bolt_ipc_send(fd, &header, sizeof(header));
-    _bolt_ipc_send(fd, url, url_length32);
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &header, .len = sizeof(header)},
+        {.data = url, .len = url_length32},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
 
     // add to the hashmap
     hashmap_set(plugin->external_browsers, &browser);
@@ -2026,11 +5125,17 @@ static int api_createembeddedbrowser(lua_State* state) {
         lua_pushliteral(state, "createembeddedbrowser: failed to create shm object");
         lua_error(state);
     }
+    if (!_bolt_plugin_shm_open_inbound(&window->popup_shm, "ep", next_window_id)) {
+        _bolt_plugin_shm_close(&window->browser_shm);
+        lua_pushliteral(state, "createembeddedbrowser: failed to create shm object");
+        lua_error(state);
+    }
     window->is_deleted = false;
     window->is_browser = true;
     window->popup_shown = false;
     window->do_capture = false;
     window->capture_id = 0;
+    memset(&window->capture, 0, sizeof(window->capture));
     window->popup_initialised = false;
     window->popup_meta.x = 0;
     window->popup_meta.y = 0;
@@ -2039,7 +5144,6 @@ static int api_createembeddedbrowser(lua_State* state) {
     window->plugin_id = plugin->id;
     window->plugin = state;
     _bolt_rwlock_init(&window->lock);
-    _bolt_rwlock_init(&window->input_lock);
     window->metadata.x = luaL_checkinteger(state, 1);
     window->metadata.y = luaL_checkinteger(state, 2);
     window->metadata.width = luaL_checkinteger(state, 3);
@@ -2062,85 +5166,372 @@ static int api_createembeddedbrowser(lua_State* state) {
     lua_settable(state, -3);
     lua_pop(state, 1);
 
-    // send an IPC message to the host to create an OSR browser
-    const int pid = getpid();
-    size_t url_length;
-    const char* url = luaL_checklstring(state, 5, &url_length);
-    const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_CREATEBROWSER_OSR;
-    const struct BoltIPCCreateBrowserHeader header = {
-        .plugin_id = plugin->id,
-        .window_id = window->id,
-        .url_length = url_length,
-        .pid = pid,
-        .w = window->metadata.width,
-        .h = window->metadata.height,
-    };
-    const uint32_t url_length32 = (uint32_t)url_length;
-    _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-    _bolt_ipc_send(fd, &header, sizeof(header));
-    _bolt_ipc_send(fd, url, url_length32);
+    // send an IPC message to the host to create an OSR browser
+    const int pid = getpid();
+    size_t url_length;
+    const char* url = luaL_checklstring(state, 5, &url_length);
+    const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_CREATEBROWSER_OSR;
+    const struct BoltIPCCreateBrowserHeader header = {
+        .plugin_id = plugin->id,
+        .window_id = window->id,
+        .url_length = url_length,
+        .pid = pid,
+        .w = window->metadata.width,
+        .h = window->metadata.height,
+    };
+    const uint32_t url_length32 = (uint32_t)url_length;
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &header, .len = sizeof(header)},
+        {.data = url, .len = url_length32},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
+
+    // set this window in the hashmap, which is accessible by backends, and put it on top of the others
+    _bolt_rwlock_lock_write(&windows.lock);
+    hashmap_set(windows.map, &window);
+    _bolt_window_order_add(window);
+    _bolt_rwlock_unlock_write(&windows.lock);
+    return 1;
+}
+
+static int api_point(lua_State* state) {
+    struct Point3D* point = lua_newuserdata(state, sizeof(struct Point3D));
+    point->xyzh.floats[0] = luaL_checknumber(state, 1);
+    point->xyzh.floats[1] = luaL_checknumber(state, 2);
+    point->xyzh.floats[2] = luaL_checknumber(state, 3);
+    point->xyzh.floats[3] = 1.0;
+    point->integer = false;
+    point->homogenous = false;
+    lua_getfield(state, LUA_REGISTRYINDEX, POINT_META_REGISTRYNAME);
+    lua_setmetatable(state, -2);
+    return 1;
+}
+
+static int api_setframebudget(lua_State* state) {
+    const lua_Number micros = luaL_optnumber(state, 1, 0.0);
+    lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME);
+    struct Plugin* plugin = lua_touserdata(state, -1);
+    lua_pop(state, 1);
+    plugin->budget_nanos = micros > 0.0 ? (uint64_t)(micros * 1000.0) : 0;
+    plugin->over_budget_streak = 0;
+    plugin->budget_warned = false;
+    return 0;
+}
+
+static int api_createbuffer(lua_State* state) {
+    const long size = luaL_checklong(state, 1);
+    void* data = malloc(size);
+    if (!data) {
+        lua_pushfstring(state, "createbuffer: heap error, failed to allocate %i bytes", size);
+        lua_error(state);
+    }
+    push_buffer(state, data, size);
+    return 1;
+}
+
+static int api_createworker(lua_State* state) {
+    lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME);
+    const struct Plugin* plugin = lua_touserdata(state, -1);
+    lua_pop(state, 1);
+    size_t path_length;
+    const char* path = luaL_checklstring(state, 1, &path_length);
+    const size_t full_path_length = plugin->path_length + path_length + 1;
+    char* full_path = lua_newuserdata(state, full_path_length);
+    memcpy(full_path, plugin->path, plugin->path_length);
+    memcpy(full_path + plugin->path_length, path, path_length + 1);
+    for (char* c = full_path + plugin->path_length; *c; c += 1) {
+        if (*c == '\\') *c = '/';
+    }
+
+    struct Worker* worker = malloc(sizeof(struct Worker));
+    if (!worker) {
+        lua_pushfstring(state, "createworker: heap error, failed to allocate %d bytes", (int)sizeof(struct Worker));
+        lua_error(state);
+    }
+    worker->state = luaL_newstate();
+    if (_bolt_load_chunk(worker->state, full_path)) {
+        lua_pushfstring(state, "createworker: %s", lua_tolstring(worker->state, -1, 0));
+        lua_close(worker->state);
+        free(worker);
+        lua_error(state);
+    }
+    lua_pop(state, 1);
+
+    // set up the worker's state, leaving the function from loadfile on top of its stack, since
+    // that's what the worker's thread will start by calling
+    lua_pushliteral(worker->state, WORKER_REGISTRYNAME);
+    lua_pushlightuserdata(worker->state, worker);
+    lua_settable(worker->state, LUA_REGISTRYINDEX);
+    _bolt_open_libraries(worker->state, plugin->path, plugin->path_length, _bolt_worker_api_init);
+    _bolt_create_metatables(worker->state, &buffer_metatable, 1);
+    // the only way to stop a worker is with a count hook, which compiled traces never call, so a worker
+    // stuck in a hot loop would be impossible to stop. this has to be done before any of its code runs,
+    // since luaJIT_setmode isn't safe to call from another thread
+    luaJIT_setmode(worker->state, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_OFF);
+
+    worker->id = next_worker_id;
+    worker->plugin_id = plugin->id;
+    worker->is_deleted = false;
+    worker->inbox_head = NULL;
+    worker->inbox_tail = NULL;
+    worker->outbox_head = NULL;
+    worker->outbox_tail = NULL;
+    worker->stopping = false;
+    worker->failed = false;
+    if (!_bolt_plugin_thread_start(&worker->thread, _bolt_worker_main, worker)) {
+        lua_close(worker->state);
+        free(worker);
+        lua_pushliteral(state, "createworker: failed to start thread");
+        lua_error(state);
+    }
+    next_worker_id += 1;
+    hashmap_set(plugin->workers, &worker);
+
+    // create an empty event table in the registry for this worker
+    lua_getfield(state, LUA_REGISTRYINDEX, WORKERS_REGISTRYNAME);
+    lua_pushinteger(state, worker->id);
+    lua_createtable(state, WORKER_EVENT_ENUM_SIZE, 0);
+    lua_settable(state, -3);
+    lua_pop(state, 1);
+
+    uint64_t* worker_id = lua_newuserdata(state, sizeof(uint64_t));
+    *worker_id = worker->id;
+    lua_getfield(state, LUA_REGISTRYINDEX, WORKER_META_REGISTRYNAME);
+    lua_setmetatable(state, -2);
+    return 1;
+}
+
+// copies `size` bytes per vertex, for vertices [first, first+count), from a snapshot's tightly-packed
+// array into a strided output, for the bulk vtable functions
+static void snapshot_copy_range(const void* array, size_t size, size_t first, size_t count, void* out, size_t stride) {
+    const uint8_t* src = (const uint8_t*)array + (first * size);
+    if (stride == size) {
+        memcpy(out, src, count * size);
+        return;
+    }
+    for (size_t i = 0; i < count; i += 1) {
+        memcpy((uint8_t*)out + (i * stride), src + (i * size), size);
+    }
+}
+
+static void snapshot2d_xy(size_t index, void* userdata, int32_t* out) {
+    const struct Batch2DSnapshot* s = userdata;
+    if (index >= s->vertex_count) { memset(out, 0, 2 * sizeof(*out)); return; }
+    memcpy(out, s->xy + (index * 2), 2 * sizeof(*out));
+}
+
+static void snapshot2d_atlas_xy(size_t index, void* userdata, int32_t* out) {
+    const struct Batch2DSnapshot* s = userdata;
+    if (index >= s->vertex_count) { memset(out, 0, 2 * sizeof(*out)); return; }
+    memcpy(out, s->atlas_xy + (index * 2), 2 * sizeof(*out));
+}
+
+static void snapshot2d_atlas_wh(size_t index, void* userdata, int32_t* out) {
+    const struct Batch2DSnapshot* s = userdata;
+    if (index >= s->vertex_count) { memset(out, 0, 2 * sizeof(*out)); return; }
+    memcpy(out, s->atlas_wh + (index * 2), 2 * sizeof(*out));
+}
+
+static void snapshot2d_uv(size_t index, void* userdata, double* out) {
+    const struct Batch2DSnapshot* s = userdata;
+    if (index >= s->vertex_count) { memset(out, 0, 2 * sizeof(*out)); return; }
+    out[0] = (double)s->uv[index * 2];
+    out[1] = (double)s->uv[(index * 2) + 1];
+}
+
+static void snapshot2d_colour(size_t index, void* userdata, double* out) {
+    const struct Batch2DSnapshot* s = userdata;
+    if (index >= s->vertex_count) { memset(out, 0, 4 * sizeof(*out)); return; }
+    for (size_t i = 0; i < 4; i += 1) out[i] = (double)s->colour[(index * 4) + i];
+}
+
+static void snapshot2d_xy_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    const struct Batch2DSnapshot* s = userdata;
+    snapshot_copy_range(s->xy, 2 * sizeof(int32_t), first, count, out, stride);
+}
+
+static void snapshot2d_atlas_xy_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    const struct Batch2DSnapshot* s = userdata;
+    snapshot_copy_range(s->atlas_xy, 2 * sizeof(int32_t), first, count, out, stride);
+}
+
+static void snapshot2d_atlas_wh_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    const struct Batch2DSnapshot* s = userdata;
+    snapshot_copy_range(s->atlas_wh, 2 * sizeof(int32_t), first, count, out, stride);
+}
+
+static void snapshot2d_uv_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    const struct Batch2DSnapshot* s = userdata;
+    snapshot_copy_range(s->uv, 2 * sizeof(float), first, count, out, stride);
+}
+
+static void snapshot2d_colour_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    const struct Batch2DSnapshot* s = userdata;
+    snapshot_copy_range(s->colour, 4 * sizeof(float), first, count, out, stride);
+}
+
+static size_t snapshot2d_texture_id(void* userdata) {
+    const struct Batch2DSnapshot* s = userdata;
+    return s->texture_id;
+}
+
+static void snapshot2d_texture_size(void* userdata, size_t* out) {
+    const struct Batch2DSnapshot* s = userdata;
+    out[0] = s->texture_size[0];
+    out[1] = s->texture_size[1];
+}
+
+// snapshots don't keep a copy of the texture's contents, which could be hundreds of megabytes
+static uint8_t snapshot_texture_compare(void* userdata, size_t x, size_t y, size_t len, const unsigned char* data) {
+    return false;
+}
+
+static uint8_t* snapshot_texture_data(void* userdata, size_t x, size_t y, size_t len) {
+    return NULL;
+}
 
-    // set this window in the hashmap, which is accessible by backends
-    _bolt_rwlock_lock_write(&windows.lock);
-    hashmap_set(windows.map, &window);
-    _bolt_rwlock_unlock_write(&windows.lock);
-    return 1;
+static uint8_t snapshot_texture_hash(void* userdata, size_t x, size_t y, size_t w, size_t h, uint8_t perceptual, uint64_t* out) {
+    return false;
 }
 
-static int api_point(lua_State* state) {
-    struct Point3D* point = lua_newuserdata(state, sizeof(struct Point3D));
-    point->xyzh.floats[0] = luaL_checknumber(state, 1);
-    point->xyzh.floats[1] = luaL_checknumber(state, 2);
-    point->xyzh.floats[2] = luaL_checknumber(state, 3);
-    point->xyzh.floats[3] = 1.0;
-    point->integer = false;
-    point->homogenous = false;
-    lua_getfield(state, LUA_REGISTRYINDEX, POINT_META_REGISTRYNAME);
-    lua_setmetatable(state, -2);
-    return 1;
+static void snapshot3d_xyz(size_t index, void* userdata, struct Point3D* out) {
+    const struct Render3DSnapshot* s = userdata;
+    out->integer = false;
+    out->homogenous = false;
+    if (index >= s->vertex_count) {
+        memset(out->xyzh.floats, 0, 3 * sizeof(double));
+    } else {
+        for (size_t i = 0; i < 3; i += 1) out->xyzh.floats[i] = (double)s->xyz[(index * 3) + i];
+    }
+    out->xyzh.floats[3] = 1.0;
 }
 
-static int api_createbuffer(lua_State* state) {
-    const long size = luaL_checklong(state, 1);
-    struct FixedBuffer* buffer = lua_newuserdata(state, sizeof(struct FixedBuffer));
-    buffer->data = malloc(size);
-    if (!buffer->data) {
-        lua_pushfstring(state, "createbuffer: heap error, failed to allocate %i bytes", size);
-        lua_error(state);
+static size_t snapshot3d_atlas_meta(size_t index, void* userdata) {
+    const struct Render3DSnapshot* s = userdata;
+    return index < s->vertex_count ? s->meta[index] : 0;
+}
+
+static int snapshot3d_meta_compare(const void* a, const void* b) {
+    const uint32_t ma = *(const uint32_t*)a;
+    const uint32_t mb = *(const uint32_t*)b;
+    return (ma > mb) - (ma < mb);
+}
+
+static void snapshot3d_atlas_xywh(size_t meta, void* userdata, int32_t* out) {
+    const struct Render3DSnapshot* s = userdata;
+    const uint32_t key = (uint32_t)meta;
+    const uint32_t* found = s->meta_count ? bsearch(&key, s->metas, s->meta_count, sizeof(*s->metas), snapshot3d_meta_compare) : NULL;
+    if (!found) {
+        memset(out, 0, 4 * sizeof(*out));
+        return;
     }
-    buffer->size = size;
-    lua_getfield(state, LUA_REGISTRYINDEX, BUFFER_META_REGISTRYNAME);
-    lua_setmetatable(state, -2);
-    return 1;
+    memcpy(out, s->meta_xywh + ((found - s->metas) * 4), 4 * sizeof(*out));
+}
+
+static void snapshot3d_uv(size_t index, void* userdata, double* out) {
+    const struct Render3DSnapshot* s = userdata;
+    if (index >= s->vertex_count) { memset(out, 0, 2 * sizeof(*out)); return; }
+    out[0] = (double)s->uv[index * 2];
+    out[1] = (double)s->uv[(index * 2) + 1];
+}
+
+static void snapshot3d_colour(size_t index, void* userdata, double* out) {
+    const struct Render3DSnapshot* s = userdata;
+    if (index >= s->vertex_count) { memset(out, 0, 4 * sizeof(*out)); return; }
+    for (size_t i = 0; i < 4; i += 1) out[i] = (double)s->colour[(index * 4) + i];
+}
+
+static uint8_t snapshot3d_bone_id(size_t index, void* userdata) {
+    const struct Render3DSnapshot* s = userdata;
+    return index < s->vertex_count ? (uint8_t)s->bone_id[index] : 0;
+}
+
+static void snapshot3d_bone_transform(uint8_t bone_id, void* userdata, struct Transform3D* out) {
+    const struct Render3DSnapshot* s = userdata;
+    if (s->bone_palette && bone_id < SNAPSHOT_BONE_COUNT) _bolt_plugin_bone_transform_from_palette(s->bone_palette, bone_id, out);
+    else memset(out, 0, sizeof(*out));
+}
+
+static const float* snapshot3d_bone_palette(void* userdata, size_t* bone_count) {
+    const struct Render3DSnapshot* s = userdata;
+    *bone_count = s->bone_palette ? SNAPSHOT_BONE_COUNT : 0;
+    return s->bone_palette;
+}
+
+static void snapshot3d_xyz_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    const struct Render3DSnapshot* s = userdata;
+    snapshot_copy_range(s->xyz, 3 * sizeof(float), first, count, out, stride);
+}
+
+static void snapshot3d_atlas_meta_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    const struct Render3DSnapshot* s = userdata;
+    snapshot_copy_range(s->meta, sizeof(uint32_t), first, count, out, stride);
+}
+
+static void snapshot3d_uv_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    const struct Render3DSnapshot* s = userdata;
+    snapshot_copy_range(s->uv, 2 * sizeof(float), first, count, out, stride);
+}
+
+static void snapshot3d_colour_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    const struct Render3DSnapshot* s = userdata;
+    snapshot_copy_range(s->colour, 4 * sizeof(float), first, count, out, stride);
+}
+
+static void snapshot3d_bone_id_bulk(size_t first, size_t count, void* userdata, void* out, size_t stride) {
+    const struct Render3DSnapshot* s = userdata;
+    snapshot_copy_range(s->bone_id, sizeof(uint32_t), first, count, out, stride);
+}
+
+static size_t snapshot3d_texture_id(void* userdata) {
+    const struct Render3DSnapshot* s = userdata;
+    return s->texture_id;
+}
+
+static void snapshot3d_texture_size(void* userdata, size_t* out) {
+    const struct Render3DSnapshot* s = userdata;
+    out[0] = s->texture_size[0];
+    out[1] = s->texture_size[1];
+}
+
+static void snapshot3d_model_matrix(void* userdata, struct Transform3D* out) {
+    const struct Render3DSnapshot* s = userdata;
+    *out = s->model_matrix;
+}
+
+static void snapshot3d_viewproj_matrix(void* userdata, struct Transform3D* out) {
+    const struct Render3DSnapshot* s = userdata;
+    *out = s->viewproj_matrix;
 }
 
 static int api_batch2d_vertexcount(lua_State* state) {
-    const struct RenderBatch2D* batch = require_self_userdata(state, "vertexcount");
+    const struct RenderBatch2D* batch = require_frame_event(state, "vertexcount");
     lua_pushinteger(state, batch->index_count);
     return 1;
 }
 
 static int api_batch2d_verticesperimage(lua_State* state) {
-    const struct RenderBatch2D* batch = require_self_userdata(state, "verticesperimage");
+    const struct RenderBatch2D* batch = require_frame_event(state, "verticesperimage");
     lua_pushinteger(state, batch->vertices_per_icon);
     return 1;
 }
 
 static int api_batch2d_isminimap(lua_State* state) {
-    const struct RenderBatch2D* batch = require_self_userdata(state, "isminimap");
+    const struct RenderBatch2D* batch = require_frame_event(state, "isminimap");
     lua_pushboolean(state, batch->is_minimap);
     return 1;
 }
 
 static int api_batch2d_targetsize(lua_State* state) {
-    const struct RenderBatch2D* batch = require_self_userdata(state, "targetsize");
+    const struct RenderBatch2D* batch = require_frame_event(state, "targetsize");
     lua_pushinteger(state, batch->screen_width);
     lua_pushinteger(state, batch->screen_height);
     return 2;
 }
 
 static int api_batch2d_vertexxy(lua_State* state) {
-    const struct RenderBatch2D* batch = require_self_userdata(state, "vertexxy");
+    const struct RenderBatch2D* batch = require_frame_event(state, "vertexxy");
     const lua_Integer index = luaL_checkinteger(state, 2);
     int32_t xy[2];
     batch->vertex_functions.xy(index - 1, batch->vertex_functions.userdata, xy);
@@ -2150,7 +5541,7 @@ static int api_batch2d_vertexxy(lua_State* state) {
 }
 
 static int api_batch2d_vertexatlasxy(lua_State* state) {
-    const struct RenderBatch2D* batch = require_self_userdata(state, "vertexatlasxy");
+    const struct RenderBatch2D* batch = require_frame_event(state, "vertexatlasxy");
     const lua_Integer index = luaL_checkinteger(state, 2);
     int32_t xy[2];
     batch->vertex_functions.atlas_xy(index - 1, batch->vertex_functions.userdata, xy);
@@ -2160,7 +5551,7 @@ static int api_batch2d_vertexatlasxy(lua_State* state) {
 }
 
 static int api_batch2d_vertexatlaswh(lua_State* state) {
-    const struct RenderBatch2D* batch = require_self_userdata(state, "vertexatlaswh");
+    const struct RenderBatch2D* batch = require_frame_event(state, "vertexatlaswh");
     const lua_Integer index = luaL_checkinteger(state, 2);
     int32_t wh[2];
     batch->vertex_functions.atlas_wh(index - 1, batch->vertex_functions.userdata, wh);
@@ -2169,8 +5560,28 @@ static int api_batch2d_vertexatlaswh(lua_State* state) {
     return 2;
 }
 
+static int api_batch2d_vertexatlashash(lua_State* state) {
+    const struct RenderBatch2D* batch = require_frame_event(state, "vertexatlashash");
+    const lua_Integer index = luaL_checkinteger(state, 2);
+    int32_t xywh[4];
+    batch->vertex_functions.atlas_xy(index - 1, batch->vertex_functions.userdata, xywh);
+    batch->vertex_functions.atlas_wh(index - 1, batch->vertex_functions.userdata, xywh + 2);
+    push_texture_hash(state, &batch->texture_functions, xywh, false);
+    return 1;
+}
+
+static int api_batch2d_vertexatlasphash(lua_State* state) {
+    const struct RenderBatch2D* batch = require_frame_event(state, "vertexatlasphash");
+    const lua_Integer index = luaL_checkinteger(state, 2);
+    int32_t xywh[4];
+    batch->vertex_functions.atlas_xy(index - 1, batch->vertex_functions.userdata, xywh);
+    batch->vertex_functions.atlas_wh(index - 1, batch->vertex_functions.userdata, xywh + 2);
+    push_texture_hash(state, &batch->texture_functions, xywh, true);
+    return 1;
+}
+
 static int api_batch2d_vertexuv(lua_State* state) {
-    const struct RenderBatch2D* batch = require_self_userdata(state, "vertexuv");
+    const struct RenderBatch2D* batch = require_frame_event(state, "vertexuv");
     const lua_Integer index = lua_tointeger(state, 2);
     double uv[2];
     batch->vertex_functions.uv(index - 1, batch->vertex_functions.userdata, uv);
@@ -2180,7 +5591,7 @@ static int api_batch2d_vertexuv(lua_State* state) {
 }
 
 static int api_batch2d_vertexcolour(lua_State* state) {
-    const struct RenderBatch2D* batch = require_self_userdata(state, "vertexcolour");
+    const struct RenderBatch2D* batch = require_frame_event(state, "vertexcolour");
     const lua_Integer index = luaL_checkinteger(state, 2);
     double colour[4];
     batch->vertex_functions.colour(index - 1, batch->vertex_functions.userdata, colour);
@@ -2191,15 +5602,37 @@ static int api_batch2d_vertexcolour(lua_State* state) {
     return 4;
 }
 
+static int api_batch2d_vertices(lua_State* state) {
+    const struct RenderBatch2D* batch = require_frame_event(state, "vertices");
+    const struct Vertex2DFunctions* f = &batch->vertex_functions;
+    size_t first, count;
+    uint8_t* out = check_vertex_range(state, "vertices", batch->index_count, BATCH2D_VERTEX_SIZE, &first, &count);
+    uint8_t* records = out ? out : malloc(count * BATCH2D_VERTEX_SIZE);
+    if (!records) {
+        lua_pushliteral(state, "vertices: heap error");
+        lua_error(state);
+    }
+    f->xy_bulk(first, count, f->userdata, records, BATCH2D_VERTEX_SIZE);
+    f->atlas_xy_bulk(first, count, f->userdata, records + 8, BATCH2D_VERTEX_SIZE);
+    f->atlas_wh_bulk(first, count, f->userdata, records + 16, BATCH2D_VERTEX_SIZE);
+    f->uv_bulk(first, count, f->userdata, records + 24, BATCH2D_VERTEX_SIZE);
+    f->colour_bulk(first, count, f->userdata, records + 32, BATCH2D_VERTEX_SIZE);
+    if (out) return 0;
+    // first six values are ints, the others are floats
+    push_vertex_table(state, records, count, BATCH2D_VERTEX_SIZE / 4, 0b000000111111);
+    free(records);
+    return 1;
+}
+
 static int api_batch2d_textureid(lua_State* state) {
-    const struct RenderBatch2D* render = require_self_userdata(state, "textureid");
+    const struct RenderBatch2D* render = require_frame_event(state, "textureid");
     const size_t id = render->texture_functions.id(render->texture_functions.userdata);
     lua_pushinteger(state, id);
     return 1;
 }
 
 static int api_batch2d_texturesize(lua_State* state) {
-    const struct RenderBatch2D* render = require_self_userdata(state, "texturesize");
+    const struct RenderBatch2D* render = require_frame_event(state, "texturesize");
     size_t size[2];
     render->texture_functions.size(render->texture_functions.userdata, size);
     lua_pushinteger(state, size[0]);
@@ -2208,7 +5641,7 @@ static int api_batch2d_texturesize(lua_State* state) {
 }
 
 static int api_batch2d_texturecompare(lua_State* state) {
-    const struct RenderBatch2D* render = require_self_userdata(state, "texturecompare");
+    const struct RenderBatch2D* render = require_frame_event(state, "texturecompare");
     const size_t x = luaL_checkinteger(state, 2);
     const size_t y = luaL_checkinteger(state, 3);
     size_t data_len;
@@ -2220,29 +5653,72 @@ static int api_batch2d_texturecompare(lua_State* state) {
 }
 
 static int api_batch2d_texturedata(lua_State* state) {
-    const struct RenderBatch2D* render = require_self_userdata(state, "texturedata");
-    const size_t x = luaL_checkinteger(state, 2);
-    const size_t y = luaL_checkinteger(state, 3);
-    const size_t len = luaL_checkinteger(state, 4);
-    const uint8_t* ret = render->texture_functions.data(render->texture_functions.userdata, x, y);
-    lua_pushlstring(state, (const char*)ret, len);
+    const struct RenderBatch2D* render = require_frame_event(state, "texturedata");
+    return push_texture_data(state, &render->texture_functions, "texturedata");
+}
+
+static int api_batch2d_snapshot(lua_State* state) {
+    const struct RenderBatch2D* batch = require_frame_event(state, "snapshot");
+    const struct Vertex2DFunctions* f = &batch->vertex_functions;
+    const size_t count = batch->index_count;
+    struct FrameEventHeader* header = lua_newuserdata(state, sizeof(struct FrameEventHeader) + sizeof(struct Batch2DSnapshot) + (count * BATCH2D_VERTEX_SIZE));
+    header->valid = true;
+    struct Batch2DSnapshot* snapshot = (struct Batch2DSnapshot*)(header + 1);
+    snapshot->vertex_count = count;
+    snapshot->xy = (int32_t*)(snapshot + 1);
+    snapshot->atlas_xy = snapshot->xy + (count * 2);
+    snapshot->atlas_wh = snapshot->atlas_xy + (count * 2);
+    snapshot->uv = (float*)(snapshot->atlas_wh + (count * 2));
+    snapshot->colour = snapshot->uv + (count * 2);
+    f->xy_bulk(0, count, f->userdata, snapshot->xy, 2 * sizeof(int32_t));
+    f->atlas_xy_bulk(0, count, f->userdata, snapshot->atlas_xy, 2 * sizeof(int32_t));
+    f->atlas_wh_bulk(0, count, f->userdata, snapshot->atlas_wh, 2 * sizeof(int32_t));
+    f->uv_bulk(0, count, f->userdata, snapshot->uv, 2 * sizeof(float));
+    f->colour_bulk(0, count, f->userdata, snapshot->colour, 4 * sizeof(float));
+    snapshot->texture_id = batch->texture_functions.id(batch->texture_functions.userdata);
+    batch->texture_functions.size(batch->texture_functions.userdata, snapshot->texture_size);
+
+    snapshot->batch = *batch;
+    snapshot->batch.vertex_functions = (struct Vertex2DFunctions) {
+        .userdata = snapshot,
+        .xy = snapshot2d_xy,
+        .atlas_xy = snapshot2d_atlas_xy,
+        .atlas_wh = snapshot2d_atlas_wh,
+        .uv = snapshot2d_uv,
+        .colour = snapshot2d_colour,
+        .xy_bulk = snapshot2d_xy_bulk,
+        .atlas_xy_bulk = snapshot2d_atlas_xy_bulk,
+        .atlas_wh_bulk = snapshot2d_atlas_wh_bulk,
+        .uv_bulk = snapshot2d_uv_bulk,
+        .colour_bulk = snapshot2d_colour_bulk,
+    };
+    snapshot->batch.texture_functions = (struct TextureFunctions) {
+        .userdata = snapshot,
+        .id = snapshot2d_texture_id,
+        .size = snapshot2d_texture_size,
+        .compare = snapshot_texture_compare,
+        .data = snapshot_texture_data,
+        .hash = snapshot_texture_hash,
+    };
+    lua_getfield(state, LUA_REGISTRYINDEX, BATCH2D_META_REGISTRYNAME);
+    lua_setmetatable(state, -2);
     return 1;
 }
 
 static int api_minimap_angle(lua_State* state) {
-    const struct RenderMinimapEvent* render = require_self_userdata(state, "angle");
+    const struct RenderMinimapEvent* render = require_frame_event(state, "angle");
     lua_pushnumber(state, render->angle);
     return 1;
 }
 
 static int api_minimap_scale(lua_State* state) {
-    const struct RenderMinimapEvent* render = require_self_userdata(state, "scale");
+    const struct RenderMinimapEvent* render = require_frame_event(state, "scale");
     lua_pushnumber(state, render->scale);
     return 1;
 }
 
 static int api_minimap_position(lua_State* state) {
-    const struct RenderMinimapEvent* render = require_self_userdata(state, "position");
+    const struct RenderMinimapEvent* render = require_frame_event(state, "position");
     lua_pushnumber(state, render->x);
     lua_pushnumber(state, render->y);
     return 2;
@@ -2352,6 +5828,86 @@ static int api_transform_get(lua_State* state) {
     return 16;
 }
 
+static int api_transform_combine(lua_State* state) {
+    const struct Transform3D* transform = require_self_userdata(state, "combine");
+    const struct Transform3D* other = require_userdata(state, 2, "combine");
+    struct Transform3D* out = lua_newuserdata(state, sizeof(struct Transform3D));
+    combine_transforms(transform, other, out);
+    lua_getfield(state, LUA_REGISTRYINDEX, TRANSFORM_META_REGISTRYNAME);
+    lua_setmetatable(state, -2);
+    return 1;
+}
+
+static int api_transform_projectpoints(lua_State* state) {
+    const struct Transform3D* transform = require_self_userdata(state, "projectpoints");
+    const struct FixedBuffer* in = require_userdata(state, 2, "projectpoints");
+    const lua_Integer in_offset = luaL_checkinteger(state, 3);
+    const lua_Integer stride = luaL_checkinteger(state, 4);
+    const lua_Integer count = luaL_checkinteger(state, 5);
+    const struct FixedBuffer* out = require_userdata(state, 6, "projectpoints");
+    const lua_Integer out_offset = luaL_checkinteger(state, 7);
+    const uint8_t cull = lua_toboolean(state, 8);
+    if (in_offset < 0 || stride < 12 || count < 0 || (count && (size_t)in_offset + ((size_t)(count - 1) * stride) + 12 > in->size)) {
+        lua_pushliteral(state, "projectpoints: input buffer is too small, or stride is less than 12");
+        lua_error(state);
+    }
+    if (out_offset < 0 || (size_t)out_offset + ((size_t)count * 12) > out->size) {
+        lua_pushfstring(state, "projectpoints: output buffer is too small for %d points at offset %d", (int)count, (int)out_offset);
+        lua_error(state);
+    }
+
+    float m[16], view[4];
+    for (size_t i = 0; i < 16; i += 1) m[i] = (float)transform->matrix[i];
+    project_view(view);
+
+    const uint8_t* src = (const uint8_t*)in->data + in_offset;
+    uint8_t* dest = (uint8_t*)out->data + out_offset;
+    size_t written = 0;
+    float x1 = 0.0f, y1 = 0.0f, x2 = 0.0f, y2 = 0.0f;
+    uint8_t any_visible = false;
+    struct ProjectBlock block;
+    for (size_t base = 0; base < (size_t)count; base += PROJECT_BLOCK_SIZE) {
+        const size_t n = ((size_t)count - base) < PROJECT_BLOCK_SIZE ? ((size_t)count - base) : PROJECT_BLOCK_SIZE;
+        for (size_t i = 0; i < n; i += 1) {
+            float xyz[3];
+            memcpy(xyz, src + ((base + i) * stride), sizeof(xyz));
+            block.x[i] = xyz[0];
+            block.y[i] = xyz[1];
+            block.z[i] = xyz[2];
+        }
+        project_block(&block, n, m, view);
+        for (size_t i = 0; i < n; i += 1) {
+            const float w = block.w[i];
+            // pixel X and Y go from view[0] to view[0] + (view[2] * 2), and so on, if on-screen
+            const uint8_t visible = w > 0.0f && block.z[i] >= -w && block.z[i] <= w &&
+                block.x[i] >= view[0] && block.x[i] <= view[0] + (view[2] * 2.0f) &&
+                block.y[i] >= view[1] && block.y[i] <= view[1] + (view[3] * 2.0f);
+            if (cull && !visible) continue;
+            if (w > 0.0f) {
+                if (!any_visible || block.x[i] < x1) x1 = block.x[i];
+                if (!any_visible || block.y[i] < y1) y1 = block.y[i];
+                if (!any_visible || block.x[i] > x2) x2 = block.x[i];
+                if (!any_visible || block.y[i] > y2) y2 = block.y[i];
+                any_visible = true;
+            }
+            const int32_t index = (int32_t)(base + i + 1);
+            uint8_t* record = dest + (written * 12);
+            memcpy(record, &block.x[i], sizeof(float));
+            memcpy(record + 4, &block.y[i], sizeof(float));
+            memcpy(record + 8, &index, sizeof(index));
+            written += 1;
+        }
+    }
+
+    lua_pushinteger(state, written);
+    if (!any_visible) return 1;
+    lua_pushnumber(state, x1);
+    lua_pushnumber(state, y1);
+    lua_pushnumber(state, x2);
+    lua_pushnumber(state, y2);
+    return 5;
+}
+
 static int api_surface_clear(lua_State* state) {
     const struct SurfaceFunctions* functions = require_self_userdata(state, "clear");
     const int argc = lua_gettop(state);
@@ -2374,12 +5930,12 @@ static int api_surface_subimage(lua_State* state) {
     const void* rgba;
     get_binary_data(state, 6, &rgba, &length);
     if (length >= req_length) {
-        functions->subimage(functions->userdata, x, y, w, h, rgba, 0);
+        functions->subimage(functions->userdata, x, y, w, h, rgba, 0, 0);
     } else {
         uint8_t* ud = lua_newuserdata(state, req_length);
         memcpy(ud, rgba, length);
         memset(ud + length, 0, req_length - length);
-        functions->subimage(functions->userdata, x, y, w, h, (const void*)ud, 0);
+        functions->subimage(functions->userdata, x, y, w, h, (const void*)ud, 0, 0);
         lua_pop(state, 1);
     }
     lua_getfield(state, LUA_REGISTRYINDEX, SURFACE_META_REGISTRYNAME);
@@ -2475,12 +6031,12 @@ static int api_window_subimage(lua_State* state) {
     const void* rgba;
     get_binary_data(state, 6, &rgba, &length);
     if (length >= req_length) {
-        window->surface_functions.subimage(window->surface_functions.userdata, x, y, w, h, rgba, 0);
+        window->surface_functions.subimage(window->surface_functions.userdata, x, y, w, h, rgba, 0, 0);
     } else {
         uint8_t* ud = lua_newuserdata(state, req_length);
         memcpy(ud, rgba, length);
         memset(ud + length, 0, req_length - length);
-        window->surface_functions.subimage(window->surface_functions.userdata, x, y, w, h, (const void*)ud, 0);
+        window->surface_functions.subimage(window->surface_functions.userdata, x, y, w, h, (const void*)ud, 0, 0);
         lua_pop(state, 1);
     }
     lua_getfield(state, LUA_REGISTRYINDEX, SURFACE_META_REGISTRYNAME);
@@ -2506,13 +6062,13 @@ static int api_window_cancelreposition(lua_State* state) {
 }
 
 static int api_render3d_vertexcount(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "vertexcount");
+    const struct Render3D* render = require_frame_event(state, "vertexcount");
     lua_pushinteger(state, render->vertex_count);
     return 1;
 }
 
 static int api_render3d_vertexxyz(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "vertexxyz");
+    const struct Render3D* render = require_frame_event(state, "vertexxyz");
     const lua_Integer index = lua_tointeger(state, 2);
     struct Point3D* point = lua_newuserdata(state, sizeof(struct Point3D));
     render->vertex_functions.xyz(index - 1, render->vertex_functions.userdata, point);
@@ -2522,7 +6078,7 @@ static int api_render3d_vertexxyz(lua_State* state) {
 }
 
 static int api_render3d_modelmatrix(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "modelmatrix");
+    const struct Render3D* render = require_frame_event(state, "modelmatrix");
     struct Transform3D* transform = lua_newuserdata(state, sizeof(struct Transform3D));
     render->matrix_functions.model_matrix(render->matrix_functions.userdata, transform);
     lua_getfield(state, LUA_REGISTRYINDEX, TRANSFORM_META_REGISTRYNAME);
@@ -2531,7 +6087,7 @@ static int api_render3d_modelmatrix(lua_State* state) {
 }
 
 static int api_render3d_viewprojmatrix(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "viewprojmatrix");
+    const struct Render3D* render = require_frame_event(state, "viewprojmatrix");
     struct Transform3D* transform = lua_newuserdata(state, sizeof(struct Transform3D));
     render->matrix_functions.viewproj_matrix(render->matrix_functions.userdata, transform);
     lua_getfield(state, LUA_REGISTRYINDEX, TRANSFORM_META_REGISTRYNAME);
@@ -2540,7 +6096,7 @@ static int api_render3d_viewprojmatrix(lua_State* state) {
 }
 
 static int api_render3d_vertexmeta(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "vertexmeta");
+    const struct Render3D* render = require_frame_event(state, "vertexmeta");
     const lua_Integer index = luaL_checkinteger(state, 2);
     size_t meta = render->vertex_functions.atlas_meta(index - 1, render->vertex_functions.userdata);
     lua_pushinteger(state, meta);
@@ -2548,7 +6104,7 @@ static int api_render3d_vertexmeta(lua_State* state) {
 }
 
 static int api_render3d_atlasxywh(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "atlasxywh");
+    const struct Render3D* render = require_frame_event(state, "atlasxywh");
     const lua_Integer meta = luaL_checkinteger(state, 2);
     int32_t xywh[4];
     render->vertex_functions.atlas_xywh(meta, render->vertex_functions.userdata, xywh);
@@ -2559,8 +6115,26 @@ static int api_render3d_atlasxywh(lua_State* state) {
     return 4;
 }
 
+static int api_render3d_atlashash(lua_State* state) {
+    const struct Render3D* render = require_frame_event(state, "atlashash");
+    const lua_Integer meta = luaL_checkinteger(state, 2);
+    int32_t xywh[4];
+    render->vertex_functions.atlas_xywh(meta, render->vertex_functions.userdata, xywh);
+    push_texture_hash(state, &render->texture_functions, xywh, false);
+    return 1;
+}
+
+static int api_render3d_atlasphash(lua_State* state) {
+    const struct Render3D* render = require_frame_event(state, "atlasphash");
+    const lua_Integer meta = luaL_checkinteger(state, 2);
+    int32_t xywh[4];
+    render->vertex_functions.atlas_xywh(meta, render->vertex_functions.userdata, xywh);
+    push_texture_hash(state, &render->texture_functions, xywh, true);
+    return 1;
+}
+
 static int api_render3d_vertexuv(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "vertexuv");
+    const struct Render3D* render = require_frame_event(state, "vertexuv");
     const lua_Integer index = luaL_checkinteger(state, 2);
     double uv[4];
     render->vertex_functions.uv(index - 1, render->vertex_functions.userdata, uv);
@@ -2570,7 +6144,7 @@ static int api_render3d_vertexuv(lua_State* state) {
 }
 
 static int api_render3d_vertexcolour(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "vertexcolour");
+    const struct Render3D* render = require_frame_event(state, "vertexcolour");
     const lua_Integer index = luaL_checkinteger(state, 2);
     double col[4];
     render->vertex_functions.colour(index - 1, render->vertex_functions.userdata, col);
@@ -2581,15 +6155,144 @@ static int api_render3d_vertexcolour(lua_State* state) {
     return 4;
 }
 
+static int api_render3d_vertices(lua_State* state) {
+    const struct Render3D* render = require_frame_event(state, "vertices");
+    const struct Vertex3DFunctions* f = &render->vertex_functions;
+    size_t first, count;
+    uint8_t* out = check_vertex_range(state, "vertices", render->vertex_count, RENDER3D_VERTEX_SIZE, &first, &count);
+    uint8_t* records = out ? out : malloc(count * RENDER3D_VERTEX_SIZE);
+    if (!records) {
+        lua_pushliteral(state, "vertices: heap error");
+        lua_error(state);
+    }
+    f->xyz_bulk(first, count, f->userdata, records, RENDER3D_VERTEX_SIZE);
+    f->atlas_meta_bulk(first, count, f->userdata, records + 12, RENDER3D_VERTEX_SIZE);
+    f->uv_bulk(first, count, f->userdata, records + 16, RENDER3D_VERTEX_SIZE);
+    f->colour_bulk(first, count, f->userdata, records + 24, RENDER3D_VERTEX_SIZE);
+    f->bone_id_bulk(first, count, f->userdata, records + 40, RENDER3D_VERTEX_SIZE);
+    if (out) return 0;
+    // the meta-ID and bone ID are ints, everything else is a float
+    push_vertex_table(state, records, count, RENDER3D_VERTEX_SIZE / 4, 0b10000001000);
+    free(records);
+    return 1;
+}
+
+// applies the bone transform from `palette` to points `first` to `n` of the block. points whose bone
+// ID is past the end of the palette are left as they are.
+static void skin_block_scalar(struct ProjectBlock* block, const uint32_t* bone_ids, size_t first, size_t n, const float* palette, size_t bone_count) {
+    for (size_t i = first; i < n; i += 1) {
+        if (bone_ids[i] >= bone_count) continue;
+        const float* b = palette + (bone_ids[i] * 12);
+        const float x = block->x[i], y = block->y[i], z = block->z[i];
+        block->x[i] = (b[0] * x) + (b[3] * y) + (b[6] * z) + b[9];
+        block->y[i] = (b[1] * x) + (b[4] * y) + (b[7] * z) + b[10];
+        block->z[i] = (b[2] * x) + (b[5] * y) + (b[8] * z) + b[11];
+    }
+}
+
+#if defined(BOLT_HAVE_PROJECT_BLOCK_SIMD)
+// every point can have a different bone, so this gathers each of the twelve palette floats for eight
+// points at once. like the project_block kernels, it returns how many points it did.
+__attribute__((target("avx2"))) static size_t skin_block_avx2(struct ProjectBlock* block, const uint32_t* bone_ids, size_t n, const float* palette, size_t bone_count) {
+    const __m256i last = _mm256_set1_epi32((int)(bone_count - 1));
+    const __m256i twelve = _mm256_set1_epi32(12);
+    size_t i;
+    for (i = 0; i + 8 <= n; i += 8) {
+        const __m256i ids = _mm256_loadu_si256((const __m256i*)(bone_ids + i));
+        const __m256 valid = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_min_epu32(ids, last), ids));
+        const __m256i offsets = _mm256_mullo_epi32(ids, twelve);
+        __m256 b[12];
+        for (size_t k = 0; k < 12; k += 1) b[k] = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), palette + k, offsets, valid, 4);
+        const __m256 x = _mm256_loadu_ps(block->x + i), y = _mm256_loadu_ps(block->y + i), z = _mm256_loadu_ps(block->z + i);
+        const __m256 sx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(b[0], x), _mm256_mul_ps(b[3], y)), _mm256_mul_ps(b[6], z)), b[9]);
+        const __m256 sy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(b[1], x), _mm256_mul_ps(b[4], y)), _mm256_mul_ps(b[7], z)), b[10]);
+        const __m256 sz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(b[2], x), _mm256_mul_ps(b[5], y)), _mm256_mul_ps(b[8], z)), b[11]);
+        _mm256_storeu_ps(block->x + i, _mm256_blendv_ps(x, sx, valid));
+        _mm256_storeu_ps(block->y + i, _mm256_blendv_ps(y, sy, valid));
+        _mm256_storeu_ps(block->z + i, _mm256_blendv_ps(z, sz, valid));
+    }
+    return i;
+}
+#endif
+
+static void skin_block(struct ProjectBlock* block, const uint32_t* bone_ids, size_t n, const float* palette, size_t bone_count) {
+    size_t done = 0;
+#if defined(BOLT_HAVE_PROJECT_BLOCK_SIMD)
+    // the gather offsets are 32-bit, which no real palette comes anywhere near
+    if (bone_count <= INT32_MAX / 12 && __builtin_cpu_supports("avx2")) done = skin_block_avx2(block, bone_ids, n, palette, bone_count);
+#endif
+    skin_block_scalar(block, bone_ids, done, n, palette, bone_count);
+}
+
+// transforms `count` model-space vertices all the way to screen space, writing four floats to `out`
+// for each one: X and Y in pixels, as Point:aspixels() would give, then Z and W in clip space.
+static void skin_vertices(const float* xyz, const uint32_t* bone_ids, size_t count, const float* palette, size_t bone_count, const float* mvp, const float* view, uint8_t* out) {
+    struct ProjectBlock block;
+    for (size_t base = 0; base < count; base += PROJECT_BLOCK_SIZE) {
+        const size_t n = (count - base) < PROJECT_BLOCK_SIZE ? (count - base) : PROJECT_BLOCK_SIZE;
+        for (size_t i = 0; i < n; i += 1) {
+            const float* v = xyz + ((base + i) * 3);
+            block.x[i] = v[0];
+            block.y[i] = v[1];
+            block.z[i] = v[2];
+        }
+        if (palette && bone_count) skin_block(&block, bone_ids + base, n, palette, bone_count);
+        project_block(&block, n, mvp, view);
+        for (size_t i = 0; i < n; i += 1) {
+            const float record[] = {block.x[i], block.y[i], block.z[i], block.w[i]};
+            // buffer offsets can be anything, so this may not be aligned
+            memcpy(out + ((base + i) * sizeof(record)), record, sizeof(record));
+        }
+    }
+}
+
+static int api_render3d_skinnedvertices(lua_State* state) {
+    const struct Render3D* render = require_frame_event(state, "skinnedvertices");
+    const struct Vertex3DFunctions* f = &render->vertex_functions;
+    size_t first, count;
+    uint8_t* out = check_vertex_range(state, "skinnedvertices", render->vertex_count, 4 * sizeof(float), &first, &count);
+    float* xyz = malloc((count ? count : 1) * 3 * sizeof(float));
+    uint32_t* bone_ids = malloc((count ? count : 1) * sizeof(uint32_t));
+    uint8_t* records = out ? out : malloc((count ? count : 1) * 4 * sizeof(float));
+    if (!xyz || !bone_ids || !records) {
+        free(xyz);
+        free(bone_ids);
+        if (!out) free(records);
+        lua_pushliteral(state, "skinnedvertices: heap error");
+        lua_error(state);
+    }
+    f->xyz_bulk(first, count, f->userdata, xyz, 3 * sizeof(float));
+    f->bone_id_bulk(first, count, f->userdata, bone_ids, sizeof(uint32_t));
+
+    size_t bone_count = 0;
+    const float* palette = render->is_animated ? f->bone_palette(f->userdata, &bone_count) : NULL;
+    struct Transform3D model, viewproj;
+    render->matrix_functions.model_matrix(render->matrix_functions.userdata, &model);
+    render->matrix_functions.viewproj_matrix(render->matrix_functions.userdata, &viewproj);
+    struct Transform3D combined;
+    combine_transforms(&model, &viewproj, &combined);
+    float mvp[16], view[4];
+    for (size_t i = 0; i < 16; i += 1) mvp[i] = (float)combined.matrix[i];
+    project_view(view);
+
+    skin_vertices(xyz, bone_ids, count, palette, bone_count, mvp, view, records);
+    free(xyz);
+    free(bone_ids);
+    if (out) return 0;
+    push_vertex_table(state, records, count, 4, 0);
+    free(records);
+    return 1;
+}
+
 static int api_render3d_textureid(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "textureid");
+    const struct Render3D* render = require_frame_event(state, "textureid");
     const size_t id = render->texture_functions.id(render->texture_functions.userdata);
     lua_pushinteger(state, id);
     return 1;
 }
 
 static int api_render3d_texturesize(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "texturesize");
+    const struct Render3D* render = require_frame_event(state, "texturesize");
     size_t size[2];
     render->texture_functions.size(render->texture_functions.userdata, size);
     lua_pushinteger(state, size[0]);
@@ -2598,7 +6301,7 @@ static int api_render3d_texturesize(lua_State* state) {
 }
 
 static int api_render3d_texturecompare(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "texturecompare");
+    const struct Render3D* render = require_frame_event(state, "texturecompare");
     const size_t x = luaL_checkinteger(state, 2);
     const size_t y = luaL_checkinteger(state, 3);
     size_t data_len;
@@ -2610,17 +6313,12 @@ static int api_render3d_texturecompare(lua_State* state) {
 }
 
 static int api_render3d_texturedata(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "texturedata");
-    const size_t x = luaL_checkinteger(state, 2);
-    const size_t y = luaL_checkinteger(state, 3);
-    const size_t len = luaL_checkinteger(state, 4);
-    const uint8_t* ret = render->texture_functions.data(render->texture_functions.userdata, x, y);
-    lua_pushlstring(state, (const char*)ret, len);
-    return 1;
+    const struct Render3D* render = require_frame_event(state, "texturedata");
+    return push_texture_data(state, &render->texture_functions, "texturedata");
 }
 
 static int api_render3d_vertexbone(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "vertexbone");
+    const struct Render3D* render = require_frame_event(state, "vertexbone");
     const int index = luaL_checkinteger(state, 2);
     uint8_t ret = render->vertex_functions.bone_id(index - 1, render->vertex_functions.userdata);
     lua_pushinteger(state, ret);
@@ -2628,7 +6326,7 @@ static int api_render3d_vertexbone(lua_State* state) {
 }
 
 static int api_render3d_boneanimation(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "boneanimation");
+    const struct Render3D* render = require_frame_event(state, "boneanimation");
     const lua_Integer bone_id = luaL_checkinteger(state, 2);
 
     if (!render->is_animated) {
@@ -2650,11 +6348,102 @@ static int api_render3d_boneanimation(lua_State* state) {
 }
 
 static int api_render3d_animated(lua_State* state) {
-    const struct Render3D* render = require_self_userdata(state, "animated");
+    const struct Render3D* render = require_frame_event(state, "animated");
     lua_pushboolean(state, render->is_animated);
     return 1;
 }
 
+static int api_render3d_snapshot(lua_State* state) {
+    const struct Render3D* render = require_frame_event(state, "snapshot");
+    const struct Vertex3DFunctions* f = &render->vertex_functions;
+    const size_t count = render->vertex_count;
+
+    // find the distinct meta-IDs first, since that decides how big the snapshot will be
+    uint32_t* metas = malloc((count ? count : 1) * sizeof(uint32_t));
+    if (!metas) {
+        lua_pushliteral(state, "snapshot: heap error");
+        lua_error(state);
+    }
+    f->atlas_meta_bulk(0, count, f->userdata, metas, sizeof(uint32_t));
+    qsort(metas, count, sizeof(uint32_t), snapshot3d_meta_compare);
+    size_t meta_count = 0;
+    for (size_t i = 0; i < count; i += 1) {
+        if (meta_count == 0 || metas[meta_count - 1] != metas[i]) metas[meta_count++] = metas[i];
+    }
+
+    const size_t bone_count = render->is_animated ? SNAPSHOT_BONE_COUNT : 0;
+    const size_t size = sizeof(struct Render3DSnapshot) + (bone_count * 12 * sizeof(float)) + (meta_count * 5 * sizeof(uint32_t)) + (count * RENDER3D_VERTEX_SIZE);
+    struct FrameEventHeader* header = lua_newuserdata(state, sizeof(struct FrameEventHeader) + size);
+    header->valid = true;
+    struct Render3DSnapshot* snapshot = (struct Render3DSnapshot*)(header + 1);
+    snapshot->vertex_count = count;
+    snapshot->meta_count = meta_count;
+    snapshot->bone_palette = bone_count ? (float*)(snapshot + 1) : NULL;
+    snapshot->metas = (uint32_t*)((float*)(snapshot + 1) + (bone_count * 12));
+    snapshot->meta_xywh = (int32_t*)(snapshot->metas + meta_count);
+    snapshot->xyz = (float*)(snapshot->meta_xywh + (meta_count * 4));
+    snapshot->meta = (uint32_t*)(snapshot->xyz + (count * 3));
+    snapshot->uv = (float*)(snapshot->meta + count);
+    snapshot->colour = snapshot->uv + (count * 2);
+    snapshot->bone_id = (uint32_t*)(snapshot->colour + (count * 4));
+
+    memcpy(snapshot->metas, metas, meta_count * sizeof(uint32_t));
+    free(metas);
+    for (size_t i = 0; i < meta_count; i += 1) {
+        f->atlas_xywh(snapshot->metas[i], f->userdata, snapshot->meta_xywh + (i * 4));
+    }
+    if (bone_count) {
+        size_t palette_count;
+        const float* palette = f->bone_palette(f->userdata, &palette_count);
+        if (palette_count > bone_count) palette_count = bone_count;
+        memcpy(snapshot->bone_palette, palette, palette_count * 12 * sizeof(float));
+        memset(snapshot->bone_palette + (palette_count * 12), 0, (bone_count - palette_count) * 12 * sizeof(float));
+    }
+    f->xyz_bulk(0, count, f->userdata, snapshot->xyz, 3 * sizeof(float));
+    f->atlas_meta_bulk(0, count, f->userdata, snapshot->meta, sizeof(uint32_t));
+    f->uv_bulk(0, count, f->userdata, snapshot->uv, 2 * sizeof(float));
+    f->colour_bulk(0, count, f->userdata, snapshot->colour, 4 * sizeof(float));
+    f->bone_id_bulk(0, count, f->userdata, snapshot->bone_id, sizeof(uint32_t));
+    snapshot->texture_id = render->texture_functions.id(render->texture_functions.userdata);
+    render->texture_functions.size(render->texture_functions.userdata, snapshot->texture_size);
+    render->matrix_functions.model_matrix(render->matrix_functions.userdata, &snapshot->model_matrix);
+    render->matrix_functions.viewproj_matrix(render->matrix_functions.userdata, &snapshot->viewproj_matrix);
+
+    snapshot->render = *render;
+    snapshot->render.vertex_functions = (struct Vertex3DFunctions) {
+        .userdata = snapshot,
+        .xyz = snapshot3d_xyz,
+        .atlas_meta = snapshot3d_atlas_meta,
+        .atlas_xywh = snapshot3d_atlas_xywh,
+        .uv = snapshot3d_uv,
+        .colour = snapshot3d_colour,
+        .bone_id = snapshot3d_bone_id,
+        .bone_transform = snapshot3d_bone_transform,
+        .bone_palette = snapshot3d_bone_palette,
+        .xyz_bulk = snapshot3d_xyz_bulk,
+        .atlas_meta_bulk = snapshot3d_atlas_meta_bulk,
+        .uv_bulk = snapshot3d_uv_bulk,
+        .colour_bulk = snapshot3d_colour_bulk,
+        .bone_id_bulk = snapshot3d_bone_id_bulk,
+    };
+    snapshot->render.texture_functions = (struct TextureFunctions) {
+        .userdata = snapshot,
+        .id = snapshot3d_texture_id,
+        .size = snapshot3d_texture_size,
+        .compare = snapshot_texture_compare,
+        .data = snapshot_texture_data,
+        .hash = snapshot_texture_hash,
+    };
+    snapshot->render.matrix_functions = (struct Render3DMatrixFunctions) {
+        .userdata = snapshot,
+        .model_matrix = snapshot3d_model_matrix,
+        .viewproj_matrix = snapshot3d_viewproj_matrix,
+    };
+    lua_getfield(state, LUA_REGISTRYINDEX, RENDER3D_META_REGISTRYNAME);
+    lua_setmetatable(state, -2);
+    return 1;
+}
+
 static int api_repositionevent_xywh(lua_State* state) {
     const struct RepositionEvent* event = require_self_userdata(state, "xywh");
     lua_pushinteger(state, event->x);
@@ -2740,8 +6529,11 @@ static int api_browser_close(lua_State* state) {
 
     const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_CLOSEBROWSER_EXTERNAL;
     const struct BoltIPCCloseBrowserHeader header = { .plugin_id = browser->plugin_id, .window_id = browser->id };
-    _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-    _bolt_ipc_send(fd, &header, sizeof(header));
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &header, .len = sizeof(header)},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
 
     return 0;
 }
@@ -2758,9 +6550,12 @@ static int api_browser_sendmessage(lua_State* state) {
 
     const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_PLUGINMESSAGE;
     const struct BoltIPCPluginMessageHeader header = { .plugin_id = id, .window_id = window->id, .message_size = len };
-    _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-    _bolt_ipc_send(fd, &header, sizeof(header));
-    _bolt_ipc_send(fd, str, len);
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &header, .len = sizeof(header)},
+        {.data = str, .len = len},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
     return 0;
 }
 
@@ -2770,7 +6565,24 @@ static int api_browser_enablecapture(lua_State* state) {
         window->plugin->ext_browser_capture_count += 1;
         window->do_capture = true;
         window->capture_ready = true;
+        window->capture.next_time = 0;
+        memset(&window->capture.tile_region, 0, sizeof(window->capture.tile_region));
     }
+    window->capture.interval_micros = opt_capture_interval(state);
+    return 0;
+}
+
+static int api_browser_setcaptureregion(lua_State* state) {
+    struct ExternalBrowser* window = require_self_userdata(state, "setcaptureregion");
+    check_capture_region(state, &window->capture);
+    return 0;
+}
+
+static int api_browser_setcapturetiled(lua_State* state) {
+    struct ExternalBrowser* window = require_self_userdata(state, "setcapturetiled");
+    const uint8_t tiled = lua_toboolean(state, 2);
+    if (tiled && !window->capture.tiled) memset(&window->capture.tile_region, 0, sizeof(window->capture.tile_region));
+    window->capture.tiled = tiled;
     return 0;
 }
 
@@ -2821,8 +6633,11 @@ static int api_embeddedbrowser_close(lua_State* state) {
 
     const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_CLOSEBROWSER_OSR;
     const struct BoltIPCCloseBrowserHeader header = { .plugin_id = window->plugin_id, .window_id = window->id };
-    _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-    _bolt_ipc_send(fd, &header, sizeof(header));
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &header, .len = sizeof(header)},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
 
     return 0;
 }
@@ -2839,9 +6654,12 @@ static int api_embeddedbrowser_sendmessage(lua_State* state) {
 
     const enum BoltIPCMessageTypeToHost msg_type = IPC_MSG_OSRPLUGINMESSAGE;
     const struct BoltIPCPluginMessageHeader header = { .plugin_id = id, .window_id = window->id, .message_size = len };
-    _bolt_ipc_send(fd, &msg_type, sizeof(msg_type));
-    _bolt_ipc_send(fd, &header, sizeof(header));
-    _bolt_ipc_send(fd, str, len);
+    const struct BoltIPCBuffer buffers[] = {
+        {.data = &msg_type, .len = sizeof(msg_type)},
+        {.data = &header, .len = sizeof(header)},
+        {.data = str, .len = len},
+    };
+    _bolt_ipc_sendv(fd, buffers, sizeof(buffers) / sizeof(*buffers));
     return 0;
 }
 
@@ -2851,7 +6669,24 @@ static int api_embeddedbrowser_enablecapture(lua_State* state) {
         next_window_id += 1;
         window->do_capture = true;
         window->capture_ready = true;
+        window->capture.next_time = 0;
+        memset(&window->capture.tile_region, 0, sizeof(window->capture.tile_region));
     }
+    window->capture.interval_micros = opt_capture_interval(state);
+    return 0;
+}
+
+static int api_embeddedbrowser_setcaptureregion(lua_State* state) {
+    struct EmbeddedWindow* window = require_self_userdata(state, "setcaptureregion");
+    check_capture_region(state, &window->capture);
+    return 0;
+}
+
+static int api_embeddedbrowser_setcapturetiled(lua_State* state) {
+    struct EmbeddedWindow* window = require_self_userdata(state, "setcapturetiled");
+    const uint8_t tiled = lua_toboolean(state, 2);
+    if (tiled && !window->capture.tiled) memset(&window->capture.tile_region, 0, sizeof(window->capture.tile_region));
+    window->capture.tiled = tiled;
     return 0;
 }
 
@@ -2899,3 +6734,182 @@ static int api_buffer_writebuffer(lua_State* state) {
     memcpy((uint8_t*)buffer->data + offset, source->data, source->size);
     return 0;
 }
+
+static int api_buffer_readinteger(lua_State* state) {
+    const struct FixedBuffer* buffer = require_self_userdata(state, "readinteger");
+    const long offset = luaL_checklong(state, 2);
+    const int width = luaL_checkint(state, 3);
+    if (width < 1 || width > 8) {
+        lua_pushfstring(state, "readinteger: width must be between 1 and 8, got %d", width);
+        lua_error(state);
+    }
+    check_buffer_range(state, buffer, offset, width, "readinteger");
+    uint64_t value = 0;
+    for (size_t i = 0; i < width; i += 1) {
+        value |= (uint64_t)*((uint8_t*)buffer->data + offset + i) << (8 * i);
+    }
+    lua_pushinteger(state, (lua_Integer)value);
+    return 1;
+}
+
+static int api_buffer_readnumber(lua_State* state) {
+    const struct FixedBuffer* buffer = require_self_userdata(state, "readnumber");
+    const long offset = luaL_checklong(state, 2);
+    double value;
+    check_buffer_range(state, buffer, offset, sizeof(value), "readnumber");
+    memcpy(&value, (uint8_t*)buffer->data + offset, sizeof(value));
+    lua_pushnumber(state, value);
+    return 1;
+}
+
+static int api_buffer_readstring(lua_State* state) {
+    const struct FixedBuffer* buffer = require_self_userdata(state, "readstring");
+    const long offset = luaL_checklong(state, 2);
+    const long length = luaL_checklong(state, 3);
+    check_buffer_range(state, buffer, offset, length, "readstring");
+    lua_pushlstring(state, (const char*)buffer->data + offset, length);
+    return 1;
+}
+
+// element types that Buffer:view accepts, and the C type each one is read and written as
+static const struct {
+    const char* name;
+    const char* ctype;
+    size_t size;
+} buffer_view_types[] = {
+    {"int8", "int8_t", 1},
+    {"uint8", "uint8_t", 1},
+    {"int16", "int16_t", 2},
+    {"uint16", "uint16_t", 2},
+    {"int32", "int32_t", 4},
+    {"uint32", "uint32_t", 4},
+    {"float", "float", 4},
+    {"double", "double", 8},
+};
+
+static int api_buffer_view(lua_State* state) {
+    const struct FixedBuffer* buffer = require_self_userdata(state, "view");
+    const char* type = luaL_checkstring(state, 2);
+    size_t t = 0;
+    while (t < sizeof(buffer_view_types) / sizeof(*buffer_view_types) && strcmp(buffer_view_types[t].name, type)) t += 1;
+    if (t == sizeof(buffer_view_types) / sizeof(*buffer_view_types)) {
+        lua_pushfstring(state, "view: unknown element type '%s'", type);
+        lua_error(state);
+    }
+    const size_t element_size = buffer_view_types[t].size;
+    const long offset = luaL_optlong(state, 3, 0);
+    check_buffer_range(state, buffer, offset, 0, "view");
+    const long count = luaL_optlong(state, 4, (long)((buffer->size - offset) / element_size));
+    check_buffer_range(state, buffer, offset, count * (long)element_size, "view");
+
+    lua_getfield(state, LUA_REGISTRYINDEX, BUFFERVIEW_REGISTRYNAME);
+    if (!lua_isfunction(state, -1)) {
+        lua_pushliteral(state, "view: buffer views are not available");
+        lua_error(state);
+    }
+    lua_pushlightuserdata(state, (void*)buffer);
+    lua_pushvalue(state, 1);
+    lua_pushstring(state, buffer_view_types[t].ctype);
+    lua_pushinteger(state, offset);
+    lua_pushinteger(state, element_size);
+    lua_pushinteger(state, count);
+    lua_call(state, 6, 1);
+    return 1;
+}
+
+static int api_buffer_size(lua_State* state) {
+    const struct FixedBuffer* buffer = require_self_userdata(state, "size");
+    lua_pushinteger(state, buffer->size);
+    return 1;
+}
+
+// gets a worker from a Worker object, erroring if it's already been closed
+static struct Worker* require_worker(lua_State* state, const char* apiname) {
+    const uint64_t* worker_id = require_self_userdata(state, apiname);
+    lua_getfield(state, LUA_REGISTRYINDEX, PLUGIN_REGISTRYNAME);
+    const struct Plugin* plugin = lua_touserdata(state, -1);
+    lua_pop(state, 1);
+    struct Worker w = {.id = *worker_id};
+    struct Worker* wp = &w;
+    struct Worker* const* worker = hashmap_get(plugin->workers, &wp);
+    if (!worker || (*worker)->is_deleted) {
+        lua_pushfstring(state, "%s: this worker has been closed", apiname);
+        lua_error(state);
+    }
+    return *worker;
+}
+
+static int api_worker_sendmessage(lua_State* state) {
+    struct Worker* worker = require_worker(state, "sendmessage");
+    void* data;
+    size_t size;
+    take_message_data(state, 2, "sendmessage", &data, &size);
+    _bolt_plugin_thread_lock(&worker->thread);
+    const uint8_t ok = worker_queue_push(&worker->inbox_head, &worker->inbox_tail, data, size);
+    if (ok) _bolt_plugin_thread_notify(&worker->thread);
+    _bolt_plugin_thread_unlock(&worker->thread);
+    if (!ok) {
+        free(data);
+        lua_pushliteral(state, "sendmessage: heap error, failed to queue message");
+        lua_error(state);
+    }
+    return 0;
+}
+
+static int api_worker_onmessage(lua_State* state) {
+    const struct Worker* worker = require_worker(state, "onmessage");
+    luaL_checkany(state, 2);
+    lua_getfield(state, LUA_REGISTRYINDEX, WORKERS_REGISTRYNAME); /*stack: worker table*/
+    lua_pushinteger(state, worker->id); /*stack: worker table, worker id*/
+    lua_gettable(state, -2); /*stack: worker table, event table*/
+    lua_pushinteger(state, WORKER_ONMESSAGE); /*stack: worker table, event table, event id*/
+    if (lua_isfunction(state, 2)) {
+        lua_pushvalue(state, 2);
+    } else {
+        lua_pushnil(state);
+    } /*stack: worker table, event table, event id, value*/
+    lua_settable(state, -3); /*stack: worker table, event table*/
+    lua_pop(state, 2); /*stack: (empty)*/
+    return 0;
+}
+
+static int api_worker_close(lua_State* state) {
+    struct Worker* worker = require_worker(state, "close");
+    _bolt_worker_stop(worker);
+    worker->is_deleted = true;
+    lua_getfield(state, LUA_REGISTRYINDEX, WORKERS_REGISTRYNAME);
+    lua_pushinteger(state, worker->id);
+    lua_pushnil(state);
+    lua_settable(state, -3);
+    lua_pop(state, 1);
+    return 0;
+}
+
+static int api_inworker_sendmessage(lua_State* state) {
+    lua_getfield(state, LUA_REGISTRYINDEX, WORKER_REGISTRYNAME);
+    struct Worker* worker = lua_touserdata(state, -1);
+    lua_pop(state, 1);
+    void* data;
+    size_t size;
+    take_message_data(state, 1, "sendmessage", &data, &size);
+    _bolt_plugin_thread_lock(&worker->thread);
+    const uint8_t ok = worker_queue_push(&worker->outbox_head, &worker->outbox_tail, data, size);
+    _bolt_plugin_thread_unlock(&worker->thread);
+    if (!ok) {
+        free(data);
+        lua_pushliteral(state, "sendmessage: heap error, failed to queue message");
+        lua_error(state);
+    }
+    return 0;
+}
+
+static int api_inworker_onmessage(lua_State* state) {
+    luaL_checkany(state, 1);
+    if (lua_isfunction(state, 1)) {
+        lua_pushvalue(state, 1);
+    } else {
+        lua_pushnil(state);
+    }
+    lua_setfield(state, LUA_REGISTRYINDEX, WORKER_MESSAGE_CB_REGISTRYNAME);
+    return 0;
+}
@@ -49,6 +49,18 @@ struct Vertex2DFunctions {
 
     /// Returns the RGBA colour of this vertex, each one normalised from 0.0 to 1.0.
     void (*colour)(size_t index, void* userdata, double* out);
+
+    /// Bulk versions of the functions above, for decoding a whole range of vertices in one call.
+    /// Each one is called with the index of the first vertex, the number of vertices, the specified
+    /// userdata, an output pointer, and a stride. The values for each vertex are written to `out`
+    /// in the same order as above, then `out` is advanced by `stride` bytes for the next vertex.
+    /// `out` doesn't need to be aligned. xy, atlas_xy and atlas_wh write two int32_t each, uv writes
+    /// two floats, and colour writes four floats.
+    void (*xy_bulk)(size_t first, size_t count, void* userdata, void* out, size_t stride);
+    void (*atlas_xy_bulk)(size_t first, size_t count, void* userdata, void* out, size_t stride);
+    void (*atlas_wh_bulk)(size_t first, size_t count, void* userdata, void* out, size_t stride);
+    void (*uv_bulk)(size_t first, size_t count, void* userdata, void* out, size_t stride);
+    void (*colour_bulk)(size_t first, size_t count, void* userdata, void* out, size_t stride);
 };
 
 /// Struct containing "vtable" callback information for Render3D's list of vertices.
@@ -81,6 +93,21 @@ struct Vertex3DFunctions {
 
     /// Returns the transform matrix for the given bone.
     void (*bone_transform)(uint8_t bone_id, void* userdata, struct Transform3D* out);
+
+    /// Returns every bone transform for this render in the game's packed layout, i.e. twelve floats
+    /// per bone, one XYZ column after another, with the fourth row implied to be (0, 0, 0, 1). The
+    /// number of bones is written to bone_count. Returns NULL if the model isn't animated. The
+    /// pointer is only valid until the end of the callback.
+    const float* (*bone_palette)(void* userdata, size_t* bone_count);
+
+    /// Bulk versions of the per-vertex functions above, with the same calling convention as the
+    /// ones in Vertex2DFunctions. xyz writes three floats, atlas_meta writes one uint32_t, uv writes
+    /// two floats, colour writes four floats, and bone_id writes one uint32_t.
+    void (*xyz_bulk)(size_t first, size_t count, void* userdata, void* out, size_t stride);
+    void (*atlas_meta_bulk)(size_t first, size_t count, void* userdata, void* out, size_t stride);
+    void (*uv_bulk)(size_t first, size_t count, void* userdata, void* out, size_t stride);
+    void (*colour_bulk)(size_t first, size_t count, void* userdata, void* out, size_t stride);
+    void (*bone_id_bulk)(size_t first, size_t count, void* userdata, void* out, size_t stride);
 };
 
 /// Struct containing "vtable" callback information for textures.
@@ -102,9 +129,16 @@ struct TextureFunctions {
     /// the texture for some images and therefore change the result of this comparison.
     uint8_t (*compare)(void* userdata, size_t x, size_t y, size_t len, const unsigned char* data);
 
-    /// Fetches a pointer to the texture's pixel data at coordinates x and y. Doesn't do any checks
-    /// on whether x and y are in-bounds. Data is always RGBA and pixel rows are always contiguous.
-    uint8_t* (*data)(void* userdata, size_t x, size_t y);
+    /// Fetches a pointer to the texture's pixel data at coordinates x and y, of which `len` bytes are
+    /// going to be read. Doesn't do any checks on whether x and y are in-bounds. Data is always RGBA
+    /// and pixel rows are always contiguous. Returns NULL if the pixel data isn't available.
+    uint8_t* (*data)(void* userdata, size_t x, size_t y, size_t len);
+
+    /// Gets a hash of the w*h rectangle at x,y of this texture, writing it to `out`. If `perceptual`
+    /// is false, this is a hash of the exact contents, otherwise it's an "average hash" of the image's
+    /// brightness, which usually stays the same when the image is re-encoded. Hashes are cached, so
+    /// asking for the same rectangle again is cheap. Returns false if no hash is available.
+    uint8_t (*hash)(void* userdata, size_t x, size_t y, size_t w, size_t h, uint8_t perceptual, uint64_t* out);
 };
 
 /// Struct containing "vtable" callback information for 3D renders' transformation matrices.
@@ -120,6 +154,22 @@ struct Render3DMatrixFunctions {
 };
 
 /// Struct containing "vtable" callback information for surfaces.
+#define SHARED_TEXTURE_MAX_PLANES 4
+
+/// A texture belonging to another process, which the backend can copy from without the pixels going
+/// through the CPU. On Windows it's a shared NT handle, otherwise it's a dmabuf with one fd per plane.
+struct SharedTexture {
+    int width;
+    int height;
+    uint32_t format; // DRM fourcc code
+    uint64_t modifier; // DRM format modifier
+    uint32_t plane_count;
+    int fds[SHARED_TEXTURE_MAX_PLANES];
+    uint32_t strides[SHARED_TEXTURE_MAX_PLANES];
+    uint64_t offsets[SHARED_TEXTURE_MAX_PLANES];
+    void* handle;
+};
+
 struct SurfaceFunctions {
     /// Userdata which will be passed to the functions contained in this struct.
     void* userdata;
@@ -127,8 +177,10 @@ struct SurfaceFunctions {
     /// Equivalent to glClearColor(r, g, b, a) & glClear().
     void (*clear)(void* userdata, double r, double g, double b, double a);
 
-    /// Updates a rectangular subsection of the surface with the given RGBA or BGRA pixels.
-    void (*subimage)(void* userdata, int x, int y, int w, int h, const void* pixels, uint8_t is_bgra);
+    /// Updates a rectangular subsection of the surface with the given RGBA or BGRA pixels. `pixels` points
+    /// to the rectangle's top-left pixel, and each row starts `stride` bytes after the last, or straight
+    /// after it if stride is 0, so a rectangle can be uploaded from the middle of a bigger image.
+    void (*subimage)(void* userdata, int x, int y, int w, int h, const void* pixels, size_t stride, uint8_t is_bgra);
 
     /// Draws a rectangle from the surface, indicated by sx,sy,sw,sh, to a rectangle on the backbuffer,
     /// indicated by dx,dy,dw,dh. All values are in pixels.
@@ -137,6 +189,40 @@ struct SurfaceFunctions {
     /// Draws a rectangle from the surface, indicated by sx,sy,sw,sh, to a rectangle on the target surface,
     /// indicated by dx,dy,dw,dh. All values are in pixels.
     void (*draw_to_surface)(void* userdata, void* target, int sx, int sy, int sw, int sh, int dx, int dy, int dw, int dh);
+
+    /// Copies a shared texture into the top-left of the surface, clipped to the surface's size. The
+    /// texture's handles are only borrowed. Returns false if the texture couldn't be imported.
+    uint8_t (*copy_shared_texture)(void* userdata, const struct SharedTexture* texture);
+};
+
+/// A rectangle of the game window to capture, and an integer factor to shrink it by. Coordinates are
+/// in pixels from the bottom-left corner, as with glReadPixels. The captured image will be
+/// (width / scale) by (height / scale) pixels of tightly-packed RGB, starting with the bottom row.
+struct CaptureRegion {
+    int x;
+    int y;
+    int width;
+    int height;
+    int scale;
+};
+
+/// Size of the bitmap of dirty tiles kept for each browser with tiled capture enabled. One bit per
+/// BOLT_CAPTURE_TILE_SIZE tile is enough for an 8K capture; larger ones are always sent whole.
+#define CAPTURE_TILE_BITMAP_SIZE 1024
+
+/// Capture settings requested by a plugin for one of its browsers.
+struct CaptureRequest {
+    uint64_t interval_micros;
+    uint64_t next_time;
+    int x; // x, y, width and height are relative to the top-left of the window; zero size means the whole window
+    int y;
+    int width;
+    int height;
+    int scale;
+    size_t region_index; // index of this browser's region in the current frame's list of regions to capture
+    uint8_t tiled; // only send the tiles that have changed since the last capture this browser was sent
+    struct CaptureRegion tile_region; // the region that dirty_tiles refers to; all zero if it needs a full capture
+    uint8_t dirty_tiles[CAPTURE_TILE_BITMAP_SIZE]; // tiles that changed since this browser's last capture
 };
 
 /// Struct containing functions initiated by plugin code, which must be set on startup, as opposed to
@@ -146,32 +232,55 @@ struct PluginManagedFunctions {
     void (*surface_destroy)(void*);
     void (*surface_resize_and_clear)(void*, unsigned int, unsigned int);
     void (*draw_region_outline)(void* target, int16_t x, int16_t y, uint16_t width, uint16_t height);
-    void (*read_screen_pixels)(uint32_t width, uint32_t height, void* data);
+    /// Starts reading some regions of the screen into a buffer on the GPU without waiting for the result.
+    /// Regions with a scale above 1 are shrunk on the GPU first. Returns false if too many reads are
+    /// already in flight.
+    uint8_t (*read_screen_pixels_start)(const struct CaptureRegion* regions, size_t count);
+    /// Copies the newest finished read into `data` and returns true, if it was started with exactly the
+    /// same regions, otherwise returns false. Never blocks. Regions are written one after the other in
+    /// the order they were given. Discards all reads in flight if `data` is NULL.
+    uint8_t (*read_screen_pixels_finish)(const struct CaptureRegion* regions, size_t count, void* data);
     void (*game_view_rect)(int* x, int* y, int* w, int* h);
+    /// Returns true if copy_shared_texture can be expected to work on surfaces.
+    uint8_t (*shared_texture_supported)(void);
+    /// Does any surface draws to the screen that have been batched up since the last call. Called at the
+    /// end of every frame, after the overlay has been drawn, so that they're all on screen before it's swapped.
+    void (*flush_screen_draws)(void);
 };
 
-struct WindowPendingInput {
-    /* bools are listed at the top to make the structure smaller by having less padding in it */
-    uint8_t mouse_motion;
-    uint8_t mouse_leave;
-    uint8_t mouse_left;
-    uint8_t mouse_right;
-    uint8_t mouse_middle;
-    uint8_t mouse_left_up;
-    uint8_t mouse_right_up;
-    uint8_t mouse_middle_up;
-    uint8_t mouse_scroll_down;
-    uint8_t mouse_scroll_up;
-    struct MouseEvent mouse_motion_event;
-    struct MouseEvent mouse_leave_event;
-    struct MouseEvent mouse_left_event;
-    struct MouseEvent mouse_right_event;
-    struct MouseEvent mouse_middle_event;
-    struct MouseEvent mouse_left_up_event;
-    struct MouseEvent mouse_right_up_event;
-    struct MouseEvent mouse_middle_up_event;
-    struct MouseEvent mouse_scroll_down_event;
-    struct MouseEvent mouse_scroll_up_event;
+/* values for the input_type params of _bolt_plugin_handle_mouse_event and _bolt_plugin_input_post */
+#define INPUT_MOUSE_MOTION 0
+#define INPUT_MOUSE_LEAVE 1
+#define INPUT_MOUSE_LEFT 2
+#define INPUT_MOUSE_RIGHT 3
+#define INPUT_MOUSE_MIDDLE 4
+#define INPUT_MOUSE_LEFT_UP 5
+#define INPUT_MOUSE_RIGHT_UP 6
+#define INPUT_MOUSE_MIDDLE_UP 7
+#define INPUT_MOUSE_SCROLL_UP 8
+#define INPUT_MOUSE_SCROLL_DOWN 9
+
+#define INPUT_MAILBOX_CAPACITY 64
+
+/// Mouse inputs waiting to be handled on the next frame. Written to by whichever thread receives
+/// window events and drained by the render thread, all without locking. Every field holds a
+/// MouseEvent packed into a uint64_t along with a sequence number taken from `sequence` when it was
+/// posted, with 0 meaning "nothing here".
+///
+/// Motion and mouseleave only keep the newest value, since nothing cares about the ones in between.
+/// Button and scroll events go into `queue` in the order they happened, and any pending motion is
+/// moved into the queue ahead of them, so that handlers see where the mouse was when it was clicked.
+/// `head` is claimed by producers with a compare-exchange, and `tail` is only ever moved by the
+/// render thread once it has taken the event out of that slot. If the queue is full, any more button
+/// or scroll events are dropped until the next frame. Draining sorts everything by sequence number,
+/// so events are handled in the order they were posted even if producers raced for queue slots.
+struct InputMailbox {
+    uint64_t motion;
+    uint64_t leave;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t sequence;
+    uint64_t queue[INPUT_MAILBOX_CAPACITY];
 };
 
 struct BoltSHM {
@@ -187,6 +296,22 @@ struct BoltSHM {
     void* file;
 };
 
+/// A thread, along with a lock and a condition variable for handing work to and from it.
+struct BoltThread {
+#if defined(_WIN32)
+    HANDLE handle;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+#else
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t finished; // set under `lock` once `func` has returned, for _bolt_plugin_thread_join_timeout
+#endif
+    void (*func)(void*);
+    void* userdata;
+};
+
 struct EmbeddedWindowMetadata {
     int x;
     int y;
@@ -201,8 +326,7 @@ struct EmbeddedWindow {
     struct lua_State* plugin;
     RWLock lock; // applies to the metadata
     struct EmbeddedWindowMetadata metadata;
-    RWLock input_lock; // applies to the pending inputs
-    struct WindowPendingInput input;
+    struct InputMailbox input;
     int16_t drag_xstart;
     int16_t drag_ystart;
     int16_t repos_target_x;
@@ -222,16 +346,38 @@ struct EmbeddedWindow {
     uint8_t popup_shown; // always false for non-browser
     uint8_t popup_initialised;
     uint64_t capture_id;
+    struct CaptureRequest capture;
     struct BoltSHM browser_shm;
+    struct BoltSHM popup_shm;
     struct EmbeddedWindowMetadata popup_meta;
     struct SurfaceFunctions popup_surface_functions;
 };
 
+/// Lookup structure for finding which embedded window is at a given point, built from where every
+/// window was actually drawn on the last frame. The screen is split into a grid of square cells,
+/// and each cell lists the windows that overlap it, topmost first, so a lookup only has to look at
+/// the handful of windows in one cell.
+struct WindowHitIndex {
+    size_t count;
+    size_t capacity;
+    struct EmbeddedWindow** windows; // in draw order, bottom first
+    struct EmbeddedWindowMetadata* rects; // where each of `windows` was drawn
+    uint32_t columns;
+    uint32_t rows;
+    uint32_t* cell_start; // `columns * rows + 1` offsets into cell_items
+    uint32_t* cell_items; // indices into `windows`
+    size_t cell_capacity;
+    size_t item_capacity;
+};
+
 struct WindowInfo {
-    RWLock lock; // applies to the map
+    RWLock lock; // applies to the map, the order and the hit index
     struct hashmap* map;
-    RWLock input_lock; // applies to the pending inputs
-    struct WindowPendingInput input;
+    struct EmbeddedWindow** order; // every window in the map, in the order they get drawn, bottom first
+    size_t order_count;
+    size_t order_capacity;
+    struct WindowHitIndex hit_index;
+    struct InputMailbox input; // inputs for the game window itself
 };
 
 struct RenderBatch2D {
@@ -293,20 +439,36 @@ void _bolt_plugin_close();
 /// Gets a reference to the global WindowInfo struct
 struct WindowInfo* _bolt_plugin_windowinfo();
 
-/// Handle all incoming IPC messages.
+/// Handle incoming IPC messages that have already been fully received by the IPC thread, without
+/// ever waiting on the socket. Stops early once the per-frame time budget is used up, leaving the
+/// rest for the next call.
 void _bolt_plugin_handle_messages();
 
-/// Creates a new instance of a plugin with its own Lua environment (lua_setfenv).
-/// The `lua` param will be loaded and executed in a fresh environment, then event callbacks will be
-/// sent to it until it is destroyed by the plugin being stopped.
+/// Sets up a new plugin's Lua state and loads its main file onto the stack, going through the
+/// bytecode cache. This doesn't touch anything outside of the plugin, so it's safe to call from
+/// any thread, and is normally done on the loader thread. Returns 1 on success or 0 on failure.
+uint8_t _bolt_plugin_prepare(const char* path, struct Plugin* plugin);
+
+/// Starts a plugin that's been set up by _bolt_plugin_prepare, adding it to the plugin list and
+/// running its main file, after which event callbacks will be sent to it until it is destroyed by
+/// the plugin being stopped. Must be called on the render thread.
 ///
-/// Returns 0 on success or 1 on failure.
-uint8_t _bolt_plugin_add(const char* path, struct Plugin* plugin);
+/// Returns 1 on success or 0 on failure.
+uint8_t _bolt_plugin_add(struct Plugin* plugin);
 
 /// Handles any mouse event, returning true if the event was consumed or false if the event should
-/// be passed to the game window. Offsets are into the WindowPendingInput struct. grab_type will be
-/// one of the GRAB_TYPE_ defined values. Booleans are write-only and may be NULL.
-uint8_t _bolt_plugin_handle_mouse_event(struct MouseEvent* event, ptrdiff_t bool_offset, ptrdiff_t event_offset, uint8_t grab_type, uint8_t* mousein_fake, uint8_t* mousein_real);
+/// be passed to the game window. input_type will be one of the INPUT_MOUSE_ defined values, and
+/// grab_type will be one of the GRAB_TYPE_ defined values. Booleans are write-only and may be NULL.
+uint8_t _bolt_plugin_handle_mouse_event(struct MouseEvent* event, uint8_t input_type, uint8_t grab_type, uint8_t* mousein_fake, uint8_t* mousein_real);
+
+/// Adds an input to a mailbox, to be handled on the next frame. input_type will be one of the
+/// INPUT_MOUSE_ defined values. Never blocks, and can be called from any thread.
+void _bolt_plugin_input_post(struct InputMailbox* mailbox, uint8_t input_type, const struct MouseEvent* event);
+
+/// Returns the topmost embedded window at this point in the game view, or NULL if there isn't one,
+/// going by where they were drawn on the last frame. If `rect` isn't NULL, the window's position and
+/// size are written to it. The caller must hold the WindowInfo's lock for reading.
+struct EmbeddedWindow* _bolt_plugin_window_at(int x, int y, struct EmbeddedWindowMetadata* rect);
 
 /// Returns the ID of the last window to receive an event, or 0 for the game window.
 uint64_t _bolt_plugin_get_last_mouseevent_windowid();
@@ -337,6 +499,111 @@ void _bolt_plugin_shm_resize(struct BoltSHM* shm, size_t length, uint64_t new_id
 /// HANDLE object, created by the host using DuplicateHandle, and is unused on non-Windows systems.
 void _bolt_plugin_shm_remap(struct BoltSHM* shm, size_t length, void* handle);
 
+/// Opens an SHM object shared by every game client of the same host, named using `owner` (the host's
+/// pid) in place of this process's pid, along with the tag and ID. If it doesn't exist yet, it's
+/// created with the given size and mapped read-write, and `created` is set, after which the caller
+/// should fill it in and call _bolt_plugin_shm_seal. Otherwise it's mapped read-only. Returns 0 on
+/// failure, including if the existing object is too small. Close it with _bolt_plugin_shm_close,
+/// which never deletes it: on POSIX the host does that, and on Windows it goes away by itself once no
+/// process has it open.
+uint8_t _bolt_plugin_shm_open_shared(struct BoltSHM* shm, size_t size, const char* tag, int owner, uint64_t id, uint8_t* created);
+
+/// Makes an SHM object created by _bolt_plugin_shm_open_shared read-only for this process too.
+void _bolt_plugin_shm_seal(struct BoltSHM* shm);
+
+/// Initialises the thread's lock and condition variable, then starts a new thread which will call
+/// `func(userdata)` and exit when it returns. Returns 0 on failure, in which case nothing needs to
+/// be cleaned up.
+uint8_t _bolt_plugin_thread_start(struct BoltThread* thread, void (*func)(void*), void* userdata);
+
+/// Waits for the thread to exit, then destroys its lock and condition variable.
+void _bolt_plugin_thread_join(struct BoltThread* thread);
+
+/// Like _bolt_plugin_thread_join, but gives up after roughly `millis` milliseconds. Returns 1 if the thread
+/// exited and was cleaned up. Otherwise returns 0 and detaches it, so it keeps running with nothing left
+/// to join it, and its BoltThread, lock and userdata must never be freed.
+uint8_t _bolt_plugin_thread_join_timeout(struct BoltThread* thread, uint32_t millis);
+
+/// Locks the thread's lock. Not recursive.
+void _bolt_plugin_thread_lock(struct BoltThread* thread);
+
+/// Unlocks the thread's lock.
+void _bolt_plugin_thread_unlock(struct BoltThread* thread);
+
+/// Waits for _bolt_plugin_thread_notify to be called. The lock must be held when calling this,
+/// and will be held again when this returns. Spurious wakeups are possible, so the caller must
+/// check whatever it was waiting for in a loop.
+void _bolt_plugin_thread_wait(struct BoltThread* thread);
+
+/// Wakes up anything waiting in _bolt_plugin_thread_wait.
+void _bolt_plugin_thread_notify(struct BoltThread* thread);
+
+/// Gets the directory plugins' compiled bytecode is cached in, creating it if it doesn't exist yet,
+/// and writes it to `buf` including a trailing path separator. Returns 0 on failure.
+uint8_t _bolt_plugin_cache_dir(char* buf, size_t size);
+
+/// Gets the last-modified time of a file, in units that are only meaningful for comparing with
+/// another value from this function. Returns 0 on failure.
+uint8_t _bolt_plugin_file_mtime(const char* path, int64_t* mtime);
+
+/// Renames `from` to `to`, atomically replacing `to` if it already exists. On failure, `from` is
+/// deleted and 0 is returned.
+uint8_t _bolt_plugin_file_replace(const char* from, const char* to);
+
+/// Maps a whole file into memory copy-on-write, so it can be written to without affecting the file,
+/// and returns it, or NULL on failure or if the file is empty. The file must not be truncated while
+/// it's mapped. Must be unmapped with _bolt_plugin_file_unmap.
+void* _bolt_plugin_file_map(const char* path, size_t* size);
+
+/// Unmaps a file mapped by _bolt_plugin_file_map.
+void _bolt_plugin_file_unmap(void* data, size_t size);
+
+/// Start of each object in the texture cache shared between game clients, immediately followed by a
+/// compressed texture's decoded RGBA pixels. `ready` is set, atomically, once all the pixels have been
+/// written; until then, other clients that find the object decode the texture themselves rather than
+/// waiting for it.
+struct BoltTextureCacheHeader {
+    uint32_t ready;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint64_t content_hash;
+    uint8_t pad[40]; // keeps the pixels 64-byte aligned
+};
+
+/// Finds the shared texture cache object holding the decoded pixels of a compressed texture, by a hash
+/// of its compressed contents, or creates it if there isn't one yet. Returns NULL if that fails, if
+/// another client is still decoding the same texture, or if the cache isn't in use, which is the case
+/// unless the host offered one and the BOLT_SHARED_TEXTURE_CACHE environment variable is set.
+///
+/// Otherwise returns a pointer to width*height*4 bytes of pixels. If `created` is set, the pixels are
+/// writable and the caller must fill in all of them then call _bolt_plugin_texcache_publish, otherwise
+/// they're read-only and already complete. Either way, close it with _bolt_plugin_shm_close.
+uint8_t* _bolt_plugin_texcache_open(struct BoltSHM* shm, uint64_t content_hash, uint32_t width, uint32_t height, uint32_t format, uint8_t* created);
+
+/// Marks an object created by _bolt_plugin_texcache_open as complete, making it available to other
+/// clients, and tells the host about it so that it can be deleted once every client has gone.
+void _bolt_plugin_texcache_publish(struct BoltSHM* shm);
+
+/// Expands one bone from a packed palette, as returned by Vertex3DFunctions.bone_palette, into a
+/// full transform matrix.
+void _bolt_plugin_bone_transform_from_palette(const float* palette, uint8_t bone_id, struct Transform3D* out);
+
+/* bitmask values for _bolt_plugin_callback_interest */
+#define PLUGIN_CALLBACK_SWAPBUFFERS (1 << 0)
+#define PLUGIN_CALLBACK_BATCH2D (1 << 1)
+#define PLUGIN_CALLBACK_RENDER3D (1 << 2)
+#define PLUGIN_CALLBACK_MINIMAP (1 << 3)
+#define PLUGIN_CALLBACK_MOUSEMOTION (1 << 4)
+#define PLUGIN_CALLBACK_MOUSEBUTTON (1 << 5)
+#define PLUGIN_CALLBACK_MOUSEBUTTONUP (1 << 6)
+#define PLUGIN_CALLBACK_SCROLL (1 << 7)
+
+/// Returns a bitmask of PLUGIN_CALLBACK_* values, indicating which event callbacks are currently set
+/// by at least one running plugin. Backends should check this before doing any work to produce an
+/// event, since the corresponding _bolt_plugin_handle_* function will do nothing if its bit is not set.
+uint32_t _bolt_plugin_callback_interest();
+
 /// Sends a RenderBatch2D to all plugins.
 void _bolt_plugin_handle_render2d(struct RenderBatch2D*);
 
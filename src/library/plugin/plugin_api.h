@@ -121,6 +121,30 @@ static int api_loadconfig(lua_State*);
 /// exists and is locked for writing, such as by the user having it open in a text editor.
 static int api_saveconfig(lua_State*);
 
+/// [-2, +0, -]
+/// Asynchronous version of loadfile. Reading the file happens on a separate thread, so this returns
+/// straight away, and the function in the second parameter will be called at the end of a later
+/// frame with the file's contents as a Buffer, or nil if it couldn't be read. Large files may be
+/// memory-mapped rather than copied into the Buffer, which makes no difference to the plugin.
+static int api_loadfileasync(lua_State*);
+
+/// [-2, +0, -]
+/// Asynchronous version of loadconfig. The function in the second parameter will be called at the
+/// end of a later frame with the file's contents as a Buffer, or nil if it couldn't be read.
+static int api_loadconfigasync(lua_State*);
+
+/// [-2|3, +0, -]
+/// Asynchronous version of saveconfig. The contents are copied, so the string or Buffer can be
+/// reused as soon as this returns, and the file is written on a separate thread. If a function is
+/// given as the third parameter, it will be called at the end of a later frame with a boolean saying
+/// whether the file was saved successfully.
+///
+/// Saving the same file again before an earlier save has been written will replace the contents of
+/// that save, rather than writing the file twice. Files are written to a temporary file first and
+/// then moved into place, so a file will never be left half-written. Any saves still waiting when
+/// the game closes will be finished before it exits.
+static int api_saveconfigasync(lua_State*);
+
 /// [-2, +1, -]
 /// Creates a surface with the given width and height, and returns it as a userdata object. The
 /// surface will initially be fully transparent.
@@ -156,9 +180,22 @@ static int api_createsurfacefromrgba(lua_State*);
 ///
 /// As with `createsurface`, the width and height of your PNG file should be integral powers of 2.
 ///
-/// Loading PNG files is slow, so use this function sparingly.
+/// Decoded images are cached in memory and shared between all plugins, so loading the same file
+/// again is cheap as long as the file hasn't changed since. Loading a PNG file for the first time is
+/// slow, though, so consider using `createsurfacefrompngasync` when loading a lot of them.
 static int api_createsurfacefrompng(lua_State*);
 
+/// [-2, +0, -]
+/// Asynchronous version of `createsurfacefrompng`. The path is interpreted the same way, and the
+/// file is decoded on a separate thread, so this returns straight away. The function in the second
+/// parameter will be called at the end of a later frame with the same values `createsurfacefrompng`
+/// would have returned, or with nil and an error message if the file couldn't be loaded. Unlike
+/// `createsurfacefrompng`, this function doesn't call `error()` for a missing or invalid file.
+///
+/// This shares the same cache of decoded images as `createsurfacefrompng`, and multiple requests
+/// for the same file at once will only decode it once.
+static int api_createsurfacefrompngasync(lua_State*);
+
 /// [-4, +1, -]
 /// Creates an embedded window with the given initial values for x, y, width, height. The x and y
 /// relate to the top-left corner of the window. An embedded window's top, left, bottom and right
@@ -211,6 +248,40 @@ static int api_point(lua_State*);
 /// "api_buffer_".
 static int api_createbuffer(lua_State*);
 
+/// [-1, +1, -]
+/// Starts a worker, which runs the given Lua file on a separate thread, so that it can do things
+/// that take a long time without holding up the game. The file path is relative to the root
+/// directory of this plugin, and must use "/" as file separators (if any).
+///
+/// The worker has its own Lua environment, completely separate from the plugin's, and can't see any
+/// of the plugin's variables. Calling `require("bolt")` in a worker gives a much smaller API, which
+/// has apiversion, checkversion, time, datetime, weekday and createbuffer, plus the two functions
+/// in this file prefixed with "api_inworker_". The worker's file is run once, and should set an
+/// onmessage handler; after that, the worker waits for messages to arrive.
+///
+/// Workers and the plugin communicate only by sending each other messages, which can be strings or
+/// buffers. Sending a buffer hands its memory over to the receiver without copying it, so the
+/// buffer will be empty (size 0) on the sending side afterwards. Messages from a worker are received
+/// once per frame, just before the plugin's onswapbuffers callback.
+///
+/// If an error occurs in a worker, the plugin will be stopped, the same as if the error had happened
+/// in the plugin itself. All the plugin's workers are stopped when the plugin stops.
+///
+/// All of the member functions of Worker objects can be found in this file, prefixed with
+/// "api_worker_".
+static int api_createworker(lua_State*);
+
+/// [-(0|1), +0, -]
+/// Sets a time budget, in microseconds, for how long this plugin's callbacks may take in total
+/// during one frame. Passing nothing, `nil` or 0 removes the budget, which is the default.
+///
+/// Going over budget logs a warning the first time it happens. If it then keeps happening for
+/// several frames in a row, the plugin will be throttled: once it's over budget in a frame, none of
+/// its callbacks other than onswapbuffers will be called for the rest of that frame. This lasts
+/// until it gets through a whole frame within its budget. Callback timings are also shown in the
+/// launcher, whether or not a budget has been set.
+static int api_setframebudget(lua_State*);
+
 /// [-1, +0, -]
 /// Sets a callback function for SwapBuffers events, overwriting the previous callback, if any.
 /// Passing a non-function (ideally `nil`) will restore the default setting, which is to have no
@@ -232,7 +303,8 @@ static int api_onswapbuffers(lua_State*);
 /// Each time a batch of 2D images is rendered, the callback will be called with one param, that
 /// being a 2D batch object. All of the member functions of 2D batch objects can be found in this
 /// file, prefixed with with "api_batch2d_". The batch object and everything contained by it will
-/// become invalid as soon as the callback ends, so do not retain them.
+/// become invalid as soon as the callback ends, so do not retain them. The same object is reused
+/// for every call, and calling its functions outside of the callback is an error.
 ///
 /// The callback will be called an extremely high amount of times per second, so great care should
 /// be taken to determine as quickly as possible whether any image is of interest or not, such as
@@ -247,7 +319,8 @@ static int api_onrender2d(lua_State*);
 /// Each time a 3D model is rendered, the callback will be called with one param, that being a 3D
 /// render object. All of the member functions of 3D render objects can be found in this file,
 /// prefixed with "api_render3d". The object and everything contained by it will become invalid as
-/// soon as the callback ends, so do not retain them.
+/// soon as the callback ends, so do not retain them. The same object is reused for every call, and
+/// calling its functions outside of the callback is an error.
 ///
 /// The callback will be called an extremely high amount of times per second, so great care should
 /// be taken to determine as quickly as possible whether any image is of interest or not, such as
@@ -265,7 +338,8 @@ static int api_onrender3d(lua_State*);
 /// expect to get a maximum of one minimap event per frame (i.e. between each SwapBuffers event.)
 ///
 /// The callback will be called with one param, that being a minimap render object. All of the
-/// member functions of that object can be found in this file, prefixed with "api_minimap_".
+/// member functions of that object can be found in this file, prefixed with "api_minimap_". As
+/// with render2d and render3d objects, it must not be used after the callback ends.
 ///
 /// The pixel contents cannot be examined directly, however it's possible to query the image angle,
 /// image scale (zoom level), and a rough estimate of the tile position it's centered on.
@@ -368,6 +442,27 @@ static int api_batch2d_vertexatlasxy(lua_State*);
 /// the batch's texture atlas, in pixel coordinates.
 static int api_batch2d_vertexatlaswh(lua_State*);
 
+/// [-2, +1, -]
+/// Given an index of a vertex in a batch, returns a hash of the contents of its associated image
+/// in the batch's texture atlas, as a 16-character string, or nil if it isn't available.
+///
+/// This is a much faster way of identifying an image than `texturecompare()`: find the hash of
+/// the image once, then keep a table mapping known hashes to whatever they mean, and look up the
+/// hash in that table. Hashes are remembered when the game uploads an image, and calculated and
+/// remembered on first use otherwise, so asking for a hash is almost always just a lookup.
+///
+/// Like `texturecompare()`, this depends on the exact bytes of the texture, so the hash of an
+/// image may be different depending on the in-game "texture compression" setting. For something
+/// that doesn't depend on that, see `vertexatlasphash()`.
+static int api_batch2d_vertexatlashash(lua_State*);
+
+/// [-2, +1, -]
+/// Same as `vertexatlashash()`, but returns a perceptual hash, which is based on the relative
+/// brightness of different parts of the image. This is much more likely to stay the same if the
+/// image is re-encoded, e.g. by changing the in-game "texture compression" setting, but is also
+/// more likely to be the same for two different images, especially small or plain ones.
+static int api_batch2d_vertexatlasphash(lua_State*);
+
 /// [-2, +2, -]
 /// Given an index of a vertex in a batch, returns the vertex's associated "UV" coordinates.
 ///
@@ -382,6 +477,21 @@ static int api_batch2d_vertexuv(lua_State*);
 /// Also aliased as "vertexcolor" to keep the Americans happy.
 static int api_batch2d_vertexcolour(lua_State*);
 
+/// [-(3|4|5), +(0|1), -]
+/// Decodes a range of vertices in one call, which is much faster than calling the per-vertex
+/// functions above in a loop. Takes the index of the first vertex and the number of vertices.
+///
+/// Each vertex is a record of twelve 4-byte values, in this order: X and Y in screen coordinates,
+/// then atlas X, Y, width and height in pixel coordinates, all as 32-bit ints; then U and V, then
+/// red, green, blue and alpha, all as 32-bit floats. These are the same values as would be
+/// returned by vertexxy, vertexatlasxy, vertexatlaswh, vertexuv and vertexcolour.
+///
+/// If a Buffer object is passed as the third param, the records will be written into it, packed
+/// and little-endian, starting at the byte offset given by the optional fourth param (default 0).
+/// Each record is 48 bytes long, and it is a fatal error if the Buffer isn't big enough. Otherwise,
+/// returns a table containing every value of every record, i.e. `count * 12` numbers.
+static int api_batch2d_vertices(lua_State*);
+
 /// [-1, +1, -]
 /// Returns the unique ID of the texture associated with this render. There will always be one (and
 /// only one) texture associated with a 2D render batch. These textures are "atlased", meaning they
@@ -410,7 +520,7 @@ static int api_batch2d_texturesize(lua_State*);
 /// but can only be done one row at a time.
 static int api_batch2d_texturecompare(lua_State*);
 
-/// [-4, +1, -]
+/// [-(4|5|6), +1, -]
 /// Gets the RGBA data starting at a given coordinate of the texture atlas, for example:
 ///
 /// `batch:texturedata(64, 128, 8)`
@@ -420,8 +530,30 @@ static int api_batch2d_texturecompare(lua_State*);
 ///
 /// Encoding Lua strings is computationally expensive, and indexing the data one byte at a time is
 /// even more so. Unless you really need to do that, use `texturecompare()` instead.
+///
+/// Alternatively, a buffer and an optional offset into it (default 0) can be passed after the
+/// length, in which case the data is copied into the buffer at that offset and the function returns
+/// true, or false if the data isn't available. The data can then be read quickly with a "uint8"
+/// view of the buffer, see `buffer:view()`.
 static int api_batch2d_texturedata(lua_State*);
 
+/// [-1, +1, m]
+/// Copies everything about this batch into a new batch object, which remains valid after the
+/// callback has returned, so it can be kept and looked at later. The copy has all of the same
+/// functions as this batch, and they'll return the same values, except for `texturecompare()`,
+/// which always returns false, and `texturedata()`, `vertexatlashash()` and `vertexatlasphash()`,
+/// which always return nil, since the texture's pixels aren't copied. Do any texture comparisons
+/// before taking the snapshot.
+///
+/// Snapshots are immutable and don't depend on anything in the game, so there's no need to do
+/// anything with them when finished other than let them be garbage-collected. To process a
+/// snapshot in a worker, use `vertices()` to write its vertices into a buffer and send that.
+///
+/// This is much faster than calling the per-vertex functions for every vertex, but still uses
+/// 48 bytes of memory per vertex, so it's best to only take snapshots of batches which are
+/// definitely of interest.
+static int api_batch2d_snapshot(lua_State*);
+
 /// [-1, +1, -]
 /// Returns the angle at which the minimap background image is being rendered, in radians.
 /// 
@@ -470,6 +602,11 @@ static int api_surface_subimage(lua_State*);
 /// Draws a section of the surface directly onto the screen.
 ///
 /// Paramaters are source X,Y,W,H followed by destination X,Y,W,H, all in pixels.
+///
+/// Draws to the screen are queued up and done together in as few draw calls as possible, either
+/// at the end of the frame or before anything next changes the contents of a surface, whichever
+/// comes first. The result is exactly the same as if they'd been drawn immediately, in order.
+/// This makes drawing many small things, like icons, far cheaper than it would otherwise be.
 static int api_surface_drawtoscreen(lua_State*);
 
 /// [-10, +0, -]
@@ -629,6 +766,17 @@ static int api_render3d_vertexmeta(lua_State*);
 /// texture atlas, in pixel coordinates.
 static int api_render3d_atlasxywh(lua_State*);
 
+/// [-2, +1, -]
+/// Given an image meta-ID from this render, returns a hash of the contents of its associated
+/// image in the texture atlas, or nil if it isn't available. Works exactly like the equivalent
+/// function for 2D batches, `batch:vertexatlashash()`.
+static int api_render3d_atlashash(lua_State*);
+
+/// [-2, +1, -]
+/// Given an image meta-ID from this render, returns a perceptual hash of its associated image in
+/// the texture atlas, or nil if it isn't available. Works exactly like `batch:vertexatlasphash()`.
+static int api_render3d_atlasphash(lua_State*);
+
 /// [-2, +2, -]
 /// Given an index of a vertex in a model, returns the vertex's associated "UV" coordinates.
 ///
@@ -643,6 +791,38 @@ static int api_render3d_vertexuv(lua_State*);
 /// Also aliased as "vertexcolor" to keep the Americans happy.
 static int api_render3d_vertexcolour(lua_State*);
 
+/// [-(3|4|5), +(0|1), -]
+/// Decodes a range of vertices in one call, which is much faster than calling the per-vertex
+/// functions above in a loop. Takes the index of the first vertex and the number of vertices.
+///
+/// Each vertex is a record of eleven 4-byte values, in this order: X, Y and Z in model coordinates
+/// as 32-bit floats; the atlas meta-ID as a 32-bit int; U and V, then red, green, blue and alpha,
+/// all as 32-bit floats; and the bone ID as a 32-bit int. These are the same values as would be
+/// returned by vertexxyz, vertexmeta, vertexuv, vertexcolour and vertexbone.
+///
+/// If a Buffer object is passed as the third param, the records will be written into it, packed
+/// and little-endian, starting at the byte offset given by the optional fourth param (default 0).
+/// Each record is 44 bytes long, and it is a fatal error if the Buffer isn't big enough. Otherwise,
+/// returns a table containing every value of every record, i.e. `count * 11` numbers.
+static int api_render3d_vertices(lua_State*);
+
+/// [-(3|4|5), +(0|1), -]
+/// Works out where a range of vertices will end up on screen, taking the index of the first vertex
+/// and the number of vertices, the same as `vertices()`. Each vertex has its bone animation (if the
+/// model is animated), model matrix and view-projection matrix applied in one pass, which is far
+/// faster than doing the same thing with `boneanimation()` and Point objects for every vertex.
+///
+/// Each result is a record of four 32-bit floats: X and Y in pixels, the same as `aspixels()` would
+/// give, followed by Z and W in clip space. A W value of zero or less means the vertex is behind the
+/// camera, and its X and Y should be ignored. Results are calculated with 32-bit floats, like the
+/// game's shaders, so they may differ very slightly from the ones calculated by Point objects.
+///
+/// If a Buffer object is passed as the third param, the records will be written into it, packed
+/// and little-endian, starting at the byte offset given by the optional fourth param (default 0).
+/// Each record is 16 bytes long, and it is a fatal error if the Buffer isn't big enough. Otherwise,
+/// returns a table containing every value of every record, i.e. `count * 4` numbers.
+static int api_render3d_skinnedvertices(lua_State*);
+
 /// [-1, +1, -]
 /// Returns the unique ID of the texture associated with this render. There will always be one (and
 /// only one) texture associated with a 3D model render. These textures are "atlased", meaning they
@@ -671,7 +851,7 @@ static int api_render3d_texturesize(lua_State*);
 /// time.
 static int api_render3d_texturecompare(lua_State*);
 
-/// [-4, +1, -]
+/// [-(4|5|6), +1, -]
 /// Gets the RGBA data starting at a given coordinate of the texture atlas, for example:
 ///
 /// `render:texturedata(64, 128, 8)`
@@ -681,6 +861,11 @@ static int api_render3d_texturecompare(lua_State*);
 ///
 /// Encoding Lua strings is computationally expensive, and indexing the data one byte at a time is
 /// even more so. Unless you really need to do that, use `texturecompare()` instead.
+///
+/// Alternatively, a buffer and an optional offset into it (default 0) can be passed after the
+/// length, in which case the data is copied into the buffer at that offset and the function returns
+/// true, or false if the data isn't available. The data can then be read quickly with a "uint8"
+/// view of the buffer, see `buffer:view()`.
 static int api_render3d_texturedata(lua_State*);
 
 /// [-1, +1, -]
@@ -700,6 +885,13 @@ static int api_render3d_vertexbone(lua_State*);
 /// `vertexbone()` and `bonetransforms()`.
 static int api_render3d_animated(lua_State*);
 
+/// [-1, +1, m]
+/// Copies everything about this render into a new render object, which remains valid after the
+/// callback has returned. This works the same way as `batch2d:snapshot()`, with the same exceptions,
+/// and also includes the model and view-projection matrices, the atlas XYWH for every meta-ID used
+/// by the model, and the transforms for every bone if the model is animated.
+static int api_render3d_snapshot(lua_State*);
+
 /// [-2, +1, -]
 /// Transforms this Point by a Transform object and returns a new Point. The original Point object
 /// is not modified.
@@ -727,6 +919,38 @@ static int api_transform_decompose(lua_State*);
 /// Returns the 16 values that compose this matrix, in row-major order.
 static int api_transform_get(lua_State*);
 
+/// [-2, +1, -]
+/// Given another Transform, returns a new Transform that does the same thing as applying this one
+/// and then that one, i.e. `point:transform(a):transform(b)` is the same as
+/// `point:transform(a:combine(b))`. Mainly useful for combining a render's model matrix with its
+/// viewproj matrix, so that they can be applied at once with `projectpoints()`.
+static int api_transform_combine(lua_State*);
+
+/// [-(7|8), +(1|5), -]
+/// Projects a large number of points to screen space in one call, which is much faster than doing
+/// it with Point objects. This transform is expected to take the points to screen coordinates, like
+/// a render's viewproj matrix does - for a model's default vertex positions, that would be
+/// `render:modelmatrix():combine(render:viewprojmatrix())`.
+///
+/// The params are: a Buffer containing the points, the byte offset of the first point in it, the
+/// stride (the number of bytes from the start of one point to the start of the next, at least 12),
+/// the number of points, a Buffer to write the results into, the byte offset to start writing at,
+/// and optionally a boolean for whether to cull points. Each point is read as three little-endian
+/// 32-bit floats, X Y and Z, so the output of `render:vertices()` can be passed in directly with a
+/// stride of 44.
+///
+/// Each result is a 12-byte record: X and Y in pixels, the same as `aspixels()` would give, as
+/// 32-bit floats, followed by the 1-based position of the point in the input, as a 32-bit int. If
+/// culling is enabled, points that aren't inside the view frustum are skipped, and the rest are
+/// written one after another with no gaps. Otherwise there's one record for every point. The output
+/// Buffer must have room for one record for every point either way.
+///
+/// Returns the number of records written, followed by the bounding box of them as a left, top,
+/// right and bottom pixel position. Points behind the camera are never included in the bounding
+/// box, whether culling or not. If there are no points to make a bounding box from, only the number
+/// of records is returned.
+static int api_transform_projectpoints(lua_State*);
+
 /// [-1, +4, -]
 /// Returns the new x, y, width and height that the window was repositioned to.
 static int api_repositionevent_xywh(lua_State*);
@@ -797,23 +1021,57 @@ static int api_browser_close(lua_State*);
 /// exactly as it appeared in Lua, byte-for-byte - it will not be decoded or re-encoded in any way.
 static int api_browser_sendmessage(lua_State*);
 
-/// [-1, +0, -]
+/// [-(1|2), +0, -]
 /// Enables screen capture for this browser. The screen contents will be sent to the browser using
 /// the postMessage function. The event's data will be an object with "type": "screenCapture",
 /// "width" and "height" will be integers indicating the size of the captured area, and "content"
 /// will be an ArrayBuffer of length (width * height * 3). The contents will be three bytes per
 /// pixel, in RGB format, in row-major order, starting with the bottom-left pixel.
 ///
+/// The optional second parameter is the minimum number of milliseconds between captures, which
+/// defaults to 250 (i.e. 4 frames per second). Pass 0 to receive a capture every frame. Calling
+/// this function again while capture is already enabled will change the interval.
+///
 /// The data will be sent using a shared memory mapping, so the overhead is much lower than it
-/// would be to send all the data using sendmessage. However, downloading screen contents from the
-/// GPU will still slow the game down (takes around 2 to 5 milliseconds depending on window size),
-/// so Bolt will limit itself to capturing 4 frames per second via this function.
+/// would be to send all the data using sendmessage. Captures are downloaded from the GPU in the
+/// background, so each one arrives a couple of frames after it was taken, and a new capture won't
+/// be sent until the browser has finished handling the previous one.
 static int api_browser_enablecapture(lua_State*);
 
 /// [-1, +0, -]
 /// Disables screen capture for this browser.
 static int api_browser_disablecapture(lua_State*);
 
+/// [-(1|5|6), +0, -]
+/// Sets which part of the screen is captured for this browser. The parameters are x, y, width and
+/// height in pixels, relative to the top-left of the game window, followed by an optional integer
+/// scale factor, which defaults to 1. Calling this with no parameters resets it to the whole window.
+///
+/// The region will be clipped to the window, then shrunk by the scale factor on the GPU before being
+/// downloaded, so the resulting capture event will be (width / scale) by (height / scale) pixels.
+/// Capturing only the part of the screen that's actually needed, and at the lowest resolution that's
+/// usable, is much less work for both the game and the browser than capturing the whole window.
+static int api_browser_setcaptureregion(lua_State*);
+
+/// [-(1|2), +0, -]
+/// Enables or disables tiled capture for this browser, depending on whether the parameter is truthy.
+/// With tiled capture, the captured area is split into 64x64 tiles, and each capture event only
+/// contains the tiles that have changed since the previous one this browser was sent. Captures are
+/// normally skipped entirely if nothing has changed. This is much less data to process for a browser that
+/// already keeps its own copy of the screen, since most of it usually stays the same between frames.
+///
+/// The capture event will have two more fields: "tileSize", which is 64, and "dirtyTiles", an
+/// ArrayBuffer with one bit for each tile, least significant bit first. Tiles are numbered in
+/// row-major order starting at the bottom-left, the same as pixels, and the ones on the right and
+/// top edges will be smaller if the width or height isn't a multiple of 64. A set bit means that
+/// tile is included in "content". Included tiles come one after the other in the same order, each
+/// one being three bytes per pixel in row-major order, like a capture of just that tile would be.
+///
+/// The first capture after enabling this, or after the capture region changes, has every tile in
+/// it. Captures of more than 8192 tiles, which is larger than 8K, are always sent whole and won't
+/// have either of these fields, so they should be checked for even when tiled capture is enabled.
+static int api_browser_setcapturetiled(lua_State*);
+
 /// [-2, +0, -]
 /// Sets an event handler for this browser for close requests. If the value is a function, it will
 /// be called with no parameters when the browser window has requested to close, such as by the
@@ -849,23 +1107,57 @@ static int api_embeddedbrowser_close(lua_State*);
 /// exactly as it appeared in Lua, byte-for-byte - it will not be decoded or re-encoded in any way.
 static int api_embeddedbrowser_sendmessage(lua_State*);
 
-/// [-1, +0, -]
+/// [-(1|2), +0, -]
 /// Enables screen capture for this browser. The screen contents will be sent to the browser using
 /// the postMessage function. The event's data will be an object with "type": "screenCapture",
 /// "width" and "height" will be integers indicating the size of the captured area, and "content"
 /// will be an ArrayBuffer of length (width * height * 3). The contents will be three bytes per
 /// pixel, in RGB format, in row-major order, starting with the bottom-left pixel.
 ///
+/// The optional second parameter is the minimum number of milliseconds between captures, which
+/// defaults to 250 (i.e. 4 frames per second). Pass 0 to receive a capture every frame. Calling
+/// this function again while capture is already enabled will change the interval.
+///
 /// The data will be sent using a shared memory mapping, so the overhead is much lower than it
-/// would be to send all the data using sendmessage. However, downloading screen contents from the
-/// GPU will still slow the game down (takes around 2 to 5 milliseconds depending on window size),
-/// so Bolt will limit itself to capturing 4 frames per second via this function.
+/// would be to send all the data using sendmessage. Captures are downloaded from the GPU in the
+/// background, so each one arrives a couple of frames after it was taken, and a new capture won't
+/// be sent until the browser has finished handling the previous one.
 static int api_embeddedbrowser_enablecapture(lua_State*);
 
 /// [-1, +0, -]
 /// Disables screen capture for this browser.
 static int api_embeddedbrowser_disablecapture(lua_State*);
 
+/// [-(1|5|6), +0, -]
+/// Sets which part of the screen is captured for this browser. The parameters are x, y, width and
+/// height in pixels, relative to the top-left of the game window, followed by an optional integer
+/// scale factor, which defaults to 1. Calling this with no parameters resets it to the whole window.
+///
+/// The region will be clipped to the window, then shrunk by the scale factor on the GPU before being
+/// downloaded, so the resulting capture event will be (width / scale) by (height / scale) pixels.
+/// Capturing only the part of the screen that's actually needed, and at the lowest resolution that's
+/// usable, is much less work for both the game and the browser than capturing the whole window.
+static int api_embeddedbrowser_setcaptureregion(lua_State*);
+
+/// [-(1|2), +0, -]
+/// Enables or disables tiled capture for this browser, depending on whether the parameter is truthy.
+/// With tiled capture, the captured area is split into 64x64 tiles, and each capture event only
+/// contains the tiles that have changed since the previous one this browser was sent. Captures are
+/// normally skipped entirely if nothing has changed. This is much less data to process for a browser that
+/// already keeps its own copy of the screen, since most of it usually stays the same between frames.
+///
+/// The capture event will have two more fields: "tileSize", which is 64, and "dirtyTiles", an
+/// ArrayBuffer with one bit for each tile, least significant bit first. Tiles are numbered in
+/// row-major order starting at the bottom-left, the same as pixels, and the ones on the right and
+/// top edges will be smaller if the width or height isn't a multiple of 64. A set bit means that
+/// tile is included in "content". Included tiles come one after the other in the same order, each
+/// one being three bytes per pixel in row-major order, like a capture of just that tile would be.
+///
+/// The first capture after enabling this, or after the capture region changes, has every tile in
+/// it. Captures of more than 8192 tiles, which is larger than 8K, are always sent whole and won't
+/// have either of these fields, so they should be checked for even when tiled capture is enabled.
+static int api_embeddedbrowser_setcapturetiled(lua_State*);
+
 /// [-4, +0, -]
 /// Writes an integer into the buffer. The first parameter is the integer itself, the second is the
 /// offset in the buffer, and the third is the number of bytes the integer will be truncated to.
@@ -887,3 +1179,75 @@ static int api_buffer_writestring(lua_State*);
 /// Writes the contents of another buffer into this buffer. The first parameter is the buffer to be
 /// copied from, and the second is the offset in this buffer where it should be copied to.
 static int api_buffer_writebuffer(lua_State*);
+
+/// [-3, +1, -]
+/// Reads an integer from the buffer. The first parameter is the offset in the buffer, and the second
+/// is the number of bytes to read, from 1 to 8. The integer will be read as unsigned little-endian,
+/// so it will be the same as the value written by writeinteger, if it fit into that many bytes.
+static int api_buffer_readinteger(lua_State*);
+
+/// [-2, +1, -]
+/// Reads a number from the buffer at the given offset, in the same format used by writenumber.
+static int api_buffer_readnumber(lua_State*);
+
+/// [-3, +1, -]
+/// Reads a string from the buffer. The first parameter is the offset into the buffer where the
+/// string begins, and the second is the length of the string in bytes.
+static int api_buffer_readstring(lua_State*);
+
+/// [-1, +1, -]
+/// Returns the size of the buffer in bytes. This will be 0 for a buffer which has been sent to or
+/// from a worker.
+static int api_buffer_size(lua_State*);
+
+/// [-(2|3|4), +1, -]
+/// Returns a view of the buffer's contents as an array of numbers of one type, which can be read
+/// and written like a table, but with no function call for each element. The first parameter is
+/// the type, which can be "int8", "uint8", "int16", "uint16", "int32", "uint32", "float" or
+/// "double", in native byte order. The second is the offset in bytes where the view starts, and
+/// defaults to 0, and the third is how many elements it has, defaulting to as many as will fit.
+///
+/// A view is indexed from 1 to its "count" field, and indexing it outside of that is an error.
+/// Writes are converted to the element type the same way as in C, so fractions are truncated for
+/// integer types. A view stays valid for as long as it exists, but will start to raise errors if
+/// its buffer is sent to or from a worker, since that leaves the buffer empty.
+///
+/// Views are much faster than readinteger and the other functions above when looking at more than
+/// a few values, particularly in loops, which LuaJIT will compile into direct memory accesses. To
+/// look at data from the game this way, pass a buffer to one of the functions that can fill one,
+/// such as `batch:vertices()` and `batch:texturedata()`, then look at it through a view.
+static int api_buffer_view(lua_State*);
+
+/// [-2, +0, -]
+/// Sends a message to the worker, which must be a string or a buffer. Sending a buffer gives its
+/// memory to the worker, leaving the buffer empty, so it can't be used again after this. Strings
+/// are copied. Messages are received by the worker in the same order they were sent.
+static int api_worker_sendmessage(lua_State*);
+
+/// [-2, +0, -]
+/// Sets an event handler for this worker for messages sent from the worker to the plugin, using
+/// its `sendmessage` function. If the value is a function, it will be called with one parameter,
+/// that being a buffer containing the message. If the worker sent a string, the buffer will contain
+/// the bytes of the string.
+static int api_worker_onmessage(lua_State*);
+
+/// [-1, +0, -]
+/// Stops the worker. Any messages which haven't been handled yet on either side are discarded. If
+/// the worker is busy, it will be interrupted, but a loop that's been JIT-compiled can't be
+/// interrupted, so the game will freeze until that loop ends the next time this plugin's workers
+/// are processed.
+///
+/// Do not use the worker object again after calling this function on it.
+static int api_worker_close(lua_State*);
+
+/// [-1, +0, -]
+/// Only available in workers. Sends a message to the plugin, which will be received by the
+/// worker object's onmessage handler. Works the same way as `worker:sendmessage`.
+static int api_inworker_sendmessage(lua_State*);
+
+/// [-1, +0, -]
+/// Only available in workers. Sets a callback function for messages sent to this worker by the
+/// plugin, overwriting the previous callback, if any. Passing a non-function (ideally `nil`) will
+/// remove the callback, meaning any messages received will be discarded. The callback will be
+/// called with one parameter, that being a buffer containing the message.
+static int api_inworker_onmessage(lua_State*);
@@ -6,7 +6,9 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <fcntl.h>
 
 uint8_t _bolt_plugin_shm_open_inbound(struct BoltSHM* shm, const char* tag, uint64_t id) {
@@ -38,7 +40,8 @@ uint8_t _bolt_plugin_shm_open_outbound(struct BoltSHM* shm, size_t size, const c
         close(shm->fd);
         return 0;
     }
-    shm->file = mmap(NULL, size, PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    shm->file = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    shm->map_length = size;
     shm->tag = tag;
     shm->id = id;
     return 1;
@@ -46,7 +49,7 @@ uint8_t _bolt_plugin_shm_open_outbound(struct BoltSHM* shm, size_t size, const c
 
 void _bolt_plugin_shm_close(struct BoltSHM* shm) {
     if (shm->file) munmap(shm->file, shm->map_length);
-    close(shm->fd);
+    if (shm->fd != -1) close(shm->fd);
     if (shm->unlink_pid > 0) {
         char buf[256];
         snprintf(buf, sizeof(buf), "/bolt-%i-%s-%lu", shm->unlink_pid, shm->tag, shm->id);
@@ -71,3 +74,173 @@ void _bolt_plugin_shm_remap(struct BoltSHM* shm, size_t length, void* handle) {
     }
     shm->map_length = length;
 }
+
+uint8_t _bolt_plugin_shm_open_shared(struct BoltSHM* shm, size_t size, const char* tag, int owner, uint64_t id, uint8_t* created) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "/bolt-%i-%s-%lu", owner, tag, id);
+    // the fd isn't kept, since a process may have a lot of these open at once
+    shm->fd = -1;
+    shm->unlink_pid = 0;
+    shm->tag = tag;
+    shm->id = id;
+    shm->file = NULL;
+    int fd = shm_open(buf, O_RDWR | O_CREAT | O_EXCL, 0644);
+    *created = fd != -1;
+    if (*created) {
+        if (ftruncate(fd, size)) {
+            close(fd);
+            shm_unlink(buf);
+            return 0;
+        }
+    } else {
+        if (errno != EEXIST) return 0;
+        fd = shm_open(buf, O_RDONLY, 0);
+        if (fd == -1) return 0;
+        // anything made by another user, or still being sized by its creator, can't be trusted
+        struct stat st;
+        if (fstat(fd, &st) || st.st_uid != geteuid() || (size_t)st.st_size < size) {
+            close(fd);
+            return 0;
+        }
+    }
+    void* file = mmap(NULL, size, *created ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        if (*created) shm_unlink(buf);
+        return 0;
+    }
+    shm->file = file;
+    shm->map_length = size;
+    return 1;
+}
+
+void _bolt_plugin_shm_seal(struct BoltSHM* shm) {
+    mprotect(shm->file, shm->map_length, PROT_READ);
+}
+
+static void* thread_entry(void* userdata) {
+    struct BoltThread* thread = userdata;
+    thread->func(thread->userdata);
+    pthread_mutex_lock(&thread->lock);
+    thread->finished = 1;
+    pthread_cond_broadcast(&thread->cond);
+    pthread_mutex_unlock(&thread->lock);
+    return NULL;
+}
+
+uint8_t _bolt_plugin_thread_start(struct BoltThread* thread, void (*func)(void*), void* userdata) {
+    thread->func = func;
+    thread->userdata = userdata;
+    thread->finished = 0;
+    pthread_mutex_init(&thread->lock, NULL);
+    pthread_cond_init(&thread->cond, NULL);
+    const int err = pthread_create(&thread->thread, NULL, thread_entry, thread);
+    if (err) {
+        printf("failed to create thread: %i\n", err);
+        pthread_cond_destroy(&thread->cond);
+        pthread_mutex_destroy(&thread->lock);
+        return 0;
+    }
+    return 1;
+}
+
+void _bolt_plugin_thread_join(struct BoltThread* thread) {
+    pthread_join(thread->thread, NULL);
+    pthread_cond_destroy(&thread->cond);
+    pthread_mutex_destroy(&thread->lock);
+}
+
+uint8_t _bolt_plugin_thread_join_timeout(struct BoltThread* thread, uint32_t millis) {
+    // pthread_timedjoin_np isn't portable, so wait on the condition variable for thread_entry to set `finished`
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += millis / 1000;
+    deadline.tv_nsec += (long)(millis % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&thread->lock);
+    while (!thread->finished) {
+        if (pthread_cond_timedwait(&thread->cond, &thread->lock, &deadline) == ETIMEDOUT) break;
+    }
+    const uint8_t finished = thread->finished;
+    pthread_mutex_unlock(&thread->lock);
+    if (!finished) {
+        pthread_detach(thread->thread);
+        return 0;
+    }
+    _bolt_plugin_thread_join(thread);
+    return 1;
+}
+
+void _bolt_plugin_thread_lock(struct BoltThread* thread) {
+    pthread_mutex_lock(&thread->lock);
+}
+
+void _bolt_plugin_thread_unlock(struct BoltThread* thread) {
+    pthread_mutex_unlock(&thread->lock);
+}
+
+void _bolt_plugin_thread_wait(struct BoltThread* thread) {
+    pthread_cond_wait(&thread->cond, &thread->lock);
+}
+
+void _bolt_plugin_thread_notify(struct BoltThread* thread) {
+    pthread_cond_broadcast(&thread->cond);
+}
+
+uint8_t _bolt_plugin_cache_dir(char* buf, size_t size) {
+    const char* cache_home = getenv("XDG_CACHE_HOME");
+    int len;
+    if (cache_home && *cache_home) {
+        len = snprintf(buf, size, "%s/bolt-launcher", cache_home);
+    } else {
+        const char* home = getenv("HOME");
+        if (!home || !*home) return 0;
+        len = snprintf(buf, size, "%s/.cache", home);
+        if (len < 0 || (size_t)len >= size || (mkdir(buf, 0700) && errno != EEXIST)) return 0;
+        len = snprintf(buf, size, "%s/.cache/bolt-launcher", home);
+    }
+    if (len < 0 || (size_t)len >= size || (mkdir(buf, 0700) && errno != EEXIST)) return 0;
+    const int dir_len = len;
+    len = snprintf(buf + dir_len, size - dir_len, "/bytecode");
+    if (len < 0 || (size_t)(dir_len + len + 1) >= size || (mkdir(buf, 0700) && errno != EEXIST)) return 0;
+    buf[dir_len + len] = '/';
+    buf[dir_len + len + 1] = '\0';
+    return 1;
+}
+
+uint8_t _bolt_plugin_file_mtime(const char* path, int64_t* mtime) {
+    struct stat st;
+    if (stat(path, &st)) return 0;
+    *mtime = ((int64_t)st.st_mtim.tv_sec * 1000000000) + st.st_mtim.tv_nsec;
+    return 1;
+}
+
+uint8_t _bolt_plugin_file_replace(const char* from, const char* to) {
+    if (rename(from, to)) {
+        unlink(from);
+        return 0;
+    }
+    return 1;
+}
+
+void* _bolt_plugin_file_map(const char* path, size_t* size) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    *size = st.st_size;
+    return data;
+}
+
+void _bolt_plugin_file_unmap(void* data, size_t size) {
+    munmap(data, size);
+}
@@ -1,6 +1,8 @@
 #include "plugin.h"
 
 #include <Windows.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 static void shm_map_readwrite(struct BoltSHM* shm, size_t size) {
     wchar_t buf[256];
@@ -46,3 +48,130 @@ void _bolt_plugin_shm_remap(struct BoltSHM* shm, size_t length, void* handle) {
     shm->handle = (HANDLE)handle;
     shm->file = MapViewOfFile(shm->handle, FILE_MAP_READ, 0, 0, length);
 }
+
+uint8_t _bolt_plugin_shm_open_shared(struct BoltSHM* shm, size_t size, const char* tag, int owner, uint64_t id, uint8_t* created) {
+    wchar_t buf[256];
+    _snwprintf(buf, 256, L"/bolt-%i-%hs-%llu", owner, tag, id);
+    shm->tag = tag;
+    shm->id = id;
+    shm->file = NULL;
+    shm->handle = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, buf);
+    if (!shm->handle) return 0;
+    *created = GetLastError() != ERROR_ALREADY_EXISTS;
+    // this fails if an existing mapping is smaller than `size`
+    shm->file = MapViewOfFile(shm->handle, *created ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+    if (!shm->file) {
+        CloseHandle(shm->handle);
+        shm->handle = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void _bolt_plugin_shm_seal(struct BoltSHM* shm) {
+    MEMORY_BASIC_INFORMATION info;
+    DWORD old_protect;
+    if (VirtualQuery(shm->file, &info, sizeof(info))) VirtualProtect(shm->file, info.RegionSize, PAGE_READONLY, &old_protect);
+}
+
+static DWORD WINAPI thread_entry(LPVOID userdata) {
+    struct BoltThread* thread = userdata;
+    thread->func(thread->userdata);
+    return 0;
+}
+
+uint8_t _bolt_plugin_thread_start(struct BoltThread* thread, void (*func)(void*), void* userdata) {
+    thread->func = func;
+    thread->userdata = userdata;
+    InitializeCriticalSection(&thread->lock);
+    InitializeConditionVariable(&thread->cond);
+    thread->handle = CreateThread(NULL, 0, thread_entry, thread, 0, NULL);
+    if (!thread->handle) {
+        printf("failed to create thread: %lu\n", GetLastError());
+        DeleteCriticalSection(&thread->lock);
+        return 0;
+    }
+    return 1;
+}
+
+void _bolt_plugin_thread_join(struct BoltThread* thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    DeleteCriticalSection(&thread->lock);
+}
+
+uint8_t _bolt_plugin_thread_join_timeout(struct BoltThread* thread, uint32_t millis) {
+    if (WaitForSingleObject(thread->handle, millis) != WAIT_OBJECT_0) {
+        // closing the handle doesn't stop the thread, it just means nothing can wait for it any more
+        CloseHandle(thread->handle);
+        return 0;
+    }
+    CloseHandle(thread->handle);
+    DeleteCriticalSection(&thread->lock);
+    return 1;
+}
+
+void _bolt_plugin_thread_lock(struct BoltThread* thread) {
+    EnterCriticalSection(&thread->lock);
+}
+
+void _bolt_plugin_thread_unlock(struct BoltThread* thread) {
+    LeaveCriticalSection(&thread->lock);
+}
+
+void _bolt_plugin_thread_wait(struct BoltThread* thread) {
+    SleepConditionVariableCS(&thread->cond, &thread->lock, INFINITE);
+}
+
+void _bolt_plugin_thread_notify(struct BoltThread* thread) {
+    WakeAllConditionVariable(&thread->cond);
+}
+
+uint8_t _bolt_plugin_cache_dir(char* buf, size_t size) {
+    const char* local_app_data = getenv("localappdata");
+    if (!local_app_data || !*local_app_data) return 0;
+    int len = snprintf(buf, size, "%s\\bolt-launcher", local_app_data);
+    if (len < 0 || (size_t)len >= size || (!CreateDirectoryA(buf, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)) return 0;
+    len = snprintf(buf, size, "%s\\bolt-launcher\\bytecode", local_app_data);
+    if (len < 0 || (size_t)(len + 1) >= size || (!CreateDirectoryA(buf, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)) return 0;
+    buf[len] = '\\';
+    buf[len + 1] = '\0';
+    return 1;
+}
+
+uint8_t _bolt_plugin_file_mtime(const char* path, int64_t* mtime) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) return 0;
+    *mtime = (int64_t)(((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime);
+    return 1;
+}
+
+uint8_t _bolt_plugin_file_replace(const char* from, const char* to) {
+    if (!MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileA(from);
+        return 0;
+    }
+    return 1;
+}
+
+void* _bolt_plugin_file_map(const char* path, size_t* size) {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+    void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) return NULL;
+    *size = (size_t)file_size.QuadPart;
+    return data;
+}
+
+void _bolt_plugin_file_unmap(void* data, size_t size) {
+    UnmapViewOfFile(data);
+}
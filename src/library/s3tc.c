@@ -0,0 +1,523 @@
+#include "s3tc.h"
+
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BOLT_HAVE_S3TC_X86
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BOLT_HAVE_S3TC_NEON
+#endif
+
+/* https://www.khronos.org/opengl/wiki/S3_Texture_Compression
+ *
+ * Every version below builds its tables with the same integer arithmetic:
+ * - 5-bit and 6-bit channels are widened to 8 bits by repeating their top bits, (x << 3) | (x >> 2)
+ *   and (x << 2) | (x >> 4), which is also how the game's own decoder does it
+ * - divisions by 3, 5 and 7 are rounded down. the SIMD versions do them as a multiply by a 16-bit
+ *   reciprocal and a shift right by 16, which rounds down to the same result for every numerator
+ *   the tables can produce (up to 2*255+255 for colours and 7*255 for alpha)
+ */
+#define DIV3_RECIPROCAL 21846
+#define DIV5_RECIPROCAL 13108
+#define DIV7_RECIPROCAL 9363
+
+// the endpoints of a colour block
+static uint16_t _bolt_dxt_c0(const uint8_t* cptr) { return cptr[0] + (cptr[1] << 8); }
+static uint16_t _bolt_dxt_c1(const uint8_t* cptr) { return cptr[2] + (cptr[3] << 8); }
+
+// the 2-bit colour indices of a colour block, two bits per pixel, pixel 0 in the lowest bits
+static uint32_t _bolt_dxt_colour_codes(const uint8_t* cptr) {
+    return cptr[4] + (cptr[5] << 8) + (cptr[6] << 16) + ((uint32_t)cptr[7] << 24);
+}
+
+// the 3-bit alpha indices of a DXT5 alpha block, three bits per pixel, pixel 0 in the lowest bits
+static uint64_t _bolt_dxt5_alpha_codes(const uint8_t* block) {
+    return block[2] + ((uint64_t)block[3] << 8) + ((uint64_t)block[4] << 16) + ((uint64_t)block[5] << 24) + ((uint64_t)block[6] << 32) + ((uint64_t)block[7] << 40);
+}
+
+/* plain C */
+
+static void _bolt_unpack_rgb565(uint16_t packed, uint8_t out[3]) {
+    out[0] = (packed >> 11) & 0b00011111;
+    out[0] = (out[0] << 3) | (out[0] >> 2);
+    out[1] = (packed >> 5) & 0b00111111;
+    out[1] = (out[1] << 2) | (out[1] >> 4);
+    out[2] = packed & 0b00011111;
+    out[2] = (out[2] << 3) | (out[2] >> 2);
+}
+
+// builds the four-entry RGBA colour table for an S3TC colour block. in three-colour mode (c0 <= c1) the
+// last entry is black, and if `punchthrough` is set it'll also have zero alpha, as in DXT1 with alpha.
+static void _bolt_dxt_colour_table(const uint8_t* cptr, uint8_t punchthrough, uint8_t table[4][4]) {
+    const uint16_t c0 = _bolt_dxt_c0(cptr);
+    const uint16_t c1 = _bolt_dxt_c1(cptr);
+    _bolt_unpack_rgb565(c0, table[0]);
+    _bolt_unpack_rgb565(c1, table[1]);
+    if (c0 > c1) {
+        for (size_t k = 0; k < 3; k += 1) {
+            table[2][k] = (2 * table[0][k] + table[1][k]) / 3;
+            table[3][k] = (2 * table[1][k] + table[0][k]) / 3;
+        }
+    } else {
+        for (size_t k = 0; k < 3; k += 1) {
+            table[2][k] = (table[0][k] + table[1][k]) / 2;
+            table[3][k] = 0;
+        }
+    }
+    table[0][3] = 0xFF;
+    table[1][3] = 0xFF;
+    table[2][3] = 0xFF;
+    table[3][3] = (punchthrough && c0 <= c1) ? 0 : 0xFF;
+}
+
+// builds the eight-entry alpha table for a DXT5 alpha block
+static void _bolt_dxt5_alpha_table(const uint8_t* block, uint8_t alpha[8]) {
+    const uint16_t alpha0 = block[0];
+    const uint16_t alpha1 = block[1];
+    alpha[0] = alpha0;
+    alpha[1] = alpha1;
+    if (alpha0 > alpha1) {
+        for (uint16_t k = 2; k < 8; k += 1) alpha[k] = (((8 - k) * alpha0) + ((k - 1) * alpha1)) / 7;
+    } else {
+        for (uint16_t k = 2; k < 6; k += 1) alpha[k] = (((6 - k) * alpha0) + ((k - 1) * alpha1)) / 5;
+        alpha[6] = 0;
+        alpha[7] = 0xFF;
+    }
+}
+
+// writes the 4x4 RGBA pixels of an S3TC colour block to `out`, where `stride` is the distance between rows in bytes
+static void _bolt_dxt_write_colours(const uint8_t* cptr, const uint8_t table[4][4], uint8_t* out, size_t stride) {
+    const uint32_t ctable = _bolt_dxt_colour_codes(cptr);
+    for (size_t j = 0; j < 4; j += 1) {
+        uint8_t* row = out + (j * stride);
+        const uint8_t codes = ctable >> (j * 8);
+        memcpy(row + 0, table[codes & 0b11], 4);
+        memcpy(row + 4, table[(codes >> 2) & 0b11], 4);
+        memcpy(row + 8, table[(codes >> 4) & 0b11], 4);
+        memcpy(row + 12, table[codes >> 6], 4);
+    }
+}
+
+static void _bolt_dxt1_decode_block(const uint8_t* block, uint8_t* out, size_t stride) {
+    uint8_t table[4][4];
+    _bolt_dxt_colour_table(block, 0, table);
+    _bolt_dxt_write_colours(block, table, out, stride);
+}
+
+static void _bolt_dxt1a_decode_block(const uint8_t* block, uint8_t* out, size_t stride) {
+    uint8_t table[4][4];
+    _bolt_dxt_colour_table(block, 1, table);
+    _bolt_dxt_write_colours(block, table, out, stride);
+}
+
+static void _bolt_dxt3_decode_block(const uint8_t* block, uint8_t* out, size_t stride) {
+    uint8_t table[4][4];
+    _bolt_dxt_colour_table(block + 8, 0, table);
+    _bolt_dxt_write_colours(block + 8, table, out, stride);
+    // 4-bit alpha values, two pixels per byte
+    for (size_t j = 0; j < 4; j += 1) {
+        uint8_t* row = out + (j * stride);
+        row[3] = (block[j * 2] & 0b1111) * 17;
+        row[7] = (block[j * 2] >> 4) * 17;
+        row[11] = (block[(j * 2) + 1] & 0b1111) * 17;
+        row[15] = (block[(j * 2) + 1] >> 4) * 17;
+    }
+}
+
+static void _bolt_dxt5_decode_block(const uint8_t* block, uint8_t* out, size_t stride) {
+    uint8_t table[4][4];
+    _bolt_dxt_colour_table(block + 8, 0, table);
+    _bolt_dxt_write_colours(block + 8, table, out, stride);
+    // 3-bit indices into an interpolated table of 8 alpha values
+    uint8_t alpha[8];
+    _bolt_dxt5_alpha_table(block, alpha);
+    const uint64_t atable = _bolt_dxt5_alpha_codes(block);
+    for (size_t j = 0; j < 4; j += 1) {
+        uint8_t* row = out + (j * stride);
+        const uint16_t codes = atable >> (j * 12);
+        row[3] = alpha[codes & 0b111];
+        row[7] = alpha[(codes >> 3) & 0b111];
+        row[11] = alpha[(codes >> 6) & 0b111];
+        row[15] = alpha[(codes >> 9) & 0b111];
+    }
+}
+
+#if defined(BOLT_HAVE_S3TC_X86)
+/* SSE2
+ *
+ * SSE2 has no byte shuffle or per-lane shift, so per-lane shifts are done as 16-bit multiplies by a
+ * power of two, and table entries are picked with masks.
+ */
+
+// picks between two vectors byte by byte: `b` where `mask` is set, `a` where it isn't
+__attribute__((target("sse2"))) static inline __m128i _bolt_dxt_blend_sse2(__m128i a, __m128i b, __m128i mask) {
+    return _mm_xor_si128(a, _mm_and_si128(mask, _mm_xor_si128(a, b)));
+}
+
+// builds the same colour table as _bolt_dxt_colour_table, as four RGBA pixels
+__attribute__((target("sse2"))) static inline __m128i _bolt_dxt_colour_table_sse2(const uint8_t* cptr, uint8_t punchthrough) {
+    const uint16_t c0 = _bolt_dxt_c0(cptr);
+    const uint16_t c1 = _bolt_dxt_c1(cptr);
+    // one endpoint per half, one channel per 16-bit lane. each channel is shifted up to the top of its
+    // lane, then its top bits are repeated below it: v >> 8 is x << (8 - width), and the mulhi is
+    // v >> (16 - 3) for the 5-bit channels and v >> (16 - 2) for the 6-bit one
+    const __m128i packed = _mm_setr_epi16(c0, c0, c0, 0, c1, c1, c1, 0);
+    const __m128i fields = _mm_and_si128(packed, _mm_setr_epi16(0xF800, 0x07E0, 0x001F, 0, 0xF800, 0x07E0, 0x001F, 0));
+    const __m128i top = _mm_mullo_epi16(fields, _mm_setr_epi16(1, 32, 2048, 0, 1, 32, 2048, 0));
+    const __m128i ends = _mm_or_si128(_mm_srli_epi16(top, 8), _mm_mulhi_epu16(top, _mm_setr_epi16(8, 4, 8, 0, 8, 4, 8, 0)));
+    const __m128i swapped = _mm_shuffle_epi32(ends, _MM_SHUFFLE(1, 0, 3, 2));
+
+    __m128i mids, alpha;
+    if (c0 > c1) {
+        // (2 * c0 + c1) / 3 in the low half, (2 * c1 + c0) / 3 in the high half
+        mids = _mm_mulhi_epu16(_mm_add_epi16(_mm_add_epi16(ends, ends), swapped), _mm_set1_epi16(DIV3_RECIPROCAL));
+        alpha = _mm_set1_epi32(0xFF000000);
+    } else {
+        // (c0 + c1) / 2 in the low half, black in the high half
+        mids = _mm_and_si128(_mm_srli_epi16(_mm_add_epi16(ends, swapped), 1), _mm_setr_epi32(-1, -1, 0, 0));
+        alpha = _mm_setr_epi32(0xFF000000, 0xFF000000, 0xFF000000, punchthrough ? 0 : 0xFF000000);
+    }
+    return _mm_or_si128(_mm_packus_epi16(ends, mids), alpha);
+}
+
+// builds the same alpha table as _bolt_dxt5_alpha_table, in the low 8 bytes
+__attribute__((target("sse2"))) static inline __m128i _bolt_dxt5_alpha_table_sse2(const uint8_t* block) {
+    const __m128i a0 = _mm_set1_epi16(block[0]);
+    const __m128i a1 = _mm_set1_epi16(block[1]);
+    __m128i alpha;
+    if (block[0] > block[1]) {
+        const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a0, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)), _mm_mullo_epi16(a1, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+        alpha = _mm_mulhi_epu16(sum, _mm_set1_epi16(DIV7_RECIPROCAL));
+    } else {
+        const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a0, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)), _mm_mullo_epi16(a1, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+        alpha = _mm_or_si128(_mm_mulhi_epu16(sum, _mm_set1_epi16(DIV5_RECIPROCAL)), _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 0xFF));
+    }
+    return _mm_packus_epi16(alpha, alpha);
+}
+
+// looks up the four rows of pixels of a colour block. each index bit is turned into a mask by testing
+// it in every lane, and the two masks pick between pairs of colours
+__attribute__((target("sse2"))) static inline void _bolt_dxt_colour_rows_sse2(const uint8_t* cptr, __m128i table, __m128i rows[4]) {
+    const __m128i c0 = _mm_shuffle_epi32(table, _MM_SHUFFLE(0, 0, 0, 0));
+    const __m128i c2 = _mm_shuffle_epi32(table, _MM_SHUFFLE(2, 2, 2, 2));
+    const __m128i diff01 = _mm_xor_si128(c0, _mm_shuffle_epi32(table, _MM_SHUFFLE(1, 1, 1, 1)));
+    const __m128i diff23 = _mm_xor_si128(c2, _mm_shuffle_epi32(table, _MM_SHUFFLE(3, 3, 3, 3)));
+    const __m128i bit0 = _mm_setr_epi32(1 << 0, 1 << 2, 1 << 4, 1 << 6);
+    const __m128i bit1 = _mm_setr_epi32(1 << 1, 1 << 3, 1 << 5, 1 << 7);
+    const uint32_t ctable = _bolt_dxt_colour_codes(cptr);
+    for (size_t j = 0; j < 4; j += 1) {
+        const __m128i codes = _mm_set1_epi32(ctable >> (j * 8));
+        const __m128i mask0 = _mm_cmpeq_epi32(_mm_and_si128(codes, bit0), bit0);
+        const __m128i mask1 = _mm_cmpeq_epi32(_mm_and_si128(codes, bit1), bit1);
+        const __m128i lo = _mm_xor_si128(c0, _mm_and_si128(mask0, diff01));
+        const __m128i hi = _mm_xor_si128(c2, _mm_and_si128(mask0, diff23));
+        rows[j] = _bolt_dxt_blend_sse2(lo, hi, mask1);
+    }
+}
+
+// replaces the alpha of each row of pixels with 16 alpha bytes, one per pixel in order
+__attribute__((target("sse2"))) static inline void _bolt_dxt_merge_alpha_sse2(__m128i rows[4], __m128i alpha) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i lo = _mm_unpacklo_epi8(zero, alpha);
+    const __m128i hi = _mm_unpackhi_epi8(zero, alpha);
+    rows[0] = _mm_or_si128(_mm_and_si128(rows[0], rgb_mask), _mm_unpacklo_epi16(zero, lo));
+    rows[1] = _mm_or_si128(_mm_and_si128(rows[1], rgb_mask), _mm_unpackhi_epi16(zero, lo));
+    rows[2] = _mm_or_si128(_mm_and_si128(rows[2], rgb_mask), _mm_unpacklo_epi16(zero, hi));
+    rows[3] = _mm_or_si128(_mm_and_si128(rows[3], rgb_mask), _mm_unpackhi_epi16(zero, hi));
+}
+
+__attribute__((target("sse2"))) static inline void _bolt_dxt_store_rows_sse2(const __m128i rows[4], uint8_t* out, size_t stride) {
+    for (size_t j = 0; j < 4; j += 1) _mm_storeu_si128((__m128i*)(out + (j * stride)), rows[j]);
+}
+
+__attribute__((target("sse2"))) static void _bolt_dxt1_decode_block_sse2(const uint8_t* block, uint8_t* out, size_t stride) {
+    __m128i rows[4];
+    _bolt_dxt_colour_rows_sse2(block, _bolt_dxt_colour_table_sse2(block, 0), rows);
+    _bolt_dxt_store_rows_sse2(rows, out, stride);
+}
+
+__attribute__((target("sse2"))) static void _bolt_dxt1a_decode_block_sse2(const uint8_t* block, uint8_t* out, size_t stride) {
+    __m128i rows[4];
+    _bolt_dxt_colour_rows_sse2(block, _bolt_dxt_colour_table_sse2(block, 1), rows);
+    _bolt_dxt_store_rows_sse2(rows, out, stride);
+}
+
+__attribute__((target("sse2"))) static void _bolt_dxt3_decode_block_sse2(const uint8_t* block, uint8_t* out, size_t stride) {
+    __m128i rows[4];
+    _bolt_dxt_colour_rows_sse2(block + 8, _bolt_dxt_colour_table_sse2(block + 8, 0), rows);
+    // split each byte into its two nibbles, low nibble first, then widen each nibble x to x * 17,
+    // which for x < 16 is the same as (x << 4) | x and can't carry into the neighbouring byte
+    const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+    const __m128i bytes = _mm_loadl_epi64((const __m128i*)block);
+    const __m128i lo = _mm_and_si128(bytes, nibble_mask);
+    const __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble_mask);
+    const __m128i nibbles = _mm_unpacklo_epi8(lo, hi);
+    _bolt_dxt_merge_alpha_sse2(rows, _mm_or_si128(nibbles, _mm_slli_epi16(nibbles, 4)));
+    _bolt_dxt_store_rows_sse2(rows, out, stride);
+}
+
+// fills every byte with byte k of `table`, for k < 8
+#define DXT5_ALPHA_BROADCAST(PAIRS, K) ((K) < 4 \
+    ? _mm_shuffle_epi32(_mm_shufflelo_epi16(PAIRS, _MM_SHUFFLE((K) & 3, (K) & 3, (K) & 3, (K) & 3)), _MM_SHUFFLE(0, 0, 0, 0)) \
+    : _mm_shuffle_epi32(_mm_shufflehi_epi16(PAIRS, _MM_SHUFFLE((K) & 3, (K) & 3, (K) & 3, (K) & 3)), _MM_SHUFFLE(3, 3, 3, 3)))
+
+__attribute__((target("sse2"))) static void _bolt_dxt5_decode_block_sse2(const uint8_t* block, uint8_t* out, size_t stride) {
+    __m128i rows[4];
+    _bolt_dxt_colour_rows_sse2(block + 8, _bolt_dxt_colour_table_sse2(block + 8, 0), rows);
+    const __m128i table = _bolt_dxt5_alpha_table_sse2(block);
+
+    // each row's 12 bits of indices go in four 16-bit lanes, shifted left by 9 - 3i in lane i so that
+    // bits 9-11 are pixel i's index once the multiply has dropped everything above bit 15
+    const uint64_t atable = _bolt_dxt5_alpha_codes(block);
+    const uint16_t r0 = atable & 0xFFF, r1 = (atable >> 12) & 0xFFF, r2 = (atable >> 24) & 0xFFF, r3 = (atable >> 36) & 0xFFF;
+    const __m128i shifts = _mm_setr_epi16(512, 64, 8, 1, 512, 64, 8, 1);
+    const __m128i idx01 = _mm_srli_epi16(_mm_mullo_epi16(_mm_setr_epi16(r0, r0, r0, r0, r1, r1, r1, r1), shifts), 9);
+    const __m128i idx23 = _mm_srli_epi16(_mm_mullo_epi16(_mm_setr_epi16(r2, r2, r2, r2, r3, r3, r3, r3), shifts), 9);
+    const __m128i idx = _mm_packus_epi16(_mm_and_si128(idx01, _mm_set1_epi16(0b111)), _mm_and_si128(idx23, _mm_set1_epi16(0b111)));
+
+    // same as the colours, but with three index bits, so eight entries narrowed down to one in three steps
+    const __m128i bit0 = _mm_set1_epi8(1), bit1 = _mm_set1_epi8(2), bit2 = _mm_set1_epi8(4);
+    const __m128i mask0 = _mm_cmpeq_epi8(_mm_and_si128(idx, bit0), bit0);
+    const __m128i mask1 = _mm_cmpeq_epi8(_mm_and_si128(idx, bit1), bit1);
+    const __m128i mask2 = _mm_cmpeq_epi8(_mm_and_si128(idx, bit2), bit2);
+    const __m128i pairs = _mm_unpacklo_epi8(table, table);
+    const __m128i a01 = _bolt_dxt_blend_sse2(DXT5_ALPHA_BROADCAST(pairs, 0), DXT5_ALPHA_BROADCAST(pairs, 1), mask0);
+    const __m128i a23 = _bolt_dxt_blend_sse2(DXT5_ALPHA_BROADCAST(pairs, 2), DXT5_ALPHA_BROADCAST(pairs, 3), mask0);
+    const __m128i a45 = _bolt_dxt_blend_sse2(DXT5_ALPHA_BROADCAST(pairs, 4), DXT5_ALPHA_BROADCAST(pairs, 5), mask0);
+    const __m128i a67 = _bolt_dxt_blend_sse2(DXT5_ALPHA_BROADCAST(pairs, 6), DXT5_ALPHA_BROADCAST(pairs, 7), mask0);
+    const __m128i a0123 = _bolt_dxt_blend_sse2(a01, a23, mask1);
+    const __m128i a4567 = _bolt_dxt_blend_sse2(a45, a67, mask1);
+    _bolt_dxt_merge_alpha_sse2(rows, _bolt_dxt_blend_sse2(a0123, a4567, mask2));
+    _bolt_dxt_store_rows_sse2(rows, out, stride);
+}
+
+/* AVX2
+ *
+ * Two rows at a time, with a per-lane shift to pull the indices apart and a cross-lane permute to look
+ * them up, which works for both tables since neither has more than eight entries. The tables are built
+ * by the SSE2 functions above.
+ */
+
+// looks up rows 0-1 and 2-3 of a colour block
+__attribute__((target("avx2"))) static inline void _bolt_dxt_colour_rows_avx2(const uint8_t* cptr, __m128i table, __m256i rows[2]) {
+    const __m256i colours = _mm256_broadcastsi128_si256(table);
+    const __m256i shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i mask = _mm256_set1_epi32(0b11);
+    const uint32_t ctable = _bolt_dxt_colour_codes(cptr);
+    rows[0] = _mm256_permutevar8x32_epi32(colours, _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(ctable & 0xFFFF), shifts), mask));
+    rows[1] = _mm256_permutevar8x32_epi32(colours, _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(ctable >> 16), shifts), mask));
+}
+
+// replaces the alpha of each pixel in `rows` with the top byte of the same lane of `alpha`
+__attribute__((target("avx2"))) static inline __m256i _bolt_dxt_merge_alpha_avx2(__m256i rows, __m256i alpha) {
+    return _mm256_or_si256(_mm256_and_si256(rows, _mm256_set1_epi32(0x00FFFFFF)), alpha);
+}
+
+__attribute__((target("avx2"))) static inline void _bolt_dxt_store_rows_avx2(const __m256i rows[2], uint8_t* out, size_t stride) {
+    _mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(rows[0]));
+    _mm_storeu_si128((__m128i*)(out + stride), _mm256_extracti128_si256(rows[0], 1));
+    _mm_storeu_si128((__m128i*)(out + (stride * 2)), _mm256_castsi256_si128(rows[1]));
+    _mm_storeu_si128((__m128i*)(out + (stride * 3)), _mm256_extracti128_si256(rows[1], 1));
+}
+
+__attribute__((target("avx2"))) static void _bolt_dxt1_decode_block_avx2(const uint8_t* block, uint8_t* out, size_t stride) {
+    __m256i rows[2];
+    _bolt_dxt_colour_rows_avx2(block, _bolt_dxt_colour_table_sse2(block, 0), rows);
+    _bolt_dxt_store_rows_avx2(rows, out, stride);
+}
+
+__attribute__((target("avx2"))) static void _bolt_dxt1a_decode_block_avx2(const uint8_t* block, uint8_t* out, size_t stride) {
+    __m256i rows[2];
+    _bolt_dxt_colour_rows_avx2(block, _bolt_dxt_colour_table_sse2(block, 1), rows);
+    _bolt_dxt_store_rows_avx2(rows, out, stride);
+}
+
+__attribute__((target("avx2"))) static void _bolt_dxt3_decode_block_avx2(const uint8_t* block, uint8_t* out, size_t stride) {
+    __m256i rows[2];
+    _bolt_dxt_colour_rows_avx2(block + 8, _bolt_dxt_colour_table_sse2(block + 8, 0), rows);
+    const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    const __m256i mask = _mm256_set1_epi32(0b1111);
+    for (size_t i = 0; i < 2; i += 1) {
+        const uint32_t nibbles = block[i * 4] + (block[(i * 4) + 1] << 8) + (block[(i * 4) + 2] << 16) + ((uint32_t)block[(i * 4) + 3] << 24);
+        const __m256i values = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(nibbles), shifts), mask);
+        // x * 17 is (x << 4) | x for a nibble, and the result has to end up in the top byte
+        rows[i] = _bolt_dxt_merge_alpha_avx2(rows[i], _mm256_or_si256(_mm256_slli_epi32(values, 28), _mm256_slli_epi32(values, 24)));
+    }
+    _bolt_dxt_store_rows_avx2(rows, out, stride);
+}
+
+__attribute__((target("avx2"))) static void _bolt_dxt5_decode_block_avx2(const uint8_t* block, uint8_t* out, size_t stride) {
+    __m256i rows[2];
+    _bolt_dxt_colour_rows_avx2(block + 8, _bolt_dxt_colour_table_sse2(block + 8, 0), rows);
+    const __m256i values = _mm256_slli_epi32(_mm256_cvtepu8_epi32(_bolt_dxt5_alpha_table_sse2(block)), 24);
+    const __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i mask = _mm256_set1_epi32(0b111);
+    const uint64_t atable = _bolt_dxt5_alpha_codes(block);
+    for (size_t i = 0; i < 2; i += 1) {
+        const __m256i idx = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((atable >> (i * 24)) & 0xFFFFFF), shifts), mask);
+        rows[i] = _bolt_dxt_merge_alpha_avx2(rows[i], _mm256_permutevar8x32_epi32(values, idx));
+    }
+    _bolt_dxt_store_rows_avx2(rows, out, stride);
+}
+#endif
+
+#if defined(BOLT_HAVE_S3TC_NEON)
+/* NEON
+ *
+ * One row at a time, with a per-lane shift to pull the indices apart and a byte table lookup. Lookups
+ * with an index past the end of the table give zero, which is used to look up only the alpha byte.
+ */
+
+// builds the same colour table as _bolt_dxt_colour_table, as four RGBA pixels. see the SSE2 version
+static uint8x16_t _bolt_dxt_colour_table_neon(const uint8_t* cptr, uint8_t punchthrough) {
+    static const uint16_t field_masks[8] = {0xF800, 0x07E0, 0x001F, 0, 0xF800, 0x07E0, 0x001F, 0};
+    static const int16_t field_shifts[8] = {0, 5, 11, 0, 0, 5, 11, 0};
+    static const int16_t repeat_shifts[8] = {-13, -14, -13, -16, -13, -14, -13, -16};
+    const uint16_t c0 = _bolt_dxt_c0(cptr);
+    const uint16_t c1 = _bolt_dxt_c1(cptr);
+    const uint16x8_t packed = vcombine_u16(vdup_n_u16(c0), vdup_n_u16(c1));
+    const uint16x8_t top = vshlq_u16(vandq_u16(packed, vld1q_u16(field_masks)), vld1q_s16(field_shifts));
+    const uint16x8_t ends = vorrq_u16(vshrq_n_u16(top, 8), vshlq_u16(top, vld1q_s16(repeat_shifts)));
+    const uint16x8_t swapped = vextq_u16(ends, ends, 4);
+
+    uint16x8_t mids;
+    uint32_t alpha3;
+    if (c0 > c1) {
+        const uint16x8_t sum = vaddq_u16(vaddq_u16(ends, ends), swapped);
+        mids = vcombine_u16(vshrn_n_u32(vmull_n_u16(vget_low_u16(sum), DIV3_RECIPROCAL), 16), vshrn_n_u32(vmull_n_u16(vget_high_u16(sum), DIV3_RECIPROCAL), 16));
+        alpha3 = 0xFF000000;
+    } else {
+        mids = vcombine_u16(vget_low_u16(vshrq_n_u16(vaddq_u16(ends, swapped), 1)), vdup_n_u16(0));
+        alpha3 = punchthrough ? 0 : 0xFF000000;
+    }
+    const uint32_t alpha_values[4] = {0xFF000000, 0xFF000000, 0xFF000000, alpha3};
+    const uint8x16_t rgb = vcombine_u8(vmovn_u16(ends), vmovn_u16(mids));
+    return vreinterpretq_u8_u32(vorrq_u32(vreinterpretq_u32_u8(rgb), vld1q_u32(alpha_values)));
+}
+
+// builds the same alpha table as _bolt_dxt5_alpha_table, in the low 8 bytes, with zeroes above
+static uint8x16_t _bolt_dxt5_alpha_table_neon(const uint8_t* block) {
+    static const uint16_t weights7_0[8] = {7, 0, 6, 5, 4, 3, 2, 1};
+    static const uint16_t weights7_1[8] = {0, 7, 1, 2, 3, 4, 5, 6};
+    static const uint16_t weights5_0[8] = {5, 0, 4, 3, 2, 1, 0, 0};
+    static const uint16_t weights5_1[8] = {0, 5, 1, 2, 3, 4, 0, 0};
+    static const uint16_t ends5[8] = {0, 0, 0, 0, 0, 0, 0, 0xFF};
+    const uint16x8_t a0 = vdupq_n_u16(block[0]);
+    const uint16x8_t a1 = vdupq_n_u16(block[1]);
+    const uint8_t mode7 = block[0] > block[1];
+    const uint16x8_t sum = vaddq_u16(vmulq_u16(a0, vld1q_u16(mode7 ? weights7_0 : weights5_0)), vmulq_u16(a1, vld1q_u16(mode7 ? weights7_1 : weights5_1)));
+    const uint16_t reciprocal = mode7 ? DIV7_RECIPROCAL : DIV5_RECIPROCAL;
+    uint16x8_t alpha = vcombine_u16(vshrn_n_u32(vmull_n_u16(vget_low_u16(sum), reciprocal), 16), vshrn_n_u32(vmull_n_u16(vget_high_u16(sum), reciprocal), 16));
+    if (!mode7) alpha = vorrq_u16(alpha, vld1q_u16(ends5));
+    return vcombine_u8(vmovn_u16(alpha), vdup_n_u8(0));
+}
+
+// looks up one row of pixels of a colour block, where `codes` is that row's 8 bits of indices
+static uint8x16_t _bolt_dxt_colour_row_neon(uint8x16_t colours, uint32_t codes) {
+    static const int32_t shifts[4] = {0, -2, -4, -6};
+    const uint32x4_t idx = vandq_u32(vshlq_u32(vdupq_n_u32(codes), vld1q_s32(shifts)), vdupq_n_u32(0b11));
+    // byte b of pixel i comes from byte (4 * idx) + b of the table
+    return vqtbl1q_u8(colours, vreinterpretq_u8_u32(vmlaq_n_u32(vdupq_n_u32(0x03020100), idx, 0x04040404)));
+}
+
+static void _bolt_dxt_colour_rows_neon(const uint8_t* cptr, uint8x16_t table, uint8x16_t rows[4]) {
+    const uint32_t ctable = _bolt_dxt_colour_codes(cptr);
+    for (size_t j = 0; j < 4; j += 1) rows[j] = _bolt_dxt_colour_row_neon(table, (ctable >> (j * 8)) & 0xFF);
+}
+
+static uint8x16_t _bolt_dxt_merge_alpha_neon(uint8x16_t row, uint32x4_t alpha) {
+    return vreinterpretq_u8_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_u8(row), vdupq_n_u32(0x00FFFFFF)), alpha));
+}
+
+static void _bolt_dxt_store_rows_neon(const uint8x16_t rows[4], uint8_t* out, size_t stride) {
+    for (size_t j = 0; j < 4; j += 1) vst1q_u8(out + (j * stride), rows[j]);
+}
+
+static void _bolt_dxt1_decode_block_neon(const uint8_t* block, uint8_t* out, size_t stride) {
+    uint8x16_t rows[4];
+    _bolt_dxt_colour_rows_neon(block, _bolt_dxt_colour_table_neon(block, 0), rows);
+    _bolt_dxt_store_rows_neon(rows, out, stride);
+}
+
+static void _bolt_dxt1a_decode_block_neon(const uint8_t* block, uint8_t* out, size_t stride) {
+    uint8x16_t rows[4];
+    _bolt_dxt_colour_rows_neon(block, _bolt_dxt_colour_table_neon(block, 1), rows);
+    _bolt_dxt_store_rows_neon(rows, out, stride);
+}
+
+static void _bolt_dxt3_decode_block_neon(const uint8_t* block, uint8_t* out, size_t stride) {
+    static const int32_t shifts[4] = {0, -4, -8, -12};
+    uint8x16_t rows[4];
+    _bolt_dxt_colour_rows_neon(block + 8, _bolt_dxt_colour_table_neon(block + 8, 0), rows);
+    const int32x4_t shift = vld1q_s32(shifts);
+    for (size_t j = 0; j < 4; j += 1) {
+        const uint32_t nibbles = block[j * 2] + (block[(j * 2) + 1] << 8);
+        const uint32x4_t values = vandq_u32(vshlq_u32(vdupq_n_u32(nibbles), shift), vdupq_n_u32(0b1111));
+        rows[j] = _bolt_dxt_merge_alpha_neon(rows[j], vshlq_n_u32(vmulq_n_u32(values, 17), 24));
+    }
+    _bolt_dxt_store_rows_neon(rows, out, stride);
+}
+
+static void _bolt_dxt5_decode_block_neon(const uint8_t* block, uint8_t* out, size_t stride) {
+    static const int32_t shifts[4] = {0, -3, -6, -9};
+    uint8x16_t rows[4];
+    _bolt_dxt_colour_rows_neon(block + 8, _bolt_dxt_colour_table_neon(block + 8, 0), rows);
+    const uint8x16_t values = _bolt_dxt5_alpha_table_neon(block);
+    const int32x4_t shift = vld1q_s32(shifts);
+    const uint64_t atable = _bolt_dxt5_alpha_codes(block);
+    for (size_t j = 0; j < 4; j += 1) {
+        const uint32x4_t idx = vandq_u32(vshlq_u32(vdupq_n_u32((atable >> (j * 12)) & 0xFFF), shift), vdupq_n_u32(0b111));
+        // the low three bytes of each lane index past the end of the table, so only the top byte is looked up
+        const uint32x4_t lookup = vorrq_u32(vshlq_n_u32(idx, 24), vdupq_n_u32(0x00FFFFFF));
+        rows[j] = _bolt_dxt_merge_alpha_neon(rows[j], vreinterpretq_u32_u8(vqtbl1q_u8(values, vreinterpretq_u8_u32(lookup))));
+    }
+    _bolt_dxt_store_rows_neon(rows, out, stride);
+}
+#endif
+
+uint8_t _bolt_s3tc_kernels(enum BoltS3TCISA isa, struct BoltS3TCKernels* out) {
+    switch (isa) {
+        case BOLT_S3TC_SCALAR:
+            *out = (struct BoltS3TCKernels){_bolt_dxt1_decode_block, _bolt_dxt1a_decode_block, _bolt_dxt3_decode_block, _bolt_dxt5_decode_block};
+            return 1;
+#if defined(BOLT_HAVE_S3TC_X86)
+        case BOLT_S3TC_SSE2:
+            if (!__builtin_cpu_supports("sse2")) return 0;
+            *out = (struct BoltS3TCKernels){_bolt_dxt1_decode_block_sse2, _bolt_dxt1a_decode_block_sse2, _bolt_dxt3_decode_block_sse2, _bolt_dxt5_decode_block_sse2};
+            return 1;
+        case BOLT_S3TC_AVX2:
+            if (!__builtin_cpu_supports("avx2")) return 0;
+            *out = (struct BoltS3TCKernels){_bolt_dxt1_decode_block_avx2, _bolt_dxt1a_decode_block_avx2, _bolt_dxt3_decode_block_avx2, _bolt_dxt5_decode_block_avx2};
+            return 1;
+#endif
+#if defined(BOLT_HAVE_S3TC_NEON)
+        case BOLT_S3TC_NEON:
+            // NEON is always there on aarch64, so there's nothing to check
+            *out = (struct BoltS3TCKernels){_bolt_dxt1_decode_block_neon, _bolt_dxt1a_decode_block_neon, _bolt_dxt3_decode_block_neon, _bolt_dxt5_decode_block_neon};
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+void _bolt_s3tc_best_kernels(struct BoltS3TCKernels* out) {
+    if (_bolt_s3tc_kernels(BOLT_S3TC_AVX2, out)) return;
+    if (_bolt_s3tc_kernels(BOLT_S3TC_NEON, out)) return;
+    if (_bolt_s3tc_kernels(BOLT_S3TC_SSE2, out)) return;
+    _bolt_s3tc_kernels(BOLT_S3TC_SCALAR, out);
+}
+
+const char* _bolt_s3tc_isa_name(enum BoltS3TCISA isa) {
+    switch (isa) {
+        case BOLT_S3TC_SCALAR: return "scalar";
+        case BOLT_S3TC_SSE2: return "sse2";
+        case BOLT_S3TC_AVX2: return "avx2";
+        case BOLT_S3TC_NEON: return "neon";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef _BOLT_LIBRARY_S3TC_H_
+#define _BOLT_LIBRARY_S3TC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* S3TC block decoding
+ *
+ * Decoders for the four S3TC (DXT) block formats the game uses, each of which turns one 4x4 block into
+ * 16 RGBA8 pixels. There's a plain C version of each, and SSE2, AVX2 and NEON versions that build the
+ * colour and alpha tables and do the per-pixel lookups in vector registers. They all use the same
+ * integer arithmetic, so every version gives byte-identical output, which bench/s3tc_bench.c checks.
+ *
+ * The sRGB formats are decoded the same as the linear ones, since the game uploads plain RGB data and
+ * labels it as sRGB.
+ *
+ * The x86 versions are compiled with per-function target attributes, so they can be built into a
+ * library that still runs on CPUs without them, and _bolt_s3tc_kernels checks the CPU before handing
+ * them out.
+ */
+
+/// Decodes one block to `out`, where `stride` is the distance between rows of `out` in bytes.
+typedef void (*BoltS3TCDecodeBlock)(const uint8_t* block, uint8_t* out, size_t stride);
+
+enum BoltS3TCISA {
+    BOLT_S3TC_SCALAR,
+    BOLT_S3TC_SSE2,
+    BOLT_S3TC_AVX2,
+    BOLT_S3TC_NEON,
+    BOLT_S3TC_ISA_COUNT,
+};
+
+/// One decoder per block format. DXT1A is DXT1 where three-colour blocks have a transparent black.
+struct BoltS3TCKernels {
+    BoltS3TCDecodeBlock dxt1;
+    BoltS3TCDecodeBlock dxt1a;
+    BoltS3TCDecodeBlock dxt3;
+    BoltS3TCDecodeBlock dxt5;
+};
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/// Fills `out` with the decoders for `isa`. Returns 0, leaving `out` untouched, if they aren't
+/// compiled into this build or the CPU doesn't support them.
+uint8_t _bolt_s3tc_kernels(enum BoltS3TCISA isa, struct BoltS3TCKernels* out);
+
+/// Fills `out` with the fastest decoders that can run on this CPU, which are the plain C ones if
+/// nothing else can.
+void _bolt_s3tc_best_kernels(struct BoltS3TCKernels* out);
+
+/// A human-readable name for `isa`, for logging.
+const char* _bolt_s3tc_isa_name(enum BoltS3TCISA isa);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
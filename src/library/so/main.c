@@ -187,16 +187,24 @@ static void _bolt_init_libgl(unsigned long addr, const Elf32_Word* gnu_hash_tabl
     if (sym) libgl.ClearColor = sym->st_value + libgl_addr;
     sym = _bolt_lookup_symbol("glDeleteTextures", gnu_hash_table, hash_table, string_table, symbol_table);
     if (sym) libgl.DeleteTextures = sym->st_value + libgl_addr;
+    sym = _bolt_lookup_symbol("glDisable", gnu_hash_table, hash_table, string_table, symbol_table);
+    if (sym) libgl.Disable = sym->st_value + libgl_addr;
     sym = _bolt_lookup_symbol("glDrawArrays", gnu_hash_table, hash_table, string_table, symbol_table);
     if (sym) libgl.DrawArrays = sym->st_value + libgl_addr;
     sym = _bolt_lookup_symbol("glDrawElements", gnu_hash_table, hash_table, string_table, symbol_table);
     if (sym) libgl.DrawElements = sym->st_value + libgl_addr;
+    sym = _bolt_lookup_symbol("glEnable", gnu_hash_table, hash_table, string_table, symbol_table);
+    if (sym) libgl.Enable = sym->st_value + libgl_addr;
     sym = _bolt_lookup_symbol("glFlush", gnu_hash_table, hash_table, string_table, symbol_table);
     if (sym) libgl.Flush = sym->st_value + libgl_addr;
     sym = _bolt_lookup_symbol("glGenTextures", gnu_hash_table, hash_table, string_table, symbol_table);
     if (sym) libgl.GenTextures = sym->st_value + libgl_addr;
     sym = _bolt_lookup_symbol("glGetError", gnu_hash_table, hash_table, string_table, symbol_table);
     if (sym) libgl.GetError = sym->st_value + libgl_addr;
+    sym = _bolt_lookup_symbol("glIsEnabled", gnu_hash_table, hash_table, string_table, symbol_table);
+    if (sym) libgl.IsEnabled = sym->st_value + libgl_addr;
+    sym = _bolt_lookup_symbol("glPixelStorei", gnu_hash_table, hash_table, string_table, symbol_table);
+    if (sym) libgl.PixelStorei = sym->st_value + libgl_addr;
     sym = _bolt_lookup_symbol("glReadPixels", gnu_hash_table, hash_table, string_table, symbol_table);
     if (sym) libgl.ReadPixels = sym->st_value + libgl_addr;
     sym = _bolt_lookup_symbol("glTexParameteri", gnu_hash_table, hash_table, string_table, symbol_table);
@@ -334,6 +342,13 @@ void glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
     LOG("glViewport end\n");
 }
 
+void glPixelStorei(GLenum pname, GLint param) {
+    LOG("glPixelStorei\n");
+    libgl.PixelStorei(pname, param);
+    _bolt_gl_onPixelStorei(pname, param);
+    LOG("glPixelStorei end\n");
+}
+
 void* eglGetProcAddress(const char* name) {
     LOG("eglGetProcAddress('%s')\n", name);
     void* ret = _bolt_gl_GetProcAddress(name);
@@ -418,14 +433,10 @@ static void _bolt_mouseevent_from_xcb(int16_t x, int16_t y, uint32_t detail, str
     out->mb_middle = (detail >> 9) & 1;
 }
 
-static uint8_t point_in_rect(int x, int y, int rx, int ry, int rw, int rh) {
-    return rx <= x && rx + rw > x && ry <= y && ry + rh > y;
-}
-
-static uint8_t handle_mouse_event(int16_t x, int16_t y, uint32_t detail, ptrdiff_t bool_offset, ptrdiff_t event_offset, uint8_t grab_type) {
+static uint8_t handle_mouse_event(int16_t x, int16_t y, uint32_t detail, uint8_t input_type, uint8_t grab_type) {
     struct MouseEvent event;
     _bolt_mouseevent_from_xcb(x, y, detail, &event);
-    return _bolt_plugin_handle_mouse_event(&event, bool_offset, event_offset, grab_type, &mousein_fake, &mousein_real);
+    return _bolt_plugin_handle_mouse_event(&event, input_type, grab_type, &mousein_fake, &mousein_real);
 }
 
 // returns true if the event should be passed on to the window, false if not
@@ -449,7 +460,7 @@ static uint8_t _bolt_handle_xcb_event(xcb_connection_t* c, xcb_generic_event_t*
             switch (event->event_type) {
                 case XCB_INPUT_MOTION: { // when mouse moves (not drag) inside the game window
                     xcb_input_motion_event_t* event = (xcb_input_motion_event_t*)e;
-                    return handle_mouse_event(event->event_x >> 16, event->event_y >> 16, event->mods.effective, offsetof(struct WindowPendingInput, mouse_motion), offsetof(struct WindowPendingInput, mouse_motion_event), GRAB_TYPE_NONE);
+                    return handle_mouse_event(event->event_x >> 16, event->event_y >> 16, event->mods.effective, INPUT_MOUSE_MOTION, GRAB_TYPE_NONE);
                 }
                 case XCB_INPUT_RAW_MOTION: // when mouse moves (not drag) anywhere globally on the PC
                 case XCB_INPUT_RAW_BUTTON_PRESS: // when pressing a mouse button anywhere globally on the PC
@@ -466,15 +477,15 @@ static uint8_t _bolt_handle_xcb_event(xcb_connection_t* c, xcb_generic_event_t*
             if (event->event != main_window_xcb) return true;
             switch (event->detail) {
                 case 1:
-                    return handle_mouse_event(event->event_x, event->event_y, event->state, offsetof(struct WindowPendingInput, mouse_left), offsetof(struct WindowPendingInput, mouse_left_event), GRAB_TYPE_START);
+                    return handle_mouse_event(event->event_x, event->event_y, event->state, INPUT_MOUSE_LEFT, GRAB_TYPE_START);
                 case 2:
-                    return handle_mouse_event(event->event_x, event->event_y, event->state, offsetof(struct WindowPendingInput, mouse_middle), offsetof(struct WindowPendingInput, mouse_middle_event), GRAB_TYPE_NONE);
+                    return handle_mouse_event(event->event_x, event->event_y, event->state, INPUT_MOUSE_MIDDLE, GRAB_TYPE_NONE);
                 case 3:
-                    return handle_mouse_event(event->event_x, event->event_y, event->state, offsetof(struct WindowPendingInput, mouse_right), offsetof(struct WindowPendingInput, mouse_right_event), GRAB_TYPE_NONE);
+                    return handle_mouse_event(event->event_x, event->event_y, event->state, INPUT_MOUSE_RIGHT, GRAB_TYPE_NONE);
                 case 4:
-                    return handle_mouse_event(event->event_x, event->event_y, event->state, offsetof(struct WindowPendingInput, mouse_scroll_up), offsetof(struct WindowPendingInput, mouse_scroll_up_event), GRAB_TYPE_NONE);
+                    return handle_mouse_event(event->event_x, event->event_y, event->state, INPUT_MOUSE_SCROLL_UP, GRAB_TYPE_NONE);
                 case 5:
-                    return handle_mouse_event(event->event_x, event->event_y, event->state, offsetof(struct WindowPendingInput, mouse_scroll_down), offsetof(struct WindowPendingInput, mouse_scroll_down_event), GRAB_TYPE_NONE);
+                    return handle_mouse_event(event->event_x, event->event_y, event->state, INPUT_MOUSE_SCROLL_DOWN, GRAB_TYPE_NONE);
             }
             break;
         }
@@ -483,28 +494,18 @@ static uint8_t _bolt_handle_xcb_event(xcb_connection_t* c, xcb_generic_event_t*
             if (event->event != main_window_xcb) return true;
             switch (event->detail) {
                 case 1:
-                    return handle_mouse_event(event->event_x, event->event_y, event->state, offsetof(struct WindowPendingInput, mouse_left_up), offsetof(struct WindowPendingInput, mouse_left_up_event), GRAB_TYPE_STOP);
+                    return handle_mouse_event(event->event_x, event->event_y, event->state, INPUT_MOUSE_LEFT_UP, GRAB_TYPE_STOP);
                 case 2:
-                    return handle_mouse_event(event->event_x, event->event_y, event->state, offsetof(struct WindowPendingInput, mouse_middle_up), offsetof(struct WindowPendingInput, mouse_middle_up_event), GRAB_TYPE_NONE);
+                    return handle_mouse_event(event->event_x, event->event_y, event->state, INPUT_MOUSE_MIDDLE_UP, GRAB_TYPE_NONE);
                 case 3:
-                    return handle_mouse_event(event->event_x, event->event_y, event->state, offsetof(struct WindowPendingInput, mouse_right_up), offsetof(struct WindowPendingInput, mouse_right_up_event), GRAB_TYPE_NONE);
+                    return handle_mouse_event(event->event_x, event->event_y, event->state, INPUT_MOUSE_RIGHT_UP, GRAB_TYPE_NONE);
                 case 4:
                 case 5: {
                     // for mousewheel-up events, we don't need to do anything with them, but we do
                     // still need to figure out if they should go to the game window or not.
                     struct WindowInfo* windows = _bolt_plugin_windowinfo();
-                    uint8_t ret = true;
                     _bolt_rwlock_lock_read(&windows->lock);
-                    size_t iter = 0;
-                    void* item;
-                    while (hashmap_iter(windows->map, &iter, &item)) {
-                        struct EmbeddedWindow** window = item;
-                        _bolt_rwlock_lock_read(&(*window)->lock);
-                        const uint8_t in_window = point_in_rect(event->event_x, event->event_y, (*window)->metadata.x, (*window)->metadata.y, (*window)->metadata.width, (*window)->metadata.height);
-                        _bolt_rwlock_unlock_read(&(*window)->lock);
-                        ret &= !in_window;
-                        if (!ret) break;
-                    }
+                    const uint8_t ret = !_bolt_plugin_window_at(event->event_x, event->event_y, NULL);
                     _bolt_rwlock_unlock_read(&windows->lock);
                     return ret;
                 }
@@ -514,14 +515,14 @@ static uint8_t _bolt_handle_xcb_event(xcb_connection_t* c, xcb_generic_event_t*
         case XCB_MOTION_NOTIFY: { // when mouse moves while dragging from inside the game window
             xcb_motion_notify_event_t* event = (xcb_motion_notify_event_t*)e;
             if (event->event != main_window_xcb) return true;
-            return handle_mouse_event(event->event_x, event->event_y, event->state, offsetof(struct WindowPendingInput, mouse_motion), offsetof(struct WindowPendingInput, mouse_motion_event), GRAB_TYPE_NONE);
+            return handle_mouse_event(event->event_x, event->event_y, event->state, INPUT_MOUSE_MOTION, GRAB_TYPE_NONE);
         }
         case XCB_ENTER_NOTIFY: {
             xcb_enter_notify_event_t* event = (xcb_enter_notify_event_t*)e;
             if (event->event != main_window_xcb) return true;
 
             // treat an enter event like a motion event, but also update mouse-in state
-            const uint8_t ret = handle_mouse_event(event->event_x, event->event_y, event->state, offsetof(struct WindowPendingInput, mouse_motion), offsetof(struct WindowPendingInput, mouse_motion_event), GRAB_TYPE_NONE);
+            const uint8_t ret = handle_mouse_event(event->event_x, event->event_y, event->state, INPUT_MOUSE_MOTION, GRAB_TYPE_NONE);
             mousein_real = 1;
             mousein_fake = ret;
             return ret;
@@ -541,10 +542,9 @@ static uint8_t _bolt_handle_xcb_event(xcb_connection_t* c, xcb_generic_event_t*
                 const int16_t wx = (*window)->metadata.x;
                 const int16_t wy = (*window)->metadata.y;
                 _bolt_rwlock_unlock_read(&(*window)->lock);
-                _bolt_rwlock_lock_write(&(*window)->input_lock);
-                (*window)->input.mouse_leave = 1;
-                _bolt_mouseevent_from_xcb(event->event_x - wx, event->event_y - wy, event->detail, &(*window)->input.mouse_leave_event);
-                _bolt_rwlock_unlock_write(&(*window)->input_lock);
+                struct MouseEvent leave_event;
+                _bolt_mouseevent_from_xcb(event->event_x - wx, event->event_y - wy, event->detail, &leave_event);
+                _bolt_plugin_input_post(&(*window)->input, INPUT_MOUSE_LEAVE, &leave_event);
             }
             _bolt_rwlock_unlock_read(&windows->lock);
             const uint8_t ret = mousein_fake;
@@ -650,6 +650,7 @@ static void* _bolt_dl_lookup(void* handle, const char* symbol) {
         if (strcmp(symbol, "glTexSubImage2D") == 0) return glTexSubImage2D;
         if (strcmp(symbol, "glDeleteTextures") == 0) return glDeleteTextures;
         if (strcmp(symbol, "glClear") == 0) return glClear;
+        if (strcmp(symbol, "glPixelStorei") == 0) return glPixelStorei;
     } else if (handle == libxcb_addr) {
         if (strcmp(symbol, "xcb_poll_for_event") == 0) return xcb_poll_for_event;
         if (strcmp(symbol, "xcb_poll_for_queued_event") == 0) return xcb_poll_for_queued_event;
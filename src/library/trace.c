@@ -0,0 +1,381 @@
+#include "trace.h"
+#include "rwlock/rwlock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define TRACE_FILE_BUFFER_SIZE (1024 * 1024)
+#define TRACE_MAX_THREADS 256
+
+uint8_t bolt_trace_recording = 0;
+
+// everything after trace_lock is protected by it. the write lock is held from _bolt_trace_begin until
+// _bolt_trace_end, so that records from different threads don't get mixed together
+static RWLock trace_lock;
+static FILE* trace_file = NULL;
+static uint8_t* trace_scratch = NULL; // payload of the record currently being built
+static size_t trace_scratch_len = 0;
+static size_t trace_scratch_capacity = 0;
+static uint8_t trace_op;
+static uint8_t trace_thread;
+static size_t trace_thread_count = 0;
+
+// index+1 of the calling thread, or 0 if it hasn't recorded anything yet
+#if defined(_WIN32)
+static DWORD trace_thread_tls;
+#else
+static pthread_key_t trace_thread_tls;
+#endif
+
+void _bolt_trace_open_from_env() {
+    if (bolt_trace_recording) return;
+    const char* path = getenv("BOLT_GL_TRACE");
+    if (!path || !*path) return;
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        printf("[trace] couldn't open '%s' for writing, not recording\n", path);
+        return;
+    }
+    setvbuf(file, NULL, _IOFBF, TRACE_FILE_BUFFER_SIZE);
+    const uint32_t version = BOLT_TRACE_VERSION;
+    fwrite(BOLT_TRACE_MAGIC, 1, sizeof(BOLT_TRACE_MAGIC) - 1, file);
+    fwrite(&version, sizeof(version), 1, file);
+#if defined(_WIN32)
+    trace_thread_tls = TlsAlloc();
+#else
+    pthread_key_create(&trace_thread_tls, NULL);
+#endif
+    _bolt_rwlock_init(&trace_lock);
+    trace_file = file;
+    trace_thread_count = 0;
+    bolt_trace_recording = 1;
+    printf("[trace] recording GL hooks to '%s'\n", path);
+}
+
+void _bolt_trace_close() {
+    if (!bolt_trace_recording) return;
+    _bolt_rwlock_lock_write(&trace_lock);
+    bolt_trace_recording = 0;
+    fclose(trace_file);
+    trace_file = NULL;
+    free(trace_scratch);
+    trace_scratch = NULL;
+    trace_scratch_len = 0;
+    trace_scratch_capacity = 0;
+    _bolt_rwlock_unlock_write(&trace_lock);
+}
+
+static void _bolt_trace_write(const void* data, size_t size) {
+    if (trace_scratch_len + size > trace_scratch_capacity) {
+        size_t capacity = trace_scratch_capacity ? trace_scratch_capacity : 256;
+        while (trace_scratch_len + size > capacity) capacity *= 2;
+        uint8_t* scratch = realloc(trace_scratch, capacity);
+        if (!scratch) return;
+        trace_scratch = scratch;
+        trace_scratch_capacity = capacity;
+    }
+    memcpy(trace_scratch + trace_scratch_len, data, size);
+    trace_scratch_len += size;
+}
+
+// writes a LEB128-encoded value into `out`, returning the number of bytes used (at most 10)
+static size_t _bolt_trace_leb128(uint64_t value, uint8_t* out) {
+    size_t n = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        if (value) byte |= 0x80;
+        out[n++] = byte;
+    } while (value);
+    return n;
+}
+
+void _bolt_trace_begin(enum BoltTraceOp op) {
+    _bolt_rwlock_lock_write(&trace_lock);
+#if defined(_WIN32)
+    uintptr_t thread = (uintptr_t)TlsGetValue(trace_thread_tls);
+#else
+    uintptr_t thread = (uintptr_t)pthread_getspecific(trace_thread_tls);
+#endif
+    if (!thread) {
+        // threads past the limit all get lumped in with the last one, which a replay can't tell apart
+        if (trace_thread_count < TRACE_MAX_THREADS) trace_thread_count += 1;
+        thread = trace_thread_count;
+#if defined(_WIN32)
+        TlsSetValue(trace_thread_tls, (void*)thread);
+#else
+        pthread_setspecific(trace_thread_tls, (void*)thread);
+#endif
+    }
+    trace_op = (uint8_t)op;
+    trace_thread = (uint8_t)(thread - 1);
+    trace_scratch_len = 0;
+}
+
+void _bolt_trace_u8(uint8_t value) {
+    _bolt_trace_write(&value, sizeof(value));
+}
+
+void _bolt_trace_u32(uint32_t value) {
+    _bolt_trace_write(&value, sizeof(value));
+}
+
+void _bolt_trace_u64(uint64_t value) {
+    _bolt_trace_write(&value, sizeof(value));
+}
+
+void _bolt_trace_f32(float value) {
+    _bolt_trace_write(&value, sizeof(value));
+}
+
+void _bolt_trace_blob(const void* data, size_t size) {
+    uint8_t length[10];
+    _bolt_trace_write(length, _bolt_trace_leb128(data ? (uint64_t)size + 1 : 0, length));
+    if (data) _bolt_trace_write(data, size);
+}
+
+void _bolt_trace_end() {
+    if (trace_file) {
+        uint8_t header[12];
+        header[0] = trace_op;
+        header[1] = trace_thread;
+        const size_t header_len = 2 + _bolt_trace_leb128(trace_scratch_len, header + 2);
+        fwrite(header, 1, header_len, trace_file);
+        fwrite(trace_scratch, 1, trace_scratch_len, trace_file);
+    }
+    _bolt_rwlock_unlock_write(&trace_lock);
+}
+
+static void _bolt_trace_result(enum BoltTraceResult result, const void* data, size_t size) {
+    if (!bolt_trace_recording) return;
+    _bolt_trace_begin(TRACE_OP_RESULT);
+    _bolt_trace_u8((uint8_t)result);
+    _bolt_trace_blob(data, size);
+    _bolt_trace_end();
+}
+
+/* recording wrappers for driver functions */
+
+static struct GLProcFunctions real_gl;
+static struct GLLibFunctions wrapped_lgl;
+static void (*real_lgl_GenTextures)(GLsizei, GLuint*);
+
+static GLuint _bolt_trace_CreateProgram() {
+    const GLuint ret = real_gl.CreateProgram();
+    _bolt_trace_result(TRACE_RESULT_CREATEPROGRAM, &ret, sizeof(ret));
+    return ret;
+}
+
+static GLuint _bolt_trace_CreateShader(GLenum type) {
+    const GLuint ret = real_gl.CreateShader(type);
+    _bolt_trace_result(TRACE_RESULT_CREATESHADER, &ret, sizeof(ret));
+    return ret;
+}
+
+static void _bolt_trace_GenBuffers(GLsizei n, GLuint* buffers) {
+    real_gl.GenBuffers(n, buffers);
+    _bolt_trace_result(TRACE_RESULT_GENBUFFERS, buffers, n * sizeof(*buffers));
+}
+
+static void _bolt_trace_GenFramebuffers(GLsizei n, GLuint* framebuffers) {
+    real_gl.GenFramebuffers(n, framebuffers);
+    _bolt_trace_result(TRACE_RESULT_GENFRAMEBUFFERS, framebuffers, n * sizeof(*framebuffers));
+}
+
+static void _bolt_trace_GenVertexArrays(GLsizei n, GLuint* arrays) {
+    real_gl.GenVertexArrays(n, arrays);
+    _bolt_trace_result(TRACE_RESULT_GENVERTEXARRAYS, arrays, n * sizeof(*arrays));
+}
+
+static void _bolt_trace_GenTextures(GLsizei n, GLuint* textures) {
+    real_lgl_GenTextures(n, textures);
+    _bolt_trace_result(TRACE_RESULT_GENTEXTURES, textures, n * sizeof(*textures));
+}
+
+static void _bolt_trace_GetActiveUniformBlockiv(GLuint program, GLuint index, GLenum pname, GLint* params) {
+    real_gl.GetActiveUniformBlockiv(program, index, pname, params);
+    _bolt_trace_result(TRACE_RESULT_GETACTIVEUNIFORMBLOCKIV, params, sizeof(*params));
+}
+
+static void _bolt_trace_GetActiveUniformsiv(GLuint program, GLsizei count, const GLuint* indices, GLenum pname, GLint* params) {
+    real_gl.GetActiveUniformsiv(program, count, indices, pname, params);
+    _bolt_trace_result(TRACE_RESULT_GETACTIVEUNIFORMSIV, params, count * sizeof(*params));
+}
+
+static void _bolt_trace_GetIntegerv(GLenum pname, GLint* data) {
+    real_gl.GetIntegerv(pname, data);
+    _bolt_trace_result(TRACE_RESULT_GETINTEGERV, data, sizeof(*data));
+}
+
+static GLuint _bolt_trace_GetUniformBlockIndex(GLuint program, const GLchar* name) {
+    const GLuint ret = real_gl.GetUniformBlockIndex(program, name);
+    _bolt_trace_result(TRACE_RESULT_GETUNIFORMBLOCKINDEX, &ret, sizeof(ret));
+    return ret;
+}
+
+static void _bolt_trace_GetUniformIndices(GLuint program, GLsizei count, const GLchar** names, GLuint* indices) {
+    real_gl.GetUniformIndices(program, count, names, indices);
+    _bolt_trace_result(TRACE_RESULT_GETUNIFORMINDICES, indices, count * sizeof(*indices));
+}
+
+static GLint _bolt_trace_GetUniformLocation(GLuint program, const GLchar* name) {
+    const GLint ret = real_gl.GetUniformLocation(program, name);
+    _bolt_trace_result(TRACE_RESULT_GETUNIFORMLOCATION, &ret, sizeof(ret));
+    return ret;
+}
+
+static void* _bolt_trace_MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    void* ret = real_gl.MapBufferRange(target, offset, length, access);
+    if (access & GL_MAP_READ_BIT) _bolt_trace_result(TRACE_RESULT_MAPBUFFERRANGE, ret, ret ? length : 0);
+    return ret;
+}
+
+static GLboolean _bolt_trace_UnmapBuffer(GLenum target) {
+    const GLboolean ret = real_gl.UnmapBuffer(target);
+    _bolt_trace_result(TRACE_RESULT_UNMAPBUFFER, &ret, sizeof(ret));
+    return ret;
+}
+
+static GLenum _bolt_trace_ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    const GLenum ret = real_gl.ClientWaitSync(sync, flags, timeout);
+    _bolt_trace_result(TRACE_RESULT_CLIENTWAITSYNC, &ret, sizeof(ret));
+    return ret;
+}
+
+void _bolt_trace_wrap_proc_functions(struct GLProcFunctions* gl) {
+    real_gl = *gl;
+#define WRAP(NAME) if (gl->NAME) gl->NAME = _bolt_trace_##NAME;
+    WRAP(CreateProgram)
+    WRAP(CreateShader)
+    WRAP(GenBuffers)
+    WRAP(GenFramebuffers)
+    WRAP(GenVertexArrays)
+    WRAP(GetActiveUniformBlockiv)
+    WRAP(GetActiveUniformsiv)
+    WRAP(GetIntegerv)
+    WRAP(GetUniformBlockIndex)
+    WRAP(GetUniformIndices)
+    WRAP(GetUniformLocation)
+    WRAP(MapBufferRange)
+    WRAP(UnmapBuffer)
+    WRAP(ClientWaitSync)
+#undef WRAP
+}
+
+const struct GLLibFunctions* _bolt_trace_wrap_lib_functions(const struct GLLibFunctions* libgl) {
+    wrapped_lgl = *libgl;
+    real_lgl_GenTextures = libgl->GenTextures;
+    wrapped_lgl.GenTextures = _bolt_trace_GenTextures;
+    return &wrapped_lgl;
+}
+
+/* reading */
+
+static uint8_t _bolt_trace_read_leb128(const uint8_t** ptr, const uint8_t* end, uint64_t* value) {
+    uint64_t ret = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (*ptr >= end) return 0;
+        const uint8_t byte = **ptr;
+        *ptr += 1;
+        ret |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = ret;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint8_t _bolt_trace_read_header(const uint8_t* data, size_t size, size_t* offset) {
+    const size_t magic_len = sizeof(BOLT_TRACE_MAGIC) - 1;
+    uint32_t version;
+    if (size < magic_len + sizeof(version) || memcmp(data, BOLT_TRACE_MAGIC, magic_len)) return 0;
+    memcpy(&version, data + magic_len, sizeof(version));
+    if (version != BOLT_TRACE_VERSION) return 0;
+    *offset = magic_len + sizeof(version);
+    return 1;
+}
+
+uint8_t _bolt_trace_read_record(const uint8_t* data, size_t size, size_t* offset, struct BoltTraceRecord* record) {
+    const uint8_t* ptr = data + *offset;
+    const uint8_t* end = data + size;
+    uint64_t length;
+    if (end - ptr < 2) return 0;
+    record->op = ptr[0];
+    record->thread = ptr[1];
+    ptr += 2;
+    if (!_bolt_trace_read_leb128(&ptr, end, &length) || length > (uint64_t)(end - ptr)) return 0;
+    record->length = (size_t)length;
+    record->payload = ptr;
+    *offset = (ptr + length) - data;
+    return 1;
+}
+
+void _bolt_trace_cursor_init(struct BoltTraceCursor* cursor, const struct BoltTraceRecord* record) {
+    cursor->ptr = record->payload;
+    cursor->end = record->payload + record->length;
+    cursor->overrun = 0;
+}
+
+static uint8_t _bolt_trace_read(struct BoltTraceCursor* cursor, void* out, size_t size) {
+    if ((size_t)(cursor->end - cursor->ptr) < size) {
+        memset(out, 0, size);
+        cursor->ptr = cursor->end;
+        cursor->overrun = 1;
+        return 0;
+    }
+    memcpy(out, cursor->ptr, size);
+    cursor->ptr += size;
+    return 1;
+}
+
+uint8_t _bolt_trace_read_u8(struct BoltTraceCursor* cursor) {
+    uint8_t ret;
+    _bolt_trace_read(cursor, &ret, sizeof(ret));
+    return ret;
+}
+
+uint32_t _bolt_trace_read_u32(struct BoltTraceCursor* cursor) {
+    uint32_t ret;
+    _bolt_trace_read(cursor, &ret, sizeof(ret));
+    return ret;
+}
+
+uint64_t _bolt_trace_read_u64(struct BoltTraceCursor* cursor) {
+    uint64_t ret;
+    _bolt_trace_read(cursor, &ret, sizeof(ret));
+    return ret;
+}
+
+float _bolt_trace_read_f32(struct BoltTraceCursor* cursor) {
+    float ret;
+    _bolt_trace_read(cursor, &ret, sizeof(ret));
+    return ret;
+}
+
+const void* _bolt_trace_read_blob(struct BoltTraceCursor* cursor, size_t* size) {
+    uint64_t length;
+    *size = 0;
+    if (!_bolt_trace_read_leb128(&cursor->ptr, cursor->end, &length)) {
+        cursor->ptr = cursor->end;
+        cursor->overrun = 1;
+        return NULL;
+    }
+    if (length == 0) return NULL;
+    if (length - 1 > (uint64_t)(cursor->end - cursor->ptr)) {
+        cursor->ptr = cursor->end;
+        cursor->overrun = 1;
+        return NULL;
+    }
+    const void* ret = cursor->ptr;
+    *size = (size_t)(length - 1);
+    cursor->ptr += length - 1;
+    return ret;
+}
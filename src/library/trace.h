@@ -0,0 +1,178 @@
+#ifndef _BOLT_LIBRARY_TRACE_H_
+#define _BOLT_LIBRARY_TRACE_H_
+#include "gl.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* GL hook trace format
+ *
+ * An optional recording of every call the game makes into the hooks in gl.c, along with everything
+ * gl.c got back from the driver while handling them, so that the same stream of calls can be replayed
+ * later against stub GL functions (see bench/hook_bench.c). Recording is turned on by setting the
+ * BOLT_GL_TRACE environment variable to the path of the file to write.
+ *
+ * The file starts with BOLT_TRACE_MAGIC and a u32 BOLT_TRACE_VERSION, followed by records. Each record
+ * is a u8 op (one of BoltTraceOp), a u8 thread index (0 for the first thread that was seen, 1 for the
+ * next and so on), a LEB128 payload length, and the payload. Payload fields are listed next to each op
+ * below and are written in host byte order; "blob" is a LEB128 length plus one, then that many bytes,
+ * with a length of 0 meaning NULL. Pointer-sized values, including GLsizeiptr and buffer offsets passed
+ * as pointers, are u64. The payload of a record may be longer than the fields listed for its op, in
+ * which case readers should ignore the rest.
+ */
+#define BOLT_TRACE_MAGIC "BOLTGLTR"
+#define BOLT_TRACE_VERSION 2
+
+enum BoltTraceOp {
+    // something gl.c got from the driver while handling the previous call on the same thread:
+    // u8 BoltTraceResult, blob data
+    TRACE_OP_RESULT,
+
+    // os-level and libgl hooks, corresponding to the _bolt_gl_on* functions in gl.h
+    TRACE_OP_CREATECONTEXT, // u64 context, u64 shared_context, u8 is_important
+    TRACE_OP_MAKECURRENT, // u64 context
+    TRACE_OP_DESTROYCONTEXT, // u64 context
+    TRACE_OP_SWAPBUFFERS, // u32 window_width, u32 window_height
+    TRACE_OP_GENTEXTURES, // blob GLuint[]
+    TRACE_OP_DRAWELEMENTS, // u32 mode, u32 count, u32 type, u64 indices_offset
+    TRACE_OP_DRAWARRAYS, // u32 mode, u32 first, u32 count
+    TRACE_OP_BINDTEXTURE, // u32 target, u32 texture
+    TRACE_OP_TEXSUBIMAGE2D, // u32 target, level, xoffset, yoffset, width, height, format, type, u64 pixels, blob pixels
+    TRACE_OP_DELETETEXTURES, // blob GLuint[]
+    TRACE_OP_CLEAR, // u32 mask
+    TRACE_OP_VIEWPORT, // u32 x, y, width, height
+    TRACE_OP_PIXELSTOREI, // u32 pname, u32 param
+
+    // hooks returned from _bolt_gl_GetProcAddress, named after the GL function they hook. a "blob"
+    // of pixels or data is only present if the pointer wasn't an offset into a bound buffer
+    TRACE_OP_CREATEPROGRAM, // no fields
+    TRACE_OP_DELETEPROGRAM, // u32 program
+    TRACE_OP_BINDATTRIBLOCATION, // u32 program, u32 index, blob name (including the terminator)
+    TRACE_OP_LINKPROGRAM, // u32 program
+    TRACE_OP_USEPROGRAM, // u32 program
+    TRACE_OP_TEXSTORAGE2D, // u32 target, levels, internalformat, width, height
+    TRACE_OP_VERTEXATTRIBPOINTER, // u32 index, size, type, normalised, stride, u64 pointer
+    TRACE_OP_GENBUFFERS, // u32 n
+    TRACE_OP_BUFFERDATA, // u32 target, u64 size, blob data, u32 usage
+    TRACE_OP_DELETEBUFFERS, // blob GLuint[]
+    TRACE_OP_BINDFRAMEBUFFER, // u32 target, u32 framebuffer
+    TRACE_OP_GENFRAMEBUFFERS, // u32 n
+    TRACE_OP_DELETEFRAMEBUFFERS, // blob GLuint[]
+    TRACE_OP_FRAMEBUFFERTEXTURE, // u32 target, attachment, texture, level
+    TRACE_OP_FRAMEBUFFERTEXTURE2D, // u32 target, attachment, textarget, texture, level
+    TRACE_OP_FRAMEBUFFERTEXTURELAYER, // u32 target, attachment, texture, level, layer
+    TRACE_OP_FRAMEBUFFERRENDERBUFFER, // u32 target, attachment, renderbuffertarget, renderbuffer
+    TRACE_OP_BINDBUFFER, // u32 target, u32 buffer
+    TRACE_OP_BINDBUFFERBASE, // u32 target, u32 index, u32 buffer
+    TRACE_OP_BINDBUFFERRANGE, // u32 target, u32 index, u32 buffer, u64 offset, u64 size
+    TRACE_OP_UNIFORMBLOCKBINDING, // u32 program, u32 block_index, u32 binding
+    TRACE_OP_UNIFORM1I, // u32 location, u32 v0
+    TRACE_OP_UNIFORM1IV, // u32 location, blob GLint[]
+    TRACE_OP_UNIFORM4F, // u32 location, f32 v0, v1, v2, v3
+    TRACE_OP_UNIFORM4FV, // u32 location, blob GLfloat[4][]
+    TRACE_OP_UNIFORMMATRIX4FV, // u32 location, u32 transpose, blob GLfloat[16][]
+    TRACE_OP_COMPRESSEDTEXSUBIMAGE2D, // u32 target, level, xoffset, yoffset, width, height, format, image_size, u64 data, blob data
+    TRACE_OP_COPYIMAGESUBDATA, // u32 src name, target, level, x, y, z, dst name, target, level, x, y, z, width, height, depth
+    TRACE_OP_ENABLEVERTEXATTRIBARRAY, // u32 index
+    TRACE_OP_DISABLEVERTEXATTRIBARRAY, // u32 index
+    TRACE_OP_MAPBUFFERRANGE, // u32 target, u64 offset, u64 length, u32 access
+    TRACE_OP_UNMAPBUFFER, // u32 target
+    TRACE_OP_BUFFERSTORAGE, // u32 target, u64 size, blob data, u32 flags
+    TRACE_OP_FLUSHMAPPEDBUFFERRANGE, // u32 target, u64 offset, u64 length, blob (what the game wrote to the mapping, if gl.c intercepted it)
+    TRACE_OP_ACTIVETEXTURE, // u32 texture
+    TRACE_OP_GENVERTEXARRAYS, // u32 n
+    TRACE_OP_DELETEVERTEXARRAYS, // blob GLuint[]
+    TRACE_OP_BINDVERTEXARRAY, // u32 array
+    TRACE_OP_BLITFRAMEBUFFER, // u32 src x0, y0, x1, y1, dst x0, y0, x1, y1, mask, filter
+
+    TRACE_OP_COUNT,
+};
+// glMultiDrawElements has no op of its own, since its hook calls _bolt_gl_onDrawElements for each draw
+
+/// Driver functions whose output affects what gl.c does, and so needs to be recorded as a TRACE_OP_RESULT.
+/// The blob holds whatever the function returned or wrote to its output pointer.
+enum BoltTraceResult {
+    TRACE_RESULT_CREATEPROGRAM, // GLuint
+    TRACE_RESULT_CREATESHADER, // GLuint
+    TRACE_RESULT_GENBUFFERS, // GLuint[]
+    TRACE_RESULT_GENFRAMEBUFFERS, // GLuint[]
+    TRACE_RESULT_GENVERTEXARRAYS, // GLuint[]
+    TRACE_RESULT_GENTEXTURES, // GLuint[], from libgl
+    TRACE_RESULT_GETACTIVEUNIFORMBLOCKIV, // GLint
+    TRACE_RESULT_GETACTIVEUNIFORMSIV, // GLint[]
+    TRACE_RESULT_GETINTEGERV, // GLint
+    TRACE_RESULT_GETUNIFORMBLOCKINDEX, // GLuint
+    TRACE_RESULT_GETUNIFORMINDICES, // GLuint[]
+    TRACE_RESULT_GETUNIFORMLOCATION, // GLint
+    TRACE_RESULT_MAPBUFFERRANGE, // the mapped contents, only for mappings with GL_MAP_READ_BIT
+    TRACE_RESULT_UNMAPBUFFER, // GLboolean
+    TRACE_RESULT_CLIENTWAITSYNC, // GLenum
+
+    TRACE_RESULT_COUNT,
+};
+
+/// True if a trace is being recorded. Set by _bolt_trace_open_from_env and cleared by _bolt_trace_close.
+extern uint8_t bolt_trace_recording;
+
+/// Opens the trace file named by the BOLT_GL_TRACE environment variable, if it's set, and starts
+/// recording. Does nothing if it's not set or a trace is already being recorded. Call this before the
+/// first hook that should be recorded.
+void _bolt_trace_open_from_env();
+
+/// Flushes and closes the trace file, if there is one. Anything recorded after this point is dropped.
+void _bolt_trace_close();
+
+/// Starts a record, which must be ended with _bolt_trace_end on the same thread. Only call this while
+/// bolt_trace_recording is set, and don't call anything that could record something else before ending it.
+void _bolt_trace_begin(enum BoltTraceOp op);
+void _bolt_trace_u8(uint8_t);
+void _bolt_trace_u32(uint32_t);
+void _bolt_trace_u64(uint64_t);
+void _bolt_trace_f32(float);
+void _bolt_trace_blob(const void* data, size_t size);
+void _bolt_trace_end();
+
+/// Replaces the functions in `gl` that produce a result with ones that record it, after calling the
+/// originals. Call this once, after `gl` has been fully loaded, if bolt_trace_recording is set.
+void _bolt_trace_wrap_proc_functions(struct GLProcFunctions* gl);
+
+/// Returns a copy of `libgl` whose functions that produce a result will also record it. The returned
+/// struct is static, so this should only be called once, if bolt_trace_recording is set.
+const struct GLLibFunctions* _bolt_trace_wrap_lib_functions(const struct GLLibFunctions* libgl);
+
+/* reading */
+
+/// One record from a trace that's been loaded into memory. `payload` points into the loaded file.
+struct BoltTraceRecord {
+    uint8_t op;
+    uint8_t thread;
+    size_t length;
+    const uint8_t* payload;
+};
+
+/// A position in a record's payload. Reads past the end of the payload give zero, or an empty blob,
+/// and set `overrun`, so the fields of a record can be read without checking the length first.
+struct BoltTraceCursor {
+    const uint8_t* ptr;
+    const uint8_t* end;
+    uint8_t overrun;
+};
+
+/// Checks the header of a trace file that's been loaded into memory, setting `offset` to the first
+/// record. Returns 1 on success or 0 if the data isn't a trace of a version this build understands.
+uint8_t _bolt_trace_read_header(const uint8_t* data, size_t size, size_t* offset);
+
+/// Reads the record at `offset` and moves `offset` past it. Returns 1 on success, or 0 at the end
+/// of the data or if the record is truncated.
+uint8_t _bolt_trace_read_record(const uint8_t* data, size_t size, size_t* offset, struct BoltTraceRecord* record);
+
+void _bolt_trace_cursor_init(struct BoltTraceCursor* cursor, const struct BoltTraceRecord* record);
+uint8_t _bolt_trace_read_u8(struct BoltTraceCursor*);
+uint32_t _bolt_trace_read_u32(struct BoltTraceCursor*);
+uint64_t _bolt_trace_read_u64(struct BoltTraceCursor*);
+float _bolt_trace_read_f32(struct BoltTraceCursor*);
+
+/// Reads a blob, returning a pointer into the payload (or NULL if the blob was NULL) and setting `size`.
+const void* _bolt_trace_read_blob(struct BoltTraceCursor*, size_t* size);
+
+#endif